@@ -0,0 +1,571 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file batched audio transcoding API usage example
+ * @example transcode_batch.c
+ *
+ * Transcode a list of audio files in one process, with a pool of worker
+ * threads. Each worker keeps its decoder, resampler and encoder between
+ * jobs and only reopens them when the stream parameters change, which
+ * avoids the setup cost of one process per file for short tracks.
+ *
+ * The playlist holds one job per line, the input and output file names
+ * separated by a tab. Empty lines and lines starting with '#' are ignored.
+ *
+ * Gapless playback is preserved: the decoder drops the delay and padding
+ * signalled by the demuxer, the output starts at sample 0 and the encoder
+ * delay is written as negative timestamps, which muxers such as mp4 turn
+ * into an edit list.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+
+#include "libavcodec/avcodec.h"
+
+#include "libavutil/audio_fifo.h"
+#include "libavutil/avstring.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/frame.h"
+#include "libavutil/time.h"
+
+#include "libswresample/swresample.h"
+
+/* Frame size used for encoders which accept any frame size */
+#define DEFAULT_FRAME_SIZE 4096
+
+typedef struct Job {
+    char *input;
+    char *output;
+} Job;
+
+typedef struct Worker {
+    pthread_t thread;
+
+    AVCodecContext    *dec;
+    AVCodecParameters *dec_par;   ///< parameters the decoder was opened with
+    AVCodecContext    *enc;
+    int                enc_global_header;
+    SwrContext        *swr;
+    AVAudioFifo       *fifo;
+    enum AVSampleFormat fifo_fmt;
+    int                fifo_channels;
+
+    AVFrame  *frame;
+    AVFrame  *conv;
+    AVPacket *pkt;
+    int64_t   next_pts;
+
+    int nb_dec_opened, nb_enc_opened;
+} Worker;
+
+static const AVCodec *encoder;
+static int64_t bit_rate = 128000;
+
+static Job *jobs;
+static int nb_jobs, next_job, nb_failed;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static Job *get_job(void)
+{
+    Job *job = NULL;
+
+    pthread_mutex_lock(&job_lock);
+    if (next_job < nb_jobs)
+        job = &jobs[next_job++];
+    pthread_mutex_unlock(&job_lock);
+    return job;
+}
+
+static int same_decoder_params(const AVCodecParameters *a,
+                               const AVCodecParameters *b)
+{
+    return a->codec_id              == b->codec_id              &&
+           a->format                == b->format                &&
+           a->sample_rate           == b->sample_rate           &&
+           a->bits_per_coded_sample == b->bits_per_coded_sample &&
+           a->block_align           == b->block_align           &&
+           a->extradata_size        == b->extradata_size        &&
+           !av_channel_layout_compare(&a->ch_layout, &b->ch_layout) &&
+           (!a->extradata_size ||
+            !memcmp(a->extradata, b->extradata, a->extradata_size));
+}
+
+/**
+ * Reuse the decoder of the previous job if the new stream has the same
+ * parameters, otherwise open a new one.
+ */
+static int get_decoder(Worker *w, const AVStream *st)
+{
+    const AVCodec *codec;
+    int ret;
+
+    if (w->dec && same_decoder_params(w->dec_par, st->codecpar)) {
+        avcodec_flush_buffers(w->dec);
+        w->dec->pkt_timebase = st->time_base;
+        return 0;
+    }
+
+    avcodec_free_context(&w->dec);
+    if (!(codec = avcodec_find_decoder(st->codecpar->codec_id))) {
+        fprintf(stderr, "Could not find decoder for %s\n",
+                avcodec_get_name(st->codecpar->codec_id));
+        return AVERROR_DECODER_NOT_FOUND;
+    }
+    if (!(w->dec = avcodec_alloc_context3(codec)))
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_parameters_to_context(w->dec, st->codecpar)) < 0 ||
+        (ret = avcodec_parameters_copy(w->dec_par, st->codecpar)) < 0) {
+        avcodec_free_context(&w->dec);
+        return ret;
+    }
+    w->dec->pkt_timebase = st->time_base;
+    if ((ret = avcodec_open2(w->dec, codec, NULL)) < 0) {
+        fprintf(stderr, "Could not open decoder: %s\n", av_err2str(ret));
+        avcodec_free_context(&w->dec);
+        return ret;
+    }
+    w->nb_dec_opened++;
+    return 0;
+}
+
+static int select_sample_rate(int rate)
+{
+    const int *p = encoder->supported_samplerates;
+    int best = 0;
+
+    if (!p)
+        return rate;
+    for (; *p; p++)
+        if (!best || abs(*p - rate) < abs(best - rate))
+            best = *p;
+    return best;
+}
+
+static int select_layout(AVChannelLayout *dst, const AVChannelLayout *src)
+{
+    const AVChannelLayout *p = encoder->ch_layouts;
+
+    if (!p)
+        return av_channel_layout_copy(dst, src);
+    for (; p->nb_channels; p++)
+        if (!av_channel_layout_compare(p, src))
+            return av_channel_layout_copy(dst, src);
+    av_channel_layout_default(dst, FFMIN(src->nb_channels, 2));
+    return 0;
+}
+
+/**
+ * Reuse the encoder of the previous job if it can be flushed and the output
+ * parameters did not change, otherwise open a new one.
+ */
+static int get_encoder(Worker *w, const AVCodecContext *dec, int global_header)
+{
+    AVChannelLayout layout = { 0 };
+    int rate = select_sample_rate(dec->sample_rate);
+    enum AVSampleFormat fmt = encoder->sample_fmts ? encoder->sample_fmts[0]
+                                                   : dec->sample_fmt;
+    int ret;
+
+    if ((ret = select_layout(&layout, &dec->ch_layout)) < 0)
+        return ret;
+
+    if (w->enc && (encoder->capabilities & AV_CODEC_CAP_ENCODER_FLUSH) &&
+        w->enc->sample_rate == rate && w->enc->sample_fmt == fmt &&
+        w->enc_global_header == global_header &&
+        !av_channel_layout_compare(&w->enc->ch_layout, &layout)) {
+        av_channel_layout_uninit(&layout);
+        avcodec_flush_buffers(w->enc);
+        return 0;
+    }
+
+    avcodec_free_context(&w->enc);
+    if (!(w->enc = avcodec_alloc_context3(encoder))) {
+        av_channel_layout_uninit(&layout);
+        return AVERROR(ENOMEM);
+    }
+    w->enc->ch_layout   = layout;
+    w->enc->sample_rate = rate;
+    w->enc->sample_fmt  = fmt;
+    w->enc->bit_rate    = bit_rate;
+    w->enc->time_base   = (AVRational){ 1, rate };
+    if (global_header)
+        w->enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    w->enc_global_header = global_header;
+    if ((ret = avcodec_open2(w->enc, encoder, NULL)) < 0) {
+        fprintf(stderr, "Could not open encoder: %s\n", av_err2str(ret));
+        avcodec_free_context(&w->enc);
+        return ret;
+    }
+    w->nb_enc_opened++;
+    return 0;
+}
+
+static int frame_size(const AVCodecContext *enc)
+{
+    if (!enc->frame_size ||
+        (enc->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE))
+        return DEFAULT_FRAME_SIZE;
+    return enc->frame_size;
+}
+
+static int encode(Worker *w, AVFormatContext *oc, AVFrame *frame)
+{
+    int ret = avcodec_send_frame(w->enc, frame);
+
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(w->enc, w->pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0)
+            return ret;
+        w->pkt->stream_index = 0;
+        av_packet_rescale_ts(w->pkt, w->enc->time_base, oc->streams[0]->time_base);
+        if ((ret = av_interleaved_write_frame(oc, w->pkt)) < 0)
+            return ret;
+    }
+    return ret;
+}
+
+/**
+ * Encode the samples waiting in the FIFO, in frames of the encoder frame
+ * size. The last frame of a file may be shorter.
+ */
+static int encode_fifo(Worker *w, AVFormatContext *oc, int flush)
+{
+    const int size = frame_size(w->enc);
+    int ret;
+
+    while (av_audio_fifo_size(w->fifo) >= size ||
+           (flush && av_audio_fifo_size(w->fifo) > 0)) {
+        AVFrame *frame = w->frame;
+
+        av_frame_unref(frame);
+        frame->nb_samples  = FFMIN(av_audio_fifo_size(w->fifo), size);
+        frame->format      = w->enc->sample_fmt;
+        frame->sample_rate = w->enc->sample_rate;
+        if ((ret = av_channel_layout_copy(&frame->ch_layout, &w->enc->ch_layout)) < 0 ||
+            (ret = av_frame_get_buffer(frame, 0)) < 0)
+            return ret;
+        if (av_audio_fifo_read(w->fifo, (void **)frame->data, frame->nb_samples) < frame->nb_samples)
+            return AVERROR_BUG;
+        frame->pts   = w->next_pts;
+        w->next_pts += frame->nb_samples;
+        if ((ret = encode(w, oc, frame)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+/**
+ * Resample a decoded frame, or flush the resampler if frame is NULL, and
+ * queue the result in the FIFO.
+ */
+static int convert(Worker *w, const AVFrame *frame)
+{
+    AVFrame *conv = w->conv;
+    int ret;
+
+    av_frame_unref(conv);
+    conv->format      = w->enc->sample_fmt;
+    conv->sample_rate = w->enc->sample_rate;
+    if ((ret = av_channel_layout_copy(&conv->ch_layout, &w->enc->ch_layout)) < 0)
+        return ret;
+    if ((ret = swr_convert_frame(w->swr, conv, frame)) < 0)
+        return ret;
+    if (conv->nb_samples &&
+        av_audio_fifo_write(w->fifo, (void **)conv->data, conv->nb_samples) < conv->nb_samples)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+static int decode(Worker *w, AVFormatContext *oc, const AVPacket *pkt)
+{
+    int ret = avcodec_send_packet(w->dec, pkt);
+
+    if (ret < 0 && ret != AVERROR_INVALIDDATA)
+        return ret;
+    for (;;) {
+        ret = avcodec_receive_frame(w->dec, w->frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0)
+            return ret;
+        ret = convert(w, w->frame);
+        av_frame_unref(w->frame);
+        if (ret < 0 || (ret = encode_fifo(w, oc, 0)) < 0)
+            return ret;
+    }
+}
+
+static int setup_resampler(Worker *w)
+{
+    int ret;
+
+    /* an existing context keeps its allocations, and its filter bank when
+     * the rates did not change */
+    ret = swr_alloc_set_opts2(&w->swr,
+                              &w->enc->ch_layout, w->enc->sample_fmt, w->enc->sample_rate,
+                              &w->dec->ch_layout, w->dec->sample_fmt, w->dec->sample_rate,
+                              0, NULL);
+    if (ret < 0)
+        return ret;
+    return swr_init(w->swr);
+}
+
+static int transcode(Worker *w, const Job *job)
+{
+    AVFormatContext *ic = NULL, *oc = NULL;
+    const AVStream *ist;
+    AVStream *ost;
+    int idx, ret;
+
+    if ((ret = avformat_open_input(&ic, job->input, NULL, NULL)) < 0) {
+        fprintf(stderr, "Could not open input file '%s': %s\n",
+                job->input, av_err2str(ret));
+        return ret;
+    }
+    if ((ret = avformat_find_stream_info(ic, NULL)) < 0)
+        goto end;
+    if ((ret = idx = av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0)) < 0) {
+        fprintf(stderr, "No audio stream in '%s'\n", job->input);
+        goto end;
+    }
+    ist = ic->streams[idx];
+
+    if ((ret = avformat_alloc_output_context2(&oc, NULL, NULL, job->output)) < 0)
+        goto end;
+    if ((ret = get_decoder(w, ist)) < 0 ||
+        (ret = get_encoder(w, w->dec, !!(oc->oformat->flags & AVFMT_GLOBALHEADER))) < 0 ||
+        (ret = setup_resampler(w)) < 0)
+        goto end;
+
+    if (w->fifo && (w->fifo_fmt != w->enc->sample_fmt ||
+                    w->fifo_channels != w->enc->ch_layout.nb_channels)) {
+        av_audio_fifo_free(w->fifo);
+        w->fifo = NULL;
+    }
+    if (w->fifo) {
+        av_audio_fifo_reset(w->fifo);
+    } else {
+        w->fifo_fmt      = w->enc->sample_fmt;
+        w->fifo_channels = w->enc->ch_layout.nb_channels;
+        w->fifo = av_audio_fifo_alloc(w->fifo_fmt, w->fifo_channels,
+                                      2 * frame_size(w->enc));
+    }
+    if (!w->fifo || !(ost = avformat_new_stream(oc, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ost->time_base = w->enc->time_base;
+    if ((ret = avcodec_parameters_from_context(ost->codecpar, w->enc)) < 0)
+        goto end;
+    av_dict_copy(&oc->metadata, ic->metadata, 0);
+    av_dict_copy(&ost->metadata, ist->metadata, 0);
+
+    if (!(oc->oformat->flags & AVFMT_NOFILE) &&
+        (ret = avio_open(&oc->pb, job->output, AVIO_FLAG_WRITE)) < 0) {
+        fprintf(stderr, "Could not open output file '%s': %s\n",
+                job->output, av_err2str(ret));
+        goto end;
+    }
+    if ((ret = avformat_write_header(oc, NULL)) < 0)
+        goto end;
+
+    w->next_pts = 0;
+    while ((ret = av_read_frame(ic, w->pkt)) >= 0) {
+        if (w->pkt->stream_index == idx)
+            ret = decode(w, oc, w->pkt);
+        av_packet_unref(w->pkt);
+        if (ret < 0)
+            goto end;
+    }
+    if (ret != AVERROR_EOF)
+        goto end;
+
+    /* drain the decoder, the resampler, the FIFO and the encoder */
+    if ((ret = decode(w, oc, NULL)) < 0 ||
+        (ret = convert(w, NULL)) < 0 ||
+        (ret = encode_fifo(w, oc, 1)) < 0 ||
+        (ret = encode(w, oc, NULL)) < 0)
+        goto end;
+    ret = av_write_trailer(oc);
+
+end:
+    if (ret < 0)
+        fprintf(stderr, "Failed to transcode '%s': %s\n", job->input, av_err2str(ret));
+    if (oc && !(oc->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    avformat_close_input(&ic);
+    return ret;
+}
+
+static void free_worker(Worker *w)
+{
+    avcodec_free_context(&w->dec);
+    avcodec_parameters_free(&w->dec_par);
+    avcodec_free_context(&w->enc);
+    swr_free(&w->swr);
+    if (w->fifo)
+        av_audio_fifo_free(w->fifo);
+    av_frame_free(&w->frame);
+    av_frame_free(&w->conv);
+    av_packet_free(&w->pkt);
+}
+
+static void *worker_thread(void *arg)
+{
+    Worker *w = arg;
+    Job *job;
+
+    while ((job = get_job())) {
+        int64_t start = av_gettime_relative();
+
+        if (transcode(w, job) < 0) {
+            pthread_mutex_lock(&job_lock);
+            nb_failed++;
+            pthread_mutex_unlock(&job_lock);
+            /* do not reuse contexts left in an unknown state */
+            avcodec_free_context(&w->dec);
+            avcodec_free_context(&w->enc);
+            continue;
+        }
+        printf("%s -> %s: %"PRId64" samples in %.3f s\n", job->input, job->output,
+               w->next_pts, (av_gettime_relative() - start) / 1000000.0);
+    }
+    return NULL;
+}
+
+static int read_playlist(const char *filename)
+{
+    char line[4096];
+    FILE *f = fopen(filename, "r");
+
+    if (!f) {
+        fprintf(stderr, "Could not open playlist '%s'\n", filename);
+        return AVERROR(errno);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char *tab;
+        Job *tmp;
+
+        line[strcspn(line, "\r\n")] = 0;
+        if (!*line || *line == '#')
+            continue;
+        if (!(tab = strchr(line, '\t'))) {
+            fprintf(stderr, "Ignoring playlist line without output: %s\n", line);
+            continue;
+        }
+        *tab = 0;
+        if (!(tmp = av_realloc_array(jobs, nb_jobs + 1, sizeof(*jobs))))
+            goto fail;
+        jobs = tmp;
+        jobs[nb_jobs].input  = av_strdup(line);
+        jobs[nb_jobs].output = av_strdup(tab + 1);
+        if (!jobs[nb_jobs++].output || !jobs[nb_jobs - 1].input)
+            goto fail;
+    }
+    fclose(f);
+    return 0;
+fail:
+    fclose(f);
+    return AVERROR(ENOMEM);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-j jobs] [-c encoder] [-b bitrate] playlist\n"
+            "Transcode the audio of the tab separated input/output file pairs "
+            "listed in playlist.\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *codec_name = "aac";
+    Worker *workers;
+    int nb_workers = 4, i, ret;
+    int64_t start;
+
+    for (i = 1; i < argc - 1; i += 2) {
+        if (!strcmp(argv[i], "-j"))
+            nb_workers = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-c"))
+            codec_name = argv[i + 1];
+        else if (!strcmp(argv[i], "-b"))
+            bit_rate = strtoll(argv[i + 1], NULL, 10);
+        else
+            break;
+    }
+    if (i != argc - 1 || nb_workers <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!(encoder = avcodec_find_encoder_by_name(codec_name)) ||
+        encoder->type != AVMEDIA_TYPE_AUDIO) {
+        fprintf(stderr, "Unknown audio encoder '%s'\n", codec_name);
+        return 1;
+    }
+    if ((ret = read_playlist(argv[i])) < 0)
+        return 1;
+    nb_workers = FFMIN(nb_workers, FFMAX(nb_jobs, 1));
+
+    if (!(workers = av_calloc(nb_workers, sizeof(*workers))))
+        return 1;
+    start = av_gettime_relative();
+    for (i = 0; i < nb_workers; i++) {
+        Worker *w = &workers[i];
+
+        w->dec_par = avcodec_parameters_alloc();
+        w->frame   = av_frame_alloc();
+        w->conv    = av_frame_alloc();
+        w->pkt     = av_packet_alloc();
+        if (!w->dec_par || !w->frame || !w->conv || !w->pkt ||
+            pthread_create(&w->thread, NULL, worker_thread, w)) {
+            fprintf(stderr, "Could not start worker %d\n", i);
+            free_worker(w);
+            nb_workers = i;
+            break;
+        }
+    }
+
+    for (i = 0; i < nb_workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+        printf("worker %d: %d decoder and %d encoder opens\n",
+               i, workers[i].nb_dec_opened, workers[i].nb_enc_opened);
+        free_worker(&workers[i]);
+    }
+    printf("%d files, %d failed, %.3f s\n", nb_jobs, nb_failed,
+           (av_gettime_relative() - start) / 1000000.0);
+
+    for (i = 0; i < nb_jobs; i++) {
+        av_freep(&jobs[i].input);
+        av_freep(&jobs[i].output);
+    }
+    av_freep(&jobs);
+    av_freep(&workers);
+    return nb_failed || !nb_workers;
+}
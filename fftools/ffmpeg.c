@@ -110,12 +110,6 @@ const int program_birth_year = 2000;
 
 FILE *vstats_file;
 
-typedef struct BenchmarkTimeStamps {
-    int64_t real_usec;
-    int64_t user_usec;
-    int64_t sys_usec;
-} BenchmarkTimeStamps;
-
 static BenchmarkTimeStamps get_benchmark_time_stamps(void);
 static int64_t getmaxrss(void);
 
@@ -184,6 +178,14 @@ static atomic_int transcode_init_done = ATOMIC_VAR_INIT(0);
 static volatile int ffmpeg_exited = 0;
 static int64_t copy_ts_first_pts = AV_NOPTS_VALUE;
 
+//PLEX
+/* When all outputs are audio, packets are fed in batches between the
+ * per-step bookkeeping (output selection, filter reaping, reports), and
+ * the sub2video heartbeat is skipped. */
+#define AUDIO_BATCH_PACKETS 8
+static int audio_only;
+//PLEX
+
 static void
 sigterm_handler(int sig)
 {
@@ -387,6 +389,8 @@ static void ffmpeg_cleanup(int ret)
 
     uninit_opts();
 
+    plex_uninit(); //PLEX
+
     avformat_network_deinit();
 
     if (received_sigterm) {
@@ -468,27 +472,151 @@ int check_avoptions(AVDictionary *m)
     return 0;
 }
 
-void update_benchmark(const char *fmt, ...)
+//PLEX
+static void benchmark_update(BenchmarkTimeStamps *last, const char *fmt, va_list va)
 {
     if (do_benchmark_all) {
         BenchmarkTimeStamps t = get_benchmark_time_stamps();
-        va_list va;
         char buf[1024];
 
         if (fmt) {
-            va_start(va, fmt);
             vsnprintf(buf, sizeof(buf), fmt, va);
-            va_end(va);
             av_log(NULL, AV_LOG_INFO,
                    "bench: %8" PRIu64 " user %8" PRIu64 " sys %8" PRIu64 " real %s \n",
-                   t.user_usec - current_time.user_usec,
-                   t.sys_usec - current_time.sys_usec,
-                   t.real_usec - current_time.real_usec, buf);
+                   t.user_usec - last->user_usec,
+                   t.sys_usec - last->sys_usec,
+                   t.real_usec - last->real_usec, buf);
         }
-        current_time = t;
+        *last = t;
+    }
+}
+
+void update_benchmark(const char *fmt, ...)
+{
+    va_list va;
+
+    va_start(va, fmt);
+    benchmark_update(&current_time, fmt, va);
+    va_end(va);
+}
+
+void update_benchmark_from(BenchmarkTimeStamps *last, const char *fmt, ...)
+{
+    va_list va;
+
+    va_start(va, fmt);
+    benchmark_update(last, fmt, va);
+    va_end(va);
+}
+//PLEX
+
+//PLEX
+#define MAX_STARTUP_STEPS 16
+
+static struct {
+    const char *step;
+    int64_t     time;
+} startup_steps[MAX_STARTUP_STEPS];
+static int nb_startup_steps, nb_startup_printed;
+static AVMutex startup_mutex = AV_MUTEX_INITIALIZER;
+static atomic_int startup_done;
+
+void startup_trace(const char *step)
+{
+    int64_t now;
+
+    if (atomic_load_explicit(&startup_done, memory_order_relaxed))
+        return;
+    now = av_gettime_relative();
+
+    ff_mutex_lock(&startup_mutex);
+    for (int i = 0; i < nb_startup_steps; i++)
+        if (!strcmp(startup_steps[i].step, step))
+            goto end;
+    if (nb_startup_steps < MAX_STARTUP_STEPS) {
+        startup_steps[nb_startup_steps].step = step;
+        startup_steps[nb_startup_steps].time = now;
+        nb_startup_steps++;
     }
+    // steps before option parsing are held until -benchmark is known
+    for (; do_benchmark && nb_startup_printed < nb_startup_steps; nb_startup_printed++)
+        av_log(NULL, AV_LOG_INFO, "startup: %8.3f ms %s\n",
+               (startup_steps[nb_startup_printed].time - startup_steps[0].time) / 1000.0,
+               startup_steps[nb_startup_printed].step);
+    if (!strcmp(step, "first packet muxed"))
+        atomic_store(&startup_done, 1);
+end:
+    ff_mutex_unlock(&startup_mutex);
 }
 
+static atomic_int_least64_t buffered_size, buffered_peak;
+static atomic_int buffer_waiters;
+static AVMutex buffer_mutex = AV_MUTEX_INITIALIZER;
+static pthread_cond_t buffer_cond = PTHREAD_COND_INITIALIZER;
+
+void buffer_account(int64_t size)
+{
+    int64_t cur = atomic_fetch_add(&buffered_size, size) + size;
+
+    if (size > 0) {
+        int64_t peak = atomic_load_explicit(&buffered_peak, memory_order_relaxed);
+        while (cur > peak &&
+               !atomic_compare_exchange_weak_explicit(&buffered_peak, &peak, cur,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            ;
+    } else if (atomic_load(&buffer_waiters)) {
+        /* also on empty packets leaving, a demuxer may wait for its queue
+         * to drain */
+        ff_mutex_lock(&buffer_mutex);
+        pthread_cond_broadcast(&buffer_cond);
+        ff_mutex_unlock(&buffer_mutex);
+    }
+}
+
+void buffer_account_packet(const void *obj, int dir)
+{
+    const AVPacket *pkt = obj;
+
+    buffer_account(dir * (int64_t)pkt->size);
+}
+
+void buffer_account_frame(const void *obj, int dir)
+{
+    const AVFrame *frame = obj;
+    int64_t size = 0;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+        size += frame->buf[i]->size;
+    for (int i = 0; i < frame->nb_extended_buf; i++)
+        size += frame->extended_buf[i]->size;
+
+    buffer_account(dir * size);
+}
+
+void buffer_stats(int64_t *cur, int64_t *peak)
+{
+    *cur  = atomic_load(&buffered_size);
+    *peak = atomic_load(&buffered_peak);
+}
+
+void buffer_wait(int (*busy)(void *opaque), void *opaque)
+{
+    if (max_buffered_size <= 0 ||
+        atomic_load(&buffered_size) <= max_buffered_size)
+        return;
+
+    ff_mutex_lock(&buffer_mutex);
+    /* announce the wait before checking, so that every release after the
+     * check sees it and wakes us up */
+    atomic_fetch_add(&buffer_waiters, 1);
+    while (atomic_load(&buffered_size) > max_buffered_size && busy(opaque))
+        pthread_cond_wait(&buffer_cond, &buffer_mutex);
+    atomic_fetch_sub(&buffer_waiters, 1);
+    ff_mutex_unlock(&buffer_mutex);
+}
+//PLEX
+
 void close_output_stream(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
@@ -509,14 +637,18 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     static int64_t last_time = -1;
     static int first_report = 1;
     uint64_t nb_frames_dup = 0, nb_frames_drop = 0;
+    int64_t comp_soft = 0, comp_inserted = 0, comp_dropped = 0; //PLEX
     int mins, secs, us;
     int64_t hours;
     const char *hours_sign;
     int ret;
     float t;
 
-    if (!print_stats && !is_last_report && !progress_avio)
+    //PLEX
+    int64_t run_time = 0;
+    if (!print_stats && !is_last_report && !progress_avio && !plexContext.progress_url)
         return;
+    //PLEX
 
     if (!is_last_report) {
         if (last_time == -1) {
@@ -525,6 +657,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         if (((cur_time - last_time) < stats_period && !first_report) ||
             (first_report && nb_output_dumped < nb_output_files))
             return;
+        run_time = cur_time - last_time; //PLEX
         last_time = cur_time;
     }
 
@@ -560,6 +693,20 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
             vid = 1;
         }
+        //PLEX
+        if (ost->type == AVMEDIA_TYPE_VIDEO) {
+            EncQualityStats qs;
+
+            if (enc_quality_stats(ost, &qs) >= 0 && qs.nb_samples)
+                av_bprintf(&buf_script, "stream_%d_%d_ssim=%.5f\n",
+                           ost->file_index, ost->index, qs.ssim);
+        }
+        if (ost->type == AVMEDIA_TYPE_AUDIO && ost->filter) {
+            comp_soft     += ost->filter->nb_samples_comp_soft;
+            comp_inserted += ost->filter->nb_samples_comp_inserted;
+            comp_dropped  += ost->filter->nb_samples_comp_dropped;
+        }
+        //PLEX
         /* compute min output value */
         if (ost->last_mux_dts != AV_NOPTS_VALUE) {
             if (pts == AV_NOPTS_VALUE || ost->last_mux_dts > pts)
@@ -573,6 +720,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         }
     }
 
+    plex_report_stats(pts, total_size, run_time); //PLEX
+
     us    = FFABS64U(pts) % AV_TIME_BASE;
     secs  = FFABS64U(pts) / AV_TIME_BASE % 60;
     mins  = FFABS64U(pts) / AV_TIME_BASE / 60 % 60;
@@ -616,6 +765,14 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         av_bprintf(&buf, " dup=%"PRId64" drop=%"PRId64, nb_frames_dup, nb_frames_drop);
     av_bprintf(&buf_script, "dup_frames=%"PRId64"\n", nb_frames_dup);
     av_bprintf(&buf_script, "drop_frames=%"PRId64"\n", nb_frames_drop);
+    //PLEX
+    if (comp_soft || comp_inserted || comp_dropped) {
+        av_bprintf(&buf, " acomp=%"PRId64"/%"PRId64"/%"PRId64, comp_soft, comp_inserted, comp_dropped);
+        av_bprintf(&buf_script, "audio_comp_soft_samples=%"PRId64"\n", comp_soft);
+        av_bprintf(&buf_script, "audio_comp_inserted_samples=%"PRId64"\n", comp_inserted);
+        av_bprintf(&buf_script, "audio_comp_dropped_samples=%"PRId64"\n", comp_dropped);
+    }
+    //PLEX
 
     if (speed < 0) {
         av_bprintf(&buf, " speed=N/A");
@@ -650,6 +807,13 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         }
     }
 
+    //PLEX
+    if (is_last_report) {
+        plex_log_mem_usage();
+        plex_log_thread_stats();
+    }
+    //PLEX
+
     first_report = 0;
 }
 
@@ -1053,6 +1217,72 @@ static void decode_flush(InputFile *ifile)
     }
 }
 
+//PLEX
+/*
+ * Seek the inputs to ts and start the outputs over, the way a new transcode
+ * started with -ss ts would, but keeping the open decoders and encoders.
+ * Requests that cannot be honoured are ignored with a warning.
+ */
+static int transcode_seek(int64_t ts, int segment)
+{
+    int nb_seeked = 0, ret;
+
+    for (int i = 0; i < nb_input_files; i++) {
+        if (input_files[i]->eof_reached) {
+            av_log(NULL, AV_LOG_WARNING, "Input #%d was read to the end, "
+                   "ignoring the seek request\n", i);
+            return 0;
+        }
+    }
+    for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
+        if (ost->finished) {
+            av_log(ost, AV_LOG_WARNING, "Stream is finished, "
+                   "ignoring the seek request\n");
+            return 0;
+        }
+    }
+    for (int i = 0; i < nb_output_files; i++) {
+        if (of_restart_query(output_files[i]) < 0) {
+            av_log(NULL, AV_LOG_WARNING, "Output #%d cannot be restarted, "
+                   "ignoring the seek request\n", i);
+            return 0;
+        }
+    }
+
+    av_log(NULL, AV_LOG_INFO, "Seeking to %s, segment %d\n",
+           av_ts2timestr(ts, &AV_TIME_BASE_Q), segment);
+
+    for (int i = 0; i < nb_input_files; i++) {
+        if (ifile_seek(input_files[i], ts) < 0)
+            continue;
+        decode_flush(input_files[i]);
+        nb_seeked++;
+    }
+    if (!nb_seeked)
+        return 0;
+
+    for (int i = 0; i < nb_filtergraphs; i++)
+        fg_seek_reset(filtergraphs[i]);
+
+    for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
+        if (ost->enc && (ret = enc_seek_flush(ost)) < 0)
+            return ret;
+    }
+
+    for (int i = 0; i < nb_output_files; i++) {
+        ret = of_restart(output_files[i], segment);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error restarting output #%d: %s\n",
+                   i, av_err2str(ret));
+            return ret;
+        }
+    }
+
+    reset_eagain();
+    return 0;
+}
+//PLEX
+
 /*
  * Return
  * - 0 -- one packet was read and processed
@@ -1065,6 +1295,7 @@ static int process_input(int file_index)
     InputFile *ifile = input_files[file_index];
     InputStream *ist;
     AVPacket *pkt;
+    int64_t ts; //PLEX
     int ret, i;
 
     ret = ifile_get_packet(ifile, &pkt);
@@ -1120,17 +1351,22 @@ static int process_input(int file_index)
 
     ist = ifile->streams[pkt->stream_index];
 
-    sub2video_heartbeat(ifile, pkt->pts, pkt->time_base);
+    if (!audio_only) //PLEX
+        sub2video_heartbeat(ifile, pkt->pts, pkt->time_base);
+
+    //PLEX
+    ts = pkt->dts != AV_NOPTS_VALUE ?
+         av_rescale_q(pkt->dts, pkt->time_base, AV_TIME_BASE_Q) : AV_NOPTS_VALUE;
+    //PLEX
 
     ret = process_input_packet(ist, pkt, 0);
 
 //PLEX
-    // Delay if needed.
-    if (plexContext.throttle_delay > 0)
-      usleep(1000*plexContext.throttle_delay);
+    // Pace the transcode if the server allows it.
+    plex_throttle(ts);
 //PLEX
 
-    av_packet_free(&pkt);
+    ifile_packet_release(ifile, &pkt); //PLEX
 
     return ret < 0 ? ret : 0;
 }
@@ -1165,6 +1401,16 @@ static int transcode_step(OutputStream *ost)
     if (ret < 0)
         return ret == AVERROR_EOF ? 0 : ret;
 
+    //PLEX
+    for (int i = 1; audio_only && i < AUDIO_BATCH_PACKETS; i++) {
+        ret = process_input(ist->file_index);
+        if (ret == AVERROR(EAGAIN))
+            break;
+        if (ret < 0)
+            return ret == AVERROR_EOF ? 0 : ret;
+    }
+    //PLEX
+
     // process_input() above might have caused output to become available
     // in multiple filtergraphs, so we process all of them
     for (int i = 0; i < nb_filtergraphs; i++) {
@@ -1205,6 +1451,13 @@ static int transcode(int *err_rate_exceeded)
 
     print_stream_maps();
 
+    //PLEX
+    audio_only = 1;
+    for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost))
+        if (ost->type != AVMEDIA_TYPE_AUDIO)
+            audio_only = 0;
+    //PLEX
+
     *err_rate_exceeded = 0;
     atomic_store(&transcode_init_done, 1);
 
@@ -1217,12 +1470,22 @@ static int transcode(int *err_rate_exceeded)
     while (!received_sigterm) {
         OutputStream *ost;
         int64_t cur_time= av_gettime_relative();
+        int64_t seek_ts; //PLEX
+        int seek_segment; //PLEX
 
         /* if 'q' pressed, exits */
         if (stdin_interaction)
             if (check_keyboard_interaction(cur_time) < 0)
                 break;
 
+        //PLEX
+        if (plex_seek_take(&seek_ts, &seek_segment)) {
+            ret = transcode_seek(seek_ts, seek_segment);
+            if (ret < 0)
+                break;
+        }
+        //PLEX
+
         ret = choose_output(&ost);
         if (ret == AVERROR(EAGAIN)) {
             reset_eagain();
@@ -1330,6 +1593,8 @@ int main(int argc, char **argv)
     int ret, err_rate_exceeded;
     BenchmarkTimeStamps ti;
 
+    startup_trace("start"); //PLEX
+
     init_dynload();
 
     setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
@@ -1344,6 +1609,7 @@ int main(int argc, char **argv)
     avdevice_register_all();
 #endif
     avformat_network_init();
+    startup_trace("libraries initialized"); //PLEX
 
     show_banner(argc, argv, options);
 
@@ -1352,6 +1618,12 @@ int main(int argc, char **argv)
     if (ret < 0)
         goto finish;
 
+    //PLEX
+    startup_trace("input and output files opened");
+    if (!do_benchmark)
+        atomic_store(&startup_done, 1);
+    //PLEX
+
     if (nb_output_files <= 0 && nb_input_files == 0) {
         show_usage();
         av_log(NULL, AV_LOG_WARNING, "Use -h to get full help or, even better, run 'man %s'\n", program_name);
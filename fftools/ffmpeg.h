@@ -270,6 +270,12 @@ typedef struct OptionsContext {
     // PLEX
     SpecifierOpt *hwaccel_fallback_thresholds;
     int        nb_hwaccel_fallback_thresholds;
+    SpecifierOpt *hwaccel_fallback_replays;
+    int        nb_hwaccel_fallback_replays;
+    SpecifierOpt *quality_samples;
+    int        nb_quality_samples;
+    int64_t keyframe_interval;
+    int copy_direct;
     // PLEX
 
     SpecifierOpt *autoscale;
@@ -311,6 +317,11 @@ typedef struct OutputFilter {
 
     uint64_t nb_frames_dup;
     uint64_t nb_frames_drop;
+
+    //PLEX: audio timestamp compensation totals reported by aresample
+    int64_t nb_samples_comp_soft;
+    int64_t nb_samples_comp_inserted;
+    int64_t nb_samples_comp_dropped;
 } OutputFilter;
 
 typedef struct FilterGraph {
@@ -397,10 +408,11 @@ typedef struct InputStream {
     uint64_t decode_errors;
 
     // PLEX
-    int hwaccel_active;             // whether hwdec was initialized
+    atomic_int hwaccel_active;      // whether hwdec was initialized, read by the main thread
     int hwaccel_blocked;            // if set, don't try to use hwaccel
     int hwaccel_error_counter;      // current error counter for fallback
     int hwaccel_fallback_threshold; // after how many errors to start fallback
+    int hwaccel_fallback_replay;    // re-decode the packets since the last keyframe on fallback
 } InputStream;
 
 typedef struct LastFrameDuration {
@@ -519,6 +531,13 @@ typedef struct KeyframeForceCtx {
     double       expr_const_values[FKF_NB];
 
     int          dropped_keyframe;
+
+    //PLEX
+    // segment duration advertised by the muxer, in AV_TIME_BASE_Q
+    int64_t      segment_duration;
+    // start of the next segment, in AV_TIME_BASE_Q
+    int64_t      segment_next;
+    //PLEX
 } KeyframeForceCtx;
 
 typedef struct Encoder Encoder;
@@ -622,6 +641,13 @@ typedef struct OutputStream {
      * subtitles utilizing fix_sub_duration at random access points.
      */
     unsigned int fix_sub_duration_heartbeat;
+
+    //PLEX
+    // compare 1 in quality_sample frames with the encoder's reconstruction
+    int quality_sample;
+    // the scores are averaged over segments of this duration, in AV_TIME_BASE_Q
+    int64_t quality_segment;
+    //PLEX
 } OutputStream;
 
 typedef struct OutputFile {
@@ -699,6 +725,7 @@ extern int auto_conversion_filters;
 
 //PLEX
 extern int exit_on_io_error;
+extern int64_t max_buffered_size;
 //PLEX
 
 extern const AVIOInterruptCB int_cb;
@@ -793,6 +820,14 @@ void fg_send_command(FilterGraph *fg, double time, const char *target,
  */
 int reap_filters(FilterGraph *fg, int flush);
 
+//PLEX
+/**
+ * Drop the filtergraph and everything queued in it after its inputs were
+ * seeked. It is configured again from the next frame sent to it.
+ */
+void fg_seek_reset(FilterGraph *fg);
+//PLEX
+
 int ffmpeg_parse_options(int argc, char **argv);
 
 void enc_stats_write(OutputStream *ost, EncStats *es,
@@ -837,6 +872,29 @@ int enc_open(OutputStream *ost, const AVFrame *frame);
 int enc_subtitle(OutputFile *of, OutputStream *ost, const AVSubtitle *sub);
 int enc_frame(OutputStream *ost, AVFrame *frame);
 int enc_flush(void);
+//PLEX
+/**
+ * Reset the encoder after its input was seeked, dropping everything it has
+ * queued. Encoders without AV_CODEC_CAP_ENCODER_FLUSH keep their state.
+ */
+int enc_seek_flush(OutputStream *ost);
+
+typedef struct EncQualityStats {
+    uint64_t nb_samples;        ///< frames compared since the start
+    double   ssim;              ///< their mean SSIM
+    int64_t  segment;           ///< index of the last complete segment, -1 if none yet
+    double   segment_ssim;      ///< mean SSIM of that segment
+    int      segment_samples;   ///< frames compared in that segment
+} EncQualityStats;
+
+/**
+ * Get the scores of the sampled frames of a stream encoded with
+ * -quality_sample. Safe to call while the encoder thread runs.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the stream is not sampled
+ */
+int enc_quality_stats(const OutputStream *ost, EncQualityStats *st);
+//PLEX
 
 /*
  * Initialize muxing state for the given stream, should be called
@@ -860,6 +918,19 @@ int of_streamcopy(OutputStream *ost, const AVPacket *pkt, int64_t dts);
 
 int64_t of_filesize(OutputFile *of);
 
+//PLEX
+/**
+ * @return 0 if of_restart() is supported for this output, a negative error
+ *         code otherwise
+ */
+int of_restart_query(OutputFile *of);
+/**
+ * Restart the output timeline after a seek, continuing at the given segment
+ * number for segmenting muxers, if not negative.
+ */
+int of_restart(OutputFile *of, int segment);
+//PLEX
+
 int ifile_open(const OptionsContext *o, const char *filename);
 void ifile_close(InputFile **f);
 
@@ -874,9 +945,25 @@ void ifile_close(InputFile **f);
  * - a negative error code on failure
  */
 int ifile_get_packet(InputFile *f, AVPacket **pkt);
+//PLEX
+/* Return a packet from ifile_get_packet() for reuse. */
+void ifile_packet_release(InputFile *f, AVPacket **pkt);
+//PLEX
+
+//PLEX
+/**
+ * Seek the input to timestamp, as if it had been opened with -ss timestamp.
+ * The demuxer thread is stopped and packets that were read ahead are lost;
+ * the caller has to flush the decoders.
+ */
+int ifile_seek(InputFile *f, int64_t timestamp);
+//PLEX
 
 int ist_output_add(InputStream *ist, OutputStream *ost);
 int ist_filter_add(InputStream *ist, InputFilter *ifilter, int is_simple);
+//PLEX
+int ist_burn_in_add(InputStream *ist);
+//PLEX
 
 /**
  * Find an unused input stream of given type.
@@ -895,6 +982,52 @@ void close_output_stream(OutputStream *ost);
 int trigger_fix_sub_duration_heartbeat(OutputStream *ost, const AVPacket *pkt);
 int fix_sub_duration_heartbeat(InputStream *ist, int64_t signal_pts);
 void update_benchmark(const char *fmt, ...);
+//PLEX
+typedef struct BenchmarkTimeStamps {
+    int64_t real_usec;
+    int64_t user_usec;
+    int64_t sys_usec;
+} BenchmarkTimeStamps;
+
+/**
+ * Like update_benchmark(), but measuring from and updating *last instead of
+ * the main thread's timestamps, for use in decoder and encoder threads.
+ */
+void update_benchmark_from(BenchmarkTimeStamps *last, const char *fmt, ...);
+
+/**
+ * Record the first time a startup step is reached, from any thread. With
+ * -benchmark the steps are printed with their offset from process start;
+ * tracing ends with the first muxed packet.
+ */
+void startup_trace(const char *step);
+
+/**
+ * Account the packet and frame data entering (size > 0) or leaving (size < 0)
+ * the queues between the pipeline stages, from any thread. All the queues
+ * draw from the one -max_buffered_size budget.
+ */
+void buffer_account(int64_t size);
+
+/**
+ * tq_set_account() callbacks for queues of packets and of frames.
+ */
+void buffer_account_packet(const void *pkt, int dir);
+void buffer_account_frame(const void *frame, int dir);
+
+/**
+ * Get the data currently queued and the most that was, in bytes.
+ */
+void buffer_stats(int64_t *cur, int64_t *peak);
+
+/**
+ * Block while the queued data exceeds the budget and busy(opaque) is
+ * nonzero. This is the backpressure applied to the demuxers, busy() tells
+ * whether their consumer still has data to work on, so they never wait for
+ * queues that cannot drain without more input.
+ */
+void buffer_wait(int (*busy)(void *opaque), void *opaque);
+//PLEX
 
 /**
  * Merge two return codes - return one of the error codes if at least one of
@@ -19,9 +19,11 @@
 #include "libavutil/avassert.h"
 #include "libavutil/dict.h"
 #include "libavutil/error.h"
+#include "libavutil/fifo.h"
 #include "libavutil/log.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/time.h"
 #include "libavutil/timestamp.h"
 
 #include "libavcodec/avcodec.h"
@@ -32,6 +34,10 @@
 #include "ffmpeg.h"
 #include "thread_queue.h"
 
+//PLEX
+#include "plex.h"
+//PLEX
+
 struct Decoder {
     AVFrame         *frame;
     AVPacket        *pkt;
@@ -51,6 +57,18 @@ struct Decoder {
     AVFrame *sub_prev[2];
     AVFrame *sub_heartbeat;
 
+    //PLEX
+    // packets since the last keyframe, re-decoded in software on hwaccel fallback
+    AVFifo         *replay;
+    int             replay_skip;    // not buffering until the next keyframe
+    int             replaying;
+    int             replay_pending; // fell back to software, replay is due
+    // -benchmark_all timestamps of the decoder thread
+    BenchmarkTimeStamps bench;
+    // best effort timestamp of the last video frame that was output
+    int64_t         replay_pts;
+    //PLEX
+
     pthread_t       thread;
     /**
      * Queue for sending coded packets from the main thread to
@@ -110,6 +128,15 @@ void dec_free(Decoder **pdec)
         av_frame_free(&dec->sub_prev[i]);
     av_frame_free(&dec->sub_heartbeat);
 
+    //PLEX
+    if (dec->replay) {
+        AVPacket *pkt;
+        while (av_fifo_read(dec->replay, &pkt, 1) >= 0)
+            av_packet_free(&pkt);
+        av_fifo_freep2(&dec->replay);
+    }
+    //PLEX
+
     av_freep(pdec);
 }
 
@@ -135,6 +162,8 @@ static int dec_alloc(Decoder **pdec)
     dec->last_frame_pts               = AV_NOPTS_VALUE;
     dec->last_frame_tb                = (AVRational){ 1, 1 };
     dec->hwaccel_pix_fmt              = AV_PIX_FMT_NONE;
+    dec->replay_skip                  = 1; //PLEX
+    dec->replay_pts                   = AV_NOPTS_VALUE; //PLEX
 
     *pdec = dec;
 
@@ -425,6 +454,12 @@ static int process_subtitle(InputStream *ist, AVFrame *frame)
     if (!subtitle)
         return 0;
 
+    //PLEX
+    ret = plex_process_subtitles(ist, (AVSubtitle*)subtitle);
+    if (ret < 0)
+        return ret;
+    //PLEX
+
     for (int i = 0; i < ist->nb_filters; i++) {
         ret = ifilter_sub2video(ist->filters[i], frame);
         if (ret < 0) {
@@ -540,12 +575,56 @@ static int send_filter_eof(InputStream *ist)
     return 0;
 }
 
+//PLEX
+#define REPLAY_MAX_PACKETS 1024
+
+static void replay_reset(Decoder *d)
+{
+    AVPacket *pkt;
+
+    while (d->replay && av_fifo_read(d->replay, &pkt, 1) >= 0)
+        av_packet_free(&pkt);
+    d->replay_skip = 1;
+}
+
+static int replay_add(Decoder *d, const AVPacket *pkt)
+{
+    AVPacket *p;
+
+    if (!d->replay) {
+        d->replay = av_fifo_alloc2(64, sizeof(AVPacket*), AV_FIFO_FLAG_AUTO_GROW);
+        if (!d->replay)
+            return AVERROR(ENOMEM);
+        av_fifo_auto_grow_limit(d->replay, REPLAY_MAX_PACKETS);
+    }
+
+    if (pkt->flags & AV_PKT_FLAG_KEY) {
+        replay_reset(d);
+        d->replay_skip = 0;
+    }
+    if (d->replay_skip)
+        return 0;
+
+    p = av_packet_clone(pkt);
+    if (!p)
+        return AVERROR(ENOMEM);
+    // the GOP is too long to keep, fall back the old way this time
+    if (av_fifo_write(d->replay, &p, 1) < 0) {
+        av_packet_free(&p);
+        replay_reset(d);
+    }
+    return 0;
+}
+
+//PLEX
+
 static int packet_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
 {
     const InputFile *ifile = input_files[ist->file_index];
     Decoder *d = ist->decoder;
     AVCodecContext *dec = ist->dec_ctx;
     const char *type_desc = av_get_media_type_string(dec->codec_type);
+    PlexStageTimer timer; //PLEX
     int ret;
 
     if (dec->codec_type == AVMEDIA_TYPE_SUBTITLE)
@@ -562,7 +641,21 @@ static int packet_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
         pkt->dts = AV_NOPTS_VALUE;
     }
 
+    //PLEX
+    if (pkt && dec->codec_type == AVMEDIA_TYPE_VIDEO && !d->replaying) {
+        atomic_fetch_add(&plexContext.packets_in, 1);
+        if (ist->hwaccel_fallback_replay && ist->hwaccel_id != HWACCEL_NONE &&
+            !ist->hwaccel_blocked) {
+            ret = replay_add(d, pkt);
+            if (ret < 0)
+                return ret;
+        }
+    }
+    plex_stage_start(&timer);
+    //PLEX
+
     ret = avcodec_send_packet(dec, pkt);
+    plex_stage_end(PLEX_STAGE_DECODE, &timer); //PLEX
     if (ret < 0 && !(ret == AVERROR_EOF && !pkt)) {
         // In particular, we don't expect AVERROR(EAGAIN), because we read all
         // decoded frames with avcodec_receive_frame() until done.
@@ -576,6 +669,13 @@ static int packet_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
 
         if (ret != AVERROR_EOF) {
             ist->decode_errors++;
+            //PLEX
+            if (dec->codec_type == AVMEDIA_TYPE_VIDEO &&
+                plex_decode_result(ist, NULL, ret)) {
+                d->replay_pending = 1;
+                return 0;
+            }
+            //PLEX
             if (!exit_on_error)
                 ret = 0;
         }
@@ -588,10 +688,14 @@ static int packet_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
 
         av_frame_unref(frame);
 
-        update_benchmark(NULL);
+        update_benchmark_from(&d->bench, NULL); //PLEX
+        plex_stage_start(&timer); //PLEX
         ret = avcodec_receive_frame(dec, frame);
-        update_benchmark("decode_%s %d.%d", type_desc,
-                         ist->file_index, ist->index);
+        plex_stage_end(PLEX_STAGE_DECODE, &timer); //PLEX
+        update_benchmark_from(&d->bench, "decode_%s %d.%d", type_desc, //PLEX
+                              ist->file_index, ist->index);
+        if (ret >= 0)
+            startup_trace("first frame decoded"); //PLEX
 
         if (ret == AVERROR(EAGAIN)) {
             av_assert0(pkt); // should never happen during flushing
@@ -602,6 +706,14 @@ static int packet_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
             av_log(ist, AV_LOG_ERROR, "Decoding error: %s\n", av_err2str(ret));
             ist->decode_errors++;
 
+            //PLEX
+            if (dec->codec_type == AVMEDIA_TYPE_VIDEO &&
+                plex_decode_result(ist, NULL, ret)) {
+                d->replay_pending = 1;
+                return 0;
+            }
+            //PLEX
+
             if (exit_on_error)
                 return ret;
 
@@ -615,6 +727,16 @@ static int packet_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
                 return AVERROR_INVALIDDATA;
         }
 
+        //PLEX
+        if (dec->codec_type == AVMEDIA_TYPE_VIDEO) {
+            int64_t ts = frame->best_effort_timestamp;
+            if (d->replaying && ts != AV_NOPTS_VALUE &&
+                d->replay_pts != AV_NOPTS_VALUE && ts <= d->replay_pts)
+                continue;
+            if (ts != AV_NOPTS_VALUE)
+                d->replay_pts = ts;
+        }
+        //PLEX
 
         av_assert0(!frame->opaque_ref);
         fd      = frame_data(frame);
@@ -635,6 +757,8 @@ static int packet_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
 
             audio_ts_process(ist, ist->decoder, frame);
         } else {
+            plex_decode_result(ist, frame, 0); //PLEX
+
             ret = video_frame_process(ist, frame);
             if (ret < 0) {
                 av_log(NULL, AV_LOG_FATAL, "Error while processing the decoded "
@@ -651,6 +775,52 @@ static int packet_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
     }
 }
 
+//PLEX
+/* Decode a packet and, when that made the decoder fall back to software,
+ * decode the packets since the last keyframe again, so that output continues
+ * without waiting for the next keyframe. Frames that were already output are
+ * dropped by packet_decode(). */
+static int replay_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
+{
+    Decoder *d = ist->decoder;
+    int64_t start, elapsed;
+    AVPacket *p;
+    int ret, nb_packets = 0;
+
+    ret = packet_decode(ist, pkt, frame);
+    if (!d->replay_pending)
+        return ret;
+    d->replay_pending = 0;
+
+    start = av_gettime_relative();
+    d->replaying = 1;
+    while (!d->replay_skip && av_fifo_read(d->replay, &p, 1) >= 0) {
+        ret = packet_decode(ist, p, frame);
+        av_packet_free(&p);
+        nb_packets++;
+        if (ret < 0)
+            break;
+    }
+    d->replaying = 0;
+    replay_reset(d);
+    if (ret < 0) {
+        av_log(ist, AV_LOG_ERROR, "Error decoding packets again in software: %s\n",
+               av_err2str(ret));
+        return ret;
+    }
+
+    if (nb_packets) {
+        elapsed = (av_gettime_relative() - start) / 1000;
+        av_log(ist, AV_LOG_INFO, "Decoded %d packets again in software in %"PRId64" ms\n",
+               nb_packets, elapsed);
+        atomic_store(&plexContext.hwaccel_fallback_ms, FFMAX(elapsed, 1));
+    }
+
+    // keep draining if the fallback happened while flushing
+    return pkt ? 0 : packet_decode(ist, NULL, frame);
+}
+//PLEX
+
 static void dec_thread_set_name(const InputStream *ist)
 {
     char name[16];
@@ -709,7 +879,7 @@ static void *decoder_thread(void *arg)
             av_log(ist, AV_LOG_VERBOSE, "Decoder thread received %s packet\n",
                    flush_buffers ? "flush" : "EOF");
 
-        ret = packet_decode(ist, dt.pkt->buf ? dt.pkt : NULL, dt.frame);
+        ret = replay_decode(ist, dt.pkt->buf ? dt.pkt : NULL, dt.frame); //PLEX
 
         av_packet_unref(dt.pkt);
         av_frame_unref(dt.frame);
@@ -734,6 +904,10 @@ static void *decoder_thread(void *arg)
             }
 
             avcodec_flush_buffers(ist->dec_ctx);
+            //PLEX
+            replay_reset(d);
+            d->replay_pts = AV_NOPTS_VALUE;
+            //PLEX
         } else if (ret < 0) {
             av_log(ist, AV_LOG_ERROR, "Error processing packet in decoder: %s\n",
                    av_err2str(ret));
@@ -778,6 +952,16 @@ int dec_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
     if (!d->queue_in)
         return AVERROR_EOF;
 
+    //PLEX
+    /* with skip_frame=nokey only keyframes are decoded, so do not hand the
+     * decoder (or the hwaccel behind it) the other packets at all; they may
+     * still be streamcopied to another output from the same input */
+    if (pkt && !(pkt->flags & AV_PKT_FLAG_KEY) &&
+        ist->dec->type == AVMEDIA_TYPE_VIDEO &&
+        ist->dec_ctx->skip_frame >= AVDISCARD_NONKEY)
+        return 0;
+    //PLEX
+
     // send the packet/flush request/EOF to the decoder thread
     if (pkt || no_eof) {
         av_packet_unref(d->pkt);
@@ -857,6 +1041,7 @@ static int dec_thread_start(InputStream *ist)
         objpool_free(&op);
         return AVERROR(ENOMEM);
     }
+    tq_set_account(d->queue_in, buffer_account_packet); //PLEX
 
     op = objpool_alloc_frames();
     if (!op)
@@ -867,6 +1052,7 @@ static int dec_thread_start(InputStream *ist)
         objpool_free(&op);
         goto fail;
     }
+    tq_set_account(d->queue_out, buffer_account_frame); //PLEX
 
     ret = pthread_create(&d->thread, NULL, decoder_thread, ist);
     if (ret) {
@@ -892,6 +1078,8 @@ static enum AVPixelFormat get_format(AVCodecContext *s, const enum AVPixelFormat
     Decoder       *d = ist->decoder;
     const enum AVPixelFormat *p;
 
+    atomic_store(&ist->hwaccel_active, 0); //PLEX
+
     for (p = pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
         const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(*p);
         const AVCodecHWConfig  *config = NULL;
@@ -900,6 +1088,11 @@ static enum AVPixelFormat get_format(AVCodecContext *s, const enum AVPixelFormat
         if (!(desc->flags & AV_PIX_FMT_FLAG_HWACCEL))
             break;
 
+//PLEX
+        if (ist->hwaccel_blocked)
+            continue;
+//PLEX
+
         if (ist->hwaccel_id == HWACCEL_GENERIC ||
             ist->hwaccel_id == HWACCEL_AUTO) {
             for (i = 0;; i++) {
@@ -915,6 +1108,7 @@ static enum AVPixelFormat get_format(AVCodecContext *s, const enum AVPixelFormat
         }
         if (config && config->device_type == ist->hwaccel_device_type) {
             d->hwaccel_pix_fmt = *p;
+            atomic_store(&ist->hwaccel_active, 1); //PLEX
             break;
         }
     }
@@ -1129,6 +1323,7 @@ int dec_open(InputStream *ist)
                av_err2str(ret));
         return ret;
     }
+    startup_trace("decoder opened"); //PLEX
 
     ret = check_avoptions(ist->decoder_opts);
     if (ret < 0)
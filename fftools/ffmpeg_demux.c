@@ -20,6 +20,10 @@
 #include <stdint.h>
 
 #include "ffmpeg.h"
+//PLEX
+#include "objpool.h"
+#include "plex.h"
+//PLEX
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
@@ -52,6 +56,11 @@ static const char *const opt_name_display_rotations[]         = {"display_rotati
 static const char *const opt_name_display_hflips[]            = {"display_hflip", NULL};
 static const char *const opt_name_display_vflips[]            = {"display_vflip", NULL};
 
+//PLEX
+static const char *const opt_name_hwaccel_fallback_thresholds[] = {"hwaccel_fallback_threshold", NULL};
+static const char *const opt_name_hwaccel_fallback_replays[]    = {"hwaccel_fallback_replay", NULL};
+//PLEX
+
 typedef struct DemuxStream {
     InputStream ist;
 
@@ -115,6 +124,22 @@ typedef struct Demuxer {
     int                   non_blocking;
 
     int                   read_started;
+
+    //PLEX
+    /* packets sent to the main thread, recycled by ifile_packet_release() */
+    ObjPool              *pkt_pool;
+    pthread_mutex_t       pkt_pool_lock;
+    //PLEX
+
+    //PLEX
+    /* keyframe seeking, with -keyframe_interval */
+    int64_t keyframe_interval;
+    int     keyframe_stream;
+    int64_t keyframe_last;
+    int64_t keyframe_target;
+    int     keyframe_seek;
+    int     keyframe_sequential;
+    //PLEX
 } Demuxer;
 
 typedef struct DemuxMsg {
@@ -305,7 +330,8 @@ static void ts_discontinuity_process(Demuxer *d, InputStream *ist,
         pkt->pts += offset;
 
     // detect timestamp discontinuities for audio/video
-    if ((ist->par->codec_type == AVMEDIA_TYPE_VIDEO ||
+    if (!d->keyframe_interval && //PLEX the jumps between keyframes are expected
+        (ist->par->codec_type == AVMEDIA_TYPE_VIDEO ||
          ist->par->codec_type == AVMEDIA_TYPE_AUDIO) &&
         pkt->dts != AV_NOPTS_VALUE)
         ts_discontinuity_detect(d, ist, pkt);
@@ -458,6 +484,35 @@ static int ts_fixup(Demuxer *d, AVPacket *pkt)
 
 // process an input packet into a message to send to the consumer thread
 // src is always cleared by this function
+//PLEX
+static AVPacket *demux_packet_get(Demuxer *d)
+{
+    void *pkt;
+    int ret;
+
+    pthread_mutex_lock(&d->pkt_pool_lock);
+    ret = objpool_get(d->pkt_pool, &pkt);
+    pthread_mutex_unlock(&d->pkt_pool_lock);
+
+    return ret < 0 ? NULL : pkt;
+}
+
+void ifile_packet_release(InputFile *f, AVPacket **pkt)
+{
+    Demuxer *d = demuxer_from_ifile(f);
+
+    if (!*pkt)
+        return;
+
+    // drop the data outside of the lock, it may be freed
+    av_packet_unref(*pkt);
+
+    pthread_mutex_lock(&d->pkt_pool_lock);
+    objpool_release(d->pkt_pool, (void **)pkt);
+    pthread_mutex_unlock(&d->pkt_pool_lock);
+}
+//PLEX
+
 static int input_packet_process(Demuxer *d, DemuxMsg *msg, AVPacket *src)
 {
     InputFile     *f = &d->f;
@@ -466,7 +521,7 @@ static int input_packet_process(Demuxer *d, DemuxMsg *msg, AVPacket *src)
     AVPacket *pkt;
     int ret = 0;
 
-    pkt = av_packet_alloc();
+    pkt = demux_packet_get(d); //PLEX
     if (!pkt) {
         av_packet_unref(src);
         return AVERROR(ENOMEM);
@@ -495,7 +550,7 @@ static int input_packet_process(Demuxer *d, DemuxMsg *msg, AVPacket *src)
     pkt      = NULL;
 
 fail:
-    av_packet_free(&pkt);
+    ifile_packet_release(f, &pkt); //PLEX
 
     return ret;
 }
@@ -535,6 +590,89 @@ static void discard_unused_programs(InputFile *ifile)
     }
 }
 
+//PLEX
+static void keyframe_seek_init(Demuxer *d)
+{
+    InputFile *f = &d->f;
+
+    d->keyframe_stream = -1;
+    d->keyframe_last   = AV_NOPTS_VALUE;
+    d->keyframe_target = AV_NOPTS_VALUE;
+    if (!d->keyframe_interval)
+        return;
+
+    for (int i = 0; i < f->nb_streams; i++) {
+        if (f->streams[i]->par->codec_type == AVMEDIA_TYPE_VIDEO &&
+            !f->streams[i]->discard) {
+            d->keyframe_stream = i;
+            break;
+        }
+    }
+    if (d->keyframe_stream < 0) {
+        av_log(d, AV_LOG_WARNING, "No video stream to seek keyframes in, "
+               "ignoring -keyframe_interval\n");
+        d->keyframe_interval = 0;
+    }
+}
+
+/**
+ * Keep only the keyframe of the video stream nearest to each multiple of the
+ * keyframe interval, and seek to the next one once it is read. Inputs that
+ * cannot seek are read sequentially, keeping the first keyframe at or after
+ * each multiple.
+ * @return 1 if the packet must be dropped
+ */
+static int keyframe_seek_filter(Demuxer *d, const AVPacket *pkt)
+{
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+
+    if (pkt->stream_index != d->keyframe_stream || !(pkt->flags & AV_PKT_FLAG_KEY))
+        return 1;
+
+    if (ts != AV_NOPTS_VALUE) {
+        /* pkt->time_base is only set later, in ts_fixup() */
+        ts = av_rescale_q(ts, d->f.ctx->streams[pkt->stream_index]->time_base,
+                          AV_TIME_BASE_Q);
+        /* seeking may land on the keyframe that was already output */
+        if (d->keyframe_last != AV_NOPTS_VALUE && ts <= d->keyframe_last)
+            return 1;
+        if (d->keyframe_sequential && d->keyframe_target != AV_NOPTS_VALUE &&
+            ts < d->keyframe_target)
+            return 1;
+        d->keyframe_last = ts;
+
+        if (d->keyframe_target == AV_NOPTS_VALUE)
+            d->keyframe_target = ts;
+        if (d->keyframe_target <= ts)
+            d->keyframe_target += ((ts - d->keyframe_target) / d->keyframe_interval + 1) *
+                                  d->keyframe_interval;
+        d->keyframe_seek = !d->keyframe_sequential;
+    }
+    return 0;
+}
+//PLEX
+
+static int file_seek(Demuxer *d, int64_t timestamp)
+{
+    AVFormatContext *ic = d->f.ctx;
+    int64_t seek_timestamp = timestamp;
+
+    if (!(ic->iformat->flags & AVFMT_SEEK_TO_PTS)) {
+        int dts_heuristic = 0;
+        for (int i = 0; i < ic->nb_streams; i++) {
+            const AVCodecParameters *par = ic->streams[i]->codecpar;
+            if (par->video_delay) {
+                dts_heuristic = 1;
+                break;
+            }
+        }
+        if (dts_heuristic) {
+            seek_timestamp -= 3*AV_TIME_BASE / 23;
+        }
+    }
+    return avformat_seek_file(ic, -1, INT64_MIN, seek_timestamp, seek_timestamp, 0);
+}
+
 static void thread_set_name(InputFile *f)
 {
     char name[16];
@@ -542,6 +680,16 @@ static void thread_set_name(InputFile *f)
     ff_thread_setname(name);
 }
 
+//PLEX
+// the consumer still has packets to work on, see buffer_wait()
+static int demux_queue_busy(void *opaque)
+{
+    Demuxer *d = opaque;
+
+    return av_thread_message_queue_nb_elems(d->in_thread_queue) > 0;
+}
+//PLEX
+
 static void *input_thread(void *arg)
 {
     Demuxer   *d = arg;
@@ -559,13 +707,35 @@ static void *input_thread(void *arg)
     thread_set_name(f);
 
     discard_unused_programs(f);
+    keyframe_seek_init(d); //PLEX
 
     d->wallclock_start = av_gettime_relative();
 
     while (1) {
         DemuxMsg msg = { NULL };
+        PlexStageTimer timer; //PLEX
+
+        //PLEX
+        if (d->keyframe_seek) {
+            d->keyframe_seek = 0;
+            ret = avformat_seek_file(f->ctx, -1, d->keyframe_last + 1, d->keyframe_target,
+                                     INT64_MAX, 0);
+            if (ret == AVERROR_EOF) {
+                av_log(d, AV_LOG_VERBOSE, "EOF while reading input\n");
+                break;
+            } else if (ret < 0) {
+                av_log(d, AV_LOG_VERBOSE, "Could not seek to the next keyframe "
+                       "(%s), reading the input sequentially\n", av_err2str(ret));
+                d->keyframe_sequential = 1;
+            }
+        }
+        //PLEX
 
+        plex_stage_start(&timer); //PLEX
         ret = av_read_frame(f->ctx, pkt);
+        plex_stage_end(PLEX_STAGE_DEMUX, &timer); //PLEX
+        if (ret >= 0)
+            startup_trace("first packet demuxed"); //PLEX
 
         if (ret == AVERROR(EAGAIN)) {
             av_usleep(10000);
@@ -598,6 +768,13 @@ static void *input_thread(void *arg)
                              f->ctx->streams[pkt->stream_index]);
         }
 
+        //PLEX
+        if (d->keyframe_interval && keyframe_seek_filter(d, pkt)) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        //PLEX
+
         /* the following test is needed in case new streams appear
            dynamically in stream : we ignore them */
         if (pkt->stream_index >= f->nb_streams ||
@@ -625,6 +802,13 @@ static void *input_thread(void *arg)
         if (f->readrate)
             readrate_sleep(d);
 
+        //PLEX
+        // live inputs are not held back, they would drop data instead
+        if (!d->non_blocking)
+            buffer_wait(demux_queue_busy, d);
+        buffer_account_packet(msg.pkt, 1);
+        //PLEX
+
         ret = av_thread_message_queue_send(d->in_thread_queue, &msg, flags);
         if (flags && ret == AVERROR(EAGAIN)) {
             flags = 0;
@@ -634,12 +818,19 @@ static void *input_thread(void *arg)
                    "thread_queue_size option (current value: %d)\n",
                    d->thread_queue_size);
         }
+        //PLEX
+        plex_stage_queue(PLEX_STAGE_DECODE,
+                         av_thread_message_queue_nb_elems(d->in_thread_queue));
+        //PLEX
         if (ret < 0) {
             if (ret != AVERROR_EOF)
                 av_log(f, AV_LOG_ERROR,
                        "Unable to send packet to main thread: %s\n",
                        av_err2str(ret));
-            av_packet_free(&msg.pkt);
+            //PLEX
+            buffer_account_packet(msg.pkt, -1);
+            ifile_packet_release(f, &msg.pkt);
+            //PLEX
             break;
         }
     }
@@ -663,8 +854,13 @@ static void thread_stop(Demuxer *d)
     if (!d->in_thread_queue)
         return;
     av_thread_message_queue_set_err_send(d->in_thread_queue, AVERROR_EOF);
-    while (av_thread_message_queue_recv(d->in_thread_queue, &msg, 0) >= 0)
-        av_packet_free(&msg.pkt);
+    //PLEX
+    while (av_thread_message_queue_recv(d->in_thread_queue, &msg, 0) >= 0) {
+        if (msg.pkt)
+            buffer_account_packet(msg.pkt, -1);
+        ifile_packet_release(f, &msg.pkt);
+    }
+    //PLEX
 
     pthread_join(d->thread, NULL);
     av_thread_message_queue_free(&d->in_thread_queue);
@@ -679,6 +875,16 @@ static int thread_start(Demuxer *d)
     if (d->thread_queue_size <= 0)
         d->thread_queue_size = (nb_input_files > 1 ? 8 : 1);
 
+    //PLEX
+    // kept across thread restarts, freed in ifile_close()
+    if (!d->pkt_pool) {
+        d->pkt_pool = objpool_alloc_packets();
+        if (!d->pkt_pool)
+            return AVERROR(ENOMEM);
+        pthread_mutex_init(&d->pkt_pool_lock, NULL);
+    }
+    //PLEX
+
     if (nb_input_files > 1 &&
         (f->ctx->pb ? !f->ctx->pb->seekable :
          strcmp(f->ctx->iformat->name, "lavfi")))
@@ -720,6 +926,53 @@ fail:
     return ret;
 }
 
+//PLEX
+int ifile_seek(InputFile *f, int64_t timestamp)
+{
+    Demuxer *d = demuxer_from_ifile(f);
+    AVFormatContext *ic = f->ctx;
+    int ret;
+
+    if (d->loop) {
+        av_log(d, AV_LOG_WARNING, "Cannot seek a looped input\n");
+        return AVERROR(ENOSYS);
+    }
+
+    // the thread is restarted by the next ifile_get_packet()
+    thread_stop(d);
+
+    /* the same as -ss, as the input was opened with */
+    if (ic->start_time != AV_NOPTS_VALUE)
+        timestamp += ic->start_time;
+
+    ret = file_seek(d, timestamp);
+    if (ret < 0) {
+        av_log(d, AV_LOG_ERROR, "could not seek to position %0.3f\n",
+               (double)timestamp / AV_TIME_BASE);
+        return ret;
+    }
+
+    f->start_time = timestamp - (ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0);
+    f->ts_offset  = f->input_ts_offset - (copy_ts ? (start_at_zero && ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0) : timestamp);
+    f->eof_reached = 0;
+
+    d->ts_offset_discont = 0;
+    d->last_ts           = 0;
+
+    for (int i = 0; i < f->nb_streams; i++) {
+        DemuxStream *ds = ds_from_ist(f->streams[i]);
+
+        ds->wrap_correction_done = 0;
+        ds->saw_first_ts         = 0;
+        ds->first_dts            = AV_NOPTS_VALUE;
+        ds->next_dts             = AV_NOPTS_VALUE;
+    }
+
+    av_log(d, AV_LOG_VERBOSE, "Seeked to %0.3f\n", (double)f->start_time / AV_TIME_BASE);
+    return 0;
+}
+//PLEX
+
 int ifile_get_packet(InputFile *f, AVPacket **pkt)
 {
     Demuxer *d = demuxer_from_ifile(f);
@@ -740,6 +993,7 @@ int ifile_get_packet(InputFile *f, AVPacket **pkt)
     if (msg.looping)
         return 1;
 
+    buffer_account_packet(msg.pkt, -1); //PLEX
     *pkt = msg.pkt;
     return 0;
 }
@@ -817,6 +1071,20 @@ void ifile_close(InputFile **pf)
     if (d->read_started)
         demux_final_stats(d);
 
+    //PLEX
+    if (d->pkt_pool) {
+        if (do_benchmark) {
+            uint64_t nb_get, nb_reused;
+            objpool_stats(d->pkt_pool, &nb_get, &nb_reused);
+            av_log(f, AV_LOG_INFO, "bench: packet pool: %"PRIu64" packets, "
+                   "%.2f%% recycled\n", nb_get,
+                   nb_get ? 100.0 * nb_reused / nb_get : 0.0);
+        }
+        objpool_free(&d->pkt_pool);
+        pthread_mutex_destroy(&d->pkt_pool_lock);
+    }
+    //PLEX
+
     for (int i = 0; i < f->nb_streams; i++)
         ist_free(&f->streams[i]);
     av_freep(&f->streams);
@@ -867,6 +1135,14 @@ int ist_output_add(InputStream *ist, OutputStream *ost)
     return 0;
 }
 
+//PLEX
+int ist_burn_in_add(InputStream *ist)
+{
+    // Decoded subtitles are handed to the inlineass filter by the decoder.
+    return ist_use(ist, DECODING_FOR_FILTER);
+}
+//PLEX
+
 int ist_filter_add(InputStream *ist, InputFilter *ifilter, int is_simple)
 {
     int ret;
@@ -1149,6 +1425,13 @@ static int ist_add(const OptionsContext *o, Demuxer *d, AVStream *st)
             if (!ist->hwaccel_device)
                 return AVERROR(ENOMEM);
         }
+
+        //PLEX
+        MATCH_PER_STREAM_OPT(hwaccel_fallback_thresholds, i,
+                             ist->hwaccel_fallback_threshold, ic, st);
+        MATCH_PER_STREAM_OPT(hwaccel_fallback_replays, i,
+                             ist->hwaccel_fallback_replay, ic, st);
+        //PLEX
     }
 
     ret = choose_decoder(o, ic, st, ist->hwaccel_id, ist->hwaccel_device_type,
@@ -1161,6 +1444,12 @@ static int ist_add(const OptionsContext *o, Demuxer *d, AVStream *st)
     if (ret < 0)
         return ret;
 
+    //PLEX
+    /* only keyframes reach the decoder */
+    if (o->keyframe_interval && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        av_dict_set(&ist->decoder_opts, "skip_frame", "nokey", AV_DICT_DONT_OVERWRITE);
+    //PLEX
+
     ist->reinit_filters = -1;
     MATCH_PER_STREAM_OPT(reinit_filters, i, ist->reinit_filters, ic, st);
 
@@ -1503,6 +1792,8 @@ int ifile_open(const OptionsContext *o, const char *filename)
     if (ret < 0)
         return ret;
 
+    plex_report_input_streams(ic); //PLEX
+
     /* apply forced codec ids */
     for (i = 0; i < ic->nb_streams; i++) {
         const AVCodec *dummy;
@@ -1528,6 +1819,8 @@ int ifile_open(const OptionsContext *o, const char *filename)
             av_dict_free(&opts[i]);
         av_freep(&opts);
 
+        plex_report_probed_streams(ic, orig_nb_streams); //PLEX
+
         if (ret < 0) {
             av_log(d, AV_LOG_FATAL, "could not find codec parameters\n");
             if (ic->nb_streams == 0)
@@ -1561,22 +1854,7 @@ int ifile_open(const OptionsContext *o, const char *filename)
 
     /* if seeking requested, we execute it */
     if (start_time != AV_NOPTS_VALUE) {
-        int64_t seek_timestamp = timestamp;
-
-        if (!(ic->iformat->flags & AVFMT_SEEK_TO_PTS)) {
-            int dts_heuristic = 0;
-            for (i=0; i<ic->nb_streams; i++) {
-                const AVCodecParameters *par = ic->streams[i]->codecpar;
-                if (par->video_delay) {
-                    dts_heuristic = 1;
-                    break;
-                }
-            }
-            if (dts_heuristic) {
-                seek_timestamp -= 3*AV_TIME_BASE / 23;
-            }
-        }
-        ret = avformat_seek_file(ic, -1, INT64_MIN, seek_timestamp, seek_timestamp, 0);
+        ret = file_seek(d, timestamp);
         if (ret < 0) {
             av_log(d, AV_LOG_WARNING, "could not seek to position %0.3f\n",
                    (double)timestamp / AV_TIME_BASE);
@@ -1590,6 +1868,14 @@ int ifile_open(const OptionsContext *o, const char *filename)
     f->ts_offset  = o->input_ts_offset - (copy_ts ? (start_at_zero && ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0) : timestamp);
     f->accurate_seek = o->accurate_seek;
     d->loop = o->loop;
+    //PLEX
+    d->keyframe_interval = o->keyframe_interval;
+    if (d->keyframe_interval < 0 || (d->keyframe_interval && d->loop)) {
+        av_log(d, AV_LOG_ERROR, "Option -keyframe_interval must be positive "
+               "and cannot be combined with -stream_loop.\n");
+        return AVERROR(EINVAL);
+    }
+    //PLEX
     d->duration = 0;
     d->time_base = (AVRational){ 1, 1 };
     d->nb_streams_warn = ic->nb_streams;
@@ -20,6 +20,10 @@
 #include <stdint.h>
 
 #include "ffmpeg.h"
+#include "thread_queue.h"
+//PLEX
+#include "plex.h"
+//PLEX
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
@@ -27,6 +31,7 @@
 #include "libavutil/dict.h"
 #include "libavutil/display.h"
 #include "libavutil/eval.h"
+#include "libavutil/fifo.h"
 #include "libavutil/frame.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
@@ -36,8 +41,43 @@
 
 #include "libavcodec/avcodec.h"
 
+#include "libavfilter/avfilter.h" //PLEX
+
 #include "libavformat/avformat.h"
 
+//PLEX
+// the compared luma is downscaled to about this width
+#define QUALITY_WIDTH        480
+// frames sampled but not yet reconstructed, more than the encoder delay
+#define QUALITY_MAX_PENDING  16
+
+typedef struct QualitySample {
+    int64_t  pts;           // in the encoder time base, AV_NOPTS_VALUE if free
+    uint8_t *luma;
+} QualitySample;
+
+/* Compares the downscaled luma of 1 in interval frames sent to the encoder
+ * with the frame it reconstructs, so quality is known without decoding. */
+typedef struct QualityMonitor {
+    int      interval;
+    int      factor;        // downscaling in both directions
+    int      w, h;          // size of the downscaled luma
+    uint64_t nb_frames;
+
+    QualitySample pending[QUALITY_MAX_PENDING];
+    uint8_t *recon_luma;
+    AVFrame *recon;
+
+    // the scores, read by the main thread
+    pthread_mutex_t lock;
+    EncQualityStats stats;
+    double   total;
+    int64_t  segment;       // segment being accumulated
+    double   segment_total;
+    int      segment_samples;
+} QualityMonitor;
+//PLEX
+
 struct Encoder {
     AVFrame *sq_frame;
 
@@ -51,8 +91,52 @@ struct Encoder {
     uint64_t packets_encoded;
 
     int opened;
+
+    pthread_t       thread;
+    /**
+     * Queue for sending frames from the main thread to the encoder thread.
+     * The thread is started for audio and video encoders once they are
+     * opened, so that encoders for independent streams run concurrently.
+     */
+    ThreadQueue    *queue_in;
+    // reference to the frame being sent to queue_in
+    AVFrame        *thread_frame;
+    // number of frames sent to queue_in but not yet received by the thread
+    atomic_int      nb_queued;
+
+    /**
+     * Packets produced by the encoder thread, retrieved by the main thread
+     * after every frame it sends. This FIFO grows as needed, so the encoder
+     * thread never blocks on its output while the main thread is blocked on
+     * queue_in.
+     */
+    AVFifo         *queue_out;
+    pthread_mutex_t out_lock;
+    pthread_cond_t  out_cond;
+    // set by the encoder thread when it terminates, AVERROR_EOF on success
+    int             out_status;
+    //PLEX
+    // -benchmark_all timestamps of the encoder thread
+    BenchmarkTimeStamps bench;
+    // set by the encoder thread once it is done with a flush request
+    int             flushed;
+
+    QualityMonitor  quality;
+    //PLEX
 };
 
+static void enc_thread_stop(Encoder *e)
+{
+    if (!e->queue_in)
+        return;
+
+    tq_send_finish(e->queue_in, 0);
+
+    pthread_join(e->thread, NULL);
+
+    tq_free(&e->queue_in);
+}
+
 void enc_free(Encoder **penc)
 {
     Encoder *enc = *penc;
@@ -60,6 +144,29 @@ void enc_free(Encoder **penc)
     if (!enc)
         return;
 
+    enc_thread_stop(enc);
+
+    //PLEX
+    if (enc->quality.recon) {
+        for (int i = 0; i < QUALITY_MAX_PENDING; i++)
+            av_freep(&enc->quality.pending[i].luma);
+        av_freep(&enc->quality.recon_luma);
+        av_frame_free(&enc->quality.recon);
+        pthread_mutex_destroy(&enc->quality.lock);
+    }
+    //PLEX
+
+    if (enc->queue_out) {
+        AVPacket *pkt;
+        while (av_fifo_read(enc->queue_out, &pkt, 1) >= 0)
+            av_packet_free(&pkt);
+        av_fifo_freep2(&enc->queue_out);
+
+        pthread_mutex_destroy(&enc->out_lock);
+        pthread_cond_destroy(&enc->out_cond);
+    }
+    av_frame_free(&enc->thread_frame);
+
     av_frame_free(&enc->sq_frame);
 
     av_packet_free(&enc->pkt);
@@ -165,6 +272,427 @@ static int set_encoder_id(OutputFile *of, OutputStream *ost)
     return 0;
 }
 
+//PLEX
+static int quality_format_supported(enum AVPixelFormat pix_fmt)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+
+    // luma in the first plane, 8 bits or native endian words
+    return desc && !(desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_RGB |
+                                    AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM |
+                                    AV_PIX_FMT_FLAG_FLOAT | AV_PIX_FMT_FLAG_BE)) &&
+           desc->nb_components >= 1 && desc->comp[0].plane == 0 &&
+           desc->comp[0].depth >= 8 && desc->comp[0].depth <= 16 &&
+           desc->comp[0].step == (desc->comp[0].depth > 8 ? 2 : 1);
+}
+
+static int quality_init(OutputStream *ost)
+{
+    QualityMonitor *q = &ost->enc->quality;
+    AVCodecContext *enc = ost->enc_ctx;
+    int ret;
+
+    ret = pthread_mutex_init(&q->lock, NULL);
+    if (ret)
+        return AVERROR(ret);
+    q->recon = av_frame_alloc();
+    if (!q->recon) {
+        pthread_mutex_destroy(&q->lock);
+        return AVERROR(ENOMEM);
+    }
+
+    q->factor = FFMAX(1, (enc->width + QUALITY_WIDTH / 2) / QUALITY_WIDTH);
+    q->w      = enc->width  / q->factor;
+    q->h      = enc->height / q->factor;
+    if (q->w < 8 || q->h < 8) {
+        q->factor = 1;
+        q->w      = enc->width;
+        q->h      = enc->height;
+    }
+
+    q->recon_luma = av_malloc(q->w * q->h);
+    if (!q->recon_luma)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < QUALITY_MAX_PENDING; i++)
+        q->pending[i].pts = AV_NOPTS_VALUE;
+
+    q->interval      = ost->quality_sample;
+    q->stats.segment = -1;
+    q->segment       = -1;
+
+    av_log(ost, AV_LOG_VERBOSE, "Sampling the SSIM of 1 in %d frames at %dx%d, "
+           "averaged over %gs\n", q->interval, q->w, q->h,
+           ost->quality_segment / (double)AV_TIME_BASE);
+    return 0;
+}
+
+// box filter the luma to the compared size and to 8 bits
+static void quality_downscale(const QualityMonitor *q, uint8_t *dst, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    const int f = q->factor, area = f * f;
+    const int shift = desc->comp[0].shift + desc->comp[0].depth - 8;
+
+    for (int y = 0; y < q->h; y++) {
+        const uint8_t *src = frame->data[0] + y * f * frame->linesize[0];
+
+        for (int x = 0; x < q->w; x++) {
+            unsigned sum = 0;
+
+            for (int j = 0; j < f; j++) {
+                const uint8_t *row = src + j * frame->linesize[0];
+
+                if (desc->comp[0].depth > 8) {
+                    for (int i = 0; i < f; i++)
+                        sum += ((const uint16_t *)row)[x * f + i];
+                } else {
+                    for (int i = 0; i < f; i++)
+                        sum += row[x * f + i];
+                }
+            }
+            dst[y * q->w + x] = (sum / area) >> shift;
+        }
+    }
+}
+
+// runs in the encoder thread, before the frame is sent
+static void quality_sample_input(QualityMonitor *q, const AVFrame *frame)
+{
+    QualitySample *slot = NULL;
+
+    if (q->nb_frames++ % q->interval || !quality_format_supported(frame->format) ||
+        frame->pts == AV_NOPTS_VALUE)
+        return;
+
+    // reuse the oldest sample if the encoder never reconstructed it
+    for (int i = 0; i < QUALITY_MAX_PENDING; i++) {
+        QualitySample *s = &q->pending[i];
+        if (s->pts == AV_NOPTS_VALUE) {
+            slot = s;
+            break;
+        }
+        if (!slot || s->pts < slot->pts)
+            slot = s;
+    }
+
+    if (!slot->luma) {
+        slot->luma = av_malloc(q->w * q->h);
+        if (!slot->luma)
+            return;
+    }
+    quality_downscale(q, slot->luma, frame);
+    slot->pts = frame->pts;
+}
+
+static void quality_update(OutputStream *ost, int64_t pts, double ssim)
+{
+    QualityMonitor *q = &ost->enc->quality;
+    int64_t segment;
+
+    segment = av_rescale_q(pts, ost->enc_ctx->time_base, AV_TIME_BASE_Q) /
+              ost->quality_segment;
+
+    pthread_mutex_lock(&q->lock);
+
+    if (segment != q->segment && q->segment_samples) {
+        q->stats.segment         = q->segment;
+        q->stats.segment_samples = q->segment_samples;
+        q->stats.segment_ssim    = q->segment_total / q->segment_samples;
+        av_log(ost, AV_LOG_VERBOSE, "Segment %"PRId64": SSIM %.5f over %d frames\n",
+               q->stats.segment, q->stats.segment_ssim, q->segment_samples);
+        q->segment_total   = 0;
+        q->segment_samples = 0;
+    }
+    q->segment        = segment;
+    q->segment_total += ssim;
+    q->segment_samples++;
+
+    q->total += ssim;
+    q->stats.nb_samples++;
+    q->stats.ssim = q->total / q->stats.nb_samples;
+
+    pthread_mutex_unlock(&q->lock);
+}
+
+// runs in the encoder thread at EOF, to close the last segment
+static void quality_finish(OutputStream *ost)
+{
+    QualityMonitor *q = &ost->enc->quality;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->segment_samples) {
+        q->stats.segment         = q->segment;
+        q->stats.segment_samples = q->segment_samples;
+        q->stats.segment_ssim    = q->segment_total / q->segment_samples;
+        q->segment_samples       = 0;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    if (q->stats.nb_samples)
+        av_log(ost, AV_LOG_INFO, "Sampled SSIM %.5f over %"PRIu64" frames\n",
+               q->stats.ssim, q->stats.nb_samples);
+}
+
+// runs in the encoder thread, after every packet
+static int quality_sample_recon(OutputStream *ost, const AVPacket *pkt)
+{
+    QualityMonitor *q = &ost->enc->quality;
+    QualitySample *s = NULL;
+    double ssim;
+    int ret;
+
+    ret = avcodec_receive_frame(ost->enc_ctx, q->recon);
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+        return 0;
+    else if (ret < 0)
+        return ret;
+
+    for (int i = 0; i < QUALITY_MAX_PENDING && pkt->pts != AV_NOPTS_VALUE; i++)
+        if (q->pending[i].pts == pkt->pts)
+            s = &q->pending[i];
+
+    if (s && quality_format_supported(q->recon->format) &&
+        q->recon->width == ost->enc_ctx->width && q->recon->height == ost->enc_ctx->height) {
+        quality_downscale(q, q->recon_luma, q->recon);
+        if (avfilter_plane_ssim(s->luma, q->w, q->recon_luma, q->w,
+                                q->w, q->h, &ssim) >= 0)
+            quality_update(ost, s->pts, ssim);
+    }
+    if (s)
+        s->pts = AV_NOPTS_VALUE;
+
+    av_frame_unref(q->recon);
+    return 0;
+}
+
+int enc_quality_stats(const OutputStream *ost, EncQualityStats *st)
+{
+    QualityMonitor *q = ost->enc ? &ost->enc->quality : NULL;
+
+    if (!q || !q->interval)
+        return AVERROR(ENOSYS);
+
+    pthread_mutex_lock(&q->lock);
+    *st = q->stats;
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+//PLEX
+
+static int enc_thread_output(Encoder *e, AVPacket *pkt)
+{
+    AVPacket *out;
+    int ret;
+
+    out = av_packet_alloc();
+    if (!out)
+        return AVERROR(ENOMEM);
+    av_packet_move_ref(out, pkt);
+
+    pthread_mutex_lock(&e->out_lock);
+    ret = av_fifo_write(e->queue_out, &out, 1);
+    pthread_cond_signal(&e->out_cond);
+    pthread_mutex_unlock(&e->out_lock);
+
+    if (ret < 0)
+        av_packet_free(&out);
+    return ret;
+}
+
+/* runs in the encoder thread */
+static int enc_thread_encode(OutputStream *ost, AVFrame *frame, AVPacket *pkt)
+{
+    Encoder            *e = ost->enc;
+    AVCodecContext   *enc = ost->enc_ctx;
+    const char *type_desc = av_get_media_type_string(enc->codec_type);
+    const char    *action = frame ? "encode" : "flush";
+    PlexStageTimer timer; //PLEX
+    int ret;
+
+    if (frame && frame->sample_aspect_ratio.num && !ost->frame_aspect_ratio.num)
+        enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
+    update_benchmark_from(&e->bench, NULL); //PLEX
+
+    //PLEX
+    if (frame && e->quality.interval)
+        quality_sample_input(&e->quality, frame);
+    //PLEX
+
+    plex_stage_start(&timer); //PLEX
+    ret = avcodec_send_frame(enc, frame);
+    plex_stage_end(PLEX_STAGE_ENCODE, &timer); //PLEX
+    if (ret < 0 && !(ret == AVERROR_EOF && !frame)) {
+        av_log(ost, AV_LOG_ERROR, "Error submitting %s frame to the encoder\n",
+               type_desc);
+        return ret;
+    }
+
+    while (1) {
+        av_packet_unref(pkt);
+
+        plex_stage_start(&timer); //PLEX
+        ret = avcodec_receive_packet(enc, pkt);
+        plex_stage_end(PLEX_STAGE_ENCODE, &timer); //PLEX
+        update_benchmark_from(&e->bench, "%s_%s %d.%d", action, type_desc, //PLEX
+                              ost->file_index, ost->index);
+
+        pkt->time_base = enc->time_base;
+
+        /* if two pass, output log on success and EOF */
+        if ((ret >= 0 || ret == AVERROR_EOF) && ost->logfile && enc->stats_out)
+            fprintf(ost->logfile, "%s", enc->stats_out);
+
+        if (ret == AVERROR(EAGAIN)) {
+            av_assert0(frame); // should never happen during flushing
+            return 0;
+        } else if (ret == AVERROR_EOF) {
+            //PLEX
+            if (e->quality.interval)
+                quality_finish(ost);
+            //PLEX
+            return ret;
+        } else if (ret < 0) {
+            av_log(ost, AV_LOG_ERROR, "%s encoding failed\n", type_desc);
+            return ret;
+        }
+
+        //PLEX
+        if (e->quality.interval) {
+            ret = quality_sample_recon(ost, pkt);
+            if (ret < 0) {
+                av_log(ost, AV_LOG_ERROR, "Error retrieving a reconstructed frame\n");
+                return ret;
+            }
+        }
+        //PLEX
+
+        ret = enc_thread_output(e, pkt);
+        if (ret < 0)
+            return ret;
+    }
+
+    av_assert0(0);
+}
+
+static void enc_thread_set_name(const OutputStream *ost)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "enc%d:%d:%s", ost->file_index, ost->index,
+             ost->enc_ctx->codec->name);
+    ff_thread_setname(name);
+}
+
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    Encoder        *e = ost->enc;
+    AVFrame    *frame = av_frame_alloc();
+    AVPacket     *pkt = av_packet_alloc();
+    int ret = 0;
+
+    if (!frame || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    enc_thread_set_name(ost);
+
+    while (ret >= 0) {
+        int dummy;
+
+        // a receive failure means the main thread is done sending, so flush
+        ret = tq_receive(e->queue_in, &dummy, frame);
+        if (ret >= 0)
+            atomic_fetch_sub(&e->nb_queued, 1);
+
+        //PLEX
+        // a frame without data is a flush request from enc_seek_flush()
+        if (ret >= 0 && !frame->buf[0]) {
+            if (ost->enc_ctx->codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH)
+                avcodec_flush_buffers(ost->enc_ctx);
+            // the dropped frames are never reconstructed
+            for (int i = 0; i < QUALITY_MAX_PENDING; i++)
+                e->quality.pending[i].pts = AV_NOPTS_VALUE;
+
+            pthread_mutex_lock(&e->out_lock);
+            e->flushed = 1;
+            pthread_cond_signal(&e->out_cond);
+            pthread_mutex_unlock(&e->out_lock);
+            continue;
+        }
+        //PLEX
+
+        ret = enc_thread_encode(ost, ret < 0 ? NULL : frame, pkt);
+
+        av_frame_unref(frame);
+    }
+
+finish:
+    tq_receive_finish(e->queue_in, 0);
+
+    pthread_mutex_lock(&e->out_lock);
+    e->out_status = ret;
+    pthread_cond_signal(&e->out_cond);
+    pthread_mutex_unlock(&e->out_lock);
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+
+    av_log(ost, AV_LOG_VERBOSE, "Terminating encoder thread\n");
+
+    return NULL;
+}
+
+static int enc_thread_start(OutputStream *ost)
+{
+    Encoder *e = ost->enc;
+    ObjPool *op;
+    int ret;
+
+    e->thread_frame = av_frame_alloc();
+    if (!e->thread_frame)
+        return AVERROR(ENOMEM);
+
+    e->queue_out = av_fifo_alloc2(8, sizeof(AVPacket*), AV_FIFO_FLAG_AUTO_GROW);
+    if (!e->queue_out)
+        return AVERROR(ENOMEM);
+
+    ret = pthread_mutex_init(&e->out_lock, NULL);
+    if (ret)
+        goto fail_mutex;
+    ret = pthread_cond_init(&e->out_cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&e->out_lock);
+        goto fail_mutex;
+    }
+
+    op = objpool_alloc_frames();
+    if (!op)
+        return AVERROR(ENOMEM);
+
+    e->queue_in = tq_alloc(1, 4, op, frame_move);
+    if (!e->queue_in) {
+        objpool_free(&op);
+        return AVERROR(ENOMEM);
+    }
+    tq_set_account(e->queue_in, buffer_account_frame); //PLEX
+
+    ret = pthread_create(&e->thread, NULL, encoder_thread, ost);
+    if (ret) {
+        ret = AVERROR(ret);
+        av_log(ost, AV_LOG_ERROR, "pthread_create() failed: %s\n",
+               av_err2str(ret));
+        tq_free(&e->queue_in);
+        return ret;
+    }
+
+    return 0;
+fail_mutex:
+    av_fifo_freep2(&e->queue_out);
+    return AVERROR(ret);
+}
+
 int enc_open(OutputStream *ost, const AVFrame *frame)
 {
     InputStream *ist = ost->ist;
@@ -301,6 +829,24 @@ int enc_open(OutputStream *ost, const AVFrame *frame)
 
     av_dict_set(&ost->encoder_opts, "flags", "+frame_duration", AV_DICT_MULTIKEY);
 
+    //PLEX
+    if (ost->quality_sample > 0) {
+        if (!(enc->capabilities & AV_CODEC_CAP_ENCODER_RECON_FRAME)) {
+            av_log(ost, AV_LOG_WARNING, "Encoder %s does not export reconstructed "
+                   "frames, not sampling the quality\n", enc->name);
+            ost->quality_sample = 0;
+        } else if (!quality_format_supported(enc_ctx->pix_fmt)) {
+            av_log(ost, AV_LOG_WARNING, "Cannot sample the quality of %s frames\n",
+                   av_get_pix_fmt_name(enc_ctx->pix_fmt));
+            ost->quality_sample = 0;
+        } else {
+            ret = av_dict_set(&ost->encoder_opts, "flags", "+recon_frame", AV_DICT_MULTIKEY);
+            if (ret < 0)
+                return ret;
+        }
+    }
+    //PLEX
+
     ret = hw_device_setup_for_encode(ost, frame ? frame->hw_frames_ctx : NULL);
     if (ret < 0) {
         av_log(ost, AV_LOG_ERROR,
@@ -308,15 +854,30 @@ int enc_open(OutputStream *ost, const AVFrame *frame)
         return ret;
     }
 
+    //PLEX
+    ret = plex_hw_session_acquire(ost, enc);
+    if (ret < 0)
+        return ret;
+    //PLEX
+
     if ((ret = avcodec_open2(ost->enc_ctx, enc, &ost->encoder_opts)) < 0) {
         if (ret != AVERROR_EXPERIMENTAL)
             av_log(ost, AV_LOG_ERROR, "Error while opening encoder - maybe "
                    "incorrect parameters such as bit_rate, rate, width or height.\n");
         return ret;
     }
+    startup_trace("encoder opened"); //PLEX
 
     e->opened = 1;
 
+    //PLEX
+    if (ost->quality_sample > 0) {
+        ret = quality_init(ost);
+        if (ret < 0)
+            return ret;
+    }
+    //PLEX
+
     if (ost->sq_idx_encode >= 0) {
         e->sq_frame = av_frame_alloc();
         if (!e->sq_frame)
@@ -373,6 +934,12 @@ int enc_open(OutputStream *ost, const AVFrame *frame)
     if (ost->st->time_base.num <= 0 || ost->st->time_base.den <= 0)
         ost->st->time_base = av_add_q(ost->enc_ctx->time_base, (AVRational){0, 1});
 
+    if (ost->type == AVMEDIA_TYPE_AUDIO || ost->type == AVMEDIA_TYPE_VIDEO) {
+        ret = enc_thread_start(ost);
+        if (ret < 0)
+            return ret;
+    }
+
     ret = of_stream_init(of, ost);
     if (ret < 0)
         return ret;
@@ -610,15 +1177,86 @@ static int update_video_stats(OutputStream *ost, const AVPacket *pkt, int write_
     return 0;
 }
 
+/* retrieve the next packet produced by the encoder thread */
+static int enc_thread_receive(Encoder *e, AVPacket **pkt, int block)
+{
+    int ret;
+
+    pthread_mutex_lock(&e->out_lock);
+    while (1) {
+        if (av_fifo_read(e->queue_out, pkt, 1) >= 0) {
+            ret = 0;
+            break;
+        }
+        if (e->out_status < 0) {
+            ret = e->out_status;
+            break;
+        }
+        if (!block) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+        pthread_cond_wait(&e->out_cond, &e->out_lock);
+    }
+    pthread_mutex_unlock(&e->out_lock);
+
+    return ret;
+}
+
+/* runs in the main thread for every packet returned by the encoder thread */
+static int enc_packet_output(OutputFile *of, OutputStream *ost, AVPacket *pkt)
+{
+    Encoder            *e = ost->enc;
+    AVCodecContext   *enc = ost->enc_ctx;
+    const char *type_desc = av_get_media_type_string(enc->codec_type);
+    int ret;
+
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+        ret = update_video_stats(ost, pkt, !!vstats_filename);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (ost->enc_stats_post.io)
+        enc_stats_write(ost, &ost->enc_stats_post, NULL, pkt,
+                        e->packets_encoded);
+
+    if (debug_ts) {
+        av_log(ost, AV_LOG_INFO, "encoder -> type:%s "
+               "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s "
+               "duration:%s duration_time:%s\n",
+               type_desc,
+               av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
+               av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base),
+               av_ts2str(pkt->duration), av_ts2timestr(pkt->duration, &enc->time_base));
+    }
+
+    if ((ret = trigger_fix_sub_duration_heartbeat(ost, pkt)) < 0) {
+        av_log(NULL, AV_LOG_ERROR,
+               "Subtitle heartbeat logic failed in %s! (%s)\n",
+               __func__, av_err2str(ret));
+        return ret;
+    }
+
+    e->data_size += pkt->size;
+
+    e->packets_encoded++;
+
+    return of_output_packet(of, ost, pkt);
+}
+
 static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
 {
     Encoder            *e = ost->enc;
     AVCodecContext   *enc = ost->enc_ctx;
-    AVPacket         *pkt = e->pkt;
     const char *type_desc = av_get_media_type_string(enc->codec_type);
-    const char    *action = frame ? "encode" : "flush";
+    int block = !frame;
     int ret;
 
+    // encoder thread already joined
+    if (!e->queue_in)
+        return AVERROR_EOF;
+
     if (frame) {
         if (ost->enc_stats_pre.io)
             enc_stats_write(ost, &ost->enc_stats_pre, frame, NULL,
@@ -635,81 +1273,82 @@ static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
                    enc->time_base.num, enc->time_base.den);
         }
 
-        if (frame->sample_aspect_ratio.num && !ost->frame_aspect_ratio.num)
-            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
-    }
-
-    update_benchmark(NULL);
+        ret = av_frame_ref(e->thread_frame, frame);
+        if (ret < 0)
+            return ret;
 
-    ret = avcodec_send_frame(enc, frame);
-    if (ret < 0 && !(ret == AVERROR_EOF && !frame)) {
-        av_log(ost, AV_LOG_ERROR, "Error submitting %s frame to the encoder\n",
-               type_desc);
-        return ret;
-    }
+        atomic_fetch_add(&e->nb_queued, 1);
+        ret = tq_send(e->queue_in, 0, e->thread_frame);
+        if (ret < 0) {
+            atomic_fetch_sub(&e->nb_queued, 1);
+            av_frame_unref(e->thread_frame);
+            if (ret != AVERROR_EOF)
+                return ret;
+            // the encoder thread terminated, collect its status
+            block = 1;
+        }
+        plex_stage_queue(PLEX_STAGE_ENCODE, atomic_load(&e->nb_queued)); //PLEX
+    } else
+        tq_send_finish(e->queue_in, 0);
 
+    // pass on whatever the encoder thread has produced so far; when
+    // flushing, wait until it is done
     while (1) {
-        av_packet_unref(pkt);
+        AVPacket *pkt;
 
-        ret = avcodec_receive_packet(enc, pkt);
-        update_benchmark("%s_%s %d.%d", action, type_desc,
-                         ost->file_index, ost->index);
-
-        pkt->time_base = enc->time_base;
-
-        /* if two pass, output log on success and EOF */
-        if ((ret >= 0 || ret == AVERROR_EOF) && ost->logfile && enc->stats_out)
-            fprintf(ost->logfile, "%s", enc->stats_out);
-
-        if (ret == AVERROR(EAGAIN)) {
-            av_assert0(frame); // should never happen during flushing
+        ret = enc_thread_receive(e, &pkt, block);
+        if (ret == AVERROR(EAGAIN))
             return 0;
-        } else if (ret == AVERROR_EOF) {
+        else if (ret == AVERROR_EOF) {
+            enc_thread_stop(e);
             ret = of_output_packet(of, ost, NULL);
             return ret < 0 ? ret : AVERROR_EOF;
         } else if (ret < 0) {
-            av_log(ost, AV_LOG_ERROR, "%s encoding failed\n", type_desc);
+            enc_thread_stop(e);
             return ret;
         }
 
-        if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
-            ret = update_video_stats(ost, pkt, !!vstats_filename);
-            if (ret < 0)
-                return ret;
-        }
-
-        if (ost->enc_stats_post.io)
-            enc_stats_write(ost, &ost->enc_stats_post, NULL, pkt,
-                            e->packets_encoded);
-
-        if (debug_ts) {
-            av_log(ost, AV_LOG_INFO, "encoder -> type:%s "
-                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s "
-                   "duration:%s duration_time:%s\n",
-                   type_desc,
-                   av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
-                   av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base),
-                   av_ts2str(pkt->duration), av_ts2timestr(pkt->duration, &enc->time_base));
-        }
-
-        if ((ret = trigger_fix_sub_duration_heartbeat(ost, pkt)) < 0) {
-            av_log(NULL, AV_LOG_ERROR,
-                   "Subtitle heartbeat logic failed in %s! (%s)\n",
-                   __func__, av_err2str(ret));
+        ret = enc_packet_output(of, ost, pkt);
+        av_packet_free(&pkt);
+        if (ret < 0)
             return ret;
-        }
+    }
+}
 
-        e->data_size += pkt->size;
+//PLEX
+int enc_seek_flush(OutputStream *ost)
+{
+    Encoder *e = ost->enc;
+    AVPacket *pkt;
+    int ret;
 
-        e->packets_encoded++;
+    // not opened yet, or the encoder thread is already done
+    if (!e || !e->queue_in)
+        return 0;
 
-        ret = of_output_packet(of, ost, pkt);
-        if (ret < 0)
-            return ret;
+    if (!(ost->enc_ctx->codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH))
+        av_log(ost, AV_LOG_VERBOSE, "Encoder cannot be flushed, keeping its state\n");
+
+    av_frame_unref(e->thread_frame);
+    atomic_fetch_add(&e->nb_queued, 1);
+    ret = tq_send(e->queue_in, 0, e->thread_frame);
+    if (ret < 0) {
+        atomic_fetch_sub(&e->nb_queued, 1);
+        return ret == AVERROR_EOF ? 0 : ret;
     }
 
-    av_assert0(0);
+    // wait for the flush, anything encoded until then is dropped
+    pthread_mutex_lock(&e->out_lock);
+    while (!e->flushed && e->out_status >= 0)
+        pthread_cond_wait(&e->out_cond, &e->out_lock);
+    e->flushed = 0;
+    while (av_fifo_read(e->queue_out, &pkt, 1) >= 0)
+        av_packet_free(&pkt);
+    pthread_mutex_unlock(&e->out_lock);
+
+    return 0;
 }
+//PLEX
 
 static int submit_encode_frame(OutputFile *of, OutputStream *ost,
                                AVFrame *frame)
@@ -815,6 +1454,21 @@ static enum AVPictureType forced_kf_apply(void *logctx, KeyframeForceCtx *kf,
         }
     } else if (kf->type == KF_FORCE_SOURCE && (in_picture->flags & AV_FRAME_FLAG_KEY)) {
         goto force_keyframe;
+    //PLEX
+    } else if (kf->segment_duration) {
+        int64_t d = kf->segment_duration;
+
+        /* Boundaries are multiples of the duration on the output timeline,
+         * like the cuts of the muxer; restart on a jump backwards */
+        if (kf->segment_next == AV_NOPTS_VALUE ||
+            av_compare_ts(in_picture->pts, tb, kf->segment_next, AV_TIME_BASE_Q) >= 0 ||
+            av_compare_ts(in_picture->pts, tb, kf->segment_next - d, AV_TIME_BASE_Q) < 0) {
+            int64_t t = av_rescale_q_rnd(in_picture->pts, tb, AV_TIME_BASE_Q,
+                                         AV_ROUND_DOWN | AV_ROUND_PASS_MINMAX);
+            kf->segment_next = (t / d - (t % d < 0) + 1) * d;
+            goto force_keyframe;
+        }
+    //PLEX
     }
 
     return AV_PICTURE_TYPE_NONE;
@@ -75,6 +75,15 @@ static const FilterGraphPriv *cfgp_from_cfg(const FilterGraph *fg)
     return (const FilterGraphPriv*)fg;
 }
 
+//PLEX
+#define SUB2VIDEO_CANVASES 4
+
+typedef struct Sub2VideoCanvas {
+    AVFrame *frame;
+    int x0, y0, x1, y1; ///< painted area, empty if x0 >= x1
+} Sub2VideoCanvas;
+//PLEX
+
 typedef struct InputFilterPriv {
     InputFilter ifilter;
 
@@ -135,6 +144,15 @@ typedef struct InputFilterPriv {
 
         ///< marks if sub2video_update should force an initialization
         unsigned int initialize;
+
+        //PLEX
+        /* canvases reused once the filtergraph has released them; frame
+         * points to the one currently shown */
+        Sub2VideoCanvas canvas[SUB2VIDEO_CANVASES];
+        int cur_canvas;
+        /* number of rects painted on the current canvas */
+        int nb_rects;
+        //PLEX
     } sub2video;
 } InputFilterPriv;
 
@@ -208,9 +226,43 @@ static int configure_filtergraph(FilterGraph *fg);
 
 static int sub2video_get_blank_frame(InputFilterPriv *ifp)
 {
-    AVFrame *frame = ifp->sub2video.frame;
+    AVFrame *frame;
     int ret;
 
+    //PLEX
+    /* Clearing what was painted on a released canvas is much cheaper than
+     * allocating and clearing a new full size one for every event. */
+    for (int i = 0; i < SUB2VIDEO_CANVASES; i++) {
+        int idx = (ifp->sub2video.cur_canvas + i) % SUB2VIDEO_CANVASES;
+        Sub2VideoCanvas *c = &ifp->sub2video.canvas[idx];
+
+        frame = c->frame;
+        if (!frame->buf[0] || !av_frame_is_writable(frame) ||
+            frame->width  != ifp->width  || frame->height != ifp->height ||
+            frame->format != ifp->format)
+            continue;
+
+        for (int y = c->y0; y < c->y1 && c->x0 < c->x1; y++)
+            memset(frame->data[0] + y * frame->linesize[0] + c->x0 * 4, 0,
+                   (c->x1 - c->x0) * 4);
+        c->x0 = c->y0 = INT_MAX;
+        c->x1 = c->y1 = 0;
+        ifp->sub2video.cur_canvas = idx;
+        ifp->sub2video.frame = frame;
+        return 0;
+    }
+
+    /* all in use, replace the one after the current canvas */
+    ifp->sub2video.cur_canvas = (ifp->sub2video.cur_canvas + 1) % SUB2VIDEO_CANVASES;
+    {
+        Sub2VideoCanvas *c = &ifp->sub2video.canvas[ifp->sub2video.cur_canvas];
+
+        c->x0 = c->y0 = INT_MAX;
+        c->x1 = c->y1 = 0;
+        frame = ifp->sub2video.frame = c->frame;
+    }
+    //PLEX
+
     av_frame_unref(frame);
 
     frame->width  = ifp->width;
@@ -226,8 +278,8 @@ static int sub2video_get_blank_frame(InputFilterPriv *ifp)
     return 0;
 }
 
-static void sub2video_copy_rect(uint8_t *dst, int dst_linesize, int w, int h,
-                                AVSubtitleRect *r)
+static int sub2video_copy_rect(uint8_t *dst, int dst_linesize, int w, int h,
+                               AVSubtitleRect *r)
 {
     uint32_t *pal, *dst2;
     uint8_t *src, *src2;
@@ -235,13 +287,13 @@ static void sub2video_copy_rect(uint8_t *dst, int dst_linesize, int w, int h,
 
     if (r->type != SUBTITLE_BITMAP) {
         av_log(NULL, AV_LOG_WARNING, "sub2video: non-bitmap subtitle\n");
-        return;
+        return AVERROR(EINVAL);
     }
     if (r->x < 0 || r->x + r->w > w || r->y < 0 || r->y + r->h > h) {
         av_log(NULL, AV_LOG_WARNING, "sub2video: rectangle (%d %d %d %d) overflowing %d %d\n",
             r->x, r->y, r->w, r->h, w, h
         );
-        return;
+        return AVERROR(EINVAL);
     }
 
     dst += r->y * dst_linesize + r->x * 4;
@@ -255,6 +307,7 @@ static void sub2video_copy_rect(uint8_t *dst, int dst_linesize, int w, int h,
         dst += dst_linesize;
         src += r->linesize[0];
     }
+    return 0;
 }
 
 static void sub2video_push_ref(InputFilterPriv *ifp, int64_t pts)
@@ -297,15 +350,45 @@ static void sub2video_update(InputFilterPriv *ifp, int64_t heartbeat_pts,
         end_pts   = INT64_MAX;
         num_rects = 0;
     }
+    //PLEX
+    /* the decoder says the current canvas already shows this subtitle */
+    if (num_rects && num_rects == ifp->sub2video.nb_rects && frame->buf[0] &&
+        frame->width == ifp->width && frame->height == ifp->height &&
+        frame->format == ifp->format) {
+        for (i = 0; i < num_rects; i++)
+            if (!(sub->rects[i]->flags & AV_SUBTITLE_FLAG_UNCHANGED))
+                break;
+        if (i == num_rects) {
+            sub2video_push_ref(ifp, pts);
+            ifp->sub2video.end_pts = end_pts;
+            ifp->sub2video.initialize = 0;
+            return;
+        }
+    }
+    ifp->sub2video.nb_rects = 0;
+    //PLEX
     if (sub2video_get_blank_frame(ifp) < 0) {
         av_log(NULL, AV_LOG_ERROR,
                "Impossible to get a blank canvas.\n");
         return;
     }
+    frame        = ifp->sub2video.frame; //PLEX
     dst          = frame->data    [0];
     dst_linesize = frame->linesize[0];
-    for (i = 0; i < num_rects; i++)
-        sub2video_copy_rect(dst, dst_linesize, frame->width, frame->height, sub->rects[i]);
+    for (i = 0; i < num_rects; i++) {
+        //PLEX
+        Sub2VideoCanvas *c = &ifp->sub2video.canvas[ifp->sub2video.cur_canvas];
+        const AVSubtitleRect *r = sub->rects[i];
+
+        if (sub2video_copy_rect(dst, dst_linesize, frame->width, frame->height, sub->rects[i]) < 0)
+            continue;
+        c->x0 = FFMIN(c->x0, r->x);
+        c->y0 = FFMIN(c->y0, r->y);
+        c->x1 = FFMAX(c->x1, r->x + r->w);
+        c->y1 = FFMAX(c->y1, r->y + r->h);
+        //PLEX
+    }
+    ifp->sub2video.nb_rects = num_rects; //PLEX
     sub2video_push_ref(ifp, pts);
     ifp->sub2video.end_pts = end_pts;
     ifp->sub2video.initialize = 0;
@@ -618,9 +701,14 @@ static int ifilter_bind_ist(InputFilter *ifilter, InputStream *ist)
         return ret;
 
     if (ifp->type_src == AVMEDIA_TYPE_SUBTITLE) {
-        ifp->sub2video.frame = av_frame_alloc();
-        if (!ifp->sub2video.frame)
-            return AVERROR(ENOMEM);
+        //PLEX
+        for (int i = 0; i < SUB2VIDEO_CANVASES; i++) {
+            ifp->sub2video.canvas[i].frame = av_frame_alloc();
+            if (!ifp->sub2video.canvas[i].frame)
+                return AVERROR(ENOMEM);
+        }
+        ifp->sub2video.frame = ifp->sub2video.canvas[0].frame;
+        //PLEX
     }
 
     return 0;
@@ -810,6 +898,7 @@ void fg_free(FilterGraph **pfg)
         return;
     fgp = fgp_from_fg(fg);
 
+    plex_log_graph_profile(fg->graph); //PLEX
     avfilter_graph_free(&fg->graph);
     for (int j = 0; j < fg->nb_inputs; j++) {
         InputFilter *ifilter = fg->inputs[j];
@@ -821,7 +910,11 @@ void fg_free(FilterGraph **pfg)
                 av_frame_free(&frame);
             av_fifo_freep2(&ifp->frame_queue);
         }
-        av_frame_free(&ifp->sub2video.frame);
+        //PLEX
+        for (int j = 0; j < SUB2VIDEO_CANVASES; j++)
+            av_frame_free(&ifp->sub2video.canvas[j].frame);
+        ifp->sub2video.frame = NULL;
+        //PLEX
 
         av_channel_layout_uninit(&ifp->fallback.ch_layout);
 
@@ -1597,6 +1690,7 @@ static void cleanup_filtergraph(FilterGraph *fg)
         ofp_from_ofilter(fg->outputs[i])->filter = NULL;
     for (i = 0; i < fg->nb_inputs; i++)
         ifp_from_ifilter(fg->inputs[i])->filter = NULL;
+    plex_log_graph_profile(fg->graph); //PLEX
     avfilter_graph_free(&fg->graph);
 }
 
@@ -1733,6 +1827,7 @@ static int configure_filtergraph(FilterGraph *fg)
 //PLEX
     //make sure the inlineasscontext is set up properly for each stream
     plex_link_subtitles_to_graph(fg->graph);
+    plex_profile_graph(fg->graph);
 //PLEX
 
     for (i = 0; i < fg->nb_inputs; i++) {
@@ -2129,6 +2224,16 @@ static int fg_output_frame(OutputFilterPriv *ofp, AVFrame *frame)
                 ofp->fps.dropped_keyframe = 0;
             }
         } else {
+            //PLEX
+            const AVDictionaryEntry *e;
+            if ((e = av_dict_get(frame->metadata, "lavfi.aresample.comp_soft_samples", NULL, 0)))
+                ofp->ofilter.nb_samples_comp_soft     = strtoll(e->value, NULL, 10);
+            if ((e = av_dict_get(frame->metadata, "lavfi.aresample.comp_inserted_samples", NULL, 0)))
+                ofp->ofilter.nb_samples_comp_inserted = strtoll(e->value, NULL, 10);
+            if ((e = av_dict_get(frame->metadata, "lavfi.aresample.comp_dropped_samples", NULL, 0)))
+                ofp->ofilter.nb_samples_comp_dropped  = strtoll(e->value, NULL, 10);
+            //PLEX
+
             frame->pts = (frame->pts == AV_NOPTS_VALUE) ? ofp->next_pts :
                 av_rescale_q(frame->pts,   frame->time_base, ofp->tb_out) -
                 av_rescale_q(ofp->ts_offset, AV_TIME_BASE_Q, ofp->tb_out);
@@ -2373,12 +2478,105 @@ int ifilter_send_eof(InputFilter *ifilter, int64_t pts, AVRational tb)
     return 0;
 }
 
+//PLEX
+/* whether a scaler has a constant output size, i.e. whatever its input is */
+static int scale_size_fixed(AVFilterContext *f)
+{
+    static const char *const dims[] = { "w", "h" };
+    int64_t foar;
+
+    /* the size is fitted to the input aspect ratio */
+    if (av_opt_get_int(f, "force_original_aspect_ratio", AV_OPT_SEARCH_CHILDREN, &foar) < 0 ||
+        foar)
+        return 0;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(dims); i++) {
+        uint8_t *val;
+        char *end;
+        long v;
+
+        if (av_opt_get(f, dims[i], AV_OPT_SEARCH_CHILDREN, &val) < 0)
+            return 0;
+        v = strtol(val, &end, 10);
+        if (*end || end == (char *)val || v <= 0) {
+            av_free(val);
+            return 0;
+        }
+        av_free(val);
+    }
+    return 1;
+}
+
+/**
+ * Try to absorb a size or pixel format change of a video input without
+ * rebuilding the graph. This works when the buffer source feeds a scaler,
+ * possibly through trim/null, since the scaler reconfigures itself when
+ * the size or format of its input frames changes. Only scalers with a
+ * constant output size qualify, and only if the display aspect ratio of
+ * the input is kept, so nothing downstream of them changes.
+ *
+ * @return 1 if the change was absorbed, 0 if the graph must be rebuilt
+ */
+static int ifilter_renegotiate(FilterGraph *fg, InputFilterPriv *ifp,
+                               const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    AVFilterContext *f = ifp->filter;
+    AVFilterLink *inlink;
+    AVBufferSrcParameters *par;
+    int ret;
+
+    if (ifp->type != AVMEDIA_TYPE_VIDEO || ifp->type_src != AVMEDIA_TYPE_VIDEO ||
+        !desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) || frame->hw_frames_ctx)
+        return 0;
+
+    do {
+        if (f->nb_outputs != 1 || !f->outputs[0])
+            return 0;
+        f = f->outputs[0]->dst;
+    } while (!strcmp(f->filter->name, "trim") || !strcmp(f->filter->name, "null"));
+
+    if (strcmp(f->filter->name, "scale") || !scale_size_fixed(f))
+        return 0;
+
+    /* the output SAR follows the input display aspect ratio */
+    inlink = f->inputs[0];
+    if (!inlink->sample_aspect_ratio.num || !frame->sample_aspect_ratio.num) {
+        if (inlink->sample_aspect_ratio.num || frame->sample_aspect_ratio.num)
+            return 0;
+    } else if (av_cmp_q(av_mul_q(inlink->sample_aspect_ratio,
+                                 (AVRational){ inlink->w, inlink->h }),
+                        av_mul_q(frame->sample_aspect_ratio,
+                                 (AVRational){ frame->width, frame->height })))
+        return 0;
+
+    par = av_buffersrc_parameters_alloc();
+    if (!par)
+        return AVERROR(ENOMEM);
+    par->format              = frame->format;
+    par->width               = frame->width;
+    par->height              = frame->height;
+    par->sample_aspect_ratio = frame->sample_aspect_ratio;
+    ret = av_buffersrc_parameters_set(ifp->filter, par);
+    av_freep(&par);
+    if (ret < 0)
+        return ret;
+
+    av_log(fg, AV_LOG_VERBOSE, "Input changed to %dx%d %s, reconfiguring "
+           "the scaler instead of the whole filtergraph\n",
+           frame->width, frame->height, desc->name);
+    return 1;
+}
+//PLEX
+
 int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_reference)
 {
     InputFilterPriv *ifp = ifp_from_ifilter(ifilter);
     FilterGraph *fg = ifilter->graph;
     AVFrameSideData *sd;
+    PlexStageTimer timer; //PLEX
     int need_reinit, ret;
+    int renegotiate; //PLEX
 
     /* determine if the parameters for this input changed */
     need_reinit = ifp->format != frame->format;
@@ -2396,17 +2594,24 @@ int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_reference)
 
     if (!ifp->ist->reinit_filters && fg->graph)
         need_reinit = 0;
+    renegotiate = need_reinit && fg->graph; //PLEX
 
     if (!!ifp->hw_frames_ctx != !!frame->hw_frames_ctx ||
-        (ifp->hw_frames_ctx && ifp->hw_frames_ctx->data != frame->hw_frames_ctx->data))
+        (ifp->hw_frames_ctx && ifp->hw_frames_ctx->data != frame->hw_frames_ctx->data)) {
         need_reinit = 1;
+        renegotiate = 0; //PLEX
+    }
 
     if (sd = av_frame_get_side_data(frame, AV_FRAME_DATA_DISPLAYMATRIX)) {
         if (!ifp->displaymatrix_present ||
-            memcmp(sd->data, ifp->displaymatrix, sizeof(ifp->displaymatrix)))
+            memcmp(sd->data, ifp->displaymatrix, sizeof(ifp->displaymatrix))) {
             need_reinit = 1;
-    } else if (ifp->displaymatrix_present)
+            renegotiate = 0; //PLEX
+        }
+    } else if (ifp->displaymatrix_present) {
         need_reinit = 1;
+        renegotiate = 0; //PLEX
+    }
 
     if (need_reinit) {
         ret = ifilter_parameters_from_frame(ifilter, frame);
@@ -2414,6 +2619,16 @@ int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_reference)
             return ret;
     }
 
+    //PLEX
+    if (renegotiate) {
+        ret = ifilter_renegotiate(fg, ifp, frame);
+        if (ret < 0)
+            return ret;
+        if (ret)
+            need_reinit = 0;
+    }
+    //PLEX
+
     /* (re)init the graph if possible, otherwise buffer the frame and return */
     if (need_reinit || !fg->graph) {
         if (!ifilter_has_all_input_formats(fg)) {
@@ -2458,8 +2673,10 @@ int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_reference)
     )
 #endif
 
+    plex_stage_start(&timer); //PLEX
     ret = av_buffersrc_add_frame_flags(ifp->filter, frame,
                                        AV_BUFFERSRC_FLAG_PUSH);
+    plex_stage_end(PLEX_STAGE_FILTER, &timer); //PLEX
     if (ret < 0) {
         av_frame_unref(frame);
         if (ret != AVERROR_EOF)
@@ -2470,9 +2687,39 @@ int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_reference)
     return 0;
 }
 
+//PLEX
+void fg_seek_reset(FilterGraph *fg)
+{
+    cleanup_filtergraph(fg);
+
+    for (int i = 0; i < fg->nb_inputs; i++) {
+        InputFilterPriv *ifp = ifp_from_ifilter(fg->inputs[i]);
+        AVFrame *frame;
+
+        while (av_fifo_read(ifp->frame_queue, &frame, 1) >= 0)
+            av_frame_free(&frame);
+        av_frame_unref(ifp->frame);
+    }
+
+    /* restart the output timelines as with a freshly opened input */
+    for (int i = 0; i < fg->nb_outputs; i++) {
+        OutputFilterPriv *ofp = ofp_from_ofilter(fg->outputs[i]);
+
+        ofp->next_pts = 0;
+        if (ofp->fps.last_frame)
+            av_frame_unref(ofp->fps.last_frame);
+        ofp->fps.frame_number     = 0;
+        memset(ofp->fps.frames_prev_hist, 0, sizeof(ofp->fps.frames_prev_hist));
+        ofp->fps.last_dropped     = 0;
+        ofp->fps.dropped_keyframe = 0;
+    }
+}
+//PLEX
+
 int fg_transcode_step(FilterGraph *graph, InputStream **best_ist)
 {
     FilterGraphPriv *fgp = fgp_from_fg(graph);
+    PlexStageTimer timer; //PLEX
     int i, ret;
     int nb_requests, nb_requests_max = 0;
     InputStream *ist;
@@ -2495,7 +2742,9 @@ int fg_transcode_step(FilterGraph *graph, InputStream **best_ist)
     }
 
     *best_ist = NULL;
+    plex_stage_start(&timer); //PLEX
     ret = avfilter_graph_request_oldest(graph->graph);
+    plex_stage_end(PLEX_STAGE_FILTER, &timer); //PLEX
     if (ret >= 0)
         return reap_filters(graph, 0);
 
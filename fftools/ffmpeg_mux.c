@@ -22,6 +22,9 @@
 
 #include "ffmpeg.h"
 #include "ffmpeg_mux.h"
+//PLEX
+#include "plex.h"
+//PLEX
 #include "objpool.h"
 #include "sync_queue.h"
 #include "thread_queue.h"
@@ -30,6 +33,7 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
 #include "libavutil/mem.h"
+#include "libavutil/opt.h"
 #include "libavutil/timestamp.h"
 #include "libavutil/thread.h"
 
@@ -64,6 +68,7 @@ static int write_packet(Muxer *mux, OutputStream *ost, AVPacket *pkt)
     AVFormatContext *s = mux->fc;
     int64_t fs;
     uint64_t frame_num;
+    PlexStageTimer timer; //PLEX
     int ret;
 
     fs = filesize(s->pb);
@@ -153,13 +158,22 @@ static int write_packet(Muxer *mux, OutputStream *ost, AVPacket *pkt)
     if (ms->stats.io)
         enc_stats_write(ost, &ms->stats, NULL, pkt, frame_num);
 
+    plex_stage_start(&timer); //PLEX
+    //PLEX
+    if (mux->direct_write) {
+        ret = av_write_frame(s, pkt);
+        av_packet_unref(pkt);
+    } else
+    //PLEX
     ret = av_interleaved_write_frame(s, pkt);
+    plex_stage_end(PLEX_STAGE_MUX, &timer); //PLEX
     if (ret < 0) {
         av_log(ost, AV_LOG_ERROR,
                "Error submitting a packet to the muxer: %s\n",
                av_err2str(ret));
         goto fail;
     }
+    startup_trace("first packet muxed"); //PLEX
 
     return 0;
 fail:
@@ -202,6 +216,28 @@ static int sync_queue_process(Muxer *mux, OutputStream *ost, AVPacket *pkt, int
     return 0;
 }
 
+//PLEX
+/* runs in the muxer thread, ordered after all the packets sent before */
+static int mux_restart(Muxer *mux, int segment)
+{
+    OutputFile *of = &mux->of;
+    int ret;
+
+    ret = avformat_restart_output(mux->fc, segment);
+    if (ret < 0)
+        return ret;
+
+    for (int i = 0; i < of->nb_streams; i++) {
+        MuxStream *ms = ms_from_ost(of->streams[i]);
+
+        ms->last_mux_dts          = AV_NOPTS_VALUE;
+        ms->ts_rescale_delta_last = 0;
+    }
+
+    return 0;
+}
+//PLEX
+
 static void thread_set_name(OutputFile *of)
 {
     char name[16];
@@ -235,6 +271,21 @@ static void *muxer_thread(void *arg)
             break;
         }
 
+        //PLEX
+        // a packet without data is a restart request from of_restart(),
+        // with the segment number in pos
+        if (ret >= 0 && !pkt->buf) {
+            ret = mux_restart(mux, pkt->pos);
+            av_packet_unref(pkt);
+            if (ret < 0) {
+                av_log(mux, AV_LOG_ERROR, "Error restarting the output: %s\n",
+                       av_err2str(ret));
+                break;
+            }
+            continue;
+        }
+        //PLEX
+
         ost = of->streams[stream_idx];
         ret = sync_queue_process(mux, ost, ret < 0 ? NULL : pkt, &stream_eof);
         av_packet_unref(pkt);
@@ -291,12 +342,31 @@ static int queue_packet(OutputStream *ost, AVPacket *pkt)
     AVPacket *tmp_pkt = NULL;
     int ret;
 
+    //PLEX
+    // with a session budget, the budget replaces the per stream limits;
+    // this queue only drains once all the streams can be muxed, so holding
+    // back the demuxers cannot help it
+    if (max_buffered_size > 0 && pkt) {
+        int64_t cur, peak;
+
+        buffer_stats(&cur, &peak);
+        if (cur + pkt->size > max_buffered_size) {
+            av_log(ost, AV_LOG_ERROR,
+                   "Too many packets buffered for output stream %d:%d, "
+                   "%"PRId64" bytes are queued with max_buffered_size %"PRId64".\n",
+                   ost->file_index, ost->st->index, cur, max_buffered_size);
+            return AVERROR(ENOSPC);
+        }
+    }
+    //PLEX
+
     if (!av_fifo_can_write(ms->muxing_queue)) {
         size_t cur_size = av_fifo_can_read(ms->muxing_queue);
         size_t pkt_size = pkt ? pkt->size : 0;
         unsigned int are_we_over_size =
             (ms->muxing_queue_data_size + pkt_size) > ms->muxing_queue_data_threshold;
-        size_t limit    = are_we_over_size ? ms->max_muxing_queue_size : SIZE_MAX;
+        size_t limit    = are_we_over_size && max_buffered_size <= 0 ? //PLEX
+                          ms->max_muxing_queue_size : SIZE_MAX;
         size_t new_size = FFMIN(2 * cur_size, limit);
 
         if (new_size <= cur_size) {
@@ -321,6 +391,7 @@ static int queue_packet(OutputStream *ost, AVPacket *pkt)
 
         av_packet_move_ref(tmp_pkt, pkt);
         ms->muxing_queue_data_size += tmp_pkt->size;
+        buffer_account_packet(tmp_pkt, 1); //PLEX
     }
     av_fifo_write(ms->muxing_queue, &tmp_pkt, 1);
 
@@ -403,6 +474,71 @@ fail:
     return exit_on_error ? ret : 0;
 }
 
+//PLEX
+int of_restart_query(OutputFile *of)
+{
+    Muxer *mux = mux_from_of(of);
+
+    // the sync queues would hold back packets across the restart
+    if (mux->sq_mux || of->sq_encode)
+        return AVERROR(ENOSYS);
+    if (!mux->header_written)
+        return 0;
+    if (!mux->tq)
+        return AVERROR(ENOSYS);
+    return avformat_restart_output_query(mux->fc);
+}
+
+int of_restart(OutputFile *of, int segment)
+{
+    Muxer *mux = mux_from_of(of);
+    MuxStream *ms = NULL;
+    int ret;
+
+    for (int i = 0; i < of->nb_streams; i++) {
+        OutputStream *ost = of->streams[i];
+
+        if (ms_from_ost(ost)->bsf_ctx)
+            av_bsf_flush(ms_from_ost(ost)->bsf_ctx);
+        ms_from_ost(ost)->streamcopy_started = 0;
+        ost->last_mux_dts = AV_NOPTS_VALUE;
+
+        if (!ms && !(ost->finished & MUXER_FINISHED))
+            ms = ms_from_ost(ost);
+    }
+
+    if (!mux->header_written) {
+        // nothing was written yet, just start at the requested segment
+        for (int i = 0; i < of->nb_streams; i++) {
+            MuxStream *qms = ms_from_ost(of->streams[i]);
+            AVPacket *pkt;
+
+            while (av_fifo_read(qms->muxing_queue, &pkt, 1) >= 0) {
+                if (pkt) {
+                    qms->muxing_queue_data_size -= pkt->size;
+                    buffer_account_packet(pkt, -1);
+                }
+                av_packet_free(&pkt);
+            }
+        }
+        if (segment >= 0 &&
+            av_opt_set_int(mux->fc, "segment_start_number", segment,
+                           AV_OPT_SEARCH_CHILDREN) < 0)
+            av_log(mux, AV_LOG_WARNING, "Output is not segmented, "
+                   "ignoring the segment number\n");
+        return 0;
+    }
+
+    if (!mux->tq || !ms)
+        return AVERROR(ENOSYS);
+
+    av_packet_unref(ms->pkt);
+    ms->pkt->pos = segment;
+    ret = tq_send(mux->tq, ms->ost.index, ms->pkt);
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+//PLEX
+
 int of_streamcopy(OutputStream *ost, const AVPacket *pkt, int64_t dts)
 {
     OutputFile *of = output_files[ost->file_index];
@@ -504,6 +640,7 @@ static int thread_start(Muxer *mux)
         objpool_free(&op);
         return AVERROR(ENOMEM);
     }
+    tq_set_account(mux->tq, buffer_account_packet); //PLEX
 
     ret = pthread_create(&mux->thread, NULL, muxer_thread, (void*)mux);
     if (ret) {
@@ -518,6 +655,11 @@ static int thread_start(Muxer *mux)
         AVPacket *pkt;
 
         while (av_fifo_read(ms->muxing_queue, &pkt, 1) >= 0) {
+            //PLEX
+            // accounted again by the thread queue
+            if (pkt)
+                buffer_account_packet(pkt, -1);
+            //PLEX
             ret = thread_submit_packet(mux, ost, pkt);
             if (pkt) {
                 ms->muxing_queue_data_size -= pkt->size;
@@ -611,6 +753,11 @@ int mux_check_init(Muxer *mux)
     av_dump_format(fc, of->index, fc->url, 1);
     nb_output_dumped++;
 
+    //PLEX
+    for (i = 0; i < fc->nb_streams; i++)
+        plex_report_output_stream(fc->streams[i]);
+    //PLEX
+
     if (sdp_filename || want_sdp) {
         ret = print_sdp();
         if (ret < 0) {
@@ -857,8 +1004,11 @@ static void ost_free(OutputStream **post)
 
     if (ms->muxing_queue) {
         AVPacket *pkt;
-        while (av_fifo_read(ms->muxing_queue, &pkt, 1) >= 0)
+        while (av_fifo_read(ms->muxing_queue, &pkt, 1) >= 0) {
+            if (pkt)
+                buffer_account_packet(pkt, -1); //PLEX
             av_packet_free(&pkt);
+        }
         av_fifo_freep2(&ms->muxing_queue);
     }
 
@@ -108,6 +108,10 @@ typedef struct Muxer {
 
     SyncQueue *sq_mux;
     AVPacket *sq_pkt;
+
+    /* all streams are copied from one input: write packets in their arrival
+     * order instead of through the interleaving queue of the muxer */
+    int direct_write; //PLEX
 } Muxer;
 
 /* whether we want to print an SDP, set in of_open() */
@@ -24,6 +24,9 @@
 #include "ffmpeg.h"
 #include "ffmpeg_mux.h"
 #include "fopen_utf8.h"
+//PLEX
+#include "plex.h"
+//PLEX
 
 #include "libavformat/avformat.h"
 #include "libavformat/avio.h"
@@ -88,8 +91,7 @@ static const char *const opt_name_audio_sample_rate[]         = {"ar", NULL};
 static const char *const opt_name_frame_sizes[]               = {"s", NULL};
 static const char *const opt_name_frame_pix_fmts[]            = {"pix_fmt", NULL};
 static const char *const opt_name_sample_fmts[]               = {"sample_fmt", NULL};
-
-static const char *const opt_name_hwaccel_fallback_thresholds[] = {"hwaccel_fallback_threshold", NULL};
+static const char *const opt_name_quality_samples[]           = {"quality_sample", NULL}; //PLEX
 
 static int check_opt_bitexact(void *ctx, const AVDictionary *opts,
                               const char *opt_name, int flag)
@@ -833,6 +835,37 @@ static int new_stream_video(Muxer *mux, const OptionsContext *o,
     return 0;
 }
 
+//PLEX
+/**
+ * TrueHD carries authored stereo and 5.1 presentations in its lower
+ * substreams. When the encoder gets fewer channels anyway and no filters
+ * are set, ask the not yet opened decoder for one of them, so that the
+ * higher substreams are not decoded at all.
+ */
+static void ost_request_dec_downmix(OutputStream *ost, const char *filters)
+{
+    InputStream *ist = ost->ist;
+    int channels     = ost->enc_ctx->ch_layout.nb_channels;
+    const char *layout;
+
+    if (!ist || !ist->dec || avcodec_is_open(ist->dec_ctx) ||
+        (ist->dec->id != AV_CODEC_ID_TRUEHD && ist->dec->id != AV_CODEC_ID_MLP))
+        return;
+    if (!channels || channels >= ist->st->codecpar->ch_layout.nb_channels ||
+        ost->audio_channels_mapped || (filters && strcmp(filters, "anull")) ||
+        av_dict_get(ist->decoder_opts, "downmix", NULL, 0))
+        return;
+
+    layout = channels <= 2 ? "stereo" : channels <= 6 ? "5.1" : NULL;
+    if (!layout)
+        return;
+
+    av_log(ost, AV_LOG_VERBOSE, "Requesting the %s presentation from the %s decoder\n",
+           layout, ist->dec->name);
+    av_dict_set(&ist->decoder_opts, "downmix", layout, 0);
+}
+//PLEX
+
 static int new_stream_audio(Muxer *mux, const OptionsContext *o,
                             OutputStream *ost)
 {
@@ -1423,6 +1456,11 @@ static int ost_add(Muxer *mux, const OptionsContext *o, enum AVMediaType type,
             return ret;
     }
 
+    //PLEX
+    if (ost->ist && type == AVMEDIA_TYPE_VIDEO)
+        plex_link_input_stream(ost->ist);
+    //PLEX
+
     if (ost->enc &&
         (type == AVMEDIA_TYPE_VIDEO || type == AVMEDIA_TYPE_AUDIO)) {
         if (ofilter) {
@@ -1431,6 +1469,10 @@ static int ost_add(Muxer *mux, const OptionsContext *o, enum AVMediaType type,
             if (ret < 0)
                 return ret;
         } else {
+            //PLEX
+            if (type == AVMEDIA_TYPE_AUDIO)
+                ost_request_dec_downmix(ost, filters);
+            //PLEX
             ret = init_simple_filtergraph(ost->ist, ost, filters);
             if (ret < 0) {
                 av_log(ost, AV_LOG_ERROR,
@@ -2486,6 +2528,78 @@ fail:
     return ret;
 }
 
+//PLEX
+/* Segment duration of a segmenting muxer, or 0 when it does not cut at a
+ * fixed interval. */
+static int64_t muxer_segment_duration(AVFormatContext *fc)
+{
+    static const char *const durations[] = { "segment_time", "seg_duration", "hls_time" };
+    static const char *const lists[]     = { "segment_times", "segment_frames" };
+    int64_t duration;
+
+    if (!fc->priv_data)
+        return 0;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(lists); i++) {
+        uint8_t *str = NULL;
+        int set;
+
+        if (av_opt_get(fc->priv_data, lists[i], 0, &str) < 0)
+            continue;
+        set = str && *str;
+        av_freep(&str);
+        if (set)
+            return 0;
+    }
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(durations); i++)
+        if (av_opt_get_int(fc->priv_data, durations[i], 0, &duration) >= 0)
+            return FFMAX(duration, 0);
+
+    return 0;
+}
+
+/* Make the encoder code forced keyframes as IDR frames, unless the user
+ * chose otherwise. */
+static void enc_force_idr(OutputStream *ost)
+{
+    static const char *const names[] = { "forced-idr", "forced_idr" };
+
+    if (!ost->enc_ctx->priv_data)
+        return;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(names); i++)
+        if (av_opt_find(ost->enc_ctx->priv_data, names[i], NULL, 0, 0) &&
+            !av_dict_get(ost->encoder_opts, names[i], NULL, 0))
+            av_opt_set_int(ost->enc_ctx->priv_data, names[i], 1, 0);
+}
+//PLEX
+
+//PLEX
+#define QUALITY_SEGMENT_DEFAULT (10 * AV_TIME_BASE)
+
+static int setup_quality_sampling(Muxer *mux, const OptionsContext *o)
+{
+    for (int i = 0; i < mux->of.nb_streams; i++) {
+        OutputStream *ost = mux->of.streams[i];
+
+        if (ost->type != AVMEDIA_TYPE_VIDEO || !ost->enc_ctx)
+            continue;
+
+        MATCH_PER_STREAM_OPT(quality_samples, i, ost->quality_sample, mux->fc, ost->st);
+        if (ost->quality_sample <= 0)
+            continue;
+
+        // score the segments the muxer cuts, if any
+        ost->quality_segment = muxer_segment_duration(mux->fc);
+        if (!ost->quality_segment)
+            ost->quality_segment = QUALITY_SEGMENT_DEFAULT;
+    }
+
+    return 0;
+}
+//PLEX
+
 static int process_forced_keyframes(Muxer *mux, const OptionsContext *o)
 {
     for (int i = 0; i < mux->of.nb_streams; i++) {
@@ -2521,6 +2635,19 @@ static int process_forced_keyframes(Muxer *mux, const OptionsContext *o)
                    "-force_key_frames is deprecated, use just 'source'\n");
             ost->kf.type = KF_FORCE_SOURCE;
 #endif
+        //PLEX
+        } else if (!strcmp(forced_keyframes, "segment")) {
+            ost->kf.segment_duration = muxer_segment_duration(mux->fc);
+            if (!ost->kf.segment_duration) {
+                av_log(ost, AV_LOG_ERROR, "-force_key_frames segment requires "
+                       "a muxer cutting segments of a fixed duration\n");
+                return AVERROR(EINVAL);
+            }
+            ost->kf.segment_next = AV_NOPTS_VALUE;
+            enc_force_idr(ost);
+            av_log(ost, AV_LOG_VERBOSE, "Forcing keyframes every %gs for "
+                   "the segments\n", ost->kf.segment_duration / (double)AV_TIME_BASE);
+        //PLEX
         } else {
             int ret = parse_forced_key_frames(ost, &ost->kf, mux, forced_keyframes);
             if (ret < 0)
@@ -2764,6 +2891,12 @@ int of_open(const OptionsContext *o, const char *filename)
         return err;
     }
 
+    //PLEX
+    err = setup_quality_sampling(mux, o);
+    if (err < 0)
+        return err;
+    //PLEX
+
     err = setup_sync_queues(mux, oc, o->shortest_buf_duration * AV_TIME_BASE);
     if (err < 0) {
         av_log(mux, AV_LOG_FATAL, "Error setting up output sync queues\n");
@@ -2772,6 +2905,24 @@ int of_open(const OptionsContext *o, const char *filename)
 
     of->url        = filename;
 
+    //PLEX
+    if (o->copy_direct) {
+        int direct = !mux->sq_mux && of->nb_streams > 0;
+
+        for (int i = 0; direct && i < of->nb_streams; i++) {
+            const OutputStream *ost = of->streams[i];
+            direct = !ost->enc_ctx && ost->ist &&
+                      ost->ist->file_index == of->streams[0]->ist->file_index;
+        }
+        if (direct)
+            av_log(mux, AV_LOG_VERBOSE, "Writing packets in input order\n");
+        else
+            av_log(mux, AV_LOG_WARNING, "-copy_direct needs all streams copied "
+                   "from a single input and no -shortest; ignoring it\n");
+        mux->direct_write = direct;
+    }
+    //PLEX
+
     /* initialize stream copy and subtitle/data streams.
      * Encoded AVFrame based streams will get initialized when the first AVFrame
      * is received in do_video_out
@@ -98,6 +98,7 @@ int64_t stats_period = 500000;
 
 //PLEX
 int exit_on_io_error = 0;
+int64_t max_buffered_size = 0;
 //PLEX
 
 static int file_overwrite     = 0;
@@ -1352,6 +1353,15 @@ int ffmpeg_parse_options(int argc, char **argv)
         goto fail;
     }
 
+//PLEX
+    /* decode the subtitle streams selected for burn-in */
+    ret = plex_setup_input_streams();
+    if (ret < 0) {
+        errmsg = "setting up subtitle burn-in";
+        goto fail;
+    }
+//PLEX
+
     correct_input_start_times();
 
     ret = apply_sync_offsets();
@@ -1860,5 +1870,36 @@ const OptionDef options[] = {
     { "filter_hw_device", HAS_ARG | OPT_EXPERT, { .func_arg = opt_filter_hw_device },
         "set hardware device used when filtering", "device" },
 
+//PLEX
+    { "map_inlineass", HAS_ARG | OPT_EXPERT | OPT_PERFILE | OPT_OUTPUT, { .func_arg = plex_opt_subtitle_stream }, "index of the subtitle stream to burn into the video", "input_file_id:stream_specifier" },
+    { "progressurl", HAS_ARG | OPT_EXPERT, { .func_arg = plex_opt_progress_url }, "write progress information via HTTP PUT", "url" },
+    { "loglevel_plex", HAS_ARG | OPT_EXPERT, { .func_arg = plex_opt_loglevel}, "log level for messages that will be sent to PMS", "" },
+    { "hwaccel_fallback_threshold", OPT_VIDEO | OPT_INT | HAS_ARG | OPT_EXPERT |
+                                    OPT_SPEC | OPT_INPUT,                    { .off = OFFSET(hwaccel_fallback_thresholds) },
+        "set when HW accelerated decoding should forcibly fall back", "fallback" },
+    { "hwaccel_fallback_replay", OPT_VIDEO | OPT_BOOL | OPT_EXPERT |
+                                 OPT_SPEC | OPT_INPUT,                       { .off = OFFSET(hwaccel_fallback_replays) },
+        "re-decode the frames since the last keyframe in software on fallback instead of skipping to the next keyframe" },
+    { "quality_sample", OPT_VIDEO | OPT_INT | HAS_ARG | OPT_EXPERT |
+                        OPT_SPEC | OPT_OUTPUT,                       { .off = OFFSET(quality_samples) },
+        "compare 1 in N frames with the encoder's reconstruction and report their SSIM", "N" },
+    { "copy_direct", OPT_BOOL | OPT_OFFSET | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(copy_direct) },
+        "write packets in input order when every stream is copied from one input, skipping the muxer interleaving" },
+    { "keyframe_interval", HAS_ARG | OPT_TIME | OPT_OFFSET | OPT_EXPERT | OPT_INPUT, { .off = OFFSET(keyframe_interval) },
+        "only decode the video keyframe nearest to every multiple of the interval", "duration" },
+    { "xioerror", OPT_BOOL | OPT_EXPERT, { &exit_on_io_error },
+        "exit on I/O error", "error" },
+    { "max_buffered_size", OPT_INT64 | HAS_ARG | OPT_EXPERT, { &max_buffered_size },
+        "bytes of packets and frames all the queues between the pipeline stages may hold together", "size" },
+    { "throttle_speed", OPT_FLOAT | HAS_ARG | OPT_EXPERT, { &plexContext.throttle_speed },
+        "transcode speed, as a multiple of realtime, when the server allows throttling", "speed" },
+    { "hw_session_dir", OPT_STRING | HAS_ARG | OPT_EXPERT, { &plexContext.hw_session_dir },
+        "directory of the lock files used to count hardware encoder sessions", "dir" },
+    { "hw_session_limit", OPT_INT | HAS_ARG | OPT_EXPERT, { &plexContext.hw_session_limit },
+        "number of hardware encoder sessions allowed per device type, up to 64", "count" },
+    { "progress_json", OPT_STRING | HAS_ARG | OPT_EXPERT, { &plexContext.progress_json },
+        "write progress as one JSON record per line to a pipe, socket or file URL", "url" },
+//PLEX
+
     { NULL, },
 };
\ No newline at end of file
@@ -4083,6 +4083,8 @@ const OptionDef options[] = {
         "set when HW accelerated decoding should forcibly fall back", "fallback" },
     { "xioerror", OPT_BOOL | OPT_EXPERT, { &exit_on_io_error },
         "exit on I/O error", "error" },
+    { "throttle_speed", OPT_FLOAT | HAS_ARG | OPT_EXPERT, { &plexContext.throttle_speed },
+        "transcode speed, as a multiple of realtime, when the server allows throttling", "speed" },
 //PLEX
 
     { NULL, },
@@ -662,6 +662,8 @@ static void ffmpeg_cleanup(int ret)
 
     uninit_opts();
 
+    plex_uninit(); //PLEX
+
     avformat_network_deinit();
 
     if (received_sigterm) {
@@ -1852,7 +1854,6 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         char url[4096];
 
         if (plexContext.progress_url) {
-            char* reply;
             int hw_state = -1;
             // Compute speed of transcode as a multiple of real-time.
             float speed = (float)(pts - last_pts) / (float)run_time;
@@ -1883,7 +1884,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             if (plexContext.sw_succeeded)
                 av_strlcatf(url, sizeof(url), "&vdec_sw_ok=%d", plexContext.sw_succeeded);
 
-            if (plexContext.throttle_delay == 0)
+            if (!plexContext.throttled)
                 av_strlcatf(url, sizeof(url), "&speed=%.1f", speed);
 
             for (i = 0; i < nb_input_streams; i++) {
@@ -1898,22 +1899,21 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             if (hw_state >= 0)
                 av_strlcatf(url, sizeof(url), "&vdec_hw_status=%d", hw_state);
 
-            reply = PMS_IssueHttpRequest(url, "PUT");
+            plex_report_progress(url);
 
-            // Handle throttling.
-            if (reply && strstr(reply, "canThrottle")) {
-                if (plexContext.throttle_delay == 0)
+            // Handle throttling, as decided by the reply to an earlier report.
+            if (atomic_load(&plexContext.can_throttle)) {
+                if (!plexContext.throttled)
                     PMS_Log(LOG_LEVEL_DEBUG, "Throttle - Going into sloth mode.");
 
-                plexContext.throttle_delay = 100;
+                plexContext.throttled = 1;
             } else {
-                if (plexContext.throttle_delay == 100)
+                if (plexContext.throttled)
                     PMS_Log(LOG_LEVEL_DEBUG, "Throttle - Getting back to work.");
 
-                plexContext.throttle_delay = 0;
+                plexContext.throttled = 0;
             }
 
-            av_free(reply);
             lastRemaining = remainingSecs;
         }
         last_pts = pts;
@@ -3886,14 +3886,12 @@ static int transcode_init(void)
         if (par && par->codec_type == AVMEDIA_TYPE_VIDEO && par->width && plexContext.progress_url) {
             // Compute real width/height based on storage aspect ratio.
             char url[1024];
-            char* reply;
             int width = par->width;
             if (par->sample_aspect_ratio.num && par->sample_aspect_ratio.den)
                 width = av_rescale(width, par->sample_aspect_ratio.num, par->sample_aspect_ratio.den);
 
             snprintf(url, sizeof(url), "%s?width=%d&height=%d", plexContext.progress_url, width, par->height);
-            reply = PMS_IssueHttpRequest(url, "PUT");
-            av_free(reply);
+            plex_report_request(url, "PUT");
         }
 //PLEX
 
@@ -4692,9 +4690,8 @@ static int process_input(int file_index)
     process_input_packet(ist, pkt, 0);
 
 //PLEX
-    // Delay if needed.
-    if (plexContext.throttle_delay > 0)
-      usleep(1000*plexContext.throttle_delay);
+    // Pace the transcode if the server allows it.
+    plex_throttle(ifile->last_ts);
 //PLEX
 
 discard_packet:
@@ -38,6 +38,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/cpu.h"
 #include "libavutil/display.h"
 #include "libavutil/hash.h"
 #include "libavutil/hdr_dynamic_metadata.h"
@@ -159,7 +160,7 @@ static int find_stream_info  = 1;
 
 /* section structure definition */
 
-#define SECTION_MAX_NB_CHILDREN 10
+#define SECTION_MAX_NB_CHILDREN 11
 
 typedef enum {
     SECTION_ID_NONE = -1,
@@ -167,6 +168,8 @@ typedef enum {
     SECTION_ID_CHAPTER_TAGS,
     SECTION_ID_CHAPTERS,
     SECTION_ID_ERROR,
+    SECTION_ID_FILE,
+    SECTION_ID_FILES,
     SECTION_ID_FORMAT,
     SECTION_ID_FORMAT_TAGS,
     SECTION_ID_FRAME,
@@ -247,6 +250,10 @@ static struct section sections[] = {
     [SECTION_ID_CHAPTER] =            { SECTION_ID_CHAPTER, "chapter", 0, { SECTION_ID_CHAPTER_TAGS, -1 } },
     [SECTION_ID_CHAPTER_TAGS] =       { SECTION_ID_CHAPTER_TAGS, "tags", SECTION_FLAG_HAS_VARIABLE_FIELDS, { -1 }, .element_name = "tag", .unique_name = "chapter_tags" },
     [SECTION_ID_ERROR] =              { SECTION_ID_ERROR, "error", 0, { -1 } },
+    [SECTION_ID_FILES] =              { SECTION_ID_FILES, "files", SECTION_FLAG_IS_ARRAY, { SECTION_ID_FILE, -1 } },
+    [SECTION_ID_FILE] =               { SECTION_ID_FILE, "file", 0,
+                                        { SECTION_ID_CHAPTERS, SECTION_ID_FORMAT, SECTION_ID_FRAMES, SECTION_ID_PROGRAMS, SECTION_ID_STREAMS,
+                                          SECTION_ID_PACKETS, SECTION_ID_PACKETS_AND_FRAMES, SECTION_ID_ERROR, -1 } },
     [SECTION_ID_FORMAT] =             { SECTION_ID_FORMAT, "format", 0, { SECTION_ID_FORMAT_TAGS, -1 } },
     [SECTION_ID_FORMAT_TAGS] =        { SECTION_ID_FORMAT_TAGS, "tags", SECTION_FLAG_HAS_VARIABLE_FIELDS, { -1 }, .element_name = "tag", .unique_name = "format_tags" },
     [SECTION_ID_FRAMES] =             { SECTION_ID_FRAMES, "frames", SECTION_FLAG_IS_ARRAY, { SECTION_ID_FRAME, SECTION_ID_SUBTITLE, -1 } },
@@ -286,7 +293,7 @@ static struct section sections[] = {
     [SECTION_ID_ROOT] =               { SECTION_ID_ROOT, "root", SECTION_FLAG_IS_WRAPPER,
                                         { SECTION_ID_CHAPTERS, SECTION_ID_FORMAT, SECTION_ID_FRAMES, SECTION_ID_PROGRAMS, SECTION_ID_STREAMS,
                                           SECTION_ID_PACKETS, SECTION_ID_ERROR, SECTION_ID_PROGRAM_VERSION, SECTION_ID_LIBRARY_VERSIONS,
-                                          SECTION_ID_PIXEL_FORMATS, -1} },
+                                          SECTION_ID_PIXEL_FORMATS, SECTION_ID_FILES, -1} },
     [SECTION_ID_STREAMS] =            { SECTION_ID_STREAMS, "streams", SECTION_FLAG_IS_ARRAY, { SECTION_ID_STREAM, -1 } },
     [SECTION_ID_STREAM] =             { SECTION_ID_STREAM, "stream", 0, { SECTION_ID_STREAM_DISPOSITION, SECTION_ID_STREAM_TAGS, SECTION_ID_STREAM_SIDE_DATA_LIST, -1 } },
     [SECTION_ID_STREAM_DISPOSITION] = { SECTION_ID_STREAM_DISPOSITION, "disposition", 0, { -1 }, .unique_name = "stream_disposition" },
@@ -301,6 +308,10 @@ static const OptionDef *options;
 /* FFprobe context */
 static const char *input_filename;
 static const char *print_input_filename;
+//PLEX
+static char *batch_filename;
+static int batch_threads;
+//PLEX
 static const AVInputFormat *iformat = NULL;
 static const char *output_filename = NULL;
 
@@ -482,7 +493,7 @@ typedef struct Writer {
     int flags;                  ///< a combination or WRITER_FLAG_*
 } Writer;
 
-#define SECTION_MAX_NB_LEVELS 10
+#define SECTION_MAX_NB_LEVELS 12
 
 struct WriterContext {
     const AVClass *class;           ///< class of the writer
@@ -3392,18 +3403,28 @@ static int open_input_file(InputFile *ifile, const char *filename,
     AVFormatContext *fmt_ctx = NULL;
     const AVDictionaryEntry *t = NULL;
     int scan_all_pmts_set = 0;
+    //PLEX
+    /* work on a private copy, batch mode opens several inputs at once */
+    AVDictionary *fmt_opts = NULL;
+
+    if ((err = av_dict_copy(&fmt_opts, format_opts, 0)) < 0)
+        return err;
+    //PLEX
 
     fmt_ctx = avformat_alloc_context();
-    if (!fmt_ctx)
+    if (!fmt_ctx) {
+        av_dict_free(&fmt_opts);
         return AVERROR(ENOMEM);
+    }
 
-    if (!av_dict_get(format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
-        av_dict_set(&format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
+    if (!av_dict_get(fmt_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
+        av_dict_set(&fmt_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
         scan_all_pmts_set = 1;
     }
     if ((err = avformat_open_input(&fmt_ctx, filename,
-                                   iformat, &format_opts)) < 0) {
+                                   iformat, &fmt_opts)) < 0) {
         print_error(filename, err);
+        av_dict_free(&fmt_opts);
         return err;
     }
     if (print_filename) {
@@ -3412,9 +3433,10 @@ static int open_input_file(InputFile *ifile, const char *filename,
     }
     ifile->fmt_ctx = fmt_ctx;
     if (scan_all_pmts_set)
-        av_dict_set(&format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
-    while ((t = av_dict_iterate(format_opts, t)))
+        av_dict_set(&fmt_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
+    while ((t = av_dict_iterate(fmt_opts, t)))
         av_log(NULL, AV_LOG_WARNING, "Option %s skipped - not known to demuxer.\n", t->key);
+    av_dict_free(&fmt_opts);
 
     if (find_stream_info) {
         AVDictionary **opts;
@@ -3481,13 +3503,6 @@ static int open_input_file(InputFile *ifile, const char *filename,
             if (err < 0)
                 exit(1);
 
-            if (do_show_log) {
-                // For loging it is needed to disable at least frame threads as otherwise
-                // the log information would need to be reordered and matches up to contexts and frames
-                // That is in fact possible but not trivial
-                av_dict_set(&codec_opts, "threads", "1", 0);
-            }
-
             av_dict_set(&opts, "flags", "+copy_opaque", AV_DICT_MULTIKEY);
 
             ist->dec_ctx->pkt_timebase = stream->time_base;
@@ -3524,31 +3539,29 @@ static void close_input_file(InputFile *ifile)
     avformat_close_input(&ifile->fmt_ctx);
 }
 
-static int probe_file(WriterContext *wctx, const char *filename,
-                      const char *print_filename)
+/**
+ * Print the sections selected for an opened input. The writer and the
+ * per-stream counters are shared, so only one input may be shown at a time.
+ */
+static int show_input(WriterContext *wctx, InputFile *ifile)
 {
-    InputFile ifile = { 0 };
-    int ret, i;
+    int ret = 0, i;
     int section_id;
 
     do_read_frames = do_show_frames || do_count_frames;
     do_read_packets = do_show_packets || do_count_packets;
 
-    ret = open_input_file(&ifile, filename, print_filename);
-    if (ret < 0)
-        goto end;
-
 #define CHECK_END if (ret < 0) goto end
 
-    nb_streams = ifile.fmt_ctx->nb_streams;
-    REALLOCZ_ARRAY_STREAM(nb_streams_frames,0,ifile.fmt_ctx->nb_streams);
-    REALLOCZ_ARRAY_STREAM(nb_streams_packets,0,ifile.fmt_ctx->nb_streams);
-    REALLOCZ_ARRAY_STREAM(selected_streams,0,ifile.fmt_ctx->nb_streams);
+    nb_streams = ifile->fmt_ctx->nb_streams;
+    REALLOCZ_ARRAY_STREAM(nb_streams_frames,0,ifile->fmt_ctx->nb_streams);
+    REALLOCZ_ARRAY_STREAM(nb_streams_packets,0,ifile->fmt_ctx->nb_streams);
+    REALLOCZ_ARRAY_STREAM(selected_streams,0,ifile->fmt_ctx->nb_streams);
 
-    for (i = 0; i < ifile.fmt_ctx->nb_streams; i++) {
+    for (i = 0; i < ifile->fmt_ctx->nb_streams; i++) {
         if (stream_specifier) {
-            ret = avformat_match_stream_specifier(ifile.fmt_ctx,
-                                                  ifile.fmt_ctx->streams[i],
+            ret = avformat_match_stream_specifier(ifile->fmt_ctx,
+                                                  ifile->fmt_ctx->streams[i],
                                                   stream_specifier);
             CHECK_END;
             else
@@ -3558,7 +3571,7 @@ static int probe_file(WriterContext *wctx, const char *filename,
             selected_streams[i] = 1;
         }
         if (!selected_streams[i])
-            ifile.fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+            ifile->fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
     }
 
     if (do_read_frames || do_read_packets) {
@@ -3571,33 +3584,31 @@ static int probe_file(WriterContext *wctx, const char *filename,
             section_id = SECTION_ID_FRAMES;
         if (do_show_frames || do_show_packets)
             writer_print_section_header(wctx, NULL, section_id);
-        ret = read_packets(wctx, &ifile);
+        ret = read_packets(wctx, ifile);
         if (do_show_frames || do_show_packets)
             writer_print_section_footer(wctx);
         CHECK_END;
     }
 
     if (do_show_programs) {
-        ret = show_programs(wctx, &ifile);
+        ret = show_programs(wctx, ifile);
         CHECK_END;
     }
 
     if (do_show_streams) {
-        ret = show_streams(wctx, &ifile);
+        ret = show_streams(wctx, ifile);
         CHECK_END;
     }
     if (do_show_chapters) {
-        ret = show_chapters(wctx, &ifile);
+        ret = show_chapters(wctx, ifile);
         CHECK_END;
     }
     if (do_show_format) {
-        ret = show_format(wctx, &ifile);
+        ret = show_format(wctx, ifile);
         CHECK_END;
     }
 
 end:
-    if (ifile.fmt_ctx)
-        close_input_file(&ifile);
     av_freep(&nb_streams_frames);
     av_freep(&nb_streams_packets);
     av_freep(&selected_streams);
@@ -3605,6 +3616,192 @@ end:
     return ret;
 }
 
+static int probe_file(WriterContext *wctx, const char *filename,
+                      const char *print_filename)
+{
+    InputFile ifile = { 0 };
+    int ret;
+
+    ret = open_input_file(&ifile, filename, print_filename);
+    if (ret >= 0)
+        ret = show_input(wctx, &ifile);
+
+    if (ifile.fmt_ctx)
+        close_input_file(&ifile);
+    return ret;
+}
+
+//PLEX
+typedef struct BatchContext {
+    WriterContext *wctx;
+    char **inputs;
+    int nb_inputs;
+    int next;                   ///< index of the next input to pick up
+    int ret;                    ///< first error met, if any
+#if HAVE_THREADS
+    pthread_mutex_t queue_lock;
+    pthread_mutex_t print_lock; ///< serializes access to the writer
+#endif
+} BatchContext;
+
+static int batch_read_list(BatchContext *b, const char *filename)
+{
+    char line[4096];
+    FILE *f = strcmp(filename, "-") ? fopen(filename, "r") : stdin;
+    int ret = 0;
+
+    if (!f) {
+        ret = AVERROR(errno);
+        av_log(NULL, AV_LOG_ERROR, "Cannot open batch list '%s': %s\n",
+               filename, av_err2str(ret));
+        return ret;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        size_t len = strcspn(line, "\r\n");
+        char *input;
+
+        line[len] = 0;
+        if (!len)
+            continue;
+        if (!strcmp(line, "-"))
+            av_strlcpy(line, "fd:", sizeof(line));
+        if (!(input = av_strdup(line)) ||
+            (ret = av_dynarray_add_nofree(&b->inputs, &b->nb_inputs, input)) < 0) {
+            av_free(input);
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+    }
+
+    if (f != stdin)
+        fclose(f);
+    return ret;
+}
+
+static void writer_flush(WriterContext *wctx)
+{
+    if (wctx->avio)
+        avio_flush(wctx->avio);
+    else
+        fflush(stdout);
+}
+
+/**
+ * Open and probe one input of the batch, then print it as one file section.
+ * Opening runs concurrently with the other workers, printing does not.
+ */
+static void batch_probe_input(BatchContext *b, int idx)
+{
+    WriterContext *w = b->wctx;
+    InputFile ifile = { 0 };
+    int ret;
+
+    ret = open_input_file(&ifile, b->inputs[idx], NULL);
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&b->print_lock);
+#endif
+    writer_print_section_header(w, NULL, SECTION_ID_FILE);
+    print_int("index", idx);
+    print_str("filename", b->inputs[idx]);
+    if (ret >= 0)
+        ret = show_input(w, &ifile);
+    if (ret < 0 && do_show_error)
+        show_error(w, ret);
+    writer_print_section_footer(w);
+    writer_flush(w);
+    if (ret < 0 && !b->ret)
+        b->ret = ret;
+#if HAVE_THREADS
+    pthread_mutex_unlock(&b->print_lock);
+#endif
+
+    if (ifile.fmt_ctx)
+        close_input_file(&ifile);
+}
+
+static void *batch_worker(void *arg)
+{
+    BatchContext *b = arg;
+
+    for (;;) {
+        int idx;
+
+#if HAVE_THREADS
+        pthread_mutex_lock(&b->queue_lock);
+#endif
+        idx = b->next++;
+#if HAVE_THREADS
+        pthread_mutex_unlock(&b->queue_lock);
+#endif
+        if (idx >= b->nb_inputs)
+            break;
+        batch_probe_input(b, idx);
+    }
+    return NULL;
+}
+
+/**
+ * Probe every input listed in batch_filename with batch_threads workers,
+ * printing each one as soon as it is done, in completion order.
+ */
+static int probe_batch(WriterContext *wctx)
+{
+    BatchContext b = { .wctx = wctx };
+    int ret, i;
+
+    ret = batch_read_list(&b, batch_filename);
+    if (ret < 0)
+        goto end;
+
+    /* index and filename identify each entry, whatever -show_entries says */
+    if (!sections[SECTION_ID_FILE].entries_to_show)
+        sections[SECTION_ID_FILE].show_all_entries = 1;
+
+    writer_print_section_header(wctx, NULL, SECTION_ID_FILES);
+#if HAVE_THREADS
+    {
+        pthread_t *threads = NULL;
+        int nb_threads = batch_threads > 0 ? batch_threads : av_cpu_count();
+
+        /* the -show_log buffer is process-wide */
+        if (do_show_log)
+            nb_threads = 1;
+        nb_threads = FFMAX(1, FFMIN(nb_threads, b.nb_inputs));
+
+        pthread_mutex_init(&b.queue_lock, NULL);
+        pthread_mutex_init(&b.print_lock, NULL);
+        if (nb_threads > 1)
+            threads = av_calloc(nb_threads - 1, sizeof(*threads));
+        for (i = 0; threads && i < nb_threads - 1; i++) {
+            if (pthread_create(&threads[i], NULL, batch_worker, &b)) {
+                av_log(NULL, AV_LOG_WARNING, "Could only start %d batch threads\n", i + 1);
+                break;
+            }
+        }
+        /* the main thread takes part as well */
+        batch_worker(&b);
+        while (i-- > 0)
+            pthread_join(threads[i], NULL);
+        av_free(threads);
+        pthread_mutex_destroy(&b.queue_lock);
+        pthread_mutex_destroy(&b.print_lock);
+    }
+#else
+    batch_worker(&b);
+#endif
+    writer_print_section_footer(wctx);
+    ret = b.ret;
+
+end:
+    for (i = 0; i < b.nb_inputs; i++)
+        av_free(b.inputs[i]);
+    av_free(b.inputs);
+    return ret;
+}
+//PLEX
+
 static void show_usage(void)
 {
     av_log(NULL, AV_LOG_INFO, "Simple multimedia streams analyzer\n");
@@ -4123,6 +4320,12 @@ static const OptionDef real_options[] = {
     { "print_filename", HAS_ARG, {.func_arg = opt_print_filename}, "override the printed input filename", "print_file"},
     { "find_stream_info", OPT_BOOL | OPT_INPUT | OPT_EXPERT, { &find_stream_info },
         "read and decode the streams to fill missing information with heuristics" },
+    //PLEX
+    { "batch", OPT_STRING | HAS_ARG, { &batch_filename },
+      "probe all the inputs listed in the specified file, one per line", "list_file" },
+    { "batch_threads", OPT_INT | HAS_ARG, { &batch_threads },
+      "number of inputs probed in parallel in batch mode (0 for automatic)", "count" },
+    //PLEX
     { NULL, },
 };
 
@@ -4174,8 +4377,13 @@ int main(int argc, char **argv)
         goto end;
     }
 
-    if (do_show_log)
+    if (do_show_log) {
         av_log_set_callback(log_callback);
+        // For loging it is needed to disable at least frame threads as otherwise
+        // the log information would need to be reordered and matches up to contexts and frames
+        // That is in fact possible but not trivial
+        av_dict_set(&codec_opts, "threads", "1", 0);
+    }
 
     /* mark things to show, based on -show_entries */
     SET_DO_SHOW(CHAPTERS, chapters);
@@ -4262,13 +4470,20 @@ int main(int argc, char **argv)
         if (do_show_pixel_formats)
             ffprobe_show_pixel_formats(wctx);
 
-        if (!input_filename &&
+        if (!input_filename && !batch_filename &&
             ((do_show_format || do_show_programs || do_show_streams || do_show_chapters || do_show_packets || do_show_error) ||
              (!do_show_program_version && !do_show_library_versions && !do_show_pixel_formats))) {
             show_usage();
             av_log(NULL, AV_LOG_ERROR, "You have to specify one input file.\n");
             av_log(NULL, AV_LOG_ERROR, "Use -h to get full help or, even better, run 'man %s'.\n", program_name);
             ret = AVERROR(EINVAL);
+        //PLEX
+        } else if (input_filename && batch_filename) {
+            av_log(NULL, AV_LOG_ERROR, "An input file and -batch cannot be used together.\n");
+            ret = AVERROR(EINVAL);
+        } else if (batch_filename) {
+            ret = probe_batch(wctx);
+        //PLEX
         } else if (input_filename) {
             ret = probe_file(wctx, input_filename, print_input_filename);
             if (ret < 0 && do_show_error)
@@ -4288,6 +4503,7 @@ int main(int argc, char **argv)
 end:
     av_freep(&output_format);
     av_freep(&read_intervals);
+    av_freep(&batch_filename); //PLEX
     av_hash_freep(&hash);
 
     uninit_opts();
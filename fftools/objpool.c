@@ -34,6 +34,11 @@ struct ObjPool {
     ObjPoolCBAlloc alloc;
     ObjPoolCBReset reset;
     ObjPoolCBFree  free;
+
+    //PLEX
+    uint64_t nb_get;
+    uint64_t nb_reused;
+    //PLEX
 };
 
 ObjPool *objpool_alloc(ObjPoolCBAlloc cb_alloc, ObjPoolCBReset cb_reset,
@@ -66,9 +71,11 @@ void objpool_free(ObjPool **pop)
 
 int  objpool_get(ObjPool *op, void **obj)
 {
+    op->nb_get++; //PLEX
     if (op->pool_count) {
         *obj = op->pool[--op->pool_count];
         op->pool[op->pool_count] = NULL;
+        op->nb_reused++; //PLEX
     } else
         *obj = op->alloc();
 
@@ -90,6 +97,14 @@ void objpool_release(ObjPool *op, void **obj)
     *obj = NULL;
 }
 
+//PLEX
+void objpool_stats(const ObjPool *op, uint64_t *nb_get, uint64_t *nb_reused)
+{
+    *nb_get    = op->nb_get;
+    *nb_reused = op->nb_reused;
+}
+//PLEX
+
 static void *alloc_packet(void)
 {
     return av_packet_alloc();
@@ -19,6 +19,8 @@
 #ifndef FFTOOLS_OBJPOOL_H
 #define FFTOOLS_OBJPOOL_H
 
+#include <stdint.h>
+
 typedef struct ObjPool ObjPool;
 
 typedef void* (*ObjPoolCBAlloc)(void);
@@ -34,4 +36,9 @@ ObjPool *objpool_alloc_frames(void);
 int  objpool_get(ObjPool *op, void **obj);
 void objpool_release(ObjPool *op, void **obj);
 
+//PLEX
+/* number of objpool_get() calls, and how many returned a recycled object */
+void objpool_stats(const ObjPool *op, uint64_t *nb_get, uint64_t *nb_reused);
+//PLEX
+
 #endif // FFTOOLS_OBJPOOL_H
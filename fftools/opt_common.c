@@ -1086,6 +1086,24 @@ int opt_cpucount(void *optctx, const char *opt, const char *arg)
     return ret;
 }
 
+//PLEX
+int opt_numa_node(void *optctx, const char *opt, const char *arg)
+{
+    double node;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_INT64, 0, INT_MAX, &node);
+    if (ret < 0)
+        return ret;
+
+    ret = av_cpu_bind_numa_node(node);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "Failed to bind to NUMA node %d: %s\n",
+               (int)node, av_err2str(ret));
+    return ret;
+}
+//PLEX
+
 static void expand_filename_template(AVBPrint *bp, const char *template,
                                      struct tm *tm)
 {
@@ -1234,6 +1252,22 @@ int opt_max_alloc(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+//PLEX
+int opt_huge_pages(void *optctx, const char *opt, const char *arg)
+{
+    char *tail;
+    size_t min_size;
+
+    min_size = strtol(arg, &tail, 10);
+    if (*tail) {
+        av_log(NULL, AV_LOG_FATAL, "Invalid hugepages \"%s\".\n", arg);
+        return AVERROR(EINVAL);
+    }
+    av_huge_page_alloc(min_size);
+    return 0;
+}
+//PLEX
+
 int opt_loglevel(void *optctx, const char *opt, const char *arg)
 {
     const struct { const char *name; int level; } log_levels[] = {
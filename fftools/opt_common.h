@@ -186,6 +186,13 @@ int init_report(const char *env, FILE **file);
 
 int opt_max_alloc(void *optctx, const char *opt, const char *arg);
 
+//PLEX
+/**
+ * Use transparent huge pages for allocations of at least the given size.
+ */
+int opt_huge_pages(void *optctx, const char *opt, const char *arg);
+//PLEX
+
 /**
  * Override the cpuflags.
  */
@@ -196,6 +203,13 @@ int opt_cpuflags(void *optctx, const char *opt, const char *arg);
  */
 int opt_cpucount(void *optctx, const char *opt, const char *arg);
 
+//PLEX
+/**
+ * Bind the process threads and memory to a NUMA node.
+ */
+int opt_numa_node(void *optctx, const char *opt, const char *arg);
+//PLEX
+
 #define CMDUTILS_COMMON_OPTIONS                                                                                         \
     { "L",           OPT_EXIT,             { .func_arg = show_license },     "show license" },                          \
     { "h",           OPT_EXIT,             { .func_arg = show_help },        "show help", "topic" },                    \
@@ -223,8 +237,10 @@ int opt_cpucount(void *optctx, const char *opt, const char *arg);
     { "v",           HAS_ARG,              { .func_arg = opt_loglevel },     "set logging level", "loglevel" },         \
     { "report",      0,                    { .func_arg = opt_report },       "generate a report" },                     \
     { "max_alloc",   HAS_ARG,              { .func_arg = opt_max_alloc },    "set maximum size of a single allocated block", "bytes" }, \
+    { "hugepages",   HAS_ARG | OPT_EXPERT, { .func_arg = opt_huge_pages },   "use transparent huge pages for blocks of at least this size", "bytes" }, \
     { "cpuflags",    HAS_ARG | OPT_EXPERT, { .func_arg = opt_cpuflags },     "force specific cpu flags", "flags" },     \
     { "cpucount",    HAS_ARG | OPT_EXPERT, { .func_arg = opt_cpucount },     "force specific cpu count", "count" },     \
+    { "numa_node",   HAS_ARG | OPT_EXPERT, { .func_arg = opt_numa_node },    "run on the CPUs and memory of a NUMA node", "node" }, \
     { "hide_banner", OPT_BOOL | OPT_EXPERT, {&hide_banner},     "do not show program banner", "hide_banner" },          \
     CMDUTILS_COMMON_OPTIONS_AVDEVICE                                                                                    \
 
@@ -20,17 +20,26 @@
 
 #include "plex.h"
 #include "ffmpeg.h"
+#include "ffmpeg_mux.h"
 #include "opt_common.h"
 
 #include "config_components.h"
 
 #include <sys/types.h>
 #include <limits.h>
+#if HAVE_FCNTL
+#include <fcntl.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #include "strings.h"
 #include "libavcodec/mpegvideo.h"
 #include "libavfilter/vf_inlineass.h"
 #include "libavformat/http.h"
 #include "libavutil/bprint.h"
+#include "libavutil/time.h"
+#include "libavutil/tracepoint.h"
 #include "libavutil/timestamp.h"
 #include "libavformat/internal.h"
 #include "libavutil/thread.h"
@@ -38,6 +47,7 @@
 PlexContext plexContext = {0};
 
 #define LOG_LINE_SIZE 1024
+#define LOG_MSG_SIZE  2048             // a formatted PMS_Log() line
 
 #if HAVE_PTHREADS
 static pthread_key_t logging_key, using_http_key, cur_line_key;
@@ -63,10 +73,12 @@ int av_log_get_level_plex(void)
 void av_log_set_level_plex(int level)
 {
     av_log_level_plex = level;
+    av_log_set_callback_level(level);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-char* PMS_IssueHttpRequest(const char* url, const char* verb)
+static char *issue_http_request(const char *url, const char *verb,
+                                const uint8_t *body, int body_size)
 {
     char* reply = NULL;
     static AVIOContext *ioctx = NULL;
@@ -74,6 +86,7 @@ char* PMS_IssueHttpRequest(const char* url, const char* verb)
     int size = 0;
     int ret = 0;
     const char *token = getenv("X_PLEX_TOKEN");
+    PlexStageTimer timer;
 #if HAVE_PTHREADS
     pthread_once(&key_once, make_keys);
 #else
@@ -91,10 +104,14 @@ char* PMS_IssueHttpRequest(const char* url, const char* verb)
 #endif
 
     pthread_mutex_lock(&req_mutex);
+    plex_stage_start(&timer);
 
     if (ioctx) {
         // Try to reuse the existing context
-        if ((ret = avformat_http_do_new_request(ioctx, url, verb)) < 0)
+        av_opt_set_bin(ioctx, "post_data", body, body_size, AV_OPT_SEARCH_CHILDREN);
+        ret = avformat_http_do_new_request(ioctx, url, verb);
+        av_opt_set_bin(ioctx, "post_data", NULL, 0, AV_OPT_SEARCH_CHILDREN);
+        if (ret < 0)
             avio_closep(&ioctx);
     }
 
@@ -102,16 +119,28 @@ char* PMS_IssueHttpRequest(const char* url, const char* verb)
         AVDictionary *settings = NULL;
         av_dict_set(&settings, "method", verb, 0);
         av_dict_set(&settings, "multiple_requests", "1", 0);
+        av_dict_set(&settings, "connection_pool", "1", 0);
         if (token && *token) {
             char headers[1024];
             snprintf(headers, sizeof(headers), "X-Plex-Token: %s\r\nX-Plex-Http-Pipeline: infinite\r\n", token);
             av_dict_set(&settings, "headers", headers, 0);
         }
+        if (body_size > 0) {
+            // Binary options are passed as hex strings through dictionaries.
+            AVBPrint hex;
+            av_bprint_init(&hex, 2 * body_size + 1, AV_BPRINT_SIZE_UNLIMITED);
+            for (int i = 0; i < body_size; i++)
+                av_bprintf(&hex, "%02x", body[i]);
+            if (av_bprint_is_complete(&hex))
+                av_dict_set(&settings, "post_data", hex.str, 0);
+            av_bprint_finalize(&hex, NULL);
+        }
 
         ret = avio_open2(&ioctx, url, AVIO_FLAG_READ, NULL, &settings);
         av_dict_free(&settings);
         if (ret < 0)
             goto fail;
+        av_opt_set_bin(ioctx, "post_data", NULL, 0, AV_OPT_SEARCH_CHILDREN);
     }
 
     size = avio_size(ioctx);
@@ -142,15 +171,639 @@ fail:
     using_http = 0;
 #endif
 
+    plex_stage_end(PLEX_STAGE_NETWORK, &timer);
     pthread_mutex_unlock(&req_mutex);
 
     return reply;
 }
 
+char* PMS_IssueHttpRequest(const char* url, const char* verb)
+{
+    char *reply;
+
+    FF_TRACE2(http_request_start, url, verb);
+    reply = issue_http_request(url, verb, NULL, 0);
+    FF_TRACE3(http_request_end, url, verb, !!reply);
+    return reply;
+}
+
+#define THROTTLE_SPEED     1.5
+#define THROTTLE_BURST     2000000          // media time allowed to run ahead at once, in microseconds
+#define THROTTLE_MAX_JUMP  10000000         // larger timestamp jumps restart the governor
+
+/**
+ * Token bucket pacing the transcode while throttled. Tokens are media time in
+ * microseconds; they accrue at throttle_speed times the wall clock and are
+ * spent as input timestamps advance.
+ */
+typedef struct PlexThrottle {
+#if HAVE_PTHREADS
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+#endif
+    int64_t         last_ts;
+    int64_t         last_time;
+    double          tokens;
+} PlexThrottle;
+
+static PlexThrottle throttle = { .last_ts = AV_NOPTS_VALUE, .last_time = AV_NOPTS_VALUE };
+
+#if HAVE_PTHREADS
+static pthread_once_t throttle_once = PTHREAD_ONCE_INIT;
+
+static void throttle_init(void)
+{
+    pthread_mutex_init(&throttle.lock, NULL);
+    pthread_cond_init(&throttle.cond, NULL);
+}
+#endif
+
+static void throttle_refill(PlexThrottle *t, double speed)
+{
+    int64_t now = av_gettime_relative();
+
+    t->tokens    = FFMIN(t->tokens + (now - t->last_time) * speed, THROTTLE_BURST);
+    t->last_time = now;
+}
+
+/**
+ * Seek requested by the server in a progress reply, taken by the main thread.
+ */
+static struct {
+#if HAVE_PTHREADS
+    pthread_mutex_t lock;
+#endif
+    int64_t         ts;
+    int             segment;
+    atomic_int      pending;            // also read by plex_throttle() unlocked
+} seek_request = {
+#if HAVE_PTHREADS
+    .lock    = PTHREAD_MUTEX_INITIALIZER,
+#endif
+    .ts      = AV_NOPTS_VALUE,
+    .segment = -1,
+};
+
+static void seek_set_requested(const char *reply)
+{
+    const char *p;
+    char *end;
+    double ts;
+    long segment = -1;
+
+    if (!reply || !(p = strstr(reply, "seek=")))
+        return;
+    ts = strtod(p + 5, &end);
+    if (end == p + 5 || !isfinite(ts) || ts < 0 || ts > INT64_MAX / AV_TIME_BASE)
+        return;
+    if ((p = strstr(reply, "segment=")))
+        segment = strtol(p + 8, NULL, 10);
+
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&seek_request.lock);
+#endif
+    // A newer request replaces one that was not taken yet.
+    seek_request.ts      = llrint(ts * AV_TIME_BASE);
+    seek_request.segment = segment >= 0 && segment <= INT_MAX ? segment : -1;
+    atomic_store(&seek_request.pending, 1);
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&seek_request.lock);
+
+    // Wake a paced transcode so that it takes the seek right away.
+    pthread_once(&throttle_once, throttle_init);
+    pthread_mutex_lock(&throttle.lock);
+    pthread_cond_broadcast(&throttle.cond);
+    pthread_mutex_unlock(&throttle.lock);
+#endif
+}
+
+int plex_seek_take(int64_t *ts, int *segment)
+{
+    int ret = 0;
+
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&seek_request.lock);
+#endif
+    if (seek_request.ts != AV_NOPTS_VALUE) {
+        *ts      = seek_request.ts;
+        *segment = seek_request.segment;
+        seek_request.ts      = AV_NOPTS_VALUE;
+        seek_request.segment = -1;
+        atomic_store(&seek_request.pending, 0);
+        ret = 1;
+    }
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&seek_request.lock);
+#endif
+    return ret;
+}
+
+void plex_throttle(int64_t ts)
+{
+    PlexThrottle *t = &throttle;
+    double speed = plexContext.throttle_speed > 0 ? plexContext.throttle_speed : THROTTLE_SPEED;
+
+    if (ts == AV_NOPTS_VALUE)
+        return;
+
+#if HAVE_PTHREADS
+    pthread_once(&throttle_once, throttle_init);
+    pthread_mutex_lock(&t->lock);
+#endif
+
+    if (!atomic_load(&plexContext.can_throttle) ||
+        t->last_ts == AV_NOPTS_VALUE || t->last_time == AV_NOPTS_VALUE ||
+        FFABS(ts - t->last_ts) > THROTTLE_MAX_JUMP) {
+        // Not throttled, just started, or seeked: run ahead by a full burst.
+        t->last_ts   = ts;
+        t->last_time = av_gettime_relative();
+        t->tokens    = THROTTLE_BURST;
+        goto end;
+    }
+
+    // Streams are interleaved, so only charge for the furthest timestamp.
+    if (ts > t->last_ts) {
+        t->tokens -= ts - t->last_ts;
+        t->last_ts = ts;
+    }
+    throttle_refill(t, speed);
+
+    while (t->tokens < 0 && atomic_load(&plexContext.can_throttle) &&
+           !atomic_load(&seek_request.pending)) {
+        int64_t wait = -t->tokens / speed + 1;
+#if HAVE_PTHREADS
+        int64_t deadline = av_gettime() + wait;
+        struct timespec abstime = { .tv_sec  = deadline / 1000000,
+                                    .tv_nsec = deadline % 1000000 * 1000 };
+        pthread_cond_timedwait(&t->cond, &t->lock, &abstime);
+#else
+        av_usleep(wait);
+#endif
+        throttle_refill(t, speed);
+    }
+
+end:
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&t->lock);
+#endif
+    return;
+}
+
+static void throttle_set_allowed(const char *reply)
+{
+    int allowed = reply && strstr(reply, "canThrottle");
+
+    if (atomic_exchange(&plexContext.can_throttle, allowed) && !allowed) {
+        // Wake a paced transcode right away, e.g. after a seek.
+#if HAVE_PTHREADS
+        pthread_once(&throttle_once, throttle_init);
+        pthread_mutex_lock(&throttle.lock);
+        pthread_cond_broadcast(&throttle.cond);
+        pthread_mutex_unlock(&throttle.lock);
+#endif
+    }
+}
+
+static void reply_process(const char *reply)
+{
+    throttle_set_allowed(reply);
+    seek_set_requested(reply);
+}
+
+#define REPORT_QUEUE_SIZE 64
+
+#define LOG_RING_SIZE      256              // must be a power of two
+#define LOG_BATCH_SIZE     32               // flush once this many lines are pending
+#define LOG_FLUSH_INTERVAL 500000           // or at least this often, in microseconds
+
+typedef struct PlexRequest {
+    char       *url;
+    const char *verb;
+} PlexRequest;
+
+/**
+ * One pending log line. The ring follows the usual bounded MPSC scheme:
+ * seq == pos means the slot is free for the producer claiming pos,
+ * seq == pos + 1 means it holds the message for position pos.
+ */
+typedef struct PlexLogSlot {
+    atomic_size_t seq;
+    int           level;
+    char          msg[LOG_MSG_SIZE];
+} PlexLogSlot;
+
+typedef struct PlexReporter {
+#if HAVE_PTHREADS
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+#endif
+    atomic_int      running;            ///< read without the lock by the producers
+    int             finished;
+
+    char           *progress;           ///< most recent progress URL, coalesced
+    char           *record;             ///< most recent JSON progress record, coalesced
+    AVIOContext    *record_pb;          ///< opened on the first record
+    int             record_failed;
+    AVFifo         *requests;           ///< pending PlexRequest, bounded
+    unsigned        nb_dropped;
+
+    PlexLogSlot     log_ring[LOG_RING_SIZE];
+    atomic_size_t   log_head;           ///< next position claimed by a producer
+    atomic_size_t   log_tail;           ///< next position read by the reporter
+    atomic_uint     log_dropped;        ///< lines lost to a full ring
+    int64_t         log_flushed;        ///< time of the last flush
+} PlexReporter;
+
+static PlexReporter reporter;
+
+/**
+ * Write one JSON progress record as a line. The output is opened on first
+ * use, and given up on at the first error so a closed pipe costs nothing.
+ */
+static void record_write(PlexReporter *r, const char *record)
+{
+    int ret;
+
+    if (r->record_failed)
+        return;
+    if (!r->record_pb &&
+        (ret = avio_open2(&r->record_pb, plexContext.progress_json,
+                          AVIO_FLAG_WRITE, NULL, NULL)) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "Cannot open progress output %s: %s\n",
+               plexContext.progress_json, av_err2str(ret));
+        r->record_failed = 1;
+        return;
+    }
+
+    avio_write(r->record_pb, (const unsigned char *)record, strlen(record));
+    avio_w8(r->record_pb, '\n');
+    avio_flush(r->record_pb);
+    if (r->record_pb->error < 0) {
+        av_log(NULL, AV_LOG_WARNING, "Error writing progress output: %s\n",
+               av_err2str(r->record_pb->error));
+        r->record_failed = 1;
+    }
+}
+
+#if HAVE_PTHREADS
+static pthread_once_t reporter_once = PTHREAD_ONCE_INIT;
+
+static size_t log_pending(PlexReporter *r)
+{
+    return atomic_load_explicit(&r->log_head, memory_order_acquire) -
+           atomic_load_explicit(&r->log_tail, memory_order_relaxed);
+}
+
+static int log_push(PlexReporter *r, int level, const char *msg)
+{
+    size_t pos = atomic_load_explicit(&r->log_head, memory_order_relaxed);
+    PlexLogSlot *slot;
+
+    while (1) {
+        size_t seq;
+
+        slot = &r->log_ring[pos & (LOG_RING_SIZE - 1)];
+        seq  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(&r->log_head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if ((ptrdiff_t)(seq - pos) < 0) {
+            atomic_fetch_add_explicit(&r->log_dropped, 1, memory_order_relaxed);
+            return AVERROR(ENOSPC);
+        } else {
+            pos = atomic_load_explicit(&r->log_head, memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    av_strlcpy(slot->msg, msg, sizeof(slot->msg));
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    return log_pending(r) >= LOG_BATCH_SIZE;
+}
+
+static int log_flush_due(PlexReporter *r)
+{
+    size_t pending = log_pending(r);
+
+    return pending >= LOG_BATCH_SIZE ||
+           (pending && (r->finished ||
+                        av_gettime() - r->log_flushed >= LOG_FLUSH_INTERVAL));
+}
+
+/**
+ * Send all pending log lines in a single POST. Each body line carries the
+ * same level=...&message=... pair the single-message endpoint takes.
+ */
+static void log_flush(PlexReporter *r)
+{
+    size_t tail = atomic_load_explicit(&r->log_tail, memory_order_relaxed);
+    char url[1024];
+    AVBPrint body;
+    unsigned dropped;
+
+    av_bprint_init(&body, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    while (1) {
+        PlexLogSlot *slot = &r->log_ring[tail & (LOG_RING_SIZE - 1)];
+
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != tail + 1)
+            break;
+
+        av_bprintf(&body, "level=%d&message=", slot->level);
+        av_bprint_escape(&body, slot->msg, NULL, AV_ESCAPE_MODE_URL, 0);
+        av_bprint_chars(&body, '\n', 1);
+
+        atomic_store_explicit(&slot->seq, tail + LOG_RING_SIZE,
+                              memory_order_release);
+        atomic_store_explicit(&r->log_tail, ++tail, memory_order_relaxed);
+    }
+
+    dropped = atomic_exchange_explicit(&r->log_dropped, 0, memory_order_relaxed);
+    if (dropped)
+        av_bprintf(&body, "level=%d&message=Dropped%%20%u%%20log%%20messages\n",
+                   LOG_LEVEL_WARNING, dropped);
+
+    if (plexContext.progress_url)
+        snprintf(url, sizeof(url), "%s/log?batch=1", plexContext.progress_url);
+    else
+        snprintf(url, sizeof(url), "http://127.0.0.1:32400/log?source=Transcoder&batch=1");
+
+    if (body.len && av_bprint_is_complete(&body))
+        av_free(issue_http_request(url, "POST", (const uint8_t *)body.str, body.len));
+
+    av_bprint_finalize(&body, NULL);
+    r->log_flushed = av_gettime();
+}
+
+static void reporter_wait(PlexReporter *r)
+{
+    struct timespec ts;
+    int64_t deadline;
+
+    if (!log_pending(r)) {
+        pthread_cond_wait(&r->cond, &r->lock);
+        return;
+    }
+
+    deadline   = r->log_flushed + LOG_FLUSH_INTERVAL;
+    ts.tv_sec  = deadline / 1000000;
+    ts.tv_nsec = deadline % 1000000 * 1000;
+    pthread_cond_timedwait(&r->cond, &r->lock, &ts);
+}
+
+static void *reporter_thread(void *arg)
+{
+    PlexReporter *r = arg;
+
+    ff_thread_setname("plex-report");
+
+    // Anything logged while talking to the server must not be reported back.
+    pthread_setspecific(logging_key, (void*)1);
+
+    pthread_mutex_lock(&r->lock);
+    while (1) {
+        PlexRequest req;
+        char *progress, *record;
+
+        while (!r->finished && !r->progress && !r->record &&
+               !av_fifo_can_read(r->requests) && !log_flush_due(r))
+            reporter_wait(r);
+
+        if (log_flush_due(r)) {
+            pthread_mutex_unlock(&r->lock);
+            log_flush(r);
+            pthread_mutex_lock(&r->lock);
+        } else if (av_fifo_read(r->requests, &req, 1) >= 0) {
+            pthread_mutex_unlock(&r->lock);
+            av_free(PMS_IssueHttpRequest(req.url, req.verb));
+            av_free(req.url);
+            pthread_mutex_lock(&r->lock);
+        } else if ((progress = r->progress)) {
+            char *reply;
+
+            r->progress = NULL;
+            pthread_mutex_unlock(&r->lock);
+
+            reply = PMS_IssueHttpRequest(progress, "PUT");
+            reply_process(reply);
+            av_free(reply);
+            av_free(progress);
+
+            pthread_mutex_lock(&r->lock);
+        } else if ((record = r->record)) {
+            r->record = NULL;
+            pthread_mutex_unlock(&r->lock);
+
+            record_write(r, record);
+            av_free(record);
+
+            pthread_mutex_lock(&r->lock);
+        } else if (r->finished) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return NULL;
+}
+
+static void reporter_start(void)
+{
+    PlexReporter *r = &reporter;
+
+    pthread_once(&key_once, make_keys);
+
+    r->requests = av_fifo_alloc2(REPORT_QUEUE_SIZE, sizeof(PlexRequest), 0);
+    if (!r->requests)
+        return;
+
+    for (size_t i = 0; i < LOG_RING_SIZE; i++)
+        atomic_init(&r->log_ring[i].seq, i);
+    atomic_init(&r->log_head, 0);
+    atomic_init(&r->log_tail, 0);
+    atomic_init(&r->log_dropped, 0);
+    r->log_flushed = av_gettime();
+
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cond, NULL);
+
+    if (pthread_create(&r->thread, NULL, reporter_thread, r)) {
+        pthread_cond_destroy(&r->cond);
+        pthread_mutex_destroy(&r->lock);
+        av_fifo_freep2(&r->requests);
+        return;
+    }
+    atomic_store(&r->running, 1);
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static int reporter_submit(char *url, const char *verb, int progress)
+{
+#if HAVE_PTHREADS
+    PlexReporter *r = &reporter;
+
+    pthread_once(&reporter_once, reporter_start);
+    if (!atomic_load(&r->running))
+        return AVERROR(ENOSYS);
+
+    pthread_mutex_lock(&r->lock);
+    if (r->finished) {
+        pthread_mutex_unlock(&r->lock);
+        return AVERROR_EOF;
+    }
+
+    if (progress) {
+        av_free(r->progress);
+        r->progress = url;
+    } else if (av_fifo_write(r->requests, &(PlexRequest){ url, verb }, 1) < 0) {
+        r->nb_dropped++;
+        av_free(url);
+    }
+
+    pthread_cond_signal(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static int reporter_submit_record(char *record)
+{
+#if HAVE_PTHREADS
+    PlexReporter *r = &reporter;
+
+    pthread_once(&reporter_once, reporter_start);
+    if (!atomic_load(&r->running))
+        return AVERROR(ENOSYS);
+
+    pthread_mutex_lock(&r->lock);
+    if (r->finished) {
+        pthread_mutex_unlock(&r->lock);
+        return AVERROR_EOF;
+    }
+    av_free(r->record);
+    r->record = record;
+    pthread_cond_signal(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static int reporter_log(int level, const char *msg)
+{
+#if HAVE_PTHREADS
+    PlexReporter *r = &reporter;
+    int ret;
+
+    pthread_once(&reporter_once, reporter_start);
+    if (!atomic_load(&r->running))
+        return AVERROR(ENOSYS);
+
+    ret = log_push(r, level, msg);
+    if (ret > 0) {
+        // Enough lines for a batch; don't wait for the flush timer.
+        pthread_mutex_lock(&r->lock);
+        pthread_cond_signal(&r->cond);
+        pthread_mutex_unlock(&r->lock);
+    }
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+void plex_report_progress(const char *url)
+{
+    char *dup = av_strdup(url);
+    char *reply;
+
+    if (dup && reporter_submit(dup, "PUT", 1) >= 0)
+        return;
+    av_free(dup);
+
+    // No reporter thread available; fall back to a blocking request.
+    reply = PMS_IssueHttpRequest(url, "PUT");
+    reply_process(reply);
+    av_free(reply);
+}
+
+// like progress URLs, only the newest record is kept while the output is busy
+static void report_record(const char *record)
+{
+    char *dup = av_strdup(record);
+
+    if (dup && reporter_submit_record(dup) >= 0)
+        return;
+    av_free(dup);
+
+    record_write(&reporter, record);
+}
+
+void plex_report_request(const char *url, const char *verb)
+{
+    char *dup = av_strdup(url);
+
+    if (dup && reporter_submit(dup, verb, 0) >= 0)
+        return;
+    av_free(dup);
+
+    av_free(PMS_IssueHttpRequest(url, verb));
+}
+
+void plex_uninit(void)
+{
+    PlexReporter *r = &reporter;
+#if HAVE_PTHREADS
+    PlexRequest req;
+
+    if (!atomic_load(&r->running))
+        goto end;
+
+    // Let the thread drain whatever is still queued before it exits;
+    // anything reported from now on is sent synchronously.
+    pthread_mutex_lock(&r->lock);
+    r->finished = 1;
+    atomic_store(&r->running, 0);
+    pthread_cond_signal(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+
+    pthread_join(r->thread, NULL);
+
+    if (log_pending(r))
+        log_flush(r);
+
+    while (av_fifo_read(r->requests, &req, 1) >= 0)
+        av_free(req.url);
+    av_fifo_freep2(&r->requests);
+    av_freep(&r->progress);
+
+    pthread_cond_destroy(&r->cond);
+    pthread_mutex_destroy(&r->lock);
+
+    if (r->nb_dropped)
+        av_log(NULL, AV_LOG_WARNING, "Dropped %u requests to the media server\n",
+               r->nb_dropped);
+end:
+#endif
+    av_freep(&r->record);
+    avio_closep(&r->record_pb);
+}
+
 void PMS_Log(LogLevel level, const char* format, ...)
 {
     // Format the mesage.
-    char msg[2048];
+    char msg[LOG_MSG_SIZE];
     char url[4096];
     va_list va;
     AVBPrint dstbuf;
@@ -161,6 +814,10 @@ void PMS_Log(LogLevel level, const char* format, ...)
     vsnprintf(msg, sizeof(msg), format, va);
     va_end(va);
 
+    // Batched by the reporter thread; a full ring drops the line.
+    if (reporter_log(level, msg) >= 0)
+        return;
+
     av_bprint_init_for_buffer(&dstbuf, url, sizeof(url));
 
     // Build the URL.
@@ -255,7 +912,7 @@ void plex_report_stream(const AVStream *st)
             av_bprint_escape(&dstbuf, profile, NULL, AV_ESCAPE_MODE_URL, 0);
         }
 
-        av_free(PMS_IssueHttpRequest(url, "PUT"));
+        plex_report_request(url, "PUT");
     }
 }
 
@@ -358,7 +1015,7 @@ void plex_report_stream_detail(AVStream *st)
         SEND_DISPOSITION(DEPENDENT,        "dependent");
         SEND_DISPOSITION(STILL_IMAGE,      "still_image");
 
-        av_free(PMS_IssueHttpRequest(url, "PUT"));
+        plex_report_request(url, "PUT");
     }
 }
 
@@ -366,7 +1023,9 @@ void plex_report_stream_detail(AVStream *st)
 void plex_init(int argc, char **argv, const OptionDef *options)
 {
     int idx;
+    plexContext.start_time = av_gettime_relative();
     av_log_set_callback(plex_log_callback);
+    av_log_set_callback_level(av_log_level_plex);
 
     idx = locate_option(argc, argv, options, "loglevel_plex");
     if (idx && argv[idx + 1])
@@ -410,19 +1069,18 @@ void plex_link_subtitles_to_graph(AVFilterGraph* g)
                 if (assCtx->width && assCtx->height)
                     avfilter_inlineass_set_storage_size(ctx, assCtx->width, assCtx->height);
 
-                for (int j = 0; j < nb_input_streams; j++) {
-                    InputStream *ist = input_streams[j];
+                for (InputStream *ist = ist_iter(NULL); ist; ist = ist_iter(ist)) {
                     if (ist->st->codecpar->codec_type == AVMEDIA_TYPE_ATTACHMENT)
                         avfilter_inlineass_add_attachment(ctx, ist->st);
                     if (ist->file_index == assCtx->file_index &&
                         ist->st->index == assCtx->stream_index &&
-                        ist->sub2video.sub_queue) {
-                        while (av_fifo_can_read(ist->sub2video.sub_queue)) {
-                            AVSubtitle tmp;
-                            av_fifo_read(ist->sub2video.sub_queue, &tmp, 1);
+                        assCtx->pending) {
+                        AVSubtitle tmp;
+                        while (av_fifo_read(assCtx->pending, &tmp, 1) >= 0) {
                             plex_process_subtitles(ist, &tmp);
                             avsubtitle_free(&tmp);
                         }
+                        av_fifo_freep2(&assCtx->pending);
                     }
                 }
 
@@ -484,8 +1142,19 @@ int plex_process_subtitles(const InputStream *ist, AVSubtitle *sub)
         InlineAssContext *ctx = &plexContext.inlineass_ctxs[i];
         if (ist->st->index == ctx->stream_index &&
             ist->file_index == ctx->file_index) {
-            if (!ctx->ctx)
+            if (!ctx->ctx) {
+                // Keep it until the filtergraph is configured.
+                AVSubtitle copy;
+                if (!ctx->pending)
+                    ctx->pending = av_fifo_alloc2(8, sizeof(AVSubtitle), AV_FIFO_FLAG_AUTO_GROW);
+                if (!ctx->pending || copy_av_subtitle(&copy, sub) < 0)
+                    return AVERROR(ENOMEM);
+                if (av_fifo_write(ctx->pending, &copy, 1) < 0) {
+                    avsubtitle_free(&copy);
+                    return AVERROR(ENOMEM);
+                }
                 return 1;
+            }
             avfilter_inlineass_append_data(ctx->ctx, ist->dec_ctx, sub);
             return 2;
         }
@@ -494,6 +1163,86 @@ int plex_process_subtitles(const InputStream *ist, AVSubtitle *sub)
     return 0;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int plex_hw_session_acquire(void *logctx, const AVCodec *codec)
+{
+#if HAVE_FCNTL
+    // Record locks belong to the process and are dropped when any of its
+    // descriptors for the file is closed, so remember the slots taken here,
+    // for each device type since every type has its own lock files.
+    static AVMutex lock = AV_MUTEX_INITIALIZER;
+    static struct {
+        char     type[32];
+        uint64_t held;
+    } slots[16];
+    static int nb_slots;
+    const AVCodecHWConfig *config = avcodec_get_hw_config(codec, 0);
+    const char *type = config ? av_hwdevice_get_type_name(config->device_type) : NULL;
+    int limit = FFMIN(plexContext.hw_session_limit, 64);
+    int ret = AVERROR(EBUSY);
+    uint64_t *held = NULL;
+
+    if (!plexContext.hw_session_dir || limit <= 0 ||
+        !(codec->capabilities & AV_CODEC_CAP_HARDWARE))
+        return 0;
+    if (!type)
+        type = codec->name;
+
+    ff_mutex_lock(&lock);
+    for (int i = 0; i < nb_slots && !held; i++)
+        if (!strcmp(slots[i].type, type))
+            held = &slots[i].held;
+    if (!held) {
+        if (nb_slots == FF_ARRAY_ELEMS(slots)) {
+            ff_mutex_unlock(&lock);
+            av_log(logctx, AV_LOG_ERROR, "Too many hardware device types\n");
+            return AVERROR(ENOSPC);
+        }
+        av_strlcpy(slots[nb_slots].type, type, sizeof(slots[nb_slots].type));
+        held = &slots[nb_slots++].held;
+    }
+
+    for (int i = 0; i < limit; i++) {
+        struct flock fl = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+        char path[1024];
+        int fd;
+
+        if (*held & (1ULL << i))
+            continue;
+
+        snprintf(path, sizeof(path), "%s/%s-session-%d.lock",
+                 plexContext.hw_session_dir, type, i);
+        fd = open(path, O_RDWR | O_CREAT, 0666);
+        if (fd < 0) {
+            ret = AVERROR(errno);
+            av_log(logctx, AV_LOG_ERROR, "Could not open session slot %s: %s\n",
+                   path, av_err2str(ret));
+            break;
+        }
+        // the descriptor stays open, and the slot locked, until exit
+        if (!fcntl(fd, F_SETLK, &fl)) {
+            *held |= 1ULL << i;
+            atomic_store(&plexContext.hw_session_slot, i + 1);
+            av_log(logctx, AV_LOG_VERBOSE, "Using %s session slot %d of %d\n",
+                   type, i, limit);
+            ret = 0;
+            break;
+        }
+        close(fd);
+    }
+    ff_mutex_unlock(&lock);
+
+    if (ret == AVERROR(EBUSY)) {
+        av_log(logctx, AV_LOG_ERROR, "All %d %s encoder sessions are in use\n",
+               limit, type);
+        PMS_Log(LOG_LEVEL_ERROR, "All %d %s encoder sessions are in use", limit, type);
+    }
+    return ret;
+#else
+    return 0;
+#endif
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 int plex_opt_progress_url(void *optctx, const char *opt, const char *arg)
 {
@@ -518,7 +1267,7 @@ void plex_feedback(const AVFormatContext *ic)
         if (ic && ic->duration != AV_NOPTS_VALUE)
             duration = ic->duration / (double)AV_TIME_BASE;
         snprintf(url, sizeof(url), "%s?duration=%f", plexContext.progress_url, duration);
-        av_free(PMS_IssueHttpRequest(url, "PUT"));
+        plex_report_request(url, "PUT");
     }
 }
 
@@ -528,7 +1277,7 @@ void plex_status(const char *str)
     if (plexContext.progress_url) {
         char url[4096];
         snprintf(url, sizeof(url), "%s?status=%s", plexContext.progress_url, str);
-        av_free(PMS_IssueHttpRequest(url, "PUT"));
+        plex_report_request(url, "PUT");
     }
 }
 
@@ -546,3 +1295,665 @@ void plex_link_input_stream(const InputStream *ist)
         }
 #endif
 }
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int plex_setup_input_streams(void)
+{
+#if CONFIG_INLINEASS_FILTER
+    for (InputStream *ist = ist_iter(NULL); ist; ist = ist_iter(ist)) {
+        for (int i = 0; i < plexContext.nb_inlineass_ctxs; i++) {
+            const InlineAssContext *ctx = &plexContext.inlineass_ctxs[i];
+            if (ist->st->index == ctx->stream_index &&
+                ist->file_index == ctx->file_index) {
+                int ret = ist_burn_in_add(ist);
+                if (ret < 0)
+                    return ret;
+            }
+        }
+    }
+#endif
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void plex_report_input_streams(const AVFormatContext *ic)
+{
+    plex_status("opened");
+
+    // AAC parameters are only reliable once probed.
+    for (int i = 0; i < ic->nb_streams; i++) {
+        if (ic->streams[i]->codecpar->codec_id != AV_CODEC_ID_AAC)
+            plex_report_stream(ic->streams[i]);
+    }
+}
+
+void plex_report_probed_streams(AVFormatContext *ic, int orig_nb_streams)
+{
+    for (int i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        const FFStream *sti = ffstream(st);
+        // -1 indicates the codec was probed
+        if (i >= orig_nb_streams || sti->request_probe == -1 ||
+            st->codecpar->codec_id == AV_CODEC_ID_AAC)
+            plex_report_stream(st);
+    }
+
+    for (int i = 0; i < ic->nb_streams; i++)
+        plex_report_stream_detail(ic->streams[i]);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void plex_report_output_stream(const AVStream *st)
+{
+    const AVCodecParameters *par = st->codecpar;
+
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO && par->width && plexContext.progress_url) {
+        // Compute real width/height based on storage aspect ratio.
+        char url[1024];
+        int width = par->width;
+        if (par->sample_aspect_ratio.num && par->sample_aspect_ratio.den)
+            width = av_rescale(width, par->sample_aspect_ratio.num, par->sample_aspect_ratio.den);
+
+        snprintf(url, sizeof(url), "%s?width=%d&height=%d", plexContext.progress_url, width, par->height);
+        plex_report_request(url, "PUT");
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static int64_t thread_cpu_time(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
+// whether anything consumes the statistics gathered for the reports
+static int reporting(void)
+{
+    return plexContext.progress_url || plexContext.progress_json;
+}
+
+void plex_stage_start(PlexStageTimer *t)
+{
+    if (!reporting())
+        return;
+
+    t->wall = av_gettime_relative();
+    t->cpu  = thread_cpu_time();
+}
+
+void plex_stage_end(enum PlexStage stage, const PlexStageTimer *t)
+{
+    PlexStageStats *st = &plexContext.stages[stage];
+
+    if (!reporting())
+        return;
+
+    atomic_fetch_add_explicit(&st->wall, av_gettime_relative() - t->wall,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&st->cpu, thread_cpu_time() - t->cpu,
+                              memory_order_relaxed);
+}
+
+void plex_stage_queue(enum PlexStage stage, int depth)
+{
+    if (reporting())
+        atomic_store_explicit(&plexContext.stages[stage].queue, depth,
+                              memory_order_relaxed);
+}
+
+static const char *const stage_names[PLEX_STAGE_NB] = {
+    [PLEX_STAGE_DEMUX]   = "demux",
+    [PLEX_STAGE_DECODE]  = "decode",
+    [PLEX_STAGE_FILTER]  = "filter",
+    [PLEX_STAGE_ENCODE]  = "encode",
+    [PLEX_STAGE_MUX]     = "mux",
+    [PLEX_STAGE_NETWORK] = "net",
+};
+
+static void report_stages(char *url, size_t url_size)
+{
+    // cumulative times in milliseconds, queue depths as last sampled
+    for (int i = 0; i < PLEX_STAGE_NB; i++) {
+        PlexStageStats *st = &plexContext.stages[i];
+        int64_t wall = atomic_load_explicit(&st->wall, memory_order_relaxed);
+        int64_t cpu  = atomic_load_explicit(&st->cpu,  memory_order_relaxed);
+        int   queue  = atomic_load_explicit(&st->queue, memory_order_relaxed);
+
+        if (!wall)
+            continue;
+
+        av_strlcatf(url, url_size, "&%s_wall=%"PRId64"&%s_cpu=%"PRId64,
+                    stage_names[i], wall / 1000, stage_names[i], cpu / 1000);
+        if (queue)
+            av_strlcatf(url, url_size, "&%s_queue=%d", stage_names[i], queue);
+    }
+}
+
+void plex_profile_graph(AVFilterGraph *graph)
+{
+    if (reporting())
+        av_opt_set_int(graph, "profile", 1, 0);
+}
+
+void plex_log_graph_profile(AVFilterGraph *graph)
+{
+    int64_t profile = 0;
+    char *dump;
+
+    if (!graph || av_opt_get_int(graph, "profile", 0, &profile) < 0 || !profile)
+        return;
+    dump = avfilter_graph_dump(graph, "profile");
+    if (dump)
+        av_log(NULL, AV_LOG_VERBOSE, "Filter profile:\n%s", dump);
+    av_free(dump);
+}
+
+#define REPORT_TOP_FILTERS 3
+
+typedef struct TopFilter {
+    const AVFilterContext *filter;
+    AVFilterProfile p;
+} TopFilter;
+
+// the filters which took the most time so far, from all the profiled graphs
+static void top_filters(TopFilter top[REPORT_TOP_FILTERS])
+{
+
+    for (int i = 0; i < nb_filtergraphs; i++) {
+        AVFilterGraph *graph = filtergraphs[i]->graph;
+        int64_t profile = 0;
+
+        if (!graph || av_opt_get_int(graph, "profile", 0, &profile) < 0 || !profile)
+            continue;
+        for (unsigned j = 0; j < graph->nb_filters; j++) {
+            AVFilterProfile p;
+            int k;
+
+            avfilter_get_profile(graph->filters[j], &p);
+            for (k = REPORT_TOP_FILTERS; k > 0 && (!top[k - 1].filter ||
+                                                   top[k - 1].p.wall_time < p.wall_time); k--)
+                if (k < REPORT_TOP_FILTERS)
+                    top[k] = top[k - 1];
+            if (k < REPORT_TOP_FILTERS && p.wall_time > 0) {
+                top[k].filter = graph->filters[j];
+                top[k].p      = p;
+            }
+        }
+    }
+}
+
+static void report_filters(char *url, size_t url_size)
+{
+    TopFilter top[REPORT_TOP_FILTERS] = { { 0 } };
+
+    top_filters(top);
+
+    // filter names are built from the graph description, keep them url safe
+    for (int i = 0; i < REPORT_TOP_FILTERS && top[i].filter; i++) {
+        char name[64];
+
+        av_strlcpy(name, top[i].filter->name, sizeof(name));
+        for (char *c = name; *c; c++)
+            if (!strchr("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-.", *c))
+                *c = '_';
+        av_strlcatf(url, url_size, "&filter%d=%s&filter%d_wall=%"PRId64"&filter%d_cpu=%"PRId64,
+                    i, name, i, top[i].p.wall_time / 1000, i, top[i].p.cpu_time / 1000);
+    }
+}
+
+// heap held by each component, when built with memory accounting
+static const char *const mem_names[AV_MEM_TAG_NB] = {
+    [AV_MEM_TAG_OTHER]       = "other",
+    [AV_MEM_TAG_CODEC]       = "codec",
+    [AV_MEM_TAG_FILTER]      = "filter",
+    [AV_MEM_TAG_FORMAT]      = "format",
+    [AV_MEM_TAG_BUFFER_POOL] = "pool",
+};
+
+static void report_memory(char *url, size_t url_size)
+{
+    for (int tag = 0; tag < AV_MEM_TAG_NB; tag++) {
+        size_t cur;
+
+        if (av_mem_get_usage(tag, &cur, NULL) < 0)
+            return;
+        av_strlcatf(url, url_size, "&mem_%s_kb=%zu", mem_names[tag], cur >> 10);
+    }
+}
+
+// data held in the queues between the pipeline stages, against the budget
+static void report_buffers(char *url, size_t url_size)
+{
+    int64_t cur, peak;
+
+    buffer_stats(&cur, &peak);
+    av_strlcatf(url, url_size, "&buffered_kb=%"PRId64"&buffered_peak_kb=%"PRId64,
+                cur >> 10, peak >> 10);
+    if (max_buffered_size > 0)
+        av_strlcatf(url, url_size, "&buffer_budget_kb=%"PRId64, max_buffered_size >> 10);
+}
+
+static void io_stats_add(AVIOStats *dst, const AVIOStats *src)
+{
+    dst->bytes_read    += src->bytes_read;
+    dst->bytes_written += src->bytes_written;
+    dst->bytes_reread  += src->bytes_reread;
+    dst->read_calls    += src->read_calls;
+    dst->write_calls   += src->write_calls;
+    dst->seeks         += src->seeks;
+    dst->read_time     += src->read_time;
+    dst->write_time    += src->write_time;
+    dst->seek_time     += src->seek_time;
+    for (int i = 0; i < AVIO_STATS_LATENCY_BUCKETS; i++)
+        dst->read_latency[i] += src->read_latency[i];
+}
+
+// time blocked in and amount of the input and output I/O, to tell sessions
+// starved by slow storage apart from slow transcodes
+static void io_totals(AVIOStats *in, AVIOStats *out)
+{
+    AVIOStats st;
+
+    memset(in,  0, sizeof(*in));
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < nb_input_files; i++)
+        if (avformat_get_io_stats(input_files[i]->ctx, &st) >= 0)
+            io_stats_add(in, &st);
+    for (int i = 0; i < nb_output_files; i++)
+        if (avformat_get_io_stats(((Muxer *)output_files[i])->fc, &st) >= 0)
+            io_stats_add(out, &st);
+}
+
+static void report_io(char *url, size_t url_size)
+{
+    AVIOStats in, out;
+
+    io_totals(&in, &out);
+
+    if (in.read_calls) {
+        av_strlcatf(url, url_size,
+                    "&io_in_kb=%"PRId64"&io_in_reads=%"PRId64"&io_in_wait_ms=%"PRId64
+                    "&io_in_seeks=%"PRId64"&io_in_seek_ms=%"PRId64"&io_in_reread_kb=%"PRId64
+                    "&io_in_latency=",
+                    in.bytes_read >> 10, in.read_calls, in.read_time / 1000,
+                    in.seeks, in.seek_time / 1000, in.bytes_reread >> 10);
+        for (int i = 0; i < AVIO_STATS_LATENCY_BUCKETS; i++)
+            av_strlcatf(url, url_size, "%s%"PRId64, i ? "," : "", in.read_latency[i]);
+    }
+    if (out.write_calls)
+        av_strlcatf(url, url_size,
+                    "&io_out_kb=%"PRId64"&io_out_writes=%"PRId64"&io_out_wait_ms=%"PRId64,
+                    out.bytes_written >> 10, out.write_calls, out.write_time / 1000);
+}
+
+// sampled SSIM of the encodes, per output stream
+static void report_quality(char *url, size_t url_size)
+{
+    for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
+        EncQualityStats st;
+
+        if (enc_quality_stats(ost, &st) < 0 || !st.nb_samples)
+            continue;
+
+        av_strlcatf(url, url_size, "&ssim_%d_%d=%.5f&ssim_%d_%d_samples=%"PRIu64,
+                    ost->file_index, ost->index, st.ssim,
+                    ost->file_index, ost->index, st.nb_samples);
+        if (st.segment >= 0)
+            av_strlcatf(url, url_size, "&ssim_%d_%d_segment=%"PRId64"&ssim_%d_%d_segment_ssim=%.5f",
+                        ost->file_index, ost->index, st.segment,
+                        ost->file_index, ost->index, st.segment_ssim);
+    }
+}
+
+void plex_log_mem_usage(void)
+{
+    size_t cur, peak;
+
+    if (av_mem_get_usage(AV_MEM_TAG_OTHER, NULL, NULL) < 0)
+        return;
+    av_log(NULL, AV_LOG_INFO, "Heap usage:      current KiB     peak KiB\n");
+    for (int tag = 0; tag < AV_MEM_TAG_NB; tag++) {
+        av_mem_get_usage(tag, &cur, &peak);
+        av_log(NULL, AV_LOG_INFO, "  %-12s %14zu %12zu\n",
+               av_mem_tag_name(tag), cur >> 10, peak >> 10);
+    }
+}
+
+void plex_log_thread_stats(void)
+{
+    for (InputStream *ist = ist_iter(NULL); ist; ist = ist_iter(ist)) {
+        AVCodecThreadStats st;
+        int nb_threads;
+
+        if (!ist->dec_ctx ||
+            (nb_threads = avcodec_get_thread_stats(ist->dec_ctx, -1, &st)) <= 0)
+            continue;
+        av_log(NULL, AV_LOG_INFO,
+               "Decoder %d:%d (%s) %d frame threads, %"PRId64" packets, in ms: decode %"PRId64
+               " setup %"PRId64" progress wait %"PRId64" (%"PRId64" waits) hwaccel wait %"PRId64
+               " idle %"PRId64"; main thread waits for setup %"PRId64" output %"PRId64"\n",
+               ist->file_index, ist->index, ist->dec_ctx->codec->name, nb_threads, st.packets,
+               st.decode_time / 1000, st.setup_time / 1000, st.progress_wait_time / 1000,
+               st.progress_waits, st.hwaccel_wait_time / 1000, st.idle_time / 1000,
+               st.submit_wait_time / 1000, st.output_wait_time / 1000);
+    }
+}
+
+#define RECORD_VERSION 1
+
+static void json_string(AVBPrint *bp, const char *str)
+{
+    av_bprint_chars(bp, '"', 1);
+    for (; str && *str; str++) {
+        if (*str == '"' || *str == '\\')
+            av_bprintf(bp, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            av_bprintf(bp, "\\u%04x", *str);
+        else
+            av_bprint_chars(bp, *str, 1);
+    }
+    av_bprint_chars(bp, '"', 1);
+}
+
+static void json_io(AVBPrint *bp, const char *name, const AVIOStats *st)
+{
+    av_bprintf(bp, "\"%s\":{\"read\":%"PRId64",\"written\":%"PRId64",\"reread\":%"PRId64
+               ",\"reads\":%"PRId64",\"writes\":%"PRId64",\"seeks\":%"PRId64
+               ",\"read_ms\":%"PRId64",\"write_ms\":%"PRId64",\"seek_ms\":%"PRId64",\"latency\":[",
+               name, st->bytes_read, st->bytes_written, st->bytes_reread,
+               st->read_calls, st->write_calls, st->seeks,
+               st->read_time / 1000, st->write_time / 1000, st->seek_time / 1000);
+    for (int i = 0; i < AVIO_STATS_LATENCY_BUCKETS; i++)
+        av_bprintf(bp, "%s%"PRId64, i ? "," : "", st->read_latency[i]);
+    av_bprintf(bp, "]}");
+}
+
+/**
+ * Everything in the progress URL plus the per stream counters, as a single
+ * line of JSON. Fields are only ever added within a version; times are in
+ * milliseconds and sizes in bytes.
+ */
+static void report_json(int64_t pts, int64_t total_size, double progress,
+                        int remaining, float speed, int hw_state)
+{
+    int64_t elapsed = av_gettime_relative() - plexContext.start_time;
+    TopFilter top[REPORT_TOP_FILTERS] = { { 0 } };
+    AVIOStats in, out;
+    AVBPrint bp;
+    const char *sep;
+    size_t mem;
+    int64_t buffered, buffered_peak;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    av_bprintf(&bp, "{\"v\":%d,\"elapsed_ms\":%"PRId64",\"pts_ms\":%"PRId64
+               ",\"progress\":%.1f,\"size\":%"PRId64",\"remaining\":%d,\"speed\":%.2f"
+               ",\"throttled\":%d",
+               RECORD_VERSION, elapsed / 1000, pts / 1000, progress, total_size,
+               remaining, speed, plexContext.throttled);
+
+#define JSON_COUNTER(field, name) \
+    av_bprintf(&bp, ",\"" name "\":%d", atomic_load(&plexContext.field))
+
+    av_bprintf(&bp, ",\"vdec\":{\"hw_status\":%d", hw_state);
+    JSON_COUNTER(packets_in,          "packets");
+    JSON_COUNTER(hwaccel_failed,      "hw_failed");
+    JSON_COUNTER(sw_failed,           "sw_failed");
+    JSON_COUNTER(hwaccel_succeeded,   "hw_ok");
+    JSON_COUNTER(sw_succeeded,        "sw_ok");
+    JSON_COUNTER(hwaccel_fallback_ms, "fallback_ms");
+    JSON_COUNTER(hw_surfaces,         "hw_surfaces");
+    JSON_COUNTER(hw_surfaces_peak,    "hw_surfaces_peak");
+    JSON_COUNTER(hw_mem_mb,           "hw_mem_mb");
+    av_bprintf(&bp, "}");
+    JSON_COUNTER(hw_session_slot,     "venc_hw_session");
+
+    av_bprintf(&bp, ",\"stages\":{");
+    for (int i = 0; i < PLEX_STAGE_NB; i++) {
+        PlexStageStats *st = &plexContext.stages[i];
+
+        av_bprintf(&bp, "%s\"%s\":{\"wall_ms\":%"PRId64",\"cpu_ms\":%"PRId64",\"queue\":%d}",
+                   i ? "," : "", stage_names[i],
+                   atomic_load_explicit(&st->wall, memory_order_relaxed) / 1000,
+                   atomic_load_explicit(&st->cpu,  memory_order_relaxed) / 1000,
+                   atomic_load_explicit(&st->queue, memory_order_relaxed));
+    }
+    av_bprintf(&bp, "}");
+
+    top_filters(top);
+    av_bprintf(&bp, ",\"filters\":[");
+    for (int i = 0; i < REPORT_TOP_FILTERS && top[i].filter; i++) {
+        av_bprintf(&bp, "%s{\"name\":", i ? "," : "");
+        json_string(&bp, top[i].filter->name);
+        av_bprintf(&bp, ",\"wall_ms\":%"PRId64",\"cpu_ms\":%"PRId64"}",
+                   top[i].p.wall_time / 1000, top[i].p.cpu_time / 1000);
+    }
+    av_bprintf(&bp, "]");
+
+    if (av_mem_get_usage(AV_MEM_TAG_OTHER, &mem, NULL) >= 0) {
+        av_bprintf(&bp, ",\"mem\":{");
+        for (int tag = 0; tag < AV_MEM_TAG_NB; tag++) {
+            av_mem_get_usage(tag, &mem, NULL);
+            av_bprintf(&bp, "%s\"%s\":%zu", tag ? "," : "", mem_names[tag], mem);
+        }
+        av_bprintf(&bp, "}");
+    }
+
+    buffer_stats(&buffered, &buffered_peak);
+    av_bprintf(&bp, ",\"buffers\":{\"kb\":%"PRId64",\"peak_kb\":%"PRId64",\"budget_kb\":%"PRId64"}",
+               buffered >> 10, buffered_peak >> 10, FFMAX(max_buffered_size, 0) >> 10);
+
+    io_totals(&in, &out);
+    av_bprintf(&bp, ",\"io\":{");
+    json_io(&bp, "in",  &in);
+    av_bprintf(&bp, ",");
+    json_io(&bp, "out", &out);
+    av_bprintf(&bp, "}");
+
+    av_bprintf(&bp, ",\"inputs\":[");
+    sep = "";
+    for (InputStream *ist = ist_iter(NULL); ist; ist = ist_iter(ist), sep = ",") {
+        av_bprintf(&bp, "%s{\"file\":%d,\"index\":%d,\"type\":\"%s\",\"codec\":\"%s\""
+                   ",\"decoding\":%d,\"frames\":%"PRIu64",\"samples\":%"PRIu64
+                   ",\"errors\":%"PRIu64",\"hw\":%d}",
+                   sep, ist->file_index, ist->index,
+                   (const char *)av_x_if_null(av_get_media_type_string(ist->par->codec_type), "unknown"),
+                   avcodec_get_name(ist->par->codec_id), ist->decoding_needed != 0,
+                   ist->frames_decoded, ist->samples_decoded, ist->decode_errors,
+                   atomic_load(&ist->hwaccel_active));
+    }
+    av_bprintf(&bp, "]");
+
+    av_bprintf(&bp, ",\"outputs\":[");
+    sep = "";
+    for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost), sep = ",") {
+        uint64_t packets = atomic_load(&ost->packets_written);
+
+        av_bprintf(&bp, "%s{\"file\":%d,\"index\":%d,\"type\":\"%s\",\"codec\":\"%s\""
+                   ",\"encoding\":%d,\"frames\":%"PRIu64",\"samples\":%"PRIu64
+                   ",\"packets\":%"PRIu64",\"fps\":%.2f,\"q\":%.1f",
+                   sep, ost->file_index, ost->index,
+                   (const char *)av_x_if_null(av_get_media_type_string(ost->type), "unknown"),
+                   avcodec_get_name(ost->par_in->codec_id), !!ost->enc_ctx,
+                   ost->frames_encoded, ost->samples_encoded, packets,
+                   elapsed > 0 ? packets * 1000000.0 / elapsed : 0.0,
+                   ost->quality / (float)FF_QP2LAMBDA);
+        if (ost->filter)
+            av_bprintf(&bp, ",\"dup\":%"PRIu64",\"drop\":%"PRIu64,
+                       ost->filter->nb_frames_dup, ost->filter->nb_frames_drop);
+        av_bprintf(&bp, "}");
+    }
+    av_bprintf(&bp, "]}");
+
+    if (av_bprint_is_complete(&bp))
+        report_record(bp.str);
+    av_bprint_finalize(&bp, NULL);
+}
+
+void plex_report_stats(int64_t pts, int64_t total_size, int64_t run_time)
+{
+    static int64_t last_pts = 0;
+    static int lastRemaining = 0;
+    const AVFormatContext *ic = (input_files && input_files[0]) ? input_files[0]->ctx : NULL;
+    int64_t secs, totalSecs;
+    int remainingSecs, smoothedRemaining;
+    int hw_state = -1;
+    float speed;
+    char url[4096];
+
+    if (!reporting() || pts == AV_NOPTS_VALUE)
+        return;
+
+    // Notify about progress.
+    secs      = pts / AV_TIME_BASE;
+    totalSecs = (ic && ic->duration != AV_NOPTS_VALUE) ? ic->duration / AV_TIME_BASE : 0;
+
+    // Compute speed of transcode as a multiple of real-time.
+    speed = run_time > 0 ? (float)(pts - last_pts) / (float)run_time : 0;
+    // Compute estimated time remaining.
+    remainingSecs = speed > 0 ? (totalSecs - secs) / speed : -1;
+    smoothedRemaining = remainingSecs;
+    if (lastRemaining != 0)
+        smoothedRemaining = lastRemaining*0.5 + remainingSecs*0.5;
+
+    // Sanity check.
+    if (smoothedRemaining < 0)
+        smoothedRemaining = -1;
+
+    for (InputStream *ist = ist_iter(NULL); ist; ist = ist_iter(ist)) {
+        // As long as all video streams (that are decoded) use hw decoding,
+        // signal that hw decoding is used.
+        if (ist->par->codec_type == AVMEDIA_TYPE_VIDEO &&
+            ist->decoding_needed &&
+            ist->frames_decoded)
+            hw_state = (hw_state < 0 || hw_state == 1) && atomic_load(&ist->hwaccel_active);
+    }
+
+    if (plexContext.progress_json)
+        report_json(pts, total_size, totalSecs == 0 ? -1 : (float)secs*100.0/totalSecs,
+                    smoothedRemaining, speed, hw_state);
+    if (!plexContext.progress_url)
+        goto throttle;
+
+    snprintf(url, sizeof(url),
+             "%s?progress=%.1f&size=%"PRId64"&remaining=%d",
+             plexContext.progress_url, totalSecs == 0 ? -1 : (float)secs*100.0/totalSecs,
+             total_size, smoothedRemaining);
+
+#define REPORT_COUNTER(field, name) do {                             \
+        int val = atomic_load(&plexContext.field);                  \
+        if (val)                                                    \
+            av_strlcatf(url, sizeof(url), "&" name "=%d", val);     \
+    } while (0)
+
+    REPORT_COUNTER(packets_in,        "vdec_packets");
+    REPORT_COUNTER(hwaccel_failed,    "vdec_hw_failed");
+    REPORT_COUNTER(sw_failed,         "vdec_sw_failed");
+    REPORT_COUNTER(hwaccel_succeeded, "vdec_hw_ok");
+    REPORT_COUNTER(sw_succeeded,      "vdec_sw_ok");
+    REPORT_COUNTER(hwaccel_fallback_ms, "vdec_fallback_ms");
+    REPORT_COUNTER(hw_surfaces,       "vdec_hw_surfaces");
+    REPORT_COUNTER(hw_surfaces_peak,  "vdec_hw_surfaces_peak");
+    REPORT_COUNTER(hw_mem_mb,         "vdec_hw_mem_mb");
+    REPORT_COUNTER(hw_session_slot,   "venc_hw_session");
+
+    // Only pass back speed if we're not throttled.
+    if (!plexContext.throttled)
+        av_strlcatf(url, sizeof(url), "&speed=%.1f", speed);
+
+    if (hw_state >= 0)
+        av_strlcatf(url, sizeof(url), "&vdec_hw_status=%d", hw_state);
+
+    report_stages(url, sizeof(url));
+    report_filters(url, sizeof(url));
+    report_memory(url, sizeof(url));
+    report_buffers(url, sizeof(url));
+    report_io(url, sizeof(url));
+    report_quality(url, sizeof(url));
+
+    plex_report_progress(url);
+
+throttle:
+    // Handle throttling, as decided by the reply to an earlier report.
+    if (atomic_load(&plexContext.can_throttle)) {
+        if (!plexContext.throttled)
+            PMS_Log(LOG_LEVEL_DEBUG, "Throttle - Going into sloth mode.");
+
+        plexContext.throttled = 1;
+    } else {
+        if (plexContext.throttled)
+            PMS_Log(LOG_LEVEL_DEBUG, "Throttle - Getting back to work.");
+
+        plexContext.throttled = 0;
+    }
+
+    lastRemaining = remainingSecs;
+    last_pts = pts;
+}
+
+// decoded frames between samples of the decoder surface pool
+#define HW_POOL_TRIM_INTERVAL 256
+
+// Sample the decoder surface pool and give back the surfaces that went
+// unused since the previous sample, beyond a couple of spare ones.
+static void hw_pool_update(AVBufferRef *hw_frames_ctx)
+{
+    AVHWFramesPoolStats stats;
+    int freed;
+
+    if (av_hwframe_ctx_get_pool_stats(hw_frames_ctx, &stats) < 0)
+        return;
+    atomic_store(&plexContext.hw_surfaces_peak,
+                 FFMAX(atomic_load(&plexContext.hw_surfaces_peak), stats.high_water));
+
+    freed = av_hwframe_ctx_trim_pool(hw_frames_ctx, 2);
+    if (freed > 0) {
+        av_log(NULL, AV_LOG_DEBUG, "Released %d unused decoder surfaces\n", freed);
+        av_hwframe_ctx_get_pool_stats(hw_frames_ctx, &stats);
+    }
+
+    atomic_store(&plexContext.hw_surfaces, stats.nb_allocated);
+    atomic_store(&plexContext.hw_mem_mb, stats.mem_size >> 20);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int plex_decode_result(InputStream *ist, const AVFrame *frame, int err)
+{
+    int is_hwaccel = atomic_load(&ist->hwaccel_active);
+
+    if (frame) {
+        const AVPixFmtDescriptor *pixdesc = av_pix_fmt_desc_get(frame->format);
+        is_hwaccel = pixdesc && (pixdesc->flags & AV_PIX_FMT_FLAG_HWACCEL);
+    }
+
+    if (err >= 0) {
+        int nb = atomic_fetch_add(is_hwaccel ? &plexContext.hwaccel_succeeded :
+                                               &plexContext.sw_succeeded, 1);
+        if (is_hwaccel && frame && frame->hw_frames_ctx &&
+            !(nb % HW_POOL_TRIM_INTERVAL))
+            hw_pool_update(frame->hw_frames_ctx);
+        return 0;
+    }
+
+    if (!is_hwaccel) {
+        atomic_fetch_add(&plexContext.sw_failed, 1);
+        return 0;
+    }
+
+    atomic_fetch_add(&plexContext.hwaccel_failed, 1);
+    ist->hwaccel_error_counter++;
+    if (ist->hwaccel_fallback_threshold &&
+        ist->hwaccel_error_counter >= ist->hwaccel_fallback_threshold) {
+        atomic_store(&ist->hwaccel_active, 0);
+        ist->hwaccel_blocked = 1;
+        av_log(ist, AV_LOG_WARNING,
+               "Triggering violent fallback to software decoding!\n");
+        avcodec_flush_buffers(ist->dec_ctx);
+        return 1;
+    }
+    return 0;
+}
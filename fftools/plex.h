@@ -85,24 +85,69 @@ typedef struct
     int stream_index;
     AVFilterContext *ctx;
     int width, height;
+    AVFifo *pending;                    // AVSubtitle decoded before ctx was linked
 } InlineAssContext;
 
+/**
+ * Pipeline stages timed for the progress reports.
+ */
+enum PlexStage {
+    PLEX_STAGE_DEMUX,                   // av_read_frame()
+    PLEX_STAGE_DECODE,                  // decoder send/receive
+    PLEX_STAGE_FILTER,                  // filtergraph push/pull
+    PLEX_STAGE_ENCODE,                  // encoder send/receive
+    PLEX_STAGE_MUX,                     // av_interleaved_write_frame(), incl. output I/O
+    PLEX_STAGE_NETWORK,                 // requests to the server
+    PLEX_STAGE_NB,
+};
+
+typedef struct PlexStageStats
+{
+    atomic_int_least64_t wall;          // microseconds
+    atomic_int_least64_t cpu;           // microseconds of thread CPU time
+    atomic_int queue;                   // last sampled depth of the stage's input queue
+} PlexStageStats;
+
+/**
+ * Start timestamps of a timed section, filled by plex_stage_start().
+ */
+typedef struct PlexStageTimer
+{
+    int64_t wall;
+    int64_t cpu;
+} PlexStageTimer;
+
 typedef struct
 {
     int64_t input_start_time;           //[+]
 
     int64_t output_duration;            //[+]
     char* progress_url;                 //[-]
-    int throttle_delay;
+    char *progress_json;                // where JSON progress records are written, any avio URL
+    int64_t start_time;                 // wall clock at plex_init(), for the rates in the records
+    int throttled;                      // pacing output since the server allowed it
+    float throttle_speed;               // pace while throttled, as a multiple of realtime
+    char *hw_session_dir;               // where hardware encoder session slots are locked
+    int hw_session_limit;               // hardware encoder sessions allowed per device type
+    atomic_int hw_session_slot;         // 1 + slot held by this process, 0 for none
 
     int nb_inlineass_ctxs;
     InlineAssContext *inlineass_ctxs;
 
-    int packets_in;
-    int hwaccel_failed;
-    int hwaccel_succeeded;
-    int sw_failed;
-    int sw_succeeded;
+    // updated from the decoder threads
+    atomic_int packets_in;
+    atomic_int hwaccel_failed;
+    atomic_int hwaccel_succeeded;
+    atomic_int sw_failed;
+    atomic_int sw_succeeded;
+    atomic_int hwaccel_fallback_ms;     // time taken to replay the GOP after a fallback
+    atomic_int hw_surfaces;             // decoder frame pool, as last sampled
+    atomic_int hw_surfaces_peak;
+    atomic_int hw_mem_mb;
+
+    atomic_int can_throttle;            // set by the reporter thread from progress replies
+
+    PlexStageStats stages[PLEX_STAGE_NB];
 } PlexContext;
 
 extern PlexContext plexContext;
@@ -119,7 +164,40 @@ typedef enum LogLevel
 char* PMS_IssueHttpRequest(const char* url, const char* verb);
 void PMS_Log(LogLevel level, const char* format, ...);
 
+/**
+ * Queue a progress update for the reporter thread. Only the most recent
+ * update is kept; the reply is only used to update plexContext.can_throttle
+ * and to pick up seek requests, see plex_seek_take().
+ */
+void plex_report_progress(const char *url);
+
+/**
+ * Take the seek the server last requested in a progress reply, as
+ * "seek=<seconds>" with an optional "segment=<number>" for the segment the
+ * output continues at.
+ *
+ * @param ts      set to the requested input position, in AV_TIME_BASE
+ * @param segment set to the requested segment number, -1 if none was given
+ * @return 1 if a seek was pending, 0 otherwise
+ */
+int plex_seek_take(int64_t *ts, int *segment);
+
+/**
+ * Queue a request for the reporter thread, discarding the reply. Never blocks
+ * on the network; requests are dropped if the queue is full.
+ */
+void plex_report_request(const char *url, const char *verb);
+
+/**
+ * Pace the transcode while the server allows throttling: block until the
+ * media timestamp ts (in AV_TIME_BASE) is no further ahead of the wall clock
+ * than plexContext.throttle_speed allows. Returns immediately once the server
+ * stops allowing throttling.
+ */
+void plex_throttle(int64_t ts);
+
 void plex_init(int argc, char **argv, const OptionDef *options);
+void plex_uninit(void);
 int av_log_get_level_plex(void);
 void av_log_set_level_plex(int);
 
@@ -139,4 +217,93 @@ void plex_link_subtitles_to_graph(AVFilterGraph* graph);
 int plex_process_subtitles(const InputStream *ist, AVSubtitle *sub);
 void plex_link_input_stream(const InputStream *ist);
 
+/**
+ * Hooks for the threaded pipeline in ffmpeg.c and its ffmpeg_*.c modules.
+ */
+
+/**
+ * Take one of the hw_session_limit session slots of the device type used by
+ * a hardware encoder. Slots are lock files shared by all the transcoders
+ * using the same hw_session_dir, and are held until the process exits, so a
+ * server can count the sessions in use before starting another transcode.
+ * Does nothing unless both -hw_session_dir and -hw_session_limit are set.
+ *
+ * @return 0 on success, AVERROR(EBUSY) if all the slots are taken
+ */
+int plex_hw_session_acquire(void *logctx, const AVCodec *codec);
+
+/**
+ * Start decoding the input streams selected for burn-in with -map_inlineass.
+ * Must be called once all the output files are open.
+ */
+int plex_setup_input_streams(void);
+
+/**
+ * Report the streams of a freshly opened input before, and the probed ones
+ * after avformat_find_stream_info().
+ */
+void plex_report_input_streams(const AVFormatContext *ic);
+void plex_report_probed_streams(AVFormatContext *ic, int orig_nb_streams);
+
+/**
+ * Report the display size of an output stream once its muxer is initialized.
+ */
+void plex_report_output_stream(const AVStream *st);
+
+/**
+ * Queue a progress report built from the current output position, as a
+ * query string to the progress URL and as a JSON record to -progress_json.
+ *
+ * @param pts        output position in AV_TIME_BASE, may be AV_NOPTS_VALUE
+ * @param total_size bytes written to the first output so far
+ * @param run_time   wall time since the previous report, in microseconds
+ */
+void plex_report_stats(int64_t pts, int64_t total_size, int64_t run_time);
+
+/**
+ * Enable the per filter profile of a configured graph when progress is
+ * reported, the most expensive filters are then included in the reports.
+ */
+void plex_profile_graph(AVFilterGraph *graph);
+
+/**
+ * Log the per filter profile of a graph about to be freed.
+ */
+void plex_log_graph_profile(AVFilterGraph *graph);
+
+/**
+ * Log the heap held by each component, when built with
+ * --enable-memory-accounting.
+ */
+void plex_log_mem_usage(void);
+
+/**
+ * Log where the frame threads of the decoders opened with the thread_stats
+ * option spent their time.
+ */
+void plex_log_thread_stats(void);
+
+/**
+ * Account the outcome of a video decode call and fall back to software
+ * decoding once the hwaccel error threshold is reached. Must be called from
+ * the thread ist is decoded on.
+ *
+ * @param frame the decoded frame, before any hwaccel download, or NULL
+ * @param err   a negative error code if decoding failed
+ * @return 1 if the decoder was just flushed to fall back, 0 otherwise
+ */
+int plex_decode_result(InputStream *ist, const AVFrame *frame, int err);
+
+/**
+ * Time a section of a pipeline stage, from any thread. Both are no-ops
+ * unless progress is reported.
+ */
+void plex_stage_start(PlexStageTimer *t);
+void plex_stage_end(enum PlexStage stage, const PlexStageTimer *t);
+
+/**
+ * Record the current depth of the queue feeding a stage.
+ */
+void plex_stage_queue(enum PlexStage stage, int depth);
+
 #endif
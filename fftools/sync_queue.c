@@ -65,8 +65,26 @@
  * streams 0 and 1 end at t=8 and t=9 respectively. All frames that _end_ at
  * or before t=5 can be output, i.e. the first 3 frames from stream 0, first
  * frame from stream 1, and all 4 frames from stream 2.
+ *
+ * To keep the cost of sending and receiving independent of the number of
+ * streams, the queue keeps the streams in three binary min-heaps:
+ * - HEAP_HEAD: the limiting streams that have a head timestamp, ordered by it,
+ *   the head stream is the root;
+ * - HEAP_TAIL: the streams whose tail frame could not be output because it
+ *   ends after the queue head, ordered by that end time, they are moved to
+ *   HEAP_READY once the queue head catches up with them;
+ * - HEAP_READY: the streams that may have output available, ordered by index.
+ *   Every stream that sq_receive() could return a frame from is there, so
+ *   receiving from any stream only needs to look at them.
  */
 
+enum {
+    HEAP_HEAD,
+    HEAP_TAIL,
+    HEAP_READY,
+    HEAP_NB,
+};
+
 typedef struct SyncQueueStream {
     AVFifo          *fifo;
     AVRational       tb;
@@ -76,6 +94,10 @@ typedef struct SyncQueueStream {
     /* stream head: largest timestamp seen */
     int64_t          head_ts;
     int              limiting;
+    /* end timestamp of the tail frame, when in HEAP_TAIL */
+    int64_t          tail_ts;
+    /* position of this stream in each of the heaps, -1 if not there */
+    int              heap_pos[HEAP_NB];
     /* no more frames will be sent for this stream */
     int              finished;
 
@@ -97,12 +119,20 @@ struct SyncQueue {
     int head_stream;
     /* the finished stream with the smallest finish timestamp or -1 */
     int head_finished_stream;
+    /* the stream with the _largest_ head timestamp or -1 */
+    int max_head_stream;
 
     // maximum buffering duration in microseconds
     int64_t buf_size_us;
 
     SyncQueueStream *streams;
     unsigned int  nb_streams;
+    unsigned int  nb_limiting;
+    unsigned int  nb_finished;
+
+    /* stream indices, see the description at the top */
+    unsigned int *heap[HEAP_NB];
+    unsigned int  nb_heap[HEAP_NB];
 
     // pool of preallocated frames to avoid constant allocations
     ObjPool *pool;
@@ -148,7 +178,117 @@ static int frame_null(const SyncQueue *sq, SyncQueueFrame frame)
     return (sq->type == SYNC_QUEUE_PACKETS) ? (frame.p == NULL) : (frame.f == NULL);
 }
 
-static void tb_update(const SyncQueue *sq, SyncQueueStream *st,
+static int heap_cmp(const SyncQueue *sq, int h, unsigned int a, unsigned int b)
+{
+    unsigned int idx_a = sq->heap[h][a], idx_b = sq->heap[h][b];
+    const SyncQueueStream *st_a = &sq->streams[idx_a];
+    const SyncQueueStream *st_b = &sq->streams[idx_b];
+
+    switch (h) {
+    case HEAP_HEAD:
+        return av_compare_ts(st_a->head_ts, st_a->tb, st_b->head_ts, st_b->tb);
+    case HEAP_TAIL:
+        return av_compare_ts(st_a->tail_ts, st_a->tb, st_b->tail_ts, st_b->tb);
+    }
+    return (idx_a > idx_b) - (idx_a < idx_b);
+}
+
+static void heap_swap(SyncQueue *sq, int h, unsigned int a, unsigned int b)
+{
+    FFSWAP(unsigned int, sq->heap[h][a], sq->heap[h][b]);
+    sq->streams[sq->heap[h][a]].heap_pos[h] = a;
+    sq->streams[sq->heap[h][b]].heap_pos[h] = b;
+}
+
+/* restore the heap order after the key of the element at pos changed */
+static void heap_update(SyncQueue *sq, int h, unsigned int pos)
+{
+    while (pos > 0 && heap_cmp(sq, h, pos, (pos - 1) / 2) < 0) {
+        heap_swap(sq, h, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+
+    while (1) {
+        unsigned int min = pos, l = 2 * pos + 1, r = 2 * pos + 2;
+
+        if (l < sq->nb_heap[h] && heap_cmp(sq, h, l, min) < 0)
+            min = l;
+        if (r < sq->nb_heap[h] && heap_cmp(sq, h, r, min) < 0)
+            min = r;
+        if (min == pos)
+            break;
+
+        heap_swap(sq, h, pos, min);
+        pos = min;
+    }
+}
+
+/* insert the stream into the heap, or update its position if already there */
+static void heap_add(SyncQueue *sq, int h, unsigned int stream_idx)
+{
+    SyncQueueStream *st = &sq->streams[stream_idx];
+
+    if (st->heap_pos[h] < 0) {
+        st->heap_pos[h] = sq->nb_heap[h];
+        sq->heap[h][sq->nb_heap[h]++] = stream_idx;
+    }
+    heap_update(sq, h, st->heap_pos[h]);
+}
+
+static void heap_remove_root(SyncQueue *sq, int h)
+{
+    unsigned int *heap = sq->heap[h];
+
+    sq->streams[heap[0]].heap_pos[h] = -1;
+    if (--sq->nb_heap[h]) {
+        heap[0] = heap[sq->nb_heap[h]];
+        sq->streams[heap[0]].heap_pos[h] = 0;
+        heap_update(sq, h, 0);
+    }
+}
+
+/* move the streams the queue head has caught up with to HEAP_READY */
+static void tail_release(SyncQueue *sq)
+{
+    const SyncQueueStream *st_head;
+
+    if (sq->head_stream < 0)
+        return;
+    st_head = &sq->streams[sq->head_stream];
+
+    while (sq->nb_heap[HEAP_TAIL]) {
+        unsigned int stream_idx = sq->heap[HEAP_TAIL][0];
+        const SyncQueueStream *st = &sq->streams[stream_idx];
+
+        if (av_compare_ts(st->tail_ts, st->tb, st_head->head_ts, st_head->tb) > 0)
+            break;
+
+        heap_remove_root(sq, HEAP_TAIL);
+        heap_add(sq, HEAP_READY, stream_idx);
+    }
+}
+
+/* check if the stream now has the largest head timestamp, on ties the one
+ * with the lowest index wins */
+static void max_head_update(SyncQueue *sq, unsigned int stream_idx)
+{
+    const SyncQueueStream *st = &sq->streams[stream_idx], *st_max;
+    int cmp;
+
+    if (st->head_ts == AV_NOPTS_VALUE)
+        return;
+    if (sq->max_head_stream < 0) {
+        sq->max_head_stream = stream_idx;
+        return;
+    }
+
+    st_max = &sq->streams[sq->max_head_stream];
+    cmp    = av_compare_ts(st->head_ts, st->tb, st_max->head_ts, st_max->tb);
+    if (cmp > 0 || (cmp == 0 && stream_idx < sq->max_head_stream))
+        sq->max_head_stream = stream_idx;
+}
+
+static void tb_update(SyncQueue *sq, SyncQueueStream *st,
                       const SyncQueueFrame frame)
 {
     AVRational tb = (sq->type == SYNC_QUEUE_PACKETS) ?
@@ -164,20 +304,41 @@ static void tb_update(const SyncQueue *sq, SyncQueueStream *st,
 
     if (st->head_ts != AV_NOPTS_VALUE)
         st->head_ts = av_rescale_q(st->head_ts, st->tb, tb);
+    if (st->heap_pos[HEAP_TAIL] >= 0)
+        st->tail_ts = av_rescale_q(st->tail_ts, st->tb, tb);
 
     st->tb = tb;
+
+    /* rounding may have moved the timestamps past other streams' ones */
+    if (st->heap_pos[HEAP_TAIL] >= 0)
+        heap_update(sq, HEAP_TAIL, st->heap_pos[HEAP_TAIL]);
+    if (st->heap_pos[HEAP_HEAD] >= 0) {
+        heap_update(sq, HEAP_HEAD, st->heap_pos[HEAP_HEAD]);
+        if (sq->head_stream >= 0)
+            sq->head_stream = sq->heap[HEAP_HEAD][0];
+        tail_release(sq);
+    }
+    if (st->head_ts != AV_NOPTS_VALUE) {
+        sq->max_head_stream = -1;
+        for (unsigned int i = 0; i < sq->nb_streams; i++)
+            max_head_update(sq, i);
+    }
 }
 
 static void finish_stream(SyncQueue *sq, unsigned int stream_idx)
 {
     SyncQueueStream *st = &sq->streams[stream_idx];
 
-    if (!st->finished)
+    if (!st->finished) {
         av_log(sq->logctx, AV_LOG_DEBUG,
                "sq: finish %u; head ts %s\n", stream_idx,
                av_ts2timestr(st->head_ts, &st->tb));
 
-    st->finished = 1;
+        st->finished = 1;
+        sq->nb_finished++;
+        /* a partial audio frame may be output now */
+        heap_add(sq, HEAP_READY, stream_idx);
+    }
 
     if (st->limiting && st->head_ts != AV_NOPTS_VALUE) {
         /* check if this stream is the new finished head */
@@ -195,58 +356,40 @@ static void finish_stream(SyncQueue *sq, unsigned int stream_idx)
             SyncQueueStream *st1 = &sq->streams[i];
             if (st != st1 && st1->head_ts != AV_NOPTS_VALUE &&
                 av_compare_ts(st->head_ts, st->tb, st1->head_ts, st1->tb) <= 0) {
-                if (!st1->finished)
+                if (!st1->finished) {
                     av_log(sq->logctx, AV_LOG_DEBUG,
                            "sq: finish secondary %u; head ts %s\n", i,
                            av_ts2timestr(st1->head_ts, &st1->tb));
 
-                st1->finished = 1;
+                    st1->finished = 1;
+                    sq->nb_finished++;
+                    heap_add(sq, HEAP_READY, i);
+                }
             }
         }
     }
 
     /* mark the whole queue as finished if all streams are finished */
-    for (unsigned int i = 0; i < sq->nb_streams; i++) {
-        if (!sq->streams[i].finished)
-            return;
-    }
+    if (sq->nb_finished < sq->nb_streams)
+        return;
     sq->finished = 1;
 
     av_log(sq->logctx, AV_LOG_DEBUG, "sq: finish queue\n");
 }
 
-static void queue_head_update(SyncQueue *sq)
+static void queue_head_update(SyncQueue *sq, unsigned int stream_idx)
 {
     av_assert0(sq->have_limiting);
 
-    if (sq->head_stream < 0) {
-        unsigned first_limiting = UINT_MAX;
-
-        /* wait for one timestamp in each stream before determining
-         * the queue head */
-        for (unsigned int i = 0; i < sq->nb_streams; i++) {
-            SyncQueueStream *st = &sq->streams[i];
-            if (!st->limiting)
-                continue;
-            if (st->head_ts == AV_NOPTS_VALUE)
-                return;
-            if (first_limiting == UINT_MAX)
-                first_limiting = i;
-        }
+    heap_add(sq, HEAP_HEAD, stream_idx);
 
-        // placeholder value, correct one will be found below
-        av_assert0(first_limiting < UINT_MAX);
-        sq->head_stream = first_limiting;
-    }
+    /* wait for one timestamp in each stream before determining
+     * the queue head */
+    if (sq->head_stream < 0 && sq->nb_heap[HEAP_HEAD] < sq->nb_limiting)
+        return;
 
-    for (unsigned int i = 0; i < sq->nb_streams; i++) {
-        SyncQueueStream *st_head  = &sq->streams[sq->head_stream];
-        SyncQueueStream *st_other = &sq->streams[i];
-        if (st_other->limiting && st_other->head_ts != AV_NOPTS_VALUE &&
-            av_compare_ts(st_other->head_ts, st_other->tb,
-                          st_head->head_ts,  st_head->tb) < 0)
-            sq->head_stream = i;
-    }
+    sq->head_stream = sq->heap[HEAP_HEAD][0];
+    tail_release(sq);
 }
 
 /* update this stream's head timestamp */
@@ -259,6 +402,7 @@ static void stream_update_ts(SyncQueue *sq, unsigned int stream_idx, int64_t ts)
         return;
 
     st->head_ts = ts;
+    max_head_update(sq, stream_idx);
 
     /* if this stream is now ahead of some finished stream, then
      * this stream is also finished */
@@ -268,10 +412,8 @@ static void stream_update_ts(SyncQueue *sq, unsigned int stream_idx, int64_t ts)
                       ts, st->tb) <= 0)
         finish_stream(sq, stream_idx);
 
-    /* update the overall head timestamp if it could have changed */
-    if (st->limiting &&
-        (sq->head_stream < 0 || sq->head_stream == stream_idx))
-        queue_head_update(sq);
+    if (st->limiting)
+        queue_head_update(sq, stream_idx);
 }
 
 /* If the queue for the given stream (or all streams when stream_idx=-1)
@@ -287,18 +429,7 @@ static int overflow_heartbeat(SyncQueue *sq, int stream_idx)
 
     /* if no stream specified, pick the one that is most ahead */
     if (stream_idx < 0) {
-        int64_t ts = AV_NOPTS_VALUE;
-
-        for (int i = 0; i < sq->nb_streams; i++) {
-            st = &sq->streams[i];
-            if (st->head_ts != AV_NOPTS_VALUE &&
-                (ts == AV_NOPTS_VALUE ||
-                 av_compare_ts(ts, sq->streams[stream_idx].tb,
-                               st->head_ts, st->tb) < 0)) {
-                ts = st->head_ts;
-                stream_idx = i;
-            }
-        }
+        stream_idx = sq->max_head_stream;
         /* no stream has a timestamp yet -> nothing to do */
         if (stream_idx < 0)
             return 0;
@@ -385,6 +516,7 @@ int sq_send(SyncQueue *sq, unsigned int stream_idx, SyncQueueFrame frame)
         objpool_release(sq->pool, (void**)&dst);
         return ret;
     }
+    heap_add(sq, HEAP_READY, stream_idx);
 
     stream_update_ts(sq, stream_idx, ts);
 
@@ -573,8 +705,15 @@ static int receive_for_stream(SyncQueue *sq, unsigned int stream_idx,
                    sq->head_stream,
                    st_head ? av_ts2timestr(st_head->head_ts, &st_head->tb) : "N/A");
 
+            /* the next frame may be ready as well */
+            heap_add(sq, HEAP_READY, stream_idx);
+
             return 0;
         }
+
+        /* wait for the queue head to catch up */
+        st->tail_ts = ts;
+        heap_add(sq, HEAP_TAIL, stream_idx);
     }
 
     return (sq->finished || (st->finished && !av_fifo_can_read(st->fifo))) ?
@@ -583,7 +722,6 @@ static int receive_for_stream(SyncQueue *sq, unsigned int stream_idx,
 
 static int receive_internal(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
 {
-    int nb_eof = 0;
     int ret;
 
     /* read a frame for a specific stream */
@@ -592,17 +730,21 @@ static int receive_internal(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
         return (ret < 0) ? ret : stream_idx;
     }
 
-    /* read a frame for any stream with available output */
-    for (unsigned int i = 0; i < sq->nb_streams; i++) {
+    /* read a frame for any stream with available output, the streams
+     * outside HEAP_READY have none */
+    while (sq->nb_heap[HEAP_READY]) {
+        unsigned int i = sq->heap[HEAP_READY][0];
+
         ret = receive_for_stream(sq, i, frame);
         if (ret == AVERROR_EOF || ret == AVERROR(EAGAIN)) {
-            nb_eof += (ret == AVERROR_EOF);
+            heap_remove_root(sq, HEAP_READY);
             continue;
         }
         return (ret < 0) ? ret : i;
     }
 
-    return (nb_eof == sq->nb_streams) ? AVERROR_EOF : AVERROR(EAGAIN);
+    /* every stream returned EOF iff the whole queue is finished */
+    return (sq->finished || !sq->nb_streams) ? AVERROR_EOF : AVERROR(EAGAIN);
 }
 
 int sq_receive(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
@@ -626,6 +768,14 @@ int sq_add_stream(SyncQueue *sq, int limiting)
         return AVERROR(ENOMEM);
     sq->streams = tmp;
 
+    for (int h = 0; h < HEAP_NB; h++) {
+        unsigned int *heap = av_realloc_array(sq->heap[h], sq->nb_streams + 1,
+                                              sizeof(*sq->heap[h]));
+        if (!heap)
+            return AVERROR(ENOMEM);
+        sq->heap[h] = heap;
+    }
+
     st = &sq->streams[sq->nb_streams];
     memset(st, 0, sizeof(*st));
 
@@ -640,8 +790,11 @@ int sq_add_stream(SyncQueue *sq, int limiting)
     st->head_ts = AV_NOPTS_VALUE;
     st->frames_max = UINT64_MAX;
     st->limiting   = limiting;
+    for (int h = 0; h < HEAP_NB; h++)
+        st->heap_pos[h] = -1;
 
     sq->have_limiting |= limiting;
+    sq->nb_limiting   += !!limiting;
 
     return sq->nb_streams++;
 }
@@ -685,6 +838,7 @@ SyncQueue *sq_alloc(enum SyncQueueType type, int64_t buf_size_us, void *logctx)
 
     sq->head_stream          = -1;
     sq->head_finished_stream = -1;
+    sq->max_head_stream      = -1;
 
     sq->pool = (type == SYNC_QUEUE_PACKETS) ? objpool_alloc_packets() :
                                               objpool_alloc_frames();
@@ -712,6 +866,8 @@ void sq_free(SyncQueue **psq)
     }
 
     av_freep(&sq->streams);
+    for (int h = 0; h < HEAP_NB; h++)
+        av_freep(&sq->heap[h]);
 
     objpool_free(&sq->pool);
 
@@ -16,38 +16,65 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
+#if HAVE_SCHED_YIELD
+#include <sched.h>
+#endif
 
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
 #include "libavutil/error.h"
-#include "libavutil/fifo.h"
-#include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 
 #include "objpool.h"
 #include "thread_queue.h"
 
+/* how many times a full or empty queue is retried before the thread sleeps,
+ * on machines where the other side can make progress meanwhile */
+#define SPIN_COUNT 64
+
 enum {
     FINISHED_SEND = (1 << 0),
     FINISHED_RECV = (1 << 1),
 };
 
-typedef struct FifoElem {
-    void        *obj;
-    unsigned int stream_idx;
-} FifoElem;
+/*
+ * The queue is a bounded ring of cells, each owning one object that items
+ * are moved into and out of (Vyukov's bounded MPMC queue). A cell's sequence
+ * number tells whose turn it is: 2 * pos when it is free for the item sent at
+ * position pos, 2 * pos + 1 when that item can be received. The doubling keeps
+ * both states apart in a queue of size 1.
+ */
+typedef struct Cell {
+    atomic_uint_least64_t seq;
+    void                 *obj;
+    unsigned int          stream_idx;
+} Cell;
 
 struct ThreadQueue {
-    int              *finished;
+    atomic_int      *finished;
     unsigned int    nb_streams;
 
-    AVFifo  *fifo;
+    Cell           *cells;
+    size_t          nb_cells;
+
+    /* next positions to send to and receive from, on separate cache lines */
+    atomic_uint_least64_t send_pos;
+    char                  pad[64];
+    atomic_uint_least64_t recv_pos;
 
     ObjPool *obj_pool;
     void   (*obj_move)(void *dst, void *src);
+    void   (*obj_account)(const void *obj, int dir);
 
+    /* only taken to sleep and wake up, when the queue is full or empty */
+    int             spin_count;
+    atomic_int      nb_waiters;
     pthread_mutex_t lock;
     pthread_cond_t  cond;
 };
@@ -59,12 +86,15 @@ void tq_free(ThreadQueue **ptq)
     if (!tq)
         return;
 
-    if (tq->fifo) {
-        FifoElem elem;
-        while (av_fifo_read(tq->fifo, &elem, 1) >= 0)
-            objpool_release(tq->obj_pool, &elem.obj);
+    if (tq->cells) {
+        for (size_t i = 0; i < tq->nb_cells; i++) {
+            /* an odd sequence marks a cell holding an item */
+            if (tq->obj_account && (atomic_load(&tq->cells[i].seq) & 1))
+                tq->obj_account(tq->cells[i].obj, -1);
+            objpool_release(tq->obj_pool, &tq->cells[i].obj);
+        }
     }
-    av_fifo_freep2(&tq->fifo);
+    av_freep(&tq->cells);
 
     objpool_free(&tq->obj_pool);
 
@@ -99,17 +129,30 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
         return NULL;
     }
 
+    tq->obj_pool = obj_pool;
+    tq->obj_move = obj_move;
+
     tq->finished = av_calloc(nb_streams, sizeof(*tq->finished));
     if (!tq->finished)
         goto fail;
+    for (unsigned int i = 0; i < nb_streams; i++)
+        atomic_init(&tq->finished[i], 0);
     tq->nb_streams = nb_streams;
 
-    tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
-    if (!tq->fifo)
+    tq->cells = av_calloc(queue_size, sizeof(*tq->cells));
+    if (!tq->cells)
         goto fail;
+    tq->nb_cells = queue_size;
+    for (size_t i = 0; i < queue_size; i++) {
+        atomic_init(&tq->cells[i].seq, 2 * i);
+        if (objpool_get(obj_pool, &tq->cells[i].obj) < 0)
+            goto fail;
+    }
 
-    tq->obj_pool = obj_pool;
-    tq->obj_move = obj_move;
+    atomic_init(&tq->send_pos, 0);
+    atomic_init(&tq->recv_pos, 0);
+    atomic_init(&tq->nb_waiters, 0);
+    tq->spin_count = av_cpu_count() > 1 ? SPIN_COUNT : 0;
 
     return tq;
 fail:
@@ -117,68 +160,183 @@ fail:
     return NULL;
 }
 
-int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+void tq_set_account(ThreadQueue *tq, void (*account)(const void *obj, int dir))
 {
-    int *finished;
-    int ret;
+    tq->obj_account = account;
+}
 
-    av_assert0(stream_idx < tq->nb_streams);
-    finished = &tq->finished[stream_idx];
+static int queue_push(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    uint64_t pos = atomic_load_explicit(&tq->send_pos, memory_order_relaxed);
+    Cell *cell;
 
-    pthread_mutex_lock(&tq->lock);
+    while (1) {
+        int64_t diff;
+
+        cell = &tq->cells[pos % tq->nb_cells];
+        diff = (int64_t)(atomic_load_explicit(&cell->seq, memory_order_acquire) - 2 * pos);
+        if (!diff) {
+            if (atomic_compare_exchange_weak_explicit(&tq->send_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return 0;
+        } else
+            pos = atomic_load_explicit(&tq->send_pos, memory_order_relaxed);
+    }
 
-    if (*finished & FINISHED_SEND) {
-        ret = AVERROR(EINVAL);
-        goto finish;
+    tq->obj_move(cell->obj, data);
+    if (tq->obj_account)
+        tq->obj_account(cell->obj, 1);
+    cell->stream_idx = stream_idx;
+    atomic_store_explicit(&cell->seq, 2 * pos + 1, memory_order_release);
+
+    return 1;
+}
+
+static int queue_pop(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    uint64_t pos = atomic_load_explicit(&tq->recv_pos, memory_order_relaxed);
+    Cell *cell;
+
+    while (1) {
+        int64_t diff;
+
+        cell = &tq->cells[pos % tq->nb_cells];
+        diff = (int64_t)(atomic_load_explicit(&cell->seq, memory_order_acquire) - (2 * pos + 1));
+        if (!diff) {
+            if (atomic_compare_exchange_weak_explicit(&tq->recv_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return 0;
+        } else
+            pos = atomic_load_explicit(&tq->recv_pos, memory_order_relaxed);
     }
 
-    while (!(*finished & FINISHED_RECV) && !av_fifo_can_write(tq->fifo))
-        pthread_cond_wait(&tq->cond, &tq->lock);
+    tq->obj_move(data, cell->obj);
+    if (tq->obj_account)
+        tq->obj_account(data, -1);
+    *stream_idx = cell->stream_idx;
+    atomic_store_explicit(&cell->seq, 2 * (pos + tq->nb_cells), memory_order_release);
 
-    if (*finished & FINISHED_RECV) {
-        ret = AVERROR_EOF;
-        *finished |= FINISHED_SEND;
-    } else {
-        FifoElem elem = { .stream_idx = stream_idx };
+    return 1;
+}
 
-        ret = objpool_get(tq->obj_pool, &elem.obj);
-        if (ret < 0)
-            goto finish;
+static int can_send(ThreadQueue *tq, unsigned int stream_idx)
+{
+    uint64_t pos = atomic_load(&tq->send_pos);
 
-        tq->obj_move(elem.obj, data);
+    return (atomic_load(&tq->finished[stream_idx]) & FINISHED_RECV) ||
+           atomic_load(&tq->cells[pos % tq->nb_cells].seq) == 2 * pos;
+}
 
-        ret = av_fifo_write(tq->fifo, &elem, 1);
-        av_assert0(ret >= 0);
-        pthread_cond_broadcast(&tq->cond);
+static int can_receive(ThreadQueue *tq)
+{
+    uint64_t pos = atomic_load(&tq->recv_pos);
+    unsigned int nb_finished = 0;
+
+    if (atomic_load(&tq->cells[pos % tq->nb_cells].seq) == 2 * pos + 1)
+        return 1;
+
+    for (unsigned int i = 0; i < tq->nb_streams; i++) {
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (finished & FINISHED_SEND) {
+            if (!(finished & FINISHED_RECV))
+                return 1;
+            nb_finished++;
+        }
     }
 
-finish:
+    return nb_finished == tq->nb_streams;
+}
+
+/* Sleep until woken up, unless the condition the caller is waiting for
+ * is already met. A sender waits with stream_idx >= 0, the receiver with -1. */
+static void park(ThreadQueue *tq, int stream_idx)
+{
+    pthread_mutex_lock(&tq->lock);
+
+    /* the count is reset by whoever wakes us up, so that the items after
+     * the one that did are not followed by more wakeups */
+    atomic_fetch_add(&tq->nb_waiters, 1);
+    /* pairs with the fence in unpark(): either the other side sees us waiting,
+     * or we see what it did */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!(stream_idx >= 0 ? can_send(tq, stream_idx) : can_receive(tq)))
+        pthread_cond_wait(&tq->cond, &tq->lock);
+
     pthread_mutex_unlock(&tq->lock);
+}
 
-    return ret;
+/* Wake up the threads sleeping on the queue, if there are any. */
+static void unpark(ThreadQueue *tq, int force)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (force || atomic_load_explicit(&tq->nb_waiters, memory_order_relaxed)) {
+        pthread_mutex_lock(&tq->lock);
+        if (force || atomic_load_explicit(&tq->nb_waiters, memory_order_relaxed)) {
+            atomic_store_explicit(&tq->nb_waiters, 0, memory_order_relaxed);
+            pthread_cond_broadcast(&tq->cond);
+        }
+        pthread_mutex_unlock(&tq->lock);
+    }
+}
+
+int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    atomic_int *finished;
+
+    av_assert0(stream_idx < tq->nb_streams);
+    finished = &tq->finished[stream_idx];
+
+    if (atomic_load(finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    for (int spin = 0; ; spin++) {
+        if (atomic_load(finished) & FINISHED_RECV) {
+            atomic_fetch_or(finished, FINISHED_SEND);
+            return AVERROR_EOF;
+        }
+
+        if (queue_push(tq, stream_idx, data))
+            break;
+
+        if (spin >= tq->spin_count)
+            park(tq, stream_idx);
+    }
+
+    unpark(tq, 0);
+
+    return 0;
 }
 
-static int receive_locked(ThreadQueue *tq, int *stream_idx,
-                          void *data)
+static int receive_nonblock(ThreadQueue *tq, int *stream_idx, void *data)
 {
-    FifoElem elem;
     unsigned int nb_finished = 0;
 
-    if (av_fifo_read(tq->fifo, &elem, 1) >= 0) {
-        tq->obj_move(data, elem.obj);
-        objpool_release(tq->obj_pool, &elem.obj);
-        *stream_idx = elem.stream_idx;
+    if (queue_pop(tq, stream_idx, data))
         return 0;
-    }
 
     for (unsigned int i = 0; i < tq->nb_streams; i++) {
-        if (!(tq->finished[i] & FINISHED_SEND))
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (!(finished & FINISHED_SEND))
             continue;
 
         /* return EOF to the consumer at most once for each stream */
-        if (!(tq->finished[i] & FINISHED_RECV)) {
-            tq->finished[i] |= FINISHED_RECV;
-            *stream_idx   = i;
+        if (!(finished & FINISHED_RECV)) {
+            /* the flag was read first, so everything sent for the stream
+             * before it finished is in the queue now; it may still be
+             * being written though */
+            if (atomic_load(&tq->send_pos) != atomic_load(&tq->recv_pos))
+                return AVERROR(EAGAIN);
+
+            atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
+            *stream_idx = i;
             return AVERROR_EOF;
         }
 
@@ -194,22 +352,24 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 
     *stream_idx = -1;
 
-    pthread_mutex_lock(&tq->lock);
-
-    while (1) {
-        ret = receive_locked(tq, stream_idx, data);
-        if (ret == AVERROR(EAGAIN)) {
-            pthread_cond_wait(&tq->cond, &tq->lock);
-            continue;
-        }
-
-        break;
+    for (int spin = 0; ; spin++) {
+        ret = receive_nonblock(tq, stream_idx, data);
+        if (ret != AVERROR(EAGAIN))
+            break;
+
+        if (spin > tq->spin_count)
+            park(tq, -1);
+#if HAVE_SCHED_YIELD
+        else if (spin == tq->spin_count)
+            /* let the senders queue more before sleeping, so a wakeup comes
+             * with a batch of items rather than a single one */
+            sched_yield();
+#endif
     }
 
+    /* a sender may be waiting for the cell that was freed */
     if (ret == 0)
-        pthread_cond_broadcast(&tq->cond);
-
-    pthread_mutex_unlock(&tq->lock);
+        unpark(tq, 0);
 
     return ret;
 }
@@ -218,28 +378,20 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
-    pthread_mutex_lock(&tq->lock);
-
     /* mark the stream as send-finished;
      * next time the consumer thread tries to read this stream it will get
      * an EOF and recv-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_SEND;
-    pthread_cond_broadcast(&tq->cond);
-
-    pthread_mutex_unlock(&tq->lock);
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
+    unpark(tq, 1);
 }
 
 void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
-    pthread_mutex_lock(&tq->lock);
-
     /* mark the stream as recv-finished;
      * next time the producer thread tries to send for this stream, it will
      * get an EOF and send-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_RECV;
-    pthread_cond_broadcast(&tq->cond);
-
-    pthread_mutex_unlock(&tq->lock);
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
+    unpark(tq, 1);
 }
@@ -40,6 +40,14 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
                       ObjPool *obj_pool, void (*obj_move)(void *dst, void *src));
 void         tq_free(ThreadQueue **tq);
 
+/**
+ * Report the items entering and leaving the queue, e.g. to account the memory
+ * they hold. account() is called with dir = 1 for every item sent and with
+ * dir = -1 for every item received or dropped by tq_free(), from the thread
+ * doing that. Must be called before any item is sent.
+ */
+void tq_set_account(ThreadQueue *tq, void (*account)(const void *obj, int dir));
+
 /**
  * Send an item for the given stream to the queue.
  *
@@ -34,6 +34,7 @@
 
 #include <float.h>
 
+#include "libavutil/intfloat.h" //PLEX
 #include "libavutil/mathematics.h"
 #include "mathops.h"
 #include "avcodec.h"
@@ -44,6 +45,7 @@
 #include "aacenctab.h"
 #include "aacenc_utils.h"
 #include "aacenc_quantization.h"
+#include "cbrt_data.h" //PLEX
 
 #include "aacenc_is.h"
 #include "aacenc_tns.h"
@@ -139,7 +141,7 @@ static av_always_inline float quantize_and_encode_band_cost_template(
                         curbits += 21;
                     } else {
                         int c = av_clip_uintp2(quant(t, Q, ROUNDING), 13);
-                        quantized = c*cbrtf(c)*IQ;
+                        quantized = av_int2float(ff_cbrt_tab[c])*IQ; //PLEX
                         curbits += av_log2(c)*2 - 4 + 1;
                     }
                 } else {
@@ -1183,4 +1185,28 @@ const AACCoefficientsEncoder ff_aac_coders[AAC_CODER_NB] = {
         ff_aac_search_for_is,
         ff_aac_search_for_pred,
     },
+    //PLEX
+    [AAC_CODER_REALTIME] = {
+        search_for_quantizers_realtime,
+        codebook_trellis_rate,
+        quantize_and_encode_band,
+        ff_aac_encode_tns_info,
+        ff_aac_encode_ltp_info,
+        ff_aac_encode_main_pred,
+        ff_aac_adjust_common_pred,
+        ff_aac_adjust_common_ltp,
+        ff_aac_apply_main_pred,
+        ff_aac_apply_tns,
+        ff_aac_update_ltp,
+        ff_aac_ltp_insert_new_frame,
+        set_special_band_scalefactors,
+        search_for_pns,
+        mark_pns,
+        ff_aac_search_for_tns,
+        ff_aac_search_for_ltp,
+        search_for_ms,
+        ff_aac_search_for_is,
+        ff_aac_search_for_pred,
+    },
+    //PLEX
 };
@@ -61,13 +61,21 @@ static inline int ff_pns_bits(SingleChannelElement *sce, int w, int g)
     return (!g || !sce->zeroes[w*16+g-1] || !sce->can_pns[w*16+g-1]) ? 9 : 5;
 }
 
+//PLEX
+/** Outer loop iterations of the realtime coder */
+#define TWOLOOP_REALTIME_ITS   8
+/** Scalefactor refinement steps per band and iteration of the realtime coder */
+#define TWOLOOP_REALTIME_DEPTH 4
+//PLEX
+
 /**
  * two-loop quantizers search taken from ISO 13818-7 Appendix C
  */
-static void search_for_quantizers_twoloop(AVCodecContext *avctx,
-                                          AACEncContext *s,
-                                          SingleChannelElement *sce,
-                                          const float lambda)
+static av_always_inline void search_for_quantizers_twoloop_internal(AVCodecContext *avctx,
+                                                                    AACEncContext *s,
+                                                                    SingleChannelElement *sce,
+                                                                    const float lambda,
+                                                                    int maxits, int maxdepth)
 {
     int start = 0, i, w, w2, g, recomprd;
     int destbits = avctx->bit_rate * 1024.0 / avctx->sample_rate
@@ -105,7 +113,6 @@ static void search_for_quantizers_twoloop(AVCodecContext *avctx,
 
     int fflag, minscaler, maxscaler, nminscaler;
     int its  = 0;
-    int maxits = 30;
     int allz = 0;
     int tbits;
     int cutoff = 1024;
@@ -588,7 +595,7 @@ static void search_for_quantizers_twoloop(AVCodecContext *avctx,
         prev = -1;
         for (w = 0; w < sce->ics.num_windows; w += sce->ics.group_len[w]) {
             /** Start with big steps, end up fine-tunning */
-            int depth = (its > maxits/2) ? ((its > maxits*2/3) ? 1 : 3) : 10;
+            int depth = FFMIN(maxdepth, (its > maxits/2) ? ((its > maxits*2/3) ? 1 : 3) : 10);
             int edepth = depth+2;
             float uplmax = its / (maxits*0.25f) + 1.0f;
             uplmax *= (tbits > destbits) ? FFMIN(2.0f, tbits / (float)FFMAX(1,destbits)) : 1.0f;
@@ -760,4 +767,28 @@ static void search_for_quantizers_twoloop(AVCodecContext *avctx,
     }
 }
 
+static void search_for_quantizers_twoloop(AVCodecContext *avctx,
+                                          AACEncContext *s,
+                                          SingleChannelElement *sce,
+                                          const float lambda)
+{
+    search_for_quantizers_twoloop_internal(avctx, s, sce, lambda, 30, 10);
+}
+
+//PLEX
+/**
+ * Two-loop search with a bounded number of iterations and refinement
+ * steps, for realtime encoding.
+ */
+static void search_for_quantizers_realtime(AVCodecContext *avctx,
+                                           AACEncContext *s,
+                                           SingleChannelElement *sce,
+                                           const float lambda)
+{
+    search_for_quantizers_twoloop_internal(avctx, s, sce, lambda,
+                                           TWOLOOP_REALTIME_ITS,
+                                           TWOLOOP_REALTIME_DEPTH);
+}
+//PLEX
+
 #endif /* AVCODEC_AACCODER_TWOLOOP_H */
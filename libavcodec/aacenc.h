@@ -39,6 +39,7 @@ typedef enum AACCoder {
     AAC_CODER_ANMR = 0,
     AAC_CODER_TWOLOOP,
     AAC_CODER_FAST,
+    AAC_CODER_REALTIME, //PLEX
 
     AAC_CODER_NB,
 }AACCoder;
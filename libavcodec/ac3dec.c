@@ -1490,6 +1490,41 @@ static int decode_audio_block(AC3DecodeContext *s, int blk, int offset)
     return 0;
 }
 
+//PLEX
+/**
+ * Check whether a mono or stereo downmix leaves nothing of the dependent
+ * frame in the output. That is the case when its channel map does not
+ * replace L, C or R: the output is then the downmix of the independent
+ * frame alone, and the dependent frame does not need to be decoded.
+ * The bit reader must be positioned at the bitstream id of the dependent
+ * frame, as left by ff_ac3_parse_header().
+ */
+static int dependent_frame_unused(AC3DecodeContext *s, GetBitContext *gbc,
+                                  const AC3HeaderInfo *hdr)
+{
+    const AVChannelLayout mono   = (AVChannelLayout)AV_CHANNEL_LAYOUT_MONO;
+    const AVChannelLayout stereo = (AVChannelLayout)AV_CHANNEL_LAYOUT_STEREO;
+    int i, channel_map;
+
+    if (!((s->out_channels == 1 && !av_channel_layout_compare(&s->downmix_layout, &mono)) ||
+          (s->out_channels == 2 && !av_channel_layout_compare(&s->downmix_layout, &stereo))))
+        return 0;
+
+    skip_bits(gbc, 5); // bitstream id
+    for (i = 0; i < (hdr->channel_mode ? 1 : 2); i++) {
+        skip_bits(gbc, 5); // dialog normalization
+        if (get_bits1(gbc))
+            skip_bits(gbc, 8); // compression gain
+    }
+    if (!get_bits1(gbc))
+        return 0;
+    channel_map = get_bits(gbc, 16);
+
+    /* custom channel map locations 0-2 are L, C and R */
+    return !(channel_map & (7 << (EAC3_MAX_CHANNELS - 3)));
+}
+//PLEX
+
 /**
  * Decode a single AC-3 frame.
  */
@@ -1704,6 +1739,10 @@ dependent_frame:
         if (hdr.frame_type == EAC3_FRAME_TYPE_DEPENDENT) {
             if (hdr.num_blocks != s->num_blocks || s->sample_rate != hdr.sample_rate) {
                 av_log(avctx, AV_LOG_WARNING, "Ignoring non-compatible dependent frame.\n");
+            } else if (dependent_frame_unused(s, &s->gbc, &hdr)) { //PLEX
+                skip = buf_size - s->frame_size;
+                s->prev_bit_rate = hdr.bit_rate;
+                goto skip;
             } else {
                 buf += s->frame_size;
                 buf_size -= s->frame_size;
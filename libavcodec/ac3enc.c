@@ -1217,6 +1217,7 @@ static int cbr_bit_allocation(AC3EncodeContext *s)
     int ch;
     int bits_left;
     int snr_offset, snr_incr;
+    int fail_offset = 1024; //PLEX lowest offset known not to fit
 
     bits_left = 8 * s->frame_size - (s->frame_bits + s->exponent_bits);
     if (bits_left < 0)
@@ -1229,10 +1230,12 @@ static int cbr_bit_allocation(AC3EncodeContext *s)
     if ((snr_offset | s->fine_snr_offset[1]) == 1023) {
         if (bit_alloc(s, 1023) <= bits_left)
             return 0;
+        fail_offset = 1023; //PLEX
     }
 
     while (snr_offset >= 0 &&
            bit_alloc(s, snr_offset) > bits_left) {
+        fail_offset = FFMIN(fail_offset, snr_offset); //PLEX
         snr_offset -= 64;
     }
     if (snr_offset < 0)
@@ -1240,8 +1243,16 @@ static int cbr_bit_allocation(AC3EncodeContext *s)
 
     FFSWAP(uint8_t *, s->bap_buffer, s->bap1_buffer);
     for (snr_incr = 64; snr_incr > 0; snr_incr >>= 2) {
-        while (snr_offset + snr_incr <= 1023 &&
-               bit_alloc(s, snr_offset + snr_incr) <= bits_left) {
+        //PLEX
+        /* Each step ends on an offset which does not fit; the next, finer,
+           step would reach it again after 3 successes, so do not run the
+           bit allocation for it twice. Same result, fewer passes. */
+        while (snr_offset + snr_incr < fail_offset) {
+            if (bit_alloc(s, snr_offset + snr_incr) > bits_left) {
+                fail_offset = snr_offset + snr_incr;
+                break;
+            }
+        //PLEX
             snr_offset += snr_incr;
             FFSWAP(uint8_t *, s->bap_buffer, s->bap1_buffer);
         }
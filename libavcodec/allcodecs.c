@@ -25,6 +25,7 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h> //PLEX
 #include <string.h>
 
 #include "config.h"
@@ -960,22 +961,38 @@ static int       nb_dynloaded_codecs = 0;
 //PLEX
 
 
-static AVOnce av_codec_static_init = AV_ONCE_INIT;
-static void av_codec_init_static(void)
+//PLEX
+/* init_static_data() runs the first time a codec is handed out rather than
+ * for every codec on the first lookup, so e.g. probing the libx265 builds
+ * only happens when libx265 is used. */
+static AVMutex static_init_mutex = AV_MUTEX_INITIALIZER;
+static const FFCodec *static_init_done[NB_BUILTIN_CODECS + 1];
+static int nb_static_init_done;
+
+static const AVCodec *codec_init_static(const FFCodec *c)
 {
-    for (int i = 0; codec_list[i]; i++) {
-        if (codec_list[i]->init_static_data)
-            codec_list[i]->init_static_data((FFCodec*)codec_list[i]);
+    int i;
+
+    if (!c->init_static_data)
+        return &c->p;
+
+    ff_mutex_lock(&static_init_mutex);
+    for (i = 0; i < nb_static_init_done && static_init_done[i] != c; i++)
+        ;
+    if (i == nb_static_init_done) {
+        c->init_static_data((FFCodec*)c);
+        static_init_done[nb_static_init_done++] = c;
     }
+    ff_mutex_unlock(&static_init_mutex);
+    return &c->p;
 }
+//PLEX
 
 const AVCodec *av_codec_iterate(void **opaque)
 {
     uintptr_t i = (uintptr_t)*opaque;
 //PLEX
-    const FFCodec *c = codec_list[i];
-
-    ff_thread_once(&av_codec_static_init, av_codec_init_static);
+    const FFCodec *c;
 
     if (i == 0)
         ff_avcodec_scan_new_things();
@@ -996,14 +1013,12 @@ const AVCodec *av_codec_iterate(void **opaque)
     }
 
     c = codec_list[i];
-//PLEX
-
-    ff_thread_once(&av_codec_static_init, av_codec_init_static);
 
     if (c) {
         *opaque = (void*)(i + 1);
-        return &c->p;
+        return codec_init_static(c);
     }
+//PLEX
     return NULL;
 }
 
@@ -1062,31 +1077,141 @@ static enum AVCodecID remap_deprecated_codec_id(enum AVCodecID id)
     }
 }
 
+//PLEX
+/* Builtin codecs of one direction, sorted by id and by name. Ties keep the
+ * codec_list order so lookups return what a linear scan would. */
+typedef struct CodecLookup {
+    int by_id[NB_BUILTIN_CODECS + 1];
+    int by_name[NB_BUILTIN_CODECS + 1];
+    int nb;
+} CodecLookup;
+
+static CodecLookup codec_lookup[2]; ///< decoders, encoders
+static AVOnce codec_lookup_once = AV_ONCE_INIT;
+
+static int codec_cmp_id(const void *a, const void *b)
+{
+    int ia = *(const int *)a, ib = *(const int *)b;
+    enum AVCodecID ida = codec_list[ia]->p.id, idb = codec_list[ib]->p.id;
+
+    if (ida != idb)
+        return ida < idb ? -1 : 1;
+    return ia - ib;
+}
+
+static int codec_cmp_name(const void *a, const void *b)
+{
+    int ia = *(const int *)a, ib = *(const int *)b;
+    int ret = strcmp(codec_list[ia]->p.name, codec_list[ib]->p.name);
+
+    return ret ? ret : ia - ib;
+}
+
+static void codec_lookup_init(void)
+{
+    for (int i = 0; codec_list[i]; i++) {
+        const AVCodec *p = &codec_list[i]->p;
+        if (av_codec_is_decoder(p)) {
+            codec_lookup[0].by_id[codec_lookup[0].nb] = i;
+            codec_lookup[0].by_name[codec_lookup[0].nb++] = i;
+        }
+        if (av_codec_is_encoder(p)) {
+            codec_lookup[1].by_id[codec_lookup[1].nb] = i;
+            codec_lookup[1].by_name[codec_lookup[1].nb++] = i;
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        qsort(codec_lookup[i].by_id,   codec_lookup[i].nb, sizeof(int), codec_cmp_id);
+        qsort(codec_lookup[i].by_name, codec_lookup[i].nb, sizeof(int), codec_cmp_name);
+    }
+}
+
+static const CodecLookup *codec_lookup_get(int (*x)(const AVCodec *))
+{
+    ff_thread_once(&codec_lookup_once, codec_lookup_init);
+    ff_avcodec_scan_new_things();
+    return &codec_lookup[x == av_codec_is_encoder];
+}
+
+/* Index of the first entry of by_id with an id not below id. */
+static int codec_lookup_id(const CodecLookup *l, enum AVCodecID id)
+{
+    int lo = 0, hi = l->nb;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (codec_list[l->by_id[mid]]->p.id < id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int codec_lookup_name(const CodecLookup *l, const char *name)
+{
+    int lo = 0, hi = l->nb;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (strcmp(codec_list[l->by_name[mid]]->p.name, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Returns 1 when p is the codec to pick, else updates the candidates. */
+static int find_codec_match(const AVCodec *p, const AVCodecDescriptor *codec_desc,
+                            const AVCodec **fallback, const AVCodec **experimental)
+{
+    if (p->capabilities & AV_CODEC_CAP_EXPERIMENTAL && !*experimental) {
+        *experimental = p;
+    } else if (codec_desc && strcmp(codec_desc->name, p->name) == 0) {
+        return 1;
+    } else if (!*fallback)
+        *fallback = p;
+    return 0;
+}
+//PLEX
+
 static const AVCodec *find_codec(enum AVCodecID id, int (*x)(const AVCodec *))
 {
     const AVCodec *fallback = NULL; //PLEX
     const AVCodecDescriptor *codec_desc = avcodec_descriptor_get(id); //PLEX
     const AVCodec *p, *experimental = NULL;
+    const CodecLookup *l; //PLEX
+    const AVCodec *builtin_fallback, *builtin_experimental; //PLEX
     void *i = 0;
 
     id = remap_deprecated_codec_id(id);
 
+    //PLEX builtin codecs from the table, then the dynamically loaded ones
+    l = codec_lookup_get(x);
+    for (int j = codec_lookup_id(l, id);
+         j < l->nb && codec_list[l->by_id[j]]->p.id == id; j++) {
+        p = &codec_list[l->by_id[j]]->p;
+        if (find_codec_match(p, codec_desc, &fallback, &experimental))
+            return codec_init_static(ffcodec(p));
+    }
+    builtin_fallback     = fallback;
+    builtin_experimental = experimental;
+
+    i = (void *)(uintptr_t)NB_BUILTIN_CODECS;
     while ((p = av_codec_iterate(&i))) {
-        if (!x(p))
+        if (!x(p) || p->id != id)
             continue;
-        if (p->id == id) {
-            if (p->capabilities & AV_CODEC_CAP_EXPERIMENTAL && !experimental) {
-                experimental = p;
-            } else if (codec_desc && strcmp(codec_desc->name, p->name) == 0) {
-                return p;
-            } else if (!fallback)
-                fallback = p;
-        }
+        if (find_codec_match(p, codec_desc, &fallback, &experimental))
+            return p;
     }
+    //PLEX
 
     //PLEX
     if (fallback)
-        return fallback;
+        return fallback == builtin_fallback ? codec_init_static(ffcodec(fallback)) : fallback;
+    if (experimental && experimental == builtin_experimental)
+        return codec_init_static(ffcodec(experimental));
     //PLEX
 
     return experimental;
@@ -1106,10 +1231,20 @@ static const AVCodec *find_codec_by_name(const char *name, int (*x)(const AVCode
 {
     void *i = 0;
     const AVCodec *p;
+    const CodecLookup *l; //PLEX
+    int j; //PLEX
 
     if (!name)
         return NULL;
 
+    //PLEX
+    l = codec_lookup_get(x);
+    j = codec_lookup_name(l, name);
+    if (j < l->nb && !strcmp(codec_list[l->by_name[j]]->p.name, name))
+        return codec_init_static(codec_list[l->by_name[j]]);
+
+    i = (void *)(uintptr_t)NB_BUILTIN_CODECS;
+    //PLEX
     while ((p = av_codec_iterate(&i))) {
         if (!x(p))
             continue;
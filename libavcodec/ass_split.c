@@ -207,6 +207,11 @@ struct ASSSplitContext {
     int current_section;
     int field_number[FF_ARRAY_ELEMS(ass_sections)];
     int *field_order[FF_ARRAY_ELEMS(ass_sections)];
+    //PLEX
+    ASSDialog dialog;      ///< returned by ff_ass_split_dialog_view()
+    char *line;            ///< copy of the line the dialog fields point into
+    unsigned line_size;
+    //PLEX
 };
 
 
@@ -430,30 +435,31 @@ void ff_ass_free_dialog(ASSDialog **dialogp)
     av_freep(dialogp);
 }
 
+static const ASSFields dialog_fields[] = {
+    {"ReadOrder", ASS_INT, offsetof(ASSDialog, readorder)},
+    {"Layer",     ASS_INT, offsetof(ASSDialog, layer)    },
+    {"Style",     ASS_STR, offsetof(ASSDialog, style)    },
+    {"Name",      ASS_STR, offsetof(ASSDialog, name)     },
+    {"MarginL",   ASS_INT, offsetof(ASSDialog, margin_l) },
+    {"MarginR",   ASS_INT, offsetof(ASSDialog, margin_r) },
+    {"MarginV",   ASS_INT, offsetof(ASSDialog, margin_v) },
+    {"Effect",    ASS_STR, offsetof(ASSDialog, effect)   },
+    {"Text",      ASS_STR, offsetof(ASSDialog, text)     },
+};
+
 ASSDialog *ff_ass_split_dialog(ASSSplitContext *ctx, const char *buf)
 {
     int i;
-    static const ASSFields fields[] = {
-        {"ReadOrder", ASS_INT, offsetof(ASSDialog, readorder)},
-        {"Layer",     ASS_INT, offsetof(ASSDialog, layer)    },
-        {"Style",     ASS_STR, offsetof(ASSDialog, style)    },
-        {"Name",      ASS_STR, offsetof(ASSDialog, name)     },
-        {"MarginL",   ASS_INT, offsetof(ASSDialog, margin_l) },
-        {"MarginR",   ASS_INT, offsetof(ASSDialog, margin_r) },
-        {"MarginV",   ASS_INT, offsetof(ASSDialog, margin_v) },
-        {"Effect",    ASS_STR, offsetof(ASSDialog, effect)   },
-        {"Text",      ASS_STR, offsetof(ASSDialog, text)     },
-    };
 
     ASSDialog *dialog = av_mallocz(sizeof(*dialog));
     if (!dialog)
         return NULL;
 
-    for (i = 0; i < FF_ARRAY_ELEMS(fields); i++) {
+    for (i = 0; i < FF_ARRAY_ELEMS(dialog_fields); i++) {
         size_t len;
-        const int last = i == FF_ARRAY_ELEMS(fields) - 1;
-        const ASSFieldType type = fields[i].type;
-        uint8_t *ptr = (uint8_t *)dialog + fields[i].offset;
+        const int last = i == FF_ARRAY_ELEMS(dialog_fields) - 1;
+        const ASSFieldType type = dialog_fields[i].type;
+        uint8_t *ptr = (uint8_t *)dialog + dialog_fields[i].offset;
         buf = skip_space(buf);
         len = last ? strlen(buf) : strcspn(buf, ",");
         if (len >= INT_MAX) {
@@ -467,6 +473,43 @@ ASSDialog *ff_ass_split_dialog(ASSSplitContext *ctx, const char *buf)
     return dialog;
 }
 
+//PLEX
+const ASSDialog *ff_ass_split_dialog_view(ASSSplitContext *ctx, const char *buf)
+{
+    ASSDialog *dialog = &ctx->dialog;
+    size_t size = strlen(buf) + 1;
+    char *line;
+    int i;
+
+    if (size > INT_MAX)
+        return NULL;
+    line = av_fast_realloc(ctx->line, &ctx->line_size, size);
+    if (!line)
+        return NULL;
+    ctx->line = line;
+    memcpy(line, buf, size);
+
+    /* terminate the fields in place instead of copying each of them */
+    memset(dialog, 0, sizeof(*dialog));
+    for (i = 0; i < FF_ARRAY_ELEMS(dialog_fields); i++) {
+        const int last = i == FF_ARRAY_ELEMS(dialog_fields) - 1;
+        uint8_t *ptr = (uint8_t *)dialog + dialog_fields[i].offset;
+        size_t len;
+
+        line = (char *)skip_space(line);
+        len  = last ? strlen(line) : strcspn(line, ",");
+        if (dialog_fields[i].type == ASS_STR)
+            *(char **)ptr = line;
+        else
+            convert_func[dialog_fields[i].type](ptr, line, len);
+        line += len;
+        if (*line)
+            *line++ = 0;
+    }
+    return dialog;
+}
+//PLEX
+
 void ff_ass_split_free(ASSSplitContext *ctx)
 {
     if (ctx) {
@@ -475,36 +518,42 @@ void ff_ass_split_free(ASSSplitContext *ctx)
             free_section(ctx, &ass_sections[i]);
             av_freep(&(ctx->field_order[i]));
         }
+        av_freep(&ctx->line); //PLEX
         av_free(ctx);
     }
 }
 
 
+//PLEX
+static inline int is_escape(const char *buf, const char *codes)
+{
+    return buf[0] == '\\' && buf[1] && strchr(codes, buf[1]);
+}
+//PLEX
+
 int ff_ass_split_override_codes(const ASSCodesCallbacks *callbacks, void *priv,
                                 const char *buf)
 {
     const char *text = NULL;
-    char new_line[2];
     int text_len = 0;
     int drawing = 0; //PLEX
 
     while (buf && *buf) {
         if (text && callbacks->text &&
 //PLEX
-            (sscanf(buf, "\\%1[nNh]", new_line) == 1 ||
-             *buf == '{') && !drawing) {
+            (is_escape(buf, "nNh") || *buf == '{') && !drawing) {
 //PLEX
             callbacks->text(priv, text, text_len);
             text = NULL;
         }
 //PLEX
-        if (sscanf(buf, "\\%1[h]", new_line) == 1) {
+        if (is_escape(buf, "h")) {
             callbacks->text(priv, " ", 1);
             buf += 2;
-        } else if (sscanf(buf, "\\%1[nN]", new_line) == 1) {
+        } else if (is_escape(buf, "nN")) {
 //PLEX
             if (callbacks->new_line)
-                callbacks->new_line(priv, new_line[0] == 'N');
+                callbacks->new_line(priv, buf[1] == 'N');
             buf += 2;
 //PLEX
         } else if (*buf == '{') {
@@ -515,55 +564,65 @@ int ff_ass_split_override_codes(const ASSCodesCallbacks *callbacks, void *priv,
                 unsigned int color = 0xFFFFFFFF;
                 int len, size = -1, an = -1, alpha = -1;
                 int x1, y1, x2, y2, t1 = -1, t2 = -1;
-                if (sscanf(buf, "\\%1[bisu]%1[01\\}]%n", style, c, &len) > 1) {
+                /* the code letter rules out most patterns without scanning them */
+                const char code = buf[1];
+                const int num = code >= '1' && code <= '4';
+                if (strchr("bisu", code) && sscanf(buf, "\\%1[bisu]%1[01\\}]%n", style, c, &len) > 1) {
                     int close = c[0] == '0' ? 1 : c[0] == '1' ? 0 : -1;
                     len += close != -1;
                     if (callbacks->style)
                         callbacks->style(priv, style[0], close);
 //PLEX
-                } else if (sscanf(buf, "\\p%u%1[\\}]%n", &size, sep, &len) > 1) {
+                } else if (code == 'p' && sscanf(buf, "\\p%u%1[\\}]%n", &size, sep, &len) > 1) {
                     drawing = (size > 0);
 //PLEX
-                } else if (sscanf(buf, "\\c%1[\\}]%n", sep, &len) > 0 ||
-                           sscanf(buf, "\\c&H%X&%1[\\}]%n", &color, sep, &len) > 1 ||
-                           sscanf(buf, "\\%1[1234]c%1[\\}]%n", c_num, sep, &len) > 1 ||
-                           sscanf(buf, "\\%1[1234]c&H%X&%1[\\}]%n", c_num, &color, sep, &len) > 2) {
+                } else if ((code == 'c' || num) &&
+                           (sscanf(buf, "\\c%1[\\}]%n", sep, &len) > 0 ||
+                            sscanf(buf, "\\c&H%X&%1[\\}]%n", &color, sep, &len) > 1 ||
+                            sscanf(buf, "\\%1[1234]c%1[\\}]%n", c_num, sep, &len) > 1 ||
+                            sscanf(buf, "\\%1[1234]c&H%X&%1[\\}]%n", c_num, &color, sep, &len) > 2)) {
                     if (callbacks->color)
                         callbacks->color(priv, color, c_num[0] - '0');
-                } else if (sscanf(buf, "\\alpha%1[\\}]%n", sep, &len) > 0 ||
-                           sscanf(buf, "\\alpha&H%2X&%1[\\}]%n", &alpha, sep, &len) > 1 ||
-                           sscanf(buf, "\\%1[1234]a%1[\\}]%n", c_num, sep, &len) > 1 ||
-                           sscanf(buf, "\\%1[1234]a&H%2X&%1[\\}]%n", c_num, &alpha, sep, &len) > 2) {
+                } else if ((code == 'a' || num) &&
+                           (sscanf(buf, "\\alpha%1[\\}]%n", sep, &len) > 0 ||
+                            sscanf(buf, "\\alpha&H%2X&%1[\\}]%n", &alpha, sep, &len) > 1 ||
+                            sscanf(buf, "\\%1[1234]a%1[\\}]%n", c_num, sep, &len) > 1 ||
+                            sscanf(buf, "\\%1[1234]a&H%2X&%1[\\}]%n", c_num, &alpha, sep, &len) > 2)) {
                     if (callbacks->alpha)
                         callbacks->alpha(priv, alpha, c_num[0] - '0');
-                } else if (sscanf(buf, "\\fn%1[\\}]%n", sep, &len) > 0 ||
-                           sscanf(buf, "\\fn%127[^\\}]%1[\\}]%n", tmp, sep, &len) > 1) {
+                } else if (code == 'f' &&
+                           (sscanf(buf, "\\fn%1[\\}]%n", sep, &len) > 0 ||
+                            sscanf(buf, "\\fn%127[^\\}]%1[\\}]%n", tmp, sep, &len) > 1)) {
                     if (callbacks->font_name)
                         callbacks->font_name(priv, tmp[0] ? tmp : NULL);
-                } else if (sscanf(buf, "\\fs%1[\\}]%n", sep, &len) > 0 ||
-                           sscanf(buf, "\\fs%u%1[\\}]%n", &size, sep, &len) > 1) {
+                } else if (code == 'f' &&
+                           (sscanf(buf, "\\fs%1[\\}]%n", sep, &len) > 0 ||
+                            sscanf(buf, "\\fs%u%1[\\}]%n", &size, sep, &len) > 1)) {
                     if (callbacks->font_size)
                         callbacks->font_size(priv, size);
-                } else if (sscanf(buf, "\\a%1[\\}]%n", sep, &len) > 0 ||
-                           sscanf(buf, "\\a%2u%1[\\}]%n", &an, sep, &len) > 1 ||
-                           sscanf(buf, "\\an%1[\\}]%n", sep, &len) > 0 ||
-                           sscanf(buf, "\\an%1u%1[\\}]%n", &an, sep, &len) > 1) {
+                } else if (code == 'a' &&
+                           (sscanf(buf, "\\a%1[\\}]%n", sep, &len) > 0 ||
+                            sscanf(buf, "\\a%2u%1[\\}]%n", &an, sep, &len) > 1 ||
+                            sscanf(buf, "\\an%1[\\}]%n", sep, &len) > 0 ||
+                            sscanf(buf, "\\an%1u%1[\\}]%n", &an, sep, &len) > 1)) {
                     if (an != -1 && buf[2] != 'n')
                         an = (an&3) + (an&4 ? 6 : an&8 ? 3 : 0);
                     if (callbacks->alignment)
                         callbacks->alignment(priv, an);
-                } else if (sscanf(buf, "\\r%1[\\}]%n", sep, &len) > 0 ||
-                           sscanf(buf, "\\r%127[^\\}]%1[\\}]%n", tmp, sep, &len) > 1) {
+                } else if (code == 'r' &&
+                           (sscanf(buf, "\\r%1[\\}]%n", sep, &len) > 0 ||
+                            sscanf(buf, "\\r%127[^\\}]%1[\\}]%n", tmp, sep, &len) > 1)) {
                     if (callbacks->cancel_overrides)
                         callbacks->cancel_overrides(priv, tmp);
-                } else if (sscanf(buf, "\\move(%d,%d,%d,%d)%1[\\}]%n", &x1, &y1, &x2, &y2, sep, &len) > 4 ||
-                           sscanf(buf, "\\move(%d,%d,%d,%d,%d,%d)%1[\\}]%n", &x1, &y1, &x2, &y2, &t1, &t2, sep, &len) > 6) {
+                } else if (code == 'm' &&
+                           (sscanf(buf, "\\move(%d,%d,%d,%d)%1[\\}]%n", &x1, &y1, &x2, &y2, sep, &len) > 4 ||
+                            sscanf(buf, "\\move(%d,%d,%d,%d,%d,%d)%1[\\}]%n", &x1, &y1, &x2, &y2, &t1, &t2, sep, &len) > 6)) {
                     if (callbacks->move)
                         callbacks->move(priv, x1, y1, x2, y2, t1, t2);
-                } else if (sscanf(buf, "\\pos(%d,%d)%1[\\}]%n", &x1, &y1, sep, &len) > 2) {
+                } else if (code == 'p' && sscanf(buf, "\\pos(%d,%d)%1[\\}]%n", &x1, &y1, sep, &len) > 2) {
                     if (callbacks->move)
                         callbacks->move(priv, x1, y1, x1, y1, -1, -1);
-                } else if (sscanf(buf, "\\org(%d,%d)%1[\\}]%n", &x1, &y1, sep, &len) > 2) {
+                } else if (code == 'o' && sscanf(buf, "\\org(%d,%d)%1[\\}]%n", &x1, &y1, sep, &len) > 2) {
                     if (callbacks->origin)
                         callbacks->origin(priv, x1, y1);
                 } else {
@@ -123,6 +123,20 @@ void ff_ass_free_dialog(ASSDialog **dialogp);
  */
 ASSDialog *ff_ass_split_dialog(ASSSplitContext *ctx, const char *buf);
 
+//PLEX
+/**
+ * Split one ASS Dialogue line like ff_ass_split_dialog(), without allocating
+ * memory for every line. The string fields point into a buffer owned by ctx
+ * and reused from one call to the next.
+ *
+ * @param ctx Context previously initialized by ff_ass_split().
+ * @param buf String containing the ASS "Dialogue" line.
+ * @return Pointer to the split ASSDialog, valid until the next call or
+ *         ff_ass_split_free(). It must not be freed.
+ */
+const ASSDialog *ff_ass_split_dialog_view(ASSSplitContext *ctx, const char *buf);
+//PLEX
+
 /**
  * Free all the memory allocated for an ASSSplitContext.
  *
@@ -32,6 +32,7 @@
 #include "libavutil/fifo.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
+#include "libavutil/mem_internal.h" //PLEX
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
 #include "avcodec.h"
@@ -333,9 +334,11 @@ FF_ENABLE_DEPRECATION_WARNINGS
     if (!(avctx->active_thread_type & FF_THREAD_FRAME) ||
         avci->frame_thread_encoder) {
         if (codec2->init) {
+            int tag = avpriv_mem_tag_push(AV_MEM_TAG_CODEC); //PLEX
             lock_avcodec(codec2);
             ret = codec2->init(avctx);
             unlock_avcodec(codec2);
+            avpriv_mem_tag_pop(tag); //PLEX
             if (ret < 0) {
                 avci->needs_close = codec2->caps_internal & FF_CODEC_CAP_INIT_CLEANUP;
                 goto free_and_end;
@@ -448,6 +451,7 @@ av_cold int avcodec_close(AVCodecContext *avctx)
         }
         if (HAVE_THREADS && avci->thread_ctx)
             ff_thread_free(avctx);
+        ff_thread_budget_release(avctx); //PLEX
         if (avci->needs_close && ffcodec(avctx->codec)->close)
             ffcodec(avctx->codec)->close(avctx);
         avci->byte_buffer_size = 0;
@@ -710,6 +714,16 @@ int avcodec_is_open(AVCodecContext *s)
     return !!s->internal;
 }
 
+//PLEX
+int avcodec_get_thread_stats(AVCodecContext *avctx, int thread, AVCodecThreadStats *stats)
+{
+    if (!HAVE_THREADS || !avcodec_is_open(avctx) || !av_codec_is_decoder(avctx->codec) ||
+        !(avctx->active_thread_type & FF_THREAD_FRAME))
+        return AVERROR(ENOSYS);
+    return ff_frame_thread_get_stats(avctx, thread, stats);
+}
+//PLEX
+
 int attribute_align_arg avcodec_receive_frame(AVCodecContext *avctx, AVFrame *frame)
 {
     av_frame_unref(frame);
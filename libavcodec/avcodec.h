@@ -2040,6 +2040,71 @@ typedef struct AVCodecContext {
 
 //PLEX
     int separate_fields;
+
+    /**
+     * With frame threading, return each decoded frame as soon as it and all
+     * earlier frames are finished instead of after a full round of threads.
+     * Output order is unchanged.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int frame_thread_low_delay;
+
+    /**
+     * Target output frame rate for packet skipping. When set, video packets
+     * flagged AV_PKT_FLAG_DISPOSABLE are dropped in avcodec_send_packet() if
+     * an already submitted frame covers the same output interval at this
+     * rate. Can be changed between packets, e.g. to catch up after a stall.
+     * Requires pkt_timebase and packet pts to be set.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    AVRational skip_disposable_rate;
+
+    /**
+     * Number of packets dropped because of skip_disposable_rate.
+     * - encoding: unused
+     * - decoding: Set by libavcodec.
+     */
+    int64_t skipped_disposable;
+
+    /**
+     * If positive and thread_count is 0, take the automatic thread count
+     * from a process-wide budget of av_cpu_count() threads shared by all
+     * decoders with this set, in proportion to this weight. Contexts opened
+     * while the budget is used up get a single thread.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int shared_thread_weight;
+
+    /**
+     * Run slice threading jobs on the process-wide pool shared with other
+     * codecs, swscale and libavfilter instead of dedicated threads.
+     * thread_count then caps how many pool threads work on this context at
+     * once. Codecs whose slice threading needs a main function, and frame
+     * threading, keep their own threads.
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    int shared_threads;
+
+    /**
+     * Take the type of frames without a forced pict_type from their
+     * AV_FRAME_DATA_ENCODE_ANALYSIS side data, so that encoders fed the
+     * same analysis produce aligned GOPs. Encoders with their own scene cut
+     * detection disable it.
+     * - encoding: Set by user.
+     * - decoding: unused
+     */
+    int use_encode_analysis;
+
+    /**
+     * Collect the statistics returned by avcodec_get_thread_stats().
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int thread_stats;
 //PLEX
 
     /**
@@ -2249,6 +2314,13 @@ enum AVSubtitleType {
 };
 
 #define AV_SUBTITLE_FLAG_FORCED 0x00000001
+//PLEX
+/**
+ * The rect has the same position, bitmap and palette as the rect with the
+ * same index in the previous subtitle returned by the decoder.
+ */
+#define AV_SUBTITLE_FLAG_UNCHANGED 0x00000002
+//PLEX
 
 typedef struct AVSubtitleRect {
     int x;         ///< top left corner  of pict, undefined when pict is not set
@@ -2940,6 +3012,14 @@ typedef struct AVCodecParserContext {
      * one returned by a decoder.
      */
     int format;
+
+//PLEX
+    /**
+     * Set by the parser to 1 if the frame is not used as a reference by any
+     * other frame, 0 otherwise.
+     */
+    int disposable;
+//PLEX
 } AVCodecParserContext;
 
 typedef struct AVCodecParser {
@@ -3159,6 +3239,46 @@ void av_fast_padded_mallocz(void *ptr, unsigned int *size, size_t min_size);
  */
 int avcodec_is_open(AVCodecContext *s);
 
+//PLEX
+#define AV_THREAD_STATS_WAIT_BUCKETS 8
+
+/**
+ * Where the threads of a frame-threaded decoder spend their time, see
+ * avcodec_get_thread_stats(). Times are in microseconds.
+ */
+typedef struct AVCodecThreadStats {
+    int64_t packets;            ///< packets decoded
+    int64_t decode_time;        ///< in the decode callback, waits included
+    int64_t setup_time;         ///< from the start of decoding to ff_thread_finish_setup()
+    int64_t progress_waits;     ///< waits for the progress of a reference frame
+    int64_t progress_wait_time;
+    int64_t hwaccel_wait_time;  ///< waits for the thread-unsafe hwaccel lock
+    int64_t idle_time;          ///< waits for a packet from the user thread
+    /**
+     * Number of progress waits by duration: bucket i counts the waits that
+     * took less than 16 << (2 * i) microseconds and more than the bucket
+     * before, the last one all the longer waits.
+     */
+    int64_t progress_wait_hist[AV_THREAD_STATS_WAIT_BUCKETS];
+
+    /* user thread, only set in the totals */
+    int64_t submit_wait_time;   ///< waits for the previous thread to finish setup
+    int64_t output_wait_time;   ///< waits for the oldest thread to finish its frame
+} AVCodecThreadStats;
+
+/**
+ * Get the statistics of a frame-threaded decoder opened with the
+ * thread_stats option set. They are updated while decoding goes on.
+ *
+ * @param thread index of the worker thread, or -1 for the totals of all
+ *               threads
+ * @return the number of worker threads, AVERROR(ENOSYS) if frame threading
+ *         is not active or thread_stats is not set, AVERROR(EINVAL) if
+ *         thread is out of range
+ */
+int avcodec_get_thread_stats(AVCodecContext *avctx, int thread, AVCodecThreadStats *stats);
+//PLEX
+
 /**
  * @}
  */
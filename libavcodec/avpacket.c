@@ -185,11 +185,21 @@ int av_packet_from_data(AVPacket *pkt, uint8_t *data, int size)
     return 0;
 }
 
+//PLEX
+static void side_data_free(AVPacketSideData *sd)
+{
+    if (sd->type == AV_PKT_DATA_SOURCE_RANGE && sd->data &&
+        sd->size >= sizeof(AVPacketSourceRange))
+        av_buffer_unref(&((AVPacketSourceRange *)sd->data)->file);
+    av_freep(&sd->data);
+}
+//PLEX
+
 void av_packet_free_side_data(AVPacket *pkt)
 {
     int i;
     for (i = 0; i < pkt->side_data_elems; i++)
-        av_freep(&pkt->side_data[i].data);
+        side_data_free(&pkt->side_data[i]); //PLEX
     av_freep(&pkt->side_data);
     pkt->side_data_elems = 0;
 }
@@ -204,7 +214,7 @@ int av_packet_add_side_data(AVPacket *pkt, enum AVPacketSideDataType type,
         AVPacketSideData *sd = &pkt->side_data[i];
 
         if (sd->type == type) {
-            av_free(sd->data);
+            side_data_free(sd); //PLEX
             sd->data = data;
             sd->size = size;
             return 0;
@@ -301,6 +311,7 @@ const char *av_packet_side_data_name(enum AVPacketSideDataType type)
     case AV_PKT_DATA_DOVI_CONF:                  return "DOVI configuration record";
     case AV_PKT_DATA_S12M_TIMECODE:              return "SMPTE ST 12-1:2014 timecode";
     case AV_PKT_DATA_DYNAMIC_HDR10_PLUS:         return "HDR10+ Dynamic Metadata (SMPTE 2094-40)";
+    case AV_PKT_DATA_SOURCE_RANGE:               return "Source File Range"; //PLEX
     }
     return NULL;
 }
@@ -415,6 +426,16 @@ int av_packet_copy_props(AVPacket *dst, const AVPacket *src)
             return AVERROR(ENOMEM);
         }
         memcpy(dst_data, src_data, size);
+        //PLEX
+        if (type == AV_PKT_DATA_SOURCE_RANGE && size >= sizeof(AVPacketSourceRange)) {
+            AVPacketSourceRange *range = (AVPacketSourceRange *)dst_data;
+            if (range->file && !(range->file = av_buffer_ref(range->file))) {
+                av_buffer_unref(&dst->opaque_ref);
+                av_packet_free_side_data(dst);
+                return AVERROR(ENOMEM);
+            }
+        }
+        //PLEX
     }
 
     return 0;
@@ -727,7 +748,7 @@ void av_packet_side_data_remove(AVPacketSideData *sd, int *pnb_sd,
     for (int i = nb_sd - 1; i >= 0; i--) {
         if (sd[i].type != type)
             continue;
-        av_free(sd[i].data);
+        side_data_free(&sd[i]); //PLEX
         sd[i] = sd[--nb_sd];
         break;
     }
@@ -741,7 +762,7 @@ void av_packet_side_data_free(AVPacketSideData **psd, int *pnb_sd)
     int nb_sd = *pnb_sd;
 
     for (int i = 0; i < nb_sd; i++)
-        av_free(sd[i].data);
+        side_data_free(&sd[i]); //PLEX
 
     av_freep(psd);
     *pnb_sd = 0;
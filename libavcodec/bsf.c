@@ -222,6 +222,12 @@ int av_bsf_send_packet(AVBSFContext *ctx, AVPacket *pkt)
     ret = av_packet_make_refcounted(pkt);
     if (ret < 0)
         return ret;
+    //PLEX
+    /* the payload may no longer match the input file once filtered */
+    if (strcmp(ctx->filter->name, "null"))
+        av_packet_side_data_remove(pkt->side_data, &pkt->side_data_elems,
+                                   AV_PKT_DATA_SOURCE_RANGE);
+    //PLEX
     av_packet_move_ref(bsfi->buffer_pkt, pkt);
 
     return 0;
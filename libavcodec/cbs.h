@@ -251,6 +251,17 @@ typedef struct CodedBitstreamContext {
      */
     int nb_decompose_unit_types;
 
+    //PLEX
+    /**
+     * Drop the units whose type is not in decompose_unit_types while
+     * splitting the fragment, so their payload is not copied or kept.
+     * Only for users which inspect fragments and never write them back;
+     * the parameter sets needed to parse the wanted units must be listed
+     * too. Supported for H.264, H.265 and H.266.
+     */
+    int discard_undecomposed;
+    //PLEX
+
     /**
      * Enable trace output during read/write operations.
      */
@@ -534,6 +534,17 @@ static int cbs_h2645_split_fragment(CodedBitstreamContext *ctx,
     if (frag->data_size == 0)
         return 0;
 
+    //PLEX
+    priv->read_packet.skip_nal_types = 0;
+    if (ctx->discard_undecomposed && ctx->decompose_unit_types) {
+        uint64_t keep = 0;
+        for (int i = 0; i < ctx->nb_decompose_unit_types; i++)
+            if (ctx->decompose_unit_types[i] < 64)
+                keep |= 1ULL << ctx->decompose_unit_types[i];
+        priv->read_packet.skip_nal_types = ~keep;
+    }
+    //PLEX
+
     if (header && frag->data[0] && codec_id == AV_CODEC_ID_H264) {
         // AVCC header.
         size_t size, start, end;
@@ -88,6 +88,15 @@
  * encoders do.
  */
 #define FF_CODEC_CAP_EOF_FLUSH              (1 << 10)
+//PLEX
+/**
+ * The decoder always decodes at full resolution; for lowres > 0, the generic
+ * code box-filters its output frames down by 2^lowres. Decoders may further
+ * cut corners (e.g. skip loop filters) when lowres is set, since the result
+ * is only meant to be an approximation used for thumbnails.
+ */
+#define FF_CODEC_CAP_LOWRES_DOWNSCALE       (1 << 11)
+//PLEX
 
 /**
  * FFCodec.codec_tags termination value
@@ -35,6 +35,9 @@
 #include "libavutil/hwcontext.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
+#include "libavutil/mem_internal.h" //PLEX
+#include "libavutil/pixdesc.h"
+#include "libavutil/tracepoint.h" //PLEX
 
 #include "avcodec.h"
 #include "avcodec_internal.h"
@@ -60,6 +63,15 @@ typedef struct DecodeContext {
      * The caller has submitted a NULL packet on input.
      */
     int draining_started;
+
+    //PLEX
+    /**
+     * State for skip_disposable_rate: the rate the slots are counted in and
+     * the first output slot not yet covered by a submitted frame.
+     */
+    AVRational skip_rate;
+    int64_t    skip_next_slot;
+    //PLEX
 } DecodeContext;
 
 static DecodeContext *decode_ctx(AVCodecInternal *avci)
@@ -427,7 +439,9 @@ static inline int decode_simple_internal(AVCodecContext *avctx, AVFrame *frame,
     if (HAVE_THREADS && avctx->active_thread_type & FF_THREAD_FRAME) {
         consumed = ff_thread_decode_frame(avctx, frame, &got_frame, pkt);
     } else {
+        int tag = avpriv_mem_tag_push(AV_MEM_TAG_CODEC); //PLEX
         consumed = codec->cb.decode(avctx, frame, &got_frame, pkt);
+        avpriv_mem_tag_pop(tag); //PLEX
 
         if (!(codec->caps_internal & FF_CODEC_CAP_SETS_PKT_DTS))
             frame->pkt_dts = pkt->dts;
@@ -631,7 +645,9 @@ static int decode_receive_frame_internal(AVCodecContext *avctx, AVFrame *frame)
     av_assert0(!frame->buf[0]);
 
     if (codec->cb_type == FF_CODEC_CB_TYPE_RECEIVE_FRAME) {
+        int tag = avpriv_mem_tag_push(AV_MEM_TAG_CODEC); //PLEX
         ret = codec->cb.receive_frame(avctx, frame);
+        avpriv_mem_tag_pop(tag); //PLEX
         emms_c();
         if (!ret) {
             if (avctx->codec->type == AVMEDIA_TYPE_VIDEO)
@@ -714,6 +730,39 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return ret;
 }
 
+//PLEX
+static int skip_disposable_packet(AVCodecContext *avctx, const AVPacket *pkt)
+{
+    DecodeContext *dc = decode_ctx(avctx->internal);
+    AVRational rate = avctx->skip_disposable_rate;
+    int64_t slot;
+
+    if (avctx->codec_type != AVMEDIA_TYPE_VIDEO ||
+        rate.num <= 0 || rate.den <= 0 ||
+        avctx->pkt_timebase.num <= 0 || avctx->pkt_timebase.den <= 0 ||
+        pkt->pts == AV_NOPTS_VALUE)
+        return 0;
+
+    slot = av_rescale_q_rnd(pkt->pts, avctx->pkt_timebase, av_inv_q(rate),
+                            AV_ROUND_DOWN | AV_ROUND_PASS_MINMAX);
+
+    if (av_cmp_q(rate, dc->skip_rate)) {
+        dc->skip_rate      = rate;
+        dc->skip_next_slot = slot;
+    }
+
+    if ((pkt->flags & AV_PKT_FLAG_DISPOSABLE) && slot < dc->skip_next_slot) {
+        avctx->skipped_disposable++;
+        av_log(avctx, AV_LOG_TRACE, "Skipping disposable packet, pts %"PRId64"\n",
+               pkt->pts);
+        return 1;
+    }
+
+    if (slot >= dc->skip_next_slot)
+        dc->skip_next_slot = slot + 1;
+    return 0;
+}
+
 int attribute_align_arg avcodec_send_packet(AVCodecContext *avctx, const AVPacket *avpkt)
 {
     AVCodecInternal *avci = avctx->internal;
@@ -729,9 +778,14 @@ int attribute_align_arg avcodec_send_packet(AVCodecContext *avctx, const AVPacke
     if (avpkt && !avpkt->size && avpkt->data)
         return AVERROR(EINVAL);
 
+    FF_TRACE3(decode_send, avctx->codec->name, avpkt ? avpkt->size : 0,
+              avpkt ? avpkt->pts : AV_NOPTS_VALUE); //PLEX
+
     if (avpkt && (avpkt->data || avpkt->side_data_elems)) {
         if (!AVPACKET_IS_EMPTY(avci->buffer_pkt))
             return AVERROR(EAGAIN);
+        if (skip_disposable_packet(avctx, avpkt)) //PLEX
+            return 0;
         ret = av_packet_ref(avci->buffer_pkt, avpkt);
         if (ret < 0)
             return ret;
@@ -774,6 +828,90 @@ static int apply_cropping(AVCodecContext *avctx, AVFrame *frame)
                                           AV_FRAME_CROP_UNALIGNED : 0);
 }
 
+//PLEX
+#define LOWRES_DOWNSCALE_PLANE(type)                                             \
+    for (int y = 0; y < dst_h; y++) {                                            \
+        const int y0 = y << lowres, y1 = FFMIN(y0 + (1 << lowres), src_h);       \
+        type *out = (type *)(dst->data[p] + y * dst->linesize[p]);               \
+        for (int x = 0; x < dst_w; x++) {                                        \
+            const int x0 = x << lowres, x1 = FFMIN(x0 + (1 << lowres), src_w);   \
+            unsigned sum = 0;                                                    \
+            for (int yy = y0; yy < y1; yy++) {                                   \
+                const type *in = (const type *)(src->data[p] + yy * src->linesize[p]); \
+                for (int xx = x0; xx < x1; xx++)                                 \
+                    sum += in[xx];                                               \
+            }                                                                    \
+            n = (x1 - x0) * (y1 - y0);                                           \
+            out[x] = (sum + n / 2) / n;                                          \
+        }                                                                        \
+    }
+
+/**
+ * Box-filter a full resolution frame down by 2^lowres, for decoders with
+ * FF_CODEC_CAP_LOWRES_DOWNSCALE. Only native endian planar formats with
+ * 8 or 16-bit storage are handled; anything else is returned unchanged.
+ */
+static int lowres_downscale(AVCodecContext *avctx, AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    const int lowres = avctx->lowres;
+    AVFrame *src = frame, *dst;
+    int bytes, ret;
+
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL |
+                                 AV_PIX_FMT_FLAG_BITSTREAM)))
+        return 0;
+    bytes = desc->comp[0].depth > 8 ? 2 : 1;
+    for (int i = 0; i < desc->nb_components; i++) {
+        if (desc->comp[i].step != bytes || desc->comp[i].shift ||
+            (bytes > 1 && !!(desc->flags & AV_PIX_FMT_FLAG_BE) != HAVE_BIGENDIAN)) {
+            av_log_once(avctx, AV_LOG_WARNING, AV_LOG_DEBUG,
+                        &avctx->internal->lowres_warned,
+                        "lowres is not supported for %s, output is full size\n",
+                        desc->name);
+            return 0;
+        }
+    }
+
+    dst = av_frame_alloc();
+    if (!dst)
+        return AVERROR(ENOMEM);
+    dst->format = src->format;
+    dst->width  = AV_CEIL_RSHIFT(src->width,  lowres);
+    dst->height = AV_CEIL_RSHIFT(src->height, lowres);
+    if ((ret = av_frame_get_buffer(dst, 0)) < 0 ||
+        (ret = av_frame_copy_props(dst, src)) < 0) {
+        av_frame_free(&dst);
+        return ret;
+    }
+    dst->crop_top    >>= lowres;
+    dst->crop_bottom >>= lowres;
+    dst->crop_left   >>= lowres;
+    dst->crop_right  >>= lowres;
+
+    for (int p = 0; p < av_pix_fmt_count_planes(src->format); p++) {
+        const int cw = (p == 1 || p == 2) ? desc->log2_chroma_w : 0;
+        const int ch = (p == 1 || p == 2) ? desc->log2_chroma_h : 0;
+        const int src_w = AV_CEIL_RSHIFT(src->width,  cw);
+        const int src_h = AV_CEIL_RSHIFT(src->height, ch);
+        const int dst_w = AV_CEIL_RSHIFT(dst->width,  cw);
+        const int dst_h = AV_CEIL_RSHIFT(dst->height, ch);
+        int n;
+
+        if (bytes == 1) {
+            LOWRES_DOWNSCALE_PLANE(uint8_t)
+        } else {
+            LOWRES_DOWNSCALE_PLANE(uint16_t)
+        }
+    }
+
+    av_frame_unref(frame);
+    av_frame_move_ref(frame, dst);
+    av_frame_free(&dst);
+    return 0;
+}
+//PLEX
+
 // make sure frames returned to the caller are valid
 static int frame_validate(AVCodecContext *avctx, AVFrame *frame)
 {
@@ -825,6 +963,15 @@ int ff_decode_receive_frame(AVCodecContext *avctx, AVFrame *frame)
         ret = apply_cropping(avctx, frame);
         if (ret < 0)
             goto fail;
+
+        //PLEX
+        if (avctx->lowres &&
+            (ffcodec(avctx->codec)->caps_internal & FF_CODEC_CAP_LOWRES_DOWNSCALE)) {
+            ret = lowres_downscale(avctx, frame);
+            if (ret < 0)
+                goto fail;
+        }
+        //PLEX
     }
 
     avctx->frame_num++;
@@ -881,6 +1028,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
     }
 #endif
+    FF_TRACE3(decode_receive, avctx->codec->name, frame->pts, avctx->frame_num); //PLEX
     return 0;
 fail:
     av_frame_unref(frame);
@@ -1887,6 +2035,7 @@ void ff_decode_flush_buffers(AVCodecContext *avctx)
 
     dc->nb_draining_errors = 0;
     dc->draining_started   = 0;
+    dc->skip_rate          = (AVRational){ 0, 0 }; //PLEX
 }
 
 AVCodecInternal *ff_decode_internal_alloc(void)
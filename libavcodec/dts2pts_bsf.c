@@ -156,6 +156,7 @@ static int h264_init(AVBSFContext *ctx)
 
     s->cbc->decompose_unit_types    = h264_decompose_unit_types;
     s->cbc->nb_decompose_unit_types = FF_ARRAY_ELEMS(h264_decompose_unit_types);
+    s->cbc->discard_undecomposed    = 1; //PLEX
 
     s->nb_frame = -(ctx->par_in->video_delay << 1);
     h264->last_poc = h264->highest_poc = INT_MIN;
@@ -131,6 +131,10 @@ typedef struct DVBSubContext {
     int compute_clut;
     int clut_count2[257][256];
     int substream;
+    //PLEX
+    int skip_repeats;
+    int changed;        ///< something visible changed since the last output
+    //PLEX
     int64_t prev_start;
     DVBSubRegion *region_list;
     DVBSubCLUT   *clut_list;
@@ -346,6 +350,7 @@ static av_cold int dvbsub_init_decoder(AVCodecContext *avctx)
 
     ctx->version = -1;
     ctx->prev_start = AV_NOPTS_VALUE;
+    ctx->changed = 1; //PLEX
 
     ff_thread_once(&init_static_once, init_default_clut);
 
@@ -750,6 +755,14 @@ static int save_subtitle_set(AVCodecContext *avctx, AVSubtitle *sub, int *got_ou
         avpriv_request_sample(ctx, "Different Version of Segment asked Twice");
         return AVERROR_PATCHWELCOME;
     }
+    //PLEX
+    /* a retransmitted display set needs no new bitmaps */
+    if (ctx->skip_repeats && !ctx->changed && ctx->compute_edt == 0) {
+        ff_dlog(avctx, "Display set unchanged, not output\n");
+        return 0;
+    }
+    ctx->changed = 0;
+    //PLEX
     for (display = ctx->display_list; display; display = display->next) {
         region = get_region(ctx, display->region_id);
         if (region && region->dirty)
@@ -899,6 +912,7 @@ static void dvbsub_parse_pixel_data_block(AVCodecContext *avctx, DVBSubObjectDis
 
     pbuf = region->pbuf;
     region->dirty = 1;
+    ctx->changed  = 1; //PLEX
 
     x_pos = display->x_pos;
     y_pos = display->y_pos;
@@ -985,6 +999,7 @@ static int dvbsub_parse_object_segment(AVCodecContext *avctx,
 
     const uint8_t *buf_end = buf + buf_size;
     int object_id;
+    int version; //PLEX
     DVBSubObject *object;
     DVBSubObjectDisplay *display;
     int top_field_len, bottom_field_len;
@@ -999,6 +1014,15 @@ static int dvbsub_parse_object_segment(AVCodecContext *avctx,
     if (!object)
         return AVERROR_INVALIDDATA;
 
+    //PLEX
+    /* the regions still hold the pixels of this version */
+    version = ((*buf) >> 4) & 15;
+    if (object->version == version) {
+        ff_dlog(avctx, "Object %d unchanged, version %d\n", object_id, version);
+        return 0;
+    }
+    //PLEX
+
     coding_method = ((*buf) >> 2) & 3;
     non_modifying_color = ((*buf++) >> 1) & 1;
 
@@ -1028,6 +1052,7 @@ static int dvbsub_parse_object_segment(AVCodecContext *avctx,
             dvbsub_parse_pixel_data_block(avctx, display, block, bfl, 1,
                                             non_modifying_color);
         }
+        object->version = version; //PLEX
     } else if (coding_method == 1) {
         avpriv_report_missing_feature(avctx, "coded as a string of characters");
         return AVERROR_PATCHWELCOME;
@@ -1087,6 +1112,7 @@ static int dvbsub_parse_clut_segment(AVCodecContext *avctx,
     if (clut->version != version) {
 
         clut->version = version;
+        ctx->changed  = 1; //PLEX
 
         while (buf + 4 < buf_end) {
             entry_id = *buf++;
@@ -1146,7 +1172,8 @@ static int dvbsub_parse_region_segment(AVCodecContext *avctx,
 
     const uint8_t *buf_end = buf + buf_size;
     int region_id, object_id;
-    int av_unused version;
+    int version;
+    int realloc = 0; //PLEX
     DVBSubRegion *region;
     DVBSubObject *object;
     DVBSubObjectDisplay *display;
@@ -1205,8 +1232,19 @@ static int dvbsub_parse_region_segment(AVCodecContext *avctx,
 
         fill = 1;
         region->dirty = 0;
+        realloc = 1; //PLEX
     }
 
+    //PLEX
+    /* same version: the buffer and the object list are still valid */
+    if (region->version == version && !realloc) {
+        ff_dlog(avctx, "Region %d unchanged, version %d\n", region_id, version);
+        return 0;
+    }
+    region->version = -1;
+    ctx->changed    = 1;
+    //PLEX
+
     region->depth = 1 << (((*buf++) >> 2) & 7);
     if (region->depth < 2 || region->depth > 8) {
         av_log(avctx, AV_LOG_ERROR, "region depth %d is invalid\n", region->depth);
@@ -1251,6 +1289,7 @@ static int dvbsub_parse_region_segment(AVCodecContext *avctx,
             ctx->object_list = object;
         }
 
+        object->version = -1; //PLEX redraw into the refilled region
         object->type = (*buf) >> 6;
 
         display = av_mallocz(sizeof(*display));
@@ -1284,6 +1323,8 @@ static int dvbsub_parse_region_segment(AVCodecContext *avctx,
         object->display_list = display;
     }
 
+    region->version = version; //PLEX
+
     return 0;
 }
 
@@ -1313,6 +1354,7 @@ static int dvbsub_parse_page_segment(AVCodecContext *avctx,
 
     ctx->time_out = timeout;
     ctx->version = version;
+    ctx->changed = 1; //PLEX
 
     ff_dlog(avctx, "Page time out %ds, state %d\n", ctx->time_out, page_state);
 
@@ -1405,6 +1447,7 @@ static int dvbsub_parse_display_definition_segment(AVCodecContext *avctx,
     }
 
     display_def->version = dds_version;
+    ctx->changed         = 1; //PLEX
     display_def->x       = 0;
     display_def->y       = 0;
     display_def->width   = bytestream_get_be16(&buf) + 1;
@@ -1560,6 +1603,7 @@ static const AVOption options[] = {
     {"compute_edt", "compute end of time using pts or timeout", OFFSET(compute_edt), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DS},
     {"compute_clut", "compute clut when not available(-1) or only once (-2) or always(1) or never(0)", OFFSET(compute_clut), AV_OPT_TYPE_BOOL, {.i64 = -1}, -2, 1, DS},
     {"dvb_substream", "", OFFSET(substream), AV_OPT_TYPE_INT, {.i64 = -1}, -1, 63, DS},
+    {"skip_repeats", "do not output display sets that repeat the previous one", OFFSET(skip_repeats), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DS}, //PLEX
     {NULL}
 };
 static const AVClass dvbsubdec_class = {
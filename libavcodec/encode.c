@@ -25,8 +25,10 @@
 #include "libavutil/frame.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
+#include "libavutil/mem_internal.h" //PLEX
 #include "libavutil/pixdesc.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/tracepoint.h" //PLEX
 
 #include "avcodec.h"
 #include "avcodec_internal.h"
@@ -150,6 +152,91 @@ static int encode_make_refcounted(AVCodecContext *avctx, AVPacket *avpkt)
     return 0;
 }
 
+//PLEX
+/**
+ * Pad last frame with silence in the buffers of src, if it is the only
+ * user of them and they are large enough, as is the case for frames from
+ * a pool sized for frame_size.
+ *
+ * @return 1 if padded, 0 if src cannot be padded in place, <0 on error
+ */
+static int pad_last_frame_in_place(AVCodecContext *s, AVFrame *frame, const AVFrame *src, int out_samples)
+{
+    int channels = s->ch_layout.nb_channels;
+    int planar   = av_sample_fmt_is_planar(s->sample_fmt);
+    int planes   = planar ? channels : 1;
+    size_t size  = (size_t)out_samples * av_get_bytes_per_sample(s->sample_fmt) *
+                   (planar ? 1 : channels);
+    int ret;
+
+    if (src->format != s->sample_fmt || src->linesize[0] < size ||
+        !av_frame_is_writable((AVFrame *)src))
+        return 0;
+    for (int p = 0; p < planes; p++) {
+        const AVBufferRef *buf = av_frame_get_plane_buffer(src, p);
+        if (!buf || src->extended_data[p] + size > buf->data + buf->size)
+            return 0;
+    }
+
+    ret = av_frame_ref(frame, src);
+    if (ret < 0)
+        return ret;
+    frame->nb_samples = out_samples;
+
+    ret = av_samples_set_silence(frame->extended_data, src->nb_samples,
+                                 out_samples - src->nb_samples,
+                                 channels, s->sample_fmt);
+    if (ret < 0) {
+        av_frame_unref(frame);
+        return ret;
+    }
+    return 1;
+}
+
+/**
+ * Reference src, or copy it into a frame from the encoder's pool if it is
+ * not refcounted, instead of a newly allocated one.
+ */
+static int encode_ref_frame(AVCodecContext *avctx, AVFrame *dst, const AVFrame *src)
+{
+    int ret;
+
+    if (src->buf[0] || avctx->hw_frames_ctx)
+        return av_frame_ref(dst, src);
+
+    if (avctx->codec->type == AVMEDIA_TYPE_VIDEO) {
+        if (src->format != avctx->pix_fmt)
+            return av_frame_ref(dst, src);
+        dst->width  = src->width;
+        dst->height = src->height;
+    } else if (avctx->codec->type == AVMEDIA_TYPE_AUDIO) {
+        if (src->format != avctx->sample_fmt)
+            return av_frame_ref(dst, src);
+        dst->nb_samples = src->nb_samples;
+        ret = av_channel_layout_copy(&dst->ch_layout, &src->ch_layout);
+        if (ret < 0)
+            goto fail;
+    } else
+        return av_frame_ref(dst, src);
+
+    ret = ff_encode_alloc_frame(avctx, dst);
+    if (ret < 0)
+        return ret;
+    ret = av_frame_copy_props(dst, src);
+    if (ret < 0)
+        goto fail;
+    ret = av_frame_copy(dst, src);
+    if (ret < 0)
+        goto fail;
+
+    return 0;
+
+fail:
+    av_frame_unref(dst);
+    return ret;
+}
+//PLEX
+
 /**
  * Pad last frame with silence.
  */
@@ -157,12 +244,20 @@ static int pad_last_frame(AVCodecContext *s, AVFrame *frame, const AVFrame *src,
 {
     int ret;
 
+    //PLEX
+    ret = pad_last_frame_in_place(s, frame, src, out_samples);
+    if (ret < 0)
+        goto fail;
+    if (ret > 0)
+        return 0;
+    //PLEX
+
     frame->format         = src->format;
     frame->nb_samples     = out_samples;
     ret = av_channel_layout_copy(&frame->ch_layout, &s->ch_layout);
     if (ret < 0)
         goto fail;
-    ret = av_frame_get_buffer(frame, 0);
+    ret = ff_encode_alloc_frame(s, frame); //PLEX
     if (ret < 0)
         goto fail;
 
@@ -259,9 +354,11 @@ int ff_encode_encode_cb(AVCodecContext *avctx, AVPacket *avpkt,
                         AVFrame *frame, int *got_packet)
 {
     const FFCodec *const codec = ffcodec(avctx->codec);
-    int ret;
+    int ret, tag;
 
+    tag = avpriv_mem_tag_push(AV_MEM_TAG_CODEC); //PLEX
     ret = codec->cb.encode(avctx, avpkt, frame, got_packet);
+    avpriv_mem_tag_pop(tag); //PLEX
     emms_c();
     av_assert0(ret <= 0);
 
@@ -387,7 +484,9 @@ static int encode_receive_packet_internal(AVCodecContext *avctx, AVPacket *avpkt
     }
 
     if (ffcodec(avctx->codec)->cb_type == FF_CODEC_CB_TYPE_RECEIVE_PACKET) {
+        int tag = avpriv_mem_tag_push(AV_MEM_TAG_CODEC); //PLEX
         ret = ffcodec(avctx->codec)->cb.receive_packet(avctx, avpkt);
+        avpriv_mem_tag_pop(tag); //PLEX
         if (ret < 0)
             av_packet_unref(avpkt);
         else
@@ -493,7 +592,7 @@ static int encode_send_frame_internal(AVCodecContext *avctx, const AVFrame *src)
         }
     }
 
-    ret = av_frame_ref(dst, src);
+    ret = encode_ref_frame(avctx, dst, src); //PLEX
     if (ret < 0)
         return ret;
 
@@ -503,6 +602,13 @@ finish:
         ret = encode_generate_icc_profile(avctx, dst);
         if (ret < 0)
             return ret;
+        //PLEX
+        if (avctx->use_encode_analysis && dst->pict_type == AV_PICTURE_TYPE_NONE) {
+            const AVFrameSideData *sd = av_frame_get_side_data(dst, AV_FRAME_DATA_ENCODE_ANALYSIS);
+            if (sd && sd->size >= sizeof(AVEncodeAnalysis))
+                dst->pict_type = ((const AVEncodeAnalysis *)sd->data)->pict_type;
+        }
+        //PLEX
     }
 
     // unset frame duration unless AV_CODEC_FLAG_FRAME_DURATION is set,
@@ -529,6 +635,9 @@ int attribute_align_arg avcodec_send_frame(AVCodecContext *avctx, const AVFrame
     if (avci->buffer_frame->buf[0])
         return AVERROR(EAGAIN);
 
+    FF_TRACE2(encode_send, avctx->codec->name,
+              frame ? frame->pts : AV_NOPTS_VALUE); //PLEX
+
     if (!frame) {
         avci->draining = 1;
     } else {
@@ -571,6 +680,7 @@ int attribute_align_arg avcodec_receive_packet(AVCodecContext *avctx, AVPacket *
             return ret;
     }
 
+    FF_TRACE3(encode_receive, avctx->codec->name, avpkt->size, avpkt->pts); //PLEX
     return 0;
 }
 
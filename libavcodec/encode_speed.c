@@ -0,0 +1,85 @@
+/*
+ * Encoder speed control against a target realtime factor
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+#include "libavutil/log.h"
+#include "libavutil/rational.h"
+
+#include "encode_speed.h"
+
+/* a slower preset typically costs 1.3-2x, so only move to one with room for it */
+#define SPEED_HEADROOM 1.6
+#define DEFAULT_WINDOW 250
+
+void ff_encode_speed_init(FFEncodeSpeed *es, AVCodecContext *avctx,
+                          double target, int level, int window)
+{
+    memset(es, 0, sizeof(*es));
+    es->target    = target;
+    es->level     = level;
+    es->max_level = level;
+    es->window    = window > 0 && window <= 2 * DEFAULT_WINDOW ? window : DEFAULT_WINDOW;
+
+    if (target > 0)
+        av_log(avctx, AV_LOG_VERBOSE, "Adapting speed every %d frames to stay "
+               "above %.2fx realtime\n", es->window, target);
+}
+
+int ff_encode_speed_update(FFEncodeSpeed *es, AVCodecContext *avctx,
+                           const AVFrame *frame, int64_t enc_time)
+{
+    double speed;
+    int level = es->level, changed;
+
+    if (es->target <= 0 || !frame)
+        return 0;
+
+    es->enc_time += enc_time;
+    if (frame->duration > 0)
+        es->media_time += frame->duration * av_q2d(avctx->time_base);
+    else if (avctx->framerate.num > 0 && avctx->framerate.den > 0)
+        es->media_time += av_q2d(av_inv_q(avctx->framerate));
+
+    if (++es->nb_frames < es->window)
+        return 0;
+
+    if (es->enc_time > 0 && es->media_time > 0) {
+        speed = es->media_time * 1000000 / es->enc_time;
+        if (speed < es->target && level > 0)
+            level--;
+        else if (speed > es->target * SPEED_HEADROOM && level < es->max_level)
+            level++;
+
+        if (level != es->level)
+            av_log(avctx, AV_LOG_VERBOSE, "Encoding at %.2fx realtime, "
+                   "switching from preset level %d to %d\n",
+                   speed, es->level, level);
+    }
+
+    changed        = level != es->level;
+    es->level      = level;
+    es->nb_frames  = 0;
+    es->enc_time   = 0;
+    es->media_time = 0;
+    return changed;
+}
@@ -0,0 +1,60 @@
+/*
+ * Encoder speed control against a target realtime factor
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_ENCODE_SPEED_H
+#define AVCODEC_ENCODE_SPEED_H
+
+#include <stdint.h>
+
+#include "avcodec.h"
+
+/**
+ * Picks a preset level for an external encoder from the time spent in it,
+ * so it runs as slow (good) as it can while staying above a target speed.
+ * Level 0 is the fastest preset, larger levels are slower.
+ */
+typedef struct FFEncodeSpeed {
+    double target;      ///< realtime factor to hold, 0 disables the control
+    int    level;       ///< current preset level
+    int    max_level;   ///< slowest level allowed, normally the configured preset
+    int    window;      ///< frames per measurement, i.e. per GOP
+
+    int     nb_frames;
+    int64_t enc_time;   ///< microseconds spent in the encoder this window
+    double  media_time; ///< seconds of input encoded this window
+} FFEncodeSpeed;
+
+/**
+ * Start speed control at the given (slowest allowed) level.
+ */
+void ff_encode_speed_init(FFEncodeSpeed *es, AVCodecContext *avctx,
+                          double target, int level, int window);
+
+/**
+ * Account one frame and, at the end of a window, adjust the level.
+ *
+ * @param enc_time microseconds spent encoding this frame
+ * @return 1 if es->level changed and the encoder should be reconfigured,
+ *         0 otherwise
+ */
+int ff_encode_speed_update(FFEncodeSpeed *es, AVCodecContext *avctx,
+                           const AVFrame *frame, int64_t enc_time);
+
+#endif /* AVCODEC_ENCODE_SPEED_H */
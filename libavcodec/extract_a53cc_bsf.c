@@ -0,0 +1,371 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Extract ATSC A/53 closed captions (CEA-608/708 cc_data) from the SEI
+ * messages of H.264/HEVC and the user data of MPEG-2 video, without
+ * decoding the video.
+ */
+
+#include <stdint.h>
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+#include "atsc_a53.h"
+#include "bsf.h"
+#include "bsf_internal.h"
+#include "bytestream.h"
+#include "h2645_parse.h"
+#include "h264.h"
+#include "hevc.h"
+#include "sei.h"
+#include "startcode.h"
+
+/* enough for the reordering of H.264 and HEVC streams */
+#define REORDER_DEPTH 16
+
+enum ExtractA53CCMode {
+    MODE_SIDE_DATA,
+    MODE_CAPTIONS,
+};
+
+typedef struct ExtractA53CCContext {
+    const AVClass *class;
+
+    H2645Packet h2645_pkt;
+    int is_nalff;
+    int nal_length_size;
+
+    /* cc_data of the current packet */
+    AVBufferRef *cc;
+
+    /* caption packets waiting to be output in presentation order */
+    AVPacket *queue[REORDER_DEPTH];
+    int nb_queued;
+    int eof;
+
+    /* AVOptions */
+    int mode;
+} ExtractA53CCContext;
+
+static int parse_t35(AVBSFContext *ctx, const uint8_t *buf, int size)
+{
+    ExtractA53CCContext *s = ctx->priv_data;
+    GetByteContext gb;
+    int country_code;
+
+    bytestream2_init(&gb, buf, size);
+    country_code = bytestream2_get_byte(&gb);
+    if (country_code == 0xFF)
+        bytestream2_skip(&gb, 1);
+    if (country_code != 0xB5 ||                        // usa_country_code
+        bytestream2_get_bytes_left(&gb) < 6 ||
+        bytestream2_get_be16u(&gb) != 0x31 ||          // atsc_provider_code
+        bytestream2_get_be32u(&gb) != MKBETAG('G', 'A', '9', '4'))
+        return 0;
+
+    return ff_parse_a53_cc(&s->cc, gb.buffer, bytestream2_get_bytes_left(&gb));
+}
+
+static int parse_sei(AVBSFContext *ctx, const uint8_t *p, const uint8_t *end)
+{
+    /* the last byte holds the rbsp trailing bits */
+    while (end - p >= 2) {
+        int type = 0, size = 0, ret;
+
+        do {
+            if (p >= end)
+                return 0;
+            type += *p;
+        } while (*p++ == 0xFF);
+        do {
+            if (p >= end)
+                return 0;
+            size += *p;
+        } while (*p++ == 0xFF);
+        if (size > end - p)
+            return 0;
+
+        if (type == SEI_TYPE_USER_DATA_REGISTERED_ITU_T_T35) {
+            ret = parse_t35(ctx, p, size);
+            if (ret < 0)
+                return ret;
+        }
+        p += size;
+    }
+    return 0;
+}
+
+static int extract_h2645(AVBSFContext *ctx, AVPacket *pkt)
+{
+    ExtractA53CCContext *s = ctx->priv_data;
+    int hevc = ctx->par_in->codec_id == AV_CODEC_ID_HEVC;
+    int ret;
+
+    ret = ff_h2645_packet_split(&s->h2645_pkt, pkt->data, pkt->size, ctx,
+                                s->is_nalff, s->nal_length_size,
+                                ctx->par_in->codec_id, 1, 0);
+    if (ret < 0)
+        return ret;
+
+    for (int i = 0; i < s->h2645_pkt.nb_nals; i++) {
+        const H2645NAL *nal = &s->h2645_pkt.nals[i];
+
+        if (hevc ? nal->type != HEVC_NAL_SEI_PREFIX && nal->type != HEVC_NAL_SEI_SUFFIX
+                 : nal->type != H264_NAL_SEI)
+            continue;
+        if (nal->size <= 1 + hevc)
+            continue;
+        ret = parse_sei(ctx, nal->data + 1 + hevc, nal->data + nal->size);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int extract_mpeg2(AVBSFContext *ctx, AVPacket *pkt)
+{
+    ExtractA53CCContext *s = ctx->priv_data;
+    const uint8_t *p = pkt->data, *end = pkt->data + pkt->size;
+    uint32_t state = -1;
+    int ret;
+
+    while (p < end) {
+        p = avpriv_find_start_code(p, end, &state);
+        /* user_data_start_code */
+        if (state != 0x1B2 || end - p < 4 || AV_RB32(p) != MKBETAG('G', 'A', '9', '4'))
+            continue;
+        ret = ff_parse_a53_cc(&s->cc, p + 4, end - p - 4);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int extract_cc(AVBSFContext *ctx, AVPacket *pkt)
+{
+    int ret;
+
+    if (ctx->par_in->codec_id == AV_CODEC_ID_MPEG2VIDEO)
+        ret = extract_mpeg2(ctx, pkt);
+    else
+        ret = extract_h2645(ctx, pkt);
+
+    /* damaged captions are not worth dropping the video for */
+    if (ret == AVERROR_INVALIDDATA) {
+        av_log(ctx, AV_LOG_WARNING, "Invalid A/53 caption data\n");
+        ret = 0;
+    }
+    return ret;
+}
+
+static void queue_insert(ExtractA53CCContext *s, AVPacket *pkt)
+{
+    int i = s->nb_queued;
+
+    while (i > 0 && s->queue[i - 1]->pts > pkt->pts) {
+        s->queue[i] = s->queue[i - 1];
+        i--;
+    }
+    s->queue[i] = pkt;
+    s->nb_queued++;
+}
+
+static void queue_pop(ExtractA53CCContext *s, AVPacket *out)
+{
+    av_packet_move_ref(out, s->queue[0]);
+    av_packet_free(&s->queue[0]);
+    s->nb_queued--;
+    memmove(s->queue, s->queue + 1, s->nb_queued * sizeof(*s->queue));
+}
+
+static int make_caption_packet(AVBSFContext *ctx, AVPacket *in)
+{
+    ExtractA53CCContext *s = ctx->priv_data;
+    AVPacket *pkt;
+    int ret;
+
+    pkt = av_packet_alloc();
+    if (!pkt)
+        return AVERROR(ENOMEM);
+    ret = av_new_packet(pkt, s->cc->size);
+    if (ret < 0)
+        goto fail;
+    memcpy(pkt->data, s->cc->data, s->cc->size);
+    ret = av_packet_copy_props(pkt, in);
+    if (ret < 0)
+        goto fail;
+    /* captions belong to the presentation time of their picture */
+    if (pkt->pts == AV_NOPTS_VALUE)
+        pkt->pts = in->dts;
+    pkt->dts    = pkt->pts;
+    pkt->flags |= AV_PKT_FLAG_KEY;
+    av_packet_free_side_data(pkt);
+
+    queue_insert(s, pkt);
+    return 0;
+fail:
+    av_packet_free(&pkt);
+    return ret;
+}
+
+static int extract_a53cc_filter(AVBSFContext *ctx, AVPacket *out)
+{
+    ExtractA53CCContext *s = ctx->priv_data;
+    AVPacket *in;
+    int ret;
+
+    for (;;) {
+        if (s->nb_queued && (s->nb_queued == REORDER_DEPTH || s->eof)) {
+            queue_pop(s, out);
+            return 0;
+        }
+        if (s->eof)
+            return AVERROR_EOF;
+
+        ret = ff_bsf_get_packet(ctx, &in);
+        if (ret == AVERROR_EOF && s->mode == MODE_CAPTIONS) {
+            s->eof = 1;
+            continue;
+        }
+        if (ret < 0)
+            return ret;
+
+        ret = extract_cc(ctx, in);
+        if (ret < 0)
+            goto fail;
+
+        if (s->mode == MODE_SIDE_DATA) {
+            if (s->cc) {
+                uint8_t *sd = av_packet_new_side_data(in, AV_PKT_DATA_A53_CC, s->cc->size);
+                if (!sd) {
+                    ret = AVERROR(ENOMEM);
+                    goto fail;
+                }
+                memcpy(sd, s->cc->data, s->cc->size);
+                av_buffer_unref(&s->cc);
+            }
+            av_packet_move_ref(out, in);
+            av_packet_free(&in);
+            return 0;
+        }
+
+        if (s->cc) {
+            ret = make_caption_packet(ctx, in);
+            av_buffer_unref(&s->cc);
+            if (ret < 0)
+                goto fail;
+        }
+        av_packet_free(&in);
+    }
+
+fail:
+    av_buffer_unref(&s->cc);
+    av_packet_free(&in);
+    return ret;
+}
+
+static int extract_a53cc_init(AVBSFContext *ctx)
+{
+    ExtractA53CCContext *s = ctx->priv_data;
+    const uint8_t *extradata = ctx->par_in->extradata;
+    int extradata_size = ctx->par_in->extradata_size;
+
+    if (ctx->par_in->codec_id == AV_CODEC_ID_H264 &&
+        extradata_size >= 7 && extradata[0] == 1) {
+        s->is_nalff        = 1;
+        s->nal_length_size = (extradata[4] & 3) + 1;
+    } else if (ctx->par_in->codec_id == AV_CODEC_ID_HEVC && extradata_size >= 23 &&
+               (extradata[0] || extradata[1] || extradata[2] > 1)) {
+        s->is_nalff        = 1;
+        s->nal_length_size = (extradata[21] & 3) + 1;
+    }
+
+    if (s->mode == MODE_CAPTIONS) {
+        AVCodecParameters *par = ctx->par_out;
+
+        av_freep(&par->extradata);
+        par->extradata_size = 0;
+        par->codec_type     = AVMEDIA_TYPE_SUBTITLE;
+        par->codec_id       = AV_CODEC_ID_EIA_608;
+        par->codec_tag      = 0;
+        par->format         = -1;
+        par->bit_rate       = 0;
+        par->width          = 0;
+        par->height         = 0;
+    }
+    return 0;
+}
+
+static void extract_a53cc_flush(AVBSFContext *ctx)
+{
+    ExtractA53CCContext *s = ctx->priv_data;
+
+    while (s->nb_queued)
+        av_packet_free(&s->queue[--s->nb_queued]);
+    av_buffer_unref(&s->cc);
+    s->eof = 0;
+}
+
+static void extract_a53cc_close(AVBSFContext *ctx)
+{
+    ExtractA53CCContext *s = ctx->priv_data;
+
+    extract_a53cc_flush(ctx);
+    ff_h2645_packet_uninit(&s->h2645_pkt);
+}
+
+static const enum AVCodecID codec_ids[] = {
+    AV_CODEC_ID_H264,
+    AV_CODEC_ID_HEVC,
+    AV_CODEC_ID_MPEG2VIDEO,
+    AV_CODEC_ID_NONE,
+};
+
+#define OFFSET(x) offsetof(ExtractA53CCContext, x)
+#define FLAGS (AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_BSF_PARAM)
+static const AVOption options[] = {
+    { "mode", "what to output", OFFSET(mode), AV_OPT_TYPE_INT,
+        { .i64 = MODE_SIDE_DATA }, MODE_SIDE_DATA, MODE_CAPTIONS, FLAGS, "mode" },
+        { "side_data", "pass the video through with the captions attached as side data",
+            0, AV_OPT_TYPE_CONST, { .i64 = MODE_SIDE_DATA }, .flags = FLAGS, .unit = "mode" },
+        { "captions", "output the captions only, as an EIA-608 stream",
+            0, AV_OPT_TYPE_CONST, { .i64 = MODE_CAPTIONS }, .flags = FLAGS, .unit = "mode" },
+    { NULL },
+};
+
+static const AVClass extract_a53cc_class = {
+    .class_name = "extract_a53cc",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const FFBitStreamFilter ff_extract_a53cc_bsf = {
+    .p.name         = "extract_a53cc",
+    .p.codec_ids    = codec_ids,
+    .p.priv_class   = &extract_a53cc_class,
+    .priv_data_size = sizeof(ExtractA53CCContext),
+    .init           = extract_a53cc_init,
+    .filter         = extract_a53cc_filter,
+    .flush          = extract_a53cc_flush,
+    .close          = extract_a53cc_close,
+};
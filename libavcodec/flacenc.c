@@ -48,6 +48,8 @@
 #define MIN_LPC_SHIFT       0
 #define MAX_LPC_SHIFT      15
 
+#define MAX_THREADS        16
+
 enum CodingMode {
     CODING_MODE_RICE  = 4,
     CODING_MODE_RICE2 = 5,
@@ -128,6 +130,23 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /* Frames are independent, with slice threads up to nb_thread_ctx of them
+     * are queued and encoded at once, each by its own copy of the context.
+     * thread_ctx[0] is the main context, the others only encode. */
+    struct FlacEncodeContext *thread_ctx[MAX_THREADS];
+    int nb_thread_ctx;
+    AVFrame *queue[MAX_THREADS];
+    int nb_queued;
+    int nb_encoded;
+    int next_out;
+    int eof;
+
+    /* per copy: current job */
+    const AVFrame *job_frame;
+    uint8_t *job_buf;
+    unsigned int job_buf_size;
+    int job_bytes;
 } FlacEncodeContext;
 
 
@@ -465,13 +484,37 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
 
     ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
                       s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+    if (ret < 0)
+        return ret;
 
     ff_bswapdsp_init(&s->bdsp);
     ff_flacencdsp_init(&s->flac_dsp);
 
+    s->nb_thread_ctx = 1;
+    if (avctx->active_thread_type & FF_THREAD_SLICE)
+        s->nb_thread_ctx = av_clip(avctx->thread_count, 1, MAX_THREADS);
+    s->thread_ctx[0] = s;
+    for (i = 0; i < s->nb_thread_ctx; i++) {
+        if (!(s->queue[i] = av_frame_alloc()))
+            return AVERROR(ENOMEM);
+        if (!i)
+            continue;
+        s->thread_ctx[i] = av_memdup(s, sizeof(*s));
+        if (!s->thread_ctx[i])
+            return AVERROR(ENOMEM);
+        s->thread_ctx[i]->md5ctx     = NULL;
+        s->thread_ctx[i]->md5_buffer = NULL;
+        ret = ff_lpc_init(&s->thread_ctx[i]->lpc_ctx, avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0) {
+            av_freep(&s->thread_ctx[i]);
+            return ret;
+        }
+    }
+
     dprint_compression_options(s);
 
-    return ret;
+    return 0;
 }
 
 
@@ -1561,9 +1604,9 @@ static void write_frame_footer(FlacEncodeContext *s)
 }
 
 
-static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
+static int write_frame(FlacEncodeContext *s, uint8_t *buf, int size)
 {
-    init_put_bits(&s->pb, avpkt->data, avpkt->size);
+    init_put_bits(&s->pb, buf, size);
     write_frame_header(s);
     write_subframes(s);
     write_frame_footer(s);
@@ -1571,10 +1614,11 @@ static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const void *samples,
+                          int nb_samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1595,7 +1639,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1606,7 +1650,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++)
+        for (i = 0; i < nb_samples * s->channels; i++)
             AV_WL32(tmp + 4*i, samples0[i]);
         buf = s->md5_buffer;
     }
@@ -1616,42 +1660,18 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
-static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
-                             const AVFrame *frame, int *got_packet_ptr)
+/* Encode s->job_frame into s->job_buf, may run in any slice thread */
+static int encode_frame_job(AVCodecContext *avctx, void *arg)
 {
-    FlacEncodeContext *s;
-    int frame_bytes, out_bytes, ret;
-
-    s = avctx->priv_data;
-
-    /* when the last block is reached, update the header in extradata */
-    if (!frame) {
-        s->max_framesize = s->max_encoded_framesize;
-        av_md5_final(s->md5ctx, s->md5sum);
-        write_streaminfo(s, avctx->extradata);
-
-        if (!s->flushed) {
-            uint8_t *side_data = av_packet_new_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA,
-                                                         avctx->extradata_size);
-            if (!side_data)
-                return AVERROR(ENOMEM);
-            memcpy(side_data, avctx->extradata, avctx->extradata_size);
+    FlacEncodeContext *s = *(FlacEncodeContext **)arg;
+    const AVFrame *frame = s->job_frame;
+    int max_framesize = s->max_framesize;
+    int frame_bytes;
 
-            avpkt->pts = s->next_pts;
-
-            *got_packet_ptr = 1;
-            s->flushed = 1;
-        }
-
-        return 0;
-    }
-
-    /* change max_framesize for small final frame */
-    if (frame->nb_samples < s->frame.blocksize) {
-        s->max_framesize = flac_get_max_frame_size(frame->nb_samples,
-                                                   s->channels,
-                                                   avctx->bits_per_raw_sample);
-    }
+    /* smaller max_framesize for small final frame */
+    if (frame->nb_samples < s->max_blocksize)
+        max_framesize = flac_get_max_frame_size(frame->nb_samples, s->channels,
+                                                avctx->bits_per_raw_sample);
 
     init_frame(s, frame->nb_samples);
 
@@ -1665,23 +1685,93 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     /* Fall back on verbatim mode if the compressed frame is larger than it
        would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
+    if (frame_bytes < 0 || frame_bytes > max_framesize) {
         s->frame.verbatim_only = 1;
         frame_bytes = encode_frame(s);
         if (frame_bytes < 0) {
             av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
+            s->job_bytes = frame_bytes;
             return frame_bytes;
         }
     }
 
-    if ((ret = ff_get_encode_buffer(avctx, avpkt, frame_bytes, 0)) < 0)
-        return ret;
+    av_fast_malloc(&s->job_buf, &s->job_buf_size, frame_bytes);
+    if (!s->job_buf) {
+        s->job_bytes = AVERROR(ENOMEM);
+        return s->job_bytes;
+    }
+    s->job_bytes = write_frame(s, s->job_buf, frame_bytes);
+    return 0;
+}
 
-    out_bytes = write_frame(s, avpkt);
+/* when the last block is reached, update the header in extradata */
+static int flac_encode_flush(AVCodecContext *avctx, AVPacket *avpkt)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    uint8_t *side_data;
+
+    if (s->flushed)
+        return AVERROR_EOF;
+
+    s->max_framesize = s->max_encoded_framesize;
+    av_md5_final(s->md5ctx, s->md5sum);
+    write_streaminfo(s, avctx->extradata);
+
+    side_data = av_packet_new_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA,
+                                        avctx->extradata_size);
+    if (!side_data)
+        return AVERROR(ENOMEM);
+    memcpy(side_data, avctx->extradata, avctx->extradata_size);
+
+    avpkt->pts = avpkt->dts = s->next_pts;
+    s->flushed = 1;
+
+    return 0;
+}
+
+static int flac_encode_receive_packet(AVCodecContext *avctx, AVPacket *avpkt)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    AVFrame *frame;
+    int out_bytes, ret;
+
+    if (s->next_out == s->nb_encoded) {
+        s->nb_encoded = s->next_out = 0;
+
+        /* a partial queue is kept on EAGAIN */
+        while (!s->eof && s->nb_queued < s->nb_thread_ctx) {
+            ret = ff_encode_get_frame(avctx, s->queue[s->nb_queued]);
+            if (ret == AVERROR_EOF)
+                s->eof = 1;
+            else if (ret < 0)
+                return ret;
+            else
+                s->nb_queued++;
+        }
+        if (!s->nb_queued)
+            return flac_encode_flush(avctx, avpkt);
+
+        for (int i = 0; i < s->nb_queued; i++) {
+            s->thread_ctx[i]->job_frame   = s->queue[i];
+            s->thread_ctx[i]->frame_count = s->frame_count + i;
+        }
+        avctx->execute(avctx, encode_frame_job, s->thread_ctx, NULL,
+                       s->nb_queued, sizeof(s->thread_ctx[0]));
+        s->frame_count += s->nb_queued;
+        s->nb_encoded   = s->nb_queued;
+    }
+
+    frame     = s->queue[s->next_out];
+    out_bytes = s->thread_ctx[s->next_out]->job_bytes;
+    if (out_bytes < 0)
+        return out_bytes;
+
+    if ((ret = ff_get_encode_buffer(avctx, avpkt, out_bytes, 0)) < 0)
+        return ret;
+    memcpy(avpkt->data, s->thread_ctx[s->next_out]->job_buf, out_bytes);
 
-    s->frame_count++;
     s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
+    if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
         av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
         return ret;
     }
@@ -1690,11 +1780,18 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     if (out_bytes < s->min_framesize)
         s->min_framesize = out_bytes;
 
+    avpkt->pts      = avpkt->dts = frame->pts;
+    avpkt->duration = frame->duration ? frame->duration :
+                      ff_samples_to_time_base(avctx, frame->nb_samples);
+    if ((ret = ff_encode_reordered_opaque(avctx, avpkt, frame)) < 0)
+        return ret;
+
     s->next_pts = frame->pts + ff_samples_to_time_base(avctx, frame->nb_samples);
 
-    av_shrink_packet(avpkt, out_bytes);
+    av_frame_unref(frame);
+    if (++s->next_out == s->nb_encoded)
+        s->nb_queued = 0;
 
-    *got_packet_ptr = 1;
     return 0;
 }
 
@@ -1703,6 +1800,14 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     FlacEncodeContext *s = avctx->priv_data;
 
+    for (int i = 1; i < MAX_THREADS && s->thread_ctx[i]; i++) {
+        ff_lpc_end(&s->thread_ctx[i]->lpc_ctx);
+        av_freep(&s->thread_ctx[i]->job_buf);
+        av_freep(&s->thread_ctx[i]);
+    }
+    for (int i = 0; i < MAX_THREADS; i++)
+        av_frame_free(&s->queue[i]);
+    av_freep(&s->job_buf);
     av_freep(&s->md5ctx);
     av_freep(&s->md5_buffer);
     ff_lpc_end(&s->lpc_ctx);
@@ -1755,14 +1860,15 @@ const FFCodec ff_flac_encoder = {
     .p.id           = AV_CODEC_ID_FLAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                       AV_CODEC_CAP_SMALL_LAST_FRAME |
-                      AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
+                      AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(FlacEncodeContext),
     .init           = flac_encode_init,
-    FF_CODEC_ENCODE_CB(flac_encode_frame),
+    FF_CODEC_RECEIVE_PACKET_CB(flac_encode_receive_packet),
     .close          = flac_encode_close,
     .p.sample_fmts  = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_S16,
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
     .p.priv_class   = &flac_encoder_class,
-    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_EOF_FLUSH,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -24,6 +24,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/cpu.h"
+#include "libavutil/mem_internal.h" //PLEX
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
 #include "avcodec.h"
@@ -76,6 +77,7 @@ static void * attribute_align_arg worker(void *v){
     AVCodecContext *avctx = v;
     ThreadContext *c = avctx->internal->frame_thread_encoder;
 
+    avpriv_mem_tag_push(AV_MEM_TAG_CODEC); //PLEX
     while (!atomic_load(&c->exit)) {
         int ret;
         AVPacket *pkt;
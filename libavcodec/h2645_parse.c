@@ -30,6 +30,7 @@
 #include "hevc.h"
 #include "h264.h"
 #include "h2645_parse.h"
+#include "startcode.h" //PLEX
 #include "vvc.h"
 
 int ff_h2645_extract_rbsp(const uint8_t *src, int length,
@@ -406,6 +407,13 @@ static int find_next_start_code(const uint8_t *buf, const uint8_t *next_avc)
         return next_avc - buf;
 
     while (buf + i + 3 < next_avc) {
+        //PLEX
+        /* keep 3 bytes for the start code itself */
+        if (buf[i])
+            i = ff_startcode_skip_nonzero(buf + i, next_avc - 3) - buf;
+        if (buf + i + 3 >= next_avc)
+            break;
+        //PLEX
         if (buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] == 1)
             break;
         i++;
@@ -460,12 +468,26 @@ fail:
     return;
 }
 
+//PLEX
+/* the NAL header is never escaped, so the type can be read from the raw bytes */
+static int peek_nal_type(const uint8_t *buf, enum AVCodecID codec_id)
+{
+    if (codec_id == AV_CODEC_ID_VVC)
+        return (buf[1] >> 3) & 0x1f;
+    else if (codec_id == AV_CODEC_ID_HEVC)
+        return (buf[0] >> 1) & 0x3f;
+    else
+        return buf[0] & 0x1f;
+}
+//PLEX
+
 int ff_h2645_packet_split(H2645Packet *pkt, const uint8_t *buf, int length,
                           void *logctx, int is_nalff, int nal_length_size,
                           enum AVCodecID codec_id, int small_padding, int use_ref)
 {
     GetByteContext bc;
     int consumed, ret = 0;
+    int nb_skipped = 0; //PLEX
     int next_avc = is_nalff ? 0 : length;
     int64_t padding = small_padding ? 0 : MAX_MBPAIR_SIZE;
 
@@ -481,6 +503,7 @@ int ff_h2645_packet_split(H2645Packet *pkt, const uint8_t *buf, int length,
         H2645NAL *nal;
         int extract_length = 0;
         int skip_trailing_zeros = 1;
+        int sized = 0; //PLEX
 
         if (bytestream2_tell(&bc) == next_avc) {
             int i = 0;
@@ -492,6 +515,7 @@ int ff_h2645_packet_split(H2645Packet *pkt, const uint8_t *buf, int length,
             bytestream2_skip(&bc, nal_length_size);
 
             next_avc = bytestream2_tell(&bc) + extract_length;
+            sized = 1; //PLEX
         } else {
             int buf_index;
 
@@ -504,7 +528,7 @@ int ff_h2645_packet_split(H2645Packet *pkt, const uint8_t *buf, int length,
             bytestream2_skip(&bc, buf_index);
 
             if (!bytestream2_get_bytes_left(&bc)) {
-                if (pkt->nb_nals > 0) {
+                if (pkt->nb_nals > 0 || nb_skipped) { //PLEX
                     // No more start codes: we discarded some irrelevant
                     // bytes at the end of the packet.
                     return 0;
@@ -523,6 +547,17 @@ int ff_h2645_packet_split(H2645Packet *pkt, const uint8_t *buf, int length,
             }
         }
 
+        //PLEX
+        /* an Annex B unit ends where the next start code search finds it */
+        if (pkt->skip_nal_types && extract_length >= 2 &&
+            pkt->skip_nal_types >> peek_nal_type(bc.buffer, codec_id) & 1) {
+            if (sized)
+                bytestream2_skip(&bc, extract_length);
+            nb_skipped++;
+            continue;
+        }
+        //PLEX
+
         if (pkt->nals_allocated < pkt->nb_nals + 1) {
             int new_size = pkt->nals_allocated + 1;
             void *tmp;
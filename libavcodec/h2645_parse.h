@@ -85,6 +85,14 @@ typedef struct H2645Packet {
     int nb_nals;
     int nals_allocated;
     unsigned nal_buffer_size;
+
+    //PLEX
+    /**
+     * NAL unit types (bit 1 << type) which ff_h2645_packet_split() drops
+     * before unescaping their payload.
+     */
+    uint64_t skip_nal_types;
+    //PLEX
 } H2645Packet;
 
 /**
@@ -49,7 +49,11 @@ static void count_or_copy(uint8_t **out, uint64_t *out_size,
     uint8_t start_code_size = ps < 0 ? 0 : *out_size == 0 || ps ? 4 : 3;
 
     if (copy) {
-        memcpy(*out + start_code_size, in, in_size);
+        //PLEX
+        /* the output may be the input packet, moved forward */
+        if (*out + start_code_size != in)
+            memmove(*out + start_code_size, in, in_size);
+        //PLEX
         if (start_code_size == 4) {
             AV_WB32(*out, 1);
         } else if (start_code_size) {
@@ -176,6 +180,7 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
     uint8_t *out;
     uint64_t out_size;
     int ret;
+    int inserted, in_place = 0; //PLEX
 
     ret = ff_bsf_get_packet(ctx, &in);
     if (ret < 0)
@@ -199,6 +204,7 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
         sps_seen = s->idr_sps_seen;
         pps_seen = s->idr_pps_seen;
         out_size = 0;
+        inserted = 0; //PLEX
 
         do {
             uint32_t nal_size = 0;
@@ -232,6 +238,7 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
                     } else {
                         count_or_copy(&out, &out_size, s->sps, s->sps_size, -1, j);
                         sps_seen = 1;
+                        inserted = 1; //PLEX
                     }
                 }
             }
@@ -244,9 +251,11 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
 
             /* prepend only to the first type 5 NAL unit of an IDR picture, if no sps/pps are already present */
             if (new_idr && unit_type == H264_NAL_IDR_SLICE && !sps_seen && !pps_seen) {
-                if (ctx->par_out->extradata)
+                if (ctx->par_out->extradata) {
                     count_or_copy(&out, &out_size, ctx->par_out->extradata,
                                   ctx->par_out->extradata_size, -1, j);
+                    inserted = 1; //PLEX
+                }
                 new_idr = 0;
             /* if only SPS has been seen, also insert PPS */
             } else if (new_idr && unit_type == H264_NAL_IDR_SLICE && sps_seen && !pps_seen) {
@@ -254,6 +263,7 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
                     LOG_ONCE(ctx, AV_LOG_WARNING, "PPS not present in the stream, nor in AVCC, stream may be unreadable\n");
                 } else {
                     count_or_copy(&out, &out_size, s->pps, s->pps_size, -1, j);
+                    inserted = 1; //PLEX
                 }
             }
 
@@ -273,23 +283,44 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
                 ret = AVERROR_INVALIDDATA;
                 goto fail;
             }
+            //PLEX
+            /* With 4-byte lengths and nothing inserted, no start code is
+             * longer than the length it replaces, so the NAL units can be
+             * rewritten in the input packet itself. */
+            in_place = s->length_size == 4 && !inserted &&
+                       in->buf && av_buffer_is_writable(in->buf) &&
+                       in->data + out_size + AV_INPUT_BUFFER_PADDING_SIZE <=
+                       in->buf->data + in->buf->size;
+            if (in_place) {
+                out = in->data;
+            } else {
+            //PLEX
             ret = av_new_packet(opkt, out_size);
             if (ret < 0)
                 goto fail;
             out = opkt->data;
+            } //PLEX
         }
     }
 #undef LOG_ONCE
 
-    av_assert1(out_size == opkt->size);
-
     s->new_idr      = new_idr;
     s->idr_sps_seen = sps_seen;
     s->idr_pps_seen = pps_seen;
 
-    ret = av_packet_copy_props(opkt, in);
-    if (ret < 0)
-        goto fail;
+    //PLEX
+    if (in_place) {
+        av_packet_move_ref(opkt, in);
+        opkt->size = out_size;
+        memset(opkt->data + out_size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    } else {
+        av_assert1(out_size == opkt->size);
+
+        ret = av_packet_copy_props(opkt, in);
+        if (ret < 0)
+            goto fail;
+    }
+    //PLEX
 
 fail:
     if (ret < 0)
@@ -1944,7 +1944,8 @@ static int h264_slice_init(H264Context *h, H264SliceContext *sl,
         (h->avctx->skip_loop_filter >= AVDISCARD_BIDIR  &&
          sl->slice_type_nos == AV_PICTURE_TYPE_B) ||
         (h->avctx->skip_loop_filter >= AVDISCARD_NONREF &&
-         nal->ref_idc == 0))
+         nal->ref_idc == 0) ||
+        h->avctx->lowres) //PLEX: approximate, see FF_CODEC_CAP_LOWRES_DOWNSCALE
         sl->deblocking_filter = 0;
 
     if (sl->deblocking_filter == 1 && h->nb_slice_ctx > 1) {
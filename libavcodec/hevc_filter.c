@@ -860,7 +860,8 @@ void ff_hevc_hls_filter(HEVCLocalContext *lc, int x, int y, int ctb_size)
         (s->avctx->skip_loop_filter >= AVDISCARD_BIDIR &&
          s->sh.slice_type == HEVC_SLICE_B) ||
         (s->avctx->skip_loop_filter >= AVDISCARD_NONREF &&
-        ff_hevc_nal_is_nonref(s->nal_unit_type)))
+        ff_hevc_nal_is_nonref(s->nal_unit_type)) ||
+        s->avctx->lowres) //PLEX: approximate, see FF_CODEC_CAP_LOWRES_DOWNSCALE
         skip = 1;
 
     if (!skip)
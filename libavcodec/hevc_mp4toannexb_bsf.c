@@ -116,6 +116,47 @@ static int hevc_mp4toannexb_init(AVBSFContext *ctx)
     return 0;
 }
 
+//PLEX
+/**
+ * With 4-byte lengths and no parameter sets to insert, the length prefixes
+ * are overwritten with start codes in place of copying the packet.
+ *
+ * @return 1 if the packet was converted, 0 if it needs the regular path
+ */
+static int hevc_mp4toannexb_in_place(AVBSFContext *ctx, AVPacket *in)
+{
+    HEVCBSFContext *s = ctx->priv_data;
+    uint8_t *const buf_end = in->data + in->size;
+
+    if (s->length_size != 4 || !in->buf || !av_buffer_is_writable(in->buf))
+        return 0;
+
+    for (const uint8_t *buf = in->data; buf < buf_end;) {
+        uint32_t nalu_size;
+        int nalu_type;
+
+        if (buf_end - buf < 4)
+            return 0;
+        nalu_size = AV_RB32(buf);
+        if (nalu_size < 2 || (int64_t)nalu_size > buf_end - buf - 4)
+            return 0;
+
+        nalu_type = (buf[4] >> 1) & 0x3f;
+        if (nalu_type >= 16 && nalu_type <= 23 && ctx->par_out->extradata_size)
+            return 0;
+        buf += 4 + nalu_size;
+    }
+
+    for (uint8_t *buf = in->data; buf < buf_end;) {
+        uint32_t nalu_size = AV_RB32(buf);
+
+        AV_WB32(buf, 1);
+        buf += 4 + nalu_size;
+    }
+    return 1;
+}
+//PLEX
+
 static int hevc_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *out)
 {
     HEVCBSFContext *s = ctx->priv_data;
@@ -129,7 +170,7 @@ static int hevc_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *out)
     if (ret < 0)
         return ret;
 
-    if (!s->extradata_parsed) {
+    if (!s->extradata_parsed || hevc_mp4toannexb_in_place(ctx, in)) { //PLEX
         av_packet_move_ref(out, in);
         av_packet_free(&in);
         return 0;
@@ -89,6 +89,11 @@ static int hevc_parse_slice_header(AVCodecParserContext *s, H2645NAL *nal,
     }
     ow  = &ps->sps->output_window;
 
+    //PLEX: sub-layer non-reference pictures have even VCL types below 16,
+    // only those of the highest sub-layer are not referenced by any picture
+    s->disposable = nal->type <= HEVC_NAL_VCL_N14 && !(nal->type & 1) &&
+                    nal->temporal_id == ps->sps->max_sub_layers - 1;
+
     s->coded_width  = ps->sps->width;
     s->coded_height = ps->sps->height;
     s->width        = ps->sps->width  - ow->left_offset - ow->right_offset;
@@ -191,6 +196,7 @@ static int parse_nal_units(AVCodecParserContext *s, const uint8_t *buf,
     /* set some sane default values */
     s->pict_type         = AV_PICTURE_TYPE_I;
     s->key_frame         = 0;
+    s->disposable        = 0; //PLEX
     s->picture_structure = AV_PICTURE_STRUCTURE_UNKNOWN;
 
     ff_hevc_reset_sei(sei);
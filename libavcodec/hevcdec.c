@@ -33,6 +33,7 @@
 #include "libavutil/md5.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/timecode.h"
 
 #include "bswapdsp.h"
@@ -2571,11 +2572,12 @@ static int hls_decode_entry(AVCodecContext *avctxt, void *arg)
 
         ctb_addr_ts++;
         ff_hevc_save_states(lc, ctb_addr_ts);
+        if (!s->filter_deferred) //PLEX
         ff_hevc_hls_filters(lc, x_ctb, y_ctb, ctb_size);
     }
 
     if (x_ctb + ctb_size >= s->ps.sps->width &&
-        y_ctb + ctb_size >= s->ps.sps->height)
+        y_ctb + ctb_size >= s->ps.sps->height && !s->filter_deferred) //PLEX
         ff_hevc_hls_filter(lc, x_ctb, y_ctb, ctb_size);
 
     return ctb_addr_ts;
@@ -2843,6 +2845,105 @@ static int set_side_data(HEVCContext *s)
     return 0;
 }
 
+//PLEX
+static void filter_wait_row(HEVCContext *s, int row, int n)
+{
+    ff_mutex_lock(&s->filter_mutex);
+    while (s->filter_progress[row] < n)
+        ff_cond_wait(&s->filter_cond, &s->filter_mutex);
+    ff_mutex_unlock(&s->filter_mutex);
+}
+
+static void filter_report_row(HEVCContext *s, int row, int n)
+{
+    ff_mutex_lock(&s->filter_mutex);
+    s->filter_progress[row] = n;
+    ff_cond_broadcast(&s->filter_cond);
+    ff_mutex_unlock(&s->filter_mutex);
+}
+
+/*
+ * Job for CTB row jobnr: the same calls hls_decode_entry() makes for this
+ * row. Each call filters the row above with a one CTB lag, so row jobnr
+ * waits until row jobnr - 1 is two CTBs ahead, as in WPP.
+ */
+static void hevc_filter_row(void *priv, int jobnr, int threadnr,
+                            int nb_jobs, int nb_threads)
+{
+    HEVCContext *s = priv;
+    HEVCLocalContext *lc = &s->filter_lc[threadnr];
+    const HEVCSPS *sps = s->ps.sps;
+    int ctb_size = 1 << sps->log2_ctb_size;
+    int y_ctb = jobnr << sps->log2_ctb_size;
+
+    for (int x = 0; x < sps->ctb_width; x++) {
+        if (jobnr)
+            filter_wait_row(s, jobnr - 1, FFMIN(x + 2, sps->ctb_width));
+        ff_hevc_hls_filters(lc, x << sps->log2_ctb_size, y_ctb, ctb_size);
+        filter_report_row(s, jobnr, x + 1);
+    }
+
+    if (jobnr == nb_jobs - 1)
+        ff_hevc_hls_filter(lc, (sps->ctb_width - 1) << sps->log2_ctb_size,
+                           y_ctb, ctb_size);
+}
+
+static int hevc_run_deferred_filters(HEVCContext *s)
+{
+    const HEVCSPS *sps = s->ps.sps;
+
+    s->filter_deferred = 0;
+
+    av_fast_malloc(&s->filter_progress, &s->filter_progress_size,
+                   sps->ctb_height * sizeof(*s->filter_progress));
+    if (!s->filter_progress)
+        return AVERROR(ENOMEM);
+    memset(s->filter_progress, 0, sps->ctb_height * sizeof(*s->filter_progress));
+
+    avpriv_slicethread_execute(s->filter_thread, sps->ctb_height, 0);
+    return 0;
+}
+
+static av_cold int hevc_init_filter_threads(HEVCContext *s)
+{
+    int ret;
+
+    if (s->avctx->shared_threads)
+        ret = avpriv_slicethread_create_shared(&s->filter_thread, s, hevc_filter_row,
+                                               s->filter_threads);
+    else
+        ret = avpriv_slicethread_create(&s->filter_thread, s, hevc_filter_row,
+                                        NULL, s->filter_threads);
+    if (ret == AVERROR(ENOSYS)) {
+        av_log(s->avctx, AV_LOG_WARNING,
+               "Threads are not supported, filter_threads is ignored.\n");
+        return 0;
+    }
+    if (ret < 0)
+        return ret;
+
+    s->filter_lc = av_calloc(ret, sizeof(*s->filter_lc));
+    if (!s->filter_lc)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < ret; i++) {
+        s->filter_lc[i].parent = s;
+        s->filter_lc[i].logctx = s->avctx;
+    }
+
+    ret = ff_mutex_init(&s->filter_mutex, NULL);
+    if (ret)
+        return AVERROR(ret);
+    ret = ff_cond_init(&s->filter_cond, NULL);
+    if (ret) {
+        ff_mutex_destroy(&s->filter_mutex);
+        return AVERROR(ret);
+    }
+    s->filter_sync_init = 1;
+
+    return 0;
+}
+//PLEX
+
 static int hevc_frame_start(HEVCContext *s)
 {
     HEVCLocalContext *lc = s->HEVClc;
@@ -2859,6 +2960,13 @@ static int hevc_frame_start(HEVCContext *s)
     s->is_decoded        = 0;
     s->first_nal_type    = s->nal_unit_type;
 
+    //PLEX
+    /* WPP slices and frame-dependent skip_loop_filter keep the inline filters */
+    s->filter_deferred = s->filter_sync_init && s->threads_number == 1 &&
+                         !s->avctx->hwaccel &&
+                         s->avctx->skip_loop_filter <= AVDISCARD_DEFAULT;
+    //PLEX
+
     s->no_rasl_output_flag = IS_IDR(s) || IS_BLA(s) || (s->nal_unit_type == HEVC_NAL_CRA_NUT && s->last_eos);
 
     if (s->ps.pps->tiles_enabled_flag)
@@ -2931,6 +3039,14 @@ static int hevc_frame_end(HEVCContext *s)
     const AVFrameSideData *sd;
     av_unused int ret;
 
+    //PLEX
+    if (s->filter_deferred) {
+        ret = hevc_run_deferred_filters(s);
+        if (ret < 0)
+            return ret;
+    }
+    //PLEX
+
     if (out->needs_fg) {
         sd = av_frame_get_side_data(out->frame, AV_FRAME_DATA_FILM_GRAIN_PARAMS);
         av_assert0(out->frame_grain->buf[0] && sd);
@@ -3473,6 +3589,17 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
     av_freep(&s->HEVClc);
     av_freep(&s->HEVClcList);
 
+    //PLEX
+    avpriv_slicethread_free(&s->filter_thread);
+    av_freep(&s->filter_lc);
+    av_freep(&s->filter_progress);
+    if (s->filter_sync_init) {
+        ff_mutex_destroy(&s->filter_mutex);
+        ff_cond_destroy(&s->filter_cond);
+        s->filter_sync_init = 0;
+    }
+    //PLEX
+
     ff_h2645_packet_uninit(&s->pkt);
 
     ff_hevc_reset_sei(&s->sei);
@@ -3635,6 +3762,14 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
     if (ret < 0)
         return ret;
 
+    //PLEX
+    if (s->filter_threads) {
+        ret = hevc_init_filter_threads(s);
+        if (ret < 0)
+            return ret;
+    }
+    //PLEX
+
     s->enable_parallel_tiles = 0;
     s->sei.picture_timing.picture_struct = 0;
     s->eos = 1;
@@ -3681,6 +3816,10 @@ static const AVOption options[] = {
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    //PLEX
+    { "filter_threads", "Threads for a deferred row-parallel deblocking/SAO pass (0 = inline filtering)",
+        OFFSET(filter_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, PAR },
+    //PLEX
     { NULL },
 };
 
@@ -3706,7 +3845,9 @@ const FFCodec ff_hevc_decoder = {
     .p.capabilities        = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                              AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS,
     .caps_internal         = FF_CODEC_CAP_EXPORTS_CROPPING |
-                             FF_CODEC_CAP_ALLOCATE_PROGRESS | FF_CODEC_CAP_INIT_CLEANUP,
+                             FF_CODEC_CAP_ALLOCATE_PROGRESS | FF_CODEC_CAP_INIT_CLEANUP |
+                             FF_CODEC_CAP_LOWRES_DOWNSCALE, //PLEX
+    .p.max_lowres          = 3, //PLEX
     .p.profiles            = NULL_IF_CONFIG_SMALL(ff_hevc_profiles),
     .hw_configs            = (const AVCodecHWConfigInternal *const []) {
 #if CONFIG_HEVC_DXVA2_HWACCEL
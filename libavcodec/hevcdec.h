@@ -27,6 +27,7 @@
 
 #include "libavutil/buffer.h"
 #include "libavutil/mem_internal.h"
+#include "libavutil/thread.h"
 
 #include "avcodec.h"
 #include "bswapdsp.h"
@@ -593,6 +594,23 @@ typedef struct HEVCContext {
                             ///< as a format defined in 14496-15
     int apply_defdispwin;
 
+    //PLEX
+    /**
+     * Deferred loop filter: deblocking and SAO run after the whole frame
+     * is decoded, one CTB row per job on a private thread pool, so that
+     * frame threads can be combined with intra-frame parallelism.
+     */
+    int filter_threads;             ///< AVOption, 0 disables the deferred pass
+    struct AVSliceThread *filter_thread;
+    HEVCLocalContext *filter_lc;    ///< one per pool thread, for SAO scratch
+    int *filter_progress;           ///< CTBs filtered per row in the current pass
+    unsigned int filter_progress_size;
+    int filter_deferred;            ///< the current frame uses the deferred pass
+    int filter_sync_init;
+    AVMutex filter_mutex;
+    AVCond  filter_cond;
+    //PLEX
+
     int nal_length_size;    ///< Number of bytes used for nal length (1, 2 or 4)
     int nuh_layer_id;
 
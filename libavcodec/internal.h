@@ -147,6 +147,16 @@ typedef struct AVCodecInternal {
 #if CONFIG_LCMS2
     FFIccContext icc; /* used to read and write embedded ICC profiles */
 #endif
+
+    //PLEX
+    int lowres_warned;
+
+    /**
+     * Threads and weight taken from the shared thread budget.
+     */
+    int budget_threads;
+    int budget_weight;
+    //PLEX
 } AVCodecInternal;
 
 /**
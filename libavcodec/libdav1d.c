@@ -36,6 +36,7 @@
 #include "codec_internal.h"
 #include "decode.h"
 #include "internal.h"
+#include "thread.h"
 
 #define FF_DAV1D_VERSION_AT_LEAST(x,y) \
     (DAV1D_API_VERSION_MAJOR > (x) || DAV1D_API_VERSION_MAJOR == (x) && DAV1D_API_VERSION_MINOR >= (y))
@@ -217,6 +218,17 @@ static av_cold int libdav1d_init(AVCodecContext *c)
 
     av_log(c, AV_LOG_INFO, "libdav1d %s\n", dav1d_version());
 
+    //PLEX
+    // explicit libdav1d thread counts do not take threads from the budget
+    if (!c->thread_count && c->shared_thread_weight > 0 &&
+#if FF_DAV1D_VERSION_AT_LEAST(6,0)
+        !dav1d->frame_threads && !dav1d->tile_threads)
+#else
+        !(dav1d->frame_threads && dav1d->tile_threads))
+#endif
+        threads = ff_thread_budget_acquire(c, av_cpu_count());
+    //PLEX
+
     dav1d_default_settings(&s);
     s.logger.cookie = c;
     s.logger.callback = libdav1d_log_callback;
@@ -28,10 +28,20 @@
 #include "encode.h"
 #include "libwebpenc_common.h"
 
-typedef LibWebPContextCommon LibWebPContext;
+//PLEX
+typedef struct LibWebPContext {
+    LibWebPContextCommon cc;
+    WebPMemoryWriter mw;      // output buffer, kept across frames
+} LibWebPContext;
+//PLEX
 
 static av_cold int libwebp_encode_init(AVCodecContext *avctx)
 {
+    //PLEX
+    LibWebPContext *s = avctx->priv_data;
+
+    WebPMemoryWriterInit(&s->mw);
+    //PLEX
     return ff_libwebp_encode_init_common(avctx);
 }
 
@@ -41,17 +51,20 @@ static int libwebp_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     LibWebPContext *s  = avctx->priv_data;
     WebPPicture *pic = NULL;
     AVFrame *alt_frame = NULL;
-    WebPMemoryWriter mw = { 0 };
 
-    int ret = ff_libwebp_get_frame(avctx, s, frame, &alt_frame, &pic);
+    int ret = ff_libwebp_get_frame(avctx, &s->cc, frame, &alt_frame, &pic);
     if (ret < 0)
         goto end;
 
-    WebPMemoryWriterInit(&mw);
-    pic->custom_ptr = &mw;
+    //PLEX
+    /* Reuse the buffer of the previous image, which is almost always large
+     * enough, instead of growing a new one for every image. */
+    s->mw.size      = 0;
+    pic->custom_ptr = &s->mw;
+    //PLEX
     pic->writer     = WebPMemoryWrite;
 
-    ret = WebPEncode(&s->config, pic);
+    ret = WebPEncode(&s->cc.config, pic);
     if (!ret) {
         av_log(avctx, AV_LOG_ERROR, "WebPEncode() failed with error: %d\n",
                pic->error_code);
@@ -59,19 +72,14 @@ static int libwebp_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
         goto end;
     }
 
-    ret = ff_get_encode_buffer(avctx, pkt, mw.size, 0);
+    ret = ff_get_encode_buffer(avctx, pkt, s->mw.size, 0);
     if (ret < 0)
         goto end;
-    memcpy(pkt->data, mw.mem, mw.size);
+    memcpy(pkt->data, s->mw.mem, s->mw.size);
 
     *got_packet = 1;
 
 end:
-#if (WEBP_ENCODER_ABI_VERSION > 0x0203)
-    WebPMemoryWriterClear(&mw);
-#else
-    free(mw.mem); /* must use free() according to libwebp documentation */
-#endif
     WebPPictureFree(pic);
     av_freep(&pic);
     av_frame_free(&alt_frame);
@@ -81,8 +89,15 @@ end:
 
 static int libwebp_encode_close(AVCodecContext *avctx)
 {
-    LibWebPContextCommon *s  = avctx->priv_data;
-    av_frame_free(&s->ref);
+    LibWebPContext *s  = avctx->priv_data;
+    av_frame_free(&s->cc.ref);
+    //PLEX
+#if (WEBP_ENCODER_ABI_VERSION > 0x0203)
+    WebPMemoryWriterClear(&s->mw);
+#else
+    free(s->mw.mem); /* must use free() according to libwebp documentation */
+#endif
+    //PLEX
 
     return 0;
 }
@@ -38,6 +38,9 @@
 #include "packet_internal.h"
 #include "atsc_a53.h"
 #include "sei.h"
+//PLEX
+#include "encode_speed.h"
+//PLEX
 
 #include <x264.h>
 #include <float.h>
@@ -129,6 +132,12 @@ typedef struct X264Context {
     int roi_warned;
 
     int mb_info;
+
+    //PLEX
+    double adaptive_speed;
+    FFEncodeSpeed speed;
+    int speed_max_refs;
+    //PLEX
 } X264Context;
 
 static void X264_log(void *p, int level, const char *fmt, va_list args)
@@ -295,6 +304,36 @@ static void reconfig_encoder(AVCodecContext *ctx, const AVFrame *frame)
     }
 }
 
+//PLEX
+/**
+ * Switch the analysis settings to those of the preset at the current speed
+ * level; everything else, including the bitstream layout, stays as opened.
+ */
+static void apply_speed_level(AVCodecContext *ctx)
+{
+    X264Context *x4 = ctx->priv_data;
+    x264_param_t p;
+
+    if (x264_param_default_preset(&p, x264_preset_names[x4->speed.level], x4->tune) < 0)
+        return;
+
+    x4->params.analyse.inter           = p.analyse.inter;
+    x4->params.analyse.intra           = p.analyse.intra;
+    x4->params.analyse.i_subpel_refine = p.analyse.i_subpel_refine;
+    x4->params.analyse.i_me_method     = p.analyse.i_me_method;
+    x4->params.analyse.i_me_range      = p.analyse.i_me_range;
+    x4->params.analyse.i_trellis       = p.analyse.i_trellis;
+    x4->params.analyse.b_mixed_references = p.analyse.b_mixed_references;
+    /* the reference count can only go down from what the encoder was opened with */
+    x4->params.i_frame_reference = FFMIN(p.i_frame_reference, x4->speed_max_refs);
+#if X264_BUILD >= 161
+    x264_param_cleanup(&p);
+#endif
+
+    x264_encoder_reconfig(x4->enc, &x4->params);
+}
+//PLEX
+
 static void free_picture(x264_picture_t *pic)
 {
     for (int i = 0; i < pic->extra_sei.num_payloads; i++)
@@ -631,11 +670,17 @@ static int X264_frame(AVCodecContext *ctx, AVPacket *pkt, const AVFrame *frame,
     int pict_type;
     int64_t wallclock = 0;
     X264Opaque *out_opaque;
+    //PLEX
+    int64_t enc_start;
+    //PLEX
 
     ret = setup_frame(ctx, frame, &pic_in);
     if (ret < 0)
         return ret;
 
+    //PLEX
+    enc_start = av_gettime_relative();
+    //PLEX
     do {
         if (x264_encoder_encode(x4->enc, &nal, &nnal, pic_in, &pic_out) < 0)
             return AVERROR_EXTERNAL;
@@ -672,6 +717,12 @@ static int X264_frame(AVCodecContext *ctx, AVPacket *pkt, const AVFrame *frame,
             return ret;
     } while (!ret && !frame && x264_encoder_delayed_frames(x4->enc));
 
+    //PLEX
+    /* the window is the GOP length, so a change lands on the next GOP */
+    if (ff_encode_speed_update(&x4->speed, ctx, frame, av_gettime_relative() - enc_start))
+        apply_speed_level(ctx);
+    //PLEX
+
     if (!ret)
         return 0;
 
@@ -968,6 +1019,10 @@ static av_cold int X264_init(AVCodecContext *avctx)
 
     if (x4->scenechange_threshold >= 0)
         x4->params.i_scenecut_threshold = x4->scenechange_threshold;
+    //PLEX
+    else if (avctx->use_encode_analysis)
+        x4->params.i_scenecut_threshold = 0;
+    //PLEX
 
     if (avctx->qmin >= 0)
         x4->params.rc.i_qp_min          = avctx->qmin;
@@ -1232,6 +1287,23 @@ FF_ENABLE_DEPRECATION_WARNINGS
     if (!x4->enc)
         return AVERROR_EXTERNAL;
 
+    //PLEX
+    if (x4->adaptive_speed > 0) {
+        int level = -1;
+
+        for (int i = 0; x4->preset && x264_preset_names[i]; i++)
+            if (!strcmp(x4->preset, x264_preset_names[i]))
+                level = i;
+        if (level < 0) {
+            av_log(avctx, AV_LOG_WARNING, "Adaptive speed needs a preset, disabling it.\n");
+        } else {
+            x4->speed_max_refs = x4->params.i_frame_reference;
+            ff_encode_speed_init(&x4->speed, avctx, x4->adaptive_speed, level,
+                                 x4->params.i_keyint_max);
+        }
+    }
+    //PLEX
+
     if (avctx->flags & AV_CODEC_FLAG_GLOBAL_HEADER) {
         x264_nal_t *nal;
         uint8_t *p;
@@ -1430,6 +1502,9 @@ static const AVOption options[] = {
     { "udu_sei",      "Use user data unregistered SEI if available",      OFFSET(udu_sei),  AV_OPT_TYPE_BOOL,   { .i64 = 0 }, 0, 1, VE },
     { "x264-params",  "Override the x264 configuration using a :-separated list of key=value parameters", OFFSET(x264_params), AV_OPT_TYPE_DICT, { 0 }, 0, 0, VE },
     { "mb_info",      "Set mb_info data through AVSideData, only useful when used from the API", OFFSET(mb_info), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VE },
+    //PLEX
+    { "adaptive_speed", "Move between presets at GOP boundaries to stay above this realtime factor, never slower than the preset (0 = off)", OFFSET(adaptive_speed), AV_OPT_TYPE_DOUBLE, { .dbl = 0 }, 0, 100, VE },
+    //PLEX
     { NULL },
 };
 
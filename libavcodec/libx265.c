@@ -33,6 +33,9 @@
 #include "libavutil/common.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+//PLEX
+#include "libavutil/time.h"
+//PLEX
 #include "avcodec.h"
 #include "codec_internal.h"
 #include "encode.h"
@@ -40,6 +43,9 @@
 #include "packet_internal.h"
 #include "atsc_a53.h"
 #include "sei.h"
+//PLEX
+#include "encode_speed.h"
+//PLEX
 
 typedef struct ReorderedData {
 #if FF_API_REORDERED_OPAQUE
@@ -81,6 +87,12 @@ typedef struct libx265Context {
      * encounter a frame with ROI side data.
      */
     int roi_warned;
+
+    //PLEX
+    double adaptive_speed;
+    FFEncodeSpeed speed;
+    int speed_max_refs;
+    //PLEX
 } libx265Context;
 
 static int is_keyframe(NalUnitType naltype)
@@ -356,6 +368,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
             return ret;
     }
 
+    //PLEX
+    if (avctx->use_encode_analysis) {
+        ret = libx265_param_parse_int(avctx, "scenecut", 0);
+        if (ret < 0)
+            return ret;
+    }
+    //PLEX
+
     if (avctx->qmin >= 0) {
         ret = libx265_param_parse_int(avctx, "qpmin", avctx->qmin);
         if (ret < 0)
@@ -470,6 +490,24 @@ FF_ENABLE_DEPRECATION_WARNINGS
         return AVERROR_INVALIDDATA;
     }
 
+    //PLEX
+    if (ctx->adaptive_speed > 0) {
+        const char *preset = ctx->preset ? ctx->preset : "medium";
+        int level = -1;
+
+        for (int i = 0; x265_preset_names[i]; i++)
+            if (!strcmp(preset, x265_preset_names[i]))
+                level = i;
+        if (level < 0) {
+            av_log(avctx, AV_LOG_WARNING, "Adaptive speed needs a named preset, disabling it.\n");
+        } else {
+            ctx->speed_max_refs = ctx->params->maxNumReferences;
+            ff_encode_speed_init(&ctx->speed, avctx, ctx->adaptive_speed, level,
+                                 ctx->params->keyframeMax);
+        }
+    }
+    //PLEX
+
     if (avctx->flags & AV_CODEC_FLAG_GLOBAL_HEADER) {
         x265_nal *nal;
         int nnal;
@@ -576,6 +614,38 @@ static void free_picture(libx265Context *ctx, x265_picture *pic)
     sei->numPayloads = 0;
 }
 
+//PLEX
+/**
+ * Switch the analysis settings to those of the preset at the current speed
+ * level; x265 ignores any field it cannot reconfigure.
+ */
+static void apply_speed_level(AVCodecContext *avctx)
+{
+    libx265Context *ctx = avctx->priv_data;
+    x265_param *p = ctx->api->param_alloc();
+
+    if (!p)
+        return;
+    if (ctx->api->param_default_preset(p, x265_preset_names[ctx->speed.level], ctx->tune) < 0) {
+        ctx->api->param_free(p);
+        return;
+    }
+
+    ctx->params->searchMethod     = p->searchMethod;
+    ctx->params->searchRange      = p->searchRange;
+    ctx->params->subpelRefine     = p->subpelRefine;
+    ctx->params->rdLevel          = p->rdLevel;
+    ctx->params->rdoqLevel        = p->rdoqLevel;
+    ctx->params->maxNumMergeCand  = p->maxNumMergeCand;
+    ctx->params->bEnableRectInter = p->bEnableRectInter;
+    ctx->params->bEnableEarlySkip = p->bEnableEarlySkip;
+    ctx->params->maxNumReferences = FFMIN(p->maxNumReferences, ctx->speed_max_refs);
+    ctx->api->param_free(p);
+
+    ctx->api->encoder_reconfig(ctx->encoder, ctx->params);
+}
+//PLEX
+
 static int libx265_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                                 const AVFrame *pic, int *got_packet)
 {
@@ -590,6 +660,9 @@ static int libx265_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     int nnal;
     int ret;
     int i;
+    //PLEX
+    int64_t enc_start;
+    //PLEX
 
     ctx->api->picture_init(ctx->params, &x265pic);
 
@@ -704,8 +777,17 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
     }
 
+    //PLEX
+    enc_start = av_gettime_relative();
+    //PLEX
     ret = ctx->api->encoder_encode(ctx->encoder, &nal, &nnal,
                                    pic ? &x265pic : NULL, &x265pic_out);
+    //PLEX
+    /* the window is the GOP length, so a change lands on the next GOP */
+    if (ret >= 0 &&
+        ff_encode_speed_update(&ctx->speed, avctx, pic, av_gettime_relative() - enc_start))
+        apply_speed_level(avctx);
+    //PLEX
 
     for (i = 0; i < sei->numPayloads; i++)
         av_free(sei->payloads[i].payload);
@@ -868,6 +950,9 @@ static const AVOption options[] = {
     { "udu_sei",     "Use user data unregistered SEI if available",                                 OFFSET(udu_sei),   AV_OPT_TYPE_BOOL,   { .i64 = 0 }, 0, 1, VE },
     { "a53cc",       "Use A53 Closed Captions (if available)",                                      OFFSET(a53_cc),    AV_OPT_TYPE_BOOL,   { .i64 = 1 }, 0, 1, VE },
     { "x265-params", "set the x265 configuration using a :-separated list of key=value parameters", OFFSET(x265_opts), AV_OPT_TYPE_DICT,   { 0 }, 0, 0, VE },
+    //PLEX
+    { "adaptive_speed", "move between presets at GOP boundaries to stay above this realtime factor, never slower than the preset (0 = off)", OFFSET(adaptive_speed), AV_OPT_TYPE_DOUBLE, { .dbl = 0 }, 0, 100, VE },
+    //PLEX
     { NULL }
 };
 
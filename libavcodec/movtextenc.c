@@ -564,7 +564,7 @@ static void mov_text_ass_style_set(MovTextContext *s, ASSStyle *style)
     }
 }
 
-static void mov_text_dialog(MovTextContext *s, ASSDialog *dialog)
+static void mov_text_dialog(MovTextContext *s, const ASSDialog *dialog)
 {
     ASSStyle *style = ff_ass_style_get(s->ass_ctx, dialog->style);
 
@@ -637,7 +637,7 @@ static int mov_text_encode_frame(AVCodecContext *avctx, unsigned char *buf,
                                  int bufsize, const AVSubtitle *sub)
 {
     MovTextContext *s = avctx->priv_data;
-    ASSDialog *dialog;
+    const ASSDialog *dialog;
     int i, length;
 
     s->text_pos = 0;
@@ -652,12 +652,11 @@ static int mov_text_encode_frame(AVCodecContext *avctx, unsigned char *buf,
             return AVERROR(EINVAL);
         }
 
-        dialog = ff_ass_split_dialog(s->ass_ctx, ass);
+        dialog = ff_ass_split_dialog_view(s->ass_ctx, ass);
         if (!dialog)
             return AVERROR(ENOMEM);
         mov_text_dialog(s, dialog);
         ff_ass_split_override_codes(&mov_text_callbacks, s, dialog->text);
-        ff_ass_free_dialog(&dialog);
     }
 
     if (s->buffer.len > UINT16_MAX)
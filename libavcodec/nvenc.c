@@ -35,6 +35,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/time.h" //PLEX
 #include "atsc_a53.h"
 #include "codec_desc.h"
 #include "encode.h"
@@ -952,6 +953,10 @@ static av_cold int nvenc_recalc_surfaces(AVCodecContext *avctx)
     // another multiply by 2 to avoid blocking next PBB group
     int nb_surfaces = FFMAX(4, ctx->encode_config.frameIntervalP * 2 * 2);
 
+    //PLEX: keep the GPU busy while the output thread holds surfaces
+    if (ctx->async_output)
+        nb_surfaces += 4;
+
     // lookahead enabled
     if (ctx->rc_lookahead > 0) {
         // +1 is to account for lkd_bound calculation later
@@ -1814,6 +1819,13 @@ static av_cold int nvenc_setup_surfaces(AVCodecContext *avctx)
     ctx->output_surface_ready_queue = av_fifo_alloc2(ctx->nb_surfaces, sizeof(NvencSurface*), 0);
     if (!ctx->output_surface_ready_queue)
         return AVERROR(ENOMEM);
+    //PLEX
+    if (ctx->async_output) {
+        ctx->output_surface_done_queue = av_fifo_alloc2(ctx->nb_surfaces, sizeof(NvencSurface*), 0);
+        if (!ctx->output_surface_done_queue)
+            return AVERROR(ENOMEM);
+    }
+    //PLEX
 
     res = nvenc_push_context(avctx);
     if (res < 0)
@@ -1866,6 +1878,253 @@ static av_cold int nvenc_setup_extradata(AVCodecContext *avctx)
     return 0;
 }
 
+//PLEX
+static void nvenc_record_latency(NvencContext *ctx, const NvencSurface *surf)
+{
+    int64_t latency = av_gettime_relative() - surf->submit_time;
+    int64_t ms;
+    int bucket = 0;
+
+    if (!ctx->latency_stats)
+        return;
+
+    for (ms = latency / 1000; ms && bucket < NVENC_LATENCY_BUCKETS - 1; ms >>= 1)
+        bucket++;
+
+    ctx->latency_hist[bucket]++;
+    ctx->latency_count++;
+    ctx->latency_sum += latency;
+    ctx->latency_max  = FFMAX(ctx->latency_max, latency);
+}
+
+static void nvenc_print_latency(AVCodecContext *avctx)
+{
+    NvencContext *ctx = avctx->priv_data;
+    int i;
+
+    if (!ctx->latency_stats || !ctx->latency_count)
+        return;
+
+    av_log(avctx, AV_LOG_INFO, "Output latency: %"PRIu64" frames, avg %.2f ms, max %.2f ms\n",
+           ctx->latency_count, ctx->latency_sum / (1000.0 * ctx->latency_count),
+           ctx->latency_max / 1000.0);
+    for (i = 0; i < NVENC_LATENCY_BUCKETS; i++) {
+        if (!ctx->latency_hist[i])
+            continue;
+        if (i == NVENC_LATENCY_BUCKETS - 1)
+            av_log(avctx, AV_LOG_INFO, "  >= %5d ms: %"PRIu64"\n",
+                   1 << (i - 1), ctx->latency_hist[i]);
+        else
+            av_log(avctx, AV_LOG_INFO, "  <  %5d ms: %"PRIu64"\n",
+                   1 << i, ctx->latency_hist[i]);
+    }
+}
+
+#if HAVE_THREADS
+/* Lock the bitstream of a finished surface and keep a copy of it, so that
+ * the surface's output buffer can be handed back to the encoder early. */
+static int nvenc_fetch_bitstream(AVCodecContext *avctx, NvencSurface *surf)
+{
+    NvencContext *ctx = avctx->priv_data;
+    NV_ENCODE_API_FUNCTION_LIST *p_nvenc = &ctx->nvenc_dload_funcs.nvenc_funcs;
+    NV_ENC_LOCK_BITSTREAM *lock_params = &surf->lock_params;
+    NVENCSTATUS nv_status;
+    unsigned int size;
+    int res = 0;
+
+    memset(lock_params, 0, sizeof(*lock_params));
+    lock_params->version         = NV_ENC_LOCK_BITSTREAM_VER;
+    lock_params->doNotWait       = 0;
+    lock_params->outputBitstream = surf->output_surface;
+
+    nv_status = p_nvenc->nvEncLockBitstream(ctx->nvencoder, lock_params);
+    if (nv_status != NV_ENC_SUCCESS)
+        return nvenc_print_error(avctx, nv_status, "Failed locking bitstream buffer");
+
+    size = lock_params->bitstreamSizeInBytes;
+    av_fast_malloc(&surf->bitstream, &surf->bitstream_size, FFMAX(size, 1));
+    if (surf->bitstream)
+        memcpy(surf->bitstream, lock_params->bitstreamBufferPtr, size);
+    else
+        res = AVERROR(ENOMEM);
+    lock_params->bitstreamBufferPtr = surf->bitstream;
+
+    nv_status = p_nvenc->nvEncUnlockBitstream(ctx->nvencoder, surf->output_surface);
+    if (nv_status != NV_ENC_SUCCESS)
+        return nvenc_print_error(avctx, nv_status, "Failed unlocking bitstream buffer");
+
+    return res;
+}
+
+static void *nvenc_output_thread(void *arg)
+{
+    AVCodecContext *avctx = arg;
+    NvencContext *ctx = avctx->priv_data;
+    NvencSurface *surf;
+    int res, res2;
+
+    pthread_mutex_lock(&ctx->output_mutex);
+    while (!ctx->output_quit) {
+        if (av_fifo_read(ctx->output_surface_ready_queue, &surf, 1) < 0) {
+            pthread_cond_wait(&ctx->output_cond, &ctx->output_mutex);
+            continue;
+        }
+        ctx->output_busy = 1;
+        pthread_mutex_unlock(&ctx->output_mutex);
+
+        res = nvenc_push_context(avctx);
+        if (res >= 0) {
+            res  = nvenc_fetch_bitstream(avctx, surf);
+            res2 = nvenc_pop_context(avctx);
+            if (res >= 0)
+                res = res2;
+        }
+        nvenc_record_latency(ctx, surf);
+
+        pthread_mutex_lock(&ctx->output_mutex);
+        ctx->output_busy = 0;
+        if (res < 0) {
+            ctx->output_error = res;
+            pthread_cond_broadcast(&ctx->output_cond);
+            break;
+        }
+        av_fifo_write(ctx->output_surface_done_queue, &surf, 1);
+        pthread_cond_broadcast(&ctx->output_cond);
+    }
+    pthread_mutex_unlock(&ctx->output_mutex);
+
+    return NULL;
+}
+
+static av_cold int nvenc_start_output_thread(AVCodecContext *avctx)
+{
+    NvencContext *ctx = avctx->priv_data;
+    int ret;
+
+    if ((ret = pthread_mutex_init(&ctx->output_mutex, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&ctx->output_cond, NULL))) {
+        pthread_mutex_destroy(&ctx->output_mutex);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_create(&ctx->output_thread, NULL, nvenc_output_thread, avctx))) {
+        pthread_cond_destroy(&ctx->output_cond);
+        pthread_mutex_destroy(&ctx->output_mutex);
+        return AVERROR(ret);
+    }
+    ctx->output_thread_running = 1;
+
+    return 0;
+}
+
+static av_cold void nvenc_stop_output_thread(AVCodecContext *avctx)
+{
+    NvencContext *ctx = avctx->priv_data;
+
+    if (!ctx->output_thread_running)
+        return;
+
+    pthread_mutex_lock(&ctx->output_mutex);
+    ctx->output_quit = 1;
+    pthread_cond_broadcast(&ctx->output_cond);
+    pthread_mutex_unlock(&ctx->output_mutex);
+
+    pthread_join(ctx->output_thread, NULL);
+    pthread_cond_destroy(&ctx->output_cond);
+    pthread_mutex_destroy(&ctx->output_mutex);
+    ctx->output_thread_running = 0;
+}
+
+static void nvenc_output_lock(NvencContext *ctx)
+{
+    if (ctx->output_thread_running)
+        pthread_mutex_lock(&ctx->output_mutex);
+}
+
+static void nvenc_output_unlock(NvencContext *ctx)
+{
+    if (ctx->output_thread_running) {
+        pthread_cond_broadcast(&ctx->output_cond);
+        pthread_mutex_unlock(&ctx->output_mutex);
+    }
+}
+
+/* Wait until the output thread has fetched every ready surface. */
+static void nvenc_output_wait_idle(NvencContext *ctx)
+{
+    if (!ctx->output_thread_running)
+        return;
+
+    pthread_mutex_lock(&ctx->output_mutex);
+    while (!ctx->output_error && (ctx->output_busy ||
+           av_fifo_can_read(ctx->output_surface_ready_queue)))
+        pthread_cond_wait(&ctx->output_cond, &ctx->output_mutex);
+    pthread_mutex_unlock(&ctx->output_mutex);
+}
+
+/* Equivalent of output_ready() for the output thread: wait for a fetched
+ * surface only when no more input can be accepted. */
+static int nvenc_get_done_surface(AVCodecContext *avctx, NvencSurface **surf)
+{
+    NvencContext *ctx = avctx->priv_data;
+    int draining = avctx->internal->draining;
+    int res;
+
+    pthread_mutex_lock(&ctx->output_mutex);
+    for (;;) {
+        int nb_done   = av_fifo_can_read(ctx->output_surface_done_queue);
+        int nb_queued = av_fifo_can_read(ctx->output_surface_ready_queue) + ctx->output_busy;
+        int nb_free   = av_fifo_can_read(ctx->unused_surface_queue);
+        int nb_total  = nb_done + nb_queued + av_fifo_can_read(ctx->output_surface_queue);
+
+        if (ctx->output_error) {
+            res = ctx->output_error;
+            break;
+        }
+        if (nb_done && (draining || !nb_free || nb_total >= ctx->async_depth)) {
+            av_fifo_read(ctx->output_surface_done_queue, surf, 1);
+            res = 0;
+            break;
+        }
+        if (!nb_queued || (!draining && nb_free && nb_total < ctx->async_depth)) {
+            res = draining ? AVERROR_EOF : AVERROR(EAGAIN);
+            break;
+        }
+        pthread_cond_wait(&ctx->output_cond, &ctx->output_mutex);
+    }
+    pthread_mutex_unlock(&ctx->output_mutex);
+
+    return res;
+}
+#else
+static av_cold int nvenc_start_output_thread(AVCodecContext *avctx)
+{
+    return AVERROR(ENOSYS);
+}
+
+static av_cold void nvenc_stop_output_thread(AVCodecContext *avctx)
+{
+}
+
+static void nvenc_output_lock(NvencContext *ctx)
+{
+}
+
+static void nvenc_output_unlock(NvencContext *ctx)
+{
+}
+
+static void nvenc_output_wait_idle(NvencContext *ctx)
+{
+}
+
+static int nvenc_get_done_surface(AVCodecContext *avctx, NvencSurface **surf)
+{
+    return AVERROR_BUG;
+}
+#endif
+//PLEX
+
 av_cold int ff_nvenc_encode_close(AVCodecContext *avctx)
 {
     NvencContext *ctx               = avctx->priv_data;
@@ -1873,6 +2132,11 @@ av_cold int ff_nvenc_encode_close(AVCodecContext *avctx)
     NV_ENCODE_API_FUNCTION_LIST *p_nvenc = &dl_fn->nvenc_funcs;
     int i, res;
 
+    //PLEX
+    nvenc_stop_output_thread(avctx);
+    nvenc_print_latency(avctx);
+    //PLEX
+
     /* the encoder has to be flushed before it can be closed */
     if (ctx->nvencoder) {
         NV_ENC_PIC_PARAMS params        = { .version        = NV_ENC_PIC_PARAMS_VER,
@@ -1889,6 +2153,7 @@ av_cold int ff_nvenc_encode_close(AVCodecContext *avctx)
     av_fifo_freep2(&ctx->output_surface_ready_queue);
     av_fifo_freep2(&ctx->output_surface_queue);
     av_fifo_freep2(&ctx->unused_surface_queue);
+    av_fifo_freep2(&ctx->output_surface_done_queue); //PLEX
 
     if (ctx->frame_data_array) {
         for (i = 0; i < ctx->frame_data_array_nb; i++)
@@ -1911,6 +2176,7 @@ av_cold int ff_nvenc_encode_close(AVCodecContext *avctx)
             if (avctx->pix_fmt != AV_PIX_FMT_CUDA && avctx->pix_fmt != AV_PIX_FMT_D3D11)
                 p_nvenc->nvEncDestroyInputBuffer(ctx->nvencoder, ctx->surfaces[i].input_surface);
             av_frame_free(&ctx->surfaces[i].in_ref);
+            av_freep(&ctx->surfaces[i].bitstream); //PLEX
             p_nvenc->nvEncDestroyBitstreamBuffer(ctx->nvencoder, ctx->surfaces[i].output_surface);
         }
     }
@@ -2000,6 +2266,16 @@ av_cold int ff_nvenc_encode_init(AVCodecContext *avctx)
             return ret;
     }
 
+    //PLEX
+    if (ctx->async_output) {
+        if ((ret = nvenc_start_output_thread(avctx)) < 0) {
+            av_log(avctx, AV_LOG_WARNING, "Failed to start the output thread, "
+                   "falling back to synchronous output\n");
+            ctx->async_output = 0;
+        }
+    }
+    //PLEX
+
     return 0;
 }
 
@@ -2336,6 +2612,32 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return res;
 }
 
+//PLEX
+static int nvenc_release_input(AVCodecContext *avctx, NvencSurface *tmpoutsurf)
+{
+    NvencContext *ctx = avctx->priv_data;
+    NV_ENCODE_API_FUNCTION_LIST *p_nvenc = &ctx->nvenc_dload_funcs.nvenc_funcs;
+    NVENCSTATUS nv_status;
+
+    if (avctx->pix_fmt == AV_PIX_FMT_CUDA || avctx->pix_fmt == AV_PIX_FMT_D3D11) {
+        ctx->registered_frames[tmpoutsurf->reg_idx].mapped -= 1;
+        if (ctx->registered_frames[tmpoutsurf->reg_idx].mapped == 0) {
+            nv_status = p_nvenc->nvEncUnmapInputResource(ctx->nvencoder, ctx->registered_frames[tmpoutsurf->reg_idx].in_map.mappedResource);
+            if (nv_status != NV_ENC_SUCCESS)
+                return nvenc_print_error(avctx, nv_status, "Failed unmapping input resource");
+        } else if (ctx->registered_frames[tmpoutsurf->reg_idx].mapped < 0) {
+            return AVERROR_BUG;
+        }
+
+        av_frame_unref(tmpoutsurf->in_ref);
+
+        tmpoutsurf->input_surface = NULL;
+    }
+
+    return 0;
+}
+//PLEX
+
 static int process_output_surface(AVCodecContext *avctx, AVPacket *pkt, NvencSurface *tmpoutsurf)
 {
     NvencContext *ctx = avctx->priv_data;
@@ -2348,6 +2650,17 @@ static int process_output_surface(AVCodecContext *avctx, AVPacket *pkt, NvencSur
 
     enum AVPictureType pict_type;
 
+    //PLEX: the output thread already fetched the bitstream
+    if (ctx->output_thread_running) {
+        lock_params = tmpoutsurf->lock_params;
+
+        res = ff_get_encode_buffer(avctx, pkt, lock_params.bitstreamSizeInBytes, 0);
+        if (res < 0)
+            goto error;
+
+        memcpy(pkt->data, lock_params.bitstreamBufferPtr, lock_params.bitstreamSizeInBytes);
+    } else {
+    //PLEX
     lock_params.version = NV_ENC_LOCK_BITSTREAM_VER;
 
     lock_params.doNotWait = 0;
@@ -2374,24 +2687,15 @@ static int process_output_surface(AVCodecContext *avctx, AVPacket *pkt, NvencSur
         goto error;
     }
 
+    nvenc_record_latency(ctx, tmpoutsurf); //PLEX
+    } //PLEX
 
-    if (avctx->pix_fmt == AV_PIX_FMT_CUDA || avctx->pix_fmt == AV_PIX_FMT_D3D11) {
-        ctx->registered_frames[tmpoutsurf->reg_idx].mapped -= 1;
-        if (ctx->registered_frames[tmpoutsurf->reg_idx].mapped == 0) {
-            nv_status = p_nvenc->nvEncUnmapInputResource(ctx->nvencoder, ctx->registered_frames[tmpoutsurf->reg_idx].in_map.mappedResource);
-            if (nv_status != NV_ENC_SUCCESS) {
-                res = nvenc_print_error(avctx, nv_status, "Failed unmapping input resource");
-                goto error;
-            }
-        } else if (ctx->registered_frames[tmpoutsurf->reg_idx].mapped < 0) {
-            res = AVERROR_BUG;
-            goto error;
-        }
 
-        av_frame_unref(tmpoutsurf->in_ref);
-
-        tmpoutsurf->input_surface = NULL;
-    }
+    //PLEX
+    res = nvenc_release_input(avctx, tmpoutsurf);
+    if (res < 0)
+        goto error;
+    //PLEX
 
     switch (lock_params.pictureType) {
     case NV_ENC_PIC_TYPE_IDR:
@@ -2705,6 +3009,12 @@ static int nvenc_send_frame(AVCodecContext *avctx, const AVFrame *frame)
             pic_params.pictureStruct = NV_ENC_PIC_STRUCT_FRAME;
         }
 
+        //PLEX: restart with a self-contained IDR after a flush
+        if (ctx->flush_idr) {
+            pic_params.encodePicFlags = NV_ENC_PIC_FLAG_FORCEIDR | NV_ENC_PIC_FLAG_OUTPUT_SPSPPS;
+            ctx->flush_idr = 0;
+        } else
+        //PLEX
         if (ctx->forced_idr >= 0 && frame->pict_type == AV_PICTURE_TYPE_I) {
             pic_params.encodePicFlags =
                 ctx->forced_idr ? NV_ENC_PIC_FLAG_FORCEIDR : NV_ENC_PIC_FLAG_FORCEINTRA;
@@ -2748,6 +3058,7 @@ static int nvenc_send_frame(AVCodecContext *avctx, const AVFrame *frame)
         return nvenc_print_error(avctx, nv_status, "EncodePicture failed!");
 
     if (frame && frame->buf[0]) {
+        in_surf->submit_time = av_gettime_relative(); //PLEX
         av_fifo_write(ctx->output_surface_queue, &in_surf, 1);
 
         if (avctx->codec_descriptor->props & AV_CODEC_PROP_REORDER)
@@ -2756,8 +3067,10 @@ static int nvenc_send_frame(AVCodecContext *avctx, const AVFrame *frame)
 
     /* all the pending buffers are now ready for output */
     if (nv_status == NV_ENC_SUCCESS) {
+        nvenc_output_lock(ctx); //PLEX
         while (av_fifo_read(ctx->output_surface_queue, &tmp_out_surf, 1) >= 0)
             av_fifo_write(ctx->output_surface_ready_queue, &tmp_out_surf, 1);
+        nvenc_output_unlock(ctx); //PLEX
     }
 
     return 0;
@@ -2788,6 +3101,28 @@ int ff_nvenc_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
     } else
         av_frame_unref(frame);
 
+    //PLEX
+    if (ctx->output_thread_running) {
+        res = nvenc_get_done_surface(avctx, &tmp_out_surf);
+        if (res < 0)
+            return res;
+
+        res = nvenc_push_context(avctx);
+        if (res < 0)
+            return res;
+
+        res = process_output_surface(avctx, pkt, tmp_out_surf);
+
+        res2 = nvenc_pop_context(avctx);
+        if (res2 < 0)
+            return res2;
+
+        if (res)
+            return res;
+
+        av_fifo_write(ctx->unused_surface_queue, &tmp_out_surf, 1);
+    } else
+    //PLEX
     if (output_ready(avctx, avctx->internal->draining)) {
         av_fifo_read(ctx->output_surface_ready_queue, &tmp_out_surf, 1);
 
@@ -2817,7 +3152,31 @@ int ff_nvenc_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
 av_cold void ff_nvenc_encode_flush(AVCodecContext *avctx)
 {
     NvencContext *ctx = avctx->priv_data;
+    NvencSurface *surf; //PLEX
 
     nvenc_send_frame(avctx, NULL);
     av_fifo_reset2(ctx->timestamp_list);
+
+    //PLEX: drop the pending output and keep the session for the next frame
+    nvenc_output_wait_idle(ctx);
+    if (nvenc_push_context(avctx) < 0)
+        return;
+    while (av_fifo_read(ctx->output_surface_ready_queue, &surf, 1) >= 0 ||
+           (ctx->output_surface_done_queue &&
+            av_fifo_read(ctx->output_surface_done_queue, &surf, 1) >= 0)) {
+        if (!ctx->output_thread_running) {
+            NV_ENCODE_API_FUNCTION_LIST *p_nvenc = &ctx->nvenc_dload_funcs.nvenc_funcs;
+            NV_ENC_LOCK_BITSTREAM lock_params = { .version = NV_ENC_LOCK_BITSTREAM_VER,
+                                                  .outputBitstream = surf->output_surface };
+            if (p_nvenc->nvEncLockBitstream(ctx->nvencoder, &lock_params) == NV_ENC_SUCCESS)
+                p_nvenc->nvEncUnlockBitstream(ctx->nvencoder, surf->output_surface);
+        }
+        nvenc_release_input(avctx, surf);
+        av_fifo_write(ctx->unused_surface_queue, &surf, 1);
+    }
+    nvenc_pop_context(avctx);
+
+    av_frame_unref(ctx->frame);
+    ctx->flush_idr = 1;
+    //PLEX
 }
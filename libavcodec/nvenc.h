@@ -34,11 +34,13 @@ typedef void ID3D11Device;
 #include "libavutil/buffer.h"
 #include "libavutil/fifo.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h" //PLEX
 #include "hwconfig.h"
 
 #include "avcodec.h"
 
 #define MAX_REGISTERED_FRAMES 64
+#define NVENC_LATENCY_BUCKETS 12 //PLEX: below 1, 2, 4 ... 1024 ms and above
 #define RC_MODE_DEPRECATED 0x800000
 #define RCD(rc_mode) ((rc_mode) | RC_MODE_DEPRECATED)
 
@@ -99,6 +101,14 @@ typedef struct NvencSurface
 
     NV_ENC_OUTPUT_PTR output_surface;
     NV_ENC_BUFFER_FORMAT format;
+
+    //PLEX
+    int64_t submit_time;                ///< av_gettime_relative() when submitted
+    /* Filled by the output thread after locking the bitstream */
+    NV_ENC_LOCK_BITSTREAM lock_params;  ///< bitstreamBufferPtr points to bitstream
+    uint8_t *bitstream;
+    unsigned int bitstream_size;
+    //PLEX
 } NvencSurface;
 
 typedef struct NvencFrameData
@@ -275,6 +285,31 @@ typedef struct NvencContext
     int highbitdepth;
     int max_slice_size;
     int rgb_mode;
+
+    //PLEX
+    int async_output;
+    int latency_stats;
+
+    /* Surfaces move from output_surface_ready_queue to this queue once the
+     * output thread has locked them. Both are protected by output_mutex. */
+    AVFifo *output_surface_done_queue;
+#if HAVE_THREADS
+    pthread_t output_thread;
+    pthread_mutex_t output_mutex;
+    pthread_cond_t output_cond;
+#endif
+    int output_thread_running;
+    int output_busy;
+    int output_quit;
+    int output_error;
+
+    uint64_t latency_hist[NVENC_LATENCY_BUCKETS];
+    uint64_t latency_count;
+    int64_t latency_sum;
+    int64_t latency_max;
+
+    int flush_idr;  ///< force an IDR with parameter sets after a flush
+    //PLEX
 } NvencContext;
 
 int ff_nvenc_encode_init(AVCodecContext *avctx);
@@ -103,6 +103,12 @@ static const AVOption options[] = {
     { "disabled",     "Disables support, throws an error.", 0,                    AV_OPT_TYPE_CONST, { .i64 = NVENC_RGB_MODE_DISABLED },  0, 0, VE, "rgb_mode" },
     { "delay",        "Delay frame output by the given amount of frames",
                                                             OFFSET(async_depth),  AV_OPT_TYPE_INT,   { .i64 = INT_MAX }, 0, INT_MAX, VE },
+    //PLEX
+    { "async_output", "Retrieve encoded frames on a separate output thread",
+                                                            OFFSET(async_output), AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, VE },
+    { "latency_stats", "Log a histogram of the submit-to-output latency on close",
+                                                            OFFSET(latency_stats), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VE },
+    //PLEX
     { "rc-lookahead", "Number of frames to look ahead for rate-control",
                                                             OFFSET(rc_lookahead), AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, VE },
     { "cq",           "Set target quality level (0 to 51, 0 means automatic) for constant quality mode in VBR rate control",
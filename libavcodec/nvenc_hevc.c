@@ -126,6 +126,12 @@ static const AVOption options[] = {
     { "disabled",     "Disables support, throws an error.", 0,                    AV_OPT_TYPE_CONST, { .i64 = NVENC_RGB_MODE_DISABLED },  0, 0, VE, "rgb_mode" },
     { "delay",        "Delay frame output by the given amount of frames",
                                                             OFFSET(async_depth),  AV_OPT_TYPE_INT,   { .i64 = INT_MAX }, 0, INT_MAX, VE },
+    //PLEX
+    { "async_output", "Retrieve encoded frames on a separate output thread",
+                                                            OFFSET(async_output), AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, VE },
+    { "latency_stats", "Log a histogram of the submit-to-output latency on close",
+                                                            OFFSET(latency_stats), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VE },
+    //PLEX
     { "no-scenecut",  "When lookahead is enabled, set this to 1 to disable adaptive I-frame insertion at scene cuts",
                                                             OFFSET(no_scenecut),  AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, VE },
     { "forced-idr",   "If forcing keyframes, force them as IDR frames.",
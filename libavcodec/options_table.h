@@ -366,6 +366,15 @@ static const AVOption avcodec_options[] = {
 {"thread_type", "select multithreading type", OFFSET(thread_type), AV_OPT_TYPE_FLAGS, {.i64 = FF_THREAD_SLICE|FF_THREAD_FRAME }, 0, INT_MAX, V|A|E|D, "thread_type"},
 {"slice", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = FF_THREAD_SLICE }, INT_MIN, INT_MAX, V|E|D, "thread_type"},
 {"frame", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = FF_THREAD_FRAME }, INT_MIN, INT_MAX, V|E|D, "thread_type"},
+//PLEX
+{"frame_thread_low_delay", "return frame-threaded output as soon as it is ready", OFFSET(frame_thread_low_delay), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, V|D},
+{"skip_disposable_rate", "drop disposable packets not needed for this output frame rate", OFFSET(skip_disposable_rate), AV_OPT_TYPE_RATIONAL, {.dbl = 0 }, 0, INT_MAX, V|D},
+{"skipped_disposable", "number of packets dropped by skip_disposable_rate", OFFSET(skipped_disposable), AV_OPT_TYPE_INT64, {.i64 = 0 }, 0, INT64_MAX, V|D|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY},
+{"shared_threads", "run slice threads on the process-wide shared pool", OFFSET(shared_threads), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, V|A|E|D},
+{"shared_thread_weight", "take automatic threads from a process-wide budget with this weight", OFFSET(shared_thread_weight), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 1000, V|A|D},
+{"use_encode_analysis", "take frame types from shared encode analysis side data", OFFSET(use_encode_analysis), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, V|E},
+{"thread_stats", "collect frame threading wait statistics", OFFSET(thread_stats), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, V|A|D},
+//PLEX
 {"audio_service_type", "audio service type", OFFSET(audio_service_type), AV_OPT_TYPE_INT, {.i64 = AV_AUDIO_SERVICE_TYPE_MAIN }, 0, AV_AUDIO_SERVICE_TYPE_NB-1, A|E, "audio_service_type"},
 {"ma", "Main Audio Service", 0, AV_OPT_TYPE_CONST, {.i64 = AV_AUDIO_SERVICE_TYPE_MAIN },              INT_MIN, INT_MAX, A|E, "audio_service_type"},
 {"ef", "Effects",            0, AV_OPT_TYPE_CONST, {.i64 = AV_AUDIO_SERVICE_TYPE_EFFECTS },           INT_MIN, INT_MAX, A|E, "audio_service_type"},
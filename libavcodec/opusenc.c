@@ -662,6 +662,9 @@ static av_cold int opus_encode_init(AVCodecContext *avctx)
         return AVERROR(ENOMEM);
     opus_write_extradata(avctx);
 
+    s->options.complexity = avctx->compression_level == FF_COMPRESSION_DEFAULT ? 10 :
+                            av_clip(avctx->compression_level, 0, 10);
+
     ff_af_queue_init(avctx, &s->afq);
 
     if ((ret = ff_celt_pvq_init(&s->pvq, 1)) < 0)
@@ -43,6 +43,7 @@
 typedef struct OpusEncOptions {
     float max_delay_ms;
     int apply_phase_inv;
+    int complexity; /* Search effort, 0 to 10, from compression_level */
 } OpusEncOptions;
 
 typedef struct OpusPacketInfo {
@@ -62,11 +62,10 @@ static float pvq_band_cost(CeltPVQ *pvq, CeltFrame *f, OpusRangeCoder *rc, int b
                         norm1, 0, 1.0f, lowband_scratch, cm[0] | cm[1]);
     }
 
-    for (i = 0; i < band_size; i++) {
+    for (i = 0; i < band_size; i++)
         err_x += (X[i] - X_orig[i])*(X[i] - X_orig[i]);
-        if (Y)
-            err_y += (Y[i] - Y_orig[i])*(Y[i] - Y_orig[i]);
-    }
+    for (i = 0; Y && i < band_size; i++)
+        err_y += (Y[i] - Y_orig[i])*(Y[i] - Y_orig[i]);
 
     dist = sqrtf(err_x) + sqrtf(err_y);
     cost = OPUS_RC_CHECKPOINT_BITS(rc)/8.0f;
@@ -365,7 +364,8 @@ static void celt_gauge_psy_weight(OpusPsyContext *s, OpusPsyStep **start,
 
 static int bands_dist(OpusPsyContext *s, CeltFrame *f, float *total_dist)
 {
-    int i, tdist = 0.0f;
+    int i;
+    float tdist = 0.0f;
     OpusRangeCoder dump;
 
     ff_opus_rc_enc_init(&dump);
@@ -387,7 +387,7 @@ static void celt_search_for_dual_stereo(OpusPsyContext *s, CeltFrame *f)
     float td1, td2;
     f->dual_stereo = 0;
 
-    if (s->avctx->ch_layout.nb_channels < 2)
+    if (s->avctx->ch_layout.nb_channels < 2 || s->options->complexity < 3)
         return;
 
     bands_dist(s, f, &td1);
@@ -398,26 +398,59 @@ static void celt_search_for_dual_stereo(OpusPsyContext *s, CeltFrame *f)
     s->dual_stereo_used += td2 < td1;
 }
 
+static void intensity_try_band(OpusPsyContext *s, CeltFrame *f, int band,
+                               int *best_band, float *best_dist)
+{
+    float dist;
+
+    if (band < 0 || band > f->end_band)
+        return;
+    f->intensity_stereo = band;
+    bands_dist(s, f, &dist);
+    if (*best_dist > dist) {
+        *best_dist = dist;
+        *best_band = band;
+    }
+}
+
+/*
+ * Every candidate costs a trial quantization of all bands, so the search
+ * effort depends on the complexity: all bands at 10, a coarse grid refined
+ * around its best band from 5, and the neighbours of the last band below.
+ */
 static void celt_search_for_intensity(OpusPsyContext *s, CeltFrame *f)
 {
+    const int complexity = s->options->complexity;
     int i, best_band = CELT_MAX_BANDS - 1;
-    float dist, best_dist = FLT_MAX;
-    /* TODO: fix, make some heuristic up here using the lambda value */
-    float end_band = 0;
+    float best_dist = FLT_MAX;
 
     if (s->avctx->ch_layout.nb_channels < 2)
         return;
 
-    for (i = f->end_band; i >= end_band; i--) {
-        f->intensity_stereo = i;
-        bands_dist(s, f, &dist);
-        if (best_dist > dist) {
-            best_dist = dist;
-            best_band = i;
+    if (complexity >= 10) {
+        for (i = f->end_band; i >= 0; i--)
+            intensity_try_band(s, f, i, &best_band, &best_dist);
+    } else if (complexity >= 5) {
+        int coarse;
+        for (i = f->end_band; i >= 0; i -= 4)
+            intensity_try_band(s, f, i, &best_band, &best_dist);
+        coarse = best_band;
+        for (i = 1; i < 4; i++) {
+            intensity_try_band(s, f, coarse + i, &best_band, &best_dist);
+            intensity_try_band(s, f, coarse - i, &best_band, &best_dist);
         }
+    } else {
+        const int last = FFMIN(s->last_is_band, f->end_band);
+        intensity_try_band(s, f, f->end_band, &best_band, &best_dist);
+        if (last != f->end_band)
+            intensity_try_band(s, f, last, &best_band, &best_dist);
+        intensity_try_band(s, f, last - 2, &best_band, &best_dist);
+        if (last + 2 < f->end_band)
+            intensity_try_band(s, f, last + 2, &best_band, &best_dist);
     }
 
     f->intensity_stereo = best_band;
+    s->last_is_band = best_band;
     s->avg_is_band = (s->avg_is_band + f->intensity_stereo)/2.0f;
 }
 
@@ -524,6 +557,7 @@ av_cold int ff_opus_psy_init(OpusPsyContext *s, AVCodecContext *avctx,
     s->max_steps = ceilf(s->options->max_delay_ms/2.5f);
     s->bsize_analysis = CELT_BLOCK_960;
     s->avg_is_band = CELT_MAX_BANDS - 1;
+    s->last_is_band = CELT_MAX_BANDS - 1;
     s->inflection_points_count = 0;
 
     s->inflection_points = av_mallocz(sizeof(*s->inflection_points)*s->max_steps);
@@ -71,6 +71,7 @@ typedef struct OpusPsyContext {
 
     /* Stats */
     float avg_is_band;
+    int last_is_band;
     int64_t dual_stereo_used;
     int64_t total_packets_out;
 
@@ -299,6 +299,16 @@ enum AVPacketSideDataType {
      */
     AV_PKT_DATA_DYNAMIC_HDR10_PLUS,
 
+    //PLEX
+    /**
+     * The packet payload is a verbatim copy of a range of a local input file,
+     * in the form of an AVPacketSourceRange. Muxers that write the payload
+     * unchanged may let the kernel copy the range to their output instead.
+     * Anything that changes the payload must drop this side data.
+     */
+    AV_PKT_DATA_SOURCE_RANGE,
+    //PLEX
+
     /**
      * The number of side data types.
      * This is not part of the public API/ABI in the sense that it may
@@ -312,6 +322,23 @@ enum AVPacketSideDataType {
 
 #define AV_PKT_DATA_QUALITY_FACTOR AV_PKT_DATA_QUALITY_STATS //DEPRECATED
 
+//PLEX
+/**
+ * Location of a packet payload in its input file, see
+ * AV_PKT_DATA_SOURCE_RANGE. The range is pkt->size bytes long.
+ */
+typedef struct AVPacketSourceRange {
+    /**
+     * Reference to an int holding a file descriptor of the input file. The
+     * descriptor is closed when the last reference goes away, so it stays
+     * valid as long as a packet or a muxer holds one. Copying the side data
+     * with av_packet_copy_props() takes a new reference.
+     */
+    AVBufferRef *file;
+    int64_t offset;
+} AVPacketSourceRange;
+//PLEX
+
 /**
  * This structure stores auxiliary information for decoding, presenting, or
  * otherwise processing the coded stream. It is typically exported by demuxers
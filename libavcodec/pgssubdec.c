@@ -73,6 +73,16 @@ typedef struct PGSSubObject {
     uint8_t      *rle;
     unsigned int rle_buffer_size, rle_data_len;
     unsigned int rle_remaining_len;
+    //PLEX
+    /* last decoded bitmap and the data it was decoded from, kept across
+     * epochs as objects are commonly sent again unchanged */
+    uint8_t      *bitmap;
+    unsigned int bitmap_size;
+    uint8_t      *bitmap_rle;
+    unsigned int bitmap_rle_size, bitmap_rle_len;
+    int          bitmap_w, bitmap_h;
+    unsigned     bitmap_serial;     ///< 0 if no bitmap is cached
+    //PLEX
 } PGSSubObject;
 
 typedef struct PGSSubObjects {
@@ -90,12 +100,26 @@ typedef struct PGSSubPalettes {
     PGSSubPalette palette[MAX_EPOCH_PALETTES];
 } PGSSubPalettes;
 
+//PLEX
+/* what was shown by a rect of the previous display set */
+typedef struct PGSSubShownRect {
+    unsigned serial;
+    int      x, y;
+    uint32_t clut[256];
+} PGSSubShownRect;
+//PLEX
+
 typedef struct PGSSubContext {
     AVClass *class;
     PGSSubPresentation presentation;
     PGSSubPalettes     palettes;
     PGSSubObjects      objects;
     int forced_subs_only;
+    //PLEX
+    unsigned           bitmap_serial;
+    PGSSubShownRect    shown[MAX_OBJECT_REFS];
+    int                nb_shown;
+    //PLEX
 } PGSSubContext;
 
 static void flush_cache(AVCodecContext *avctx)
@@ -143,7 +167,15 @@ static av_cold int init_decoder(AVCodecContext *avctx)
 
 static av_cold int close_decoder(AVCodecContext *avctx)
 {
+    PGSSubContext *ctx = avctx->priv_data;
+
     flush_cache(avctx);
+    //PLEX
+    for (int i = 0; i < MAX_EPOCH_OBJECTS; i++) {
+        av_freep(&ctx->objects.object[i].bitmap);
+        av_freep(&ctx->objects.object[i].bitmap_rle);
+    }
+    //PLEX
 
     return 0;
 }
@@ -154,11 +186,11 @@ static av_cold int close_decoder(AVCodecContext *avctx)
  * The subtitle is stored as a Run Length Encoded image.
  *
  * @param avctx contains the current codec context
- * @param sub pointer to the processed subtitle data
+ * @param dst buffer for the w x h bitmap
  * @param buf pointer to the RLE data to process
  * @param buf_size size of the RLE data to process
  */
-static int decode_rle(AVCodecContext *avctx, AVSubtitleRect *rect,
+static int decode_rle(AVCodecContext *avctx, uint8_t *dst, int w, int h,
                       const uint8_t *buf, unsigned int buf_size)
 {
     const uint8_t *rle_bitmap_end;
@@ -166,15 +198,10 @@ static int decode_rle(AVCodecContext *avctx, AVSubtitleRect *rect,
 
     rle_bitmap_end = buf + buf_size;
 
-    rect->data[0] = av_malloc_array(rect->w, rect->h);
-
-    if (!rect->data[0])
-        return AVERROR(ENOMEM);
-
     pixel_count = 0;
     line_count  = 0;
 
-    while (buf < rle_bitmap_end && line_count < rect->h) {
+    while (buf < rle_bitmap_end && line_count < h) {
         uint8_t flags, color;
         int run;
 
@@ -189,17 +216,17 @@ static int decode_rle(AVCodecContext *avctx, AVSubtitleRect *rect,
             color = flags & 0x80 ? bytestream_get_byte(&buf) : 0;
         }
 
-        if (run > 0 && pixel_count + run <= rect->w * rect->h) {
-            memset(rect->data[0] + pixel_count, color, run);
+        if (run > 0 && pixel_count + run <= w * h) {
+            memset(dst + pixel_count, color, run);
             pixel_count += run;
         } else if (!run) {
             /*
              * New Line. Check if correct pixels decoded, if not display warning
              * and adjust bitmap pointer to correct new line position.
              */
-            if (pixel_count % rect->w > 0) {
+            if (pixel_count % w > 0) {
                 av_log(avctx, AV_LOG_ERROR, "Decoded %d pixels, when line should be %d pixels\n",
-                       pixel_count % rect->w, rect->w);
+                       pixel_count % w, w);
                 if (avctx->err_recognition & AV_EF_EXPLODE) {
                     return AVERROR_INVALIDDATA;
                 }
@@ -208,15 +235,53 @@ static int decode_rle(AVCodecContext *avctx, AVSubtitleRect *rect,
         }
     }
 
-    if (pixel_count < rect->w * rect->h) {
+    if (pixel_count < w * h) {
         av_log(avctx, AV_LOG_ERROR, "Insufficient RLE data for subtitle\n");
         return AVERROR_INVALIDDATA;
     }
 
-    ff_dlog(avctx, "Pixel Count = %d, Area = %d\n", pixel_count, rect->w * rect->h);
+    ff_dlog(avctx, "Pixel Count = %d, Area = %d\n", pixel_count, w * h);
+
+    return 0;
+}
+
+//PLEX
+/**
+ * Make the bitmap of an object available in object->bitmap, decoding the RLE
+ * data only if it differs from the data of the cached bitmap.
+ */
+static int get_object_bitmap(AVCodecContext *avctx, PGSSubObject *object)
+{
+    PGSSubContext *ctx = avctx->priv_data;
+    int ret;
+
+    if (object->bitmap_serial &&
+        object->bitmap_w == object->w && object->bitmap_h == object->h &&
+        object->bitmap_rle_len == object->rle_data_len &&
+        !memcmp(object->bitmap_rle, object->rle, object->rle_data_len))
+        return 0;
 
+    object->bitmap_serial = 0;
+    av_fast_malloc(&object->bitmap, &object->bitmap_size,
+                   (size_t)object->w * object->h);
+    av_fast_malloc(&object->bitmap_rle, &object->bitmap_rle_size,
+                   FFMAX(object->rle_data_len, 1));
+    if (!object->bitmap || !object->bitmap_rle)
+        return AVERROR(ENOMEM);
+
+    ret = decode_rle(avctx, object->bitmap, object->w, object->h,
+                     object->rle, object->rle_data_len);
+    if (ret < 0)
+        return ret;
+
+    memcpy(object->bitmap_rle, object->rle, object->rle_data_len);
+    object->bitmap_rle_len = object->rle_data_len;
+    object->bitmap_w       = object->w;
+    object->bitmap_h       = object->h;
+    object->bitmap_serial  = ++ctx->bitmap_serial ? ctx->bitmap_serial : ++ctx->bitmap_serial;
     return 0;
 }
+//PLEX
 
 /**
  * Parse the picture segment packet.
@@ -499,7 +564,7 @@ static int display_end_segment(AVCodecContext *avctx, AVSubtitle *sub,
     PGSSubContext *ctx = avctx->priv_data;
     int64_t pts;
     PGSSubPalette *palette;
-    int i, ret;
+    int i, ret, nb_shown;
 
     pts = ctx->presentation.pts != AV_NOPTS_VALUE ? ctx->presentation.pts : sub->pts;
     memset(sub, 0, sizeof(*sub));
@@ -512,6 +577,11 @@ static int display_end_segment(AVCodecContext *avctx, AVSubtitle *sub,
     sub->end_display_time   = UINT32_MAX;
     sub->format             = 0;
 
+    //PLEX
+    nb_shown = ctx->nb_shown;
+    ctx->nb_shown = 0;
+    //PLEX
+
     // Blank if last object_count was 0.
     if (!ctx->presentation.object_count)
         return 1;
@@ -529,8 +599,11 @@ static int display_end_segment(AVCodecContext *avctx, AVSubtitle *sub,
     }
     for (i = 0; i < ctx->presentation.object_count; i++) {
         AVSubtitleRect *const rect = av_mallocz(sizeof(*rect));
+        PGSSubShownRect *shown = &ctx->shown[i]; //PLEX
+        unsigned shown_serial = i < nb_shown ? shown->serial : 0; //PLEX
         PGSSubObject *object;
 
+        shown->serial = 0; //PLEX
         if (!rect)
             return AVERROR(ENOMEM);
         sub->rects[sub->num_rects++] = rect;
@@ -565,7 +638,8 @@ static int display_end_segment(AVCodecContext *avctx, AVSubtitle *sub,
                 if (avctx->err_recognition & AV_EF_EXPLODE)
                     return AVERROR_INVALIDDATA;
             }
-            ret = decode_rle(avctx, rect, object->rle, object->rle_data_len);
+            //PLEX
+            ret = get_object_bitmap(avctx, object);
             if (ret < 0) {
                 if ((avctx->err_recognition & AV_EF_EXPLODE) ||
                     ret == AVERROR(ENOMEM)) {
@@ -575,6 +649,10 @@ static int display_end_segment(AVCodecContext *avctx, AVSubtitle *sub,
                 rect->h = 0;
                 continue;
             }
+            rect->data[0] = av_memdup(object->bitmap, (size_t)object->w * object->h);
+            if (!rect->data[0])
+                return AVERROR(ENOMEM);
+            //PLEX
         }
         /* Allocate memory for colors */
         rect->nb_colors = 256;
@@ -584,7 +662,22 @@ static int display_end_segment(AVCodecContext *avctx, AVSubtitle *sub,
 
         if (!ctx->forced_subs_only || ctx->presentation.objects[i].composition_flag & 0x40)
             memcpy(rect->data[1], palette->clut, rect->nb_colors * sizeof(uint32_t));
+
+        //PLEX
+        /* let the caller keep what it made of the previous rect */
+        if (rect->data[0]) {
+            if (shown_serial && shown_serial == object->bitmap_serial &&
+                shown->x == rect->x && shown->y == rect->y &&
+                !memcmp(shown->clut, rect->data[1], AVPALETTE_SIZE))
+                rect->flags |= AV_SUBTITLE_FLAG_UNCHANGED;
+            shown->serial = object->bitmap_serial;
+            shown->x      = rect->x;
+            shown->y      = rect->y;
+            memcpy(shown->clut, rect->data[1], AVPALETTE_SIZE);
+        }
+        //PLEX
     }
+    ctx->nb_shown = ctx->presentation.object_count; //PLEX
     return 1;
 }
 
@@ -48,8 +48,10 @@
 #include "libavutil/internal.h"
 #include "libavutil/log.h"
 #include "libavutil/mem.h"
+#include "libavutil/mem_internal.h" //PLEX
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h" //PLEX
 
 enum {
     /// Set when the thread is awaiting a packet.
@@ -108,6 +110,11 @@ typedef struct PerThreadContext {
     int hwaccel_threadsafe;
 
     atomic_int debug_threads;       ///< Set if the FF_DEBUG_THREADS option is set.
+
+    //PLEX
+    AVCodecThreadStats stats;       ///< Updated by this thread, if the parent collects them.
+    int64_t decode_start;           ///< When the current packet started decoding.
+    //PLEX
 } PerThreadContext;
 
 /**
@@ -135,6 +142,12 @@ typedef struct FrameThreadContext {
                                     * Set for the first N packets, where N is the number of threads.
                                     * While it is set, ff_thread_en/decode_frame won't return any results.
                                     */
+    //PLEX
+    int nb_pending;                ///< Submitted packets whose output has not been returned yet.
+    int collect_stats;             ///< Set from AVCodecContext.thread_stats.
+    int64_t submit_wait_time;
+    int64_t output_wait_time;
+    //PLEX
 
     /* hwaccel state for thread-unsafe hwaccels is temporarily stored here in
      * order to transfer its ownership to the next decoding thread without the
@@ -144,6 +157,26 @@ typedef struct FrameThreadContext {
     void            *stash_hwaccel_priv;
 } FrameThreadContext;
 
+//PLEX
+/* the worker running on the current thread, for the progress wait statistics */
+static _Thread_local PerThreadContext *cur_worker;
+
+static int64_t stats_now(const FrameThreadContext *fctx)
+{
+    return fctx->collect_stats ? av_gettime_relative() : 0;
+}
+
+static void hwaccel_lock(PerThreadContext *p)
+{
+    int64_t start = stats_now(p->parent);
+
+    pthread_mutex_lock(&p->parent->hwaccel_mutex);
+    if (start)
+        p->stats.hwaccel_wait_time += av_gettime_relative() - start;
+    p->hwaccel_serializing = 1;
+}
+//PLEX
+
 static int hwaccel_serial(const AVCodecContext *avctx)
 {
     return avctx->hwaccel && !(ffhwaccel(avctx->hwaccel)->caps_internal & HWACCEL_CAP_THREAD_SAFE);
@@ -192,14 +225,25 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
     const FFCodec *codec = ffcodec(avctx->codec);
 
     thread_set_name(p);
+    avpriv_mem_tag_push(AV_MEM_TAG_CODEC); //PLEX
+    cur_worker = p; //PLEX
 
     pthread_mutex_lock(&p->mutex);
     while (1) {
+        int64_t idle_start = stats_now(p->parent); //PLEX
+
         while (atomic_load(&p->state) == STATE_INPUT_READY && !p->die)
             pthread_cond_wait(&p->input_cond, &p->mutex);
 
         if (p->die) break;
 
+        //PLEX
+        if (idle_start) {
+            p->decode_start = av_gettime_relative();
+            p->stats.idle_time += p->decode_start - idle_start;
+        }
+        //PLEX
+
         if (!codec->update_thread_context)
             ff_thread_finish_setup(avctx);
 
@@ -213,10 +257,8 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
 
         /* if the previous thread uses thread-unsafe hwaccel then we take the
          * lock to ensure the threads don't run concurrently */
-        if (hwaccel_serial(avctx)) {
-            pthread_mutex_lock(&p->parent->hwaccel_mutex);
-            p->hwaccel_serializing = 1;
-        }
+        if (hwaccel_serial(avctx))
+            hwaccel_lock(p); //PLEX
 
         av_frame_unref(p->frame);
         p->got_frame = 0;
@@ -228,6 +270,14 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
         if (atomic_load(&p->state) == STATE_SETTING_UP)
             ff_thread_finish_setup(avctx);
 
+        //PLEX
+        if (p->decode_start) {
+            p->stats.decode_time += av_gettime_relative() - p->decode_start;
+            p->stats.packets++;
+            p->decode_start = 0;
+        }
+        //PLEX
+
         if (p->hwaccel_serializing) {
             /* wipe hwaccel state for thread-unsafe hwaccels to avoid stale
              * pointers lying around;
@@ -462,10 +512,16 @@ static int submit_packet(PerThreadContext *p, AVCodecContext *user_avctx,
     if (prev_thread) {
         int err;
         if (atomic_load(&prev_thread->state) == STATE_SETTING_UP) {
+            int64_t start = stats_now(fctx); //PLEX
+
             pthread_mutex_lock(&prev_thread->progress_mutex);
             while (atomic_load(&prev_thread->state) == STATE_SETTING_UP)
                 pthread_cond_wait(&prev_thread->progress_cond, &prev_thread->progress_mutex);
             pthread_mutex_unlock(&prev_thread->progress_mutex);
+            //PLEX
+            if (start)
+                fctx->submit_wait_time += av_gettime_relative() - start;
+            //PLEX
         }
 
         err = update_context_from_thread(p->avctx, prev_thread->avctx, 0);
@@ -497,6 +553,7 @@ static int submit_packet(PerThreadContext *p, AVCodecContext *user_avctx,
 
     fctx->prev_thread = p;
     fctx->next_decoding++;
+    fctx->nb_pending++; //PLEX
 
     return 0;
 }
@@ -523,6 +580,28 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
     if (err)
         goto finish;
 
+    //PLEX
+    /*
+     * In low delay mode, only wait for the oldest thread once every thread
+     * is busy; before that, return its output only if it is already done.
+     */
+    if (avctx->frame_thread_low_delay && avpkt->size) {
+        int max_pending = avctx->thread_count - (avctx->codec_id == AV_CODEC_ID_FFV1);
+
+        if (fctx->next_decoding >= avctx->thread_count)
+            fctx->next_decoding = 0;
+        fctx->delaying = 0;
+
+        p = &fctx->threads[finished];
+        if (fctx->nb_pending < max_pending &&
+            (!fctx->nb_pending || atomic_load(&p->state) != STATE_INPUT_READY)) {
+            *got_picture_ptr = 0;
+            err = avpkt->size;
+            goto finish;
+        }
+    }
+    //PLEX
+
     /*
      * If we're still receiving the initial packets, don't return a frame.
      */
@@ -549,10 +628,16 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
         p = &fctx->threads[finished++];
 
         if (atomic_load(&p->state) != STATE_INPUT_READY) {
+            int64_t start = stats_now(fctx); //PLEX
+
             pthread_mutex_lock(&p->progress_mutex);
             while (atomic_load_explicit(&p->state, memory_order_relaxed) != STATE_INPUT_READY)
                 pthread_cond_wait(&p->output_cond, &p->progress_mutex);
             pthread_mutex_unlock(&p->progress_mutex);
+            //PLEX
+            if (start)
+                fctx->output_wait_time += av_gettime_relative() - start;
+            //PLEX
         }
 
         av_frame_move_ref(picture, p->frame);
@@ -568,6 +653,7 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
          */
         p->got_frame = 0;
         p->result = 0;
+        fctx->nb_pending = FFMAX(fctx->nb_pending - 1, 0); //PLEX
 
         if (finished >= avctx->thread_count) finished = 0;
     } while (!avpkt->size && !*got_picture_ptr && err >= 0 && finished != fctx->next_finished);
@@ -611,8 +697,9 @@ void ff_thread_report_progress(ThreadFrame *f, int n, int field)
 
 void ff_thread_await_progress(const ThreadFrame *f, int n, int field)
 {
-    PerThreadContext *p;
+    PerThreadContext *p, *worker = cur_worker; //PLEX
     atomic_int *progress = f->progress ? f->progress->progress : NULL;
+    int64_t start; //PLEX
 
     if (!progress ||
         atomic_load_explicit(&progress[field], memory_order_acquire) >= n)
@@ -624,10 +711,24 @@ void ff_thread_await_progress(const ThreadFrame *f, int n, int field)
         av_log(f->owner[field], AV_LOG_DEBUG,
                "thread awaiting %d field %d from %p\n", n, field, progress);
 
+    start = worker ? stats_now(worker->parent) : 0; //PLEX
     pthread_mutex_lock(&p->progress_mutex);
     while (atomic_load_explicit(&progress[field], memory_order_relaxed) < n)
         pthread_cond_wait(&p->progress_cond, &p->progress_mutex);
     pthread_mutex_unlock(&p->progress_mutex);
+
+    //PLEX
+    if (start) {
+        int64_t time = av_gettime_relative() - start;
+        int bucket = 0;
+
+        while (bucket < AV_THREAD_STATS_WAIT_BUCKETS - 1 && time >= 16 << (2 * bucket))
+            bucket++;
+        worker->stats.progress_wait_hist[bucket]++;
+        worker->stats.progress_waits++;
+        worker->stats.progress_wait_time += time;
+    }
+    //PLEX
 }
 
 void ff_thread_finish_setup(AVCodecContext *avctx) {
@@ -640,10 +741,8 @@ void ff_thread_finish_setup(AVCodecContext *avctx) {
     p->hwaccel_threadsafe = avctx->hwaccel &&
                             (ffhwaccel(avctx->hwaccel)->caps_internal & HWACCEL_CAP_THREAD_SAFE);
 
-    if (hwaccel_serial(avctx) && !p->hwaccel_serializing) {
-        pthread_mutex_lock(&p->parent->hwaccel_mutex);
-        p->hwaccel_serializing = 1;
-    }
+    if (hwaccel_serial(avctx) && !p->hwaccel_serializing)
+        hwaccel_lock(p); //PLEX
 
     /* this assumes that no hwaccel calls happen before ff_thread_finish_setup() */
     if (avctx->hwaccel &&
@@ -673,6 +772,11 @@ void ff_thread_finish_setup(AVCodecContext *avctx) {
 
     pthread_cond_broadcast(&p->progress_cond);
     pthread_mutex_unlock(&p->progress_mutex);
+
+    //PLEX
+    if (p->decode_start)
+        p->stats.setup_time += av_gettime_relative() - p->decode_start;
+    //PLEX
 }
 
 /// Waits for all threads to finish.
@@ -863,6 +967,7 @@ int ff_frame_thread_init(AVCodecContext *avctx)
             thread_count = avctx->thread_count = FFMIN(nb_cpus + 1, MAX_AUTO_THREADS);
         else
             thread_count = avctx->thread_count = 1;
+        thread_count = avctx->thread_count = ff_thread_budget_acquire(avctx, thread_count); //PLEX
     }
 
     if (thread_count <= 1) {
@@ -883,6 +988,7 @@ int ff_frame_thread_init(AVCodecContext *avctx)
 
     fctx->async_lock = 1;
     fctx->delaying = 1;
+    fctx->collect_stats = avctx->thread_stats; //PLEX
 
     if (codec->p.type == AVMEDIA_TYPE_VIDEO)
         avctx->delay = avctx->thread_count - 1;
@@ -909,6 +1015,40 @@ error:
     return err;
 }
 
+//PLEX
+int ff_frame_thread_get_stats(AVCodecContext *avctx, int thread, AVCodecThreadStats *stats)
+{
+    FrameThreadContext *fctx = avctx->internal->thread_ctx;
+
+    if (!fctx->collect_stats)
+        return AVERROR(ENOSYS);
+    if (thread < -1 || thread >= avctx->thread_count)
+        return AVERROR(EINVAL);
+    if (thread >= 0) {
+        *stats = fctx->threads[thread].stats;
+        return avctx->thread_count;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < avctx->thread_count; i++) {
+        const AVCodecThreadStats *t = &fctx->threads[i].stats;
+
+        stats->packets            += t->packets;
+        stats->decode_time        += t->decode_time;
+        stats->setup_time         += t->setup_time;
+        stats->progress_waits     += t->progress_waits;
+        stats->progress_wait_time += t->progress_wait_time;
+        stats->hwaccel_wait_time  += t->hwaccel_wait_time;
+        stats->idle_time          += t->idle_time;
+        for (int j = 0; j < AV_THREAD_STATS_WAIT_BUCKETS; j++)
+            stats->progress_wait_hist[j] += t->progress_wait_hist[j];
+    }
+    stats->submit_wait_time = fctx->submit_wait_time;
+    stats->output_wait_time = fctx->output_wait_time;
+    return avctx->thread_count;
+}
+//PLEX
+
 void ff_thread_flush(AVCodecContext *avctx)
 {
     int i;
@@ -924,6 +1064,7 @@ void ff_thread_flush(AVCodecContext *avctx)
 
     fctx->next_decoding = fctx->next_finished = 0;
     fctx->delaying = 1;
+    fctx->nb_pending = 0; //PLEX
     fctx->prev_thread = NULL;
     for (i = 0; i < avctx->thread_count; i++) {
         PerThreadContext *p = &fctx->threads[i];
@@ -152,6 +152,8 @@ int ff_slice_thread_init(AVCodecContext *avctx)
             thread_count = avctx->thread_count = FFMIN(nb_cpus + 1, MAX_AUTO_THREADS);
         else
             thread_count = avctx->thread_count = 1;
+        if (av_codec_is_decoder(avctx->codec)) //PLEX
+            thread_count = avctx->thread_count = ff_thread_budget_acquire(avctx, thread_count);
     }
 
     if (thread_count <= 1) {
@@ -161,7 +163,11 @@ int ff_slice_thread_init(AVCodecContext *avctx)
 
     avctx->internal->thread_ctx = c = av_mallocz(sizeof(*c));
     mainfunc = ffcodec(avctx->codec)->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ? &main_function : NULL;
-    if (!c || (thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func, mainfunc, thread_count)) <= 1) {
+    if (c && avctx->shared_threads && !mainfunc) //PLEX
+        thread_count = avpriv_slicethread_create_shared(&c->thread, avctx, worker_func, thread_count);
+    else if (c)
+        thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func, mainfunc, thread_count);
+    if (!c || thread_count <= 1) {
         if (c)
             avpriv_slicethread_free(&c->thread);
         av_freep(&avctx->internal->thread_ctx);
@@ -2393,6 +2393,12 @@ static int encode_frame(AVCodecContext *avctx, QSVEncContext *q,
             if (q->forced_idr)
                 enc_ctrl->FrameType |= MFX_FRAMETYPE_IDR;
         }
+        //PLEX: restart with an IDR after a flush
+        if (q->flush_idr) {
+            enc_ctrl->FrameType = MFX_FRAMETYPE_I | MFX_FRAMETYPE_IDR | MFX_FRAMETYPE_REF;
+            q->flush_idr = 0;
+        }
+        //PLEX
     }
 
     ret = av_new_packet(&pkt.pkt, q->packet_size);
@@ -2485,6 +2491,33 @@ nomem:
     goto free;
 }
 
+//PLEX
+static void qsv_set_ext_params(AVCodecContext *avctx, QSVEncContext *q)
+{
+    if (avctx->hwaccel_context) {
+        AVQSVContext *qsv = avctx->hwaccel_context;
+        int i, j;
+        q->param.ExtParam = q->extparam;
+        for (i = 0; i < qsv->nb_ext_buffers; i++)
+            q->param.ExtParam[i] = qsv->ext_buffers[i];
+        q->param.NumExtParam = qsv->nb_ext_buffers;
+
+        for (i = 0; i < q->nb_extparam_internal; i++) {
+            for (j = 0; j < qsv->nb_ext_buffers; j++) {
+                if (qsv->ext_buffers[j]->BufferId == q->extparam_internal[i]->BufferId)
+                    break;
+            }
+            if (j < qsv->nb_ext_buffers)
+                continue;
+            q->param.ExtParam[q->param.NumExtParam++] = q->extparam_internal[i];
+        }
+    } else {
+        q->param.ExtParam    = q->extparam_internal;
+        q->param.NumExtParam = q->nb_extparam_internal;
+    }
+}
+//PLEX
+
 static int update_parameters(AVCodecContext *avctx, QSVEncContext *q,
                              const AVFrame *frame)
 {
@@ -2508,27 +2541,7 @@ static int update_parameters(AVCodecContext *avctx, QSVEncContext *q,
     if (!needReset)
         return 0;
 
-    if (avctx->hwaccel_context) {
-        AVQSVContext *qsv = avctx->hwaccel_context;
-        int i, j;
-        q->param.ExtParam = q->extparam;
-        for (i = 0; i < qsv->nb_ext_buffers; i++)
-            q->param.ExtParam[i] = qsv->ext_buffers[i];
-        q->param.NumExtParam = qsv->nb_ext_buffers;
-
-        for (i = 0; i < q->nb_extparam_internal; i++) {
-            for (j = 0; j < qsv->nb_ext_buffers; j++) {
-                if (qsv->ext_buffers[j]->BufferId == q->extparam_internal[i]->BufferId)
-                    break;
-            }
-            if (j < qsv->nb_ext_buffers)
-                continue;
-            q->param.ExtParam[q->param.NumExtParam++] = q->extparam_internal[i];
-        }
-    } else {
-        q->param.ExtParam    = q->extparam_internal;
-        q->param.NumExtParam = q->nb_extparam_internal;
-    }
+    qsv_set_ext_params(avctx, q); //PLEX
 
     // Flush codec before reset configuration.
     while (ret != AVERROR(EAGAIN)) {
@@ -2611,6 +2624,43 @@ int ff_qsv_encode(AVCodecContext *avctx, QSVEncContext *q,
     return 0;
 }
 
+//PLEX
+void ff_qsv_enc_flush(AVCodecContext *avctx, QSVEncContext *q)
+{
+    QSVPacket pkt;
+    int ret;
+
+    if (!q->session)
+        return;
+
+    /* wait for the queued operations before freeing their bitstreams */
+    while (av_fifo_read(q->async_fifo, &pkt, 1) >= 0) {
+        do {
+            ret = MFXVideoCORE_SyncOperation(q->session, *pkt.sync, 1000);
+        } while (ret == MFX_WRN_IN_EXECUTION);
+
+        if (avctx->codec_id == AV_CODEC_ID_H264) {
+            mfxExtBuffer **enc_buf = pkt.bs->ExtParam;
+            mfxExtAVCEncodedFrameInfo *enc_info = (mfxExtAVCEncodedFrameInfo *)(*enc_buf);
+            av_freep(&enc_info);
+            av_freep(&enc_buf);
+        }
+        av_freep(&pkt.sync);
+        av_freep(&pkt.bs);
+        av_packet_unref(&pkt.pkt);
+    }
+
+    /* restart the sequence on the same session */
+    qsv_set_ext_params(avctx, q);
+    ret = MFXVideoENCODE_Reset(q->session, &q->param);
+    if (ret < 0)
+        ff_qsv_print_error(avctx, ret, "Error resetting the encoder on flush");
+
+    clear_unused_frames(q);
+    q->flush_idr = 1;
+}
+//PLEX
+
 int ff_qsv_enc_close(AVCodecContext *avctx, QSVEncContext *q)
 {
     QSVFrame *cur;
@@ -314,6 +314,7 @@ typedef struct QSVEncContext {
     int skip_frame;
     // This is used for Hyper Encode
     int dual_gfx;
+    int flush_idr; //PLEX: force an IDR after ff_qsv_enc_flush()
 } QSVEncContext;
 
 int ff_qsv_enc_init(AVCodecContext *avctx, QSVEncContext *q);
@@ -323,4 +324,6 @@ int ff_qsv_encode(AVCodecContext *avctx, QSVEncContext *q,
 
 int ff_qsv_enc_close(AVCodecContext *avctx, QSVEncContext *q);
 
+void ff_qsv_enc_flush(AVCodecContext *avctx, QSVEncContext *q); //PLEX
+
 #endif /* AVCODEC_QSVENC_H */
@@ -97,6 +97,15 @@ static av_cold int qsv_enc_close(AVCodecContext *avctx)
     return ff_qsv_enc_close(avctx, &q->qsv);
 }
 
+//PLEX
+static av_cold void qsv_enc_flush(AVCodecContext *avctx)
+{
+    QSVH264EncContext *q = avctx->priv_data;
+
+    ff_qsv_enc_flush(avctx, &q->qsv);
+}
+//PLEX
+
 #define OFFSET(x) offsetof(QSVH264EncContext, x)
 #define VE AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_ENCODING_PARAM
 static const AVOption options[] = {
@@ -198,7 +207,9 @@ const FFCodec ff_h264_qsv_encoder = {
     .init           = qsv_enc_init,
     FF_CODEC_ENCODE_CB(qsv_enc_frame),
     .close          = qsv_enc_close,
-    .p.capabilities = AV_CODEC_CAP_DELAY | AV_CODEC_CAP_HYBRID,
+    .flush          = qsv_enc_flush, //PLEX
+    .p.capabilities = AV_CODEC_CAP_DELAY | AV_CODEC_CAP_HYBRID |
+                      AV_CODEC_CAP_ENCODER_FLUSH, //PLEX
     .p.pix_fmts     = (const enum AVPixelFormat[]){ AV_PIX_FMT_NV12,
                                                     AV_PIX_FMT_QSV,
                                                     AV_PIX_FMT_NONE },
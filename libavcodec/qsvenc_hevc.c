@@ -299,6 +299,15 @@ static av_cold int qsv_enc_close(AVCodecContext *avctx)
     return ff_qsv_enc_close(avctx, &q->qsv);
 }
 
+//PLEX
+static av_cold void qsv_enc_flush(AVCodecContext *avctx)
+{
+    QSVHEVCEncContext *q = avctx->priv_data;
+
+    ff_qsv_enc_flush(avctx, &q->qsv);
+}
+//PLEX
+
 #define OFFSET(x) offsetof(QSVHEVCEncContext, x)
 #define VE AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_ENCODING_PARAM
 static const AVOption options[] = {
@@ -393,7 +402,9 @@ const FFCodec ff_hevc_qsv_encoder = {
     .init           = qsv_enc_init,
     FF_CODEC_ENCODE_CB(qsv_enc_frame),
     .close          = qsv_enc_close,
-    .p.capabilities = AV_CODEC_CAP_DELAY | AV_CODEC_CAP_HYBRID,
+    .flush          = qsv_enc_flush, //PLEX
+    .p.capabilities = AV_CODEC_CAP_DELAY | AV_CODEC_CAP_HYBRID |
+                      AV_CODEC_CAP_ENCODER_FLUSH, //PLEX
     .p.pix_fmts     = (const enum AVPixelFormat[]){ AV_PIX_FMT_NV12,
                                                     AV_PIX_FMT_P010,
                                                     AV_PIX_FMT_P012,
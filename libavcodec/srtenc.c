@@ -234,7 +234,7 @@ static int encode_frame(AVCodecContext *avctx,
                         const ASSCodesCallbacks *cb)
 {
     SRTContext *s = avctx->priv_data;
-    ASSDialog *dialog;
+    const ASSDialog *dialog;
     int i;
 
     av_bprint_clear(&s->buffer);
@@ -247,14 +247,13 @@ static int encode_frame(AVCodecContext *avctx,
             return AVERROR(EINVAL);
         }
 
-        dialog = ff_ass_split_dialog(s->ass_ctx, ass);
+        dialog = ff_ass_split_dialog_view(s->ass_ctx, ass);
         if (!dialog)
             return AVERROR(ENOMEM);
         s->alignment_applied = 0;
         if (avctx->codec_id == AV_CODEC_ID_SUBRIP)
             srt_style_apply(s, dialog->style);
         ff_ass_split_override_codes(cb, s, dialog->text);
-        ff_ass_free_dialog(&dialog);
     }
 
     if (!av_bprint_is_complete(&s->buffer))
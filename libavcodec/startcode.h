@@ -27,10 +27,37 @@
 
 #include <stdint.h>
 
+//PLEX
+#include "config.h"
+#include "libavutil/intreadwrite.h"
+//PLEX
+
 const uint8_t *avpriv_find_start_code(const uint8_t *p,
                                       const uint8_t *end,
                                       uint32_t *state);
 
 int ff_startcode_find_candidate_c(const uint8_t *buf, int size);
 
+//PLEX
+/**
+ * Skip the words of [p, end) that contain no zero byte, so cannot hold the
+ * start of a start code. Unlike ff_startcode_find_candidate_c() this never
+ * reads past end, so it also works on unpadded buffers.
+ *
+ * @return p advanced to the first word possibly holding a zero byte, or to
+ *         less than a word before end
+ */
+static inline const uint8_t *ff_startcode_skip_nonzero(const uint8_t *p,
+                                                       const uint8_t *end)
+{
+#if HAVE_FAST_UNALIGNED && HAVE_FAST_64BIT
+    while (end - p >= 8 &&
+           !((~AV_RN64(p) & (AV_RN64(p) - 0x0101010101010101ULL)) &
+             0x8080808080808080ULL))
+        p += 8;
+#endif
+    return p;
+}
+//PLEX
+
 #endif /* AVCODEC_STARTCODE_H */
@@ -84,4 +84,21 @@ int ff_slice_thread_init_progress(AVCodecContext *avctx);
 void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, int n);
 void ff_thread_await_progress2(AVCodecContext *avctx,  int field, int thread, int shift);
 
+//PLEX
+/**
+ * Take up to wanted threads from the process-wide budget shared by all
+ * contexts with shared_thread_weight set. The grant is proportional to the
+ * weight of the context among the open ones and limited to what is still
+ * free, but always at least 1. If sharing is disabled, wanted is returned.
+ * The threads are returned by ff_thread_budget_release().
+ */
+int ff_thread_budget_acquire(AVCodecContext *avctx, int wanted);
+void ff_thread_budget_release(AVCodecContext *avctx);
+
+/**
+ * Backend of avcodec_get_thread_stats() for frame threading.
+ */
+int ff_frame_thread_get_stats(AVCodecContext *avctx, int thread, AVCodecThreadStats *stats);
+//PLEX
+
 #endif /* AVCODEC_THREAD_H */
@@ -0,0 +1,71 @@
+/*
+ * Process-wide thread budget shared by codec contexts
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/log.h"
+#include "libavutil/thread.h"
+
+#include "avcodec.h"
+#include "internal.h"
+#include "thread.h"
+
+static AVMutex budget_mutex = AV_MUTEX_INITIALIZER;
+static int64_t budget_weight;   ///< sum of the weights of the open contexts
+static int     budget_used;     ///< threads handed out to the open contexts
+
+int ff_thread_budget_acquire(AVCodecContext *avctx, int wanted)
+{
+    AVCodecInternal *avci = avctx->internal;
+    int total = av_cpu_count();
+    int share, granted;
+
+    if (avctx->shared_thread_weight <= 0 || avci->budget_threads)
+        return wanted;
+
+    ff_mutex_lock(&budget_mutex);
+    budget_weight += avctx->shared_thread_weight;
+    share   = total * (int64_t)avctx->shared_thread_weight / budget_weight;
+    granted = FFMAX(1, FFMIN3(wanted, share, total - budget_used));
+    budget_used += granted;
+    avci->budget_threads = granted;
+    avci->budget_weight  = avctx->shared_thread_weight;
+    ff_mutex_unlock(&budget_mutex);
+
+    av_log(avctx, AV_LOG_VERBOSE, "Using %d of %d wanted threads from the "
+           "shared budget of %d\n", granted, wanted, total);
+    return granted;
+}
+
+void ff_thread_budget_release(AVCodecContext *avctx)
+{
+    AVCodecInternal *avci = avctx->internal;
+
+    if (!avci->budget_threads)
+        return;
+
+    ff_mutex_lock(&budget_mutex);
+    budget_weight -= avci->budget_weight;
+    budget_used   -= avci->budget_threads;
+    ff_mutex_unlock(&budget_mutex);
+
+    avci->budget_threads = 0;
+    avci->budget_weight  = 0;
+}
@@ -81,7 +81,7 @@ static int ttml_encode_frame(AVCodecContext *avctx, uint8_t *buf,
                              int bufsize, const AVSubtitle *sub)
 {
     TTMLContext *s = avctx->priv_data;
-    ASSDialog *dialog;
+    const ASSDialog *dialog;
     int i;
 
     av_bprint_clear(&s->buffer);
@@ -95,7 +95,7 @@ static int ttml_encode_frame(AVCodecContext *avctx, uint8_t *buf,
             return AVERROR(EINVAL);
         }
 
-        dialog = ff_ass_split_dialog(s->ass_ctx, ass);
+        dialog = ff_ass_split_dialog_view(s->ass_ctx, ass);
         if (!dialog)
             return AVERROR(ENOMEM);
 
@@ -117,16 +117,12 @@ static int ttml_encode_frame(AVCodecContext *avctx, uint8_t *buf,
                    dialog->text,
                    av_err2str(ret));
 
-            if (log_level == AV_LOG_ERROR) {
-                ff_ass_free_dialog(&dialog);
+            if (log_level == AV_LOG_ERROR)
                 return ret;
-            }
         }
 
         if (dialog->style)
             av_bprintf(&s->buffer, "</span>");
-
-        ff_ass_free_dialog(&dialog);
     }
 
     if (!av_bprint_is_complete(&s->buffer))
@@ -981,7 +981,7 @@ const uint8_t *avpriv_find_start_code(const uint8_t *av_restrict p,
     }
 
     while (p < end) {
-        if      (p[-1] > 1      ) p += 3;
+        if      (p[-1] > 1      ) p = ff_startcode_skip_nonzero(p, end) + 3; //PLEX
         else if (p[-2]          ) p += 2;
         else if (p[-3]|(p[-1]-1)) p++;
         else {
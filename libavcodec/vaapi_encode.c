@@ -26,6 +26,7 @@
 #include "libavutil/internal.h"
 #include "libavutil/log.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
 
 #include "vaapi_encode.h"
 #include "encode.h"
@@ -140,6 +141,7 @@ static int vaapi_encode_wait(AVCodecContext *avctx,
 {
     VAAPIEncodeContext *ctx = avctx->priv_data;
     VAStatus vas;
+    int64_t wait_start; //PLEX
 
     av_assert0(pic->encode_issued);
 
@@ -147,6 +149,7 @@ static int vaapi_encode_wait(AVCodecContext *avctx,
         // Already waited for this picture.
         return 0;
     }
+    wait_start = av_gettime_relative(); //PLEX
 
     av_log(avctx, AV_LOG_DEBUG, "Sync to pic %"PRId64"/%"PRId64" "
            "(input surface %#x).\n", pic->display_order,
@@ -173,6 +176,14 @@ static int vaapi_encode_wait(AVCodecContext *avctx,
         }
     }
 
+    //PLEX
+    {
+        int64_t now = av_gettime_relative();
+        ctx->stat_wait_time += now - wait_start;
+        ctx->stat_hw_time   += now - pic->issue_time;
+    }
+    //PLEX
+
     // Input is definitely finished with now.
     av_frame_free(&pic->input_image);
 
@@ -641,6 +652,18 @@ static int vaapi_encode_issue(AVCodecContext *avctx,
 
     pic->encode_issued = 1;
 
+    //PLEX
+    {
+        int depth = 0;
+        for (VAAPIEncodePicture *tmp = ctx->pic_start; tmp; tmp = tmp->next)
+            depth += tmp->encode_issued && !tmp->encode_complete;
+        pic->issue_time = av_gettime_relative();
+        ctx->stat_pictures++;
+        ctx->stat_depth_sum += depth;
+        ctx->stat_depth_max  = FFMAX(ctx->stat_depth_max, depth);
+    }
+    //PLEX
+
     return 0;
 
 fail_with_picture:
@@ -1434,19 +1457,24 @@ start:
     }
 
     if (ctx->has_sync_buffer_func) {
-        if (av_fifo_can_write(ctx->encode_fifo)) {
+        //PLEX
+        /* Issue every picture whose references are issued, e.g. all the
+         * B-frames released by a new P-frame, so that the hardware is not
+         * left idle while the oldest picture is waited for. */
+        while (av_fifo_can_write(ctx->encode_fifo)) {
+        //PLEX
             err = vaapi_encode_pick_next(avctx, &pic);
-            if (!err) {
-                av_assert0(pic);
-                pic->encode_order = ctx->encode_order +
-                    av_fifo_can_read(ctx->encode_fifo);
-                err = vaapi_encode_issue(avctx, pic);
-                if (err < 0) {
-                    av_log(avctx, AV_LOG_ERROR, "Encode failed: %d.\n", err);
-                    return err;
-                }
-                av_fifo_write(ctx->encode_fifo, &pic, 1);
+            if (err)
+                break;
+            av_assert0(pic);
+            pic->encode_order = ctx->encode_order +
+                av_fifo_can_read(ctx->encode_fifo);
+            err = vaapi_encode_issue(avctx, pic);
+            if (err < 0) {
+                av_log(avctx, AV_LOG_ERROR, "Encode failed: %d.\n", err);
+                return err;
             }
+            av_fifo_write(ctx->encode_fifo, &pic, 1);
         }
 
         if (!av_fifo_can_read(ctx->encode_fifo))
@@ -2964,6 +2992,41 @@ fail:
     return err;
 }
 
+//PLEX
+av_cold void ff_vaapi_encode_flush(AVCodecContext *avctx)
+{
+    VAAPIEncodeContext *ctx = avctx->priv_data;
+    VAAPIEncodePicture *pic, *next;
+    int i;
+
+    // Drop every queued picture; the next input starts a new IDR GOP on
+    // the same VA context, as after init.
+    for (pic = ctx->pic_start; pic; pic = next) {
+        next = pic->next;
+        vaapi_encode_free(avctx, pic);
+    }
+    ctx->pic_start = ctx->pic_end = NULL;
+
+    for (i = 0; i < MAX_PICTURE_REFERENCES; i++)
+        ctx->next_prev[i] = NULL;
+    ctx->nb_next_prev = 0;
+
+    if (ctx->encode_fifo)
+        av_fifo_reset2(ctx->encode_fifo);
+    av_packet_unref(ctx->tail_pkt);
+    av_frame_unref(ctx->frame);
+
+    ctx->input_order   = 0;
+    ctx->encode_order  = 0;
+    ctx->output_order  = 0;
+    ctx->gop_counter   = 0;
+    ctx->idr_counter   = 0;
+    ctx->first_pts     = 0;
+    ctx->dts_pts_diff  = 0;
+    ctx->end_of_stream = 0;
+}
+//PLEX
+
 av_cold int ff_vaapi_encode_close(AVCodecContext *avctx)
 {
     VAAPIEncodeContext *ctx = avctx->priv_data;
@@ -2974,6 +3037,18 @@ av_cold int ff_vaapi_encode_close(AVCodecContext *avctx)
     if (!ctx->frame)
         return 0;
 
+    //PLEX
+    if (ctx->stat_pictures)
+        av_log(avctx, AV_LOG_VERBOSE, "%"PRId64" pictures encoded, "
+               "%.1f in flight on average (max %d), %.2f ms from issue to "
+               "completion, %.2f ms blocked on completion per picture.\n",
+               ctx->stat_pictures,
+               (double)ctx->stat_depth_sum / ctx->stat_pictures,
+               ctx->stat_depth_max,
+               ctx->stat_hw_time   / 1000.0 / ctx->stat_pictures,
+               ctx->stat_wait_time / 1000.0 / ctx->stat_pictures);
+    //PLEX
+
     for (pic = ctx->pic_start; pic; pic = next) {
         next = pic->next;
         vaapi_encode_free(avctx, pic);
@@ -93,6 +93,7 @@ typedef struct VAAPIEncodePicture {
     int             b_depth;
     int             encode_issued;
     int             encode_complete;
+    int64_t         issue_time; //PLEX
 
     AVFrame        *input_image;
     VASurfaceID     input_surface;
@@ -379,6 +380,17 @@ typedef struct VAAPIEncodeContext {
     // Max number of frame buffered in encoder.
     int             async_depth;
 
+    //PLEX
+    // Pipeline statistics, logged on close.
+    int64_t         stat_pictures;
+    // Sum and peak of the pictures in flight when one is issued.
+    int64_t         stat_depth_sum;
+    int             stat_depth_max;
+    // Time from issue to completion, and time spent blocked on completion.
+    int64_t         stat_hw_time;
+    int64_t         stat_wait_time;
+    //PLEX
+
     /** Head data for current output pkt, used only for AV1. */
     //void  *header_data;
     //size_t header_data_size;
@@ -493,6 +505,7 @@ int ff_vaapi_encode_receive_packet(AVCodecContext *avctx, AVPacket *pkt);
 
 int ff_vaapi_encode_init(AVCodecContext *avctx);
 int ff_vaapi_encode_close(AVCodecContext *avctx);
+void ff_vaapi_encode_flush(AVCodecContext *avctx); //PLEX
 
 
 #define VAAPI_ENCODE_COMMON_OPTIONS \
@@ -84,8 +84,17 @@ typedef struct VAAPIEncodeAV1Context {
     int tier;
     int tile_cols, tile_rows;
     int tile_groups;
+    int tune; //PLEX
 } VAAPIEncodeAV1Context;
 
+//PLEX
+enum {
+    TUNE_DEFAULT,
+    TUNE_LOW_DELAY,
+    TUNE_LADDER,
+};
+//PLEX
+
 static void vaapi_encode_av1_trace_write_log(void *ctx,
                                              PutBitContext *pbc, int length,
                                              const char *str, const int *subscripts,
@@ -786,6 +795,26 @@ static av_cold int vaapi_encode_av1_init(AVCodecContext *avctx)
         return AVERROR(EINVAL);
     }
 
+    //PLEX
+    switch (priv->tune) {
+    case TUNE_LOW_DELAY:
+        // No reordering, and each packet is returned as soon as it is coded.
+        avctx->max_b_frames = 0;
+        ctx->async_depth    = 1;
+        break;
+    case TUNE_LADDER:
+        /* GOPs are always closed and of fixed length here, so the renditions
+         * stay aligned; AVBR would be picked for a bitrate, but it does not
+         * bound the peak rate the variant playlists advertise. */
+        if (avctx->bit_rate > 0 && ctx->explicit_rc_mode == RC_MODE_AUTO) {
+            ctx->explicit_rc_mode = RC_MODE_VBR;
+            if (avctx->rc_max_rate <= 0)
+                avctx->rc_max_rate = 2 * avctx->bit_rate;
+        }
+        break;
+    }
+    //PLEX
+
     ret = ff_vaapi_encode_init(avctx);
     if (ret < 0)
         return ret;
@@ -908,6 +937,17 @@ static const AVOption vaapi_encode_av1_options[] = {
     { "tile_groups", "Number of tile groups for encoding",
       OFFSET(tile_groups), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, AV1_MAX_TILE_ROWS * AV1_MAX_TILE_COLS, FLAGS },
 
+    //PLEX
+    { "tune", "Tune the GOP and rate control for a use case",
+      OFFSET(tune), AV_OPT_TYPE_INT, { .i64 = TUNE_DEFAULT }, 0, TUNE_LADDER, FLAGS, "tune" },
+    { "default",   "Use the other options as given",
+      0, AV_OPT_TYPE_CONST, { .i64 = TUNE_DEFAULT },   0, 0, FLAGS, "tune" },
+    { "low_delay", "No B-frames and no frames buffered ahead (overrides bf and async_depth)",
+      0, AV_OPT_TYPE_CONST, { .i64 = TUNE_LOW_DELAY }, 0, 0, FLAGS, "tune" },
+    { "ladder",    "Peak-limited VBR for ABR renditions (maxrate defaults to twice the bitrate)",
+      0, AV_OPT_TYPE_CONST, { .i64 = TUNE_LADDER },    0, 0, FLAGS, "tune" },
+    //PLEX
+
     { NULL },
 };
 
@@ -159,7 +159,7 @@ static int webvtt_encode_frame(AVCodecContext *avctx,
                                unsigned char *buf, int bufsize, const AVSubtitle *sub)
 {
     WebVTTContext *s = avctx->priv_data;
-    ASSDialog *dialog;
+    const ASSDialog *dialog;
     int i;
 
     av_bprint_clear(&s->buffer);
@@ -172,12 +172,11 @@ static int webvtt_encode_frame(AVCodecContext *avctx,
             return AVERROR(EINVAL);
         }
 
-        dialog = ff_ass_split_dialog(s->ass_ctx, ass);
+        dialog = ff_ass_split_dialog_view(s->ass_ctx, ass);
         if (!dialog)
             return AVERROR(ENOMEM);
         webvtt_style_apply(s, dialog->style);
         ff_ass_split_override_codes(&webvtt_callbacks, s, dialog->text);
-        ff_ass_free_dialog(&dialog);
     }
 
     if (!av_bprint_is_complete(&s->buffer))
@@ -21,6 +21,17 @@
 
 %include "libavutil/x86/x86util.asm"
 
+SECTION_RODATA
+
+pd_8:            times 4 dd 8
+pd_max23:        times 4 dd 8388607
+pd_min23:        times 4 dd -8388608
+pq_65536:        times 2 dq 65536
+ps_bank_sign_a:  dd 0, 0x80000000, 0, 0
+ps_bank_sign_b:  dd 0, 0x80000000, 0, 0x80000000
+ps_bank_sign_c:  times 4 dd 0x80000000
+ps_bank_sign_d:  dd 0x80000000, 0, 0, 0
+
 SECTION .text
 
 %define sizeof_float 4
@@ -286,3 +297,171 @@ LFE_FIR1_FLOAT
 INIT_XMM avx
 LFE_FIR1_FLOAT
 %endif
+
+%if ARCH_X86_64
+;-----------------------------------------------------------------------------
+; void decode_hf(int32_t **dst, const int32_t *vq_index,
+;                const int8_t hf_vq[1024][32], int32_t scale_factors[32][2],
+;                ptrdiff_t sb_start, ptrdiff_t sb_end,
+;                ptrdiff_t ofs, ptrdiff_t len)
+;-----------------------------------------------------------------------------
+INIT_XMM sse4
+cglobal decode_hf, 8, 11, 6, dst, vq, hfvq, sf, start, end, ofs, len, coeff, out, cnt
+    cmp        startq, endq
+    jge .end
+    shl          ofsq, 2
+    mova           m3, [pd_max23]
+    mova           m4, [pd_min23]
+    mova           m5, [pd_8]
+.loop_sb:
+    mov          cntd, [vqq+startq*4]
+    shl          cntq, 5
+    lea        coeffq, [hfvqq+cntq]
+    movd           m0, [sfq+startq*8]
+    pshufd         m0, m0, 0
+    mov          outq, [dstq+startq*8]
+    add          outq, ofsq
+    xor          cntq, cntq
+.loop:
+    pmovsxbd       m1, [coeffq+cntq]
+    pmovsxbd       m2, [coeffq+cntq+4]
+    pmulld         m1, m0
+    pmulld         m2, m0
+    paddd          m1, m5
+    paddd          m2, m5
+    psrad          m1, 4
+    psrad          m2, 4
+    pminsd         m1, m3
+    pminsd         m2, m3
+    pmaxsd         m1, m4
+    pmaxsd         m2, m4
+    movu [outq+cntq*4   ], m1
+    movu [outq+cntq*4+16], m2
+    add          cntq, 8
+    cmp          cntq, lenq
+    jl .loop
+    inc        startq
+    cmp        startq, endq
+    jl .loop_sb
+.end:
+    RET
+
+;-----------------------------------------------------------------------------
+; void decode_joint(int32_t **dst, int32_t **src,
+;                   const int32_t *scale_factors,
+;                   ptrdiff_t sb_start, ptrdiff_t sb_end,
+;                   ptrdiff_t ofs, ptrdiff_t len)
+;-----------------------------------------------------------------------------
+cglobal decode_joint, 7, 10, 6, dst, src, sf, start, end, ofs, len, out, in, cnt
+    cmp        startq, endq
+    jge .end
+    shl          ofsq, 2
+    mova           m3, [pd_max23]
+    mova           m4, [pd_min23]
+    mova           m5, [pq_65536]
+.loop_sb:
+    movd           m0, [sfq+startq*4]
+    pshufd         m0, m0, 0
+    mov          outq, [dstq+startq*8]
+    mov           inq, [srcq+startq*8]
+    add          outq, ofsq
+    add           inq, ofsq
+    xor          cntq, cntq
+.loop:
+    ; mul17() on the even and odd lanes, the results end up in the low
+    ; dwords of m1 and the high dwords of m2
+    movu           m1, [inq+cntq*4]
+    pshufd         m2, m1, q3311
+    pmuldq         m1, m0
+    pmuldq         m2, m0
+    paddq          m1, m5
+    paddq          m2, m5
+    psrlq          m1, 17
+    psllq          m2, 15
+    pblendw        m1, m2, 0xcc
+    pminsd         m1, m3
+    pmaxsd         m1, m4
+    movu [outq+cntq*4], m1
+    add          cntq, 4
+    cmp          cntq, lenq
+    jl .loop
+    inc        startq
+    cmp        startq, endq
+    jl .loop_sb
+.end:
+    RET
+
+;-----------------------------------------------------------------------------
+; void lbr_bank(float output[32][4], float **input,
+;               const float *coeff, ptrdiff_t ofs, ptrdiff_t len)
+;-----------------------------------------------------------------------------
+INIT_XMM sse2
+cglobal lbr_bank, 5, 8, 14, output, input, coeff, ofs, len, src, cnt, out
+    shl          ofsq, 2
+    movu           m8, [coeffq]             ; SW0 SW1 SW2 SW3
+    shufps         m9, m8, m8, q0123        ; SW3 SW2 SW1 SW0
+    movu           m0, [coeffq+16]          ; C1  C2  C3  C4
+    shufps        m10, m0, m0, q2013
+    shufps        m11, m0, m0, q1230
+    shufps        m12, m0, m0, q0321
+    shufps        m13, m0, m0, q3102
+    xorps         m10, [ps_bank_sign_a]
+    xorps         m11, [ps_bank_sign_b]
+    xorps         m12, [ps_bank_sign_c]
+    xorps         m13, [ps_bank_sign_d]
+    mov          outq, outputq
+    xor          cntq, cntq
+
+    ; short window and 8 point forward MDCT
+.loop:
+    mov          srcq, [inputq+cntq*8]
+    movu           m0, [srcq+ofsq-16]
+    movu           m1, [srcq+ofsq]
+    mulps          m0, m8
+    mulps          m1, m9
+    shufps         m2, m0, m0, q0123
+    shufps         m3, m1, m1, q0123
+    subps          m0, m2                   ; a b -b -a
+    addps          m1, m3                   ; d c  c  d
+    shufps         m2, m0, m0, q0000
+    shufps         m3, m0, m0, q1111
+    shufps         m4, m1, m1, q1111
+    shufps         m5, m1, m1, q0000
+    mulps          m2, m10
+    mulps          m3, m11
+    mulps          m4, m12
+    mulps          m5, m13
+    addps          m2, m3
+    addps          m4, m5
+    addps          m2, m4
+    mova       [outq], m2
+    add          outq, 16
+    inc          cntq
+    cmp          cntq, lenq
+    jl .loop
+
+    ; aliasing cancellation for high frequencies, rows 12 to len - 1
+    sub          lenq, 13
+    jle .end
+    movq           m6, [coeffq+32]
+    shufps         m6, m6, q0101            ; AL2 AL1 AL2 AL1
+    lea          outq, [outputq+12*16]
+.loop_alias:
+    movq           m0, [outq+8]             ; output[i  ][2..3]
+    movq           m1, [outq+16]            ; output[i+1][0..1]
+    shufps         m1, m1, q1001
+    mulps          m2, m0, m6
+    mulps          m3, m1, m6
+    subps          m4, m3, m2
+    addps          m3, m2
+    addps          m0, m4
+    subps          m1, m3
+    shufps         m1, m1, q1001
+    movq      [outq+8], m0
+    movq     [outq+16], m1
+    add          outq, 16
+    dec          lenq
+    jg .loop_alias
+.end:
+    RET
+%endif ; ARCH_X86_64
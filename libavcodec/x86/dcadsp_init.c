@@ -32,6 +32,17 @@ LFE_FIR_FLOAT_FUNC(sse3)
 LFE_FIR_FLOAT_FUNC(avx)
 LFE_FIR_FLOAT_FUNC(fma3)
 
+void ff_decode_hf_sse4(int32_t **dst, const int32_t *vq_index,
+                       const int8_t hf_vq[1024][32], int32_t scale_factors[32][2],
+                       ptrdiff_t sb_start, ptrdiff_t sb_end,
+                       ptrdiff_t ofs, ptrdiff_t len);
+void ff_decode_joint_sse4(int32_t **dst, int32_t **src,
+                          const int32_t *scale_factors,
+                          ptrdiff_t sb_start, ptrdiff_t sb_end,
+                          ptrdiff_t ofs, ptrdiff_t len);
+void ff_lbr_bank_sse2(float output[32][4], float **input,
+                      const float *coeff, ptrdiff_t ofs, ptrdiff_t len);
+
 av_cold void ff_dcadsp_init_x86(DCADSPContext *s)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -46,4 +57,13 @@ av_cold void ff_dcadsp_init_x86(DCADSPContext *s)
     }
     if (EXTERNAL_FMA3(cpu_flags))
         s->lfe_fir_float[0] = ff_lfe_fir0_float_fma3;
+
+#if ARCH_X86_64
+    if (EXTERNAL_SSE2(cpu_flags))
+        s->lbr_bank = ff_lbr_bank_sse2;
+    if (EXTERNAL_SSE4(cpu_flags)) {
+        s->decode_hf    = ff_decode_hf_sse4;
+        s->decode_joint = ff_decode_joint_sse4;
+    }
+#endif
 }
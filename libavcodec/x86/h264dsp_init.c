@@ -23,6 +23,7 @@
 #include "libavutil/x86/asm.h"
 #include "libavutil/x86/cpu.h"
 #include "libavcodec/h264dsp.h"
+#include "startcode.h" //PLEX
 
 /***********************************/
 /* IDCT */
@@ -196,6 +197,13 @@ av_cold void ff_h264dsp_init_x86(H264DSPContext *c, const int bit_depth,
     if (EXTERNAL_MMXEXT(cpu_flags) && chroma_format_idc <= 1)
         c->h264_loop_filter_strength = ff_h264_loop_filter_strength_mmxext;
 
+    //PLEX
+    if (EXTERNAL_SSE2(cpu_flags))
+        c->startcode_find_candidate = ff_startcode_find_candidate_sse2;
+    if (EXTERNAL_AVX2_FAST(cpu_flags))
+        c->startcode_find_candidate = ff_startcode_find_candidate_avx2;
+    //PLEX
+
     if (bit_depth == 8) {
         if (EXTERNAL_MMX(cpu_flags)) {
             if (chroma_format_idc <= 1) {
@@ -0,0 +1,357 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Loudness, true peak, silence and chroma fingerprint analysis in one pass.
+ *
+ * The loudness uses the shared EBU R128 measurement of ebur128.c. The true
+ * peak is measured on a 4x (2x above 96 kHz) oversampled signal, with the
+ * windowed sinc interpolator of libebur128. The chroma is accumulated from
+ * the spectrum of the mono downmix, one transform per non-overlapping window.
+ */
+
+#include <float.h>
+
+#include "libavutil/opt.h"
+#include "libavutil/tx.h"
+
+#include "audio.h"
+#include "avfilter.h"
+#include "ebur128.h"
+#include "internal.h"
+
+#define TP_TAPS      12     ///< interpolator taps per phase
+#define CHROMA_BINS  12
+#define CHROMA_FMIN  220.
+#define CHROMA_FMAX  5000.
+
+typedef struct AAnalyzeContext {
+    const AVClass *class;
+
+    int64_t interval;
+    double noise;
+    int64_t min_silence;
+
+    int channels;
+    FFEBUR128State *r128;
+
+    int tp_factor;
+    double *tp_coeffs;      ///< [tp_factor][TP_TAPS], reversed for the history order
+    double *tp_history;     ///< [channels][2 * TP_TAPS], each window stored twice
+    int tp_pos;
+    double peak;            ///< linear true peak so far
+
+    int64_t silence_start;  ///< first sample of the current silence, or AV_NOPTS_VALUE
+    int silence_reported;
+    int64_t min_silence_samples;
+
+    AVTXContext *tx;
+    av_tx_fn tx_fn;
+    int fft_size;
+    int fft_fill;
+    float *fft_in;
+    AVComplexFloat *fft_out;
+    float *window;
+    int8_t *bin_class;
+    double chroma[CHROMA_BINS];
+    double prev_chroma[CHROMA_BINS];
+
+    int64_t interval_samples;
+    int64_t next_report;
+    int64_t nb_samples;     ///< samples analysed so far
+} AAnalyzeContext;
+
+#define OFFSET(x) offsetof(AAnalyzeContext, x)
+#define FLAGS AV_OPT_FLAG_AUDIO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption aanalyze_options[] = {
+    { "interval", "set the reporting interval",       OFFSET(interval),    AV_OPT_TYPE_DURATION, {.i64=1000000}, 100000, 60000000, FLAGS },
+    { "noise",    "set the silence noise tolerance",  OFFSET(noise),       AV_OPT_TYPE_DOUBLE,   {.dbl=0.001},   0,      1,        FLAGS },
+    { "duration", "set the minimum silence duration", OFFSET(min_silence), AV_OPT_TYPE_DURATION, {.i64=2000000}, 0,      INT64_MAX, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(aanalyze);
+
+static int init_true_peak(AAnalyzeContext *s, int sample_rate)
+{
+    const int taps = TP_TAPS;
+    int total;
+
+    s->tp_factor = sample_rate < 96000 ? 4 : sample_rate < 192000 ? 2 : 1;
+    total = s->tp_factor * taps;
+
+    s->tp_coeffs  = av_calloc(total, sizeof(*s->tp_coeffs));
+    s->tp_history = av_calloc(2 * taps * s->channels, sizeof(*s->tp_history));
+    if (!s->tp_coeffs || !s->tp_history)
+        return AVERROR(ENOMEM);
+
+    for (int j = 0; j < total; j++) {
+        const double m = j - (total - 1) / 2.;
+        double c = fabs(m) > 1e-6 ? sin(m * M_PI / s->tp_factor) / (m * M_PI / s->tp_factor) : 1.;
+
+        c *= 0.5 * (1. - cos(2. * M_PI * j / (total - 1)));
+        s->tp_coeffs[(j % s->tp_factor) * taps + (taps - 1 - j / s->tp_factor)] = c;
+    }
+    return 0;
+}
+
+static int init_chroma(AAnalyzeContext *s, int sample_rate)
+{
+    const float scale = 1.f;
+    int ret;
+
+    s->fft_size  = 1 << av_log2(FFMAX(sample_rate / 10, 256));
+    s->fft_in    = av_calloc(s->fft_size + 2, sizeof(*s->fft_in));
+    s->fft_out   = av_calloc(s->fft_size / 2 + 1, sizeof(*s->fft_out));
+    s->window    = av_calloc(s->fft_size, sizeof(*s->window));
+    s->bin_class = av_calloc(s->fft_size / 2 + 1, sizeof(*s->bin_class));
+    if (!s->fft_in || !s->fft_out || !s->window || !s->bin_class)
+        return AVERROR(ENOMEM);
+
+    ret = av_tx_init(&s->tx, &s->tx_fn, AV_TX_FLOAT_RDFT, 0, s->fft_size, &scale, 0);
+    if (ret < 0)
+        return ret;
+
+    for (int i = 0; i < s->fft_size; i++)
+        s->window[i] = 0.5f - 0.5f * cosf(2.f * M_PI * i / (s->fft_size - 1));
+
+    for (int k = 0; k <= s->fft_size / 2; k++) {
+        const double f = (double)k * sample_rate / s->fft_size;
+        s->bin_class[k] = -1;
+        if (f >= CHROMA_FMIN && f <= CHROMA_FMAX)
+            s->bin_class[k] = ((int)lrint(CHROMA_BINS * log2(f / 440.)) % CHROMA_BINS + CHROMA_BINS) % CHROMA_BINS;
+    }
+    return 0;
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AAnalyzeContext *s = ctx->priv;
+    int ret;
+
+    s->channels = inlink->ch_layout.nb_channels;
+    s->r128 = ff_ebur128_init(s->channels, inlink->sample_rate, 0,
+                              FF_EBUR128_MODE_I | FF_EBUR128_MODE_S);
+    if (!s->r128)
+        return AVERROR(ENOMEM);
+
+    if ((ret = init_true_peak(s, inlink->sample_rate)) < 0 ||
+        (ret = init_chroma(s, inlink->sample_rate)) < 0)
+        return ret;
+
+    s->silence_start       = AV_NOPTS_VALUE;
+    s->min_silence_samples = av_rescale(s->min_silence, inlink->sample_rate, AV_TIME_BASE);
+    s->interval_samples    = FFMAX(av_rescale(s->interval, inlink->sample_rate, AV_TIME_BASE), 1);
+    s->next_report         = s->interval_samples;
+    return 0;
+}
+
+static double dot(const double *a, const double *b, int len)
+{
+    double sum = 0.;
+
+    for (int i = 0; i < len; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+static void analyze_true_peak(AAnalyzeContext *s, const double *src, int nb_samples)
+{
+    const int channels = s->channels;
+    double peak = s->peak;
+
+    for (int n = 0; n < nb_samples; n++) {
+        for (int c = 0; c < channels; c++) {
+            double *hist = s->tp_history + c * 2 * TP_TAPS;
+            const double v = src[c];
+
+            hist[s->tp_pos] = hist[s->tp_pos + TP_TAPS] = v;
+            peak = FFMAX(peak, fabs(v));
+            for (int p = 0; p < s->tp_factor; p++)
+                peak = FFMAX(peak, fabs(dot(s->tp_coeffs + p * TP_TAPS,
+                                            hist + s->tp_pos + 1, TP_TAPS)));
+        }
+        if (++s->tp_pos == TP_TAPS)
+            s->tp_pos = 0;
+        src += channels;
+    }
+    s->peak = peak;
+}
+
+static void analyze_chroma_window(AAnalyzeContext *s)
+{
+    for (int i = 0; i < s->fft_size; i++)
+        s->fft_in[i] *= s->window[i];
+    s->tx_fn(s->tx, s->fft_out, s->fft_in, sizeof(float));
+
+    for (int k = 0; k <= s->fft_size / 2; k++) {
+        const AVComplexFloat v = s->fft_out[k];
+        if (s->bin_class[k] >= 0)
+            s->chroma[s->bin_class[k]] += v.re * v.re + v.im * v.im;
+    }
+    s->fft_fill = 0;
+}
+
+static void analyze_silence(AVFilterContext *ctx, AVFrame *frame,
+                            const double *src, int64_t start)
+{
+    AAnalyzeContext *s = ctx->priv;
+    const double rate = ctx->inputs[0]->sample_rate;
+    char buf[32];
+
+    for (int n = 0; n < frame->nb_samples; n++) {
+        int silent = 1;
+
+        for (int c = 0; c < s->channels && silent; c++)
+            silent = fabs(src[c]) < s->noise;
+        src += s->channels;
+
+        if (!silent) {
+            if (s->silence_reported) {
+                snprintf(buf, sizeof(buf), "%0.3f", (start + n) / rate);
+                av_dict_set(&frame->metadata, "lavfi.aanalyze.silence_end", buf, 0);
+                snprintf(buf, sizeof(buf), "%0.3f", (start + n - s->silence_start) / rate);
+                av_dict_set(&frame->metadata, "lavfi.aanalyze.silence_duration", buf, 0);
+            }
+            s->silence_start    = AV_NOPTS_VALUE;
+            s->silence_reported = 0;
+        } else if (s->silence_start == AV_NOPTS_VALUE) {
+            s->silence_start = start + n;
+        } else if (!s->silence_reported &&
+                   start + n - s->silence_start >= s->min_silence_samples) {
+            snprintf(buf, sizeof(buf), "%0.3f", s->silence_start / rate);
+            av_dict_set(&frame->metadata, "lavfi.aanalyze.silence_start", buf, 0);
+            s->silence_reported = 1;
+        }
+    }
+}
+
+static void report(AAnalyzeContext *s, AVFrame *frame)
+{
+    char chroma[CHROMA_BINS + 1], buf[32];
+    double loudness, max = 0., mean = 0.;
+    unsigned fingerprint = 0;
+
+    ff_ebur128_loudness_global(s->r128, &loudness);
+    snprintf(buf, sizeof(buf), "%0.2f", loudness);
+    av_dict_set(&frame->metadata, "lavfi.aanalyze.I", buf, 0);
+    ff_ebur128_loudness_shortterm(s->r128, &loudness);
+    snprintf(buf, sizeof(buf), "%0.2f", loudness);
+    av_dict_set(&frame->metadata, "lavfi.aanalyze.S", buf, 0);
+    snprintf(buf, sizeof(buf), "%0.2f", 20. * log10(FFMAX(s->peak, DBL_MIN)));
+    av_dict_set(&frame->metadata, "lavfi.aanalyze.true_peak", buf, 0);
+
+    for (int i = 0; i < CHROMA_BINS; i++) {
+        max   = FFMAX(max, s->chroma[i]);
+        mean += s->chroma[i] / CHROMA_BINS;
+    }
+    /* one digit per pitch class, then one bit per class above the mean and
+     * one per class rising since the previous interval */
+    for (int i = 0; i < CHROMA_BINS; i++) {
+        chroma[i] = '0' + (max > 0. ? lrint(9. * s->chroma[i] / max) : 0);
+        fingerprint |= (s->chroma[i] > mean) << i;
+        fingerprint |= (s->chroma[i] > s->prev_chroma[i]) << (i + CHROMA_BINS);
+    }
+    chroma[CHROMA_BINS] = 0;
+    av_dict_set(&frame->metadata, "lavfi.aanalyze.chroma", chroma, 0);
+    snprintf(buf, sizeof(buf), "%06x", fingerprint);
+    av_dict_set(&frame->metadata, "lavfi.aanalyze.fingerprint", buf, 0);
+
+    memcpy(s->prev_chroma, s->chroma, sizeof(s->chroma));
+    memset(s->chroma, 0, sizeof(s->chroma));
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AAnalyzeContext *s = ctx->priv;
+    const double *src = (const double *)frame->data[0];
+    const float scale = 1.f / s->channels;
+    int64_t start = s->nb_samples;
+
+    if (frame->pts != AV_NOPTS_VALUE)
+        start = av_rescale_q(frame->pts, inlink->time_base, av_make_q(1, inlink->sample_rate));
+
+    ff_ebur128_add_frames_double(s->r128, src, frame->nb_samples);
+    analyze_true_peak(s, src, frame->nb_samples);
+    analyze_silence(ctx, frame, src, start);
+
+    for (int n = 0; n < frame->nb_samples; n++) {
+        double sum = 0.;
+
+        for (int c = 0; c < s->channels; c++)
+            sum += src[n * s->channels + c];
+        s->fft_in[s->fft_fill] = sum * scale;
+        if (++s->fft_fill == s->fft_size)
+            analyze_chroma_window(s);
+    }
+
+    s->nb_samples += frame->nb_samples;
+    if (s->nb_samples >= s->next_report) {
+        report(s, frame);
+        s->next_report += s->interval_samples * ((s->nb_samples - s->next_report) / s->interval_samples + 1);
+    }
+
+    return ff_filter_frame(ctx->outputs[0], frame);
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    AAnalyzeContext *s = ctx->priv;
+
+    if (s->r128) {
+        double loudness;
+
+        ff_ebur128_loudness_global(s->r128, &loudness);
+        av_log(ctx, AV_LOG_INFO, "Integrated loudness: %.1f LUFS, true peak: %.1f dBTP\n",
+               loudness, 20. * log10(FFMAX(s->peak, DBL_MIN)));
+        ff_ebur128_destroy(&s->r128);
+    }
+
+    av_tx_uninit(&s->tx);
+    av_freep(&s->tp_coeffs);
+    av_freep(&s->tp_history);
+    av_freep(&s->fft_in);
+    av_freep(&s->fft_out);
+    av_freep(&s->window);
+    av_freep(&s->bin_class);
+}
+
+static const AVFilterPad aanalyze_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_AUDIO,
+        .filter_frame = filter_frame,
+        .config_props = config_input,
+    },
+};
+
+const AVFilter ff_af_aanalyze = {
+    .name          = "aanalyze",
+    .description   = NULL_IF_CONFIG_SMALL("Measure loudness, true peak, silence and a chroma fingerprint in one pass."),
+    .priv_size     = sizeof(AAnalyzeContext),
+    .priv_class    = &aanalyze_class,
+    .uninit        = uninit,
+    .flags         = AVFILTER_FLAG_METADATA_ONLY,
+    FILTER_INPUTS(aanalyze_inputs),
+    FILTER_OUTPUTS(ff_audio_default_filterpad),
+    FILTER_SINGLE_SAMPLEFMT(AV_SAMPLE_FMT_DBL),
+};
@@ -46,6 +46,23 @@ typedef struct AResampleContext {
     int eof;
 } AResampleContext;
 
+//PLEX
+static const char *const comp_stats[][2] = {
+    { "comp_soft_samples",     "lavfi.aresample.comp_soft_samples"     },
+    { "comp_inserted_samples", "lavfi.aresample.comp_inserted_samples" },
+    { "comp_dropped_samples",  "lavfi.aresample.comp_dropped_samples"  },
+};
+
+static void export_comp_stats(AResampleContext *aresample, AVFrame *frame)
+{
+    for (int i = 0; i < FF_ARRAY_ELEMS(comp_stats); i++) {
+        int64_t v;
+        if (av_opt_get_int(aresample->swr, comp_stats[i][0], 0, &v) >= 0 && v)
+            av_dict_set_int(&frame->metadata, comp_stats[i][1], v, 0);
+    }
+}
+//PLEX
+
 static av_cold int preinit(AVFilterContext *ctx)
 {
     AResampleContext *aresample = ctx->priv;
@@ -228,6 +245,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     aresample->more_data = outsamplesref->nb_samples == n_out; // Indicate that there is probably more data in our buffers
 
     outsamplesref->nb_samples  = n_out;
+    export_comp_stats(aresample, outsamplesref); //PLEX
 
     ret = ff_filter_frame(outlink, outsamplesref);
     av_frame_free(&insamplesref);
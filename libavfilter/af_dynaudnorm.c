@@ -39,6 +39,7 @@
 
 #include "audio.h"
 #include "avfilter.h"
+#include "dynamicsdsp.h"
 #include "filters.h"
 #include "internal.h"
 
@@ -116,6 +117,8 @@ typedef struct DynamicAudioNormalizerContext {
 
     AVExpr *expr;
     double var_values[VAR_VARS_NB];
+
+    DynamicsDSPContext dsp;
 } DynamicAudioNormalizerContext;
 
 typedef struct ThreadData {
@@ -382,6 +385,7 @@ static int config_input(AVFilterLink *inlink)
     }
 
     init_gaussian_filter(s);
+    ff_dynamics_dsp_init(&s->dsp);
 
     s->window = ff_get_audio_buffer(ctx->outputs[0], s->frame_len * 2);
     if (!s->window)
@@ -502,16 +506,9 @@ static double minimum_filter(cqueue *q)
 
 static double gaussian_filter(DynamicAudioNormalizerContext *s, cqueue *q, cqueue *tq)
 {
-    const double *weights = s->weights;
-    double result = 0.0, tsum = 0.0;
-
-    for (int i = 0; i < cqueue_size(q); i++) {
-        double tq_item = cqueue_peek(tq, i);
-        double q_item = cqueue_peek(q, i);
-
-        tsum   += tq_item * weights[i];
-        result += tq_item * weights[i] * q_item;
-    }
+    double result;
+    const double tsum = s->dsp.weighted_sum(s->weights, tq->elements, q->elements,
+                                            cqueue_size(q), &result);
 
     if (tsum == 0.0)
         result = 1.0;
@@ -804,13 +801,9 @@ static void amplify_channel(DynamicAudioNormalizerContext *s, AVFrame *in,
 
     cqueue_dequeue(s->gain_history_smoothed[c], &current_amplification_factor);
 
-    for (int i = 0; i < frame->nb_samples && enabled && !bypass; i++) {
-        const double amplification_factor = fade(s->prev_amplification_factor[c],
-                                                 current_amplification_factor, i,
-                                                 frame->nb_samples);
-
-        dst_ptr[i] = src_ptr[i] * amplification_factor;
-    }
+    if (enabled && !bypass && frame->nb_samples > 0)
+        s->dsp.gain_ramp(dst_ptr, src_ptr, s->prev_amplification_factor[c],
+                         current_amplification_factor, frame->nb_samples);
 
     s->prev_amplification_factor[c] = current_amplification_factor;
 }
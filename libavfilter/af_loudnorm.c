@@ -20,6 +20,7 @@
 
 /* http://k.ylo.ph/2016/04/04/loudnorm.html */
 
+#include "libavutil/float_dsp.h"
 #include "libavutil/opt.h"
 #include "avfilter.h"
 #include "filters.h"
@@ -33,6 +34,7 @@ enum FrameType {
     INNER_FRAME,
     FINAL_FRAME,
     LINEAR_MODE,
+    REALTIME_MODE, //PLEX
     FRAME_NB
 };
 
@@ -95,8 +97,26 @@ typedef struct LoudNormContext {
 
     FFEBUR128State *r128_in;
     FFEBUR128State *r128_out;
+
+    //PLEX
+    int realtime;
+    int64_t lookahead;
+    AVFloatDSPContext *fdsp;
+    AVFrame *rt_frame;          ///< measured block held back as lookahead
+    double rt_frame_peak;
+    double rt_gain;             ///< linear gain at the end of the last output block
+    double rt_gain_db;          ///< smoothed gain target
+    double rt_alpha;
+    int64_t rt_samples;         ///< input samples measured so far
+    int rt_block;
+    //PLEX
 } LoudNormContext;
 
+//PLEX
+/* time constant of the realtime gain smoothing, in seconds */
+#define RT_SMOOTHING 1.0
+//PLEX
+
 #define OFFSET(x) offsetof(LoudNormContext, x)
 #define FLAGS AV_OPT_FLAG_AUDIO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
 
@@ -121,6 +141,10 @@ static const AVOption loudnorm_options[] = {
     {     "none",         0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  NONE},     0,         0,  FLAGS, "print_format" },
     {     "json",         0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  JSON},     0,         0,  FLAGS, "print_format" },
     {     "summary",      0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  SUMMARY},  0,         0,  FLAGS, "print_format" },
+    //PLEX
+    { "realtime",         "normalize in one pass with a short lookahead", OFFSET(realtime), AV_OPT_TYPE_BOOL,   {.i64 =  0},        0,         1,  FLAGS },
+    { "lookahead",        "set the lookahead of the realtime mode", OFFSET(lookahead),  AV_OPT_TYPE_DURATION, {.i64 = 100000}, 10000, 1000000, FLAGS },
+    //PLEX
     { NULL }
 };
 
@@ -408,6 +432,101 @@ static void true_peak_limiter(LoudNormContext *s, double *out, int nb_samples, i
     }
 }
 
+//PLEX
+static double realtime_target_gain(LoudNormContext *s, int sample_rate)
+{
+    double loudness, global, threshold, env_global;
+
+    /* the short-term window is only meaningful once it has filled up */
+    if (s->rt_samples < 3LL * sample_rate) {
+        if (s->rt_samples < 4LL * sample_rate / 10)
+            return s->rt_gain_db;
+        ff_ebur128_loudness_momentary(s->r128_in, &loudness);
+    } else {
+        ff_ebur128_loudness_shortterm(s->r128_in, &loudness);
+    }
+    ff_ebur128_loudness_global(s->r128_in, &global);
+    ff_ebur128_relative_threshold(s->r128_in, &threshold);
+
+    /* hold the gain over silence and quiet passages instead of boosting them */
+    if (loudness <= -70. || loudness < threshold || loudness < s->measured_thresh)
+        return s->rt_gain_db;
+
+    env_global = av_clipd(loudness - global, -s->target_lra / 2., s->target_lra / 2.);
+    return s->target_i - loudness + env_global;
+}
+
+static void realtime_apply_gain(LoudNormContext *s, double *dst, int nb_samples,
+                                double g0, double g1)
+{
+    const int channels = s->channels;
+    double step;
+
+    if (fabs(g1 - g0) < 1e-9) {
+        const int len     = nb_samples * channels;
+        const int len_dsp = len & ~7;
+
+        s->fdsp->vector_dmul_scalar(dst, dst, g1, len_dsp);
+        for (int i = len_dsp; i < len; i++)
+            dst[i] *= g1;
+        return;
+    }
+
+    step = (g1 - g0) / nb_samples;
+    for (int n = 0; n < nb_samples; n++) {
+        const double g = g0 + step * (n + 1);
+        for (int c = 0; c < channels; c++)
+            dst[c] *= g;
+        dst += channels;
+    }
+}
+
+/**
+ * Measure the next block and output the one held back before it, with the
+ * gain ramped to the current target. The gain is capped by the sample peak
+ * of both blocks, so the ramp into the held block stays below the ceiling.
+ * in is NULL at EOF.
+ */
+static int realtime_filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    LoudNormContext *s = ctx->priv;
+    AVFrame *out = s->rt_frame;
+    double out_peak = s->rt_frame_peak;
+    double gain, peak = 0.;
+
+    if (in) {
+        const double *src = (const double *)in->data[0];
+
+        for (int i = 0; i < in->nb_samples * s->channels; i++)
+            peak = FFMAX(peak, fabs(src[i]));
+
+        ff_ebur128_add_frames_double(s->r128_in, src, in->nb_samples);
+        s->rt_samples += in->nb_samples;
+        s->rt_gain_db += (realtime_target_gain(s, inlink->sample_rate) - s->rt_gain_db) * s->rt_alpha;
+    }
+
+    s->rt_frame      = in;
+    s->rt_frame_peak = peak;
+    if (!out)
+        return 0;
+
+    gain = pow(10., s->rt_gain_db / 20.) * s->offset;
+    if (gain * out_peak > s->target_tp)
+        gain = s->target_tp / out_peak;
+    if (gain * peak > s->target_tp)
+        gain = s->target_tp / peak;
+    if (s->rt_gain < 0.)
+        s->rt_gain = gain;
+
+    realtime_apply_gain(s, (double *)out->data[0], out->nb_samples, s->rt_gain, gain);
+    s->rt_gain = gain;
+    ff_ebur128_add_frames_double(s->r128_out, (const double *)out->data[0], out->nb_samples);
+
+    return ff_filter_frame(ctx->outputs[0], out);
+}
+//PLEX
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -689,7 +808,9 @@ static int activate(AVFilterContext *ctx)
     if (s->frame_type != LINEAR_MODE) {
         int nb_samples;
 
-        if (s->frame_type == FIRST_FRAME) {
+        if (s->frame_type == REALTIME_MODE) { //PLEX
+            nb_samples = s->rt_block;
+        } else if (s->frame_type == FIRST_FRAME) {
             nb_samples = frame_size(inlink->sample_rate, 3000);
         } else {
             nb_samples = frame_size(inlink->sample_rate, 100);
@@ -702,6 +823,17 @@ static int activate(AVFilterContext *ctx)
 
     if (ret < 0)
         return ret;
+    //PLEX
+    if (ret > 0 && s->frame_type == REALTIME_MODE) {
+        if ((ret = ff_inlink_make_frame_writable(inlink, &in)) < 0) {
+            av_frame_free(&in);
+            return ret;
+        }
+        ret = realtime_filter_frame(inlink, in);
+        if (ret >= 0 && ff_inlink_queued_samples(inlink) >= s->rt_block)
+            ff_filter_set_ready(ctx, 10);
+    } else
+    //PLEX
     if (ret > 0) {
         if (s->frame_type == FIRST_FRAME) {
             const int nb_samples = frame_size(inlink->sample_rate, 100);
@@ -719,6 +851,13 @@ static int activate(AVFilterContext *ctx)
         return ret;
 
     if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        //PLEX
+        if (s->frame_type == REALTIME_MODE) {
+            ret = realtime_filter_frame(inlink, NULL);
+            ff_outlink_set_status(outlink, status, pts);
+            return ret;
+        }
+        //PLEX
         ff_outlink_set_status(outlink, status, pts);
         return flush_frame(outlink);
     }
@@ -744,7 +883,7 @@ static int query_formats(AVFilterContext *ctx)
     if (ret < 0)
         return ret;
 
-    if (s->frame_type == LINEAR_MODE) {
+    if (s->frame_type == LINEAR_MODE || s->frame_type == REALTIME_MODE) { //PLEX
         return ff_set_common_all_samplerates(ctx);
     } else {
         return ff_set_common_samplerates_from_list(ctx, input_srate);
@@ -796,6 +935,19 @@ static int config_input(AVFilterLink *inlink)
     s->attack_length = frame_size(inlink->sample_rate, 10);
     s->release_length = frame_size(inlink->sample_rate, 100);
 
+    //PLEX
+    if (s->frame_type == REALTIME_MODE) {
+        s->fdsp = avpriv_float_dsp_alloc(0);
+        if (!s->fdsp)
+            return AVERROR(ENOMEM);
+        s->rt_block = frame_size(inlink->sample_rate, s->lookahead / 1000);
+        s->rt_alpha = 1. - exp(-s->rt_block / (inlink->sample_rate * RT_SMOOTHING));
+        /* start from the gain of a previous measurement to skip the warm-up */
+        s->rt_gain_db = s->measured_i != 0. ? s->target_i - s->measured_i : 0.;
+        s->rt_gain    = -1.;
+    }
+    //PLEX
+
     return 0;
 }
 
@@ -817,6 +969,11 @@ static av_cold int init(AVFilterContext *ctx)
         }
     }
 
+    //PLEX
+    if (s->realtime && s->frame_type != LINEAR_MODE)
+        s->frame_type = REALTIME_MODE;
+    //PLEX
+
     return 0;
 }
 
@@ -875,7 +1032,7 @@ static av_cold void uninit(AVFilterContext *ctx)
             20. * log10(tp_out),
             lra_out,
             thresh_out,
-            s->frame_type == LINEAR_MODE ? "linear" : "dynamic",
+            s->frame_type == LINEAR_MODE ? "linear" : s->frame_type == REALTIME_MODE ? "realtime" : "dynamic", //PLEX
             s->target_i - i_out
         );
         break;
@@ -903,7 +1060,7 @@ static av_cold void uninit(AVFilterContext *ctx)
             20. * log10(tp_out),
             lra_out,
             thresh_out,
-            s->frame_type == LINEAR_MODE ? "Linear" : "Dynamic",
+            s->frame_type == LINEAR_MODE ? "Linear" : s->frame_type == REALTIME_MODE ? "Realtime" : "Dynamic", //PLEX
             s->target_i - i_out
         );
         break;
@@ -917,6 +1074,8 @@ end:
     av_freep(&s->limiter_buf);
     av_freep(&s->prev_smp);
     av_freep(&s->buf);
+    av_frame_free(&s->rt_frame); //PLEX
+    av_freep(&s->fdsp); //PLEX
 }
 
 static const AVFilterPad avfilter_af_loudnorm_inputs[] = {
@@ -31,13 +31,17 @@
 #include "libavutil/common.h"
 #include "libavutil/opt.h"
 
+#include "libavutil/mem_internal.h"
+
 #include "audio.h"
 #include "avfilter.h"
+#include "dynamicsdsp.h"
 #include "filters.h"
 #include "formats.h"
-#include "hermite.h"
 #include "internal.h"
 
+#define BLOCK_SIZE 256
+
 typedef struct SidechainCompressContext {
     const AVClass *class;
 
@@ -50,22 +54,16 @@ typedef struct SidechainCompressContext {
     double threshold;
     double makeup;
     double mix;
-    double thres;
     double knee;
-    double knee_start;
-    double knee_stop;
-    double lin_knee_start;
-    double lin_knee_stop;
-    double adj_knee_start;
-    double adj_knee_stop;
-    double compressed_knee_start;
-    double compressed_knee_stop;
     int link;
     int detection;
     int mode;
 
     AVAudioFifo *fifo[2];
     int64_t pts;
+
+    CompressorCurve curve;
+    DynamicsDSPContext dsp;
 } SidechainCompressContext;
 
 #define OFFSET(x) offsetof(SidechainCompressContext, x)
@@ -99,66 +97,18 @@ AVFILTER_DEFINE_CLASS_EXT(sidechaincompress_acompressor,
                           "acompressor/sidechaincompress",
                           options);
 
-// A fake infinity value (because real infinity may break some hosts)
-#define FAKE_INFINITY (65536.0 * 65536.0)
-
-// Check for infinity (with appropriate-ish tolerance)
-#define IS_FAKE_INFINITY(value) (fabs(value-FAKE_INFINITY) < 1.0)
-
-static double output_gain(double lin_slope, double ratio, double thres,
-                          double knee, double knee_start, double knee_stop,
-                          double compressed_knee_start,
-                          double compressed_knee_stop,
-                          int detection, int mode)
-{
-    double slope = log(lin_slope);
-    double gain = 0.0;
-    double delta = 0.0;
-
-    if (detection)
-        slope *= 0.5;
-
-    if (IS_FAKE_INFINITY(ratio)) {
-        gain = thres;
-        delta = 0.0;
-    } else {
-        gain = (slope - thres) / ratio + thres;
-        delta = 1.0 / ratio;
-    }
-
-    if (mode) {
-        if (knee > 1.0 && slope > knee_start)
-            gain = hermite_interpolation(slope, knee_stop, knee_start,
-                                         knee_stop, compressed_knee_start,
-                                         1.0, delta);
-    } else {
-        if (knee > 1.0 && slope < knee_stop)
-            gain = hermite_interpolation(slope, knee_start, knee_stop,
-                                         knee_start, compressed_knee_stop,
-                                         1.0, delta);
-    }
-
-    return exp(gain - slope);
-}
-
 static int compressor_config_output(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     SidechainCompressContext *s = ctx->priv;
 
-    s->thres = log(s->threshold);
-    s->lin_knee_start = s->threshold / sqrt(s->knee);
-    s->lin_knee_stop = s->threshold * sqrt(s->knee);
-    s->adj_knee_start = s->lin_knee_start * s->lin_knee_start;
-    s->adj_knee_stop = s->lin_knee_stop * s->lin_knee_stop;
-    s->knee_start = log(s->lin_knee_start);
-    s->knee_stop = log(s->lin_knee_stop);
-    s->compressed_knee_start = (s->knee_start - s->thres) / s->ratio + s->thres;
-    s->compressed_knee_stop = (s->knee_stop - s->thres) / s->ratio + s->thres;
-
     s->attack_coeff = FFMIN(1., 1. / (s->attack * outlink->sample_rate / 4000.));
     s->release_coeff = FFMIN(1., 1. / (s->release * outlink->sample_rate / 4000.));
 
+    ff_compressor_curve_init(&s->curve, s->threshold, s->ratio, s->knee,
+                             s->detection, s->mode);
+    ff_dynamics_dsp_init(&s->dsp);
+
     return 0;
 }
 
@@ -167,53 +117,51 @@ static void compressor(SidechainCompressContext *s,
                        double level_in, double level_sc,
                        AVFilterLink *inlink, AVFilterLink *sclink)
 {
+    LOCAL_ALIGNED_32(float, detector, [BLOCK_SIZE]);
+    LOCAL_ALIGNED_32(float, gain, [BLOCK_SIZE]);
     const double makeup = s->makeup;
     const double mix = s->mix;
+    const int channels = inlink->ch_layout.nb_channels;
+    const int sc_channels = sclink->ch_layout.nb_channels;
     int i, c;
 
-    for (i = 0; i < nb_samples; i++) {
-        double abs_sample, gain = 1.0;
-        double detector;
-        int detected;
+    /* The envelope is a recursion over the samples, the static curve is then
+     * evaluated for a whole block at once. */
+    for (int offset = 0; offset < nb_samples; offset += BLOCK_SIZE) {
+        const int len = FFMIN(nb_samples - offset, BLOCK_SIZE);
 
-        abs_sample = fabs(scsrc[0] * level_sc);
+        for (i = 0; i < len; i++) {
+            double abs_sample = fabs(scsrc[0] * level_sc);
 
-        if (s->link == 1) {
-            for (c = 1; c < sclink->ch_layout.nb_channels; c++)
-                abs_sample = FFMAX(fabs(scsrc[c] * level_sc), abs_sample);
-        } else {
-            for (c = 1; c < sclink->ch_layout.nb_channels; c++)
-                abs_sample += fabs(scsrc[c] * level_sc);
+            if (s->link == 1) {
+                for (c = 1; c < sc_channels; c++)
+                    abs_sample = FFMAX(fabs(scsrc[c] * level_sc), abs_sample);
+            } else {
+                for (c = 1; c < sc_channels; c++)
+                    abs_sample += fabs(scsrc[c] * level_sc);
 
-            abs_sample /= sclink->ch_layout.nb_channels;
-        }
-
-        if (s->detection)
-            abs_sample *= abs_sample;
+                abs_sample /= sc_channels;
+            }
 
-        s->lin_slope += (abs_sample - s->lin_slope) * (abs_sample > s->lin_slope ? s->attack_coeff : s->release_coeff);
+            if (s->detection)
+                abs_sample *= abs_sample;
 
-        if (s->mode) {
-            detector = (s->detection ? s->adj_knee_stop : s->lin_knee_stop);
-            detected = s->lin_slope < detector;
-        } else {
-            detector = (s->detection ? s->adj_knee_start : s->lin_knee_start);
-            detected = s->lin_slope > detector;
+            s->lin_slope += (abs_sample - s->lin_slope) * (abs_sample > s->lin_slope ? s->attack_coeff : s->release_coeff);
+            detector[i] = s->lin_slope;
+            scsrc += sc_channels;
         }
 
-        if (s->lin_slope > 0.0 && detected)
-            gain = output_gain(s->lin_slope, s->ratio, s->thres, s->knee,
-                               s->knee_start, s->knee_stop,
-                               s->compressed_knee_start,
-                               s->compressed_knee_stop,
-                               s->detection, s->mode);
+        s->dsp.compressor_gain(gain, detector, len, &s->curve);
 
-        for (c = 0; c < inlink->ch_layout.nb_channels; c++)
-            dst[c] = src[c] * level_in * (gain * makeup * mix + (1. - mix));
+        for (i = 0; i < len; i++) {
+            const double g = level_in * (gain[i] * makeup * mix + (1. - mix));
 
-        src += inlink->ch_layout.nb_channels;
-        dst += inlink->ch_layout.nb_channels;
-        scsrc += sclink->ch_layout.nb_channels;
+            for (c = 0; c < channels; c++)
+                dst[c] = src[c] * g;
+
+            src += channels;
+            dst += channels;
+        }
     }
 }
 
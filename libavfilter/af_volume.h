@@ -90,6 +90,8 @@ typedef struct VolumeContext {
     int samples_align;
 } VolumeContext;
 
+void ff_volume_init(VolumeContext *vol); //PLEX
 void ff_volume_init_x86(VolumeContext *vol);
+void ff_volume_init_aarch64(VolumeContext *vol); //PLEX
 
 #endif /* AVFILTER_VOLUME_H */
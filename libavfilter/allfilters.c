@@ -19,8 +19,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+//PLEX
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/thread.h"
+//PLEX
 #include "avfilter.h"
 
+extern const AVFilter ff_af_aanalyze;
 extern const AVFilter ff_af_abench;
 extern const AVFilter ff_af_acompressor;
 extern const AVFilter ff_af_acontrast;
@@ -178,6 +185,7 @@ extern const AVFilter ff_vf_addroi;
 extern const AVFilter ff_vf_alphaextract;
 extern const AVFilter ff_vf_alphamerge;
 extern const AVFilter ff_vf_amplify;
+extern const AVFilter ff_vf_analyze;
 extern const AVFilter ff_vf_ass;
 extern const AVFilter ff_vf_atadenoise;
 extern const AVFilter ff_vf_avgblur;
@@ -247,6 +255,7 @@ extern const AVFilter ff_vf_dedot;
 extern const AVFilter ff_vf_deflate;
 extern const AVFilter ff_vf_deflicker;
 extern const AVFilter ff_vf_deinterlace_qsv;
+extern const AVFilter ff_vf_deinterlace_auto;
 extern const AVFilter ff_vf_deinterlace_vaapi;
 extern const AVFilter ff_vf_dejudder;
 extern const AVFilter ff_vf_delogo;
@@ -396,6 +405,7 @@ extern const AVFilter ff_vf_perms;
 extern const AVFilter ff_vf_perspective;
 extern const AVFilter ff_vf_phase;
 extern const AVFilter ff_vf_photosensitivity;
+extern const AVFilter ff_vf_pipeline;
 extern const AVFilter ff_vf_pixdesctest;
 extern const AVFilter ff_vf_pixelize;
 extern const AVFilter ff_vf_pixscope;
@@ -427,6 +437,7 @@ extern const AVFilter ff_vf_rotate;
 extern const AVFilter ff_vf_sab;
 extern const AVFilter ff_vf_scale;
 extern const AVFilter ff_vf_scale_cuda;
+extern const AVFilter ff_vf_scale_ladder;
 extern const AVFilter ff_vf_scale_npp;
 extern const AVFilter ff_vf_scale_qsv;
 extern const AVFilter ff_vf_scale_vaapi;
@@ -622,17 +633,50 @@ const AVFilter *av_filter_iterate(void **opaque)
     return f;
 }
 
+//PLEX
+/* filter_list indices sorted by name, ties in list order. */
+static int filter_by_name[FF_ARRAY_ELEMS(filter_list)];
+static int nb_filter_by_name;
+static AVOnce filter_by_name_once = AV_ONCE_INIT;
+
+static int filter_name_cmp(const void *a, const void *b)
+{
+    int ia = *(const int *)a, ib = *(const int *)b;
+    int ret = strcmp(filter_list[ia]->name, filter_list[ib]->name);
+
+    return ret ? ret : ia - ib;
+}
+
+static void filter_by_name_init(void)
+{
+    while (filter_list[nb_filter_by_name]) {
+        filter_by_name[nb_filter_by_name] = nb_filter_by_name;
+        nb_filter_by_name++;
+    }
+    qsort(filter_by_name, nb_filter_by_name, sizeof(*filter_by_name), filter_name_cmp);
+}
+//PLEX
+
 const AVFilter *avfilter_get_by_name(const char *name)
 {
-    const AVFilter *f = NULL;
-    void *opaque = 0;
+    int lo = 0, hi; //PLEX
 
     if (!name)
         return NULL;
 
-    while ((f = av_filter_iterate(&opaque)))
-        if (!strcmp(f->name, name))
-            return f;
+    //PLEX
+    ff_thread_once(&filter_by_name_once, filter_by_name_init);
+    hi = nb_filter_by_name;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (strcmp(filter_list[filter_by_name[mid]]->name, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < nb_filter_by_name && !strcmp(filter_list[filter_by_name[lo]]->name, name))
+        return filter_list[filter_by_name[lo]];
+    //PLEX
 
     return NULL;
 }
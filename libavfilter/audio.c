@@ -46,6 +46,7 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
     AVFrame *frame = NULL;
     int channels = link->ch_layout.nb_channels;
     int align = av_cpu_max_align();
+    int allocated;
 #if FF_API_OLD_CHANNEL_LAYOUT
 FF_DISABLE_DEPRECATION_WARNINGS
     int channel_layout_nb_channels = av_get_channel_layout_nb_channels(link->channel_layout);
@@ -54,37 +55,20 @@ FF_DISABLE_DEPRECATION_WARNINGS
 FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 
-    if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
-                                                    nb_samples, link->format, align);
-        if (!link->frame_pool)
-            return NULL;
-    } else {
-        int pool_channels = 0;
-        int pool_nb_samples = 0;
-        int pool_align = 0;
-        enum AVSampleFormat pool_format = AV_SAMPLE_FMT_NONE;
-
-        if (ff_frame_pool_get_audio_config(link->frame_pool,
-                                           &pool_channels, &pool_nb_samples,
-                                           &pool_format, &pool_align) < 0) {
-            return NULL;
-        }
-
-        if (pool_channels != channels || pool_nb_samples < nb_samples ||
-            pool_format != link->format || pool_align != align) {
-
-            ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
-                                                        nb_samples, link->format, align);
-            if (!link->frame_pool)
-                return NULL;
-        }
-    }
+    //PLEX: pools are shared by the links with the same configuration
+    if (ff_frame_pool_audio_reinit((FFFramePool **)&link->frame_pool, av_buffer_allocz,
+                                   channels, nb_samples, link->format, align) < 0)
+        return NULL;
 
-    frame = ff_frame_pool_get(link->frame_pool);
+    frame = ff_frame_pool_get2(link->frame_pool, &allocated);
     if (!frame)
         return NULL;
+    link->frame_pool_frames++;
+    link->frame_pool_allocs += allocated;
+    if (allocated) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+            link->src->internal->profile_bytes += frame->buf[i]->size;
+    }
 
     frame->nb_samples = nb_samples;
 #if FF_API_OLD_CHANNEL_LAYOUT
@@ -19,6 +19,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
@@ -29,10 +34,13 @@
 #include "libavutil/frame.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/internal.h"
+#include "libavutil/mem_internal.h" //PLEX
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
+#include "libavutil/tracepoint.h" //PLEX
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -196,7 +204,7 @@ void avfilter_link_free(AVFilterLink **link)
         return;
 
     ff_framequeue_free(&(*link)->fifo);
-    ff_frame_pool_uninit((FFFramePool**)&(*link)->frame_pool);
+    ff_frame_pool_release((FFFramePool**)&(*link)->frame_pool); //PLEX
     av_channel_layout_uninit(&(*link)->ch_layout);
 
     av_freep(link);
@@ -885,8 +893,11 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
         ctx->thread_type = 0;
     }
 
-    if (ctx->filter->init)
+    if (ctx->filter->init) {
+        int tag = avpriv_mem_tag_push(AV_MEM_TAG_FILTER); //PLEX
         ret = ctx->filter->init(ctx);
+        avpriv_mem_tag_pop(tag); //PLEX
+    }
     if (ret < 0)
         return ret;
 
@@ -960,6 +971,7 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
             goto fail;
     }
 
+    FF_TRACE2(filter_frame_in, dstctx->name, frame->pts); //PLEX
     ff_inlink_process_commands(link, frame);
     dstctx->is_disabled = !ff_inlink_evaluate_timeline_at_frame(link, frame);
 
@@ -1016,6 +1028,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
 #endif
     }
 
+    FF_TRACE2(filter_frame_out, link->src->name, frame->pts); //PLEX
     link->frame_blocked_in = link->frame_wanted_out = 0;
     link->frame_count_in++;
     link->sample_count_in += frame->nb_samples;
@@ -1329,16 +1342,67 @@ static int ff_filter_activate_default(AVFilterContext *filter)
      [buffersrc1][testsrc1][buffersrc2][testsrc2]concat=v=2).
  */
 
+//PLEX
+static int64_t thread_cpu_time(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
+int avfilter_get_profile(const AVFilterContext *ctx, AVFilterProfile *profile)
+{
+    const AVFilterInternal *fi = ctx->internal;
+
+    memset(profile, 0, sizeof(*profile));
+    profile->wall_time   = fi->profile_wall;
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    profile->cpu_time    = fi->profile_cpu;
+#else
+    profile->cpu_time    = -1;
+#endif
+    profile->activations = fi->profile_activations;
+    profile->bytes_alloc = fi->profile_bytes;
+    for (unsigned i = 0; i < ctx->nb_inputs; i++)
+        if (ctx->inputs[i])
+            profile->frames_in += ctx->inputs[i]->frame_count_out;
+    for (unsigned i = 0; i < ctx->nb_outputs; i++)
+        if (ctx->outputs[i])
+            profile->frames_out += ctx->outputs[i]->frame_count_in;
+    return 0;
+}
+//PLEX
+
 int ff_filter_activate(AVFilterContext *filter)
 {
-    int ret;
+    const int profile = filter->graph && filter->graph->profile; //PLEX
+    int64_t wall = 0, cpu = 0;
+    int ret, tag;
 
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
     filter->ready = 0;
+    //PLEX
+    if (profile) {
+        wall = av_gettime_relative();
+        cpu  = thread_cpu_time();
+    }
+    tag = avpriv_mem_tag_push(AV_MEM_TAG_FILTER);
+    //PLEX
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
+    //PLEX
+    avpriv_mem_tag_pop(tag);
+    if (profile) {
+        filter->internal->profile_wall += av_gettime_relative() - wall;
+        filter->internal->profile_cpu  += thread_cpu_time() - cpu;
+        filter->internal->profile_activations++;
+    }
+    //PLEX
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
@@ -1383,6 +1447,7 @@ int ff_inlink_check_available_samples(AVFilterLink *link, unsigned min)
 
 static void consume_update(AVFilterLink *link, const AVFrame *frame)
 {
+    FF_TRACE2(filter_frame_in, link->dst->name, frame->pts); //PLEX
     update_link_current_pts(link, frame->pts);
     ff_inlink_process_commands(link, frame);
     link->dst->is_disabled = !ff_inlink_evaluate_timeline_at_frame(link, frame);
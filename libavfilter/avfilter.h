@@ -668,6 +668,12 @@ struct AVFilterLink {
      */
     AVBufferRef *hw_frames_ctx;
 
+    /**
+     * Number of frames taken from the frame pool, and of those which needed
+     * newly allocated buffers.
+     */
+    int64_t frame_pool_frames, frame_pool_allocs; //PLEX
+
 #ifndef FF_INTERNAL_FIELDS
 
     /**
@@ -928,6 +934,12 @@ typedef struct AVFilterGraph {
     int sink_links_count;
 
     unsigned disable_auto_convert;
+
+    //PLEX
+    int format_negotiation; ///< format selection around auto-inserted conversions, Access ONLY through AVOptions
+    int shared_threads;     ///< run slice threads on the process-wide shared pool, Access ONLY through AVOptions
+    int profile;            ///< collect the cost of each filter, see avfilter_get_profile(), Access ONLY through AVOptions
+    //PLEX
 } AVFilterGraph;
 
 /**
@@ -1467,12 +1479,51 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
  * Dump a graph into a human-readable string representation.
  *
  * @param graph    the graph to dump
- * @param options  formatting options; currently ignored
+ * @param options  formatting options; "profile" lists the cost of each
+ *                 filter, most expensive first, instead of the links
  * @return  a string, or NULL in case of memory allocation failure;
  *          the string must be freed using av_free
  */
 char *avfilter_graph_dump(AVFilterGraph *graph, const char *options);
 
+//PLEX
+/**
+ * Cost of a filter instance, collected while the profile option of its graph
+ * is set.
+ */
+typedef struct AVFilterProfile {
+    int64_t wall_time;      ///< time spent running the filter, in microseconds
+    /**
+     * CPU time of the thread running the filter, in microseconds, slice
+     * threads excluded; -1 if not supported on this platform.
+     */
+    int64_t cpu_time;
+    int64_t activations;    ///< number of times the filter was run
+    int64_t frames_in;      ///< frames taken from the inputs
+    int64_t frames_out;     ///< frames sent to the outputs
+    int64_t bytes_alloc;    ///< frame buffers newly allocated for the outputs
+} AVFilterProfile;
+
+/**
+ * Get the cost of a filter instance so far.
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int avfilter_get_profile(const AVFilterContext *ctx, AVFilterProfile *profile);
+
+/**
+ * Compute the SSIM between two 8-bit planes with the code of the ssim
+ * filter, including its SIMD versions.
+ *
+ * @param score set to the mean SSIM of the planes, 1.0 meaning identical
+ * @return 0 on success, a negative AVERROR code on failure, e.g. for planes
+ *         smaller than 8x8
+ */
+int avfilter_plane_ssim(const uint8_t *main, ptrdiff_t main_stride,
+                        const uint8_t *ref, ptrdiff_t ref_stride,
+                        int w, int h, double *score);
+//PLEX
+
 /**
  * Request a frame on the oldest sink link.
  *
@@ -40,6 +40,13 @@
 #include "internal.h"
 #include "thread.h"
 
+//PLEX
+enum {
+    FORMAT_NEGOTIATION_DEFAULT,
+    FORMAT_NEGOTIATION_COST,
+};
+//PLEX
+
 #define OFFSET(x) offsetof(AVFilterGraph, x)
 #define F AV_OPT_FLAG_FILTERING_PARAM
 #define V AV_OPT_FLAG_VIDEO_PARAM
@@ -55,6 +62,16 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    //PLEX
+    { "format_negotiation", "How to pick the formats around auto-inserted conversions", OFFSET(format_negotiation), AV_OPT_TYPE_INT,
+        { .i64 = FORMAT_NEGOTIATION_DEFAULT }, 0, FORMAT_NEGOTIATION_COST, F|V, "format_negotiation" },
+        { "default", "pick the format closest to the input of each conversion", 0, AV_OPT_TYPE_CONST, { .i64 = FORMAT_NEGOTIATION_DEFAULT }, .flags = F|V, .unit = "format_negotiation" },
+        { "cost",    "pick the pair of formats with the cheapest conversion",   0, AV_OPT_TYPE_CONST, { .i64 = FORMAT_NEGOTIATION_COST    }, .flags = F|V, .unit = "format_negotiation" },
+    { "shared_threads", "Run slice threads on the process-wide shared pool", OFFSET(shared_threads), AV_OPT_TYPE_BOOL,
+        { .i64 = 0 }, 0, 1, F|V|A },
+    { "profile", "Collect the time spent in each filter", OFFSET(profile), AV_OPT_TYPE_BOOL,
+        { .i64 = 0 }, 0, 1, F|V|A },
+    //PLEX
     { NULL },
 };
 
@@ -116,11 +133,36 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
     }
 }
 
+//PLEX
+static void log_frame_pool_stats(AVFilterGraph *graph)
+{
+    int64_t frames = 0, allocs = 0;
+
+    for (int i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        for (int j = 0; j < f->nb_outputs; j++) {
+            AVFilterLink *l = f->outputs[j];
+            if (!l || !l->frame_pool_frames)
+                continue;
+            av_log(graph, AV_LOG_DEBUG, "%s:%s -> %s:%s: %"PRId64" pooled frames, %"PRId64" allocated\n",
+                   l->src->name, l->srcpad->name, l->dst->name, l->dstpad->name,
+                   l->frame_pool_frames, l->frame_pool_allocs);
+            frames += l->frame_pool_frames;
+            allocs += l->frame_pool_allocs;
+        }
+    }
+    if (frames)
+        av_log(graph, AV_LOG_VERBOSE, "Frame pools: %"PRId64" frames, %"PRId64" needing new buffers\n",
+               frames, allocs);
+}
+
 void avfilter_graph_free(AVFilterGraph **graph)
 {
     if (!*graph)
         return;
 
+    log_frame_pool_stats(*graph);
+
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
@@ -393,6 +435,74 @@ static int formats_declared(AVFilterContext *f)
     return 1;
 }
 
+//PLEX
+/* Hardware frame formats that can be mapped to another device without
+ * copying, through a device derived from the one of the source frames. */
+static const struct {
+    enum AVPixelFormat from, to;
+    const char *device;
+} hw_mappings[] = {
+    { AV_PIX_FMT_VAAPI,     AV_PIX_FMT_OPENCL,    "opencl" },
+    { AV_PIX_FMT_VAAPI,     AV_PIX_FMT_VULKAN,    "vulkan" },
+    { AV_PIX_FMT_VAAPI,     AV_PIX_FMT_DRM_PRIME, "drm"    },
+    { AV_PIX_FMT_DRM_PRIME, AV_PIX_FMT_OPENCL,    "opencl" },
+    { AV_PIX_FMT_DRM_PRIME, AV_PIX_FMT_VULKAN,    "vulkan" },
+    { AV_PIX_FMT_DRM_PRIME, AV_PIX_FMT_VAAPI,     "vaapi"  },
+    { AV_PIX_FMT_QSV,       AV_PIX_FMT_OPENCL,    "opencl" },
+    { AV_PIX_FMT_QSV,       AV_PIX_FMT_VAAPI,     "vaapi"  },
+};
+
+static int formats_contain(const AVFilterFormats *f, int format)
+{
+    for (int i = 0; i < f->nb_formats; i++)
+        if (f->formats[i] == format)
+            return 1;
+    return 0;
+}
+
+/**
+ * Find a mapping between the hardware formats produced by the source of a
+ * link and those accepted by its destination, when the source only
+ * produces hardware frames.
+ * @return index in hw_mappings or -1
+ */
+static int find_hw_mapping(const AVFilterFormats *src, const AVFilterFormats *dst)
+{
+    for (int i = 0; i < src->nb_formats; i++) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(src->formats[i]);
+        if (!desc || !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL))
+            return -1;
+    }
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(hw_mappings); i++)
+        if (formats_contain(src, hw_mappings[i].from) &&
+            formats_contain(dst, hw_mappings[i].to) &&
+            avfilter_get_by_name("hwmap"))
+            return i;
+    return -1;
+}
+
+/* Report the links where frames are copied between device and system
+ * memory, which are easy to lose in a long filter chain. */
+static void graph_log_hw_transfers(AVFilterGraph *graph, void *log_ctx)
+{
+    for (int i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        const char *name = f->filter->name;
+
+        if (strcmp(name, "hwdownload") && strcmp(name, "hwupload") &&
+            strcmp(name, "hwupload_cuda"))
+            continue;
+        if (!f->nb_inputs || !f->nb_outputs || !f->inputs[0] || !f->outputs[0])
+            continue;
+        av_log(log_ctx, AV_LOG_VERBOSE, "Filter '%s' copies %s frames to %s between '%s' and '%s'\n",
+               f->name, av_get_pix_fmt_name(f->inputs[0]->format),
+               av_get_pix_fmt_name(f->outputs[0]->format),
+               f->inputs[0]->src->name, f->outputs[0]->dst->name);
+    }
+}
+//PLEX
+
 /**
  * Perform one round of query_formats() and merging formats lists on the
  * filter graph.
@@ -474,6 +584,11 @@ static int query_formats(AVFilterGraph *graph, void *log_ctx)
                 AVFilterLink *inlink, *outlink;
                 char inst_name[30];
                 const char *opts;
+                //PLEX
+                const char *conversion_filter = neg->conversion_filter;
+                char hwmap_opts[32];
+                int map = -1;
+                //PLEX
 
                 if (graph->disable_auto_convert) {
                     av_log(log_ctx, AV_LOG_ERROR,
@@ -483,16 +598,35 @@ static int query_formats(AVFilterGraph *graph, void *log_ctx)
                     return AVERROR(EINVAL);
                 }
 
+                //PLEX
+                if (link->type == AVMEDIA_TYPE_VIDEO)
+                    map = find_hw_mapping(link->incfg.formats, link->outcfg.formats);
+                if (map >= 0)
+                    conversion_filter = "hwmap";
+                //PLEX
+
                 /* couldn't merge format lists. auto-insert conversion filter */
-                if (!(filter = avfilter_get_by_name(neg->conversion_filter))) {
+                if (!(filter = avfilter_get_by_name(conversion_filter))) {
                     av_log(log_ctx, AV_LOG_ERROR,
                            "'%s' filter not present, cannot convert formats.\n",
-                           neg->conversion_filter);
+                           conversion_filter);
                     return AVERROR(EINVAL);
                 }
                 snprintf(inst_name, sizeof(inst_name), "auto_%s_%d",
-                         neg->conversion_filter, converter_count++);
+                         conversion_filter, converter_count++);
                 opts = FF_FIELD_AT(char *, neg->conversion_opts_offset, *graph);
+                //PLEX
+                if (map >= 0) {
+                    snprintf(hwmap_opts, sizeof(hwmap_opts), "derive_device=%s",
+                             hw_mappings[map].device);
+                    opts = hwmap_opts;
+                    av_log(log_ctx, AV_LOG_VERBOSE, "Mapping %s frames to %s without copying "
+                           "between '%s' and '%s'\n",
+                           av_get_pix_fmt_name(hw_mappings[map].from),
+                           av_get_pix_fmt_name(hw_mappings[map].to),
+                           link->src->name, link->dst->name);
+                }
+                //PLEX
                 ret = avfilter_graph_create_filter(&convert, filter, inst_name, opts, NULL, graph);
                 if (ret < 0)
                     return ret;
@@ -1094,6 +1228,208 @@ static int pick_formats(AVFilterGraph *graph)
     return 0;
 }
 
+//PLEX
+#define MAX_CONVERSION_CHAIN 16
+
+static int is_converter(const AVFilterContext *f)
+{
+    return !strncmp(f->name, "auto_", 5) && f->nb_inputs == 1 && f->nb_outputs == 1 &&
+           f->inputs[0] && f->outputs[0] && f->inputs[0]->type == AVMEDIA_TYPE_VIDEO;
+}
+
+/**
+ * Estimate the cost of converting a frame between two pixel formats: the
+ * bits read and written per pixel, doubled when the conversion is more than
+ * a repacking of the same samples (which swscale handles with its unscaled,
+ * mostly SIMD paths), and dominated by any loss of information.
+ */
+static int64_t conversion_cost(enum AVPixelFormat src, enum AVPixelFormat dst)
+{
+    const AVPixFmtDescriptor *s = av_pix_fmt_desc_get(src);
+    const AVPixFmtDescriptor *d = av_pix_fmt_desc_get(dst);
+    int64_t cost;
+    int loss;
+
+    if (src == dst)
+        return 0;
+    if (!s || !d || (s->flags | d->flags) & AV_PIX_FMT_FLAG_HWACCEL)
+        return INT64_MAX;
+
+    cost = av_get_padded_bits_per_pixel(s) + av_get_padded_bits_per_pixel(d);
+    if (s->nb_components   != d->nb_components   ||
+        s->log2_chroma_w   != d->log2_chroma_w   ||
+        s->log2_chroma_h   != d->log2_chroma_h   ||
+        s->comp[0].depth   != d->comp[0].depth   ||
+        (s->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_FLOAT)) !=
+        (d->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_FLOAT)))
+        cost *= 2;
+
+    loss = av_get_pix_fmt_loss(dst, src, !!(s->flags & AV_PIX_FMT_FLAG_ALPHA));
+    if (loss & FF_LOSS_ALPHA)
+        cost += 1 << 24;
+    if (loss & (FF_LOSS_COLORSPACE | FF_LOSS_DEPTH | FF_LOSS_CHROMA))
+        cost += 1 << 20;
+    if (loss & (FF_LOSS_RESOLUTION | FF_LOSS_COLORQUANT))
+        cost += 1 << 16;
+    return cost;
+}
+
+static int next_converter(AVFilterGraph *graph, const AVFilterFormats *in,
+                          const uint8_t *visited)
+{
+    for (int i = 0; i < graph->nb_filters; i++)
+        if (!visited[i] && is_converter(graph->filters[i]) &&
+            graph->filters[i]->inputs[0]->incfg.formats == in)
+            return i;
+    return -1;
+}
+
+/**
+ * Pick the formats of a chain of conversions whose format lists are shared
+ * through the filters between them, minimizing the total conversion cost.
+ */
+static int pick_chain_formats(AVFilterGraph *graph, AVFilterContext **chain, int nb)
+{
+    int64_t *cost[MAX_CONVERSION_CHAIN + 1] = { NULL };
+    int     *prev[MAX_CONVERSION_CHAIN + 1] = { NULL };
+    AVFilterFormats *lists[MAX_CONVERSION_CHAIN + 1];
+    int64_t best = INT64_MAX;
+    int best_k = -1, ret = 0;
+
+    for (int j = 0; j < nb; j++)
+        lists[j] = chain[j]->inputs[0]->incfg.formats;
+    lists[nb] = chain[nb - 1]->outputs[0]->incfg.formats;
+
+    for (int j = 0; j <= nb; j++) {
+        cost[j] = av_malloc_array(lists[j]->nb_formats, sizeof(**cost));
+        prev[j] = av_malloc_array(lists[j]->nb_formats, sizeof(**prev));
+        if (!cost[j] || !prev[j]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+    }
+
+    for (int k = 0; k < lists[0]->nb_formats; k++)
+        cost[0][k] = 0;
+    for (int j = 1; j <= nb; j++) {
+        for (int k = 0; k < lists[j]->nb_formats; k++) {
+            cost[j][k] = INT64_MAX;
+            prev[j][k] = -1;
+            for (int l = 0; l < lists[j - 1]->nb_formats; l++) {
+                int64_t c = conversion_cost(lists[j - 1]->formats[l], lists[j]->formats[k]);
+                if (c == INT64_MAX || cost[j - 1][l] == INT64_MAX)
+                    continue;
+                if (cost[j - 1][l] + c < cost[j][k]) {
+                    cost[j][k] = cost[j - 1][l] + c;
+                    prev[j][k] = l;
+                }
+            }
+        }
+    }
+    for (int k = 0; k < lists[nb]->nb_formats; k++) {
+        if (cost[nb][k] < best) {
+            best   = cost[nb][k];
+            best_k = k;
+        }
+    }
+    if (best_k < 0)
+        goto end;
+
+    for (int j = nb; j >= 0; j--) {
+        int k = best_k;
+        if (j)
+            best_k = prev[j][k];
+        lists[j]->formats[0] = lists[j]->formats[k];
+    }
+    for (int j = 0; j < nb; j++)
+        av_log(graph, AV_LOG_DEBUG, "'%s': picking %s -> %s out of %d x %d formats\n",
+               chain[j]->name, av_get_pix_fmt_name(lists[j]->formats[0]),
+               av_get_pix_fmt_name(lists[j + 1]->formats[0]),
+               lists[j]->nb_formats, lists[j + 1]->nb_formats);
+    for (int j = 0; j <= nb; j++)
+        lists[j]->nb_formats = 1;
+    av_log(graph, AV_LOG_DEBUG, "Picked formats for %d chained conversions, cost %"PRId64"\n",
+           nb, best);
+
+end:
+    for (int j = 0; j <= nb; j++) {
+        av_freep(&cost[j]);
+        av_freep(&prev[j]);
+    }
+    return ret;
+}
+
+/**
+ * Pick the formats around the auto-inserted conversions with the lowest
+ * total cost, instead of following the preference order of the filters.
+ * Conversions only separated by filters passing their format through are
+ * considered together, so that an early conversion does not make a later
+ * one more expensive.
+ */
+static int pick_conversion_formats(AVFilterGraph *graph)
+{
+    uint8_t *visited = av_calloc(graph->nb_filters, 1);
+    int ret = 0;
+
+    if (!visited)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *chain[MAX_CONVERSION_CHAIN];
+        AVFilterContext *f = graph->filters[i];
+        int nb = 0, is_head = 1;
+
+        if (visited[i] || !is_converter(f))
+            continue;
+        for (int j = 0; j < graph->nb_filters; j++)
+            if (!visited[j] && is_converter(graph->filters[j]) &&
+                graph->filters[j]->outputs[0]->incfg.formats == f->inputs[0]->incfg.formats)
+                is_head = 0;
+        if (!is_head)
+            continue;
+
+        for (int j = i; j >= 0 && nb < MAX_CONVERSION_CHAIN;
+             j = next_converter(graph, chain[nb - 1]->outputs[0]->incfg.formats, visited)) {
+            visited[j] = 1;
+            chain[nb++] = graph->filters[j];
+        }
+        if ((ret = pick_chain_formats(graph, chain, nb)) < 0 ||
+            (ret = reduce_formats(graph)) < 0)
+            break;
+        /* the rest of a chain longer than the limit starts a new one */
+        i = -1;
+    }
+
+    av_free(visited);
+    return ret;
+}
+
+static void graph_log_conversions(AVFilterGraph *graph, void *log_ctx)
+{
+    int64_t total = 0;
+    int nb = 0;
+
+    for (int i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        int64_t cost;
+
+        if (!is_converter(f))
+            continue;
+        cost = conversion_cost(f->inputs[0]->format, f->outputs[0]->format);
+        av_log(log_ctx, AV_LOG_DEBUG, "Conversion '%s' between '%s' and '%s': %s -> %s, cost %"PRId64"\n",
+               f->name, f->inputs[0]->src->name, f->outputs[0]->dst->name,
+               av_get_pix_fmt_name(f->inputs[0]->format),
+               av_get_pix_fmt_name(f->outputs[0]->format), cost);
+        if (cost != INT64_MAX)
+            total += cost;
+        nb++;
+    }
+    if (nb)
+        av_log(log_ctx, AV_LOG_DEBUG, "%d video conversions inserted, total cost %"PRId64"\n",
+               nb, total);
+}
+//PLEX
+
 /**
  * Configure the formats of all the links in the graph.
  */
@@ -1113,6 +1449,12 @@ static int graph_config_formats(AVFilterGraph *graph, void *log_ctx)
     if ((ret = reduce_formats(graph)) < 0)
         return ret;
 
+    //PLEX
+    if (graph->format_negotiation == FORMAT_NEGOTIATION_COST &&
+        (ret = pick_conversion_formats(graph)) < 0)
+        return ret;
+    //PLEX
+
     /* for audio filters, ensure the best format, sample rate and channel layout
      * is selected */
     swap_sample_fmts(graph);
@@ -1122,6 +1464,8 @@ static int graph_config_formats(AVFilterGraph *graph, void *log_ctx)
     if ((ret = pick_formats(graph)) < 0)
         return ret;
 
+    graph_log_conversions(graph, log_ctx); //PLEX
+
     return 0;
 }
 
@@ -1181,6 +1525,10 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
 
+    //PLEX
+    graph_log_hw_transfers(graphctx, log_ctx);
+    //PLEX
+
     return 0;
 }
 
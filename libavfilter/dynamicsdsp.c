@@ -0,0 +1,163 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Block kernels shared by the dynamics filters.
+ *
+ * The loops are branch free and call no libm functions, so that the
+ * compiler can vectorize them. log and exp are approximated with a range
+ * reduction on the float exponent and short polynomials, the relative error
+ * of the compressor gain stays below 1e-5.
+ */
+
+#include <float.h>
+#include <stdint.h>
+
+#include "libavutil/attributes.h"
+#include "libavutil/common.h"
+#include "libavutil/mathematics.h"
+
+#include "dynamicsdsp.h"
+
+static av_always_inline float fast_logf(float x)
+{
+    union { float f; int32_t i; } u = { .f = x };
+    int e = ((u.i >> 23) & 0xff) - 127;
+    float m, t, t2;
+    int big;
+
+    /* x = 2^e * m, with m in [sqrt(2)/2, sqrt(2)) */
+    u.i = (u.i & 0x007fffff) | 0x3f800000;
+    m   = u.f;
+    big = m > (float)M_SQRT2;
+    m   = big ? m * 0.5f : m;
+    e  += big;
+
+    /* log(m) = 2 atanh((m - 1) / (m + 1)) */
+    t  = (m - 1.f) / (m + 1.f);
+    t2 = t * t;
+    return e * (float)M_LN2 +
+           2.f * t * (1.f + t2 * (1.f / 3 + t2 * (1.f / 5 + t2 * (1.f / 7))));
+}
+
+static av_always_inline float fast_expf(float x)
+{
+    union { float f; int32_t i; } u;
+    float r, p;
+    int n;
+
+    /* x = n log(2) + r, with |r| <= log(2) / 2 */
+    x = FFMIN(FFMAX(x, -87.f), 88.f);
+    n = (int)(x * (float)M_LOG2E + (x < 0.f ? -0.5f : 0.5f));
+    r = x - n * (float)M_LN2;
+    p = 1.f + r * (1.f + r * (1.f / 2 + r * (1.f / 6 + r * (1.f / 24 +
+                  r * (1.f / 120 + r * (1.f / 720))))));
+    u.i = (n + 127) << 23;
+    return p * u.f;
+}
+
+static void compressor_gain_c(float *gain, const float *detector, int len,
+                              const CompressorCurve *curve)
+{
+    const float scale      = curve->scale;
+    const float thres      = curve->thres;
+    const float inv_ratio  = curve->inv_ratio;
+    const float knee_start = curve->knee_start;
+    const float knee_stop  = curve->knee_stop;
+    const float x0         = curve->knee_x0;
+    const float inv_width  = curve->knee_inv_width;
+    const float c0 = curve->knee_c[0], c1 = curve->knee_c[1];
+    const float c2 = curve->knee_c[2], c3 = curve->knee_c[3];
+    const int knee   = curve->knee;
+    const int upward = curve->upward;
+
+    for (int i = 0; i < len; i++) {
+        const float d     = detector[i];
+        const float slope = fast_logf(FFMAX(d, FLT_MIN)) * scale;
+        const float t     = (slope - x0) * inv_width;
+        const float hermite = ((c3 * t + c2) * t + c1) * t + c0;
+        const int in_knee = knee & (upward ? slope > knee_start : slope < knee_stop);
+        const int active  = (d > 0.f) & (upward ? slope < knee_stop : slope > knee_start);
+        const float out   = in_knee ? hermite : (slope - thres) * inv_ratio + thres;
+        const float g     = fast_expf(out - slope);
+
+        gain[i] = active ? g : 1.f;
+    }
+}
+
+static void gain_ramp_c(double *dst, const double *src, double prev, double next,
+                        int len)
+{
+    const double step = 1.0 / len;
+
+    for (int i = 0; i < len; i++) {
+        const double f0 = 1.0 - step * (i + 1.0);
+        const double f1 = 1.0 - f0;
+
+        dst[i] = src[i] * (f0 * prev + f1 * next);
+    }
+}
+
+static double weighted_sum_c(const double *w, const double *t, const double *q,
+                             int len, double *result)
+{
+    double tsum = 0.0, sum = 0.0;
+
+    for (int i = 0; i < len; i++) {
+        tsum += t[i] * w[i];
+        sum  += t[i] * w[i] * q[i];
+    }
+    *result = sum;
+    return tsum;
+}
+
+void ff_compressor_curve_init(CompressorCurve *curve, double threshold,
+                              double ratio, double knee, int rms, int upward)
+{
+    const double thres      = log(threshold);
+    const double knee_start = log(threshold / sqrt(knee));
+    const double knee_stop  = log(threshold * sqrt(knee));
+    const double delta      = 1.0 / ratio;
+    const double x0 = upward ? knee_stop  : knee_start;
+    const double x1 = upward ? knee_start : knee_stop;
+    const double p1 = ((upward ? knee_start : knee_stop) - thres) / ratio + thres;
+    const double width = x1 - x0;
+    const double m0 = width, m1 = delta * width;
+
+    curve->scale      = rms ? 0.5f : 1.f;
+    curve->thres      = thres;
+    curve->inv_ratio  = delta;
+    curve->knee_start = knee_start;
+    curve->knee_stop  = knee_stop;
+    curve->knee       = knee > 1.0;
+    curve->upward     = !!upward;
+    curve->knee_x0    = x0;
+    curve->knee_inv_width = width != 0.0 ? 1.0 / width : 0.0;
+    curve->knee_c[0]  = x0;
+    curve->knee_c[1]  = m0;
+    curve->knee_c[2]  = -3 * x0 - 2 * m0 + 3 * p1 - m1;
+    curve->knee_c[3]  =  2 * x0 + m0 - 2 * p1 + m1;
+}
+
+av_cold void ff_dynamics_dsp_init(DynamicsDSPContext *c)
+{
+    c->compressor_gain = compressor_gain_c;
+    c->gain_ramp       = gain_ramp_c;
+    c->weighted_sum    = weighted_sum_c;
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_DYNAMICSDSP_H
+#define AVFILTER_DYNAMICSDSP_H
+
+/**
+ * Static curve of a compressor, in the natural log domain of the detector.
+ */
+typedef struct CompressorCurve {
+    float scale;            ///< detector to amplitude log scale, 0.5 for rms
+    float thres;
+    float inv_ratio;
+    float knee_start;
+    float knee_stop;
+    int   knee;             ///< whether the knee is interpolated
+    int   upward;
+    float knee_x0;          ///< start of the interpolated knee
+    float knee_inv_width;
+    float knee_c[4];        ///< cubic coefficients of the knee, constant term first
+} CompressorCurve;
+
+typedef struct DynamicsDSPContext {
+    /**
+     * Compute the gains of a compressor for len detector values, with
+     * approximated log and exp. The gain is 1 outside the compressed range.
+     */
+    void (*compressor_gain)(float *gain, const float *detector, int len,
+                            const CompressorCurve *curve);
+
+    /**
+     * dst[i] = src[i] * ((1 - f) * prev + f * next), f = (i + 1) / len
+     */
+    void (*gain_ramp)(double *dst, const double *src, double prev, double next,
+                      int len);
+
+    /**
+     * Return the sum of w[i] * t[i] and store the sum of w[i] * t[i] * q[i]
+     * in *result.
+     */
+    double (*weighted_sum)(const double *w, const double *t, const double *q,
+                           int len, double *result);
+} DynamicsDSPContext;
+
+/**
+ * Set up a compressor curve, with the knee given as amplitudes.
+ */
+void ff_compressor_curve_init(CompressorCurve *curve, double threshold,
+                              double ratio, double knee, int rms, int upward);
+
+void ff_dynamics_dsp_init(DynamicsDSPContext *c);
+
+#endif /* AVFILTER_DYNAMICSDSP_H */
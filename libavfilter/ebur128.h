@@ -165,6 +165,18 @@ void ff_ebur128_add_frames_double(FFEBUR128State * st,
  */
 int ff_ebur128_loudness_global(FFEBUR128State * st, double *out);
 
+//PLEX
+/** \brief Get momentary loudness (last 400ms) in LUFS.
+ *
+ *  @param st library state.
+ *  @param out momentary loudness in LUFS. -HUGE_VAL if result is negative
+ *             infinity.
+ *  @return
+ *    - 0 on success.
+ */
+int ff_ebur128_loudness_momentary(FFEBUR128State * st, double *out);
+//PLEX
+
 /** \brief Get short-term loudness (last 3s) in LUFS.
  *
  *  @param st library state.
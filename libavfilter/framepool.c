@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
 #include "framepool.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
@@ -26,6 +28,10 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/thread.h"
+
+/* Unused shared pools kept for their configuration to come back. */
+#define MAX_IDLE_POOLS 4
 
 struct FFFramePool {
 
@@ -46,8 +52,28 @@ struct FFFramePool {
     int linesize[4];
     AVBufferPool *pools[4];
 
+    AVBufferRef* (*alloc)(size_t size);
+    atomic_uint nb_allocated;
+
+    /* shared pools, under shared_pools_lock */
+    int shared;
+    int refcount;
+    unsigned idle_since;
+    struct FFFramePool *next;
 };
 
+static AVMutex shared_pools_lock = AV_MUTEX_INITIALIZER;
+static FFFramePool *shared_pools;
+static unsigned nb_idle_pools, idle_clock;
+
+static AVBufferRef *pool_alloc(void *opaque, size_t size)
+{
+    FFFramePool *pool = opaque;
+
+    atomic_fetch_add_explicit(&pool->nb_allocated, 1, memory_order_relaxed);
+    return pool->alloc ? pool->alloc(size) : av_buffer_alloc(size);
+}
+
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
                                       int width,
                                       int height,
@@ -64,6 +90,8 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
         return NULL;
 
     pool->type = AVMEDIA_TYPE_VIDEO;
+    pool->alloc = alloc;
+    atomic_init(&pool->nb_allocated, 0);
     pool->width = width;
     pool->height = height;
     pool->format = format;
@@ -99,7 +127,7 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
     for (i = 0; i < 4 && sizes[i]; i++) {
         if (sizes[i] > SIZE_MAX - align)
             goto fail;
-        pool->pools[i] = av_buffer_pool_init(sizes[i] + align, alloc);
+        pool->pools[i] = av_buffer_pool_init2(sizes[i] + align, pool, pool_alloc, NULL);
         if (!pool->pools[i])
             goto fail;
     }
@@ -127,6 +155,8 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
     planar = av_sample_fmt_is_planar(format);
 
     pool->type = AVMEDIA_TYPE_AUDIO;
+    pool->alloc = alloc;
+    atomic_init(&pool->nb_allocated, 0);
     pool->planes = planar ? channels : 1;
     pool->channels = channels;
     pool->nb_samples = nb_samples;
@@ -138,7 +168,7 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
     if (ret < 0)
         goto fail;
 
-    pool->pools[0] = av_buffer_pool_init(pool->linesize[0], NULL);
+    pool->pools[0] = av_buffer_pool_init2(pool->linesize[0], pool, pool_alloc, NULL);
     if (!pool->pools[0])
         goto fail;
 
@@ -189,6 +219,14 @@ int ff_frame_pool_get_audio_config(FFFramePool *pool,
 
 AVFrame *ff_frame_pool_get(FFFramePool *pool)
 {
+    return ff_frame_pool_get2(pool, NULL);
+}
+
+AVFrame *ff_frame_pool_get2(FFFramePool *pool, int *allocated)
+{
+    /* another thread allocating from a shared pool at the same time may be
+     * counted here too, which is fine for statistics */
+    unsigned nb_allocated = atomic_load_explicit(&pool->nb_allocated, memory_order_relaxed);
     int i;
     AVFrame *frame;
     const AVPixFmtDescriptor *desc;
@@ -274,6 +312,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
         av_assert0(0);
     }
 
+    if (allocated)
+        *allocated = atomic_load_explicit(&pool->nb_allocated, memory_order_relaxed) != nb_allocated;
     return frame;
 fail:
     av_frame_free(&frame);
@@ -293,3 +333,125 @@ void ff_frame_pool_uninit(FFFramePool **pool)
 
     av_freep(pool);
 }
+
+static void release_locked(FFFramePool **pool)
+{
+    FFFramePool **p, **oldest;
+
+    if (--(*pool)->refcount) {
+        *pool = NULL;
+        return;
+    }
+    (*pool)->idle_since = ++idle_clock;
+    *pool = NULL;
+
+    if (++nb_idle_pools <= MAX_IDLE_POOLS)
+        return;
+
+    oldest = NULL;
+    for (p = &shared_pools; *p; p = &(*p)->next)
+        if (!(*p)->refcount && (!oldest || (*p)->idle_since < (*oldest)->idle_since))
+            oldest = p;
+    if (oldest) {
+        FFFramePool *evicted = *oldest;
+        *oldest = evicted->next;
+        nb_idle_pools--;
+        ff_frame_pool_uninit(&evicted);
+    }
+}
+
+static FFFramePool *ref_locked(FFFramePool *pool)
+{
+    if (!pool->refcount++)
+        nb_idle_pools--;
+    return pool;
+}
+
+static void add_locked(FFFramePool *pool)
+{
+    pool->shared   = 1;
+    pool->refcount = 1;
+    pool->next     = shared_pools;
+    shared_pools   = pool;
+}
+
+int ff_frame_pool_video_reinit(FFFramePool **pool,
+                               AVBufferRef* (*alloc)(size_t size),
+                               int width,
+                               int height,
+                               enum AVPixelFormat format,
+                               int align)
+{
+    FFFramePool *p = *pool;
+
+#define VIDEO_MATCH(p) ((p)->type == AVMEDIA_TYPE_VIDEO && (p)->alloc == alloc && \
+                        (p)->width == width && (p)->height == height &&          \
+                        (p)->format == format && (p)->align == align)
+
+    if (p && VIDEO_MATCH(p))
+        return 0;
+
+    ff_frame_pool_release(pool);
+
+    ff_mutex_lock(&shared_pools_lock);
+    for (p = shared_pools; p; p = p->next)
+        if (VIDEO_MATCH(p))
+            break;
+    if (p) {
+        *pool = ref_locked(p);
+    } else if ((p = ff_frame_pool_video_init(alloc, width, height, format, align))) {
+        add_locked(p);
+        *pool = p;
+    }
+    ff_mutex_unlock(&shared_pools_lock);
+
+    return *pool ? 0 : AVERROR(ENOMEM);
+}
+
+int ff_frame_pool_audio_reinit(FFFramePool **pool,
+                               AVBufferRef* (*alloc)(size_t size),
+                               int channels,
+                               int nb_samples,
+                               enum AVSampleFormat format,
+                               int align)
+{
+    FFFramePool *p = *pool;
+
+    /* audio pools also serve frames with fewer samples */
+#define AUDIO_MATCH(p) ((p)->type == AVMEDIA_TYPE_AUDIO && (p)->alloc == alloc && \
+                        (p)->channels == channels && (p)->nb_samples >= nb_samples && \
+                        (p)->format == format && (p)->align == align)
+
+    if (p && AUDIO_MATCH(p))
+        return 0;
+
+    ff_frame_pool_release(pool);
+
+    ff_mutex_lock(&shared_pools_lock);
+    for (p = shared_pools; p; p = p->next)
+        if (AUDIO_MATCH(p) && p->nb_samples == nb_samples)
+            break;
+    if (p) {
+        *pool = ref_locked(p);
+    } else if ((p = ff_frame_pool_audio_init(alloc, channels, nb_samples, format, align))) {
+        add_locked(p);
+        *pool = p;
+    }
+    ff_mutex_unlock(&shared_pools_lock);
+
+    return *pool ? 0 : AVERROR(ENOMEM);
+}
+
+void ff_frame_pool_release(FFFramePool **pool)
+{
+    if (!*pool)
+        return;
+    if (!(*pool)->shared) {
+        ff_frame_pool_uninit(pool);
+        return;
+    }
+
+    ff_mutex_lock(&shared_pools_lock);
+    release_locked(pool);
+    ff_mutex_unlock(&shared_pools_lock);
+}
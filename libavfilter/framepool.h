@@ -115,5 +115,47 @@ int ff_frame_pool_get_audio_config(FFFramePool *pool,
  */
 AVFrame *ff_frame_pool_get(FFFramePool *pool);
 
+/**
+ * Same as ff_frame_pool_get(), and set allocated to 1 if new buffers had to
+ * be allocated for the frame, 0 otherwise.
+ */
+AVFrame *ff_frame_pool_get2(FFFramePool *pool, int *allocated);
+
+/**
+ * Make pool point to a video frame pool with the given configuration,
+ * keeping it if it has this configuration already and releasing it
+ * otherwise.
+ *
+ * Such pools are shared by all their users in the process, and the last
+ * unused ones are kept, so that their buffers are reused when the
+ * configuration comes back, e.g. when a graph is rebuilt after a change of
+ * resolution. Release them with ff_frame_pool_release().
+ *
+ * @return 0 on success, a negative AVERROR otherwise, with pool set to NULL.
+ */
+int ff_frame_pool_video_reinit(FFFramePool **pool,
+                               AVBufferRef* (*alloc)(size_t size),
+                               int width,
+                               int height,
+                               enum AVPixelFormat format,
+                               int align);
+
+/**
+ * Same as ff_frame_pool_video_reinit() for audio. A pool with more samples
+ * than requested is kept.
+ */
+int ff_frame_pool_audio_reinit(FFFramePool **pool,
+                               AVBufferRef* (*alloc)(size_t size),
+                               int channels,
+                               int nb_samples,
+                               enum AVSampleFormat format,
+                               int align);
+
+/**
+ * Release a pool obtained with ff_frame_pool_*_reinit() or
+ * ff_frame_pool_*_init(), and set it to NULL.
+ */
+void ff_frame_pool_release(FFFramePool **pool);
+
 
 #endif /* AVFILTER_FRAMEPOOL_H */
@@ -19,10 +19,12 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "libavutil/channel_layout.h"
 #include "libavutil/bprint.h"
+#include "libavutil/common.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
 #include "internal.h"
@@ -154,17 +156,64 @@ static void avfilter_graph_dump_to_buf(AVBPrint *buf, AVFilterGraph *graph)
     }
 }
 
+//PLEX
+static int cmp_wall_time(const void *a, const void *b)
+{
+    const AVFilterProfile *pa = a, *pb = b;
+    return FFDIFFSIGN(pb->wall_time, pa->wall_time);
+}
+
+static void avfilter_graph_dump_profile_to_buf(AVBPrint *buf, AVFilterGraph *graph)
+{
+    struct {
+        AVFilterProfile p; /* first, for cmp_wall_time() */
+        const AVFilterContext *filter;
+    } *rows = av_calloc(graph->nb_filters, sizeof(*rows));
+    int64_t total = 0;
+
+    if (!rows)
+        return;
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        rows[i].filter = graph->filters[i];
+        avfilter_get_profile(graph->filters[i], &rows[i].p);
+        total += rows[i].p.wall_time;
+    }
+    qsort(rows, graph->nb_filters, sizeof(*rows), cmp_wall_time);
+
+    av_bprintf(buf, "%-32s %10s %6s %10s %10s %10s %10s %10s\n", "filter",
+               "wall ms", "%", "cpu ms", "runs", "frames in", "frames out", "MiB alloc");
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        const AVFilterProfile *p = &rows[i].p;
+        char name[33];
+
+        snprintf(name, sizeof(name), "%s (%s)", rows[i].filter->name,
+                 rows[i].filter->filter->name);
+        av_bprintf(buf, "%-32s %10.1f %6.1f %10.1f %10"PRId64" %10"PRId64" %10"PRId64" %10.1f\n",
+                   name, p->wall_time / 1000.0,
+                   total ? p->wall_time * 100.0 / total : 0.0,
+                   p->cpu_time / 1000.0, p->activations,
+                   p->frames_in, p->frames_out, p->bytes_alloc / 1048576.0);
+    }
+    av_free(rows);
+}
+//PLEX
+
 char *avfilter_graph_dump(AVFilterGraph *graph, const char *options)
 {
     AVBPrint buf;
     char *dump = NULL;
+    //PLEX
+    void (*dump_to_buf)(AVBPrint *, AVFilterGraph *) =
+        options && !strcmp(options, "profile") ? avfilter_graph_dump_profile_to_buf
+                                               : avfilter_graph_dump_to_buf;
+    //PLEX
 
     av_bprint_init(&buf, 0, AV_BPRINT_SIZE_COUNT_ONLY);
-    avfilter_graph_dump_to_buf(&buf, graph);
+    dump_to_buf(&buf, graph);
     dump = av_malloc(buf.len + 1);
     if (!dump)
         return NULL;
     av_bprint_init_for_buffer(&buf, dump, buf.len + 1);
-    avfilter_graph_dump_to_buf(&buf, graph);
+    dump_to_buf(&buf, graph);
     return dump;
 }
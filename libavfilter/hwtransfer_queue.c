@@ -0,0 +1,241 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/error.h"
+#include "libavutil/hwcontext.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "hwtransfer_queue.h"
+
+#if HAVE_THREADS
+
+typedef struct TransferJob {
+    AVFrame *dst, *src;
+    int done;
+    int ret;
+} TransferJob;
+
+struct FFHWTransferQueue {
+    void *logctx;
+
+    /* ring of jobs, the oldest at head; jobs before head + nb_started run */
+    TransferJob *jobs;
+    int depth;
+    int head;
+    int nb;
+    int nb_started;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int exit;
+};
+
+static void *transfer_thread(void *arg)
+{
+    FFHWTransferQueue *q = arg;
+
+    pthread_mutex_lock(&q->lock);
+    while (1) {
+        TransferJob *job;
+
+        while (!q->exit && q->nb_started == q->nb)
+            pthread_cond_wait(&q->cond, &q->lock);
+        if (q->exit)
+            break;
+
+        job = &q->jobs[(q->head + q->nb_started++) % q->depth];
+        pthread_mutex_unlock(&q->lock);
+
+        job->ret = av_hwframe_transfer_data(job->dst, job->src, 0);
+        if (job->ret >= 0)
+            job->ret = av_frame_copy_props(job->dst, job->src);
+        av_frame_free(&job->src);
+
+        pthread_mutex_lock(&q->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return NULL;
+}
+
+int ff_hwtransfer_queue_alloc(FFHWTransferQueue **pq, void *logctx, int depth)
+{
+    FFHWTransferQueue *q;
+    int ret;
+
+    q = av_mallocz(sizeof(*q));
+    if (!q)
+        return AVERROR(ENOMEM);
+    q->logctx = logctx;
+    q->depth  = depth;
+    q->jobs   = av_calloc(depth, sizeof(*q->jobs));
+    if (!q->jobs) {
+        av_free(q);
+        return AVERROR(ENOMEM);
+    }
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    ret = pthread_create(&q->thread, NULL, transfer_thread, q);
+    if (ret) {
+        pthread_cond_destroy(&q->cond);
+        pthread_mutex_destroy(&q->lock);
+        av_free(q->jobs);
+        av_free(q);
+        return AVERROR(ret);
+    }
+
+    *pq = q;
+    return 0;
+}
+
+void ff_hwtransfer_queue_free(FFHWTransferQueue **pq)
+{
+    FFHWTransferQueue *q = *pq;
+
+    if (!q)
+        return;
+
+    pthread_mutex_lock(&q->lock);
+    q->exit = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+    pthread_join(q->thread, NULL);
+
+    for (int i = 0; i < q->nb; i++) {
+        TransferJob *job = &q->jobs[(q->head + i) % q->depth];
+        av_frame_free(&job->dst);
+        av_frame_free(&job->src);
+    }
+
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+    av_free(q->jobs);
+    av_freep(pq);
+}
+
+int ff_hwtransfer_queue_submit(FFHWTransferQueue *q, AVFrame *dst, AVFrame *src)
+{
+    TransferJob *job;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->nb == q->depth) {
+        pthread_mutex_unlock(&q->lock);
+        av_frame_free(&dst);
+        av_frame_free(&src);
+        return AVERROR_BUG;
+    }
+    job = &q->jobs[(q->head + q->nb++) % q->depth];
+    job->dst  = dst;
+    job->src  = src;
+    job->done = 0;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    return 0;
+}
+
+int ff_hwtransfer_queue_receive(FFHWTransferQueue *q, AVFrame **dst, int wait)
+{
+    TransferJob *job;
+    int ret;
+
+    pthread_mutex_lock(&q->lock);
+    job = &q->jobs[q->head];
+    while (wait && q->nb && !job->done)
+        pthread_cond_wait(&q->cond, &q->lock);
+    if (!q->nb || !job->done) {
+        pthread_mutex_unlock(&q->lock);
+        return 0;
+    }
+
+    q->head = (q->head + 1) % q->depth;
+    q->nb--;
+    q->nb_started--;
+    pthread_mutex_unlock(&q->lock);
+
+    ret = job->ret;
+    if (ret < 0) {
+        av_log(q->logctx, AV_LOG_ERROR, "Failed to transfer frame: %s.\n",
+               av_err2str(ret));
+        av_frame_free(&job->dst);
+        return ret;
+    }
+    *dst = job->dst;
+    job->dst = NULL;
+
+    return 1;
+}
+
+int ff_hwtransfer_queue_pending(FFHWTransferQueue *q)
+{
+    int nb;
+
+    pthread_mutex_lock(&q->lock);
+    nb = q->nb;
+    pthread_mutex_unlock(&q->lock);
+
+    return nb;
+}
+
+int ff_hwtransfer_queue_can_submit(FFHWTransferQueue *q)
+{
+    return ff_hwtransfer_queue_pending(q) < q->depth;
+}
+
+#else
+
+int ff_hwtransfer_queue_alloc(FFHWTransferQueue **pq, void *logctx, int depth)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_hwtransfer_queue_free(FFHWTransferQueue **pq)
+{
+}
+
+int ff_hwtransfer_queue_submit(FFHWTransferQueue *q, AVFrame *dst, AVFrame *src)
+{
+    av_frame_free(&dst);
+    av_frame_free(&src);
+    return AVERROR(ENOSYS);
+}
+
+int ff_hwtransfer_queue_receive(FFHWTransferQueue *q, AVFrame **dst, int wait)
+{
+    return 0;
+}
+
+int ff_hwtransfer_queue_pending(FFHWTransferQueue *q)
+{
+    return 0;
+}
+
+int ff_hwtransfer_queue_can_submit(FFHWTransferQueue *q)
+{
+    return 0;
+}
+
+#endif /* HAVE_THREADS */
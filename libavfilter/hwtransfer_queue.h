@@ -0,0 +1,67 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_HWTRANSFER_QUEUE_H
+#define AVFILTER_HWTRANSFER_QUEUE_H
+
+#include "libavutil/frame.h"
+
+/**
+ * Hardware frame transfers run on a worker thread, in submission order, so
+ * that the copy of one frame overlaps the processing of the previous one.
+ */
+typedef struct FFHWTransferQueue FFHWTransferQueue;
+
+/**
+ * @param depth maximum number of transfers in flight
+ * @return 0 on success, AVERROR(ENOSYS) when built without threads
+ */
+int ff_hwtransfer_queue_alloc(FFHWTransferQueue **pq, void *logctx, int depth);
+
+/**
+ * Stop the worker and free the queue with all the frames still in it.
+ */
+void ff_hwtransfer_queue_free(FFHWTransferQueue **pq);
+
+/**
+ * Queue av_hwframe_transfer_data(dst, src) followed by copying the frame
+ * properties of src to dst. Takes ownership of both frames, which must not
+ * be touched until dst is returned. The queue must not be full.
+ */
+int ff_hwtransfer_queue_submit(FFHWTransferQueue *q, AVFrame *dst, AVFrame *src);
+
+/**
+ * Get the oldest transfer once it is done.
+ *
+ * @param wait block until the oldest transfer is done instead of returning 0
+ * @return 1 if *dst was set, 0 if there is nothing to return, a negative
+ *         error code if the oldest transfer failed
+ */
+int ff_hwtransfer_queue_receive(FFHWTransferQueue *q, AVFrame **dst, int wait);
+
+/**
+ * @return the number of transfers submitted and not yet received
+ */
+int ff_hwtransfer_queue_pending(FFHWTransferQueue *q);
+
+/**
+ * @return whether another transfer can be submitted
+ */
+int ff_hwtransfer_queue_can_submit(FFHWTransferQueue *q);
+
+#endif /* AVFILTER_HWTRANSFER_QUEUE_H */
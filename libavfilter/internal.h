@@ -139,6 +139,13 @@ struct AVFilterInternal {
     // 1 when avfilter_init_*() was successfully called on this filter
     // 0 otherwise
     int initialized;
+
+    //PLEX: cost of the filter, see AVFilterProfile
+    int64_t profile_wall;
+    int64_t profile_cpu;
+    int64_t profile_activations;
+    int64_t profile_bytes;
+    //PLEX
 };
 
 static av_always_inline int ff_filter_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -101,7 +101,8 @@ kernel void weight_accum(global float *sum, global float *weight,
 
 kernel void average(__write_only image2d_t dst,
                     __read_only image2d_t src,
-                    global float *sum, global float *weight) {
+                    global float *sum, global float *weight,
+                    __read_only image2d_t prev, float t, float thresh) {
     int x = get_global_id(0);
     int y = get_global_id(1);
     int2 dim = get_image_dim(dst);
@@ -110,6 +111,14 @@ kernel void average(__write_only image2d_t dst,
     float s = sum[y * dim.x + x];
     float src_pix = read_imagef(src, sampler, (int2)(x, y)).x;
     float r = (s + src_pix * 255) / (1.0f + w) / 255.0f;
+
+    // recursive temporal filter: pull towards the previous output, less
+    // so the more they differ, so that moving areas do not smear
+    if (t > 0.0f) {
+        float prev_pix = read_imagef(prev, sampler, (int2)(x, y)).x;
+        float k = t * clamp(1.0f - fabs(r - prev_pix) * 255 / thresh, 0.0f, 1.0f);
+        r = mix(r, prev_pix, k);
+    }
     if (x < dim.x && y < dim.y)
         write_imagef(dst, (int2)(x, y), (float4)(r, 0.0f, 0.0f, 1.0f));
 }
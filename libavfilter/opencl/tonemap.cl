@@ -21,6 +21,7 @@ extern float3 lrgb2yuv(float3);
 extern float  lrgb2y(float3);
 extern float3 yuv2lrgb(float3);
 extern float3 lrgb2lrgb(float3);
+extern float  eotf_st2084(float);
 extern float  get_luma_src(float3);
 extern float  get_luma_dst(float3);
 extern float3 ootf(float3 c, float peak);
@@ -206,12 +207,85 @@ float3 map_to_dst_space_from_yuv(float3 yuv, float peak) {
     return c;
 }
 
+#ifdef DOVI_RESHAPE
+// layout must match DoviParams in vf_tonemap_opencl.c
+struct dovi_piece {
+    float poly[3];
+    float mmr_constant;
+    float mmr[3][7];
+    int   mmr_order;       // 0 for a polynomial piece
+};
+
+struct dovi_curve {
+    float pivots[9];
+    int   num_pivots;
+    struct dovi_piece pieces[8];
+};
+
+struct dovi_params {
+    struct dovi_curve curves[3];
+    float nonlinear[9];
+    float nonlinear_offset[3];
+    float linear[9];
+};
+
+// reshape one component s of the base layer, sig being all three components
+float reshape_dovi(__constant struct dovi_curve *curve, float s, float3 sig) {
+    int i = 0;
+
+    s = clamp(s, curve->pivots[0], curve->pivots[curve->num_pivots - 1]);
+    while (i < curve->num_pivots - 2 && s >= curve->pivots[i + 1])
+        i++;
+
+    __constant struct dovi_piece *p = &curve->pieces[i];
+    float r;
+    if (p->mmr_order) {
+        float3 x = sig, xp = sig;
+        float4 xx = (float4)(sig.x * sig.y, sig.x * sig.z, sig.y * sig.z,
+                             sig.x * sig.y * sig.z), xxp = xx;
+        r = p->mmr_constant;
+        for (int k = 0; k < p->mmr_order; k++) {
+            __constant float *m = p->mmr[k];
+            r += m[0] * xp.x  + m[1] * xp.y  + m[2] * xp.z +
+                 m[3] * xxp.x + m[4] * xxp.y + m[5] * xxp.z + m[6] * xxp.w;
+            xp  *= x;
+            xxp *= xx;
+        }
+    } else {
+        r = p->poly[0] + s * (p->poly[1] + s * p->poly[2]);
+    }
+    return clamp(r, 0.0f, 1.0f);
+}
+
+float3 mat3_mul(__constant float *m, float3 c) {
+    return (float3)(m[0] * c.x + m[1] * c.y + m[2] * c.z,
+                    m[3] * c.x + m[4] * c.y + m[5] * c.z,
+                    m[6] * c.x + m[7] * c.y + m[8] * c.z);
+}
+
+// map from reshaped IPT-PQ to destination space RGB
+float3 map_to_dst_space_from_dovi(float3 ipt, __constant struct dovi_params *dovi) {
+    float3 c = ipt - (float3)(dovi->nonlinear_offset[0],
+                              dovi->nonlinear_offset[1],
+                              dovi->nonlinear_offset[2]);
+    c = mat3_mul(dovi->nonlinear, c);
+    c = max(c, 0.0f);
+    c = (float3)(eotf_st2084(c.x), eotf_st2084(c.y), eotf_st2084(c.z));
+    c = mat3_mul(dovi->linear, c);
+    c = lrgb2lrgb(c);
+    return c;
+}
+#endif
+
 __kernel void tonemap(__write_only image2d_t dst1,
                       __read_only  image2d_t src1,
                       __write_only image2d_t dst2,
                       __read_only  image2d_t src2,
                       global uint *util_buf,
                       float peak
+#ifdef DOVI_RESHAPE
+                      , __constant struct dovi_params *dovi
+#endif
                       )
 {
     __local uint sum_wg;
@@ -230,10 +304,26 @@ __kernel void tonemap(__write_only image2d_t dst1,
     float y3 = read_imagef(src1, sampler, (int2)(x + 1, y + 1)).x;
     float2 uv = read_imagef(src2, sampler, (int2)(xi,     yi)).xy;
 
+#ifdef DOVI_RESHAPE
+    // chroma is reshaped against the luma at its own position
+    float3 sig_uv = (float3)(0.25f * (y0 + y1 + y2 + y3), uv.x, uv.y);
+    float u = reshape_dovi(&dovi->curves[1], uv.x, sig_uv);
+    float v = reshape_dovi(&dovi->curves[2], uv.y, sig_uv);
+    y0 = reshape_dovi(&dovi->curves[0], y0, (float3)(y0, uv.x, uv.y));
+    y1 = reshape_dovi(&dovi->curves[0], y1, (float3)(y1, uv.x, uv.y));
+    y2 = reshape_dovi(&dovi->curves[0], y2, (float3)(y2, uv.x, uv.y));
+    y3 = reshape_dovi(&dovi->curves[0], y3, (float3)(y3, uv.x, uv.y));
+
+    float3 c0 = map_to_dst_space_from_dovi((float3)(y0, u, v), dovi);
+    float3 c1 = map_to_dst_space_from_dovi((float3)(y1, u, v), dovi);
+    float3 c2 = map_to_dst_space_from_dovi((float3)(y2, u, v), dovi);
+    float3 c3 = map_to_dst_space_from_dovi((float3)(y3, u, v), dovi);
+#else
     float3 c0 = map_to_dst_space_from_yuv((float3)(y0, uv.x, uv.y), peak);
     float3 c1 = map_to_dst_space_from_yuv((float3)(y1, uv.x, uv.y), peak);
     float3 c2 = map_to_dst_space_from_yuv((float3)(y2, uv.x, uv.y), peak);
     float3 c3 = map_to_dst_space_from_yuv((float3)(y3, uv.x, uv.y), peak);
+#endif
 
     float sig0 = max(c0.x, max(c0.y, c0.z));
     float sig1 = max(c1.x, max(c1.y, c1.z));
@@ -0,0 +1,159 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program checks the dynamics kernels against the scalar
+ * formulas they replace and reports the time taken per sample.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/mem_internal.h"
+#include "libavutil/time.h"
+#include "libavfilter/dynamicsdsp.h"
+#include "libavfilter/hermite.h"
+
+#define LEN   4096
+#define RUNS  256
+
+static double ref_gain(double lin_slope, double threshold, double ratio,
+                       double knee, int rms, int upward)
+{
+    const double thres      = log(threshold);
+    const double knee_start = log(threshold / sqrt(knee));
+    const double knee_stop  = log(threshold * sqrt(knee));
+    const double delta      = 1.0 / ratio;
+    double slope, gain;
+
+    if (lin_slope <= 0.0)
+        return 1.0;
+    slope = log(lin_slope) * (rms ? 0.5 : 1.0);
+    if (upward ? slope >= knee_stop : slope <= knee_start)
+        return 1.0;
+
+    gain = (slope - thres) / ratio + thres;
+    if (upward) {
+        if (knee > 1.0 && slope > knee_start)
+            gain = hermite_interpolation(slope, knee_stop, knee_start, knee_stop,
+                                         (knee_start - thres) / ratio + thres,
+                                         1.0, delta);
+    } else {
+        if (knee > 1.0 && slope < knee_stop)
+            gain = hermite_interpolation(slope, knee_start, knee_stop, knee_start,
+                                         (knee_stop - thres) / ratio + thres,
+                                         1.0, delta);
+    }
+    return exp(gain - slope);
+}
+
+static int check_compressor(DynamicsDSPContext *c, AVLFG *lfg)
+{
+    LOCAL_ALIGNED_32(float, detector, [LEN]);
+    LOCAL_ALIGNED_32(float, gain, [LEN]);
+    double max_err = 0.0;
+    int64_t t = 0;
+
+    for (int run = 0; run < 64; run++) {
+        const double threshold = pow(10.0, -(av_lfg_get(lfg) % 50) / 20.0);
+        const double ratio     = 1.0 + av_lfg_get(lfg) % 19;
+        const double knee      = 1.0 + av_lfg_get(lfg) % 8;
+        const int rms    = run & 1;
+        const int upward = (run >> 1) & 1;
+        CompressorCurve curve;
+        int64_t start;
+
+        ff_compressor_curve_init(&curve, threshold, ratio, knee, rms, upward);
+        for (int i = 0; i < LEN; i++) {
+            /* from -120 dB to +12 dB, with some exact zeros */
+            const double db = -120.0 + 132.0 * av_lfg_get(lfg) / UINT32_MAX;
+            detector[i] = i % 97 ? pow(10.0, db / 20.0) : 0.f;
+            if (rms)
+                detector[i] *= detector[i];
+        }
+
+        start = av_gettime_relative();
+        c->compressor_gain(gain, detector, LEN, &curve);
+        t += av_gettime_relative() - start;
+
+        for (int i = 0; i < LEN; i++) {
+            const double ref = ref_gain(detector[i], threshold, ratio, knee, rms, upward);
+            const double err = fabs(gain[i] - ref) / ref;
+
+            /* the float detector may land on the other side of the knee */
+            if (err > max_err && fabs(log(detector[i]) * (rms ? 0.5 : 1.0) -
+                                      curve.knee_start) > 1e-5 &&
+                                 fabs(log(detector[i]) * (rms ? 0.5 : 1.0) -
+                                      curve.knee_stop) > 1e-5)
+                max_err = err;
+        }
+    }
+
+    printf("compressor_gain: max relative error %g, %.2f ns per sample\n",
+           max_err, t * 1000.0 / (64 * LEN));
+    return max_err > 1e-4;
+}
+
+static int check_ramp(DynamicsDSPContext *c, AVLFG *lfg)
+{
+    LOCAL_ALIGNED_32(double, src, [LEN]);
+    LOCAL_ALIGNED_32(double, dst, [LEN]);
+    const double prev = 0.25, next = 3.0;
+    double max_err = 0.0, tsum, sum, ref_tsum = 0.0, ref_sum = 0.0;
+    int64_t start, t;
+
+    for (int i = 0; i < LEN; i++)
+        src[i] = av_lfg_get(lfg) / (double)UINT32_MAX - 0.5;
+
+    start = av_gettime_relative();
+    for (int run = 0; run < RUNS; run++)
+        c->gain_ramp(dst, src, prev, next, LEN);
+    t = av_gettime_relative() - start;
+
+    for (int i = 0; i < LEN; i++) {
+        const double f = (i + 1.0) / LEN;
+        max_err = FFMAX(max_err, fabs(dst[i] - src[i] * ((1.0 - f) * prev + f * next)));
+    }
+    printf("gain_ramp: max error %g, %.2f ns per sample\n",
+           max_err, t * 1000.0 / (RUNS * LEN));
+    if (max_err > 1e-12)
+        return 1;
+
+    tsum = c->weighted_sum(src, dst, src, LEN, &sum);
+    for (int i = 0; i < LEN; i++) {
+        ref_tsum += dst[i] * src[i];
+        ref_sum  += dst[i] * src[i] * src[i];
+    }
+    printf("weighted_sum: error %g %g\n", fabs(tsum - ref_tsum), fabs(sum - ref_sum));
+    return fabs(tsum - ref_tsum) > 1e-9 || fabs(sum - ref_sum) > 1e-9;
+}
+
+int main(void)
+{
+    DynamicsDSPContext c;
+    AVLFG lfg;
+    int ret = 0;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+    ff_dynamics_dsp_init(&c);
+
+    ret |= check_compressor(&c, &lfg);
+    ret |= check_ramp(&c, &lfg);
+    return ret;
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2017 Vittorio Giovara <vittorio.giovara@gmail.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * tone curves shared by the CPU tonemap filters
+ */
+
+#include <math.h>
+
+#include "libavutil/common.h"
+#include "libavutil/hdr_dynamic_metadata.h"
+
+#include "colorspace.h"
+#include "tonemap.h"
+
+void ff_tonemap_curve_init(FFTonemapCurve *c, enum TonemapAlgorithm tonemap,
+                           double param, int use_lut)
+{
+    switch(tonemap) {
+    case TONEMAP_GAMMA:
+        if (isnan(param))
+            param = 1.8f;
+        break;
+    case TONEMAP_REINHARD:
+        if (!isnan(param))
+            param = (1.0f - param) / param;
+        break;
+    case TONEMAP_MOBIUS:
+        if (isnan(param))
+            param = 0.3f;
+        break;
+    }
+
+    if (isnan(param))
+        param = 1.0f;
+
+    c->tonemap  = tonemap;
+    c->param    = param;
+    c->use_lut  = use_lut;
+    c->lut_peak = 0.0f;
+}
+
+static float hable(float in)
+{
+    float a = 0.15f, b = 0.50f, c = 0.10f, d = 0.20f, e = 0.02f, f = 0.30f;
+    return (in * (in * a + b * c) + d * e) / (in * (in * a + b) + d * f) - e / f;
+}
+
+static float mobius(float in, float j, double peak)
+{
+    float a, b;
+
+    if (in <= j)
+        return in;
+
+    a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
+    b = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6);
+
+    return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
+}
+
+#define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
+static float tonemap_curve(const FFTonemapCurve *c, float sig, float peak)
+{
+    switch(c->tonemap) {
+    default:
+    case TONEMAP_NONE:
+        return sig;
+    case TONEMAP_LINEAR:
+        return sig * c->param / peak;
+    case TONEMAP_GAMMA:
+        return sig > 0.05f ? pow(sig / peak, 1.0f / c->param)
+                           : sig * pow(0.05f / peak, 1.0f / c->param) / 0.05f;
+    case TONEMAP_CLIP:
+        return av_clipf(sig * c->param, 0, 1.0f);
+    case TONEMAP_HABLE:
+        return hable(sig) / hable(peak);
+    case TONEMAP_REINHARD:
+        return sig / (sig + c->param) * (peak + c->param) / peak;
+    case TONEMAP_MOBIUS:
+        return mobius(sig, c->param, peak);
+    }
+}
+
+/* The table holds curve(sig) / sig for sig = peak * (i / LUT_SIZE)^2, which
+ * spends most of the entries on the dark and in-range part of the signal. */
+void ff_tonemap_curve_set_peak(FFTonemapCurve *c, float peak)
+{
+    if (!c->use_lut || c->lut_peak == peak)
+        return;
+
+    for (int i = 0; i <= TONEMAP_LUT_SIZE; i++) {
+        float x = (float)i / TONEMAP_LUT_SIZE;
+        float sig = FFMAX(peak * x * x, 1e-6f);
+        c->lut[i] = tonemap_curve(c, sig, peak) / sig;
+    }
+    c->lut_peak = peak;
+}
+
+void ff_tonemap_desat_row(float *r, float *g, float *b, const float *r_in,
+                          const float *g_in, const float *b_in, int w,
+                          float cr, float cg, float cb, float desat)
+{
+    for (int x = 0; x < w; x++) {
+        float luma = cr * r_in[x] + cg * g_in[x] + cb * b_in[x];
+        float overbright = FFMAX(luma - desat, 1e-6f) / FFMAX(luma, 1e-6f);
+        r[x] = MIX(r_in[x], luma, overbright);
+        g[x] = MIX(g_in[x], luma, overbright);
+        b[x] = MIX(b_in[x], luma, overbright);
+    }
+}
+
+/* pick the brightest component, reducing the value range as necessary
+ * to keep the entire signal in range and preventing discoloration due to
+ * out-of-bounds clipping, then apply the computed scale factor to the
+ * color, linearly to prevent discoloration */
+#define SCALE_ROW(scale)                                    \
+    for (int x = 0; x < w; x++) {                           \
+        float sig = FFMAX(r[x], g[x]), f;                   \
+        sig = FFMAX(sig, b[x]);                             \
+        sig = FFMAX(sig, 1e-6f);                            \
+        f = (scale);                                        \
+        max = FFMAX(max, sig);                              \
+        r[x] *= f;                                          \
+        g[x] *= f;                                          \
+        b[x] *= f;                                          \
+    }
+
+static float lut_scale(const FFTonemapCurve *c, float sig, float peak)
+{
+    float pos = sqrtf(sig / peak) * TONEMAP_LUT_SIZE;
+    int i = pos;
+
+    if (i >= TONEMAP_LUT_SIZE)
+        return tonemap_curve(c, sig, peak) / sig;
+    pos -= i;
+    return c->lut[i] + (c->lut[i + 1] - c->lut[i]) * pos;
+}
+
+float ff_tonemap_row(const FFTonemapCurve *c, float *r, float *g, float *b,
+                     int w, float peak)
+{
+    const float param = c->param;
+    float max = 0.0f;
+
+    if (c->use_lut && c->tonemap != TONEMAP_NONE && c->tonemap != TONEMAP_LINEAR) {
+        SCALE_ROW(lut_scale(c, sig, peak));
+        return max;
+    }
+
+    switch(c->tonemap) {
+    default:
+    case TONEMAP_NONE:
+        SCALE_ROW(1.0f);
+        break;
+    case TONEMAP_LINEAR:
+        SCALE_ROW(param / peak);
+        break;
+    case TONEMAP_CLIP:
+        SCALE_ROW(av_clipf(sig * param, 0, 1.0f) / sig);
+        break;
+    case TONEMAP_HABLE: {
+        const float hable_peak = hable(peak);
+        SCALE_ROW(hable(sig) / (hable_peak * sig));
+        break;
+    }
+    case TONEMAP_REINHARD: {
+        const float k = (peak + param) / peak;
+        SCALE_ROW(k / (sig + param));
+        break;
+    }
+    case TONEMAP_MOBIUS: {
+        const float j = param;
+        const float ma = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
+        const float mb = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6);
+        const float k = (mb * mb + 2.0f * mb * j + j * j) / (mb - ma);
+        SCALE_ROW(sig <= j ? 1.0f : k * (sig + ma) / ((sig + mb) * sig));
+        break;
+    }
+    case TONEMAP_GAMMA:
+        SCALE_ROW(tonemap_curve(c, sig, peak) / sig);
+        break;
+    }
+    return max;
+}
+
+/* HDR10+ carries the brightest component of each scene. */
+double ff_tonemap_dynamic_peak(const AVFrame *in)
+{
+    AVFrameSideData *sd = av_frame_get_side_data(in, AV_FRAME_DATA_DYNAMIC_HDR_PLUS);
+    const AVDynamicHDRPlus *hdr;
+    double maxscl = 0;
+
+    if (!sd)
+        return 0;
+    hdr = (const AVDynamicHDRPlus *)sd->data;
+    if (!hdr->num_windows)
+        return 0;
+    for (int i = 0; i < 3; i++)
+        maxscl = FFMAX(maxscl, av_q2d(hdr->params[0].maxscl[i]));
+
+    /* maxscl is a fraction of 100000 cd/m^2 */
+    return maxscl * 100000 / REFERENCE_WHITE;
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_TONEMAP_H
+#define AVFILTER_TONEMAP_H
+
+#include "libavutil/frame.h"
+
+enum TonemapAlgorithm {
+    TONEMAP_NONE,
+    TONEMAP_LINEAR,
+    TONEMAP_GAMMA,
+    TONEMAP_CLIP,
+    TONEMAP_REINHARD,
+    TONEMAP_HABLE,
+    TONEMAP_MOBIUS,
+    TONEMAP_MAX,
+};
+
+#define TONEMAP_LUT_SIZE 1024
+
+/**
+ * Tone curve on linear light RGB, where 1.0 is the reference white.
+ */
+typedef struct FFTonemapCurve {
+    enum TonemapAlgorithm tonemap;
+    double param;
+    int use_lut;
+
+    float lut[TONEMAP_LUT_SIZE + 1];
+    float lut_peak;
+} FFTonemapCurve;
+
+/**
+ * Set up the curve, a NAN param picks the default of the algorithm.
+ */
+void ff_tonemap_curve_init(FFTonemapCurve *c, enum TonemapAlgorithm tonemap,
+                           double param, int use_lut);
+
+/**
+ * Must be called before tone mapping rows with a new peak.
+ */
+void ff_tonemap_curve_set_peak(FFTonemapCurve *c, float peak);
+
+/**
+ * Pull overbright pixels towards their luma, out may alias in.
+ */
+void ff_tonemap_desat_row(float *r, float *g, float *b, const float *r_in,
+                          const float *g_in, const float *b_in, int w,
+                          float cr, float cg, float cb, float desat);
+
+/**
+ * Tone map a row in place.
+ *
+ * @return the highest signal level seen
+ */
+float ff_tonemap_row(const FFTonemapCurve *c, float *r, float *g, float *b,
+                     int w, float peak);
+
+/**
+ * @return the HDR10+ scene peak of the frame relative to the reference
+ *         white, 0 if it carries none
+ */
+double ff_tonemap_dynamic_peak(const AVFrame *in);
+
+#endif /* AVFILTER_TONEMAP_H */
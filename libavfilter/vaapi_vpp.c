@@ -598,9 +598,9 @@ int ff_vaapi_vpp_make_param_buffers(AVFilterContext *avctx,
     return 0;
 }
 
-static int vaapi_vpp_render_single_pipeline_buffer(AVFilterContext *avctx,
-                                                   VAProcPipelineParameterBuffer *params,
-                                                   VABufferID *params_id)
+static int vaapi_vpp_make_pipeline_buffer(AVFilterContext *avctx,
+                                          VAProcPipelineParameterBuffer *params,
+                                          VABufferID *params_id)
 {
     VAAPIVPPContext *ctx = avctx->priv;
     VAStatus vas;
@@ -617,13 +617,6 @@ static int vaapi_vpp_render_single_pipeline_buffer(AVFilterContext *avctx,
     }
     av_log(avctx, AV_LOG_DEBUG, "Pipeline parameter buffer is %#x.\n", *params_id);
 
-    vas = vaRenderPicture(ctx->hwctx->display, ctx->va_context, params_id, 1);
-    if (vas != VA_STATUS_SUCCESS) {
-        av_log(avctx, AV_LOG_ERROR, "Failed to render parameter buffer: "
-               "%d (%s).\n", vas, vaErrorStr(vas));
-        return AVERROR(EIO);
-    }
-
     return 0;
 }
 
@@ -653,12 +646,24 @@ int ff_vaapi_vpp_render_pictures(AVFilterContext *avctx,
         goto fail;
     }
 
+    //PLEX
+    // Submit the pipelines of all inputs in one call, so the driver can
+    // compose them in a single pass over the output surface.
     for (int i = 0; i < cout; i++) {
-        err = vaapi_vpp_render_single_pipeline_buffer(avctx, &params_list[i], &params_ids[i]);
+        err = vaapi_vpp_make_pipeline_buffer(avctx, &params_list[i], &params_ids[i]);
         if (err)
             goto fail_after_begin;
     }
 
+    vas = vaRenderPicture(ctx->hwctx->display, ctx->va_context, params_ids, cout);
+    if (vas != VA_STATUS_SUCCESS) {
+        av_log(avctx, AV_LOG_ERROR, "Failed to render parameter buffers: "
+               "%d (%s).\n", vas, vaErrorStr(vas));
+        err = AVERROR(EIO);
+        goto fail_after_begin;
+    }
+    //PLEX
+
     vas = vaEndPicture(ctx->hwctx->display, ctx->va_context);
     if (vas != VA_STATUS_SUCCESS) {
         av_log(avctx, AV_LOG_ERROR, "Failed to start picture processing: "
@@ -0,0 +1,417 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Scene change, black frame and silence analysis in a single pass.
+ *
+ * The scene score and the black ratio are computed on every step-th row of
+ * the luma plane, the scene score with the same SAD functions and formula
+ * as scdet. With the audio input enabled, video frames are only output once
+ * the audio covering their timestamp has been analysed. With export enabled,
+ * the keyframe decisions are attached as AV_FRAME_DATA_ENCODE_ANALYSIS for
+ * the encoders of all the renditions made from the output.
+ */
+
+#include "libavutil/channel_layout.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "audio.h"
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "scene_sad.h"
+#include "video.h"
+
+typedef struct AnalyzeContext {
+    const AVClass *class;
+
+    int step;
+    double pixel_black_th;
+    int audio;
+    double noise;
+    int export;
+    double scene_th;
+    int keyint;
+    int min_keyint;
+
+    int depth;
+    int shift;
+    ff_scene_sad_fn sad;
+    AVFrame *prev;
+    double prev_mafd;
+
+    int noise_i;
+    int64_t audio_end;      ///< end of the analysed audio, in samples
+    int64_t silence_start;  ///< first sample of the current silence, or AV_NOPTS_VALUE
+    int audio_eof;
+    int64_t since_key;      ///< frames since the last exported keyframe, -1 before the first
+} AnalyzeContext;
+
+#define OFFSET(x) offsetof(AnalyzeContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption analyze_options[] = {
+    { "step",   "set the luma row sampling step",   OFFSET(step),           AV_OPT_TYPE_INT,    {.i64=4},     1,   16, FLAGS },
+    { "pix_th", "set the pixel black threshold",    OFFSET(pixel_black_th), AV_OPT_TYPE_DOUBLE, {.dbl=.10},   0,    1, FLAGS },
+    { "audio",  "add an audio input to analyse",    OFFSET(audio),          AV_OPT_TYPE_BOOL,   {.i64=0},     0,    1, FLAGS },
+    { "noise",  "set the silence noise tolerance",  OFFSET(noise),          AV_OPT_TYPE_DOUBLE, {.dbl=0.001}, 0,    1, FLAGS },
+    { "export", "export the analysis to encoders",  OFFSET(export),         AV_OPT_TYPE_BOOL,   {.i64=0},     0,    1, FLAGS },
+    { "scene_th", "set the exported scene cut threshold", OFFSET(scene_th), AV_OPT_TYPE_DOUBLE, {.dbl=10.},   0,  100, FLAGS },
+    { "keyint", "set the maximum exported keyframe interval", OFFSET(keyint), AV_OPT_TYPE_INT,  {.i64=0},     0, INT_MAX, FLAGS },
+    { "min_keyint", "set the minimum exported keyframe interval", OFFSET(min_keyint), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(analyze);
+
+static const enum AVPixelFormat pix_fmts[] = {
+    AV_PIX_FMT_GRAY8, AV_PIX_FMT_NV12,
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P,
+    AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUVJ422P,
+    AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUVJ444P,
+    AV_PIX_FMT_GRAY10, AV_PIX_FMT_P010,
+    AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUV420P12, AV_PIX_FMT_YUV422P12, AV_PIX_FMT_YUV444P12,
+    AV_PIX_FMT_NONE
+};
+
+static const enum AVSampleFormat sample_fmts[] = {
+    AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP,
+    AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S16P,
+    AV_SAMPLE_FMT_NONE
+};
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterLink *inlink = outlink->src->inputs[FF_OUTLINK_IDX(outlink)];
+
+    outlink->time_base = inlink->time_base;
+    if (outlink->type == AVMEDIA_TYPE_VIDEO) {
+        outlink->w                   = inlink->w;
+        outlink->h                   = inlink->h;
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+        outlink->frame_rate          = inlink->frame_rate;
+    }
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    AnalyzeContext *s = ctx->priv;
+    int ret;
+
+    s->silence_start = AV_NOPTS_VALUE;
+    s->noise_i       = lrint(s->noise * INT16_MAX);
+    s->since_key     = -1;
+
+    if (s->audio) {
+        AVFilterPad pad = {
+            .name         = "audio",
+            .type         = AVMEDIA_TYPE_AUDIO,
+            .config_props = config_output,
+        };
+
+        if ((ret = ff_append_inpad(ctx, &(AVFilterPad){ .name = "audio", .type = AVMEDIA_TYPE_AUDIO })) < 0 ||
+            (ret = ff_append_outpad(ctx, &pad)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    AnalyzeContext *s = ctx->priv;
+    AVFilterFormats *formats;
+    AVFilterChannelLayouts *layouts;
+    int ret;
+
+    /* ff_set_common_* would mix the audio and video lists */
+    formats = ff_make_format_list(pix_fmts);
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->outcfg.formats)) < 0 ||
+        (ret = ff_formats_ref(formats, &ctx->outputs[0]->incfg.formats)) < 0)
+        return ret;
+
+    if (!s->audio)
+        return 0;
+
+    formats = ff_make_format_list(sample_fmts);
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[1]->outcfg.formats)) < 0 ||
+        (ret = ff_formats_ref(formats, &ctx->outputs[1]->incfg.formats)) < 0)
+        return ret;
+
+    layouts = ff_all_channel_layouts();
+    if ((ret = ff_channel_layouts_ref(layouts, &ctx->inputs[1]->outcfg.channel_layouts)) < 0 ||
+        (ret = ff_channel_layouts_ref(layouts, &ctx->outputs[1]->incfg.channel_layouts)) < 0)
+        return ret;
+
+    formats = ff_all_samplerates();
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[1]->outcfg.samplerates)) < 0 ||
+        (ret = ff_formats_ref(formats, &ctx->outputs[1]->incfg.samplerates)) < 0)
+        return ret;
+
+    return 0;
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AnalyzeContext *s = inlink->dst->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+
+    s->depth = desc->comp[0].depth;
+    s->shift = desc->comp[0].shift;
+    s->sad   = ff_scene_sad_get_fn(s->depth == 8 ? 8 : 16);
+    if (!s->sad)
+        return AVERROR(EINVAL);
+    return 0;
+}
+
+static int analyze_video(AVFilterContext *ctx, AVFrame *frame)
+{
+    AnalyzeContext *s = ctx->priv;
+    const int step = s->step;
+    const int rows = (frame->height + step - 1) / step;
+    const ptrdiff_t linesize = frame->linesize[0];
+    const int factor = 1 << (s->depth - 8);
+    const int full = frame->color_range == AVCOL_RANGE_JPEG;
+    const unsigned threshold = (unsigned)(full ? s->pixel_black_th * ((1 << s->depth) - 1) :
+                                          16 * factor + s->pixel_black_th * (235 - 16) * factor) << s->shift;
+    const int64_t count = (int64_t)rows * frame->width;
+    int64_t nb_black = 0;
+    double score = 0, mafd = 0;
+    char buf[32];
+
+    if (s->prev && s->prev->width == frame->width && s->prev->height == frame->height) {
+        uint64_t sad;
+
+        s->sad(s->prev->data[0], s->prev->linesize[0] * step,
+               frame->data[0], linesize * step, frame->width, rows, &sad);
+        mafd  = (double)sad * 100. / count / (1 << (s->depth + s->shift));
+        score = av_clipf(FFMIN(mafd, fabs(mafd - s->prev_mafd)), 0, 100.);
+        s->prev_mafd = mafd;
+    }
+    av_frame_free(&s->prev);
+    if (!(s->prev = av_frame_clone(frame)))
+        return AVERROR(ENOMEM);
+
+    for (int y = 0; y < frame->height; y += step) {
+        const uint8_t *line = frame->data[0] + y * linesize;
+
+        if (s->depth == 8) {
+            for (int x = 0; x < frame->width; x++)
+                nb_black += line[x] <= threshold;
+        } else {
+            const uint16_t *line16 = (const uint16_t *)line;
+            for (int x = 0; x < frame->width; x++)
+                nb_black += line16[x] <= threshold;
+        }
+    }
+
+    if (s->export) {
+        AVFrameSideData *sd = av_frame_new_side_data(frame, AV_FRAME_DATA_ENCODE_ANALYSIS,
+                                                     sizeof(AVEncodeAnalysis));
+        AVEncodeAnalysis *ea;
+        int key;
+
+        if (!sd)
+            return AVERROR(ENOMEM);
+        ea = (AVEncodeAnalysis *)sd->data;
+        ea->scene_cut  = s->since_key >= 0 && score >= s->scene_th;
+        ea->complexity = mafd;
+
+        key = s->since_key < 0 ||
+              (ea->scene_cut && s->since_key >= s->min_keyint) ||
+              (s->keyint && s->since_key >= s->keyint);
+        ea->pict_type = key ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+        s->since_key  = key ? 1 : s->since_key + 1;
+    }
+
+    snprintf(buf, sizeof(buf), "%0.3f", score);
+    av_dict_set(&frame->metadata, "lavfi.analyze.scene", buf, 0);
+    snprintf(buf, sizeof(buf), "%0.3f", (double)nb_black / count);
+    av_dict_set(&frame->metadata, "lavfi.analyze.black", buf, 0);
+
+    if (s->audio) {
+        AVFilterLink *alink = ctx->inputs[1];
+        double silence = 0;
+
+        if (s->silence_start != AV_NOPTS_VALUE && frame->pts != AV_NOPTS_VALUE) {
+            int64_t start = av_rescale_q(s->silence_start, av_make_q(1, alink->sample_rate),
+                                         ctx->inputs[0]->time_base);
+            silence = FFMAX(frame->pts - start, 0) * av_q2d(ctx->inputs[0]->time_base);
+        }
+        snprintf(buf, sizeof(buf), "%0.3f", silence);
+        av_dict_set(&frame->metadata, "lavfi.analyze.silence", buf, 0);
+    }
+    return 0;
+}
+
+#define ANALYZE_AUDIO(type, noise)                                             \
+    for (int i = 0; i < nb_samples; i++) {                                    \
+        int silent = 1;                                                       \
+        for (int c = 0; c < channels && silent; c++) {                        \
+            type v = planar ? ((const type *)frame->extended_data[c])[i] :     \
+                              ((const type *)frame->extended_data[0])[i * channels + c]; \
+            silent = v < noise && v > -noise;                                 \
+        }                                                                     \
+        if (!silent)                                                          \
+            s->silence_start = AV_NOPTS_VALUE;                                \
+        else if (s->silence_start == AV_NOPTS_VALUE)                          \
+            s->silence_start = start + i;                                     \
+    }
+
+static void analyze_audio(AVFilterContext *ctx, AVFrame *frame)
+{
+    AnalyzeContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[1];
+    const int planar = av_sample_fmt_is_planar(frame->format);
+    const int channels = frame->ch_layout.nb_channels;
+    const int nb_samples = frame->nb_samples;
+    int64_t start = s->audio_end;
+
+    if (frame->pts != AV_NOPTS_VALUE)
+        start = av_rescale_q(frame->pts, inlink->time_base, av_make_q(1, inlink->sample_rate));
+
+    switch (frame->format) {
+    case AV_SAMPLE_FMT_FLT:
+    case AV_SAMPLE_FMT_FLTP:
+        ANALYZE_AUDIO(float, s->noise);
+        break;
+    default:
+        ANALYZE_AUDIO(int16_t, s->noise_i);
+        break;
+    }
+    s->audio_end = start + nb_samples;
+}
+
+/* Whether the audio covering a video timestamp is analysed. */
+static int audio_ready(AVFilterContext *ctx, int64_t pts)
+{
+    AnalyzeContext *s = ctx->priv;
+    AVFilterLink *alink = ctx->inputs[1];
+
+    if (!s->audio || s->audio_eof || pts == AV_NOPTS_VALUE)
+        return 1;
+    return av_rescale_q(s->audio_end, av_make_q(1, alink->sample_rate),
+                        ctx->inputs[0]->time_base) > pts;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    AnalyzeContext *s = ctx->priv;
+    AVFilterLink *inlink  = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFrame *frame;
+    int64_t pts;
+    int ret, status;
+
+    for (int i = 0; i < ctx->nb_outputs; i++)
+        if ((status = ff_outlink_get_status(ctx->outputs[i])))
+            ff_inlink_set_status(ctx->inputs[i], status);
+
+    if (s->audio && !s->audio_eof) {
+        AVFilterLink *ainlink  = ctx->inputs[1];
+        AVFilterLink *aoutlink = ctx->outputs[1];
+
+        ret = ff_inlink_consume_frame(ainlink, &frame);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            analyze_audio(ctx, frame);
+            ret = ff_filter_frame(aoutlink, frame);
+            if (ret < 0)
+                return ret;
+            ff_filter_set_ready(ctx, 100);
+            return 0;
+        }
+        if (ff_inlink_acknowledge_status(ainlink, &status, &pts)) {
+            s->audio_eof = 1;
+            s->silence_start = AV_NOPTS_VALUE;
+            ff_outlink_set_status(aoutlink, status, pts);
+            ff_filter_set_ready(ctx, 100);
+            return 0;
+        }
+    }
+
+    if (ff_inlink_check_available_frame(inlink)) {
+        if (!audio_ready(ctx, ff_inlink_peek_frame(inlink, 0)->pts)) {
+            ff_inlink_request_frame(ctx->inputs[1]);
+            return 0;
+        }
+        ret = ff_inlink_consume_frame(inlink, &frame);
+        if (ret < 0)
+            return ret;
+        if ((ret = analyze_video(ctx, frame)) < 0) {
+            av_frame_free(&frame);
+            return ret;
+        }
+        return ff_filter_frame(outlink, frame);
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
+
+    if (ff_outlink_frame_wanted(outlink))
+        ff_inlink_request_frame(inlink);
+    if (s->audio && !s->audio_eof && ff_outlink_frame_wanted(ctx->outputs[1]))
+        ff_inlink_request_frame(ctx->inputs[1]);
+    return FFERROR_NOT_READY;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    AnalyzeContext *s = ctx->priv;
+
+    av_frame_free(&s->prev);
+}
+
+static const AVFilterPad analyze_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+    },
+};
+
+static const AVFilterPad analyze_outputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_output,
+    },
+};
+
+const AVFilter ff_vf_analyze = {
+    .name          = "analyze",
+    .description   = NULL_IF_CONFIG_SMALL("Detect scene changes, black frames and silence in one pass."),
+    .priv_size     = sizeof(AnalyzeContext),
+    .priv_class    = &analyze_class,
+    .init          = init,
+    .uninit        = uninit,
+    .activate      = activate,
+    .flags         = AVFILTER_FLAG_METADATA_ONLY |
+                     AVFILTER_FLAG_DYNAMIC_INPUTS |
+                     AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    FILTER_INPUTS(analyze_inputs),
+    FILTER_OUTPUTS(analyze_outputs),
+    FILTER_QUERY_FUNC(query_formats),
+};
@@ -49,6 +49,11 @@ typedef struct CropDetectContext {
     int window_size;
     int mv_threshold;
     int bitdepth;
+    int step;
+    int interval;
+    int keyframes;
+    int set_crop;
+    int nb_analyzed;
     float   low, high;
     uint8_t low_u8, high_u8;
     uint8_t  *filterbuf;
@@ -259,6 +264,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     int8_t *directions  = s->directions;
     const AVFrameSideData *sd = NULL;
     int scan_w, scan_h, bboff;
+    int analyze;
 
     void (*sobel)(int w, int h, uint16_t *dst, int dst_linesize,
                   int8_t *dir, int dir_linesize,
@@ -272,19 +278,28 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     if (++s->frame_nb > 0) {
         metadata = &frame->metadata;
 
+        /* only look at some of the frames, the borders rarely change */
+        analyze = !s->keyframes || (frame->flags & AV_FRAME_FLAG_KEY);
+
         // Reset the crop area every reset_count frames, if reset_count is > 0
-        if (s->reset_count > 0 && s->frame_nb > s->reset_count) {
+        if (analyze && s->reset_count > 0 && s->frame_nb > s->reset_count) {
             s->x1 = frame->width  - 1;
             s->y1 = frame->height - 1;
             s->x2 = 0;
             s->y2 = 0;
             s->frame_nb = 1;
+            s->nb_analyzed = 0;
         }
 
+        analyze = analyze && !((s->frame_nb - 1) % s->interval);
+        if (analyze)
+            s->nb_analyzed++;
+
 #define FIND(DST, FROM, NOEND, INC, STEP0, STEP1, LEN) \
         outliers = 0;\
         for (last_y = y = FROM; NOEND; y = y INC) {\
-            if (checkline(ctx, frame->data[0] + STEP0 * y, STEP1, LEN, bpp) > limit_upscaled) {\
+            if (checkline(ctx, frame->data[0] + STEP0 * y, STEP1 * s->step,\
+                          (LEN + s->step - 1) / s->step, bpp) > limit_upscaled) {\
                 if (++outliers > s->max_outliers) { \
                     DST = last_y;\
                     break;\
@@ -293,7 +308,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
                 last_y = y INC;\
         }
 
-        if (s->mode == MODE_BLACK) {
+        if (!analyze) {
+            /* keep the crop area of the last analyzed frame */
+        } else if (s->mode == MODE_BLACK) {
             FIND(s->y1,                 0,               y < s->y1, +1, frame->linesize[0], bpp, frame->width);
             FIND(s->y2, frame->height - 1, y > FFMAX(s->y2, s->y1), -1, frame->linesize[0], bpp, frame->width);
             FIND(s->x1,                 0,               y < s->x1, +1, bpp, frame->linesize[0], frame->height);
@@ -376,14 +393,14 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
                 FIND_EDGE(s->x2, s->x2, y < inw, +1, bpp, inw, scan_h);
 
                 // queue bboxes
-                bboff = (s->frame_nb - 1) % s->window_size;
+                bboff = (s->nb_analyzed - 1) % s->window_size;
                 s->bboxes[0][bboff] = s->x1;
                 s->bboxes[1][bboff] = s->x2;
                 s->bboxes[2][bboff] = s->y1;
                 s->bboxes[3][bboff] = s->y2;
 
                 // sort queue
-                bboff = FFMIN(s->frame_nb, s->window_size);
+                bboff = FFMIN(s->nb_analyzed, s->window_size);
                 AV_QSORT(s->bboxes[0], bboff, int, comp);
                 AV_QSORT(s->bboxes[1], bboff, int, comp);
                 AV_QSORT(s->bboxes[2], bboff, int, comp);
@@ -432,11 +449,21 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
         snprintf(limit_str, sizeof(limit_str), "%f", s->limit);
         av_dict_set(metadata, "lavfi.cropdetect.limit", limit_str, 0);
 
-        av_log(ctx, AV_LOG_INFO,
-               "x1:%d x2:%d y1:%d y2:%d w:%d h:%d x:%d y:%d pts:%"PRId64" t:%f limit:%f crop=%d:%d:%d:%d\n",
-               s->x1, s->x2, s->y1, s->y2, w, h, x, y, frame->pts,
-               frame->pts == AV_NOPTS_VALUE ? -1 : frame->pts * av_q2d(inlink->time_base),
-               s->limit, w, h, x, y);
+        /* let a downstream scale apply the crop without another run */
+        if (s->set_crop && w > 0 && h > 0 &&
+            x + w <= frame->width && y + h <= frame->height) {
+            frame->crop_left   = x;
+            frame->crop_top    = y;
+            frame->crop_right  = frame->width  - x - w;
+            frame->crop_bottom = frame->height - y - h;
+        }
+
+        if (analyze)
+            av_log(ctx, AV_LOG_INFO,
+                   "x1:%d x2:%d y1:%d y2:%d w:%d h:%d x:%d y:%d pts:%"PRId64" t:%f limit:%f crop=%d:%d:%d:%d\n",
+                   s->x1, s->x2, s->y1, s->y2, w, h, x, y, frame->pts,
+                   frame->pts == AV_NOPTS_VALUE ? -1 : frame->pts * av_q2d(inlink->time_base),
+                   s->limit, w, h, x, y);
     }
 
     return ff_filter_frame(inlink->dst->outputs[0], frame);
@@ -480,6 +507,10 @@ static const AVOption cropdetect_options[] = {
     { "high", "Set high threshold for edge detection",                OFFSET(high),        AV_OPT_TYPE_FLOAT, {.dbl=25/255.}, 0, 1, FLAGS },
     { "low", "Set low threshold for edge detection",                  OFFSET(low),         AV_OPT_TYPE_FLOAT, {.dbl=15/255.}, 0, 1, FLAGS },
     { "mv_threshold", "motion vector threshold when estimating video window size", OFFSET(mv_threshold), AV_OPT_TYPE_INT, {.i64=8}, 0, 100, FLAGS},
+    { "step", "Only sample every this many pixels of a line",         OFFSET(step),        AV_OPT_TYPE_INT, { .i64 = 1 },  1, INT_MAX, FLAGS },
+    { "interval", "Only analyze every this many frames",              OFFSET(interval),    AV_OPT_TYPE_INT, { .i64 = 1 },  1, INT_MAX, FLAGS },
+    { "keyframes", "Only analyze key frames",                         OFFSET(keyframes),   AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { "set_crop", "Export the crop area as frame cropping",           OFFSET(set_crop),    AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
     { NULL }
 };
 
@@ -0,0 +1,344 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Deinterlace with the best implementation available for the input frames.
+ *
+ * The deinterlacer runs in a private graph, which is flushed and dropped
+ * when progressive frames arrive and built again on the next interlaced
+ * frame, so that content switching between the two is handled in order and
+ * without keeping progressive frames.
+ */
+
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "avfilter.h"
+#include "buffersink.h"
+#include "buffersrc.h"
+#include "filters.h"
+#include "internal.h"
+#include "video.h"
+
+typedef struct DeintImpl {
+    enum AVPixelFormat pix_fmt;     ///< AV_PIX_FMT_NONE for software formats
+    const char *name;
+    const char *args[2];            ///< for frame and field rate output
+} DeintImpl;
+
+/* in order of preference for each format */
+static const DeintImpl impls[] = {
+    { AV_PIX_FMT_CUDA,   "bwdif_cuda",        { "mode=send_frame:deint=all", "mode=send_field:deint=all" } },
+    { AV_PIX_FMT_CUDA,   "yadif_cuda",        { "mode=send_frame:deint=all", "mode=send_field:deint=all" } },
+    { AV_PIX_FMT_VAAPI,  "deinterlace_vaapi", { "rate=frame:auto=0",         "rate=field:auto=0" } },
+    { AV_PIX_FMT_QSV,    "vpp_qsv",           { "deinterlace=advanced:rate=frame", "deinterlace=advanced:rate=field" } },
+    { AV_PIX_FMT_VULKAN, "bwdif_vulkan",      { "mode=send_frame:deint=all", "mode=send_field:deint=all" } },
+    { AV_PIX_FMT_NONE,   "bwdif",             { "mode=send_frame:deint=all", "mode=send_field:deint=all" } },
+    { AV_PIX_FMT_NONE,   "yadif",             { "mode=send_frame:deint=all", "mode=send_field:deint=all" } },
+};
+
+typedef struct DeintAutoContext {
+    const AVClass *class;
+    int rate;
+    int deint;
+
+    const DeintImpl *impl;
+    AVFilterGraph *graph;
+    AVFilterContext *src, *sink;
+} DeintAutoContext;
+
+static const enum AVPixelFormat pix_fmts[] = {
+    AV_PIX_FMT_CUDA, AV_PIX_FMT_VAAPI, AV_PIX_FMT_QSV, AV_PIX_FMT_VULKAN,
+    AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P, AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV440P, AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_YUVJ411P, AV_PIX_FMT_YUVJ420P,
+    AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ440P, AV_PIX_FMT_YUVJ444P,
+    AV_PIX_FMT_YUV420P9, AV_PIX_FMT_YUV422P9, AV_PIX_FMT_YUV444P9,
+    AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUV420P12, AV_PIX_FMT_YUV422P12, AV_PIX_FMT_YUV444P12,
+    AV_PIX_FMT_YUV420P14, AV_PIX_FMT_YUV422P14, AV_PIX_FMT_YUV444P14,
+    AV_PIX_FMT_YUV420P16, AV_PIX_FMT_YUV422P16, AV_PIX_FMT_YUV444P16,
+    AV_PIX_FMT_YUVA420P, AV_PIX_FMT_YUVA422P, AV_PIX_FMT_YUVA444P,
+    AV_PIX_FMT_GBRP, AV_PIX_FMT_GBRP9, AV_PIX_FMT_GBRP10,
+    AV_PIX_FMT_GBRP12, AV_PIX_FMT_GBRP14, AV_PIX_FMT_GBRP16,
+    AV_PIX_FMT_GBRAP, AV_PIX_FMT_GBRAP16,
+    AV_PIX_FMT_GRAY8, AV_PIX_FMT_GRAY16,
+    AV_PIX_FMT_NONE
+};
+
+static int select_impl(AVFilterContext *ctx, enum AVPixelFormat format)
+{
+    DeintAutoContext *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    enum AVPixelFormat key = (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) ? format : AV_PIX_FMT_NONE;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(impls); i++) {
+        if (impls[i].pix_fmt == key && avfilter_get_by_name(impls[i].name)) {
+            s->impl = &impls[i];
+            av_log(ctx, AV_LOG_VERBOSE, "Deinterlacing %s frames with %s\n",
+                   desc->name, s->impl->name);
+            return 0;
+        }
+    }
+
+    av_log(ctx, AV_LOG_ERROR, "No deinterlacer available for %s frames\n", desc->name);
+    return AVERROR(ENOSYS);
+}
+
+static void free_graph(DeintAutoContext *s)
+{
+    avfilter_graph_free(&s->graph);
+    s->src = s->sink = NULL;
+}
+
+static int build_graph(AVFilterContext *ctx)
+{
+    DeintAutoContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVBufferSrcParameters *par;
+    AVFilterContext *deint;
+    int ret;
+
+    s->graph = avfilter_graph_alloc();
+    par = av_buffersrc_parameters_alloc();
+    if (!s->graph || !par) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    s->graph->nb_threads = ff_filter_get_nb_threads(ctx);
+
+    par->format              = inlink->format;
+    par->width               = inlink->w;
+    par->height              = inlink->h;
+    par->time_base           = inlink->time_base;
+    par->frame_rate          = inlink->frame_rate;
+    par->sample_aspect_ratio = inlink->sample_aspect_ratio;
+    par->hw_frames_ctx       = inlink->hw_frames_ctx;
+
+    s->src = avfilter_graph_alloc_filter(s->graph, avfilter_get_by_name("buffer"), "in");
+    if (!s->src) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = av_buffersrc_parameters_set(s->src, par)) < 0 ||
+        (ret = avfilter_init_str(s->src, NULL)) < 0)
+        goto fail;
+
+    deint = avfilter_graph_alloc_filter(s->graph, avfilter_get_by_name(s->impl->name), "deint");
+    if (!deint) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if (ctx->hw_device_ctx && !(deint->hw_device_ctx = av_buffer_ref(ctx->hw_device_ctx))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = avfilter_init_str(deint, s->impl->args[s->rate])) < 0)
+        goto fail;
+
+    if ((ret = avfilter_graph_create_filter(&s->sink, avfilter_get_by_name("buffersink"),
+                                            "out", NULL, NULL, s->graph)) < 0)
+        goto fail;
+
+    if ((ret = avfilter_link(s->src, 0, deint, 0)) < 0 ||
+        (ret = avfilter_link(deint, 0, s->sink, 0)) < 0 ||
+        (ret = avfilter_graph_config(s->graph, ctx)) < 0)
+        goto fail;
+
+    av_free(par);
+    return 0;
+
+fail:
+    av_free(par);
+    free_graph(s);
+    return ret;
+}
+
+/* Pass on every frame the private graph has ready, or all of them up to
+ * EOF when flushing. */
+static int drain_graph(AVFilterContext *ctx, int flush)
+{
+    DeintAutoContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVRational tb = av_buffersink_get_time_base(s->sink);
+    int ret;
+
+    if (flush && (ret = av_buffersrc_add_frame(s->src, NULL)) < 0)
+        return ret;
+
+    while (1) {
+        AVFrame *out = av_frame_alloc();
+
+        if (!out)
+            return AVERROR(ENOMEM);
+        if ((ret = av_buffersink_get_frame(s->sink, out)) < 0) {
+            av_frame_free(&out);
+            break;
+        }
+        out->pts      = av_rescale_q(out->pts, tb, outlink->time_base);
+        out->duration = av_rescale_q(out->duration, tb, outlink->time_base);
+        if ((ret = ff_filter_frame(outlink, out)) < 0)
+            return ret;
+    }
+    if (ret == AVERROR_EOF)
+        free_graph(s);
+    else if (ret != AVERROR(EAGAIN))
+        return ret;
+
+    return 0;
+}
+
+static int filter_frame(AVFilterContext *ctx, AVFrame *in)
+{
+    DeintAutoContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    int ret;
+
+    if (s->deint && !(in->flags & AV_FRAME_FLAG_INTERLACED)) {
+        if (s->graph && (ret = drain_graph(ctx, 1)) < 0)
+            goto fail;
+        in->pts      = av_rescale_q(in->pts, inlink->time_base, outlink->time_base);
+        in->duration = av_rescale_q(in->duration, inlink->time_base, outlink->time_base);
+        return ff_filter_frame(outlink, in);
+    }
+
+    if (!s->graph && (ret = build_graph(ctx)) < 0)
+        goto fail;
+    if ((ret = av_buffersrc_add_frame(s->src, in)) < 0)
+        goto fail;
+    av_frame_free(&in);
+
+    return drain_graph(ctx, 0);
+
+fail:
+    av_frame_free(&in);
+    return ret;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    DeintAutoContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFrame *in;
+    int64_t pts;
+    int ret, status;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    ret = ff_inlink_consume_frame(inlink, &in);
+    if (ret < 0)
+        return ret;
+    if (ret > 0)
+        return filter_frame(ctx, in);
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        if (s->graph && (ret = drain_graph(ctx, 1)) < 0)
+            return ret;
+        ff_outlink_set_status(outlink, status,
+                              av_rescale_q(pts, inlink->time_base, outlink->time_base));
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    DeintAutoContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVBufferRef *hw_frames_ctx;
+    int ret;
+
+    free_graph(s);
+    if ((ret = select_impl(ctx, inlink->format)) < 0 ||
+        (ret = build_graph(ctx)) < 0)
+        return ret;
+
+    /* the private graph is kept for the first frames */
+    outlink->w                   = av_buffersink_get_w(s->sink);
+    outlink->h                   = av_buffersink_get_h(s->sink);
+    outlink->time_base           = av_buffersink_get_time_base(s->sink);
+    outlink->frame_rate          = av_buffersink_get_frame_rate(s->sink);
+    outlink->sample_aspect_ratio = av_buffersink_get_sample_aspect_ratio(s->sink);
+
+    hw_frames_ctx = av_buffersink_get_hw_frames_ctx(s->sink);
+    if (hw_frames_ctx) {
+        av_buffer_unref(&outlink->hw_frames_ctx);
+        outlink->hw_frames_ctx = av_buffer_ref(hw_frames_ctx);
+        if (!outlink->hw_frames_ctx)
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    DeintAutoContext *s = ctx->priv;
+
+    free_graph(s);
+}
+
+#define OFFSET(x) offsetof(DeintAutoContext, x)
+#define FLAGS (AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM)
+
+static const AVOption deinterlace_auto_options[] = {
+    { "rate", "generate output at frame rate or field rate", OFFSET(rate), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, FLAGS, "rate" },
+        { "frame", "one frame for each frame", 0, AV_OPT_TYPE_CONST, { .i64 = 0 }, 0, 0, FLAGS, "rate" },
+        { "field", "one frame for each field", 0, AV_OPT_TYPE_CONST, { .i64 = 1 }, 0, 0, FLAGS, "rate" },
+    { "deint", "specify which frames to deinterlace", OFFSET(deint), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, FLAGS, "deint" },
+        { "all",        "deinterlace all frames",                          0, AV_OPT_TYPE_CONST, { .i64 = 0 }, 0, 0, FLAGS, "deint" },
+        { "interlaced", "deinterlace frames marked as interlaced, pass others", 0, AV_OPT_TYPE_CONST, { .i64 = 1 }, 0, 0, FLAGS, "deint" },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(deinterlace_auto);
+
+static const AVFilterPad deinterlace_auto_inputs[] = {
+    {
+        .name = "default",
+        .type = AVMEDIA_TYPE_VIDEO,
+    },
+};
+
+static const AVFilterPad deinterlace_auto_outputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_output,
+    },
+};
+
+const AVFilter ff_vf_deinterlace_auto = {
+    .name           = "deinterlace_auto",
+    .description    = NULL_IF_CONFIG_SMALL("Deinterlace with the best available implementation."),
+    .priv_size      = sizeof(DeintAutoContext),
+    .priv_class     = &deinterlace_auto_class,
+    .uninit         = uninit,
+    .activate       = activate,
+    FILTER_INPUTS(deinterlace_auto_inputs),
+    FILTER_OUTPUTS(deinterlace_auto_outputs),
+    FILTER_PIXFMTS_ARRAY(pix_fmts),
+    .flags_internal = FF_FILTER_FLAG_HWFRAME_AWARE,
+};
@@ -33,6 +33,7 @@
 #include "libavutil/eval.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
+#include "libavutil/video_hint.h"
 #include "avfilter.h"
 #include "ccfifo.h"
 #include "filters.h"
@@ -76,6 +77,7 @@ typedef struct FPSContext {
     char *framerate;        ///< expression that defines the target framerate
     int rounding;           ///< AVRounding method for timestamps
     int eof_action;         ///< action performed for last frame in FIFO
+    int hint_dups;          ///< mark duplicated frames as unchanged for encoders
 
     /* Set during outlink configuration */
     int64_t  in_pts_off;    ///< input frame pts offset for start_time handling
@@ -114,6 +116,7 @@ static const AVOption fps_options[] = {
     { "eof_action", "action performed for last frame", OFFSET(eof_action), AV_OPT_TYPE_INT, { .i64 = EOF_ACTION_ROUND }, 0, EOF_ACTION_NB-1, V|F, "eof_action" },
         { "round", "round similar to other frames",  0, AV_OPT_TYPE_CONST, { .i64 = EOF_ACTION_ROUND }, 0, 0, V|F, "eof_action" },
         { "pass",  "pass through last frame",        0, AV_OPT_TYPE_CONST, { .i64 = EOF_ACTION_PASS  }, 0, 0, V|F, "eof_action" },
+    { "hint_dups", "mark duplicated frames as unchanged", OFFSET(hint_dups), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, V|F },
     { NULL }
 };
 
@@ -301,6 +304,20 @@ static int write_frame(AVFilterContext *ctx, FPSContext *s, AVFilterLink *outlin
             return AVERROR(ENOMEM);
         // Make sure Closed Captions will not be duplicated
         ff_ccfifo_inject(&s->cc_fifo, frame);
+
+        /* a repeat is all skip blocks to encoders honouring the hint */
+        if (s->hint_dups && s->cur_frame_out > 0) {
+            AVVideoHint *hint;
+
+            av_frame_remove_side_data(frame, AV_FRAME_DATA_VIDEO_HINT);
+            hint = av_video_hint_create_side_data(frame, 0);
+            if (!hint) {
+                av_frame_free(&frame);
+                return AVERROR(ENOMEM);
+            }
+            hint->type = AV_VIDEO_HINT_TYPE_CHANGED;
+        }
+
         frame->pts = s->next_pts++;
         frame->duration = 1;
 
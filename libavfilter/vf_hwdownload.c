@@ -24,7 +24,9 @@
 #include "libavutil/pixdesc.h"
 
 #include "avfilter.h"
+#include "filters.h"
 #include "formats.h"
+#include "hwtransfer_queue.h"
 #include "internal.h"
 #include "video.h"
 
@@ -33,6 +35,11 @@ typedef struct HWDownloadContext {
 
     AVBufferRef       *hwframes_ref;
     AVHWFramesContext *hwframes;
+
+    //PLEX
+    int async;
+    FFHWTransferQueue *queue;
+    //PLEX
 } HWDownloadContext;
 
 static int hwdownload_query_formats(AVFilterContext *avctx)
@@ -105,6 +112,19 @@ static int hwdownload_config_output(AVFilterLink *outlink)
     outlink->w = inlink->w;
     outlink->h = inlink->h;
 
+    //PLEX
+    if (ctx->async && !ctx->queue) {
+        err = ff_hwtransfer_queue_alloc(&ctx->queue, avctx, ctx->async);
+        if (err == AVERROR(ENOSYS)) {
+            av_log(ctx, AV_LOG_WARNING, "Asynchronous downloads need threads, "
+                   "downloading synchronously.\n");
+            ctx->async = 0;
+        } else if (err < 0) {
+            return err;
+        }
+    }
+    //PLEX
+
     return 0;
 }
 
@@ -158,17 +178,128 @@ fail:
     return err;
 }
 
+//PLEX
+static int hwdownload_submit(AVFilterContext *avctx, AVFrame *input)
+{
+    HWDownloadContext *ctx = avctx->priv;
+    AVFrame *output;
+
+    if (!ctx->hwframes_ref || !input->hw_frames_ctx ||
+        (void*)ctx->hwframes != input->hw_frames_ctx->data) {
+        av_log(ctx, AV_LOG_ERROR, "Input frame is not the in the configured "
+               "hwframe context.\n");
+        av_frame_free(&input);
+        return AVERROR(EINVAL);
+    }
+
+    output = ff_get_video_buffer(avctx->outputs[0], ctx->hwframes->width,
+                                 ctx->hwframes->height);
+    if (!output) {
+        av_frame_free(&input);
+        return AVERROR(ENOMEM);
+    }
+
+    return ff_hwtransfer_queue_submit(ctx->queue, output, input);
+}
+
+static int hwdownload_send(AVFilterContext *avctx, AVFrame *output)
+{
+    AVFilterLink *outlink = avctx->outputs[0];
+
+    output->width  = outlink->w;
+    output->height = outlink->h;
+
+    return ff_filter_frame(outlink, output);
+}
+
+/* keep up to async downloads in flight, the oldest one leaves when it is
+ * done or when it has to make room for the next input */
+static int hwdownload_activate(AVFilterContext *avctx)
+{
+    AVFilterLink  *inlink = avctx->inputs[0];
+    AVFilterLink *outlink = avctx->outputs[0];
+    HWDownloadContext *ctx = avctx->priv;
+    AVFrame *input, *output;
+    int64_t pts;
+    int ret, status;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    if (!ctx->queue) {
+        ret = ff_inlink_consume_frame(inlink, &input);
+        if (ret < 0)
+            return ret;
+        if (ret > 0)
+            return hwdownload_filter_frame(inlink, input);
+        FF_FILTER_FORWARD_STATUS(inlink, outlink);
+        FF_FILTER_FORWARD_WANTED(outlink, inlink);
+        return FFERROR_NOT_READY;
+    }
+
+    ret = ff_hwtransfer_queue_receive(ctx->queue, &output,
+                                      !ff_hwtransfer_queue_can_submit(ctx->queue));
+    if (ret < 0)
+        return ret;
+    if (ret > 0) {
+        ff_filter_set_ready(avctx, 100);
+        return hwdownload_send(avctx, output);
+    }
+
+    if (ff_hwtransfer_queue_can_submit(ctx->queue)) {
+        ret = ff_inlink_consume_frame(inlink, &input);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            ff_filter_set_ready(avctx, 100);
+            return hwdownload_submit(avctx, input);
+        }
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        while ((ret = ff_hwtransfer_queue_receive(ctx->queue, &output, 1)) > 0) {
+            ret = hwdownload_send(avctx, output);
+            if (ret < 0)
+                return ret;
+        }
+        if (ret < 0)
+            return ret;
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+//PLEX
+
 static av_cold void hwdownload_uninit(AVFilterContext *avctx)
 {
     HWDownloadContext *ctx = avctx->priv;
 
+    ff_hwtransfer_queue_free(&ctx->queue); //PLEX
     av_buffer_unref(&ctx->hwframes_ref);
 }
 
+//PLEX
+#define OFFSET(x) offsetof(HWDownloadContext, x)
+#define FLAGS (AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM)
+static const AVOption hwdownload_options[] = {
+    {
+        "async", "Number of downloads running in the background, 0 to download synchronously",
+        OFFSET(async), AV_OPT_TYPE_INT,
+        { .i64 = 0 }, 0, 16, FLAGS
+    },
+    {
+        NULL
+    }
+};
+//PLEX
+
 static const AVClass hwdownload_class = {
     .class_name = "hwdownload",
     .item_name  = av_default_item_name,
-    .option     = NULL,
+    .option     = hwdownload_options, //PLEX
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
@@ -177,7 +308,6 @@ static const AVFilterPad hwdownload_inputs[] = {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
         .config_props = hwdownload_config_input,
-        .filter_frame = hwdownload_filter_frame,
     },
 };
 
@@ -195,6 +325,7 @@ const AVFilter ff_vf_hwdownload = {
     .uninit        = hwdownload_uninit,
     .priv_size     = sizeof(HWDownloadContext),
     .priv_class    = &hwdownload_class,
+    .activate      = hwdownload_activate, //PLEX
     FILTER_INPUTS(hwdownload_inputs),
     FILTER_OUTPUTS(hwdownload_outputs),
     FILTER_QUERY_FUNC(hwdownload_query_formats),
@@ -24,7 +24,9 @@
 #include "libavutil/opt.h"
 
 #include "avfilter.h"
+#include "filters.h"
 #include "formats.h"
+#include "hwtransfer_queue.h"
 #include "internal.h"
 #include "video.h"
 
@@ -37,6 +39,14 @@ typedef struct HWUploadContext {
     AVHWFramesContext *hwframes;
 
     char *device_type;
+
+    //PLEX
+    int reuse;
+    AVFrame *last_input;
+    AVFrame *last_output;
+    int async;
+    FFHWTransferQueue *queue;
+    //PLEX
 } HWUploadContext;
 
 static int hwupload_query_formats(AVFilterContext *avctx)
@@ -149,7 +159,8 @@ static int hwupload_config_output(AVFilterLink *outlink)
     ctx->hwframes->height    = inlink->h;
 
     if (avctx->extra_hw_frames >= 0)
-        ctx->hwframes->initial_pool_size = 2 + avctx->extra_hw_frames;
+        ctx->hwframes->initial_pool_size = 2 + avctx->extra_hw_frames +
+                                           ctx->async; //PLEX
 
     err = av_hwframe_ctx_init(ctx->hwframes_ref);
     if (err < 0)
@@ -161,6 +172,19 @@ static int hwupload_config_output(AVFilterLink *outlink)
         goto fail;
     }
 
+    //PLEX
+    if (ctx->async && !ctx->queue) {
+        err = ff_hwtransfer_queue_alloc(&ctx->queue, avctx, ctx->async);
+        if (err == AVERROR(ENOSYS)) {
+            av_log(ctx, AV_LOG_WARNING, "Asynchronous uploads need threads, "
+                   "uploading synchronously.\n");
+            ctx->async = 0;
+        } else if (err < 0) {
+            goto fail;
+        }
+    }
+    //PLEX
+
     return 0;
 
 fail:
@@ -168,6 +192,45 @@ fail:
     return err;
 }
 
+//PLEX
+/* Since a reference to the previous input is kept, its buffers cannot have
+ * been reused, so sharing them means the frames have the same content. */
+static int same_data(const AVFrame *a, const AVFrame *b)
+{
+    if (a->format != b->format || a->width != b->width || a->height != b->height)
+        return 0;
+    for (int i = 0; i < FF_ARRAY_ELEMS(a->buf); i++) {
+        if (!a->buf[i] != !b->buf[i] ||
+            (a->buf[i] && a->buf[i]->buffer != b->buf[i]->buffer))
+            return 0;
+    }
+    for (int i = 0; i < AV_NUM_DATA_POINTERS; i++) {
+        if (a->data[i] != b->data[i] || a->linesize[i] != b->linesize[i])
+            return 0;
+    }
+    return !!a->buf[0];
+}
+
+static AVFrame *reuse_output(HWUploadContext *ctx, const AVFrame *input)
+{
+    AVFrame *output = av_frame_alloc();
+
+    if (!output)
+        return NULL;
+    if (av_frame_ref(output, ctx->last_output) < 0)
+        goto fail;
+    while (output->nb_side_data)
+        av_frame_remove_side_data(output, output->side_data[0]->type);
+    av_dict_free(&output->metadata);
+    if (av_frame_copy_props(output, input) < 0)
+        goto fail;
+    return output;
+fail:
+    av_frame_free(&output);
+    return NULL;
+}
+//PLEX
+
 static int hwupload_filter_frame(AVFilterLink *link, AVFrame *input)
 {
     AVFilterContext *avctx = link->dst;
@@ -179,6 +242,16 @@ static int hwupload_filter_frame(AVFilterLink *link, AVFrame *input)
     if (input->format == outlink->format)
         return ff_filter_frame(outlink, input);
 
+    //PLEX
+    if (ctx->reuse && ctx->last_input && same_data(input, ctx->last_input)) {
+        output = reuse_output(ctx, input);
+        av_frame_free(&input);
+        if (!output)
+            return AVERROR(ENOMEM);
+        return ff_filter_frame(outlink, output);
+    }
+    //PLEX
+
     output = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!output) {
         av_log(ctx, AV_LOG_ERROR, "Failed to allocate frame to upload to.\n");
@@ -199,6 +272,20 @@ static int hwupload_filter_frame(AVFilterLink *link, AVFrame *input)
     if (err < 0)
         goto fail;
 
+    //PLEX
+    if (ctx->reuse) {
+        av_frame_free(&ctx->last_output);
+        ctx->last_output = av_frame_clone(output);
+        if (!ctx->last_output) {
+            err = AVERROR(ENOMEM);
+            goto fail;
+        }
+        av_frame_free(&ctx->last_input);
+        ctx->last_input = input;
+        return ff_filter_frame(outlink, output);
+    }
+    //PLEX
+
     av_frame_free(&input);
 
     return ff_filter_frame(outlink, output);
@@ -209,10 +296,136 @@ fail:
     return err;
 }
 
+//PLEX
+static int hwupload_send(AVFilterContext *avctx, AVFrame *output)
+{
+    HWUploadContext *ctx = avctx->priv;
+
+    if (ctx->reuse) {
+        av_frame_free(&ctx->last_output);
+        ctx->last_output = av_frame_clone(output);
+        if (!ctx->last_output) {
+            av_frame_free(&output);
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    return ff_filter_frame(avctx->outputs[0], output);
+}
+
+static int hwupload_submit(AVFilterContext *avctx, AVFrame *input)
+{
+    AVFilterLink *outlink = avctx->outputs[0];
+    HWUploadContext   *ctx = avctx->priv;
+    AVFrame *output;
+    int ret;
+
+    /* frames that are not uploaded must wait for the ones before them */
+    if (input->format == outlink->format ||
+        (ctx->reuse && ctx->last_input && same_data(input, ctx->last_input))) {
+        while ((ret = ff_hwtransfer_queue_receive(ctx->queue, &output, 1)) > 0) {
+            ret = hwupload_send(avctx, output);
+            if (ret < 0)
+                break;
+        }
+        if (ret < 0) {
+            av_frame_free(&input);
+            return ret;
+        }
+        return hwupload_filter_frame(avctx->inputs[0], input);
+    }
+
+    output = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+    if (!output) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to allocate frame to upload to.\n");
+        av_frame_free(&input);
+        return AVERROR(ENOMEM);
+    }
+
+    output->width  = input->width;
+    output->height = input->height;
+
+    if (ctx->reuse) {
+        av_frame_free(&ctx->last_input);
+        ctx->last_input = av_frame_clone(input);
+        if (!ctx->last_input) {
+            av_frame_free(&input);
+            av_frame_free(&output);
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    return ff_hwtransfer_queue_submit(ctx->queue, output, input);
+}
+
+/* keep up to async uploads in flight, the oldest one leaves when it is
+ * done or when it has to make room for the next input */
+static int hwupload_activate(AVFilterContext *avctx)
+{
+    AVFilterLink  *inlink = avctx->inputs[0];
+    AVFilterLink *outlink = avctx->outputs[0];
+    HWUploadContext   *ctx = avctx->priv;
+    AVFrame *input, *output;
+    int64_t pts;
+    int ret, status;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    if (!ctx->queue) {
+        ret = ff_inlink_consume_frame(inlink, &input);
+        if (ret < 0)
+            return ret;
+        if (ret > 0)
+            return hwupload_filter_frame(inlink, input);
+        FF_FILTER_FORWARD_STATUS(inlink, outlink);
+        FF_FILTER_FORWARD_WANTED(outlink, inlink);
+        return FFERROR_NOT_READY;
+    }
+
+    ret = ff_hwtransfer_queue_receive(ctx->queue, &output,
+                                      !ff_hwtransfer_queue_can_submit(ctx->queue));
+    if (ret < 0)
+        return ret;
+    if (ret > 0) {
+        ff_filter_set_ready(avctx, 100);
+        return hwupload_send(avctx, output);
+    }
+
+    if (ff_hwtransfer_queue_can_submit(ctx->queue)) {
+        ret = ff_inlink_consume_frame(inlink, &input);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            ff_filter_set_ready(avctx, 100);
+            return hwupload_submit(avctx, input);
+        }
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        while ((ret = ff_hwtransfer_queue_receive(ctx->queue, &output, 1)) > 0) {
+            ret = hwupload_send(avctx, output);
+            if (ret < 0)
+                return ret;
+        }
+        if (ret < 0)
+            return ret;
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+//PLEX
+
 static av_cold void hwupload_uninit(AVFilterContext *avctx)
 {
     HWUploadContext *ctx = avctx->priv;
 
+    ff_hwtransfer_queue_free(&ctx->queue); //PLEX
+    av_frame_free(&ctx->last_input); //PLEX
+    av_frame_free(&ctx->last_output); //PLEX
     av_buffer_unref(&ctx->hwframes_ref);
     av_buffer_unref(&ctx->hwdevice_ref);
 }
@@ -225,6 +438,18 @@ static const AVOption hwupload_options[] = {
         OFFSET(device_type), AV_OPT_TYPE_STRING,
         { .str = NULL }, 0, 0, FLAGS
     },
+    //PLEX
+    {
+        "reuse", "Upload repeated input frames only once",
+        OFFSET(reuse), AV_OPT_TYPE_BOOL,
+        { .i64 = 0 }, 0, 1, FLAGS
+    },
+    {
+        "async", "Number of uploads running in the background, 0 to upload synchronously",
+        OFFSET(async), AV_OPT_TYPE_INT,
+        { .i64 = 0 }, 0, 16, FLAGS
+    },
+    //PLEX
     {
         NULL
     }
@@ -236,7 +461,6 @@ static const AVFilterPad hwupload_inputs[] = {
     {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
-        .filter_frame = hwupload_filter_frame,
     },
 };
 
@@ -254,6 +478,7 @@ const AVFilter ff_vf_hwupload = {
     .uninit        = hwupload_uninit,
     .priv_size     = sizeof(HWUploadContext),
     .priv_class    = &hwupload_class,
+    .activate      = hwupload_activate, //PLEX
     FILTER_INPUTS(hwupload_inputs),
     FILTER_OUTPUTS(hwupload_outputs),
     FILTER_QUERY_FUNC(hwupload_query_formats),
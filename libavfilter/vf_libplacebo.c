@@ -42,6 +42,10 @@ static inline AVFrame *pl_get_mapped_avframe(const struct pl_frame *frame)
 }
 #endif
 
+#if PL_API_VER >= 351
+#include <libplacebo/cache.h>
+#endif
+
 #if PL_API_VER >= 309
 #include <libplacebo/options.h>
 #else
@@ -158,6 +162,9 @@ typedef struct LibplaceboContext {
     pl_vulkan vulkan;
     pl_gpu gpu;
     pl_tex tex[4];
+#if PL_API_VER >= 351
+    pl_cache cache;
+#endif
 
     /* input state */
     LibplaceboInput *inputs;
@@ -269,6 +276,7 @@ typedef struct LibplaceboContext {
     int shader_bin_len;
     const struct pl_hook *hooks[2];
     int num_hooks;
+    char *shader_cache;
 } LibplaceboContext;
 
 static inline enum pl_log_level get_log_level(void)
@@ -566,6 +574,26 @@ static int libplacebo_init(AVFilterContext *avctx)
         return AVERROR(ENOMEM);
     }
 
+    /* Compiled shaders and pipelines are kept on disk, so that later
+     * instances and processes skip the compilation */
+    if (s->shader_cache && s->shader_cache[0]) {
+#if PL_API_VER >= 351
+        s->cache = pl_cache_create(pl_cache_params(
+            .log  = s->log,
+            .get  = pl_cache_get_file,
+            .set  = pl_cache_set_file,
+            .priv = s->shader_cache,
+        ));
+        if (!s->cache) {
+            libplacebo_uninit(avctx);
+            return AVERROR(ENOMEM);
+        }
+#else
+        av_log(avctx, AV_LOG_WARNING, "libplacebo version %s too old for a "
+               "shader cache, upgrade libplacebo to >= 6.351\n", PL_VERSION);
+#endif
+    }
+
     if (s->out_format_string) {
         s->out_format = av_get_pix_fmt(s->out_format_string);
         if (s->out_format == AV_PIX_FMT_NONE) {
@@ -713,6 +741,9 @@ static int init_vulkan(AVFilterContext *avctx, const AVVulkanDeviceContext *hwct
     }
 
     s->gpu = s->vulkan->gpu;
+#if PL_API_VER >= 351
+    pl_gpu_set_cache(s->gpu, s->cache);
+#endif
 
     /* Parse the user shaders, if requested */
     if (s->shader_bin_len)
@@ -753,6 +784,9 @@ static void libplacebo_uninit(AVFilterContext *avctx)
 
     pl_options_free(&s->opts);
     pl_vulkan_destroy(&s->vulkan);
+#if PL_API_VER >= 351
+    pl_cache_destroy(&s->cache);
+#endif
     pl_log_destroy(&s->log);
     ff_vk_uninit(&s->vkctx);
     s->gpu = NULL;
@@ -1495,6 +1529,7 @@ static const AVOption libplacebo_options[] = {
 
     { "custom_shader_path", "Path to custom user shader (mpv .hook format)", OFFSET(shader_path), AV_OPT_TYPE_STRING, .flags = STATIC },
     { "custom_shader_bin", "Custom user shader as binary (mpv .hook format)", OFFSET(shader_bin), AV_OPT_TYPE_BINARY, .flags = STATIC },
+    { "shader_cache", "Directory to cache compiled shaders in", OFFSET(shader_cache), AV_OPT_TYPE_STRING, .flags = STATIC },
 
     /* Performance/quality tradeoff options */
     { "skip_aa", "Skip anti-aliasing", OFFSET(skip_aa), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DYNAMIC },
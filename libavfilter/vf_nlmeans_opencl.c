@@ -68,6 +68,9 @@ typedef struct NLMeansOpenCLContext {
     int                   patch_size_uv;
     int                   research_size;
     int                   research_size_uv;
+    float                 temporal;
+    float                 temporal_thresh;
+    AVFrame              *prev;     // previous output, for the temporal filter
     cl_command_queue      command_queue;
 } NLMeansOpenCLContext;
 
@@ -168,7 +171,7 @@ fail:
 }
 
 static int nlmeans_plane(AVFilterContext *avctx, cl_mem dst, cl_mem src,
-                         cl_int width, cl_int height, cl_int p, cl_int r)
+                         cl_mem prev, cl_int width, cl_int height, cl_int p, cl_int r)
 {
     NLMeansOpenCLContext *ctx = avctx->priv;
     const float zero = 0.0f;
@@ -179,6 +182,7 @@ static int nlmeans_plane(AVFilterContext *avctx, cl_mem dst, cl_mem src,
     cl_int cle;
     int nb_pixel, *tmp = NULL, idx = 0;
     cl_int *dxdy = NULL;
+    cl_float t;
 
     weight_buf_size = width * height * sizeof(float);
     cle = clEnqueueFillBuffer(ctx->command_queue, ctx->weight,
@@ -264,11 +268,17 @@ static int nlmeans_plane(AVFilterContext *avctx, cl_mem dst, cl_mem src,
     }
     av_freep(&dxdy);
 
-    // average
+    // average, and blend with the previous output if there is one
+    t = prev ? ctx->temporal : 0.0f;
+    if (!prev)
+        prev = src;
     CL_SET_KERNEL_ARG(ctx->average_kernel, 0, cl_mem, &dst);
     CL_SET_KERNEL_ARG(ctx->average_kernel, 1, cl_mem, &src);
     CL_SET_KERNEL_ARG(ctx->average_kernel, 2, cl_mem, &ctx->sum);
     CL_SET_KERNEL_ARG(ctx->average_kernel, 3, cl_mem, &ctx->weight);
+    CL_SET_KERNEL_ARG(ctx->average_kernel, 4, cl_mem, &prev);
+    CL_SET_KERNEL_ARG(ctx->average_kernel, 5, cl_float, &t);
+    CL_SET_KERNEL_ARG(ctx->average_kernel, 6, cl_float, &ctx->temporal_thresh);
     cle = clEnqueueNDRangeKernel(ctx->command_queue, ctx->average_kernel, 2,
                                  NULL, worksize3, NULL, 0, NULL, NULL);
     CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to enqueue average kernel: %d.\n",
@@ -292,7 +302,7 @@ static int nlmeans_opencl_filter_frame(AVFilterLink *inlink, AVFrame *input)
     AVHWFramesContext *input_frames_ctx;
     const AVPixFmtDescriptor *desc;
     enum AVPixelFormat in_format;
-    cl_mem src, dst;
+    cl_mem src, dst, prev;
     const cl_int zero = 0;
     int w, h, err, cle, overflow, p, patch, research;
 
@@ -347,7 +357,8 @@ static int nlmeans_opencl_filter_frame(AVFilterLink *inlink, AVFrame *input)
         h = p ? ctx->chroma_h : inlink->h;
         patch = (p ? ctx->patch_size_uv : ctx->patch_size) / 2;
         research = (p ? ctx->research_size_uv : ctx->research_size) / 2;
-        err = nlmeans_plane(avctx, dst, src, w, h, patch, research);
+        prev = ctx->prev ? (cl_mem) ctx->prev->data[p] : NULL;
+        err = nlmeans_plane(avctx, dst, src, prev, w, h, patch, research);
         if (err < 0)
             goto fail;
     }
@@ -364,6 +375,15 @@ static int nlmeans_opencl_filter_frame(AVFilterLink *inlink, AVFrame *input)
 
     av_frame_free(&input);
 
+    if (ctx->temporal > 0.0f) {
+        av_frame_free(&ctx->prev);
+        ctx->prev = av_frame_clone(output);
+        if (!ctx->prev) {
+            err = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+
     av_log(ctx, AV_LOG_DEBUG, "Filter output: %s, %ux%u (%"PRId64").\n",
            av_get_pix_fmt_name(output->format),
            output->width, output->height, output->pts);
@@ -394,6 +414,8 @@ static av_cold void nlmeans_opencl_uninit(AVFilterContext *avctx)
 
     CL_RELEASE_QUEUE(ctx->command_queue);
 
+    av_frame_free(&ctx->prev);
+
     ff_opencl_filter_uninit(avctx);
 }
 
@@ -405,6 +427,8 @@ static const AVOption nlmeans_opencl_options[] = {
     { "pc", "patch size for chroma planes", OFFSET(patch_size_uv), AV_OPT_TYPE_INT, { .i64 = 0 },     0, 99, FLAGS },
     { "r",  "research window",                   OFFSET(research_size),    AV_OPT_TYPE_INT, { .i64 = 7*2+1 }, 0, 99, FLAGS },
     { "rc", "research window for chroma planes", OFFSET(research_size_uv), AV_OPT_TYPE_INT, { .i64 = 0 },     0, 99, FLAGS },
+    { "t",  "temporal strength",  OFFSET(temporal),        AV_OPT_TYPE_FLOAT, { .dbl = 0.0 },  0.0,  0.9, FLAGS },
+    { "tt", "temporal threshold", OFFSET(temporal_thresh), AV_OPT_TYPE_FLOAT, { .dbl = 10.0 }, 1.0, 255.0, FLAGS },
     { NULL }
 };
 
@@ -32,6 +32,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/timestamp.h"
@@ -87,6 +88,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     ff_framesync_uninit(&s->fs);
     av_expr_free(s->x_pexpr); s->x_pexpr = NULL;
     av_expr_free(s->y_pexpr); s->y_pexpr = NULL;
+    av_freep(&s->bbox_spans); //PLEX
 }
 
 static inline int normalize_xy(double d, int chroma_sub)
@@ -448,6 +450,25 @@ static av_always_inline void blend_slice_packed_rgb(AVFilterContext *ctx,
     }
 }
 
+//PLEX
+/* Range [*k0, *k1) of the samples in row j of a plane of the cropped overlay
+ * whose alpha, as read by blend_plane, is not all zero. The second alpha row
+ * of subsampled planes is read linesize samples down, i.e. next rows. */
+static av_always_inline void row_span(const OverlayContext *s, int src_hp, int j,
+                                      int hsub, int vsub, int next, int *k0, int *k1)
+{
+    const int (*span)[2] = s->bbox_spans + s->bbox_y + (j << vsub);
+    int x0 = span[0][0], x1 = span[0][1];
+
+    if (vsub && j + 1 < src_hp) {
+        x0 = FFMIN(x0, span[next][0]);
+        x1 = FFMAX(x1, span[next][1]);
+    }
+    *k0 = (x0 - s->bbox_x) >> hsub;
+    *k1 = x0 < x1 ? ((x1 - 1 - s->bbox_x) >> hsub) + 1 : *k0;
+}
+//PLEX
+
 #define DEFINE_BLEND_PLANE(depth, nbits)                                                                   \
 static av_always_inline void blend_plane_##depth##_##nbits##bits(AVFilterContext *ctx,                     \
                                          AVFrame *dst, const AVFrame *src,                                 \
@@ -477,6 +498,8 @@ static av_always_inline void blend_plane_##depth##_##nbits##bits(AVFilterContext
     const uint##depth##_t max = (1 << nbits) - 1;                                                          \
     const uint##depth##_t mid = (1 << (nbits -1)) ;                                                        \
     int bytes = depth / 8;                                                                                 \
+    /* samples covered by 8 bytes of alpha */                                                              \
+    const int span = (8 / bytes) >> hsub;                                                                  \
                                                                                                            \
     dst_step /= bytes;                                                                                     \
     j = FFMAX(-yp, 0);                                                                                     \
@@ -499,8 +522,21 @@ static av_always_inline void blend_plane_##depth##_##nbits##bits(AVFilterContext
         a = ap + (k<<hsub);                                                                                \
         da = dap + ((xp+k) << hsub);                                                                       \
         kmax = FFMIN(-xp + dst_wp, src_wp);                                                                \
+        /* PLEX: only blend the non-transparent columns of this row */                                     \
+        if (straight && octx->overlay_has_alpha) {                                                         \
+            int k0, k1;                                                                                    \
+            row_span(octx, src_hp, j, hsub, vsub, bytes, &k0, &k1);                                        \
+            if (k0 > k) {                                                                                  \
+                s  += k0 - k;                                                                              \
+                d  += dst_step * (k0 - k);                                                                 \
+                da += (k0 - k) << hsub;                                                                    \
+                a  += (k0 - k) << hsub;                                                                    \
+                k   = k0;                                                                                  \
+            }                                                                                              \
+            kmax = FFMIN(kmax, k1);                                                                        \
+        }                                                                                                  \
                                                                                                            \
-        if (nbits == 8 && ((vsub && j+1 < src_hp) || !vsub) && octx->blend_row[i]) {                       \
+        if (nbits == 8 && k < kmax && ((vsub && j+1 < src_hp) || !vsub) && octx->blend_row[i]) {                       \
             int c = octx->blend_row[i]((uint8_t*)d, (uint8_t*)da, (uint8_t*)s,                             \
                     (uint8_t*)a, kmax - k, src->linesize[3]);                                              \
                                                                                                            \
@@ -513,6 +549,18 @@ static av_always_inline void blend_plane_##depth##_##nbits##bits(AVFilterContext
         for (; k < kmax; k++) {                                                                            \
             int alpha_v, alpha_h, alpha;                                                                   \
                                                                                                            \
+            /* PLEX: skip transparent spans, which leave straight alpha blending unchanged */              \
+            while (straight && k + span <= kmax && ((k + span) << hsub) <= src_w &&                        \
+                   !AV_RN64(a) && (!vsub || j + 1 >= src_hp || !AV_RN64(a + src->linesize[3]))) {          \
+                s  += span;                                                                                \
+                d  += dst_step * span;                                                                     \
+                da += span << hsub;                                                                        \
+                a  += span << hsub;                                                                        \
+                k  += span;                                                                                \
+            }                                                                                              \
+            if (k >= kmax)                                                                                 \
+                break;                                                                                     \
+                                                                                                           \
             /* average alpha for color components, improve quality */                                      \
             if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {                                            \
                 alpha = (a[0] + a[src->linesize[3]] +                                                      \
@@ -1029,12 +1077,111 @@ end:
     return 0;
 }
 
+//PLEX
+/* Find the smallest area of the overlay frame, aligned to its chroma
+ * subsampling, outside of which it is fully transparent. */
+static int update_bbox(OverlayContext *s, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    const AVComponentDescriptor *a = &desc->comp[3];
+    int x0 = frame->width, x1 = 0, y0 = frame->height, y1 = 0;
+
+    av_fast_malloc(&s->bbox_spans, &s->bbox_spans_size,
+                   frame->height * sizeof(*s->bbox_spans));
+    if (!s->bbox_spans) {
+        s->bbox_data = NULL;
+        return AVERROR(ENOMEM);
+    }
+    s->bbox_data = frame->data[0];
+    s->bbox_pts  = frame->pts;
+
+    for (int y = 0; y < frame->height; y++) {
+        const uint8_t *row = frame->data[a->plane] + y * frame->linesize[a->plane] + a->offset;
+        int first = -1, last = -1;
+
+        if (a->depth <= 8) {
+            for (int x = 0; x < frame->width && first < 0; x++)
+                if (row[x * a->step])
+                    first = x;
+            for (int x = frame->width - 1; x > first && first >= 0 && last < 0; x--)
+                if (row[x * a->step])
+                    last = x;
+        } else {
+            for (int x = 0; x < frame->width && first < 0; x++)
+                if (AV_RN16(row + x * a->step))
+                    first = x;
+            for (int x = frame->width - 1; x > first && first >= 0 && last < 0; x--)
+                if (AV_RN16(row + x * a->step))
+                    last = x;
+        }
+        s->bbox_spans[y][0] = first < 0 ? frame->width : first;
+        s->bbox_spans[y][1] = first < 0 ? 0 : FFMAX(first, last) + 1;
+        if (first < 0)
+            continue;
+        x0 = FFMIN(x0, first);
+        x1 = FFMAX(x1, FFMAX(first, last) + 1);
+        y0 = FFMIN(y0, y);
+        y1 = y + 1;
+    }
+
+    if (x0 >= x1) {
+        s->bbox_x = s->bbox_y = s->bbox_w = s->bbox_h = 0;
+        return 0;
+    }
+    /* chroma alpha is averaged differently in the last chroma row and
+     * column, keep a transparent one after the content */
+    x0 &= ~((1 << desc->log2_chroma_w) - 1);
+    y0 &= ~((1 << desc->log2_chroma_h) - 1);
+    x1  = FFALIGN(x1, 1 << desc->log2_chroma_w) + (desc->log2_chroma_w ? 1 << desc->log2_chroma_w : 0);
+    y1  = FFALIGN(y1, 1 << desc->log2_chroma_h) + (desc->log2_chroma_h ? 1 << desc->log2_chroma_h : 0);
+    x1  = FFMIN(x1, frame->width);
+    y1  = FFMIN(y1, frame->height);
+    s->bbox_x = x0;
+    s->bbox_y = y0;
+    s->bbox_w = x1 - x0;
+    s->bbox_h = y1 - y0;
+    return 0;
+}
+
+/* Restrict the overlay frame to its non-transparent area, which is all that
+ * changes the main frame with straight alpha. Mostly transparent overlays,
+ * like subtitle canvases, are then blended at the cost of their content.
+ * Returns 0 if there is nothing to blend, a negative error code on failure. */
+static int crop_to_bbox(OverlayContext *s, AVFrame *crop, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int ret;
+
+    if (frame->data[0] != s->bbox_data || frame->pts != s->bbox_pts) {
+        ret = update_bbox(s, frame);
+        if (ret < 0)
+            return ret;
+    }
+    if (!s->bbox_w || !s->bbox_h)
+        return 0;
+
+    *crop = *frame;
+    crop->width  = s->bbox_w;
+    crop->height = s->bbox_h;
+    for (int i = 0; i < 4 && crop->data[i]; i++) {
+        int hsub = (i == 1 || i == 2) ? desc->log2_chroma_w : 0;
+        int vsub = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+
+        crop->data[i] += (s->bbox_y >> vsub) * crop->linesize[i] +
+                         (s->bbox_x >> hsub) * s->overlay_pix_step[i];
+    }
+    return 1;
+}
+//PLEX
+
 static int do_blend(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
     AVFrame *mainpic, *second;
     OverlayContext *s = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
+    AVFrame crop; //PLEX
+    int x = 0, y = 0; //PLEX
     int ret;
 
     ret = ff_framesync_dualinput_get_writable(fs, &mainpic, &second);
@@ -1069,6 +1216,24 @@ FF_ENABLE_DEPRECATION_WARNINGS
                s->var_values[VAR_Y], s->y);
     }
 
+    //PLEX
+    if (s->overlay_has_alpha && !s->alpha_format) {
+        ret = crop_to_bbox(s, &crop, second);
+        if (ret <= 0) {
+            if (ret < 0) {
+                av_frame_free(&mainpic);
+                return ret;
+            }
+            return ff_filter_frame(ctx->outputs[0], mainpic);
+        }
+        second = &crop;
+        x = s->x;
+        y = s->y;
+        s->x += s->bbox_x;
+        s->y += s->bbox_y;
+    }
+    //PLEX
+
     if (s->x < mainpic->width  && s->x + second->width  >= 0 &&
         s->y < mainpic->height && s->y + second->height >= 0) {
         ThreadData td;
@@ -1078,6 +1243,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
         ff_filter_execute(ctx, s->blend_slice, &td, NULL, FFMIN(FFMAX(1, FFMIN3(s->y + second->height, FFMIN(second->height, mainpic->height), mainpic->height - s->y)),
                                                                 ff_filter_get_nb_threads(ctx)));
     }
+
+    //PLEX
+    if (second == &crop) {
+        s->x = x;
+        s->y = y;
+    }
+    //PLEX
     return ff_filter_frame(ctx->outputs[0], mainpic);
 }
 
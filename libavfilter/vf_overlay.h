@@ -83,6 +83,16 @@ typedef struct OverlayContext {
     int (*blend_row[4])(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a, int w,
                         ptrdiff_t alinesize);
     int (*blend_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
+
+    //PLEX
+    /* non-transparent area of the last overlay frame, empty if w or h is 0 */
+    const uint8_t *bbox_data;
+    int64_t bbox_pts;
+    int bbox_x, bbox_y, bbox_w, bbox_h;
+    /* per overlay row, non-transparent columns [first, last + 1), first >= last if none */
+    int (*bbox_spans)[2];
+    unsigned int bbox_spans_size;
+    //PLEX
 } OverlayContext;
 
 void ff_overlay_init_x86(OverlayContext *s, int format, int pix_format,
@@ -0,0 +1,547 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Run the filters of a chain concurrently on successive frames.
+ *
+ * Each filter of the chain runs in a private graph with its own thread, and
+ * frames move between the stages through bounded queues. The last stage
+ * hands its frames to an unbounded queue which is emptied by the filter, so
+ * that a stage can only wait for the next one and the pipeline cannot lock.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/fifo.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+
+#include "avfilter.h"
+#include "buffersink.h"
+#include "buffersrc.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+typedef struct PipelineStage {
+    struct PipelineContext *s;
+    int index;
+    char *desc;
+
+    AVFilterGraph *graph;
+    AVFilterContext *src, *sink;
+    AVThreadMessageQueue *queue;    ///< frames waiting for this stage
+
+    pthread_t thread;
+    int thread_started;
+} PipelineStage;
+
+typedef struct PipelineContext {
+    const AVClass *class;
+    char *filters;
+    int queue_size;
+
+    PipelineStage *stages;
+    int nb_stages;
+
+    /* output of the last stage */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    AVFifo *out;
+    int out_status;
+
+    int eof;
+    int64_t eof_pts;
+    int64_t next_pts;
+} PipelineContext;
+
+static void free_frame(void *arg)
+{
+    av_frame_free(arg);
+}
+
+/* Split the chain at the commas separating its filters, keeping the quoting
+ * and escaping of their arguments. */
+static int split_stages(AVFilterContext *ctx)
+{
+    PipelineContext *s = ctx->priv;
+    const char *start = s->filters, *p;
+    int quoted = 0;
+
+    for (p = s->filters; ; p++) {
+        if (quoted) {
+            if (!*p)
+                break;
+            if (*p == '\'')
+                quoted = 0;
+        } else if (*p == '\\' && p[1]) {
+            p++;
+        } else if (*p == '\'') {
+            quoted = 1;
+        } else if (!*p || *p == ',') {
+            PipelineStage *st;
+            char *desc = av_strndup(start, p - start);
+
+            if (!desc)
+                return AVERROR(ENOMEM);
+            if (!desc[strspn(desc, " \t\n\r")]) {
+                av_log(ctx, AV_LOG_ERROR, "Empty filter in the pipeline\n");
+                av_free(desc);
+                return AVERROR(EINVAL);
+            }
+            st = av_realloc_array(s->stages, s->nb_stages + 1, sizeof(*s->stages));
+            if (!st) {
+                av_free(desc);
+                return AVERROR(ENOMEM);
+            }
+            s->stages = st;
+            st = &s->stages[s->nb_stages];
+            memset(st, 0, sizeof(*st));
+            st->s     = s;
+            st->index = s->nb_stages++;
+            st->desc  = desc;
+
+            if (!*p)
+                break;
+            start = p + 1;
+        }
+    }
+
+    if (quoted) {
+        av_log(ctx, AV_LOG_ERROR, "Unterminated quote in the pipeline\n");
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+static int build_stage(AVFilterContext *ctx, PipelineStage *st)
+{
+    PipelineContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFilterContext *prev = st->index ? s->stages[st->index - 1].sink : NULL;
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    AVBufferSrcParameters *par;
+    int ret;
+
+    st->graph = avfilter_graph_alloc();
+    par = av_buffersrc_parameters_alloc();
+    if (!st->graph || !par) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    st->graph->nb_threads = ff_filter_get_nb_threads(ctx);
+    if (ctx->graph->scale_sws_opts &&
+        !(st->graph->scale_sws_opts = av_strdup(ctx->graph->scale_sws_opts))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = avfilter_graph_parse2(st->graph, st->desc, &inputs, &outputs)) < 0)
+        goto fail;
+    if (!inputs || inputs->next || !outputs || outputs->next ||
+        avfilter_pad_get_type(inputs->filter_ctx->input_pads, inputs->pad_idx) != AVMEDIA_TYPE_VIDEO ||
+        avfilter_pad_get_type(outputs->filter_ctx->output_pads, outputs->pad_idx) != AVMEDIA_TYPE_VIDEO) {
+        av_log(ctx, AV_LOG_ERROR, "Pipeline stage '%s' must have one video input and output\n",
+               st->desc);
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    if (ctx->hw_device_ctx) {
+        for (int i = 0; i < st->graph->nb_filters; i++) {
+            AVFilterContext *f = st->graph->filters[i];
+            if (!(f->hw_device_ctx = av_buffer_ref(ctx->hw_device_ctx))) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+        }
+    }
+
+    if (prev) {
+        par->format              = av_buffersink_get_format(prev);
+        par->width               = av_buffersink_get_w(prev);
+        par->height              = av_buffersink_get_h(prev);
+        par->time_base           = av_buffersink_get_time_base(prev);
+        par->frame_rate          = av_buffersink_get_frame_rate(prev);
+        par->sample_aspect_ratio = av_buffersink_get_sample_aspect_ratio(prev);
+        par->hw_frames_ctx       = av_buffersink_get_hw_frames_ctx(prev);
+    } else {
+        par->format              = inlink->format;
+        par->width               = inlink->w;
+        par->height              = inlink->h;
+        par->time_base           = inlink->time_base;
+        par->frame_rate          = inlink->frame_rate;
+        par->sample_aspect_ratio = inlink->sample_aspect_ratio;
+        par->hw_frames_ctx       = inlink->hw_frames_ctx;
+    }
+
+    st->src = avfilter_graph_alloc_filter(st->graph, avfilter_get_by_name("buffer"), "in");
+    if (!st->src) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = av_buffersrc_parameters_set(st->src, par)) < 0 ||
+        (ret = avfilter_init_str(st->src, NULL)) < 0)
+        goto fail;
+
+    if ((ret = avfilter_graph_create_filter(&st->sink, avfilter_get_by_name("buffersink"),
+                                            "out", NULL, NULL, st->graph)) < 0)
+        goto fail;
+    /* the last stage converts to the format negotiated for the output */
+    if (st->index == s->nb_stages - 1) {
+        enum AVPixelFormat pix_fmts[] = { outlink->format, AV_PIX_FMT_NONE };
+        if ((ret = av_opt_set_int_list(st->sink, "pix_fmts", pix_fmts,
+                                       AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN)) < 0)
+            goto fail;
+    }
+
+    if ((ret = avfilter_link(st->src, 0, inputs->filter_ctx, inputs->pad_idx)) < 0 ||
+        (ret = avfilter_link(outputs->filter_ctx, outputs->pad_idx, st->sink, 0)) < 0 ||
+        (ret = avfilter_graph_config(st->graph, ctx)) < 0)
+        goto fail;
+
+    ret = av_thread_message_queue_alloc(&st->queue, s->queue_size, sizeof(AVFrame *));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(st->queue, free_frame);
+
+fail:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    av_free(par);
+    return ret;
+}
+
+static int stage_output(PipelineStage *st, AVFrame *frame)
+{
+    PipelineContext *s = st->s;
+    int ret;
+
+    if (st->index < s->nb_stages - 1)
+        return av_thread_message_queue_send(s->stages[st->index + 1].queue, &frame, 0);
+
+    pthread_mutex_lock(&s->lock);
+    ret = av_fifo_write(s->out, &frame, 1);
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return ret;
+}
+
+/* Pass on every frame the stage has ready. */
+static int drain_stage(PipelineStage *st)
+{
+    int ret;
+
+    while (1) {
+        AVFrame *frame = av_frame_alloc();
+
+        if (!frame)
+            return AVERROR(ENOMEM);
+        if ((ret = av_buffersink_get_frame(st->sink, frame)) < 0) {
+            av_frame_free(&frame);
+            return ret == AVERROR(EAGAIN) ? 0 : ret;
+        }
+        if ((ret = stage_output(st, frame)) < 0) {
+            av_frame_free(&frame);
+            return ret;
+        }
+    }
+}
+
+static void *stage_thread(void *arg)
+{
+    PipelineStage *st = arg;
+    PipelineContext *s = st->s;
+    AVFrame *frame;
+    int ret;
+
+    while (1) {
+        ret = av_thread_message_queue_recv(st->queue, &frame, 0);
+        if (ret == AVERROR_EOF) {
+            if ((ret = av_buffersrc_add_frame(st->src, NULL)) >= 0)
+                ret = drain_stage(st);
+            break;
+        } else if (ret < 0) {
+            break;
+        }
+
+        ret = av_buffersrc_add_frame(st->src, frame);
+        av_frame_free(&frame);
+        if (ret < 0 || (ret = drain_stage(st)) < 0)
+            break;
+    }
+    if (ret >= 0)
+        ret = AVERROR_EOF;
+
+    /* no more frames from this stage, and none accepted any more */
+    av_thread_message_queue_set_err_send(st->queue, ret);
+    if (st->index < s->nb_stages - 1) {
+        av_thread_message_queue_set_err_recv(s->stages[st->index + 1].queue, ret);
+    } else {
+        pthread_mutex_lock(&s->lock);
+        s->out_status = ret;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    return NULL;
+}
+
+static int receive_output(PipelineContext *s, AVFrame **frame, int wait)
+{
+    int ret;
+
+    pthread_mutex_lock(&s->lock);
+    while (wait && !s->out_status && !av_fifo_can_read(s->out))
+        pthread_cond_wait(&s->cond, &s->lock);
+    if (av_fifo_read(s->out, frame, 1) >= 0)
+        ret = 0;
+    else
+        ret = s->out_status ? s->out_status : AVERROR(EAGAIN);
+    pthread_mutex_unlock(&s->lock);
+
+    return ret;
+}
+
+static void stop_stages(PipelineContext *s)
+{
+    AVFrame *frame;
+
+    for (int i = 0; i < s->nb_stages; i++) {
+        if (!s->stages[i].queue)
+            continue;
+        av_thread_message_queue_set_err_send(s->stages[i].queue, AVERROR_EOF);
+        av_thread_message_queue_set_err_recv(s->stages[i].queue, AVERROR_EOF);
+        av_thread_message_flush(s->stages[i].queue);
+    }
+    for (int i = 0; i < s->nb_stages; i++) {
+        PipelineStage *st = &s->stages[i];
+        if (st->thread_started)
+            pthread_join(st->thread, NULL);
+        st->thread_started = 0;
+        av_thread_message_queue_free(&st->queue);
+        avfilter_graph_free(&st->graph);
+        st->src = st->sink = NULL;
+    }
+
+    while (s->out && av_fifo_read(s->out, &frame, 1) >= 0)
+        av_frame_free(&frame);
+    s->out_status = 0;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    PipelineContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFrame *frame;
+    int64_t pts;
+    int ret, status;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    /* once the input is done, wait for the stages to finish */
+    ret = receive_output(s, &frame, s->eof);
+    if (ret >= 0) {
+        if (frame->pts != AV_NOPTS_VALUE)
+            s->next_pts = frame->pts + frame->duration;
+        ff_filter_set_ready(ctx, 100);
+        return ff_filter_frame(outlink, frame);
+    } else if (ret == AVERROR_EOF) {
+        ff_outlink_set_status(outlink, AVERROR_EOF,
+                              s->eof_pts != AV_NOPTS_VALUE ? s->eof_pts : s->next_pts);
+        return 0;
+    } else if (ret != AVERROR(EAGAIN)) {
+        return ret;
+    }
+
+    ret = ff_inlink_consume_frame(inlink, &frame);
+    if (ret < 0)
+        return ret;
+    if (ret > 0) {
+        /* waits while the first stage is full */
+        ret = av_thread_message_queue_send(s->stages[0].queue, &frame, 0);
+        if (ret < 0) {
+            av_frame_free(&frame);
+            if (ret != AVERROR_EOF)
+                return ret;
+            /* the stages do not want more input */
+            s->eof     = 1;
+            s->eof_pts = AV_NOPTS_VALUE;
+            ff_inlink_set_status(inlink, AVERROR_EOF);
+        }
+        ff_filter_set_ready(ctx, 100);
+        return 0;
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        s->eof     = 1;
+        s->eof_pts = av_rescale_q(pts, inlink->time_base, outlink->time_base);
+        av_thread_message_queue_set_err_recv(s->stages[0].queue, AVERROR_EOF);
+        ff_filter_set_ready(ctx, 100);
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    int ret;
+
+    /* the stages insert the conversions they need */
+    if ((ret = ff_formats_ref(ff_all_formats(AVMEDIA_TYPE_VIDEO),
+                              &ctx->inputs[0]->outcfg.formats)) < 0)
+        return ret;
+    return ff_formats_ref(ff_all_formats(AVMEDIA_TYPE_VIDEO),
+                          &ctx->outputs[0]->incfg.formats);
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    PipelineContext *s = ctx->priv;
+    AVFilterContext *sink;
+    AVBufferRef *hw_frames_ctx;
+    int ret;
+
+    stop_stages(s);
+    s->eof      = 0;
+    s->next_pts = AV_NOPTS_VALUE;
+
+    for (int i = 0; i < s->nb_stages; i++)
+        if ((ret = build_stage(ctx, &s->stages[i])) < 0)
+            return ret;
+
+    sink = s->stages[s->nb_stages - 1].sink;
+    outlink->w                   = av_buffersink_get_w(sink);
+    outlink->h                   = av_buffersink_get_h(sink);
+    outlink->time_base           = av_buffersink_get_time_base(sink);
+    outlink->frame_rate          = av_buffersink_get_frame_rate(sink);
+    outlink->sample_aspect_ratio = av_buffersink_get_sample_aspect_ratio(sink);
+
+    hw_frames_ctx = av_buffersink_get_hw_frames_ctx(sink);
+    if (hw_frames_ctx) {
+        av_buffer_unref(&outlink->hw_frames_ctx);
+        outlink->hw_frames_ctx = av_buffer_ref(hw_frames_ctx);
+        if (!outlink->hw_frames_ctx)
+            return AVERROR(ENOMEM);
+    }
+
+    for (int i = 0; i < s->nb_stages; i++) {
+        ret = pthread_create(&s->stages[i].thread, NULL, stage_thread, &s->stages[i]);
+        if (ret) {
+            av_log(ctx, AV_LOG_ERROR, "Failed to start the pipeline threads\n");
+            return AVERROR(ret);
+        }
+        s->stages[i].thread_started = 1;
+    }
+
+    av_log(ctx, AV_LOG_VERBOSE, "Running %d filters in parallel\n", s->nb_stages);
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    PipelineContext *s = ctx->priv;
+    int ret;
+
+    if (!s->filters) {
+        av_log(ctx, AV_LOG_ERROR, "No filters given\n");
+        return AVERROR(EINVAL);
+    }
+    if ((ret = split_stages(ctx)) < 0)
+        return ret;
+
+    s->out = av_fifo_alloc2(s->queue_size, sizeof(AVFrame *), AV_FIFO_FLAG_AUTO_GROW);
+    if (!s->out)
+        return AVERROR(ENOMEM);
+    if ((ret = pthread_mutex_init(&s->lock, NULL))) {
+        av_fifo_freep2(&s->out);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&s->cond, NULL))) {
+        pthread_mutex_destroy(&s->lock);
+        av_fifo_freep2(&s->out);
+        return AVERROR(ret);
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    PipelineContext *s = ctx->priv;
+
+    if (s->out) {
+        stop_stages(s);
+        av_fifo_freep2(&s->out);
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->lock);
+    }
+    for (int i = 0; i < s->nb_stages; i++)
+        av_freep(&s->stages[i].desc);
+    av_freep(&s->stages);
+    s->nb_stages = 0;
+}
+
+#define OFFSET(x) offsetof(PipelineContext, x)
+#define FLAGS (AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM)
+
+static const AVOption pipeline_options[] = {
+    { "filters",    "set the filter chain to run in parallel", OFFSET(filters),    AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0,  FLAGS },
+    { "queue_size", "set the number of frames queued for each filter", OFFSET(queue_size), AV_OPT_TYPE_INT, { .i64 = 2 }, 1, 64, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(pipeline);
+
+static const AVFilterPad pipeline_inputs[] = {
+    {
+        .name = "default",
+        .type = AVMEDIA_TYPE_VIDEO,
+    },
+};
+
+static const AVFilterPad pipeline_outputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_output,
+    },
+};
+
+const AVFilter ff_vf_pipeline = {
+    .name           = "pipeline",
+    .description    = NULL_IF_CONFIG_SMALL("Run the filters of a chain in parallel on successive frames."),
+    .priv_size      = sizeof(PipelineContext),
+    .priv_class     = &pipeline_class,
+    .init           = init,
+    .uninit         = uninit,
+    .activate       = activate,
+    FILTER_INPUTS(pipeline_inputs),
+    FILTER_OUTPUTS(pipeline_outputs),
+    FILTER_QUERY_FUNC(query_formats),
+    .flags_internal = FF_FILTER_FLAG_HWFRAME_AWARE,
+};
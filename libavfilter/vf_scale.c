@@ -727,6 +727,17 @@ static int scale_frame(AVFilterLink *link, AVFrame *in, AVFrame **frame_out)
     if (in->colorspace == AVCOL_SPC_YCGCO)
         av_log(link->dst, AV_LOG_WARNING, "Detected unsupported YCgCo colorspace.\n");
 
+    //PLEX
+    /* cropping exported upstream, e.g. by cropdetect=set_crop=1 */
+    if (in->crop_top || in->crop_bottom || in->crop_left || in->crop_right) {
+        ret = av_frame_apply_cropping(in, AV_FRAME_CROP_UNALIGNED);
+        if (ret < 0) {
+            av_frame_free(&in);
+            return ret;
+        }
+    }
+    //PLEX
+
     frame_changed = in->width  != link->w ||
                     in->height != link->h ||
                     in->format != link->format ||
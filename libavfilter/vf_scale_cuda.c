@@ -24,6 +24,7 @@
 #include <stdio.h>
 
 #include "libavutil/common.h"
+#include "libavutil/csp.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/hwcontext_cuda_internal.h"
 #include "libavutil/cuda_check.h"
@@ -32,6 +33,7 @@
 #include "libavutil/pixdesc.h"
 
 #include "avfilter.h"
+#include "colorspace.h"
 #include "internal.h"
 #include "scale_eval.h"
 #include "video.h"
@@ -108,6 +110,18 @@ typedef struct CUDAScaleContext {
     int interp_as_integer;
 
     float param;
+
+    //PLEX
+    int   tonemap;
+    float tonemap_param;
+    float tonemap_desat;
+    float tonemap_peak;
+    ScaleCudaTonemapParams tm;
+    enum AVColorSpace tm_colorspace;
+    enum AVColorPrimaries tm_primaries;
+    enum AVColorTransferCharacteristic tm_trc;
+    enum AVColorRange tm_range;
+    //PLEX
 } CUDAScaleContext;
 
 static av_cold int cudascale_init(AVFilterContext *ctx)
@@ -122,6 +136,26 @@ static av_cold int cudascale_init(AVFilterContext *ctx)
     if (!s->tmp_frame)
         return AVERROR(ENOMEM);
 
+    //PLEX
+    switch (s->tonemap) {
+    case SCALE_CUDA_TONEMAP_GAMMA:
+        if (isnan(s->tonemap_param))
+            s->tonemap_param = 1.8f;
+        break;
+    case SCALE_CUDA_TONEMAP_REINHARD:
+        if (!isnan(s->tonemap_param))
+            s->tonemap_param = (1.0f - s->tonemap_param) / s->tonemap_param;
+        break;
+    case SCALE_CUDA_TONEMAP_MOBIUS:
+        if (isnan(s->tonemap_param))
+            s->tonemap_param = 0.3f;
+        break;
+    }
+    if (isnan(s->tonemap_param))
+        s->tonemap_param = 1.0f;
+    s->tm_colorspace = AVCOL_SPC_NB;
+    //PLEX
+
     return 0;
 }
 
@@ -237,6 +271,18 @@ static av_cold int init_processing_chain(AVFilterContext *ctx, int in_width, int
     in_format     = in_frames_ctx->sw_format;
     out_format    = (s->format == AV_PIX_FMT_NONE) ? in_format : s->format;
 
+    //PLEX
+    if (s->tonemap >= 0) {
+        if (s->format == AV_PIX_FMT_NONE)
+            out_format = AV_PIX_FMT_NV12;
+        if (in_format != AV_PIX_FMT_P010 || out_format != AV_PIX_FMT_NV12) {
+            av_log(ctx, AV_LOG_ERROR, "Tonemapping is only supported from p010 to nv12\n");
+            return AVERROR(ENOSYS);
+        }
+        s->passthrough = 0;
+    }
+    //PLEX
+
     if (!format_is_supported(in_format)) {
         av_log(ctx, AV_LOG_ERROR, "Unsupported input format: %s\n",
                av_get_pix_fmt_name(in_format));
@@ -325,6 +371,14 @@ static av_cold int cudascale_load_functions(AVFilterContext *ctx)
     if (ret < 0)
         goto fail;
 
+    //PLEX
+    if (s->tonemap >= 0) {
+        snprintf(buf, sizeof(buf), "Tonemap_%s_%s_%s", function_infix, in_fmt_name, out_fmt_name);
+        ret = CHECK_CU(cu->cuModuleGetFunction(&s->cu_func, s->cu_module, buf));
+        goto fail;
+    }
+    //PLEX
+
     snprintf(buf, sizeof(buf), "Subsample_%s_%s_%s", function_infix, in_fmt_name, out_fmt_name);
     ret = CHECK_CU(cu->cuModuleGetFunction(&s->cu_func, s->cu_module, buf));
     if (ret < 0) {
@@ -424,6 +478,114 @@ static int call_resize_kernel(AVFilterContext *ctx, CUfunction func,
                                        BLOCKX, BLOCKY, 1, 0, s->cu_stream, args_uchar, NULL));
 }
 
+//PLEX
+static void tonemap_fill_matrix(float dst[9], const double src[3][3])
+{
+    for (int i = 0; i < 9; i++)
+        dst[i] = src[i / 3][i % 3];
+}
+
+/* Derive the kernel parameters from the colour properties of the input,
+ * converting to BT.709 SDR. */
+static int tonemap_update_params(AVFilterContext *ctx, AVFrame *in)
+{
+    CUDAScaleContext *s = ctx->priv;
+    ScaleCudaTonemapParams *tm = &s->tm;
+    const AVLumaCoefficients *luma_src, *luma_dst;
+    const AVColorPrimariesDesc *prim_src, *prim_dst;
+    double rgb2yuv[3][3], yuv2rgb[3][3], rgb2xyz[3][3], xyz2rgb[3][3], rgb2rgb[3][3];
+    double peak = s->tonemap_peak;
+
+    if (in->color_trc != AVCOL_TRC_SMPTE2084 && in->color_trc != AVCOL_TRC_ARIB_STD_B67) {
+        av_log(ctx, AV_LOG_ERROR, "Unsupported input transfer characteristic %s\n",
+               av_color_transfer_name(in->color_trc));
+        return AVERROR(EINVAL);
+    }
+
+    if (peak <= 0)
+        peak = ff_determine_signal_peak(in);
+    tm->peak  = peak;
+    tm->algo  = s->tonemap;
+    tm->param = s->tonemap_param;
+    tm->desat = s->tonemap_desat;
+    tm->hlg   = in->color_trc == AVCOL_TRC_ARIB_STD_B67;
+    /* BT.2100 system gamma for the nominal peak luminance of the display */
+    tm->hlg_gamma = FFMAX(1.2 + 0.42 * log10(peak * REFERENCE_WHITE / 1000.0), 1.0);
+
+    if (in->colorspace  == s->tm_colorspace &&
+        in->color_primaries == s->tm_primaries &&
+        in->color_trc   == s->tm_trc &&
+        in->color_range == s->tm_range)
+        return 0;
+
+    luma_src = av_csp_luma_coeffs_from_avcsp(in->colorspace == AVCOL_SPC_UNSPECIFIED ?
+                                             AVCOL_SPC_BT2020_NCL : in->colorspace);
+    prim_src = av_csp_primaries_desc_from_id(in->color_primaries == AVCOL_PRI_UNSPECIFIED ?
+                                             AVCOL_PRI_BT2020 : in->color_primaries);
+    luma_dst = av_csp_luma_coeffs_from_avcsp(AVCOL_SPC_BT709);
+    prim_dst = av_csp_primaries_desc_from_id(AVCOL_PRI_BT709);
+    if (!luma_src || !prim_src) {
+        av_log(ctx, AV_LOG_ERROR, "Unsupported input colorspace %s/%s\n",
+               av_color_space_name(in->colorspace),
+               av_color_primaries_name(in->color_primaries));
+        return AVERROR(EINVAL);
+    }
+
+    ff_fill_rgb2yuv_table(luma_src, rgb2yuv);
+    ff_matrix_invert_3x3(rgb2yuv, yuv2rgb);
+    tonemap_fill_matrix(tm->yuv2rgb, yuv2rgb);
+    tm->luma_src[0] = av_q2d(luma_src->cr);
+    tm->luma_src[1] = av_q2d(luma_src->cg);
+    tm->luma_src[2] = av_q2d(luma_src->cb);
+
+    ff_fill_rgb2xyz_table(&prim_dst->prim, &prim_dst->wp, rgb2xyz);
+    ff_matrix_invert_3x3(rgb2xyz, xyz2rgb);
+    ff_fill_rgb2xyz_table(&prim_src->prim, &prim_src->wp, rgb2xyz);
+    ff_matrix_mul_3x3(rgb2rgb, rgb2xyz, xyz2rgb);
+    tonemap_fill_matrix(tm->rgb2rgb, rgb2rgb);
+
+    ff_fill_rgb2yuv_table(luma_dst, rgb2yuv);
+    tonemap_fill_matrix(tm->rgb2yuv, rgb2yuv);
+    tm->luma_dst[0] = av_q2d(luma_dst->cr);
+    tm->luma_dst[1] = av_q2d(luma_dst->cg);
+    tm->luma_dst[2] = av_q2d(luma_dst->cb);
+
+    tm->full_range_in  = in->color_range == AVCOL_RANGE_JPEG;
+    tm->full_range_out = 0;
+
+    s->tm_colorspace = in->colorspace;
+    s->tm_primaries  = in->color_primaries;
+    s->tm_trc        = in->color_trc;
+    s->tm_range      = in->color_range;
+    return 0;
+}
+
+static int call_tonemap_kernel(AVFilterContext *ctx, CUtexObject src_tex[4],
+                               AVFrame *out, AVFrame *in)
+{
+    CUDAScaleContext *s = ctx->priv;
+    CudaFunctions *cu = s->hwctx->internal->cuda_dl;
+    CUdeviceptr dst_devptr[2] = {
+        (CUdeviceptr)out->data[0], (CUdeviceptr)out->data[1]
+    };
+    int dst_width = out->width, dst_height = out->height;
+    int dst_pitch_0 = out->linesize[0], dst_pitch_1 = out->linesize[1];
+    int src_width = in->width, src_height = in->height;
+
+    void *args[] = {
+        &src_tex[0], &src_tex[1], &dst_devptr[0], &dst_devptr[1],
+        &dst_width, &dst_height, &dst_pitch_0, &dst_pitch_1,
+        &src_width, &src_height, &s->param, &s->tm
+    };
+
+    /* one thread per chroma sample and the 2x2 luma samples around it */
+    return CHECK_CU(cu->cuLaunchKernel(s->cu_func,
+                                       DIV_UP(AV_CEIL_RSHIFT(dst_width, 1), BLOCKX),
+                                       DIV_UP(AV_CEIL_RSHIFT(dst_height, 1), BLOCKY), 1,
+                                       BLOCKX, BLOCKY, 1, 0, s->cu_stream, args, NULL));
+}
+//PLEX
+
 static int scalecuda_resize(AVFilterContext *ctx,
                             AVFrame *out, AVFrame *in)
 {
@@ -469,6 +631,13 @@ static int scalecuda_resize(AVFilterContext *ctx,
             goto exit;
     }
 
+    //PLEX
+    if (s->tonemap >= 0) {
+        ret = call_tonemap_kernel(ctx, tex, out, in);
+        goto exit;
+    }
+    //PLEX
+
     // scale primary plane(s). Usually Y (and A), or single plane of RGB frames.
     ret = call_resize_kernel(ctx, s->cu_func,
                              tex, in->width, in->height,
@@ -548,6 +717,11 @@ static int cudascale_filter_frame(AVFilterLink *link, AVFrame *in)
         goto fail;
     }
 
+    //PLEX
+    if (s->tonemap >= 0 && (ret = tonemap_update_params(ctx, in)) < 0)
+        goto fail;
+    //PLEX
+
     ret = CHECK_CU(cu->cuCtxPushCurrent(s->hwctx->cuda_ctx));
     if (ret < 0)
         goto fail;
@@ -558,6 +732,16 @@ static int cudascale_filter_frame(AVFilterLink *link, AVFrame *in)
     if (ret < 0)
         goto fail;
 
+    //PLEX
+    if (s->tonemap >= 0) {
+        out->color_trc       = AVCOL_TRC_BT709;
+        out->color_primaries = AVCOL_PRI_BT709;
+        out->colorspace      = AVCOL_SPC_BT709;
+        out->color_range     = AVCOL_RANGE_MPEG;
+        ff_update_hdr_metadata(out, 1.0);
+    }
+    //PLEX
+
     av_reduce(&out->sample_aspect_ratio.num, &out->sample_aspect_ratio.den,
               (int64_t)in->sample_aspect_ratio.num * outlink->h * link->w,
               (int64_t)in->sample_aspect_ratio.den * outlink->w * link->h,
@@ -598,6 +782,19 @@ static const AVOption options[] = {
         { "decrease", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = 1 }, 0, 0, FLAGS, "force_oar" },
         { "increase", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = 2 }, 0, 0, FLAGS, "force_oar" },
     { "force_divisible_by", "enforce that the output resolution is divisible by a defined integer when force_original_aspect_ratio is used", OFFSET(force_divisible_by), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 256, FLAGS },
+    //PLEX
+    { "tonemap", "Tonemap HDR input to SDR while scaling", OFFSET(tonemap), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, SCALE_CUDA_TONEMAP_MAX - 1, FLAGS, "tonemap" },
+        { "none",     "no curve, only convert the transfer and primaries", 0, AV_OPT_TYPE_CONST, { .i64 = SCALE_CUDA_TONEMAP_NONE     }, 0, 0, FLAGS, "tonemap" },
+        { "linear",   "linear stretch",        0, AV_OPT_TYPE_CONST, { .i64 = SCALE_CUDA_TONEMAP_LINEAR   }, 0, 0, FLAGS, "tonemap" },
+        { "gamma",    "logarithmic curve",     0, AV_OPT_TYPE_CONST, { .i64 = SCALE_CUDA_TONEMAP_GAMMA    }, 0, 0, FLAGS, "tonemap" },
+        { "clip",     "hard clip",             0, AV_OPT_TYPE_CONST, { .i64 = SCALE_CUDA_TONEMAP_CLIP     }, 0, 0, FLAGS, "tonemap" },
+        { "reinhard", "simple Reinhard curve", 0, AV_OPT_TYPE_CONST, { .i64 = SCALE_CUDA_TONEMAP_REINHARD }, 0, 0, FLAGS, "tonemap" },
+        { "hable",    "filmic Hable curve",    0, AV_OPT_TYPE_CONST, { .i64 = SCALE_CUDA_TONEMAP_HABLE    }, 0, 0, FLAGS, "tonemap" },
+        { "mobius",   "Mobius curve",          0, AV_OPT_TYPE_CONST, { .i64 = SCALE_CUDA_TONEMAP_MOBIUS   }, 0, 0, FLAGS, "tonemap" },
+    { "tonemap_param", "Tonemap parameter", OFFSET(tonemap_param), AV_OPT_TYPE_FLOAT, { .dbl = NAN }, DBL_MIN, DBL_MAX, FLAGS },
+    { "tonemap_desat", "Tonemap desaturation strength", OFFSET(tonemap_desat), AV_OPT_TYPE_FLOAT, { .dbl = 2 }, 0, DBL_MAX, FLAGS },
+    { "tonemap_peak",  "Tonemap signal peak override", OFFSET(tonemap_peak), AV_OPT_TYPE_FLOAT, { .dbl = 0 }, 0, DBL_MAX, FLAGS },
+    //PLEX
     { NULL },
 };
 
@@ -1140,6 +1140,240 @@ __device__ static inline T Subsample_Bicubic(cudaTextureObject_t tex,
 #undef PIX
 }
 
+//PLEX
+// --- TONEMAPPING ---
+
+// Fused scale, tonemap and P010 -> NV12 conversion. Each thread produces a
+// 2x2 block of luma and the chroma sample they share, so that the source is
+// only read once. The tone curves match vf_tonemap.c.
+
+struct TonemapRGB
+{
+    float x, y, z;
+};
+
+__device__ static inline TonemapRGB tm_mat3(const float m[9], TonemapRGB c)
+{
+    TonemapRGB r = {
+        m[0] * c.x + m[1] * c.y + m[2] * c.z,
+        m[3] * c.x + m[4] * c.y + m[5] * c.z,
+        m[6] * c.x + m[7] * c.y + m[8] * c.z,
+    };
+    return r;
+}
+
+__device__ static inline float tm_dot(const float v[3], TonemapRGB c)
+{
+    return v[0] * c.x + v[1] * c.y + v[2] * c.z;
+}
+
+__device__ static inline float eotf_st2084(float x)
+{
+    const float m1 = 0.1593017578125f, m2 = 78.84375f;
+    const float c1 = 0.8359375f, c2 = 18.8515625f, c3 = 18.6875f;
+    float p, a, b;
+
+    if (x <= 0.0f)
+        return 0.0f;
+    p = __powf(x, 1.0f / m2);
+    a = max(p - c1, 0.0f);
+    b = max(c2 - c3 * p, 1e-6f);
+    // in units of the SDR reference white of 100 cd/m^2
+    return __powf(a / b, 1.0f / m1) * 100.0f;
+}
+
+__device__ static inline float inverse_oetf_hlg(float x)
+{
+    const float a = 0.17883277f, b = 0.28466892f, c = 0.55991073f;
+
+    return x < 0.5f ? 4.0f * x * x : __expf((x - c) / a) + b;
+}
+
+__device__ static inline float inverse_eotf_bt1886(float x)
+{
+    return x <= 0.0f ? 0.0f : __powf(x, 1.0f / 2.4f);
+}
+
+__device__ static inline float tm_hable(float in)
+{
+    float a = 0.15f, b = 0.50f, c = 0.10f, d = 0.20f, e = 0.02f, f = 0.30f;
+    return (in * (in * a + b * c) + d * e) / (in * (in * a + b) + d * f) - e / f;
+}
+
+__device__ static inline float tm_mobius(float in, float j, float peak)
+{
+    float a, b;
+
+    if (in <= j)
+        return in;
+
+    a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
+    b = (j * j - 2.0f * j * peak + peak) / max(peak - 1.0f, 1e-6f);
+
+    return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
+}
+
+__device__ static inline float tm_curve(const ScaleCudaTonemapParams &p, float sig)
+{
+    const float peak = p.peak;
+
+    switch (p.algo) {
+    case SCALE_CUDA_TONEMAP_LINEAR:
+        return sig * p.param / peak;
+    case SCALE_CUDA_TONEMAP_GAMMA:
+        return sig > 0.05f ? __powf(sig / peak, 1.0f / p.param)
+                           : sig * __powf(0.05f / peak, 1.0f / p.param) / 0.05f;
+    case SCALE_CUDA_TONEMAP_CLIP:
+        return min(max(sig * p.param, 0.0f), 1.0f);
+    case SCALE_CUDA_TONEMAP_HABLE:
+        return tm_hable(sig) / tm_hable(peak);
+    case SCALE_CUDA_TONEMAP_REINHARD:
+        return sig / (sig + p.param) * (peak + p.param) / peak;
+    case SCALE_CUDA_TONEMAP_MOBIUS:
+        return tm_mobius(sig, p.param, peak);
+    default:
+        return sig;
+    }
+}
+
+// P010 sample, MSB aligned, to linear light in the destination primaries
+__device__ static inline TonemapRGB tm_linearize(const ScaleCudaTonemapParams &p,
+                                                 ushort y, ushort2 uv)
+{
+    float fy = y / 65535.0f, fu = uv.x / 65535.0f, fv = uv.y / 65535.0f;
+    TonemapRGB c;
+
+    if (p.full_range_in) {
+        fu -= 0.5f;
+        fv -= 0.5f;
+    } else {
+        fy = (fy * 255.0f -  16.0f) / 219.0f;
+        fu = (fu * 255.0f - 128.0f) / 224.0f;
+        fv = (fv * 255.0f - 128.0f) / 224.0f;
+    }
+
+    c.x = fy;
+    c.y = fu;
+    c.z = fv;
+    c = tm_mat3(p.yuv2rgb, c);
+
+    if (p.hlg) {
+        float luma;
+
+        c.x = inverse_oetf_hlg(c.x);
+        c.y = inverse_oetf_hlg(c.y);
+        c.z = inverse_oetf_hlg(c.z);
+        luma = max(tm_dot(p.luma_src, c), 0.0f);
+        luma = p.peak * __powf(luma, p.hlg_gamma - 1.0f) / __powf(12.0f, p.hlg_gamma);
+        c.x *= luma;
+        c.y *= luma;
+        c.z *= luma;
+    } else {
+        c.x = eotf_st2084(c.x);
+        c.y = eotf_st2084(c.y);
+        c.z = eotf_st2084(c.z);
+    }
+
+    return tm_mat3(p.rgb2rgb, c);
+}
+
+__device__ static inline TonemapRGB tm_map(const ScaleCudaTonemapParams &p, TonemapRGB c)
+{
+    float sig, sig_orig;
+
+    c.x = max(c.x, 0.0f);
+    c.y = max(c.y, 0.0f);
+    c.z = max(c.z, 0.0f);
+
+    // desaturate to prevent unnatural colors
+    if (p.desat > 0.0f) {
+        float luma = tm_dot(p.luma_dst, c);
+        float overbright = max(luma - p.desat, 1e-6f) / max(luma, 1e-6f);
+        c.x = c.x * (1.0f - overbright) + luma * overbright;
+        c.y = c.y * (1.0f - overbright) + luma * overbright;
+        c.z = c.z * (1.0f - overbright) + luma * overbright;
+    }
+
+    sig = max(max(max(c.x, c.y), c.z), 1e-6f);
+    sig_orig = sig;
+    sig = tm_curve(p, sig);
+
+    c.x = inverse_eotf_bt1886(min(c.x * sig / sig_orig, 1.0f));
+    c.y = inverse_eotf_bt1886(min(c.y * sig / sig_orig, 1.0f));
+    c.z = inverse_eotf_bt1886(min(c.z * sig / sig_orig, 1.0f));
+    return c;
+}
+
+__device__ static inline uchar tm_to_8bit(float x)
+{
+    return (uchar)(__saturatef(x) * 255.0f + 0.5f);
+}
+
+__device__ static inline uchar tm_luma(const ScaleCudaTonemapParams &p, TonemapRGB c)
+{
+    float y = tm_dot(p.rgb2yuv, c);
+
+    if (!p.full_range_out)
+        y = (219.0f * y + 16.0f) / 255.0f;
+    return tm_to_8bit(y);
+}
+
+template<subsample_function_t<ushort> subsample_func_y,
+         subsample_function_t<ushort2> subsample_func_uv>
+__device__ static inline void Tonemap_p010le_nv12(cudaTextureObject_t src_tex_y,
+                                                  cudaTextureObject_t src_tex_uv,
+                                                  uchar *dst_y, uchar2 *dst_uv,
+                                                  int dst_width, int dst_height,
+                                                  int dst_pitch_y, int dst_pitch_uv,
+                                                  int src_width, int src_height,
+                                                  float param,
+                                                  const ScaleCudaTonemapParams &p)
+{
+    int xo = blockIdx.x * blockDim.x + threadIdx.x;
+    int yo = blockIdx.y * blockDim.y + threadIdx.y;
+    int dst_width_uv  = (dst_width  + 1) >> 1;
+    int dst_height_uv = (dst_height + 1) >> 1;
+    TonemapRGB sum = { 0.0f, 0.0f, 0.0f };
+    ushort2 uv;
+
+    if (yo >= dst_height_uv || xo >= dst_width_uv)
+        return;
+
+    uv = subsample_func_uv(src_tex_uv, xo, yo, dst_width_uv, dst_height_uv,
+                           (src_width + 1) >> 1, (src_height + 1) >> 1, 10, param);
+
+    for (int i = 0; i < 4; i++) {
+        int x = 2 * xo + (i & 1);
+        int y = 2 * yo + (i >> 1);
+        int xc = min(x, dst_width - 1), yc = min(y, dst_height - 1);
+        ushort luma = subsample_func_y(src_tex_y, xc, yc, dst_width, dst_height,
+                                       src_width, src_height, 10, param);
+        TonemapRGB c = tm_map(p, tm_linearize(p, luma, uv));
+
+        if (x < dst_width && y < dst_height)
+            dst_y[y * dst_pitch_y + x] = tm_luma(p, c);
+        sum.x += 0.25f * c.x;
+        sum.y += 0.25f * c.y;
+        sum.z += 0.25f * c.z;
+    }
+
+    {
+        TonemapRGB yuv = tm_mat3(p.rgb2yuv, sum);
+        float u = yuv.y, v = yuv.z;
+
+        if (p.full_range_out) {
+            u += 0.5f;
+            v += 0.5f;
+        } else {
+            u = (224.0f * u + 128.0f) / 255.0f;
+            v = (224.0f * v + 128.0f) / 255.0f;
+        }
+        dst_uv[yo * (dst_pitch_uv / sizeof(uchar2)) + xo] =
+            make_uchar2(tm_to_8bit(u), tm_to_8bit(v));
+    }
+}
+//PLEX
+
 /// --- FUNCTION EXPORTS ---
 
 #define KERNEL_ARGS(T) \
@@ -1322,4 +1556,43 @@ LANCZOS_KERNELS_RGB(rgb0)
 LANCZOS_KERNELS_RGB(bgr0)
 LANCZOS_KERNELS_RGB(rgba)
 LANCZOS_KERNELS_RGB(bgra)
+
+//PLEX
+#define TONEMAP_KERNEL_ARGS \
+    cudaTextureObject_t src_tex_0, cudaTextureObject_t src_tex_1, \
+    uchar *dst_0, uchar2 *dst_1,                                  \
+    int dst_width, int dst_height, int dst_pitch_0, int dst_pitch_1, \
+    int src_width, int src_height, float param, ScaleCudaTonemapParams tm
+
+#define TONEMAP(subsample_y, subsample_uv)                               \
+    Tonemap_p010le_nv12<subsample_y, subsample_uv>(                      \
+        src_tex_0, src_tex_1, dst_0, dst_1, dst_width, dst_height,       \
+        dst_pitch_0, dst_pitch_1, src_width, src_height, param, tm)
+
+__global__ void Tonemap_Nearest_p010le_nv12(TONEMAP_KERNEL_ARGS)
+{
+    TONEMAP(Subsample_Nearest<ushort>, Subsample_Nearest<ushort2>);
+}
+
+__global__ void Tonemap_Bilinear_p010le_nv12(TONEMAP_KERNEL_ARGS)
+{
+    TONEMAP(Subsample_Bilinear<ushort>, Subsample_Bilinear<ushort2>);
+}
+
+__global__ void Tonemap_Bicubic_p010le_nv12(TONEMAP_KERNEL_ARGS)
+{
+    Tonemap_p010le_nv12<Subsample_Bicubic<ushort, bicubic_coeffs>,
+                        Subsample_Bicubic<ushort2, bicubic_coeffs> >(
+        src_tex_0, src_tex_1, dst_0, dst_1, dst_width, dst_height,
+        dst_pitch_0, dst_pitch_1, src_width, src_height, param, tm);
+}
+
+__global__ void Tonemap_Lanczos_p010le_nv12(TONEMAP_KERNEL_ARGS)
+{
+    Tonemap_p010le_nv12<Subsample_Bicubic<ushort, lanczos_coeffs>,
+                        Subsample_Bicubic<ushort2, lanczos_coeffs> >(
+        src_tex_0, src_tex_1, dst_0, dst_1, dst_width, dst_height,
+        dst_pitch_0, dst_pitch_1, src_width, src_height, param, tm);
+}
+//PLEX
 }
@@ -25,4 +25,37 @@
 
 #define SCALE_CUDA_PARAM_DEFAULT 999999.0f
 
+//PLEX
+enum {
+    SCALE_CUDA_TONEMAP_NONE,
+    SCALE_CUDA_TONEMAP_LINEAR,
+    SCALE_CUDA_TONEMAP_GAMMA,
+    SCALE_CUDA_TONEMAP_CLIP,
+    SCALE_CUDA_TONEMAP_REINHARD,
+    SCALE_CUDA_TONEMAP_HABLE,
+    SCALE_CUDA_TONEMAP_MOBIUS,
+    SCALE_CUDA_TONEMAP_MAX,
+};
+
+/**
+ * Parameters of the fused tonemapping kernels, passed by value. Matrices
+ * are row major, signal levels are relative to the SDR reference white.
+ */
+typedef struct ScaleCudaTonemapParams {
+    int   algo;
+    int   hlg;              ///< source is HLG rather than PQ
+    int   full_range_in;
+    int   full_range_out;
+    float param;
+    float desat;
+    float peak;
+    float hlg_gamma;        ///< system gamma of the HLG OOTF
+    float yuv2rgb[9];       ///< source YCbCr to RGB
+    float rgb2rgb[9];       ///< source to destination primaries
+    float rgb2yuv[9];       ///< destination RGB to YCbCr
+    float luma_src[3];
+    float luma_dst[3];
+} ScaleCudaTonemapParams;
+//PLEX
+
 #endif
@@ -0,0 +1,414 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Scale the input to several sizes at once, for adaptive bitrate ladders.
+ *
+ * The outputs are produced from the largest to the smallest and each one is
+ * scaled from the smallest larger output already produced, so that only the
+ * first pass reads the full size source frame.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "scale_eval.h"
+#include "video.h"
+
+typedef struct LadderOutput {
+    int w, h;
+    int src;                   ///< output scaled from, -1 for the input
+    struct SwsContext *sws;    ///< NULL if the size of the source is kept
+} LadderOutput;
+
+typedef struct ScaleLadderContext {
+    const AVClass *class;
+    char *sizes_str;
+    char *flags_str;
+    int cascade;
+
+    LadderOutput *outputs;
+    int *order;                ///< output indices, largest first
+    AVFrame **frames;
+    uint8_t *needed;
+    int nb_outputs;
+} ScaleLadderContext;
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ScaleLadderContext *s = ctx->priv;
+    const LadderOutput *out = &s->outputs[FF_OUTLINK_IDX(outlink)];
+
+    outlink->w = out->w;
+    outlink->h = out->h;
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ out->h * inlink->w, out->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    ScaleLadderContext *s = ctx->priv;
+    const char *p = s->sizes_str;
+    int ret;
+
+    while (*p) {
+        AVFilterPad pad = { 0 };
+        size_t len = strcspn(p, "|");
+
+        p += len + !!p[len];
+        if (!len)
+            continue;
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name = av_asprintf("output%d", s->nb_outputs);
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+        if ((ret = ff_append_outpad_free_name(ctx, &pad)) < 0)
+            return ret;
+        s->nb_outputs++;
+    }
+    if (!s->nb_outputs) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes given.\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->outputs = av_calloc(s->nb_outputs, sizeof(*s->outputs));
+    s->order   = av_calloc(s->nb_outputs, sizeof(*s->order));
+    s->frames  = av_calloc(s->nb_outputs, sizeof(*s->frames));
+    s->needed  = av_calloc(s->nb_outputs, sizeof(*s->needed));
+    if (!s->outputs || !s->order || !s->frames || !s->needed)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    ScaleLadderContext *s = ctx->priv;
+
+    for (int i = 0; s->outputs && i < s->nb_outputs; i++)
+        sws_freeContext(s->outputs[i].sws);
+    for (int i = 0; s->frames && i < s->nb_outputs; i++)
+        av_frame_free(&s->frames[i]);
+    av_freep(&s->outputs);
+    av_freep(&s->order);
+    av_freep(&s->frames);
+    av_freep(&s->needed);
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    AVFilterFormats *formats = NULL;
+    const AVPixFmtDescriptor *desc = NULL;
+    int ret;
+
+    /* the outputs have the format of the input, only the size changes */
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+
+        if (sws_isSupportedInput(pix_fmt) && sws_isSupportedOutput(pix_fmt) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+    return ff_set_common_formats(ctx, formats);
+}
+
+static int eval_size(AVFilterContext *ctx, int i, const char *str, int len)
+{
+    ScaleLadderContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    char buf[128], *x;
+    int w, h, ret;
+
+    av_strlcpy(buf, str, FFMIN(len + 1, sizeof(buf)));
+    if (av_parse_video_size(&w, &h, buf) < 0) {
+        /* WxH, with scale filter expressions for W and H */
+        x = strchr(buf, 'x');
+        if (!x) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid output size '%s'.\n", buf);
+            return AVERROR(EINVAL);
+        }
+        *x = 0;
+        ret = ff_scale_eval_dimensions(ctx, buf, x + 1, inlink, ctx->outputs[i], &w, &h);
+        if (ret < 0)
+            return ret;
+        ret = ff_scale_adjust_dimensions(inlink, &w, &h, 0, 1);
+        if (ret < 0)
+            return ret;
+    }
+    if (w <= 0 || h <= 0) {
+        av_log(ctx, AV_LOG_ERROR, "Invalid output size %dx%d.\n", w, h);
+        return AVERROR(EINVAL);
+    }
+
+    s->outputs[i].w = w;
+    s->outputs[i].h = h;
+    return 0;
+}
+
+static int init_sws(AVFilterContext *ctx, LadderOutput *out, int src_w, int src_h)
+{
+    ScaleLadderContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    struct SwsContext *sws;
+    int ret;
+
+    sws_freeContext(out->sws);
+    out->sws = sws = sws_alloc_context();
+    if (!sws)
+        return AVERROR(ENOMEM);
+
+    if (s->flags_str && (ret = av_opt_set(sws, "sws_flags", s->flags_str, 0)) < 0)
+        return ret;
+    av_opt_set_int(sws, "threads", ff_filter_get_nb_threads(ctx), 0);
+    av_opt_set_int(sws, "srcw", src_w, 0);
+    av_opt_set_int(sws, "srch", src_h, 0);
+    av_opt_set_int(sws, "src_format", inlink->format, 0);
+    av_opt_set_int(sws, "dstw", out->w, 0);
+    av_opt_set_int(sws, "dsth", out->h, 0);
+    av_opt_set_int(sws, "dst_format", inlink->format, 0);
+    /* MPEG chroma positions, as the scale filter uses */
+    if (desc->log2_chroma_h == 1) {
+        av_opt_set_int(sws, "src_v_chr_pos", 128, 0);
+        av_opt_set_int(sws, "dst_v_chr_pos", 128, 0);
+    }
+    return sws_init_context(sws, NULL, NULL);
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    ScaleLadderContext *s = ctx->priv;
+    const char *p = s->sizes_str;
+    int ret;
+
+    for (int i = 0; i < s->nb_outputs;) {
+        size_t len = strcspn(p, "|");
+
+        if (len) {
+            if ((ret = eval_size(ctx, i, p, len)) < 0)
+                return ret;
+            s->order[i] = i;
+            i++;
+        }
+        p += len + !!p[len];
+    }
+
+    /* largest first; stable, so equal sizes keep their order */
+    for (int i = 1; i < s->nb_outputs; i++) {
+        int k = s->order[i], j = i;
+        int64_t area = (int64_t)s->outputs[k].w * s->outputs[k].h;
+
+        while (j > 0 && (int64_t)s->outputs[s->order[j - 1]].w *
+                                 s->outputs[s->order[j - 1]].h < area) {
+            s->order[j] = s->order[j - 1];
+            j--;
+        }
+        s->order[j] = k;
+    }
+
+    for (int i = 0; i < s->nb_outputs; i++) {
+        LadderOutput *out = &s->outputs[s->order[i]];
+        int src_w = inlink->w, src_h = inlink->h;
+
+        out->src = -1;
+        /* the smallest output already produced that is not smaller */
+        for (int j = i - 1; s->cascade && j >= 0; j--) {
+            const LadderOutput *prev = &s->outputs[s->order[j]];
+
+            /* never from an upscaled output */
+            if (prev->w >= out->w && prev->h >= out->h &&
+                prev->w <= inlink->w && prev->h <= inlink->h) {
+                out->src = s->order[j];
+                src_w    = prev->w;
+                src_h    = prev->h;
+                break;
+            }
+        }
+
+        if (src_w == out->w && src_h == out->h) {
+            sws_freeContext(out->sws);
+            out->sws = NULL;
+        } else if ((ret = init_sws(ctx, out, src_w, src_h)) < 0) {
+            return ret;
+        }
+
+        av_log(ctx, AV_LOG_VERBOSE, "output%d: %dx%d -> %dx%d\n", s->order[i],
+               src_w, src_h, out->w, out->h);
+    }
+    return 0;
+}
+
+static int scale_frame(AVFilterContext *ctx, AVFrame *in)
+{
+    ScaleLadderContext *s = ctx->priv;
+    int ret = 0;
+
+    /* an output is needed if it is still open or another one is scaled from it */
+    memset(s->needed, 0, s->nb_outputs);
+    for (int i = s->nb_outputs - 1; i >= 0; i--) {
+        int k = s->order[i];
+
+        if (!ff_outlink_get_status(ctx->outputs[k]))
+            s->needed[k] = 1;
+        if (s->needed[k] && s->outputs[k].src >= 0)
+            s->needed[s->outputs[k].src] = 1;
+    }
+
+    for (int i = 0; i < s->nb_outputs; i++) {
+        int k = s->order[i];
+        const LadderOutput *out = &s->outputs[k];
+        AVFilterLink *outlink = ctx->outputs[k];
+        const AVFrame *src = out->src >= 0 ? s->frames[out->src] : in;
+        AVFrame *frame;
+
+        if (!s->needed[k])
+            continue;
+
+        if (!out->sws) {
+            frame = av_frame_clone(src);
+        } else {
+            frame = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+            if (frame && (ret = av_frame_copy_props(frame, src)) >= 0)
+                ret = sws_scale_frame(out->sws, frame, src);
+            if (ret < 0) {
+                av_frame_free(&frame);
+                break;
+            }
+        }
+        if (!frame) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        frame->sample_aspect_ratio = outlink->sample_aspect_ratio;
+        s->frames[k] = frame;
+    }
+
+    /* sent once all are scaled, so that no output is written to while it
+     * is still a source */
+    for (int i = 0; i < s->nb_outputs; i++) {
+        AVFrame *frame = s->frames[i];
+
+        s->frames[i] = NULL;
+        if (!frame)
+            continue;
+        if (ret < 0 || ff_outlink_get_status(ctx->outputs[i])) {
+            av_frame_free(&frame);
+            continue;
+        }
+        ret = ff_filter_frame(ctx->outputs[i], frame);
+    }
+    return ret;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFrame *in;
+    int status, ret, nb_eofs = 0;
+    int64_t pts;
+
+    for (int i = 0; i < ctx->nb_outputs; i++)
+        nb_eofs += ff_outlink_get_status(ctx->outputs[i]) == AVERROR_EOF;
+
+    if (nb_eofs == ctx->nb_outputs) {
+        ff_inlink_set_status(inlink, AVERROR_EOF);
+        return 0;
+    }
+
+    ret = ff_inlink_consume_frame(inlink, &in);
+    if (ret < 0)
+        return ret;
+    if (ret > 0) {
+        ret = scale_frame(ctx, in);
+        av_frame_free(&in);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        for (int i = 0; i < ctx->nb_outputs; i++) {
+            if (ff_outlink_get_status(ctx->outputs[i]))
+                continue;
+            ff_outlink_set_status(ctx->outputs[i], status, pts);
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        if (ff_outlink_get_status(ctx->outputs[i]))
+            continue;
+
+        if (ff_outlink_frame_wanted(ctx->outputs[i])) {
+            ff_inlink_request_frame(inlink);
+            return 0;
+        }
+    }
+
+    return FFERROR_NOT_READY;
+}
+
+#define OFFSET(x) offsetof(ScaleLadderContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption scale_ladder_options[] = {
+    { "sizes",   "set the '|'-separated output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING, { .str = "-2x1080|-2x720|-2x480" }, 0, 0, FLAGS },
+    { "flags",   "set the libswscale flags",  OFFSET(flags_str), AV_OPT_TYPE_STRING, { .str = "bicubic" }, 0, 0, FLAGS },
+    { "cascade", "scale each output from the next larger one", OFFSET(cascade), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(scale_ladder);
+
+static const AVFilterPad scale_ladder_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+    },
+};
+
+const AVFilter ff_vf_scale_ladder = {
+    .name          = "scale_ladder",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several sizes at once."),
+    .priv_size     = sizeof(ScaleLadderContext),
+    .priv_class    = &scale_ladder_class,
+    .init          = init,
+    .uninit        = uninit,
+    .activate      = activate,
+    FILTER_INPUTS(scale_ladder_inputs),
+    .outputs       = NULL,
+    FILTER_QUERY_FUNC(query_formats),
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+};
@@ -319,6 +319,53 @@ static int ssim_plane(AVFilterContext *ctx, void *arg,
     return 0;
 }
 
+//PLEX
+int avfilter_plane_ssim(const uint8_t *main, ptrdiff_t main_stride,
+                        const uint8_t *ref, ptrdiff_t ref_stride,
+                        int w, int h, double *score)
+{
+    SSIMDSPContext dsp = {
+        .ssim_4x4_line = ssim_4x4xn_8bit,
+        .ssim_end_line = ssim_endn_8bit,
+    };
+    int (*temp)[4], (*sum0)[4], (*sum1)[4];
+    double ssim = 0.0;
+    int z = 0;
+
+    if (w < 8 || h < 8)
+        return AVERROR(EINVAL);
+
+#if ARCH_X86
+    ff_ssim_init_x86(&dsp);
+#endif
+
+    temp = av_calloc(2 * SUM_LEN(w), sizeof(*temp));
+    if (!temp)
+        return AVERROR(ENOMEM);
+    sum0 = temp;
+    sum1 = sum0 + SUM_LEN(w);
+
+    w >>= 2;
+    h >>= 2;
+
+    /* same as ssim_plane() as a single job */
+    for (int y = 1; y < h; y++) {
+        for (; z <= y; z++) {
+            FFSWAP(void*, sum0, sum1);
+            dsp.ssim_4x4_line(&main[4 * z * main_stride], main_stride,
+                              &ref[4 * z * ref_stride], ref_stride,
+                              sum0, w);
+        }
+
+        ssim += dsp.ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, w - 1);
+    }
+
+    av_free(temp);
+    *score = ssim / ((w - 1) * (h - 1));
+    return 0;
+}
+//PLEX
+
 static double ssim_db(double ssim, double weight)
 {
     return (fabs(weight - ssim) > 1e-9) ? 10.0 * log10(weight / (weight - ssim)) : INFINITY;
@@ -53,6 +53,11 @@ typedef struct StackVAAPIContext {
     StackBaseContext base;
 
     VARectangle *rects;
+    //PLEX
+    /* per input, reused for every output frame */
+    VARectangle *irects;
+    VAProcPipelineParameterBuffer *params;
+    //PLEX
 } StackVAAPIContext;
 
 static int process_frame(FFFrameSync *fs)
@@ -62,8 +67,8 @@ static int process_frame(FFFrameSync *fs)
     StackVAAPIContext *sctx = fs->opaque;
     VAAPIVPPContext *vppctx = fs->opaque;
     AVFrame *oframe, *iframe;
-    VAProcPipelineParameterBuffer *params = NULL;
-    VARectangle *irect = NULL;
+    VAProcPipelineParameterBuffer *params = sctx->params; //PLEX
+    VARectangle *irect = sctx->irects; //PLEX
     int ret = 0;
 
     if (vppctx->va_context == VA_INVALID_ID)
@@ -73,13 +78,6 @@ static int process_frame(FFFrameSync *fs)
     if (!oframe)
         return AVERROR(ENOMEM);
 
-    irect = av_calloc(avctx->nb_inputs, sizeof(*irect));
-    params = av_calloc(avctx->nb_inputs, sizeof(*params));
-    if (!irect || !params) {
-        ret = AVERROR(ENOMEM);
-        goto fail;
-    }
-
     for (int i = 0; i < avctx->nb_inputs; i++) {
         ret = ff_framesync_get_frame(fs, i, &iframe, 0);
         if (ret)
@@ -120,13 +118,9 @@ static int process_frame(FFFrameSync *fs)
     if (ret)
         goto fail;
 
-    av_freep(&irect);
-    av_freep(&params);
     return ff_filter_frame(outlink, oframe);
 
 fail:
-    av_freep(&irect);
-    av_freep(&params);
     av_frame_free(&oframe);
     return ret;
 }
@@ -204,6 +198,13 @@ static int vaapi_stack_init(AVFilterContext *avctx)
     if (!sctx->rects)
         return AVERROR(ENOMEM);
 
+    //PLEX
+    sctx->irects = av_calloc(sctx->base.nb_inputs, sizeof(*sctx->irects));
+    sctx->params = av_calloc(sctx->base.nb_inputs, sizeof(*sctx->params));
+    if (!sctx->irects || !sctx->params)
+        return AVERROR(ENOMEM);
+    //PLEX
+
     ff_vaapi_vpp_ctx_init(avctx);
     vppctx->output_format = AV_PIX_FMT_NONE;
 
@@ -217,6 +218,8 @@ static av_cold void vaapi_stack_uninit(AVFilterContext *avctx)
     stack_uninit(avctx);
 
     av_freep(&sctx->rects);
+    av_freep(&sctx->irects); //PLEX
+    av_freep(&sctx->params); //PLEX
 }
 
 static int vaapi_stack_query_formats(AVFilterContext *avctx)
@@ -37,9 +37,13 @@
 # include "libavformat/avformat.h"
 #endif
 #include "libavutil/avstring.h"
+#include "libavutil/crc.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 #include "drawutils.h"
 #include "avfilter.h"
 #include "internal.h"
@@ -48,9 +52,32 @@
 
 #define FF_ASS_FEATURE_WRAP_UNICODE     (LIBASS_VERSION >= 0x01600010)
 
+//PLEX
+/* consecutive images of one color, merged into a single mask */
+typedef struct AssLayer {
+    FFDrawColor color;
+    uint8_t *mask;
+    unsigned mask_size;
+    int x, y, w, h;
+} AssLayer;
+
+/* Instances using the same fonts directory and style overrides share one
+ * libass library, so that attached fonts are copied into it only once. */
+typedef struct AssSharedLibrary {
+    ASS_Library *library;
+    AVMutex lock;              ///< guards the library, renderers read it too
+    char *key;
+    int refcount;
+    uint64_t *fonts;           ///< size and CRC of the attached fonts added
+    int nb_fonts;
+    struct AssSharedLibrary *next;
+} AssSharedLibrary;
+//PLEX
+
 typedef struct AssContext {
     const AVClass *class;
     ASS_Library  *library;
+    AssSharedLibrary *shared; //PLEX
     ASS_Renderer *renderer;
     ASS_Track    *track;
     char *filename;
@@ -65,6 +92,14 @@ typedef struct AssContext {
     int shaping;
     FFDrawContext draw;
     int wrap_unicode;
+    //PLEX
+    AssLayer *layers;          ///< composited image list of the last change
+    int nb_layers, layers_alloc;
+    int layers_valid;
+    long long idle_start, idle_end; ///< time range in ms without active events
+    int idle_events;           ///< number of track events when the range was found
+    int lazy_fonts;
+    //PLEX
 } AssContext;
 
 #define OFFSET(x) offsetof(AssContext, x)
@@ -99,26 +134,158 @@ static void ass_log(int ass_level, const char *fmt, va_list args, void *ctx)
     av_log(ctx, level, "\n");
 }
 
+//PLEX
+static AVMutex shared_libraries_lock = AV_MUTEX_INITIALIZER;
+static AssSharedLibrary *shared_libraries;
+
+static const AVClass ass_library_class = {
+    .class_name = "libass",
+    .item_name  = av_default_item_name,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+/* shared libraries outlive the instances, they log on their own */
+static const AVClass *const ass_library_log_ctx = &ass_library_class;
+
+static int set_style_overrides(ASS_Library *library, const char *force_style)
+{
+    char **list = NULL;
+    char *temp = NULL, *style, *ptr;
+    int i = 0, ret = 0;
+
+    style = av_strdup(force_style);
+    if (!style)
+        return AVERROR(ENOMEM);
+
+    ptr = av_strtok(style, ",", &temp);
+    while (ptr) {
+        av_dynarray_add(&list, &i, ptr);
+        if (!list) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ptr = av_strtok(NULL, ",", &temp);
+    }
+    av_dynarray_add(&list, &i, NULL);
+    if (!list) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    /* libass copies the strings */
+    ass_set_style_overrides(library, list);
+
+end:
+    av_free(list);
+    av_free(style);
+    return ret;
+}
+
+static void shared_library_free(AssSharedLibrary *shared)
+{
+    ass_library_done(shared->library);
+    ff_mutex_destroy(&shared->lock);
+    av_free(shared->fonts);
+    av_free(shared->key);
+    av_free(shared);
+}
+
+static int shared_library_ref(AVFilterContext *ctx)
+{
+    AssContext *ass = ctx->priv;
+    AssSharedLibrary *shared;
+    char *key;
+    int ret = 0;
+
+    key = av_asprintf("%s|%s", ass->fontsdir ? ass->fontsdir : "",
+                      ass->force_style ? ass->force_style : "");
+    if (!key)
+        return AVERROR(ENOMEM);
+
+    ff_mutex_lock(&shared_libraries_lock);
+    for (shared = shared_libraries; shared; shared = shared->next)
+        if (!strcmp(shared->key, key))
+            break;
+
+    if (!shared) {
+        shared = av_mallocz(sizeof(*shared));
+        if (!shared) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        shared->library = ass_library_init();
+        if (!shared->library) {
+            av_log(ctx, AV_LOG_ERROR, "Could not initialize libass.\n");
+            av_free(shared);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        ff_mutex_init(&shared->lock, NULL);
+        shared->key = key;
+        key = NULL;
+
+        ass_set_message_cb(shared->library, ass_log, (void *)&ass_library_log_ctx);
+        ass_set_fonts_dir(shared->library, ass->fontsdir);
+        ass_set_extract_fonts(shared->library, 1);
+        if (ass->force_style) {
+            ret = set_style_overrides(shared->library, ass->force_style);
+            if (ret < 0) {
+                shared_library_free(shared);
+                goto end;
+            }
+        }
+
+        shared->next = shared_libraries;
+        shared_libraries = shared;
+    }
+    shared->refcount++;
+    ass->shared  = shared;
+    ass->library = shared->library;
+
+end:
+    ff_mutex_unlock(&shared_libraries_lock);
+    av_free(key);
+    return ret;
+}
+
+static void shared_library_unref(AssContext *ass)
+{
+    AssSharedLibrary **p;
+
+    if (!ass->shared)
+        return;
+
+    ff_mutex_lock(&shared_libraries_lock);
+    if (!--ass->shared->refcount) {
+        for (p = &shared_libraries; *p != ass->shared; p = &(*p)->next)
+            ;
+        *p = ass->shared->next;
+        shared_library_free(ass->shared);
+    }
+    ff_mutex_unlock(&shared_libraries_lock);
+    ass->shared  = NULL;
+    ass->library = NULL;
+}
+//PLEX
+
 static av_cold int init(AVFilterContext *ctx)
 {
     AssContext *ass = ctx->priv;
+    int ret;
 
     if (!ass->filename) {
         av_log(ctx, AV_LOG_ERROR, "No filename provided!\n");
         return AVERROR(EINVAL);
     }
 
-    ass->library = ass_library_init();
-    if (!ass->library) {
-        av_log(ctx, AV_LOG_ERROR, "Could not initialize libass.\n");
-        return AVERROR(EINVAL);
-    }
-    ass_set_message_cb(ass->library, ass_log, ctx);
-
-    ass_set_fonts_dir(ass->library, ass->fontsdir);
-    ass_set_extract_fonts(ass->library, 1);
+    //PLEX
+    ret = shared_library_ref(ctx);
+    if (ret < 0)
+        return ret;
+    ass->idle_events = -1;
 
+    ff_mutex_lock(&ass->shared->lock);
     ass->renderer = ass_renderer_init(ass->library);
+    ff_mutex_unlock(&ass->shared->lock);
+    //PLEX
     if (!ass->renderer) {
         av_log(ctx, AV_LOG_ERROR, "Could not initialize libass renderer.\n");
         return AVERROR(EINVAL);
@@ -133,10 +300,17 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     if (ass->track)
         ass_free_track(ass->track);
-    if (ass->renderer)
+    //PLEX
+    if (ass->renderer) {
+        ff_mutex_lock(&ass->shared->lock);
         ass_renderer_done(ass->renderer);
-    if (ass->library)
-        ass_library_done(ass->library);
+        ff_mutex_unlock(&ass->shared->lock);
+    }
+    shared_library_unref(ass);
+    for (int i = 0; i < ass->layers_alloc; i++)
+        av_freep(&ass->layers[i].mask);
+    av_freep(&ass->layers);
+    //PLEX
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -170,21 +344,166 @@ static int config_input(AVFilterLink *inlink)
 #define AB(c)  (((c)>>8) &0xFF)
 #define AA(c)  ((0xFF-(c)) &0xFF)
 
-static void overlay_ass_image(AssContext *ass, AVFrame *picref,
-                              const ASS_Image *image)
+//PLEX
+/* Merge the image list into as few masks as possible. Only consecutive images
+ * of the same color are merged, which keeps the stacking order, and only as
+ * long as the merged mask is not mostly empty. */
+static int composite_layers(AssContext *ass, const ASS_Image *image)
+{
+    ass->nb_layers    = 0;
+    ass->layers_valid = 0;
+
+    while (image) {
+        const ASS_Image *end, *cur;
+        AssLayer *layer;
+        int x0 = image->dst_x, x1 = image->dst_x + image->w;
+        int y0 = image->dst_y, y1 = image->dst_y + image->h;
+        int64_t area = (int64_t)image->w * image->h;
+
+        for (end = image->next; end && end->color == image->color; end = end->next) {
+            int nx0 = FFMIN(x0, end->dst_x), nx1 = FFMAX(x1, end->dst_x + end->w);
+            int ny0 = FFMIN(y0, end->dst_y), ny1 = FFMAX(y1, end->dst_y + end->h);
+            int64_t narea = area + (int64_t)end->w * end->h;
+
+            if ((int64_t)(nx1 - nx0) * (ny1 - ny0) > 2 * narea)
+                break;
+            x0 = nx0; x1 = nx1;
+            y0 = ny0; y1 = ny1;
+            area = narea;
+        }
+
+        if (ass->nb_layers == ass->layers_alloc) {
+            int nb = FFMAX(2 * ass->layers_alloc, 8);
+            AssLayer *layers = av_realloc_array(ass->layers, nb, sizeof(*layers));
+            if (!layers)
+                return AVERROR(ENOMEM);
+            memset(layers + ass->layers_alloc, 0,
+                   (nb - ass->layers_alloc) * sizeof(*layers));
+            ass->layers       = layers;
+            ass->layers_alloc = nb;
+        }
+        layer = &ass->layers[ass->nb_layers];
+        layer->x = x0;
+        layer->y = y0;
+        layer->w = x1 - x0;
+        layer->h = y1 - y0;
+        av_fast_malloc(&layer->mask, &layer->mask_size,
+                       FFMAX((size_t)layer->w * layer->h, 1));
+        if (!layer->mask)
+            return AVERROR(ENOMEM);
+        memset(layer->mask, 0, (size_t)layer->w * layer->h);
+
+        for (cur = image; cur != end; cur = cur->next) {
+            uint8_t *dst = layer->mask + (cur->dst_y - y0) * layer->w + cur->dst_x - x0;
+            const uint8_t *src = cur->bitmap;
+
+            for (int y = 0; y < cur->h; y++) {
+                if (cur == image) {
+                    memcpy(dst, src, cur->w);
+                } else {
+                    /* coverage of two draws of the same color */
+                    for (int x = 0; x < cur->w; x++)
+                        dst[x] = dst[x] + src[x] - (dst[x] * src[x] + 127) / 255;
+                }
+                dst += layer->w;
+                src += cur->stride;
+            }
+        }
+
+        {
+            uint8_t rgba_color[] = {AR(image->color), AG(image->color), AB(image->color), AA(image->color)};
+            ff_draw_color(&ass->draw, &layer->color, rgba_color);
+        }
+        ass->nb_layers++;
+        image = end;
+    }
+
+    ass->layers_valid = 1;
+    return 0;
+}
+
+typedef struct ThreadData {
+    AVFrame *frame;
+    int y_start, y_end;
+} ThreadData;
+
+/* Blend the part of the layers within a band of rows. Bands start on chroma
+ * row boundaries, so no output sample is shared between two of them. */
+static int overlay_ass_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    for (; image; image = image->next) {
-        uint8_t rgba_color[] = {AR(image->color), AG(image->color), AB(image->color), AA(image->color)};
-        FFDrawColor color;
-        ff_draw_color(&ass->draw, &color, rgba_color);
-        ff_blend_mask(&ass->draw, &color,
-                      picref->data, picref->linesize,
-                      picref->width, picref->height,
-                      image->bitmap, image->stride, image->w, image->h,
-                      3, 0, image->dst_x, image->dst_y);
+    AssContext *ass = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *picref = td->frame;
+    const int align = 1 << ass->draw.vsub_max;
+    int rows  = (td->y_end - td->y_start + align - 1) / align;
+    int start = td->y_start + rows * jobnr / nb_jobs * align;
+    int end   = FFMIN(td->y_start + rows * (jobnr + 1) / nb_jobs * align, td->y_end);
+    uint8_t *data[4] = { NULL };
+
+    if (start >= end)
+        return 0;
+    for (int plane = 0; plane < ass->draw.nb_planes; plane++)
+        data[plane] = picref->data[plane] +
+                      (start >> ass->draw.vsub[plane]) * picref->linesize[plane];
+
+    for (int i = 0; i < ass->nb_layers; i++) {
+        AssLayer *layer = &ass->layers[i];
+
+        if (layer->y >= end || layer->y + layer->h <= start)
+            continue;
+        ff_blend_mask(&ass->draw, &layer->color,
+                      data, picref->linesize,
+                      picref->width, end - start,
+                      layer->mask, layer->w, layer->w, layer->h,
+                      3, 0, layer->x, layer->y - start);
     }
+    return 0;
 }
 
+static void overlay_ass_layers(AVFilterContext *ctx, AVFrame *picref)
+{
+    AssContext *ass = ctx->priv;
+    const int align = 1 << ass->draw.vsub_max;
+    ThreadData td = { .frame = picref, .y_start = INT_MAX, .y_end = 0 };
+    int nb_jobs;
+
+    /* only the rows covered by the layers are split between the threads */
+    for (int i = 0; i < ass->nb_layers; i++) {
+        td.y_start = FFMIN(td.y_start, ass->layers[i].y);
+        td.y_end   = FFMAX(td.y_end,   ass->layers[i].y + ass->layers[i].h);
+    }
+    td.y_start = FFMAX(td.y_start, 0) & ~(align - 1);
+    td.y_end   = FFMIN(td.y_end, picref->height);
+    if (td.y_start >= td.y_end)
+        return;
+
+    nb_jobs = FFMIN(ff_filter_get_nb_threads(ctx),
+                    (td.y_end - td.y_start + align - 1) / align);
+    ff_filter_execute(ctx, overlay_ass_slice, &td, NULL, nb_jobs);
+}
+
+/* Find how long nothing is displayed after an empty render at now, so that
+ * the following frames can skip libass until the next event starts. */
+static void update_idle_range(AssContext *ass, long long now)
+{
+    const ASS_Track *track = ass->track;
+    long long end = LLONG_MAX;
+
+    ass->idle_events = -1;
+    for (int i = 0; i < track->n_events; i++) {
+        const ASS_Event *event = &track->events[i];
+
+        if (event->Start > now)
+            end = FFMIN(end, event->Start);
+        else if (now < event->Start + event->Duration)
+            return; /* active, only drawing nothing right now */
+    }
+    ass->idle_start  = now;
+    ass->idle_end    = end;
+    ass->idle_events = track->n_events;
+}
+//PLEX
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -192,13 +511,40 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     AssContext *ass = ctx->priv;
     int detect_change = 0;
     double time_ms = picref->pts * av_q2d(inlink->time_base) * 1000;
-    ASS_Image *image = ass_render_frame(ass->renderer, ass->track,
-                                        time_ms, &detect_change);
+    long long now = time_ms;
+    ASS_Image *image;
+    int ret;
+
+    //PLEX
+    if (ass->track->n_events == ass->idle_events &&
+        now >= ass->idle_start && now < ass->idle_end)
+        return ff_filter_frame(outlink, picref);
+    //PLEX
+
+    /* libass picks up the fonts other instances added at frame start */
+    ff_mutex_lock(&ass->shared->lock); //PLEX
+    image = ass_render_frame(ass->renderer, ass->track, time_ms, &detect_change);
+    ff_mutex_unlock(&ass->shared->lock); //PLEX
 
     if (detect_change)
         av_log(ctx, AV_LOG_DEBUG, "Change happened at time ms:%f\n", time_ms);
 
-    overlay_ass_image(ass, picref, image);
+    //PLEX
+    if (!image) {
+        ass->layers_valid = 0;
+        update_idle_range(ass, now);
+        return ff_filter_frame(outlink, picref);
+    }
+
+    if (detect_change || !ass->layers_valid) {
+        ret = composite_layers(ass, image);
+        if (ret < 0) {
+            av_frame_free(&picref);
+            return ret;
+        }
+    }
+    overlay_ass_layers(ctx, picref);
+    //PLEX
 
     return ff_filter_frame(outlink, picref);
 }
@@ -235,9 +581,11 @@ static av_cold int init_ass(AVFilterContext *ctx)
         return ret;
 
     /* Initialize fonts */
+    ff_mutex_lock(&ass->shared->lock); //PLEX
     ass_set_fonts(ass->renderer, NULL, NULL, 1, NULL, 1);
 
     ass->track = ass_read_file(ass->library, ass->filename, NULL);
+    ff_mutex_unlock(&ass->shared->lock); //PLEX
     if (!ass->track) {
         av_log(ctx, AV_LOG_ERROR,
                "Could not create a libass track when reading file '%s'\n",
@@ -257,6 +605,7 @@ const AVFilter ff_vf_ass = {
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_QUERY_FUNC(query_formats),
     .priv_class    = &ass_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
 #endif
 
@@ -268,6 +617,7 @@ static const AVOption subtitles_options[] = {
     {"stream_index", "set stream index",             OFFSET(stream_index), AV_OPT_TYPE_INT,    { .i64 = -1 }, -1,       INT_MAX,  FLAGS},
     {"si",           "set stream index",             OFFSET(stream_index), AV_OPT_TYPE_INT,    { .i64 = -1 }, -1,       INT_MAX,  FLAGS},
     {"force_style",  "force subtitle style",         OFFSET(force_style),  AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS},
+    {"lazy_fonts",   "only load the attached fonts used by the styles and events", OFFSET(lazy_fonts), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, FLAGS }, //PLEX
 #if FF_ASS_FEATURE_WRAP_UNICODE
     {"wrap_unicode", "break lines according to the Unicode Line Breaking Algorithm", OFFSET(wrap_unicode), AV_OPT_TYPE_BOOL, { .i64 = -1 }, -1, 1, FLAGS },
 #endif
@@ -304,6 +654,228 @@ static int attachment_is_font(AVStream * st)
     return 0;
 }
 
+//PLEX
+static int add_font_name(AVDictionary **names, const char *name, size_t len)
+{
+    char buf[256];
+
+    while (len && *name == ' ') {
+        name++;
+        len--;
+    }
+    /* vertical layout variant of the family */
+    if (len && *name == '@') {
+        name++;
+        len--;
+    }
+    while (len && name[len - 1] == ' ')
+        len--;
+    if (!len)
+        return 0;
+
+    av_strlcpy(buf, name, FFMIN(len + 1, sizeof(buf)));
+    return av_dict_set(names, buf, "", 0);
+}
+
+/* Collect the font names of the styles and of the \fn override tags. */
+static int track_font_names(const ASS_Track *track, AVDictionary **names)
+{
+    int ret;
+
+    for (int i = 0; i < track->n_styles; i++) {
+        const char *name = track->styles[i].FontName;
+        if (name && (ret = add_font_name(names, name, strlen(name))) < 0)
+            return ret;
+    }
+
+    for (int i = 0; i < track->n_events; i++) {
+        const char *p = track->events[i].Text;
+
+        while (p && (p = strstr(p, "\\fn"))) {
+            size_t len;
+
+            p  += 3;
+            len = strcspn(p, "\\}");
+            if ((ret = add_font_name(names, p, len)) < 0)
+                return ret;
+            p  += len;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Look up the family, full and PostScript names of the sfnt font at offset.
+ *
+ * @return 1 if one of them is in names, 0 if none is, a negative error code
+ *         if the font could not be parsed
+ */
+static int sfnt_names_match(const uint8_t *buf, int size, uint32_t offset,
+                            AVDictionary *names)
+{
+    const uint8_t *table = NULL;
+    uint32_t version, table_size = 0;
+    unsigned nb_tables, count, strings;
+
+    if (size < 12 || offset > size - 12)
+        return AVERROR_INVALIDDATA;
+    version = AV_RB32(buf + offset);
+    if (version != 0x00010000 && version != MKBETAG('O','T','T','O') &&
+        version != MKBETAG('t','r','u','e'))
+        return AVERROR_INVALIDDATA;
+
+    nb_tables = AV_RB16(buf + offset + 4);
+    if (nb_tables > (size - offset - 12) / 16)
+        return AVERROR_INVALIDDATA;
+    for (unsigned i = 0; i < nb_tables; i++) {
+        const uint8_t *rec = buf + offset + 12 + 16 * i;
+        uint32_t pos = AV_RB32(rec + 8);
+
+        if (AV_RB32(rec) != MKBETAG('n','a','m','e'))
+            continue;
+        table_size = AV_RB32(rec + 12);
+        if (pos > size || table_size > size - pos || table_size < 6)
+            return AVERROR_INVALIDDATA;
+        table = buf + pos;
+        break;
+    }
+    if (!table)
+        return AVERROR_INVALIDDATA;
+
+    count   = AV_RB16(table + 2);
+    strings = AV_RB16(table + 4);
+    if (count > (table_size - 6) / 12 || strings > table_size)
+        return AVERROR_INVALIDDATA;
+
+    for (unsigned i = 0; i < count; i++) {
+        const uint8_t *rec = table + 6 + 12 * i;
+        unsigned platform = AV_RB16(rec);
+        unsigned name_id  = AV_RB16(rec + 6);
+        unsigned len      = AV_RB16(rec + 8);
+        unsigned pos      = strings + AV_RB16(rec + 10);
+        const uint8_t *str = table + pos, *end;
+        char name[256];
+        int n = 0;
+
+        /* family, full, PostScript and typographic family names */
+        if ((name_id != 1 && name_id != 4 && name_id != 6 && name_id != 16) ||
+            pos > table_size || len > table_size - pos)
+            continue;
+
+        end = str + len;
+        if (platform == 0 || platform == 3) {
+            end = str + (len & ~1);
+            while (str < end) {
+                uint32_t ch;
+                uint8_t tmp;
+
+                GET_UTF16(ch, str < end ? (str += 2, AV_RB16(str - 2)) : 0, break;)
+                PUT_UTF8(ch, tmp, if (n < sizeof(name) - 1) name[n++] = tmp;)
+            }
+        } else if (platform == 1) {
+            while (str < end && n < sizeof(name) - 1)
+                name[n++] = *str++;
+        } else {
+            continue;
+        }
+        name[n] = 0;
+
+        if (n && av_dict_get(names, name, NULL, 0))
+            return 1;
+    }
+    return 0;
+}
+
+static int font_is_used(const uint8_t *data, int size, AVDictionary *names)
+{
+    if (size >= 12 && AV_RB32(data) == MKBETAG('t','t','c','f')) {
+        uint32_t nb_fonts = AV_RB32(data + 8);
+
+        if (nb_fonts > (size - 12) / 4)
+            return AVERROR_INVALIDDATA;
+        for (uint32_t i = 0; i < nb_fonts; i++) {
+            int ret = sfnt_names_match(data, size, AV_RB32(data + 12 + 4 * i), names);
+            if (ret)
+                return ret;
+        }
+        return 0;
+    }
+    return sfnt_names_match(data, size, 0, names);
+}
+
+static void add_attached_font(AVFilterContext *ctx, const char *name,
+                              const uint8_t *data, int size)
+{
+    AssContext *ass = ctx->priv;
+    AssSharedLibrary *shared = ass->shared;
+    uint64_t id = (uint64_t)size << 32 |
+                  av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), 0, data, size);
+    int i;
+
+    ff_mutex_lock(&shared->lock);
+    for (i = 0; i < shared->nb_fonts; i++)
+        if (shared->fonts[i] == id)
+            break;
+    if (i < shared->nb_fonts) {
+        av_log(ctx, AV_LOG_DEBUG, "Attached font already loaded: %s\n", name);
+    } else {
+        av_log(ctx, AV_LOG_DEBUG, "Loading attached font: %s\n", name);
+        ass_add_font(ass->library, name, (char *)data, size);
+        /* at worst the font gets copied again by a later instance */
+        if (av_reallocp_array(&shared->fonts, shared->nb_fonts + 1, sizeof(*shared->fonts)) >= 0)
+            shared->fonts[shared->nb_fonts++] = id;
+        else
+            shared->nb_fonts = 0;
+    }
+    ff_mutex_unlock(&shared->lock);
+}
+
+static int load_attached_fonts(AVFilterContext *ctx, AVFormatContext *fmt)
+{
+    AssContext *ass = ctx->priv;
+    AVDictionary *names = NULL;
+    int ret;
+
+    if (ass->lazy_fonts) {
+        ret = track_font_names(ass->track, &names);
+        if (ret < 0)
+            return ret;
+    }
+
+    for (int j = 0; j < fmt->nb_streams; j++) {
+        AVStream *st = fmt->streams[j];
+        const AVDictionaryEntry *tag;
+
+        if (st->codecpar->codec_type != AVMEDIA_TYPE_ATTACHMENT ||
+            !attachment_is_font(st))
+            continue;
+
+        tag = av_dict_get(st->metadata, "filename", NULL, AV_DICT_MATCH_CASE);
+        if (!tag) {
+            av_log(ctx, AV_LOG_WARNING,
+                   "Font attachment has no filename, ignored.\n");
+            continue;
+        }
+        /* fonts whose names can't be read are loaded anyway */
+        if (ass->lazy_fonts &&
+            !font_is_used(st->codecpar->extradata, st->codecpar->extradata_size, names)) {
+            av_log(ctx, AV_LOG_DEBUG, "Skipping unused attached font: %s\n",
+                   tag->value);
+            continue;
+        }
+        add_attached_font(ctx, tag->value, st->codecpar->extradata,
+                          st->codecpar->extradata_size);
+    }
+    av_dict_free(&names);
+
+    /* Initialize fonts */
+    ff_mutex_lock(&ass->shared->lock);
+    ass_set_fonts(ass->renderer, NULL, NULL, 1, NULL, 1);
+    ff_mutex_unlock(&ass->shared->lock);
+    return 0;
+}
+//PLEX
+
 AVFILTER_DEFINE_CLASS(subtitles);
 
 static av_cold int init_subtitles(AVFilterContext *ctx)
@@ -339,6 +911,21 @@ static av_cold int init_subtitles(AVFilterContext *ctx)
     if (ret < 0)
         goto end;
 
+    //PLEX
+    /* Lay the subtitles out for the video stored in the same file, so that
+     * they can be rendered after a scaler at the output size. */
+    if (!ass->original_w || !ass->original_h) {
+        ret = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+        if (ret >= 0 && fmt->streams[ret]->codecpar->width > 0 &&
+            fmt->streams[ret]->codecpar->height > 0) {
+            ass->original_w = fmt->streams[ret]->codecpar->width;
+            ass->original_h = fmt->streams[ret]->codecpar->height;
+            av_log(ctx, AV_LOG_VERBOSE, "Using original size %dx%d of video stream #%d\n",
+                   ass->original_w, ass->original_h, ret);
+        }
+    }
+    //PLEX
+
     /* Locate subtitles stream */
     if (ass->stream_index < 0)
         ret = av_find_best_stream(fmt, AVMEDIA_TYPE_SUBTITLE, -1, -1, NULL, 0);
@@ -365,31 +952,6 @@ static av_cold int init_subtitles(AVFilterContext *ctx)
     sid = ret;
     st = fmt->streams[sid];
 
-    /* Load attached fonts */
-    for (j = 0; j < fmt->nb_streams; j++) {
-        AVStream *st = fmt->streams[j];
-        if (st->codecpar->codec_type == AVMEDIA_TYPE_ATTACHMENT &&
-            attachment_is_font(st)) {
-            const AVDictionaryEntry *tag = NULL;
-            tag = av_dict_get(st->metadata, "filename", NULL,
-                              AV_DICT_MATCH_CASE);
-
-            if (tag) {
-                av_log(ctx, AV_LOG_DEBUG, "Loading attached font: %s\n",
-                       tag->value);
-                ass_add_font(ass->library, tag->value,
-                             st->codecpar->extradata,
-                             st->codecpar->extradata_size);
-            } else {
-                av_log(ctx, AV_LOG_WARNING,
-                       "Font attachment has no filename, ignored.\n");
-            }
-        }
-    }
-
-    /* Initialize fonts */
-    ass_set_fonts(ass->renderer, NULL, NULL, 1, NULL, 1);
-
     /* Open decoder */
     dec = avcodec_find_decoder(st->codecpar->codec_id);
     if (!dec) {
@@ -444,32 +1006,18 @@ static av_cold int init_subtitles(AVFilterContext *ctx)
     }
 #endif
 
-    if (ass->force_style) {
-        char **list = NULL;
-        char *temp = NULL;
-        char *ptr = av_strtok(ass->force_style, ",", &temp);
-        int i = 0;
-        while (ptr) {
-            av_dynarray_add(&list, &i, ptr);
-            if (!list) {
-                ret = AVERROR(ENOMEM);
-                goto end;
-            }
-            ptr = av_strtok(NULL, ",", &temp);
-        }
-        av_dynarray_add(&list, &i, NULL);
-        if (!list) {
-            ret = AVERROR(ENOMEM);
-            goto end;
-        }
-        ass_set_style_overrides(ass->library, list);
-        av_free(list);
-    }
     /* Decode subtitles and push them into the renderer (libass) */
-    if (dec_ctx->subtitle_header)
+    //PLEX
+    /* the style overrides are set on the shared library; embedded [Fonts]
+     * are added to it while processing the header */
+    if (dec_ctx->subtitle_header) {
+        ff_mutex_lock(&ass->shared->lock);
         ass_process_codec_private(ass->track,
                                   dec_ctx->subtitle_header,
                                   dec_ctx->subtitle_header_size);
+        ff_mutex_unlock(&ass->shared->lock);
+    }
+    //PLEX
     while (av_read_frame(fmt, &pkt) >= 0) {
         int i, got_subtitle;
         AVSubtitle sub = {0};
@@ -495,6 +1043,9 @@ static av_cold int init_subtitles(AVFilterContext *ctx)
         avsubtitle_free(&sub);
     }
 
+    /* Load attached fonts, now that the fonts used are known */
+    ret = load_attached_fonts(ctx, fmt); //PLEX
+
 end:
     av_dict_free(&codec_opts);
     avcodec_free_context(&dec_ctx);
@@ -512,5 +1063,6 @@ const AVFilter ff_vf_subtitles = {
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_QUERY_FUNC(query_formats),
     .priv_class    = &subtitles_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
 #endif
@@ -36,18 +36,11 @@
 #include "avfilter.h"
 #include "colorspace.h"
 #include "internal.h"
+#include "tonemap.h"
 #include "video.h"
 
-enum TonemapAlgorithm {
-    TONEMAP_NONE,
-    TONEMAP_LINEAR,
-    TONEMAP_GAMMA,
-    TONEMAP_CLIP,
-    TONEMAP_REINHARD,
-    TONEMAP_HABLE,
-    TONEMAP_MOBIUS,
-    TONEMAP_MAX,
-};
+/* time constant of the scene peak smoothing, in frames */
+#define PEAK_DETECT_FRAMES 16
 
 typedef struct TonemapContext {
     const AVClass *class;
@@ -56,118 +49,32 @@ typedef struct TonemapContext {
     double param;
     double desat;
     double peak;
+    int use_lut;
+    int peak_detect;
+    double threshold;
 
     const AVLumaCoefficients *coeffs;
+    FFTonemapCurve curve;
+
+    float *slice_peak;
+    int nb_slice_peak;
+    double scene_peak;
 } TonemapContext;
 
 static av_cold int init(AVFilterContext *ctx)
 {
     TonemapContext *s = ctx->priv;
 
-    switch(s->tonemap) {
-    case TONEMAP_GAMMA:
-        if (isnan(s->param))
-            s->param = 1.8f;
-        break;
-    case TONEMAP_REINHARD:
-        if (!isnan(s->param))
-            s->param = (1.0f - s->param) / s->param;
-        break;
-    case TONEMAP_MOBIUS:
-        if (isnan(s->param))
-            s->param = 0.3f;
-        break;
-    }
-
-    if (isnan(s->param))
-        s->param = 1.0f;
+    ff_tonemap_curve_init(&s->curve, s->tonemap, s->param, s->use_lut);
 
     return 0;
 }
 
-static float hable(float in)
+static av_cold void uninit(AVFilterContext *ctx)
 {
-    float a = 0.15f, b = 0.50f, c = 0.10f, d = 0.20f, e = 0.02f, f = 0.30f;
-    return (in * (in * a + b * c) + d * e) / (in * (in * a + b) + d * f) - e / f;
-}
-
-static float mobius(float in, float j, double peak)
-{
-    float a, b;
-
-    if (in <= j)
-        return in;
-
-    a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
-    b = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6);
-
-    return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
-}
-
-#define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
-static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
-                    const AVPixFmtDescriptor *desc, int x, int y, double peak)
-{
-    int map[3] = { desc->comp[0].plane, desc->comp[1].plane, desc->comp[2].plane };
-    const float *r_in = (const float *)(in->data[map[0]] + x * desc->comp[map[0]].step + y * in->linesize[map[0]]);
-    const float *g_in = (const float *)(in->data[map[1]] + x * desc->comp[map[1]].step + y * in->linesize[map[1]]);
-    const float *b_in = (const float *)(in->data[map[2]] + x * desc->comp[map[2]].step + y * in->linesize[map[2]]);
-    float *r_out = (float *)(out->data[map[0]] + x * desc->comp[map[0]].step + y * out->linesize[map[0]]);
-    float *g_out = (float *)(out->data[map[1]] + x * desc->comp[map[1]].step + y * out->linesize[map[1]]);
-    float *b_out = (float *)(out->data[map[2]] + x * desc->comp[map[2]].step + y * out->linesize[map[2]]);
-    float sig, sig_orig;
-
-    /* load values */
-    *r_out = *r_in;
-    *g_out = *g_in;
-    *b_out = *b_in;
-
-    /* desaturate to prevent unnatural colors */
-    if (s->desat > 0) {
-        float luma = av_q2d(s->coeffs->cr) * *r_in + av_q2d(s->coeffs->cg) * *g_in + av_q2d(s->coeffs->cb) * *b_in;
-        float overbright = FFMAX(luma - s->desat, 1e-6) / FFMAX(luma, 1e-6);
-        *r_out = MIX(*r_in, luma, overbright);
-        *g_out = MIX(*g_in, luma, overbright);
-        *b_out = MIX(*b_in, luma, overbright);
-    }
-
-    /* pick the brightest component, reducing the value range as necessary
-     * to keep the entire signal in range and preventing discoloration due to
-     * out-of-bounds clipping */
-    sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
-    sig_orig = sig;
-
-    switch(s->tonemap) {
-    default:
-    case TONEMAP_NONE:
-        // do nothing
-        break;
-    case TONEMAP_LINEAR:
-        sig = sig * s->param / peak;
-        break;
-    case TONEMAP_GAMMA:
-        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
-                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
-        break;
-    case TONEMAP_CLIP:
-        sig = av_clipf(sig * s->param, 0, 1.0f);
-        break;
-    case TONEMAP_HABLE:
-        sig = hable(sig) / hable(peak);
-        break;
-    case TONEMAP_REINHARD:
-        sig = sig / (sig + s->param) * (peak + s->param) / peak;
-        break;
-    case TONEMAP_MOBIUS:
-        sig = mobius(sig, s->param, peak);
-        break;
-    }
+    TonemapContext *s = ctx->priv;
 
-    /* apply the computed scale factor to the color,
-     * linearly to prevent discoloration */
-    *r_out *= sig / sig_orig;
-    *g_out *= sig / sig_orig;
-    *b_out *= sig / sig_orig;
+    av_freep(&s->slice_peak);
 }
 
 typedef struct ThreadData {
@@ -185,15 +92,56 @@ static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs
     const AVPixFmtDescriptor *desc = td->desc;
     const int slice_start = (in->height * jobnr) / nb_jobs;
     const int slice_end = (in->height * (jobnr+1)) / nb_jobs;
-    double peak = td->peak;
+    const int map[3] = { desc->comp[0].plane, desc->comp[1].plane, desc->comp[2].plane };
+    const float peak = td->peak;
+    float max = 0.0f;
+
+    for (int y = slice_start; y < slice_end; y++) {
+        const float *r_in = (const float *)(in->data[map[0]] + y * in->linesize[map[0]]);
+        const float *g_in = (const float *)(in->data[map[1]] + y * in->linesize[map[1]]);
+        const float *b_in = (const float *)(in->data[map[2]] + y * in->linesize[map[2]]);
+        float *r_out = (float *)(out->data[map[0]] + y * out->linesize[map[0]]);
+        float *g_out = (float *)(out->data[map[1]] + y * out->linesize[map[1]]);
+        float *b_out = (float *)(out->data[map[2]] + y * out->linesize[map[2]]);
+        float row_max;
+
+        /* desaturate to prevent unnatural colors */
+        if (s->desat > 0) {
+            ff_tonemap_desat_row(r_out, g_out, b_out, r_in, g_in, b_in, out->width,
+                                 av_q2d(s->coeffs->cr), av_q2d(s->coeffs->cg),
+                                 av_q2d(s->coeffs->cb), s->desat);
+        } else {
+            memcpy(r_out, r_in, out->width * sizeof(*r_out));
+            memcpy(g_out, g_in, out->width * sizeof(*g_out));
+            memcpy(b_out, b_in, out->width * sizeof(*b_out));
+        }
+
+        row_max = ff_tonemap_row(&s->curve, r_out, g_out, b_out, out->width, peak);
+        max = FFMAX(max, row_max);
+    }
 
-    for (int y = slice_start; y < slice_end; y++)
-        for (int x = 0; x < out->width; x++)
-            tonemap(s, out, in, desc, x, y, peak);
+    if (s->slice_peak)
+        s->slice_peak[jobnr] = max;
 
     return 0;
 }
 
+/* Fold the highest signal level of the last frame into the running scene
+ * peak, starting over when the level jumps by more than the threshold. */
+static void update_scene_peak(TonemapContext *s, int nb_jobs)
+{
+    float frame_peak = 0.0f;
+
+    for (int i = 0; i < nb_jobs; i++)
+        frame_peak = FFMAX(frame_peak, s->slice_peak[i]);
+
+    if (!s->scene_peak ||
+        fabs(frame_peak - s->scene_peak) > s->threshold * s->scene_peak)
+        s->scene_peak = frame_peak;
+    else
+        s->scene_peak += (frame_peak - s->scene_peak) / PEAK_DETECT_FRAMES;
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     AVFilterContext *ctx = link->dst;
@@ -203,7 +151,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     AVFrame *out;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     const AVPixFmtDescriptor *odesc = av_pix_fmt_desc_get(outlink->format);
-    int ret, x, y;
+    int ret, x, y, nb_jobs;
     double peak = s->peak;
 
     if (!desc || !odesc) {
@@ -233,7 +181,12 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
 
     /* read peak from side data if not passed in */
     if (!peak) {
-        peak = ff_determine_signal_peak(in);
+        peak = ff_tonemap_dynamic_peak(in);
+        if (!peak)
+            peak = ff_determine_signal_peak(in);
+        /* the measured peak only ever lowers the one from the metadata */
+        if (s->peak_detect && s->scene_peak)
+            peak = FFMIN(FFMAX(s->scene_peak, 1.0), peak);
         av_log(s, AV_LOG_DEBUG, "Computed signal peak: %f\n", peak);
     }
 
@@ -249,13 +202,29 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         s->desat = 0;
     }
 
+    nb_jobs = FFMIN(in->height, ff_filter_get_nb_threads(ctx));
+    if (s->peak_detect && !s->peak && nb_jobs > s->nb_slice_peak) {
+        av_freep(&s->slice_peak);
+        s->slice_peak = av_calloc(nb_jobs, sizeof(*s->slice_peak));
+        if (!s->slice_peak) {
+            av_frame_free(&in);
+            av_frame_free(&out);
+            return AVERROR(ENOMEM);
+        }
+        s->nb_slice_peak = nb_jobs;
+    }
+
+    ff_tonemap_curve_set_peak(&s->curve, peak);
+
     /* do the tone map */
     td.out = out;
     td.in = in;
     td.desc = desc;
     td.peak = peak;
-    ff_filter_execute(ctx, tonemap_slice, &td, NULL,
-                      FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
+    ff_filter_execute(ctx, tonemap_slice, &td, NULL, nb_jobs);
+
+    if (s->slice_peak)
+        update_scene_peak(s, nb_jobs);
 
     /* copy/generate alpha if needed */
     if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
@@ -292,6 +261,9 @@ static const AVOption tonemap_options[] = {
     { "param",        "tonemap parameter", OFFSET(param), AV_OPT_TYPE_DOUBLE, {.dbl = NAN}, DBL_MIN, DBL_MAX, FLAGS },
     { "desat",        "desaturation strength", OFFSET(desat), AV_OPT_TYPE_DOUBLE, {.dbl = 2}, 0, DBL_MAX, FLAGS },
     { "peak",         "signal peak override", OFFSET(peak), AV_OPT_TYPE_DOUBLE, {.dbl = 0}, 0, DBL_MAX, FLAGS },
+    { "lut",          "use a lookup table for the tone curve", OFFSET(use_lut), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
+    { "peak_detect",  "measure the signal peak of each scene", OFFSET(peak_detect), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
+    { "threshold",    "scene change threshold of the peak detection", OFFSET(threshold), AV_OPT_TYPE_DOUBLE, {.dbl = 0.2}, 0, DBL_MAX, FLAGS },
     { NULL }
 };
 
@@ -309,6 +281,7 @@ const AVFilter ff_vf_tonemap = {
     .name            = "tonemap",
     .description     = NULL_IF_CONFIG_SMALL("Conversion to/from different dynamic ranges."),
     .init            = init,
+    .uninit          = uninit,
     .priv_size       = sizeof(TonemapContext),
     .priv_class      = &tonemap_class,
     FILTER_INPUTS(tonemap_inputs),
@@ -19,6 +19,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/common.h"
+#include "libavutil/dovi_meta.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
@@ -37,6 +38,30 @@
 
 #define DETECTION_FRAMES 63
 
+//PLEX
+/* Dolby Vision reshaping parameters, laid out as struct dovi_params in
+ * tonemap.cl. A piece with a zero mmr_order is a polynomial. */
+typedef struct DoviPiece {
+    cl_float poly[3];
+    cl_float mmr_constant;
+    cl_float mmr[3][7];
+    cl_int   mmr_order;
+} DoviPiece;
+
+typedef struct DoviCurve {
+    cl_float  pivots[AV_DOVI_MAX_PIECES + 1];
+    cl_int    num_pivots;
+    DoviPiece pieces[AV_DOVI_MAX_PIECES];
+} DoviCurve;
+
+typedef struct DoviParams {
+    DoviCurve curves[3];
+    cl_float  nonlinear[9];
+    cl_float  nonlinear_offset[3];
+    cl_float  linear[9];
+} DoviParams;
+//PLEX
+
 enum TonemapAlgorithm {
     TONEMAP_NONE,
     TONEMAP_LINEAR,
@@ -68,6 +93,12 @@ typedef struct TonemapOpenCLContext {
     cl_kernel             kernel;
     cl_command_queue      command_queue;
     cl_mem                util_mem;
+    //PLEX
+    int                   apply_dovi;
+    int                   dovi;
+    DoviParams            dovi_params;
+    cl_mem                dovi_mem;
+    //PLEX
 } TonemapOpenCLContext;
 
 static const char *const linearize_funcs[AVCOL_TRC_NB] = {
@@ -108,6 +139,75 @@ static int get_rgb2rgb_matrix(enum AVColorPrimaries in, enum AVColorPrimaries ou
     return 0;
 }
 
+//PLEX
+/* Hunt-Pointer-Estevez LMS to BT.2020 RGB, without crosstalk */
+static const double dovi_lms2rgb[3][3] = {
+    {  3.06441879, -2.16597676,  0.10155818 },
+    { -0.65612108,  1.78554118, -0.12943749 },
+    {  0.01736321, -0.04725154,  1.03004253 },
+};
+
+static void dovi_update_params(DoviParams *p, const AVDOVIMetadata *dovi)
+{
+    const AVDOVIRpuDataHeader *hdr = av_dovi_get_header(dovi);
+    const AVDOVIDataMapping *map = av_dovi_get_mapping(dovi);
+    const AVDOVIColorMetadata *color = av_dovi_get_color(dovi);
+    const float pivot_scale = 1.0f / ((1 << hdr->bl_bit_depth) - 1);
+    double rgb2lms[3][3], linear[3][3];
+
+    for (int c = 0; c < 3; c++) {
+        const AVDOVIReshapingCurve *curve = &map->curves[c];
+        DoviCurve *out = &p->curves[c];
+
+        out->num_pivots = curve->num_pivots;
+        for (int i = 0; i < curve->num_pivots; i++)
+            out->pivots[i] = curve->pivots[i] * pivot_scale;
+
+        for (int i = 0; i < curve->num_pivots - 1; i++) {
+            DoviPiece *piece = &out->pieces[i];
+
+            memset(piece, 0, sizeof(*piece));
+            if (curve->mapping_idc[i] == AV_DOVI_MAPPING_MMR) {
+                piece->mmr_order    = curve->mmr_order[i];
+                piece->mmr_constant = ldexp(curve->mmr_constant[i], -hdr->coef_log2_denom);
+                for (int k = 0; k < curve->mmr_order[i]; k++)
+                    for (int j = 0; j < 7; j++)
+                        piece->mmr[k][j] = ldexp(curve->mmr_coef[i][k][j], -hdr->coef_log2_denom);
+            } else {
+                for (int k = 0; k <= curve->poly_order[i]; k++)
+                    piece->poly[k] = ldexp(curve->poly_coef[i][k], -hdr->coef_log2_denom);
+            }
+        }
+    }
+
+    for (int i = 0; i < 9; i++) {
+        p->nonlinear[i]  = av_q2d(color->ycc_to_rgb_matrix[i]);
+        rgb2lms[i / 3][i % 3] = av_q2d(color->rgb_to_lms_matrix[i]);
+    }
+    for (int i = 0; i < 3; i++)
+        p->nonlinear_offset[i] = av_q2d(color->ycc_to_rgb_offset[i]);
+
+    ff_matrix_mul_3x3(linear, rgb2lms, dovi_lms2rgb);
+    for (int i = 0; i < 9; i++)
+        p->linear[i] = linear[i / 3][i % 3];
+}
+
+/* Peak of the source display from the RPU, in units of REFERENCE_WHITE. */
+static double dovi_signal_peak(const AVDOVIMetadata *dovi)
+{
+    const AVDOVIColorMetadata *color = av_dovi_get_color(dovi);
+    const double m1 = 0.1593017578125, m2 = 78.84375;
+    const double c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+    double p;
+
+    if (!color->source_max_pq)
+        return 0;
+
+    p = pow(color->source_max_pq / 4095.0, 1.0 / m2);
+    return pow(FFMAX(p - c1, 0) / (c2 - c3 * p), 1.0 / m1) * 10000 / REFERENCE_WHITE;
+}
+//PLEX
+
 #define OPENCL_SOURCE_NB 3
 // Average light level for SDR signals. This is equal to a signal level of 0.5
 // under a typical presentation gamma of about 2.0.
@@ -235,6 +335,11 @@ static int tonemap_opencl_init(AVFilterContext *avctx)
     if (ctx->trc_in == AVCOL_TRC_ARIB_STD_B67)
         av_bprintf(&header, "#define ootf_impl ootf_hlg\n");
 
+    //PLEX
+    if (ctx->dovi)
+        av_bprintf(&header, "#define DOVI_RESHAPE\n");
+    //PLEX
+
     if (ctx->trc_out == AVCOL_TRC_ARIB_STD_B67)
         av_bprintf(&header, "#define inverse_ootf_impl inverse_ootf_hlg\n");
 
@@ -263,11 +368,22 @@ static int tonemap_opencl_init(AVFilterContext *avctx)
                        NULL, &cle);
     CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to create util buffer: %d.\n", cle);
 
+    //PLEX
+    if (ctx->dovi) {
+        ctx->dovi_mem = clCreateBuffer(ctx->ocf.hwctx->context, CL_MEM_READ_ONLY,
+                                       sizeof(ctx->dovi_params), NULL, &cle);
+        CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to create Dolby Vision "
+                         "buffer: %d.\n", cle);
+    }
+    //PLEX
+
     ctx->initialised = 1;
     return 0;
 
 fail:
     av_bprint_finalize(&header, NULL);
+    if (ctx->dovi_mem)
+        clReleaseMemObject(ctx->dovi_mem); //PLEX
     if (ctx->util_mem)
         clReleaseMemObject(ctx->util_mem);
     if (ctx->command_queue)
@@ -315,6 +431,16 @@ static int launch_kernel(AVFilterContext *avctx, cl_kernel kernel,
     CL_SET_KERNEL_ARG(kernel, 3, cl_mem, &input->data[1]);
     CL_SET_KERNEL_ARG(kernel, 4, cl_mem, &ctx->util_mem);
     CL_SET_KERNEL_ARG(kernel, 5, cl_float, &peak);
+    //PLEX
+    if (ctx->dovi) {
+        cle = clEnqueueWriteBuffer(ctx->command_queue, ctx->dovi_mem, CL_FALSE,
+                                   0, sizeof(ctx->dovi_params), &ctx->dovi_params,
+                                   0, NULL, NULL);
+        CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to write Dolby Vision "
+                         "parameters: %d.\n", cle);
+        CL_SET_KERNEL_ARG(kernel, 6, cl_mem, &ctx->dovi_mem);
+    }
+    //PLEX
 
     local_work[0]  = 16;
     local_work[1]  = 16;
@@ -339,6 +465,7 @@ static int tonemap_opencl_filter_frame(AVFilterLink *inlink, AVFrame *input)
     AVFilterLink     *outlink = avctx->outputs[0];
     TonemapOpenCLContext *ctx = avctx->priv;
     AVFrame *output = NULL;
+    AVFrameSideData *sd; //PLEX
     cl_int cle;
     int err;
     double peak = ctx->peak;
@@ -363,6 +490,18 @@ static int tonemap_opencl_filter_frame(AVFilterLink *inlink, AVFrame *input)
     if (err < 0)
         goto fail;
 
+    //PLEX
+    sd = av_frame_get_side_data(input, AV_FRAME_DATA_DOVI_METADATA);
+    if (sd && ctx->apply_dovi && (ctx->dovi || !ctx->initialised)) {
+        const AVDOVIMetadata *dovi = (const AVDOVIMetadata *)sd->data;
+
+        dovi_update_params(&ctx->dovi_params, dovi);
+        if (!peak)
+            peak = dovi_signal_peak(dovi);
+        ctx->dovi = 1;
+    }
+    //PLEX
+
     if (!peak)
         peak = ff_determine_signal_peak(input);
 
@@ -385,9 +524,24 @@ static int tonemap_opencl_filter_frame(AVFilterLink *inlink, AVFrame *input)
     ctx->range_out = output->color_range;
     ctx->chroma_loc = output->chroma_location;
 
+    //PLEX
+    /* the reshaped signal is always BT.2020 PQ, whatever the tags say */
+    if (ctx->dovi) {
+        ctx->trc_in        = AVCOL_TRC_SMPTE2084;
+        ctx->colorspace_in = AVCOL_SPC_BT2020_NCL;
+        ctx->primaries_in  = AVCOL_PRI_BT2020;
+        if (ctx->primaries == -1)
+            output->color_primaries = ctx->primaries_out = AVCOL_PRI_BT2020;
+        if (ctx->colorspace == -1)
+            output->colorspace = ctx->colorspace_out = AVCOL_SPC_BT2020_NCL;
+        av_frame_remove_side_data(output, AV_FRAME_DATA_DOVI_METADATA);
+        av_frame_remove_side_data(output, AV_FRAME_DATA_DOVI_RPU_BUFFER);
+    }
+    //PLEX
+
     if (!ctx->initialised) {
-        if (!(input->color_trc == AVCOL_TRC_SMPTE2084 ||
-            input->color_trc == AVCOL_TRC_ARIB_STD_B67)) {
+        if (!(ctx->trc_in == AVCOL_TRC_SMPTE2084 ||
+            ctx->trc_in == AVCOL_TRC_ARIB_STD_B67)) {
             av_log(ctx, AV_LOG_ERROR, "unsupported transfer function characteristic.\n");
             err = AVERROR(ENOSYS);
             goto fail;
@@ -461,6 +615,8 @@ static av_cold void tonemap_opencl_uninit(AVFilterContext *avctx)
     TonemapOpenCLContext *ctx = avctx->priv;
     cl_int cle;
 
+    if (ctx->dovi_mem)
+        clReleaseMemObject(ctx->dovi_mem); //PLEX
     if (ctx->util_mem)
         clReleaseMemObject(ctx->util_mem);
     if (ctx->kernel) {
@@ -514,6 +670,7 @@ static const AVOption tonemap_opencl_options[] = {
     { "param",     "tonemap parameter",   OFFSET(param), AV_OPT_TYPE_DOUBLE, {.dbl = NAN}, DBL_MIN, DBL_MAX, FLAGS },
     { "desat",     "desaturation parameter",   OFFSET(desat_param), AV_OPT_TYPE_DOUBLE, {.dbl = 0.5}, 0, DBL_MAX, FLAGS },
     { "threshold", "scene detection threshold",   OFFSET(scene_threshold), AV_OPT_TYPE_DOUBLE, {.dbl = 0.2}, 0, DBL_MAX, FLAGS },
+    { "apply_dovi", "apply Dolby Vision reshaping if present", OFFSET(apply_dovi), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS }, //PLEX
     { NULL }
 };
 
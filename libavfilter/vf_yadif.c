@@ -186,6 +186,23 @@ static void filter_edges_16bit(void *dst1, void *prev1, void *cur1, void *next1,
     FILTER(offset, w, 0)
 }
 
+//PLEX
+av_cold void ff_yadif_init_filter_line(YADIFContext *s)
+{
+    if (s->csp->comp[0].depth > 8) {
+        s->filter_line  = filter_line_c_16bit;
+        s->filter_edges = filter_edges_16bit;
+    } else {
+        s->filter_line  = filter_line_c;
+        s->filter_edges = filter_edges;
+    }
+
+#if ARCH_X86
+    ff_yadif_init_x86(s);
+#endif
+}
+//PLEX
+
 static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     YADIFContext *s = ctx->priv;
@@ -308,17 +325,7 @@ static int config_output(AVFilterLink *outlink)
 
     s->csp = av_pix_fmt_desc_get(outlink->format);
     s->filter = filter;
-    if (s->csp->comp[0].depth > 8) {
-        s->filter_line  = filter_line_c_16bit;
-        s->filter_edges = filter_edges_16bit;
-    } else {
-        s->filter_line  = filter_line_c;
-        s->filter_edges = filter_edges;
-    }
-
-#if ARCH_X86
-    ff_yadif_init_x86(s);
-#endif
+    ff_yadif_init_filter_line(s); //PLEX
 
     return 0;
 }
@@ -31,10 +31,13 @@
 #include <zimg.h>
 
 #include "avfilter.h"
+#include "colorspace.h"
 #include "formats.h"
 #include "internal.h"
+#include "tonemap.h"
 #include "video.h"
 #include "libavutil/avstring.h"
+#include "libavutil/csp.h"
 #include "libavutil/eval.h"
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
@@ -106,6 +109,13 @@ typedef struct ZScaleContext {
     double param_a;
     double param_b;
 
+    enum TonemapAlgorithm tonemap;
+    double tonemap_param;
+    double tonemap_desat;
+    double tonemap_peak;
+    FFTonemapCurve curve;
+    const AVLumaCoefficients *coeffs;
+
     char *w_expr;               ///< width  expression string
     char *h_expr;               ///< height expression string
 
@@ -133,6 +143,11 @@ typedef struct ZScaleContext {
     zimg_graph_builder_params alpha_params_tmp, params_tmp;
     zimg_filter_graph *alpha_graph[MAX_THREADS], *graph[MAX_THREADS];
 
+    /* with tonemapping, graph[] only linearizes each slice into lin[], and
+     * tm_graph[] converts the tone mapped slice to the output format */
+    zimg_filter_graph *tm_graph[MAX_THREADS];
+    AVFrame *lin[MAX_THREADS];
+
     enum AVColorSpace in_colorspace, out_colorspace;
     enum AVColorTransferCharacteristic in_trc, out_trc;
     enum AVColorPrimaries in_primaries, out_primaries;
@@ -143,6 +158,7 @@ typedef struct ZScaleContext {
 typedef struct ThreadData {
     const AVPixFmtDescriptor *desc, *odesc;
     AVFrame *in, *out;
+    float peak;
 } ThreadData;
 
 static av_cold int init(AVFilterContext *ctx)
@@ -190,6 +206,8 @@ static av_cold int init(AVFilterContext *ctx)
     if (!s->h_expr)
         av_opt_set(s, "h", "ih", 0);
 
+    ff_tonemap_curve_init(&s->curve, s->tonemap, s->tonemap_param, 0);
+
     return 0;
 }
 
@@ -575,12 +593,60 @@ static void format_init(zimg_image_format *format, AVFrame *frame, const AVPixFm
     format->chroma_location = location == -1 ? convert_chroma_location(frame->chroma_location) : location;
 }
 
+/* R, G, B planes of the GBRPF32 slice buffers */
+static const int lin_plane[3] = { 2, 0, 1 };
+
+/* Point the slice at linear light RGB in the output primaries, to be tone
+ * mapped in place and converted on to the output format by a second graph. */
+static int lin_graph_build(AVFilterContext *ctx, zimg_image_format *dst_format,
+                           int job_nr, size_t *tmp_size)
+{
+    ZScaleContext *s = ctx->priv;
+    zimg_image_format lin_format;
+    AVFrame *lin;
+    int ret;
+
+    zimg_image_format_default(&lin_format, ZIMG_API_VERSION);
+    lin_format.width = dst_format->width;
+    lin_format.height = dst_format->height;
+    lin_format.depth = 32;
+    lin_format.pixel_type = ZIMG_PIXEL_FLOAT;
+    lin_format.color_family = ZIMG_COLOR_RGB;
+    lin_format.matrix_coefficients = ZIMG_MATRIX_RGB;
+    lin_format.transfer_characteristics = ZIMG_TRANSFER_LINEAR;
+    lin_format.color_primaries = dst_format->color_primaries;
+    lin_format.pixel_range = ZIMG_RANGE_FULL;
+
+    if (s->tm_graph[job_nr])
+        zimg_filter_graph_free(s->tm_graph[job_nr]);
+    s->tm_graph[job_nr] = zimg_filter_graph_build(&lin_format, dst_format, &s->params);
+    if (!s->tm_graph[job_nr])
+        return print_zimg_error(ctx);
+
+    ret = zimg_filter_graph_get_tmp_size(s->tm_graph[job_nr], tmp_size);
+    if (ret)
+        return print_zimg_error(ctx);
+
+    av_frame_free(&s->lin[job_nr]);
+    lin = s->lin[job_nr] = av_frame_alloc();
+    if (!lin)
+        return AVERROR(ENOMEM);
+    lin->format = AV_PIX_FMT_GBRPF32;
+    lin->width  = lin_format.width;
+    lin->height = lin_format.height;
+    if ((ret = av_frame_get_buffer(lin, ZIMG_ALIGNMENT)) < 0)
+        return ret;
+
+    *dst_format = lin_format;
+    return 0;
+}
+
 static int graphs_build(AVFrame *in, AVFrame *out, const AVPixFmtDescriptor *desc, const AVPixFmtDescriptor *out_desc,
                         AVFilterContext *ctx, int job_nr, int n_jobs)
 {
     ZScaleContext *s = ctx->priv;
     int ret;
-    size_t size;
+    size_t size, tm_size = 0;
     zimg_image_format src_format;
     zimg_image_format dst_format;
     zimg_image_format alpha_src_format;
@@ -603,6 +669,12 @@ static int graphs_build(AVFrame *in, AVFrame *out, const AVPixFmtDescriptor *des
     dst_format.width = out->width;
     dst_format.height = out_slice_end - out_slice_start;
 
+    if (s->tonemap != TONEMAP_NONE) {
+        ret = lin_graph_build(ctx, &dst_format, job_nr, &tm_size);
+        if (ret < 0)
+            return ret;
+    }
+
     if (s->graph[job_nr]) {
         zimg_filter_graph_free(s->graph[job_nr]);
     }
@@ -613,6 +685,7 @@ static int graphs_build(AVFrame *in, AVFrame *out, const AVPixFmtDescriptor *des
     ret = zimg_filter_graph_get_tmp_size(s->graph[job_nr], &size);
     if (ret)
         return print_zimg_error(ctx);
+    size = FFMAX(size, tm_size);
 
     if (s->tmp[job_nr])
         av_freep(&s->tmp[job_nr]);
@@ -700,6 +773,50 @@ static void update_output_color_information(ZScaleContext *s, AVFrame *frame)
         frame->chroma_location = (int)s->dst_format.chroma_location + 1;
 }
 
+static int tonemap_process(AVFilterContext *ctx, ThreadData *td, int job_nr,
+                           const zimg_image_buffer_const *src_buf,
+                           const zimg_image_buffer *dst_buf)
+{
+    ZScaleContext *s = ctx->priv;
+    AVFrame *lin = s->lin[job_nr];
+    zimg_image_buffer lin_dst = { ZIMG_API_VERSION };
+    zimg_image_buffer_const lin_src = { ZIMG_API_VERSION };
+    int ret;
+
+    for (int i = 0; i < 3; i++) {
+        lin_dst.plane[i].data = lin->data[lin_plane[i]];
+        lin_dst.plane[i].stride = lin->linesize[lin_plane[i]];
+        lin_dst.plane[i].mask = -1;
+
+        lin_src.plane[i].data = lin->data[lin_plane[i]];
+        lin_src.plane[i].stride = lin->linesize[lin_plane[i]];
+        lin_src.plane[i].mask = -1;
+    }
+
+    if (!s->graph[job_nr] || !s->tm_graph[job_nr])
+        return AVERROR(EINVAL);
+    ret = zimg_filter_graph_process(s->graph[job_nr], src_buf, &lin_dst, s->tmp[job_nr], 0, 0, 0, 0);
+    if (ret)
+        return print_zimg_error(ctx);
+
+    for (int y = 0; y < lin->height; y++) {
+        float *r = (float *)(lin->data[lin_plane[0]] + y * lin->linesize[lin_plane[0]]);
+        float *g = (float *)(lin->data[lin_plane[1]] + y * lin->linesize[lin_plane[1]]);
+        float *b = (float *)(lin->data[lin_plane[2]] + y * lin->linesize[lin_plane[2]]);
+
+        if (s->coeffs)
+            ff_tonemap_desat_row(r, g, b, r, g, b, lin->width,
+                                 av_q2d(s->coeffs->cr), av_q2d(s->coeffs->cg),
+                                 av_q2d(s->coeffs->cb), s->tonemap_desat);
+        ff_tonemap_row(&s->curve, r, g, b, lin->width, td->peak);
+    }
+
+    ret = zimg_filter_graph_process(s->tm_graph[job_nr], &lin_src, dst_buf, s->tmp[job_nr], 0, 0, 0, 0);
+    if (ret)
+        return print_zimg_error(ctx);
+    return 0;
+}
+
 static int filter_slice(AVFilterContext *ctx, void *data, int job_nr, int n_jobs)
 {
     ThreadData *td = data;
@@ -740,11 +857,17 @@ static int filter_slice(AVFilterContext *ctx, void *data, int job_nr, int n_jobs
         dst_buf.plane[i].stride = td->out->linesize[p];
         dst_buf.plane[i].mask = -1;
     }
-    if (!s->graph[job_nr])
-        return AVERROR(EINVAL);
-    ret = zimg_filter_graph_process(s->graph[job_nr], &src_buf, &dst_buf, s->tmp[job_nr], 0, 0, 0, 0);
-    if (ret)
-        return print_zimg_error(ctx);
+    if (s->tonemap != TONEMAP_NONE) {
+        ret = tonemap_process(ctx, td, job_nr, &src_buf, &dst_buf);
+        if (ret < 0)
+            return ret;
+    } else {
+        if (!s->graph[job_nr])
+            return AVERROR(EINVAL);
+        ret = zimg_filter_graph_process(s->graph[job_nr], &src_buf, &dst_buf, s->tmp[job_nr], 0, 0, 0, 0);
+        if (ret)
+            return print_zimg_error(ctx);
+    }
 
     if (td->desc->flags & AV_PIX_FMT_FLAG_ALPHA && td->odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
         src_buf.plane[0].data = td->in->data[3];
@@ -764,6 +887,40 @@ static int filter_slice(AVFilterContext *ctx, void *data, int job_nr, int n_jobs
     return 0;
 }
 
+static void tonemap_setup(AVFilterContext *ctx, ThreadData *td)
+{
+    ZScaleContext *s = ctx->priv;
+    double peak = s->tonemap_peak;
+
+    if (!peak) {
+        peak = ff_tonemap_dynamic_peak(td->in);
+        if (!peak)
+            peak = ff_determine_signal_peak(td->in);
+        /* zimg scales linear light to the nominal peak luminance */
+        if (s->nominal_peak_luminance > 0)
+            peak = peak * REFERENCE_WHITE / s->nominal_peak_luminance;
+        av_log(ctx, AV_LOG_DEBUG, "Computed signal peak: %f\n", peak);
+    }
+    td->peak = peak;
+    ff_tonemap_curve_set_peak(&s->curve, peak);
+
+    s->coeffs = NULL;
+    if (s->tonemap_desat > 0) {
+        s->coeffs = av_csp_luma_coeffs_from_avcsp(td->out->colorspace);
+        if (!s->coeffs)
+            s->coeffs = av_csp_luma_coeffs_from_avcsp(td->in->colorspace);
+        if (!s->coeffs) {
+            av_log(ctx, AV_LOG_WARNING, "Missing color space information, "
+                   "desaturation is disabled\n");
+            s->tonemap_desat = 0;
+        }
+    }
+
+    av_frame_remove_side_data(td->out, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
+    av_frame_remove_side_data(td->out, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+    av_frame_remove_side_data(td->out, AV_FRAME_DATA_DYNAMIC_HDR_PLUS);
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     AVFilterContext *ctx = link->dst;
@@ -782,6 +939,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         (link->w != outlink->w) ||
         (link->h != outlink->h) ||
         s->first_time ||
+        s->tonemap != TONEMAP_NONE ||
         (s->src_format.chroma_location != s->dst_format.chroma_location) ||
         (s->src_format.color_family !=s->dst_format.color_family) ||
         (s->src_format.color_primaries !=s->dst_format.color_primaries) ||
@@ -877,6 +1035,9 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         td.desc = desc;
         td.odesc = odesc;
 
+        if (s->tonemap != TONEMAP_NONE)
+            tonemap_setup(ctx, &td);
+
         memset(s->jobs_ret, 0, s->nb_threads * sizeof(*s->jobs_ret));
         ret = ff_filter_execute(ctx, filter_slice, &td, s->jobs_ret, s->nb_threads);
         for (int i = 0; ret >= 0 && i < s->nb_threads; i++)
@@ -947,6 +1108,11 @@ static av_cold void uninit(AVFilterContext *ctx)
             zimg_filter_graph_free(s->alpha_graph[i]);
             s->alpha_graph[i] = NULL;
         }
+        if (s->tm_graph[i]) {
+            zimg_filter_graph_free(s->tm_graph[i]);
+            s->tm_graph[i] = NULL;
+        }
+        av_frame_free(&s->lin[i]);
     }
 }
 
@@ -1100,6 +1266,17 @@ static const AVOption zscale_options[] = {
     { "param_a", "parameter A, which is parameter \"b\" for bicubic, "
                  "and the number of filter taps for lanczos", OFFSET(param_a), AV_OPT_TYPE_DOUBLE, {.dbl = NAN}, -DBL_MAX, DBL_MAX, FLAGS },
     { "param_b", "parameter B, which is parameter \"c\" for bicubic", OFFSET(param_b), AV_OPT_TYPE_DOUBLE, {.dbl = NAN}, -DBL_MAX, DBL_MAX, FLAGS },
+    { "tonemap", "tone map linear light on the way to the output", OFFSET(tonemap), AV_OPT_TYPE_INT, {.i64 = TONEMAP_NONE}, TONEMAP_NONE, TONEMAP_MAX - 1, FLAGS, "tonemap" },
+    {     "none",     0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_NONE},     0, 0, FLAGS, "tonemap" },
+    {     "linear",   0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_LINEAR},   0, 0, FLAGS, "tonemap" },
+    {     "gamma",    0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_GAMMA},    0, 0, FLAGS, "tonemap" },
+    {     "clip",     0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_CLIP},     0, 0, FLAGS, "tonemap" },
+    {     "reinhard", 0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_REINHARD}, 0, 0, FLAGS, "tonemap" },
+    {     "hable",    0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_HABLE},    0, 0, FLAGS, "tonemap" },
+    {     "mobius",   0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_MOBIUS},   0, 0, FLAGS, "tonemap" },
+    { "tonemap_param", "tonemap parameter", OFFSET(tonemap_param), AV_OPT_TYPE_DOUBLE, {.dbl = NAN}, DBL_MIN, DBL_MAX, FLAGS },
+    { "tonemap_desat", "tonemap desaturation strength", OFFSET(tonemap_desat), AV_OPT_TYPE_DOUBLE, {.dbl = 2}, 0, DBL_MAX, FLAGS },
+    { "tonemap_peak",  "tonemap signal peak override", OFFSET(tonemap_peak), AV_OPT_TYPE_DOUBLE, {.dbl = 0}, 0, DBL_MAX, FLAGS },
     { NULL }
 };
 
@@ -48,10 +48,7 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
 AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int align)
 {
     AVFrame *frame = NULL;
-    int pool_width = 0;
-    int pool_height = 0;
-    int pool_align = 0;
-    enum AVPixelFormat pool_format = AV_PIX_FMT_NONE;
+    int allocated;
 
     if (link->hw_frames_ctx &&
         ((AVHWFramesContext*)link->hw_frames_ctx->data)->format == link->format) {
@@ -68,32 +65,20 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
         return frame;
     }
 
-    if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                    link->format, align);
-        if (!link->frame_pool)
-            return NULL;
-    } else {
-        if (ff_frame_pool_get_video_config(link->frame_pool,
-                                           &pool_width, &pool_height,
-                                           &pool_format, &pool_align) < 0) {
-            return NULL;
-        }
-
-        if (pool_width != w || pool_height != h ||
-            pool_format != link->format || pool_align != align) {
-
-            ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                        link->format, align);
-            if (!link->frame_pool)
-                return NULL;
-        }
-    }
+    //PLEX: pools are shared by the links with the same configuration
+    if (ff_frame_pool_video_reinit((FFFramePool **)&link->frame_pool, av_buffer_allocz,
+                                   w, h, link->format, align) < 0)
+        return NULL;
 
-    frame = ff_frame_pool_get(link->frame_pool);
+    frame = ff_frame_pool_get2(link->frame_pool, &allocated);
     if (!frame)
         return NULL;
+    link->frame_pool_frames++;
+    link->frame_pool_allocs += allocated;
+    if (allocated) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+            link->src->internal->profile_bytes += frame->buf[i]->size;
+    }
 
     frame->sample_aspect_ratio = link->sample_aspect_ratio;
 
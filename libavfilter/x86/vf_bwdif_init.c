@@ -37,6 +37,11 @@ void ff_bwdif_filter_line_avx2(void *dst, const void *prev, const void *cur, con
                                int mrefs2, int prefs3, int mrefs3, int prefs4,
                                int mrefs4, int parity, int clip_max);
 
+void ff_bwdif_filter_line_avx512(void *dst, const void *prev, const void *cur, const void *next,
+                                 int w, int prefs, int mrefs, int prefs2,
+                                 int mrefs2, int prefs3, int mrefs3, int prefs4,
+                                 int mrefs4, int parity, int clip_max);
+
 void ff_bwdif_filter_line_12bit_sse2(void *dst, const void *prev, const void *cur, const void *next,
                                      int w, int prefs, int mrefs, int prefs2,
                                      int mrefs2, int prefs3, int mrefs3, int prefs4,
@@ -49,6 +54,10 @@ void ff_bwdif_filter_line_12bit_avx2(void *dst, const void *prev, const void *cu
                                      int w, int prefs, int mrefs, int prefs2,
                                      int mrefs2, int prefs3, int mrefs3, int prefs4,
                                      int mrefs4, int parity, int clip_max);
+void ff_bwdif_filter_line_12bit_avx512(void *dst, const void *prev, const void *cur, const void *next,
+                                       int w, int prefs, int mrefs, int prefs2,
+                                       int mrefs2, int prefs3, int mrefs3, int prefs4,
+                                       int mrefs4, int parity, int clip_max);
 
 av_cold void ff_bwdif_init_x86(BWDIFDSPContext *bwdif, int bit_depth)
 {
@@ -61,6 +70,8 @@ av_cold void ff_bwdif_init_x86(BWDIFDSPContext *bwdif, int bit_depth)
             bwdif->filter_line = ff_bwdif_filter_line_ssse3;
         if (ARCH_X86_64 && EXTERNAL_AVX2_FAST(cpu_flags))
             bwdif->filter_line = ff_bwdif_filter_line_avx2;
+        if (ARCH_X86_64 && EXTERNAL_AVX512(cpu_flags))
+            bwdif->filter_line = ff_bwdif_filter_line_avx512;
     } else if (bit_depth <= 12) {
         if (EXTERNAL_SSE2(cpu_flags))
             bwdif->filter_line = ff_bwdif_filter_line_12bit_sse2;
@@ -68,5 +79,7 @@ av_cold void ff_bwdif_init_x86(BWDIFDSPContext *bwdif, int bit_depth)
             bwdif->filter_line = ff_bwdif_filter_line_12bit_ssse3;
         if (ARCH_X86_64 && EXTERNAL_AVX2_FAST(cpu_flags))
             bwdif->filter_line = ff_bwdif_filter_line_12bit_avx2;
+        if (ARCH_X86_64 && EXTERNAL_AVX512(cpu_flags))
+            bwdif->filter_line = ff_bwdif_filter_line_12bit_avx512;
     }
 }
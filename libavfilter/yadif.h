@@ -90,6 +90,13 @@ typedef struct YADIFContext {
 
 void ff_yadif_init_x86(YADIFContext *yadif);
 
+//PLEX
+/**
+ * Set filter_line and filter_edges for the pixel format in yadif->csp.
+ */
+void ff_yadif_init_filter_line(YADIFContext *yadif);
+//PLEX
+
 int ff_yadif_filter_frame(AVFilterLink *link, AVFrame *frame);
 
 int ff_yadif_request_frame(AVFilterLink *link);
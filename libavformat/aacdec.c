@@ -215,6 +215,7 @@ const AVInputFormat ff_aac_demuxer = {
     .read_header  = adts_aac_read_header,
     .read_packet  = adts_aac_read_packet,
     .flags        = AVFMT_GENERIC_INDEX,
+    .flags_internal = FF_FMT_PACKED_INDEX, //PLEX
     .extensions   = "aac",
     .mime_type    = "audio/aac,audio/aacp,audio/x-aac",
     .raw_codec_id = AV_CODEC_ID_AAC,
@@ -25,6 +25,7 @@
 #include "libavutil/crc.h"
 #include "libavcodec/ac3_parser.h"
 #include "avformat.h"
+#include "internal.h"
 #include "rawdec.h"
 
 static int ac3_eac3_probe(const AVProbeData *p, enum AVCodecID expected_codec_id)
@@ -111,6 +112,7 @@ const AVInputFormat ff_ac3_demuxer = {
     .read_header    = ff_raw_audio_read_header,
     .read_packet    = ff_raw_read_partial_packet,
     .flags= AVFMT_GENERIC_INDEX,
+    .flags_internal = FF_FMT_PACKED_INDEX, //PLEX
     .extensions = "ac3",
     .raw_codec_id   = AV_CODEC_ID_AC3,
     .priv_data_size = sizeof(FFRawDemuxerContext),
@@ -131,6 +133,7 @@ const AVInputFormat ff_eac3_demuxer = {
     .read_header    = ff_raw_audio_read_header,
     .read_packet    = ff_raw_read_partial_packet,
     .flags          = AVFMT_GENERIC_INDEX,
+    .flags_internal = FF_FMT_PACKED_INDEX, //PLEX
     .extensions     = "eac3,ec3",
     .raw_codec_id   = AV_CODEC_ID_EAC3,
     .priv_data_size = sizeof(FFRawDemuxerContext),
@@ -22,7 +22,13 @@
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h> //PLEX
 
+//PLEX
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+//PLEX
 #include "libavformat/internal.h"
 #include "avformat.h"
 #include "mux.h"
@@ -619,6 +625,97 @@ const AVInputFormat *av_demuxer_iterate(void **opaque)
     return f;
 }
 
+//PLEX
+/* One element of a comma separated demuxer name. */
+typedef struct DemuxerName {
+    const char *name;
+    int len;
+    int idx;                ///< index into demuxer_list
+} DemuxerName;
+
+static DemuxerName *demuxer_names;
+static int nb_demuxer_names;
+static AVOnce demuxer_names_once = AV_ONCE_INIT;
+
+/* Same order as av_match_name() equality: case insensitive, whole element. */
+static int demuxer_name_cmp(const char *a, int alen, const char *b, int blen)
+{
+    int ret = av_strncasecmp(a, b, FFMIN(alen, blen));
+    return ret ? ret : alen - blen;
+}
+
+static int demuxer_name_sort(const void *a, const void *b)
+{
+    const DemuxerName *na = a, *nb = b;
+    int ret = demuxer_name_cmp(na->name, na->len, nb->name, nb->len);
+    return ret ? ret : na->idx - nb->idx;
+}
+
+static void demuxer_names_init(void)
+{
+    int nb = 0;
+
+    for (int i = 0; demuxer_list[i]; i++) {
+        nb++;
+        for (const char *p = demuxer_list[i]->name; *p; p++)
+            nb += *p == ',';
+    }
+
+    demuxer_names = av_malloc_array(nb, sizeof(*demuxer_names));
+    if (!demuxer_names)
+        return;
+
+    nb = 0;
+    for (int i = 0; demuxer_list[i]; i++) {
+        const char *p = demuxer_list[i]->name;
+        while (1) {
+            const char *end = strchr(p, ',');
+            int len = end ? end - p : strlen(p);
+
+            /* av_match_name() gives these a special meaning */
+            if (*p == '-' || (len == 3 && !strncmp(p, "ALL", 3))) {
+                av_freep(&demuxer_names);
+                return;
+            }
+            demuxer_names[nb++] = (DemuxerName){ p, len, i };
+            if (!end)
+                break;
+            p = end + 1;
+        }
+    }
+    qsort(demuxer_names, nb, sizeof(*demuxer_names), demuxer_name_sort);
+    nb_demuxer_names = nb;
+}
+
+const AVInputFormat *ff_find_builtin_demuxer(const char *short_name, void **opaque)
+{
+    int lo = 0, hi, len;
+
+    ff_thread_once(&demuxer_names_once, demuxer_names_init);
+    /* av_match_name() also matches a list such as "matroska,webm" against the
+     * full name of a demuxer, leave those to the linear scan */
+    if (!demuxer_names || !short_name || strchr(short_name, ','))
+        return NULL;
+
+    len = strlen(short_name);
+    hi  = nb_demuxer_names;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (demuxer_name_cmp(demuxer_names[mid].name, demuxer_names[mid].len,
+                             short_name, len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *opaque = (void *)(uintptr_t)(FF_ARRAY_ELEMS(demuxer_list) - 1);
+    if (lo < nb_demuxer_names &&
+        !demuxer_name_cmp(demuxer_names[lo].name, demuxer_names[lo].len, short_name, len))
+        return demuxer_list[demuxer_names[lo].idx];
+    return NULL;
+}
+//PLEX
+
 void avpriv_register_devices(const FFOutputFormat * const o[], const AVInputFormat * const i[])
 {
     atomic_store_explicit(&outdev_list_intptr, (uintptr_t)o, memory_order_relaxed);
@@ -29,6 +29,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/slicethread.h" //PLEX
 #include "libavcodec/avcodec.h"
 #include "libavcodec/codec.h"
 #include "libavcodec/bsf.h"
@@ -36,9 +37,11 @@
 #include "libavcodec/packet_internal.h"
 #include "avformat.h"
 #include "avio.h"
+#include "avio_internal.h" //PLEX
 #include "demux.h"
 #include "mux.h"
 #include "internal.h"
+#include "packed_index.h" //PLEX
 
 void ff_free_stream(AVStream **pst)
 {
@@ -72,9 +75,11 @@ FF_ENABLE_DEPRECATION_WARNINGS
     av_bsf_free(&sti->bsfc);
     av_freep(&sti->priv_pts);
     av_freep(&sti->index_entries);
+    ff_packed_index_free(&sti->packed_index); //PLEX
     av_freep(&sti->probe_data.buf);
 
     av_bsf_free(&sti->extract_extradata.bsf);
+    avpriv_packet_list_free(&sti->interleave_queue); //PLEX
 
     if (sti->info) {
         av_freep(&sti->info->duration_error);
@@ -103,6 +108,10 @@ void ff_flush_packet_queue(AVFormatContext *s)
     avpriv_packet_list_free(&si->parse_queue);
     avpriv_packet_list_free(&si->packet_buffer);
     avpriv_packet_list_free(&si->raw_packet_buffer);
+    //PLEX
+    avpriv_packet_list_free(&si->decrypt_queue);
+    si->decrypt_err = 0;
+    //PLEX
 
     si->raw_packet_buffer_size = 0;
 }
@@ -147,7 +156,15 @@ void avformat_free_context(AVFormatContext *s)
     av_packet_free(&si->pkt);
     av_packet_free(&si->parse_pkt);
     av_freep(&s->streams);
+    av_freep(&si->interleave_heap); //PLEX
     ff_flush_packet_queue(s);
+    //PLEX
+    for (int i = 0; i < si->nb_decrypt_pkts; i++)
+        av_packet_free(&si->decrypt_pkts[i]);
+    av_freep(&si->decrypt_pkts);
+    avpriv_slicethread_free(&si->decrypt_pool);
+    av_buffer_unref(&si->source_file);
+    //PLEX
     av_freep(&s->url);
     av_free(s);
 }
@@ -848,10 +865,21 @@ void ff_format_set_url(AVFormatContext *s, char *url)
     s->url = url;
 }
 
+//PLEX
+int avformat_get_io_stats(AVFormatContext *s, AVIOStats *stats)
+{
+    *stats = ffformatcontext(s)->io_stats;
+    if (s->pb)
+        ffio_add_stats(stats, s->pb);
+    return 0;
+}
+//PLEX
+
 int ff_format_io_close(AVFormatContext *s, AVIOContext **pb)
 {
     int ret = 0;
     if (*pb) {
+        ffio_add_stats(&ffformatcontext(s)->io_stats, *pb); //PLEX
 #if FF_API_AVFORMAT_IO_CLOSE
 FF_DISABLE_DEPRECATION_WARNINGS
         if (s->io_close == ff_format_io_close_default || s->io_close == NULL)
@@ -1256,6 +1256,18 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_SHORTEST   0x100000 ///< Stop muxing when the shortest stream stops.
 #endif
 #define AVFMT_FLAG_AUTO_BSF   0x200000 ///< Add bitstream filters as requested by the muxer
+//PLEX
+/**
+ * Let avformat_find_stream_info() take codec parameters from the container
+ * and the parsers, and only decode frames for what they leave unknown.
+ */
+#define AVFMT_FLAG_TRUST_HEADERS 0x400000
+/**
+ * Attach AV_PKT_DATA_SOURCE_RANGE side data to packets whose payload is
+ * read verbatim from a local file, for muxers that can send it zero-copy.
+ */
+#define AVFMT_FLAG_SOURCE_RANGES 0x800000
+//PLEX
 
     /**
      * Maximum number of bytes read from input in order to determine stream
@@ -1726,6 +1738,44 @@ typedef struct AVFormatContext {
      * @return 0 on success, a negative AVERROR code on failure
      */
     int (*io_close2)(struct AVFormatContext *s, AVIOContext *pb);
+
+    //PLEX
+    /**
+     * Directory in which avformat_find_stream_info() results for local files
+     * are cached, keyed by path, size and modification time. Unset disables
+     * the cache.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *probe_cache;
+
+    /**
+     * Number of packets read ahead and passed to the decryption callbacks
+     * together. 1 decrypts each packet as it is read.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int decrypt_batch;
+
+    /**
+     * Number of threads running AVDecryptionCallbacks.handle_packet() on the
+     * packets of a batch. 1 decrypts them on the calling thread.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int decrypt_threads;
+
+    /**
+     * Leave the attached pictures of seekable inputs unread when opening,
+     * and read them on the first av_read_frame() for the streams which are
+     * not discarded then, or on avformat_queue_attached_pictures().
+     * AVStream.attached_pic is empty and the picture dimensions are unknown
+     * until then.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int lazy_attached_pics;
+    //PLEX
 } AVFormatContext;
 
 /**
@@ -2422,6 +2472,36 @@ int av_write_uncoded_frame_query(AVFormatContext *s, int stream_index);
  */
 int av_write_trailer(AVFormatContext *s);
 
+//PLEX
+/**
+ * Restart the timeline of an output whose header has been written, e.g.
+ * after the input was seeked: all the queued packets are written out, and
+ * the timestamps of the following packets may start over. Muxers that split
+ * their output close the current segment and continue with a new one.
+ *
+ * @param segment number of the next segment, or a negative value to keep
+ *                counting; ignored by muxers that do not split their output
+ * @return 0 on success, AVERROR(ENOSYS) if the muxer cannot restart its
+ *         output, another negative AVERROR on failure
+ */
+int avformat_restart_output(AVFormatContext *s, int segment);
+
+/**
+ * @return 0 if avformat_restart_output() is supported by the muxer of s
+ *         with its current options, AVERROR(ENOSYS) otherwise
+ */
+int avformat_restart_output_query(AVFormatContext *s);
+
+/**
+ * Get the I/O statistics of s: those of s->pb, plus every other context
+ * the (de)muxer opened and closed again through io_open/io_close2, such
+ * as the segments of a segmenting muxer or the playlists of HLS.
+ *
+ * @return 0 on success
+ */
+int avformat_get_io_stats(AVFormatContext *s, AVIOStats *stats);
+//PLEX
+
 /**
  * Return the output format in the list of registered output formats
  * which best matches the provided parameters, or return NULL if
@@ -2860,10 +2940,25 @@ int avformat_http_do_new_request(AVIOContext *pb, const char *uri, const char *v
 //PLEX
 
 //PLEX
+/**
+ * Hooks decrypting demuxed packets in place. new_stream() is called before
+ * the first packet of a stream is passed on. The packets are writable; a
+ * packet the callbacks fail on is flagged AV_PKT_FLAG_CORRUPT.
+ */
 typedef struct AVDecryptionCallbacks {
     int (*new_stream)(AVFormatContext *ctx, AVStream *s);
     int (*close_stream)(AVFormatContext *ctx, AVStream *s);
+    /**
+     * Decrypt one packet. With AVFormatContext.decrypt_threads > 1 this is
+     * called concurrently for different packets of the same context.
+     */
     int (*handle_packet)(AVFormatContext *ctx, AVPacket *pkt);
+    /**
+     * Optional, decrypt AVFormatContext.decrypt_batch packets at once, in
+     * demuxing order. Used instead of handle_packet() when set; an error
+     * flags the whole batch.
+     */
+    int (*handle_packets)(AVFormatContext *ctx, AVPacket **pkts, int nb_pkts);
 } AVDecryptionCallbacks;
 void avformat_set_decryption_callbacks(const AVDecryptionCallbacks* cbs);
 //PLEX
@@ -36,6 +36,7 @@
 #include "dv.h"
 #include "internal.h"
 #include "isom.h"
+#include "readahead.h" //PLEX
 #include "riff.h"
 #include "libavcodec/bytestream.h"
 #include "libavcodec/exif.h"
@@ -66,6 +67,8 @@ typedef struct AVIStream {
     AVBufferRef *sub_buffer;
 
     int64_t seek_pos;
+
+    FFReadAhead readahead; //PLEX
 } AVIStream;
 
 typedef struct AVIContext {
@@ -87,11 +90,21 @@ typedef struct AVIContext {
     int use_odml;
 #define MAX_ODML_DEPTH 1000
     int64_t dts_max;
+    //PLEX
+    int readahead_window;
+    int64_t readahead_pos;  ///< position of the next non-interleaved read
+    int64_t readahead_len;  ///< bytes to buffer for it, 0 for a plain read
+    //PLEX
 } AVIContext;
 
 
 static const AVOption options[] = {
     { "use_odml", "use odml index", offsetof(AVIContext, use_odml), AV_OPT_TYPE_BOOL, {.i64 = 1}, -1, 1, AV_OPT_FLAG_DECODING_PARAM},
+    //PLEX
+    { "readahead_window", "in non-interleaved mode, read chunks of a stream stored apart from the "
+      "current position this many bytes at a time", offsetof(AVIContext, readahead_window),
+      AV_OPT_TYPE_INT, {.i64 = 1 << 20}, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM},
+    //PLEX
     { NULL },
 };
 
@@ -1382,6 +1395,26 @@ start_sync:
     return AVERROR_EOF;
 }
 
+//PLEX
+/**
+ * @return the number of bytes from pos, inside index entry i, to the end of
+ *         the chunks of the same stream that follow back to back, up to the
+ *         read-ahead window
+ */
+static int64_t avi_contiguous_run(AVIContext *avi, AVStream *st, int i, int64_t pos)
+{
+    FFStream *const sti = ffstream(st);
+    const AVIndexEntry *e   = &sti->index_entries[i];
+    const AVIndexEntry *end = sti->index_entries + sti->nb_index_entries;
+
+    while (e + 1 < end &&
+           e[1].pos == e->pos + 8 + e->size + (e->size & 1) &&
+           e[1].pos + 8 + e[1].size - pos <= avi->readahead_window)
+        e++;
+    return e->pos + 8 + e->size - pos;
+}
+//PLEX
+
 static int ni_prepare_read(AVFormatContext *s)
 {
     AVIContext *avi = s->priv_data;
@@ -1435,10 +1468,17 @@ static int ni_prepare_read(AVFormatContext *s)
             best_ast->frame_offset = best_sti->index_entries[i].timestamp;
     }
 
+    avi->readahead_len = 0; //PLEX
     if (i >= 0) {
         int64_t pos = best_sti->index_entries[i].pos;
+        int size = best_ast->remaining ? best_ast->remaining : best_sti->index_entries[i].size; //PLEX
         pos += best_ast->packet_size - best_ast->remaining;
-        if (avio_seek(s->pb, pos + 8, SEEK_SET) < 0)
+        //PLEX: serve streams stored apart from a per-stream buffer instead of seeking per packet
+        if (!avi->dv_demux && best_st->codecpar->codec_type != AVMEDIA_TYPE_SUBTITLE &&
+            ff_readahead_wanted(&best_ast->readahead, s->pb, pos + 8, size, avi->readahead_window)) {
+            avi->readahead_pos = pos + 8;
+            avi->readahead_len = avi_contiguous_run(avi, best_st, i, pos + 8);
+        } else if (avio_seek(s->pb, pos + 8, SEEK_SET) < 0)
           return AVERROR_EOF;
 
         av_assert0(best_ast->remaining <= best_ast->packet_size);
@@ -1496,8 +1536,17 @@ resync:
 
         if (size > ast->remaining)
             size = ast->remaining;
-        avi->last_pkt_pos = avio_tell(pb);
-        err               = av_get_packet(pb, pkt, size);
+        //PLEX
+        if (avi->readahead_len) {
+            avi->last_pkt_pos = avi->readahead_pos;
+            err = ff_readahead_get_packet(&ast->readahead, pb, pkt, avi->readahead_pos,
+                                          size, avi->readahead_len);
+            avi->readahead_len = 0;
+        } else {
+            avi->last_pkt_pos = avio_tell(pb);
+            err               = av_get_packet(pb, pkt, size);
+        }
+        //PLEX
         if (err < 0)
             return err;
         size = err;
@@ -1989,6 +2038,7 @@ static int avi_read_close(AVFormatContext *s)
             }
             av_buffer_unref(&ast->sub_buffer);
             av_packet_free(&ast->sub_pkt);
+            ff_readahead_free(&ast->readahead); //PLEX
         }
     }
 
@@ -425,6 +425,124 @@ int ffurl_write2(void *urlcontext, const uint8_t *buf, int size)
     return retry_transfer_wrapper(h, NULL, buf, size, size, 0);
 }
 
+//PLEX
+int ffurl_writev(URLContext *h, const URLWriteVec *vec, int nb_vec)
+{
+    URLWriteVec v[URL_WRITEV_MAX];
+    int64_t wait_since = 0;
+    int fast_retries = 5;
+    int total = 0, i = 0;
+
+    if (!(h->flags & AVIO_FLAG_WRITE))
+        return AVERROR(EIO);
+    if (nb_vec > URL_WRITEV_MAX)
+        return AVERROR(EINVAL);
+
+    if (!h->prot->url_writev) {
+        for (i = 0; i < nb_vec; i++) {
+            int ret = ffurl_write(h, vec[i].data, vec[i].size);
+            if (ret < 0)
+                return ret;
+            total += vec[i].size;
+        }
+        return total;
+    }
+
+    memcpy(v, vec, nb_vec * sizeof(*v));
+    while (i < nb_vec) {
+        int ret;
+
+        if (!v[i].size) {
+            i++;
+            continue;
+        }
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+        ret = h->prot->url_writev(h, v + i, nb_vec - i);
+        if (ret == AVERROR(EINTR))
+            continue;
+        if (ret == AVERROR(EAGAIN) && !(h->flags & AVIO_FLAG_NONBLOCK)) {
+            if (fast_retries) {
+                fast_retries--;
+            } else {
+                if (h->rw_timeout) {
+                    if (!wait_since)
+                        wait_since = av_gettime_relative();
+                    else if (av_gettime_relative() > wait_since + h->rw_timeout)
+                        return AVERROR(EIO);
+                }
+                av_usleep(1000);
+            }
+            continue;
+        }
+        if (ret < 0)
+            return ret;
+        if (ret) {
+            fast_retries = FFMAX(fast_retries, 2);
+            wait_since = 0;
+        }
+
+        total += ret;
+        while (ret && i < nb_vec) {
+            int len = FFMIN(ret, v[i].size);
+            v[i].data += len;
+            v[i].size -= len;
+            ret       -= len;
+            if (!v[i].size)
+                i++;
+        }
+    }
+    return total;
+}
+
+int ffurl_write_from_fd(URLContext *h, int fd, int64_t offset, int size)
+{
+    int64_t wait_since = 0;
+    int fast_retries = 5;
+    int total = 0;
+
+    if (!(h->flags & AVIO_FLAG_WRITE))
+        return AVERROR(EIO);
+    if (!h->prot->url_write_from_fd)
+        return AVERROR(ENOSYS);
+
+    while (total < size) {
+        int ret;
+
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+        ret = h->prot->url_write_from_fd(h, fd, offset + total, size - total);
+        if (ret == AVERROR(EINTR))
+            continue;
+        if (ret == AVERROR(EAGAIN) && !(h->flags & AVIO_FLAG_NONBLOCK)) {
+            if (fast_retries) {
+                fast_retries--;
+            } else {
+                if (h->rw_timeout) {
+                    if (!wait_since)
+                        wait_since = av_gettime_relative();
+                    else if (av_gettime_relative() > wait_since + h->rw_timeout)
+                        return AVERROR(EIO);
+                }
+                av_usleep(1000);
+            }
+            continue;
+        }
+        /* the caller can still fall back to a copy if nothing went out */
+        if (ret == AVERROR(ENOSYS) && total)
+            return AVERROR(EIO);
+        if (ret < 0)
+            return ret;
+        if (!ret)
+            return AVERROR_EOF;
+        fast_retries = FFMAX(fast_retries, 2);
+        wait_since = 0;
+        total += ret;
+    }
+    return total;
+}
+//PLEX
+
 int64_t ffurl_seek2(void *urlcontext, int64_t pos, int whence)
 {
     URLContext *h = urlcontext;
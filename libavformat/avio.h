@@ -847,4 +847,40 @@ int avio_accept(AVIOContext *s, AVIOContext **c);
  *           < 0 for an AVERROR code
  */
 int avio_handshake(AVIOContext *c);
+
+//PLEX
+#define AVIO_STATS_LATENCY_BUCKETS 8
+
+/**
+ * I/O statistics of an AVIOContext, see avio_get_stats().
+ * Times are in microseconds spent blocked in the protocol.
+ */
+typedef struct AVIOStats {
+    int64_t bytes_read;
+    int64_t bytes_written;
+    /**
+     * Bytes read again after seeking back to data read before.
+     */
+    int64_t bytes_reread;
+    int64_t read_calls;
+    int64_t write_calls;
+    int64_t seeks;
+    int64_t read_time;
+    int64_t write_time;
+    int64_t seek_time;
+    /**
+     * Number of reads by latency: bucket i counts the reads that took less
+     * than 64 << (2 * i) microseconds and more than the bucket before, the
+     * last one all the slower reads.
+     */
+    int64_t read_latency[AVIO_STATS_LATENCY_BUCKETS];
+} AVIOStats;
+
+/**
+ * Get the I/O statistics of s since it was opened.
+ *
+ * @return 0 on success, AVERROR(EINVAL) if s is NULL
+ */
+int avio_get_stats(AVIOContext *s, AVIOStats *stats);
+//PLEX
 #endif /* AVFORMAT_AVIO_H */
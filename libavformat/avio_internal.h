@@ -76,6 +76,35 @@ typedef struct FFIOContext {
      * is updated each time a successful writeout ends up further position-wise
      */
     int64_t written_output_size;
+
+    //PLEX
+    /**
+     * Size up to which the read buffer grows while it keeps being refilled
+     * without seeks, 0 to keep it fixed.
+     */
+    int max_buffer_size;
+
+    /**
+     * Consecutive sequential refills that returned at least half of the
+     * requested size.
+     */
+    int sequential_fills;
+
+    /**
+     * Set once the protocol turned down a write from a file descriptor.
+     */
+    int no_write_from_fd;
+
+    /**
+     * Statistics not covered by the counters above.
+     */
+    AVIOStats stats;
+
+    /**
+     * End of the furthest data read so far, to count the bytes read again.
+     */
+    int64_t read_end;
+    //PLEX
 } FFIOContext;
 
 static av_always_inline FFIOContext *ffiocontext(AVIOContext *ctx)
@@ -162,6 +191,23 @@ int ffio_read_size(AVIOContext *s, unsigned char *buf, int size);
  */
 int ffio_realloc_buf(AVIOContext *s, int buf_size);
 
+//PLEX
+/**
+ * Flush s and write size bytes of the file fd starting at offset, letting
+ * the kernel copy them when the protocol supports it.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if nothing was written and the data
+ *         has to be written with avio_write(), or another negative AVERROR
+ *         code on failure, which is also recorded in s->error
+ */
+int ffio_write_from_fd(AVIOContext *s, int fd, int64_t offset, int size);
+
+/**
+ * Add the statistics of s to the totals in dst.
+ */
+void ffio_add_stats(AVIOStats *dst, AVIOContext *s);
+//PLEX
+
 /**
  * Ensures that the requested seekback buffer size will be available
  *
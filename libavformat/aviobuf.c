@@ -26,6 +26,7 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
+#include "libavutil/time.h"
 #include "libavutil/avassert.h"
 #include "libavcodec/defs.h"
 #include "avio.h"
@@ -35,6 +36,13 @@
 #include <stdarg.h>
 
 #define IO_BUFFER_SIZE 32768
+//PLEX
+#define IO_BUFFER_MAX_SIZE 262144
+/* sequential refills after which the read buffer is doubled */
+#define IO_BUFFER_GROW_FILLS 4
+/* writes at least this fraction of the buffer bypass it */
+#define IO_WRITEV_MIN_FRACTION 2
+//PLEX
 
 /**
  * Do seeks within this distance ahead of the current buffer by skipping
@@ -167,11 +175,14 @@ void avio_context_free(AVIOContext **ps)
     av_freep(ps);
 }
 
+static void writeout_done(AVIOContext *s, int ret, int len, int64_t start);
+
 static void writeout(AVIOContext *s, const uint8_t *data, int len)
 {
     FFIOContext *const ctx = ffiocontext(s);
+    int64_t start = av_gettime_relative(); //PLEX
+    int ret = 0;
     if (!s->error) {
-        int ret = 0;
         if (s->write_data_type)
 #if FF_API_AVIO_WRITE_NONCONST
             ret = s->write_data_type(s->opaque, (uint8_t *)data,
@@ -187,6 +198,18 @@ static void writeout(AVIOContext *s, const uint8_t *data, int len)
 #else
             ret = s->write_packet(s->opaque, data, len);
 #endif
+    }
+    writeout_done(s, ret, len, start);
+}
+
+//PLEX
+/* Bookkeeping shared by plain and vectored writeouts. */
+static void writeout_done(AVIOContext *s, int ret, int len, int64_t start)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    ctx->stats.write_calls++;
+    ctx->stats.write_time += av_gettime_relative() - start;
+    if (!s->error) {
         if (ret < 0) {
             s->error = ret;
         } else {
@@ -207,6 +230,32 @@ static void writeout(AVIOContext *s, const uint8_t *data, int len)
     s->pos += len;
 }
 
+/**
+ * Write the buffered data followed by data with a single vectored write to
+ * the protocol, sparing the copy of data into the buffer. Returns 0 if the
+ * context does not qualify.
+ */
+static int writeout_vectored(AVIOContext *s, const uint8_t *data, int size)
+{
+    URLContext *h = ffio_geturlcontext(s);
+    int len = s->buf_ptr - s->buffer;
+    URLWriteVec vec[2] = { { s->buffer, len }, { data, size } };
+    int64_t start;
+    int ret = 0;
+
+    if (!h || !h->prot->url_writev || s->write_data_type || s->update_checksum ||
+        s->buf_ptr_max > s->buf_ptr || size < s->buffer_size / IO_WRITEV_MIN_FRACTION)
+        return 0;
+
+    start = av_gettime_relative();
+    if (!s->error)
+        ret = ffurl_writev(h, vec + !len, 2 - !len);
+    writeout_done(s, ret, len + size, start);
+    s->buf_ptr = s->buf_ptr_max = s->buffer;
+    return 1;
+}
+//PLEX
+
 static void flush_buffer(AVIOContext *s)
 {
     s->buf_ptr_max = FFMAX(s->buf_ptr, s->buf_ptr_max);
@@ -223,6 +272,32 @@ static void flush_buffer(AVIOContext *s)
         s->buf_end = s->buffer;
 }
 
+//PLEX
+int ffio_write_from_fd(AVIOContext *s, int fd, int64_t offset, int size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    URLContext *h = ffio_geturlcontext(s);
+    int64_t start;
+    int ret;
+
+    if (!h || !h->prot->url_write_from_fd || ctx->no_write_from_fd ||
+        s->write_data_type || s->update_checksum || s->buf_ptr_max > s->buf_ptr)
+        return AVERROR(ENOSYS);
+    if (s->error)
+        return s->error;
+
+    flush_buffer(s);
+    start = av_gettime_relative();
+    ret = ffurl_write_from_fd(h, fd, offset, size);
+    if (ret == AVERROR(ENOSYS)) {
+        ctx->no_write_from_fd = 1;
+        return ret;
+    }
+    writeout_done(s, ret, size, start);
+    return ret < 0 ? ret : 0;
+}
+//PLEX
+
 void avio_w8(AVIOContext *s, int b)
 {
     av_assert2(b>=-128 && b<=255);
@@ -249,6 +324,10 @@ void avio_write(AVIOContext *s, const unsigned char *buf, int size)
 {
     if (size <= 0)
         return;
+    //PLEX
+    if (size > s->buf_end - s->buf_ptr && writeout_vectored(s, buf, size))
+        return;
+    //PLEX
     if (s->direct && !s->update_checksum) {
         avio_flush(s);
         writeout(s, buf, size);
@@ -275,6 +354,17 @@ void avio_flush(AVIOContext *s)
         avio_seek(s, seekback, SEEK_CUR);
 }
 
+//PLEX
+static int64_t timed_seek(AVIOContext *s, int64_t offset)
+{
+    int64_t start = av_gettime_relative();
+    int64_t ret = s->seek(s->opaque, offset, SEEK_SET);
+
+    ffiocontext(s)->stats.seek_time += av_gettime_relative() - start;
+    return ret;
+}
+//PLEX
+
 int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
 {
     FFIOContext *const ctx = ffiocontext(s);
@@ -335,8 +425,10 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         int64_t res;
 
         pos -= FFMIN(buffer_size>>1, pos);
-        if ((res = s->seek(s->opaque, pos, SEEK_SET)) < 0)
+        res = timed_seek(s, pos); //PLEX
+        if (res < 0)
             return res;
+        ctx->sequential_fills = 0; //PLEX
         s->buf_end =
         s->buf_ptr = s->buffer;
         s->pos = pos;
@@ -350,9 +442,11 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         }
         if (!s->seek)
             return AVERROR(EPIPE);
-        if ((res = s->seek(s->opaque, offset, SEEK_SET)) < 0)
+        res = timed_seek(s, offset); //PLEX
+        if (res < 0)
             return res;
         ctx->seek_count++;
+        ctx->sequential_fills = 0; //PLEX
         if (!s->write_flag)
             s->buf_end = s->buffer;
         s->buf_ptr = s->buf_ptr_max = s->buffer;
@@ -544,12 +638,31 @@ void avio_write_marker(AVIOContext *s, int64_t time, enum AVIODataMarkerType typ
 
 static int read_packet_wrapper(AVIOContext *s, uint8_t *buf, int size)
 {
+    //PLEX
+    FFIOContext *const ctx = ffiocontext(s);
+    int64_t start, time;
+    int bucket = 0;
+    //PLEX
     int ret;
 
     if (!s->read_packet)
         return AVERROR(EINVAL);
+    start = av_gettime_relative(); //PLEX
     ret = s->read_packet(s->opaque, buf, size);
     av_assert2(ret || s->max_packet_size);
+    //PLEX
+    time = av_gettime_relative() - start;
+    while (bucket < AVIO_STATS_LATENCY_BUCKETS - 1 && time >= 64 << (2 * bucket))
+        bucket++;
+    ctx->stats.read_latency[bucket]++;
+    ctx->stats.read_calls++;
+    ctx->stats.read_time += time;
+    if (ret > 0) {
+        if (s->pos < ctx->read_end)
+            ctx->stats.bytes_reread += FFMIN(ret, ctx->read_end - s->pos);
+        ctx->read_end = FFMAX(ctx->read_end, s->pos + ret);
+    }
+    //PLEX
     return ret;
 }
 
@@ -563,6 +676,7 @@ static void fill_buffer(AVIOContext *s)
     uint8_t *dst        = s->buf_end - s->buffer + max_buffer_size <= s->buffer_size ?
                           s->buf_end : s->buffer;
     int len             = s->buffer_size - (dst - s->buffer);
+    int requested; //PLEX
 
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
@@ -572,6 +686,20 @@ static void fill_buffer(AVIOContext *s)
     if (s->eof_reached)
         return;
 
+    //PLEX
+    /* grow the buffer once reads keep returning plenty of data sequentially */
+    if (ctx->max_buffer_size > s->buffer_size && s->buf_ptr >= s->buf_end &&
+        ctx->sequential_fills >= IO_BUFFER_GROW_FILLS && !s->update_checksum &&
+        s->buffer_size == ctx->orig_buffer_size) {
+        int ret = ffio_realloc_buf(s, FFMIN(2LL * s->buffer_size, ctx->max_buffer_size));
+        if (ret < 0)
+            ctx->max_buffer_size = 0;
+        ctx->sequential_fills = 0;
+        dst = s->buffer;
+        len = s->buffer_size;
+    }
+    //PLEX
+
     if (s->update_checksum && dst == s->buffer) {
         if (s->buf_end > s->checksum_ptr)
             s->checksum = s->update_checksum(s->checksum, s->checksum_ptr,
@@ -592,7 +720,14 @@ static void fill_buffer(AVIOContext *s)
         len = ctx->orig_buffer_size;
     }
 
+    requested = len; //PLEX
     len = read_packet_wrapper(s, dst, len);
+    //PLEX
+    if (len > 0 && len >= requested / 2)
+        ctx->sequential_fills++;
+    else
+        ctx->sequential_fills = 0;
+    //PLEX
     if (len == AVERROR_EOF) {
         /* do not modify buffer if EOF reached so that a seek back can
            be done without rereading data */
@@ -1008,6 +1143,10 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
         return AVERROR(ENOMEM);
     }
     (*s)->direct = h->flags & AVIO_FLAG_DIRECT;
+    //PLEX
+    if (!(h->flags & AVIO_FLAG_WRITE) && !max_packet_size && !(*s)->direct)
+        ffiocontext(*s)->max_buffer_size = IO_BUFFER_MAX_SIZE;
+    //PLEX
 
     (*s)->seekable = h->is_streamed ? 0 : AVIO_SEEKABLE_NORMAL;
     (*s)->max_packet_size = max_packet_size;
@@ -1308,6 +1447,40 @@ int avio_closep(AVIOContext **s)
     return ret;
 }
 
+//PLEX
+int avio_get_stats(AVIOContext *s, AVIOStats *stats)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+
+    if (!s)
+        return AVERROR(EINVAL);
+    *stats = ctx->stats;
+    stats->bytes_read    = ctx->bytes_read;
+    stats->bytes_written = ctx->bytes_written;
+    stats->seeks         = ctx->seek_count;
+    return 0;
+}
+
+void ffio_add_stats(AVIOStats *dst, AVIOContext *s)
+{
+    AVIOStats st;
+
+    if (avio_get_stats(s, &st) < 0)
+        return;
+    dst->bytes_read    += st.bytes_read;
+    dst->bytes_written += st.bytes_written;
+    dst->bytes_reread  += st.bytes_reread;
+    dst->read_calls    += st.read_calls;
+    dst->write_calls   += st.write_calls;
+    dst->seeks         += st.seeks;
+    dst->read_time     += st.read_time;
+    dst->write_time    += st.write_time;
+    dst->seek_time     += st.seek_time;
+    for (int i = 0; i < AVIO_STATS_LATENCY_BUCKETS; i++)
+        dst->read_latency[i] += st.read_latency[i];
+}
+//PLEX
+
 int avio_vprintf(AVIOContext *s, const char *fmt, va_list ap)
 {
     AVBPrint bp;
@@ -0,0 +1,366 @@
+/*
+ * Block cache protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Seek-aware in-memory cache of fixed size blocks of a seekable input.
+ *
+ * Blocks are evicted in least recently used order, except for pinned ones:
+ * the head and the tail of the file, where demuxers keep their indexes (MP4
+ * moov, Matroska Cues, AVI idx1), and blocks that keep being read again.
+ * Runs of consecutive misses are taken as sequential reading and fetched
+ * ahead in growing requests, while isolated misses fetch a single block.
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/tree.h"
+#include "url.h"
+
+/* number of times a block is read again after a seek before it is pinned */
+#define PIN_REVISITS 2
+
+typedef struct BlockCacheEntry {
+    int64_t index;
+    uint8_t *data;
+    int size;               /* shorter than a block only at the end of file */
+    int revisits;
+    int pinned;
+    struct BlockCacheEntry *prev, *next;
+} BlockCacheEntry;
+
+typedef struct BlockCacheContext {
+    const AVClass *class;
+    int block_size;
+    int64_t cache_size;
+    int readahead;
+    int64_t pin_size;
+
+    URLContext *inner;
+    int64_t inner_pos;
+    int64_t pos;
+    int64_t last_end;       /* end of the previous read */
+    int64_t size;           /* -1 if unknown */
+    struct AVTreeNode *root;
+    /* most recently used first */
+    BlockCacheEntry *lru_head, *lru_tail;
+    int nb_blocks, max_blocks;
+    int nb_pinned;
+    int64_t last_miss;
+    int run;
+    int64_t hits, misses, fetched;
+} BlockCacheContext;
+
+static int cmp(const void *key, const void *node)
+{
+    return FFDIFFSIGN(*(const int64_t *)key, ((const BlockCacheEntry *)node)->index);
+}
+
+static void lru_unlink(BlockCacheContext *c, BlockCacheEntry *e)
+{
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        c->lru_head = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        c->lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void lru_push(BlockCacheContext *c, BlockCacheEntry *e)
+{
+    e->next = c->lru_head;
+    if (c->lru_head)
+        c->lru_head->prev = e;
+    else
+        c->lru_tail = e;
+    c->lru_head = e;
+}
+
+static void block_pin(BlockCacheContext *c, BlockCacheEntry *e)
+{
+    /* keep at least half of the cache for everything else */
+    if (!e->pinned && c->nb_pinned < c->max_blocks / 2) {
+        e->pinned = 1;
+        c->nb_pinned++;
+    }
+}
+
+static int in_hot_region(BlockCacheContext *c, int64_t index)
+{
+    int64_t start = index * c->block_size;
+
+    return start < c->pin_size ||
+           (c->size >= 0 && start + c->block_size > c->size - c->pin_size);
+}
+
+static void block_evict(BlockCacheContext *c)
+{
+    BlockCacheEntry *e = c->lru_tail;
+    struct AVTreeNode *node = NULL;
+
+    while (e && e->pinned)
+        e = e->prev;
+    if (!e)
+        return;
+
+    lru_unlink(c, e);
+    av_tree_insert(&c->root, &e->index, cmp, &node);
+    av_free(node);
+    av_free(e->data);
+    av_free(e);
+    c->nb_blocks--;
+}
+
+static int block_insert(BlockCacheContext *c, BlockCacheEntry *e)
+{
+    struct AVTreeNode *node = av_tree_node_alloc();
+
+    if (!node)
+        return AVERROR(ENOMEM);
+    while (c->nb_blocks >= c->max_blocks && c->nb_blocks > c->nb_pinned)
+        block_evict(c);
+    av_tree_insert(&c->root, e, cmp, &node);
+    av_assert0(!node);
+    lru_push(c, e);
+    c->nb_blocks++;
+    if (in_hot_region(c, e->index))
+        block_pin(c, e);
+    return 0;
+}
+
+/* Read count blocks starting at index from the inner protocol in one go.
+ * Stops early at the end of file or at a block that is already cached.
+ * Returns the number of blocks added. */
+static int fetch_blocks(URLContext *h, int64_t index, int count)
+{
+    BlockCacheContext *c = h->priv_data;
+    int64_t pos = index * c->block_size;
+    int ret = 0;
+
+    if (c->inner_pos != pos) {
+        int64_t r = ffurl_seek(c->inner, pos, SEEK_SET);
+        if (r < 0)
+            return r;
+        c->inner_pos = pos;
+    }
+
+    for (int i = 0; i < count; i++) {
+        BlockCacheEntry *e;
+
+        if (i && av_tree_find(c->root, &(int64_t){ index + i }, cmp, NULL))
+            break;
+
+        e = av_mallocz(sizeof(*e));
+        if (!e || !(e->data = av_malloc(c->block_size))) {
+            av_free(e);
+            return AVERROR(ENOMEM);
+        }
+        e->index = index + i;
+
+        while (e->size < c->block_size) {
+            ret = ffurl_read(c->inner, e->data + e->size, c->block_size - e->size);
+            if (ret < 0)
+                break;
+            e->size     += ret;
+            c->inner_pos += ret;
+        }
+        if (ret == AVERROR_EOF)
+            c->size = c->inner_pos;
+        if (!e->size || (ret < 0 && ret != AVERROR_EOF)) {
+            av_free(e->data);
+            av_free(e);
+            return i ? i : ret;
+        }
+
+        if ((ret = block_insert(c, e)) < 0) {
+            av_free(e->data);
+            av_free(e);
+            return ret;
+        }
+        c->fetched++;
+        if (e->size < c->block_size)
+            return i + 1;
+    }
+    return count;
+}
+
+static int blockcache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    BlockCacheContext *c = h->priv_data;
+    int ret;
+
+    av_strstart(arg, "blockcache:", &arg);
+
+    if (flags & AVIO_FLAG_WRITE)
+        return AVERROR(ENOSYS);
+
+    ret = ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
+                               options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0)
+        return ret;
+
+    c->max_blocks = FFMAX(c->cache_size / c->block_size, 2 * c->readahead + 2);
+    c->readahead  = FFMAX(c->readahead, 1);
+    c->size       = ffurl_size(c->inner);
+    if (c->size < 0)
+        c->size = -1;
+    c->last_miss  = -2;
+    c->last_end   = -1;
+    h->is_streamed = c->inner->is_streamed;
+    return 0;
+}
+
+static int blockcache_read(URLContext *h, unsigned char *buf, int size)
+{
+    BlockCacheContext *c = h->priv_data;
+    int64_t index = c->pos / c->block_size;
+    int offset = c->pos % c->block_size;
+    BlockCacheEntry *e;
+    int ret;
+
+    if (c->size >= 0 && c->pos >= c->size)
+        return AVERROR_EOF;
+
+    e = av_tree_find(c->root, &index, cmp, NULL);
+    if (e) {
+        c->hits++;
+        /* index structures are read again and again, sequential data is not */
+        if (c->pos != c->last_end && ++e->revisits >= PIN_REVISITS)
+            block_pin(c, e);
+    } else {
+        int count = 1;
+
+        c->misses++;
+        if (index == c->last_miss + 1)
+            c->run = FFMIN(c->run + 1, 30);
+        else
+            c->run = 0;
+        if (c->run)
+            count = FFMIN(1 << c->run, c->readahead);
+
+        ret = fetch_blocks(h, index, count);
+        if (ret < 0)
+            return ret;
+        c->last_miss = index + FFMAX(ret, 1) - 1;
+        e = av_tree_find(c->root, &index, cmp, NULL);
+        if (!e)
+            return AVERROR_EOF;
+    }
+
+    if (offset >= e->size)
+        return AVERROR_EOF;
+
+    if (e != c->lru_head) {
+        lru_unlink(c, e);
+        lru_push(c, e);
+    }
+
+    size = FFMIN(size, e->size - offset);
+    memcpy(buf, e->data + offset, size);
+    c->pos     += size;
+    c->last_end = c->pos;
+    return size;
+}
+
+static int64_t blockcache_seek(URLContext *h, int64_t pos, int whence)
+{
+    BlockCacheContext *c = h->priv_data;
+
+    switch (whence) {
+    case AVSEEK_SIZE:
+        if (c->size < 0) {
+            int64_t size = ffurl_seek(c->inner, 0, AVSEEK_SIZE);
+            if (size >= 0)
+                c->size = size;
+            return size;
+        }
+        return c->size;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += c->pos;
+        break;
+    case SEEK_END:
+        if (c->size < 0)
+            return AVERROR(ENOSYS);
+        pos += c->size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    /* the inner protocol is only repositioned on the next miss */
+    c->pos = pos;
+    return pos;
+}
+
+static int blockcache_close(URLContext *h)
+{
+    BlockCacheContext *c = h->priv_data;
+
+    av_log(h, AV_LOG_VERBOSE, "Statistics, cache hits:%"PRId64" misses:%"PRId64
+           " blocks fetched:%"PRId64" pinned:%d\n",
+           c->hits, c->misses, c->fetched, c->nb_pinned);
+
+    while (c->lru_head) {
+        BlockCacheEntry *e = c->lru_head;
+        lru_unlink(c, e);
+        av_free(e->data);
+        av_free(e);
+    }
+    av_tree_destroy(c->root);
+    c->root = NULL;
+    return ffurl_closep(&c->inner);
+}
+
+#define OFFSET(x) offsetof(BlockCacheContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+
+static const AVOption options[] = {
+    { "block_size", "size of a cache block", OFFSET(block_size), AV_OPT_TYPE_INT, { .i64 = 64 * 1024 }, 4096, 16 << 20, D },
+    { "cache_size", "maximum amount of data kept in memory", OFFSET(cache_size), AV_OPT_TYPE_INT64, { .i64 = 32 << 20 }, 0, INT64_MAX, D },
+    { "readahead", "maximum number of blocks fetched at once while reading sequentially", OFFSET(readahead), AV_OPT_TYPE_INT, { .i64 = 16 }, 1, 1024, D },
+    { "pin_size", "bytes at the start and the end of the file kept cached", OFFSET(pin_size), AV_OPT_TYPE_INT64, { .i64 = 1 << 20 }, 0, INT64_MAX, D },
+    { NULL }
+};
+
+static const AVClass blockcache_context_class = {
+    .class_name = "blockcache",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_blockcache_protocol = {
+    .name                = "blockcache",
+    .url_open2           = blockcache_open,
+    .url_read            = blockcache_read,
+    .url_seek            = blockcache_seek,
+    .url_close           = blockcache_close,
+    .priv_data_size      = sizeof(BlockCacheContext),
+    .priv_data_class     = &blockcache_context_class,
+};
@@ -18,12 +18,15 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h> //PLEX
+
 #include "libavutil/avstring.h"
 #include "libavutil/avassert.h"
 #include "libavutil/bprint.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h" //PLEX
 #include "libavutil/timestamp.h"
 #include "libavcodec/codec_desc.h"
 #include "libavcodec/bsf.h"
@@ -41,6 +44,7 @@ typedef enum ConcatMatchMode {
 typedef struct ConcatStream {
     AVBSFContext *bsf;
     int out_stream_index;
+    int new_extradata; //PLEX
 } ConcatStream;
 
 typedef struct {
@@ -61,6 +65,20 @@ typedef struct {
     int got_first;
 } ConcatFile;
 
+//PLEX
+/* The file following the current one, opened and probed by a background
+ * thread while the current one is being read. */
+typedef struct ConcatPreopen {
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int active;
+    unsigned fileno;
+    AVFormatContext *avf;
+    int ret;
+} ConcatPreopen;
+//PLEX
+
 typedef struct {
     AVClass *class;
     ConcatFile *files;
@@ -77,6 +95,14 @@ typedef struct {
     int skip_before_video_key;
     int skip_before_inpoint;
     int offset_inout;
+    //PLEX
+    int preopen;
+    ConcatPreopen next;
+    /* only set while the reading thread waits for a cancelled preopen, so
+     * the files adopted from earlier preopens can keep using it */
+    atomic_int preopen_abort;
+    AVIOInterruptCB *interrupt_callback;
+    //PLEX
 } ConcatContext;
 
 static int concat_probe(const AVProbeData *probe)
@@ -176,11 +202,18 @@ fail:
     return ret;
 }
 
+/* Returns 1 if the stream was already set up and the extradata changed. */
 static int copy_stream_props(AVStream *st, AVStream *source_st)
 {
-    int ret;
+    int ret, changed; //PLEX
 
     if (st->codecpar->codec_id || !source_st->codecpar->codec_id) {
+        //PLEX
+        changed = source_st->codecpar->extradata_size &&
+                  (st->codecpar->extradata_size != source_st->codecpar->extradata_size ||
+                   memcmp(st->codecpar->extradata, source_st->codecpar->extradata,
+                          source_st->codecpar->extradata_size));
+        //PLEX
         if (st->codecpar->extradata_size < source_st->codecpar->extradata_size) {
             ret = ff_alloc_extradata(st->codecpar,
                                      source_st->codecpar->extradata_size);
@@ -190,7 +223,7 @@ static int copy_stream_props(AVStream *st, AVStream *source_st)
         if (source_st->codecpar->extradata_size)
             memcpy(st->codecpar->extradata, source_st->codecpar->extradata,
                    source_st->codecpar->extradata_size);
-        return 0;
+        return changed; //PLEX
     }
     if ((ret = avcodec_parameters_copy(st->codecpar, source_st->codecpar)) < 0)
         return ret;
@@ -261,6 +294,7 @@ static int match_streams_one_to_one(AVFormatContext *avf)
         if ((ret = copy_stream_props(st, cat->avf->streams[i])) < 0)
             return ret;
         cat->cur_file->streams[i].out_stream_index = i;
+        cat->cur_file->streams[i].new_extradata = ret; //PLEX
     }
     return 0;
 }
@@ -281,6 +315,7 @@ static int match_streams_exact_id(AVFormatContext *avf)
                 if ((ret = copy_stream_props(avf->streams[j], st)) < 0)
                     return ret;
                 cat->cur_file->streams[i].out_stream_index = j;
+                cat->cur_file->streams[i].new_extradata = ret; //PLEX
             }
         }
     }
@@ -337,42 +372,143 @@ static int64_t get_best_effort_duration(ConcatFile *file, AVFormatContext *avf)
     return AV_NOPTS_VALUE;
 }
 
-static int open_file(AVFormatContext *avf, unsigned fileno)
+//PLEX
+/* Open and probe a file, and seek to its in point. This runs on the preopen
+ * thread too, so it must not touch the state of the current file. */
+static int open_file_context(AVFormatContext *avf, ConcatFile *file,
+                             AVFormatContext **ravf, AVIOInterruptCB *int_cb)
 {
     ConcatContext *cat = avf->priv_data;
-    ConcatFile *file = &cat->files[fileno];
+    AVFormatContext *s;
     AVDictionary *options = NULL;
     int ret;
 
-    if (cat->avf)
-        avformat_close_input(&cat->avf);
-
-    cat->avf = avformat_alloc_context();
-    if (!cat->avf)
+    s = *ravf = avformat_alloc_context();
+    if (!s)
         return AVERROR(ENOMEM);
 
-    cat->avf->flags |= avf->flags & ~AVFMT_FLAG_CUSTOM_IO;
-    cat->avf->interrupt_callback = avf->interrupt_callback;
+    s->flags |= avf->flags & ~AVFMT_FLAG_CUSTOM_IO;
+    s->interrupt_callback = *int_cb;
 
-    if ((ret = ff_copy_whiteblacklists(cat->avf, avf)) < 0)
-        return ret;
+    if ((ret = ff_copy_whiteblacklists(s, avf)) < 0)
+        goto fail;
+    if (avf->probe_cache && !(s->probe_cache = av_strdup(avf->probe_cache))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
 
     ret = av_dict_copy(&options, file->options, 0);
     if (ret < 0)
-        return ret;
+        goto fail;
 
-    if ((ret = avformat_open_input(&cat->avf, file->url, NULL, &options)) < 0 ||
-        (ret = avformat_find_stream_info(cat->avf, NULL)) < 0) {
-        av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
+    if ((ret = avformat_open_input(ravf, file->url, NULL, &options)) < 0 ||
+        (ret = avformat_find_stream_info(*ravf, NULL)) < 0) {
+        if (!atomic_load(&cat->preopen_abort))
+            av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
         av_dict_free(&options);
-        avformat_close_input(&cat->avf);
-        return ret;
+        goto fail;
     }
     if (options) {
         av_log(avf, AV_LOG_WARNING, "Unused options for '%s'.\n", file->url);
         /* TODO log unused options once we have a proper string API */
         av_dict_free(&options);
     }
+    if (file->inpoint != AV_NOPTS_VALUE) {
+        if ((ret = avformat_seek_file(*ravf, -1, INT64_MIN, file->inpoint, file->inpoint, 0)) < 0)
+            goto fail;
+    }
+    return 0;
+
+fail:
+    avformat_close_input(ravf);
+    return ret;
+}
+
+#if HAVE_THREADS
+static int preopen_interrupt_cb(void *opaque)
+{
+    ConcatContext *cat = opaque;
+    return atomic_load(&cat->preopen_abort) || ff_check_interrupt(cat->interrupt_callback);
+}
+
+static void *preopen_thread(void *arg)
+{
+    AVFormatContext *avf = arg;
+    ConcatContext *cat = avf->priv_data;
+    AVIOInterruptCB int_cb = { preopen_interrupt_cb, cat };
+
+    cat->next.ret = open_file_context(avf, &cat->files[cat->next.fileno],
+                                      &cat->next.avf, &int_cb);
+    return NULL;
+}
+
+static void preopen_start(AVFormatContext *avf, unsigned fileno)
+{
+    ConcatContext *cat = avf->priv_data;
+    int ret;
+
+    cat->next.fileno = fileno;
+    cat->next.avf    = NULL;
+    if ((ret = pthread_create(&cat->next.thread, NULL, preopen_thread, avf))) {
+        av_log(avf, AV_LOG_WARNING, "Could not start opening '%s' ahead: %s\n",
+               cat->files[fileno].url, av_err2str(AVERROR(ret)));
+        return;
+    }
+    cat->next.active = 1;
+    av_log(avf, AV_LOG_DEBUG, "Opening file %u ahead\n", fileno);
+}
+
+/* Wait for the preopened file, and return it unless it was cancelled. */
+static int preopen_finish(ConcatContext *cat, AVFormatContext **ravf, int cancel)
+{
+    if (!cat->next.active)
+        return AVERROR(EAGAIN);
+    if (cancel)
+        atomic_store(&cat->preopen_abort, 1);
+    pthread_join(cat->next.thread, NULL);
+    atomic_store(&cat->preopen_abort, 0);
+    cat->next.active = 0;
+
+    if (cancel) {
+        avformat_close_input(&cat->next.avf);
+        return AVERROR_EXIT;
+    }
+    *ravf = cat->next.avf;
+    cat->next.avf = NULL;
+    return cat->next.ret;
+}
+#else
+static void preopen_start(AVFormatContext *avf, unsigned fileno)
+{
+}
+
+static int preopen_finish(ConcatContext *cat, AVFormatContext **ravf, int cancel)
+{
+    return AVERROR(EAGAIN);
+}
+#endif
+//PLEX
+
+static int open_file(AVFormatContext *avf, unsigned fileno)
+{
+    ConcatContext *cat = avf->priv_data;
+    ConcatFile *file = &cat->files[fileno];
+    int ret;
+
+    if (cat->avf)
+        avformat_close_input(&cat->avf);
+
+    //PLEX
+    if (cat->next.active && cat->next.fileno == fileno) {
+        if ((ret = preopen_finish(cat, &cat->avf, 0)) < 0)
+            return ret;
+        cat->avf->interrupt_callback = avf->interrupt_callback;
+    } else {
+        preopen_finish(cat, NULL, 1);
+        if ((ret = open_file_context(avf, file, &cat->avf, &avf->interrupt_callback)) < 0)
+            return ret;
+    }
+    //PLEX
     cat->cur_file = file;
     file->start_time = !fileno ? 0 :
                        cat->files[fileno - 1].start_time +
@@ -389,10 +525,10 @@ static int open_file(AVFormatContext *avf, unsigned fileno)
 
     if ((ret = match_streams(avf)) < 0)
         return ret;
-    if (file->inpoint != AV_NOPTS_VALUE) {
-       if ((ret = avformat_seek_file(cat->avf, -1, INT64_MIN, file->inpoint, file->inpoint, 0)) < 0)
-           return ret;
-    }
+    //PLEX
+    if (cat->preopen && fileno + 1 < cat->nb_files)
+        preopen_start(avf, fileno + 1);
+    //PLEX
     return 0;
 }
 
@@ -401,6 +537,7 @@ static int concat_read_close(AVFormatContext *avf)
     ConcatContext *cat = avf->priv_data;
     unsigned i, j;
 
+    preopen_finish(cat, NULL, 1); //PLEX
     for (i = 0; i < cat->nb_files; i++) {
         av_freep(&cat->files[i].url);
         for (j = 0; j < cat->files[i].nb_streams; j++) {
@@ -669,6 +806,11 @@ static int concat_read_header(AVFormatContext *avf)
     unsigned i;
     int ret;
 
+    //PLEX
+    atomic_init(&cat->preopen_abort, 0);
+    cat->interrupt_callback = &avf->interrupt_callback;
+    //PLEX
+
     ret = concat_parse_script(avf);
     if (ret < 0)
         return ret;
@@ -837,6 +979,19 @@ static int concat_read_packet(AVFormatContext *avf, AVPacket *pkt)
     if ((ret = filter_packet(avf, cs, pkt)) < 0)
         return ret;
 
+    //PLEX
+    /* let the caller's decoder carry on across files with new extradata */
+    if (cat->preopen && cs->new_extradata && !cs->bsf) {
+        AVCodecParameters *par = cat->avf->streams[pkt->stream_index]->codecpar;
+        uint8_t *sd = av_packet_new_side_data(pkt, AV_PKT_DATA_NEW_EXTRADATA,
+                                              par->extradata_size);
+        if (!sd)
+            return AVERROR(ENOMEM);
+        memcpy(sd, par->extradata, par->extradata_size);
+        cs->new_extradata = 0;
+    }
+    //PLEX
+
     st = cat->avf->streams[pkt->stream_index];
     sti = ffstream(st);
     av_log(avf, AV_LOG_DEBUG, "file:%d stream:%d pts:%s pts_time:%s dts:%s dts_time:%s",
@@ -989,6 +1144,8 @@ static const AVOption options[] = {
       OFFSET(skip_before_inpoint), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
     { "offset_inout", "offset in/out points by the file's start time",
       OFFSET(offset_inout), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
+    { "preopen", "open the next file in the background for gapless transitions", //PLEX
+      OFFSET(preopen), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
     { NULL }
 };
 
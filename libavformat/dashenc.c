@@ -38,6 +38,7 @@
 #include "libavutil/rational.h"
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
+#include "libavutil/tracepoint.h" //PLEX
 
 #include "libavcodec/avcodec.h"
 
@@ -69,6 +70,7 @@ enum {
     FRAG_TYPE_EVERY_FRAME,
     FRAG_TYPE_DURATION,
     FRAG_TYPE_PFRAMES,
+    FRAG_TYPE_FRAMES, //PLEX
     FRAG_TYPE_NB
 };
 
@@ -91,6 +93,7 @@ typedef struct AdaptationSet {
     int64_t seg_duration;
     int64_t frag_duration;
     int frag_type;
+    int frag_frames; //PLEX
     enum AVMediaType media_type;
     AVDictionary *metadata;
     AVRational min_frame_rate, max_frame_rate;
@@ -141,9 +144,20 @@ typedef struct OutputStream {
     int64_t total_pkt_duration;
     int muxer_overhead;
     int frag_type;
+    int frag_frames; //PLEX
     int64_t gop_size;
     AVRational sar;
     int coding_dependency;
+    //PLEX
+    /* SegmentTimeline cache: the closed <S> runs are kept serialized, only
+     * the last run can still grow. */
+    int segments_removed;           /* segments dropped from the front of the list */
+    AVBPrint timeline;
+    int timeline_first;             /* first segment covered, counting removed ones */
+    int timeline_nb;                /* segments covered, including the open run */
+    int64_t run_time, run_duration, run_end;
+    int run_repeat, run_has_time;
+    //PLEX
 } OutputStream;
 
 typedef struct DASHContext {
@@ -201,6 +215,7 @@ typedef struct DASHContext {
     int nr_of_streams_to_flush;
     int nr_of_streams_flushed;
     int frag_type;
+    int frag_frames; //PLEX
     int write_prft;
     int64_t max_gop_size;
     int64_t max_segment_duration;
@@ -488,8 +503,10 @@ static void set_http_options(AVDictionary **options, DASHContext *c)
     av_dict_copy(options, c->http_opts, 0);
     if (c->user_agent)
         av_dict_set(options, "user_agent", c->user_agent, 0);
-    if (c->http_persistent)
+    if (c->http_persistent) {
         av_dict_set_int(options, "multiple_requests", 1, 0);
+        av_dict_set_int(options, "connection_pool", 1, 0); //PLEX
+    }
     if (c->timeout >= 0)
         av_dict_set_int(options, "timeout", c->timeout, 0);
 }
@@ -640,6 +657,7 @@ static void dash_free(AVFormatContext *s)
         for (j = 0; j < os->nb_segments; j++)
             av_free(os->segments[j]);
         av_free(os->segments);
+        av_bprint_finalize(&os->timeline, NULL); //PLEX
         av_freep(&os->single_file_name);
         av_freep(&os->init_seg_name);
         av_freep(&os->media_seg_name);
@@ -651,6 +669,65 @@ static void dash_free(AVFormatContext *s)
     ff_format_io_close(s, &c->http_delete);
 }
 
+//PLEX
+static void print_timeline_run(AVBPrint *bp, const OutputStream *os)
+{
+    av_bprintf(bp, "\t\t\t\t\t\t<S ");
+    if (os->run_has_time)
+        av_bprintf(bp, "t=\"%"PRId64"\" ", os->run_time);
+    av_bprintf(bp, "d=\"%"PRId64"\" ", os->run_duration);
+    if (os->run_repeat > 0)
+        av_bprintf(bp, "r=\"%d\" ", os->run_repeat);
+    av_bprintf(bp, "/>\n");
+}
+
+/* Only the segments added since the last manifest are serialized, unless
+ * the window moved and the timeline has to be rebuilt. */
+static void output_segment_timeline(AVFormatContext *s, OutputStream *os,
+                                    AVIOContext *out, int start_index)
+{
+    int first = os->segments_removed + start_index;
+    AVBPrint run;
+
+    if (os->timeline_nb && os->timeline_first != first) {
+        av_bprint_clear(&os->timeline);
+        os->timeline_nb = 0;
+    }
+    os->timeline_first = first;
+
+    for (int i = start_index + os->timeline_nb; i < os->nb_segments; i++) {
+        Segment *seg = os->segments[i];
+        if (os->timeline_nb && seg->duration == os->run_duration &&
+            seg->time == os->run_end) {
+            os->run_repeat++;
+        } else {
+            if (os->timeline_nb)
+                print_timeline_run(&os->timeline, os);
+            os->run_has_time = !os->timeline_nb || seg->time != os->run_end;
+            os->run_time     = seg->time;
+            os->run_duration = seg->duration;
+            os->run_repeat   = 0;
+        }
+        os->run_end = seg->time + seg->duration;
+        os->timeline_nb++;
+    }
+
+    if (!av_bprint_is_complete(&os->timeline)) {
+        av_log(s, AV_LOG_ERROR, "Out of memory for the segment timeline\n");
+        av_bprint_clear(&os->timeline);
+        os->timeline_nb = 0;
+        return;
+    }
+
+    avio_write(out, os->timeline.str, os->timeline.len);
+    if (os->timeline_nb) {
+        av_bprint_init(&run, 0, AV_BPRINT_SIZE_AUTOMATIC);
+        print_timeline_run(&run, os);
+        avio_write(out, run.str, run.len);
+    }
+}
+//PLEX
+
 static void output_segment_list(OutputStream *os, AVIOContext *out, AVFormatContext *s,
                                 int representation_id, int final)
 {
@@ -675,27 +752,8 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, AVFormatCont
             avio_printf(out, " presentationTimeOffset=\"%"PRId64"\"", c->presentation_time_offset);
         avio_printf(out, ">\n");
         if (c->use_timeline) {
-            int64_t cur_time = 0;
             avio_printf(out, "\t\t\t\t\t<SegmentTimeline>\n");
-            for (i = start_index; i < os->nb_segments; ) {
-                Segment *seg = os->segments[i];
-                int repeat = 0;
-                avio_printf(out, "\t\t\t\t\t\t<S ");
-                if (i == start_index || seg->time != cur_time) {
-                    cur_time = seg->time;
-                    avio_printf(out, "t=\"%"PRId64"\" ", seg->time);
-                }
-                avio_printf(out, "d=\"%"PRId64"\" ", seg->duration);
-                while (i + repeat + 1 < os->nb_segments &&
-                       os->segments[i + repeat + 1]->duration == seg->duration &&
-                       os->segments[i + repeat + 1]->time == os->segments[i + repeat]->time + os->segments[i + repeat]->duration)
-                    repeat++;
-                if (repeat > 0)
-                    avio_printf(out, "r=\"%d\" ", repeat);
-                avio_printf(out, "/>\n");
-                i += 1 + repeat;
-                cur_time += (1 + repeat) * seg->duration;
-            }
+            output_segment_timeline(s, os, out, start_index); //PLEX
             avio_printf(out, "\t\t\t\t\t</SegmentTimeline>\n");
         }
         avio_printf(out, "\t\t\t\t</SegmentTemplate>\n");
@@ -1030,6 +1088,8 @@ static int parse_adaptation_sets(AVFormatContext *s)
                 as->frag_type = FRAG_TYPE_PFRAMES;
             else if (!strcmp(type_str, "every_frame"))
                 as->frag_type = FRAG_TYPE_EVERY_FRAME;
+            else if (!strcmp(type_str, "frames")) //PLEX
+                as->frag_type = FRAG_TYPE_FRAMES;
             else if (!strcmp(type_str, "none"))
                 as->frag_type = FRAG_TYPE_NONE;
             else {
@@ -1037,6 +1097,23 @@ static int parse_adaptation_sets(AVFormatContext *s)
                 return ret;
             }
             state = parse_default;
+        //PLEX
+        } else if (state != new_set && av_strstart(p, "frag_frames=", &p)) {
+            char frames_str[12], *end_str;
+
+            n = strcspn(p, ",");
+            snprintf(frames_str, sizeof(frames_str), "%.*s", n, p);
+            p += n;
+            if (*p)
+                p++;
+
+            as->frag_frames = strtol(frames_str, &end_str, 10);
+            if (frames_str == end_str || *end_str || as->frag_frames <= 0) {
+                av_log(s, AV_LOG_ERROR, "Unable to parse option value \"%s\" as frame count\n", frames_str);
+                return AVERROR(EINVAL);
+            }
+            state = parse_default;
+        //PLEX
         } else if (state != new_set && av_strstart(p, "descriptor=", &p)) {
             n = strcspn(p, ">") + 1; //followed by one comma, so plus 1
             if (n < strlen(p)) {
@@ -1616,9 +1693,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
             as->frag_duration = c->frag_duration;
         if (as->frag_type < 0)
             as->frag_type = c->frag_type;
+        if (!as->frag_frames) //PLEX
+            as->frag_frames = c->frag_frames;
         os->seg_duration = as->seg_duration;
         os->frag_duration = as->frag_duration;
         os->frag_type = as->frag_type;
+        os->frag_frames = as->frag_frames; //PLEX
 
         c->max_segment_duration = FFMAX(c->max_segment_duration, as->seg_duration);
 
@@ -1631,6 +1711,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
             av_log(s, AV_LOG_WARNING, "frag_type set to duration for stream %d but no frag_duration set\n", i);
             os->frag_type = c->streaming ? FRAG_TYPE_EVERY_FRAME : FRAG_TYPE_NONE;
         }
+        //PLEX
+        if (os->frag_type == FRAG_TYPE_FRAMES && !os->frag_frames) {
+            av_log(s, AV_LOG_WARNING, "frag_type set to frames for stream %d but no frag_frames set\n", i);
+            os->frag_type = c->streaming ? FRAG_TYPE_EVERY_FRAME : FRAG_TYPE_NONE;
+        }
+        //PLEX
         if (os->frag_type == FRAG_TYPE_DURATION && os->frag_duration > os->seg_duration) {
             av_log(s, AV_LOG_ERROR, "Fragment duration %"PRId64" is longer than Segment duration %"PRId64"\n", os->frag_duration, os->seg_duration);
             return AVERROR(EINVAL);
@@ -1732,6 +1818,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
                       sizeof(os->codec_str));
         os->first_pts = AV_NOPTS_VALUE;
         os->max_pts = AV_NOPTS_VALUE;
+        av_bprint_init(&os->timeline, 0, AV_BPRINT_SIZE_UNLIMITED); //PLEX
         os->last_dts = AV_NOPTS_VALUE;
         os->segment_index = c->skip_to_segment; //PLEX
 
@@ -1929,6 +2016,7 @@ static inline void dashenc_delete_media_segments(AVFormatContext *s, OutputStrea
     }
 
     os->nb_segments -= remove_count;
+    os->segments_removed += remove_count; //PLEX
     memmove(os->segments, os->segments + remove_count, os->nb_segments * sizeof(*os->segments));
 }
 
@@ -1938,7 +2026,7 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
     int i, ret = 0;
 
     const char *proto = avio_find_protocol_name(s->url);
-    int use_rename = proto && !strcmp(proto, "file");
+    int use_rename = proto && !strcmp(proto, "file") && !c->streaming; //PLEX
 
     int cur_flush_segment_index = 0, next_exp_index = -1;
     if (stream >= 0) {
@@ -1991,6 +2079,7 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
         if (c->single_file) {
             find_index_range(s, os->full_path, os->pos, &index_length);
         } else {
+            FF_TRACE3(segment_close, os->full_path, os->segment_index, range_length); //PLEX
             dashenc_io_close(s, &os->out, os->temp_path);
 
             if (use_rename) {
@@ -2146,7 +2235,7 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
 
     if (!os->availability_time_offset &&
         ((os->frag_type == FRAG_TYPE_DURATION && os->seg_duration != os->frag_duration) ||
-         (os->frag_type == FRAG_TYPE_EVERY_FRAME && pkt->duration))) {
+         ((os->frag_type == FRAG_TYPE_EVERY_FRAME || os->frag_type == FRAG_TYPE_FRAMES) && pkt->duration))) { //PLEX
         AdaptationSet *as = &c->as[os->as_idx - 1];
         int64_t frame_duration = 0;
 
@@ -2157,6 +2246,13 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         case FRAG_TYPE_EVERY_FRAME:
             frame_duration = av_rescale_q(pkt->duration, st->time_base, AV_TIME_BASE_Q);
             break;
+        //PLEX
+        case FRAG_TYPE_FRAMES:
+            frame_duration = av_rescale_q(pkt->duration * os->frag_frames, st->time_base,
+                                          AV_TIME_BASE_Q);
+            frame_duration = FFMIN(frame_duration, os->seg_duration);
+            break;
+        //PLEX
         }
 
          os->availability_time_offset = ((double) os->seg_duration -
@@ -2252,6 +2348,17 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
+    //PLEX
+    /* Cut a fragment every frag_frames packets so that each chunk of the
+     * in-progress segment can be sent out as soon as it is complete. */
+    if (os->frag_type == FRAG_TYPE_FRAMES && os->packets_written &&
+        !(os->packets_written % os->frag_frames)) {
+        ret = av_write_frame(os->ctx, NULL);
+        if (ret < 0)
+            return ret;
+    }
+    //PLEX
+
     if (pkt->flags & AV_PKT_FLAG_KEY && (os->packets_written || os->nb_segments) && !os->gop_size && as->trick_idx < 0) {
         os->gop_size = os->last_duration + av_rescale_q(os->total_pkt_duration, st->time_base, AV_TIME_BASE_Q);
         c->max_gop_size = FFMAX(c->max_gop_size, os->gop_size);
@@ -2272,7 +2379,8 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
     if (!c->single_file && os->packets_written == 1) {
         AVDictionary *opts = NULL;
         const char *proto = avio_find_protocol_name(s->url);
-        int use_rename = proto && !strcmp(proto, "file");
+        // PLEX: in streaming mode, chunks must be visible while the segment is written
+        int use_rename = proto && !strcmp(proto, "file") && !c->streaming;
         if (os->segment_type == SEGMENT_TYPE_MP4)
             write_styp(os->ctx->pb);
         os->filename[0] = os->full_path[0] = os->temp_path[0] = '\0';
@@ -2289,6 +2397,7 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         if (ret < 0) {
             return handle_io_open_error(s, ret, os->temp_path);
         }
+        FF_TRACE2(segment_open, os->full_path, os->segment_index); //PLEX
 
         // in streaming mode, the segments are available for playing
         // before fully written but the manifest is needed so that
@@ -2396,6 +2505,8 @@ static const AVOption options[] = {
     { "every_frame", "fragment at every frame", 0, AV_OPT_TYPE_CONST, {.i64 = FRAG_TYPE_EVERY_FRAME }, 0, UINT_MAX, E, "frag_type"},
     { "duration", "fragment at specific time intervals", 0, AV_OPT_TYPE_CONST, {.i64 = FRAG_TYPE_DURATION }, 0, UINT_MAX, E, "frag_type"},
     { "pframes", "fragment at keyframes and following P-Frame reordering (Video only, experimental)", 0, AV_OPT_TYPE_CONST, {.i64 = FRAG_TYPE_PFRAMES }, 0, UINT_MAX, E, "frag_type"},
+    { "frames", "fragment every frag_frames frames", 0, AV_OPT_TYPE_CONST, {.i64 = FRAG_TYPE_FRAMES }, 0, UINT_MAX, E, "frag_type"}, //PLEX
+    { "frag_frames", "set the number of frames per fragment for frag_type frames", OFFSET(frag_frames), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E }, //PLEX
     { "remove_at_exit", "remove all segments when finished", OFFSET(remove_at_exit), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "use_template", "Use SegmentTemplate instead of SegmentList", OFFSET(use_template), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, E },
     { "use_timeline", "Use SegmentTimeline in SegmentTemplate", OFFSET(use_timeline), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, E },
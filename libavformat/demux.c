@@ -29,10 +29,13 @@
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/mem_internal.h" //PLEX
 #include "libavutil/opt.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/slicethread.h" //PLEX
 #include "libavutil/time.h"
 #include "libavutil/timestamp.h"
+#include "libavutil/tracepoint.h" //PLEX
 
 #include "libavcodec/avcodec.h"
 #include "libavcodec/bsf.h"
@@ -46,6 +49,7 @@
 #include "demux.h"
 #include "id3v2.h"
 #include "internal.h"
+#include "probecache.h" //PLEX
 #include "url.h"
 
 static int64_t wrap_timestamp(const AVStream *st, int64_t timestamp)
@@ -183,6 +187,24 @@ static int init_input(AVFormatContext *s, const char *filename,
                                   s, 0, s->format_probesize);
 }
 
+//PLEX
+static void decrypt_init_stream(AVFormatContext *s, AVStream *st)
+{
+    FFStream *const sti = ffstream(st);
+    int (*new_stream)(AVFormatContext *ctx, AVStream *s);
+
+    if (sti->decrypt_inited)
+        return;
+
+    ff_lock_avformat();
+    new_stream = decryption_callbacks.new_stream;
+    ff_unlock_avformat();
+    if (new_stream)
+        new_stream(s, st);
+    sti->decrypt_inited = 1;
+}
+//PLEX
+
 static int update_stream_avctx(AVFormatContext *s)
 {
     int ret;
@@ -216,16 +238,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         if (ret < 0)
             return ret;
 
-//PLEX
-        if (!sti->decrypt_inited) {
-            ff_lock_avformat();
-            int (*new_stream)(AVFormatContext *ctx, AVStream *s) = decryption_callbacks.new_stream;
-            ff_unlock_avformat();
-            if (new_stream)
-                new_stream(s, st);
-            sti->decrypt_inited = 1;
-        }
-//PLEX
+        decrypt_init_stream(s, st); //PLEX
 
         sti->codec_desc = avcodec_descriptor_get(sti->avctx->codec_id);
 
@@ -320,15 +333,25 @@ int avformat_open_input(AVFormatContext **ps, const char *filename,
     }
 
     /* e.g. AVFMT_NOFILE formats will not have an AVIOContext */
-    if (s->pb)
-        ff_id3v2_read_dict(s->pb, &si->id3v2_meta, ID3v2_DEFAULT_MAGIC, &id3v2_extra_meta);
+    if (s->pb) {
+        //PLEX
+        if (s->lazy_attached_pics)
+            ff_id3v2_read_dict_lazy(s, &si->id3v2_meta, ID3v2_DEFAULT_MAGIC, &id3v2_extra_meta);
+        else
+            ff_id3v2_read_dict(s->pb, &si->id3v2_meta, ID3v2_DEFAULT_MAGIC, &id3v2_extra_meta);
+        //PLEX
+    }
 
-    if (s->iformat->read_header)
-        if ((ret = s->iformat->read_header(s)) < 0) {
+    if (s->iformat->read_header) {
+        int tag = avpriv_mem_tag_push(AV_MEM_TAG_FORMAT); //PLEX
+        ret = s->iformat->read_header(s);
+        avpriv_mem_tag_pop(tag); //PLEX
+        if (ret < 0) {
             if (s->iformat->flags_internal & FF_FMT_INIT_CLEANUP)
                 goto close;
             goto fail;
         }
+    }
 
     if (!s->metadata) {
         s->metadata    = si->id3v2_meta;
@@ -352,7 +375,7 @@ int avformat_open_input(AVFormatContext **ps, const char *filename,
         ff_id3v2_free_extra_meta(&id3v2_extra_meta);
     }
 
-    if ((ret = avformat_queue_attached_pictures(s)) < 0)
+    if ((ret = ff_queue_attached_pictures(s)) < 0) //PLEX
         goto close;
 
     if (s->pb && !si->data_offset)
@@ -551,6 +574,149 @@ static int update_wrap_reference(AVFormatContext *s, AVStream *st, int stream_in
     return 1;
 }
 
+//PLEX
+static void decrypt_worker(void *priv, int jobnr, int threadnr,
+                           int nb_jobs, int nb_threads)
+{
+    AVFormatContext *const s = priv;
+    FFFormatContext *const si = ffformatcontext(s);
+    AVPacket *const pkt = si->decrypt_pkts[jobnr];
+
+    if (si->decrypt_handle_packet(s, pkt) < 0)
+        pkt->flags |= AV_PKT_FLAG_CORRUPT;
+}
+
+static int decrypt_packets(AVFormatContext *s, AVPacket **pkts, int nb_pkts)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    AVDecryptionCallbacks cbs;
+    int ret;
+
+    ff_lock_avformat();
+    cbs = decryption_callbacks;
+    ff_unlock_avformat();
+    if (!cbs.handle_packet && !cbs.handle_packets)
+        return 0;
+
+    for (int i = 0; i < nb_pkts; i++) {
+        decrypt_init_stream(s, s->streams[pkts[i]->stream_index]);
+        if ((ret = av_packet_make_writable(pkts[i])) < 0)
+            return ret;
+    }
+
+    if (cbs.handle_packets) {
+        if (cbs.handle_packets(s, pkts, nb_pkts) < 0)
+            for (int i = 0; i < nb_pkts; i++)
+                pkts[i]->flags |= AV_PKT_FLAG_CORRUPT;
+        return 0;
+    }
+
+    if (nb_pkts > 1 && s->decrypt_threads > 1 && pkts == si->decrypt_pkts &&
+        !si->decrypt_pool && !si->decrypt_pool_failed) {
+        ret = avpriv_slicethread_create(&si->decrypt_pool, s, decrypt_worker,
+                                        NULL, s->decrypt_threads);
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "Could not start the decryption threads, "
+                   "decrypting on the demuxing thread\n");
+            si->decrypt_pool_failed = 1;
+        }
+    }
+
+    if (nb_pkts > 1 && si->decrypt_pool && pkts == si->decrypt_pkts) {
+        si->decrypt_handle_packet = cbs.handle_packet;
+        avpriv_slicethread_execute(si->decrypt_pool, nb_pkts, 0);
+        return 0;
+    }
+
+    for (int i = 0; i < nb_pkts; i++)
+        if (cbs.handle_packet(s, pkts[i]) < 0)
+            pkts[i]->flags |= AV_PKT_FLAG_CORRUPT;
+    return 0;
+}
+
+static int decryption_active(void)
+{
+    int active;
+
+    ff_lock_avformat();
+    active = decryption_callbacks.handle_packet || decryption_callbacks.handle_packets;
+    ff_unlock_avformat();
+    return active;
+}
+
+static int read_packet_raw(AVFormatContext *s, AVPacket *pkt)
+{
+    int err, tag;
+
+    tag = avpriv_mem_tag_push(AV_MEM_TAG_FORMAT);
+    err = s->iformat->read_packet(s, pkt);
+    avpriv_mem_tag_pop(tag);
+    if (err >= 0 && (err = av_packet_make_refcounted(pkt)) < 0)
+        av_packet_unref(pkt);
+    return err;
+}
+
+/**
+ * Read a packet from the demuxer and decrypt it. With decrypt_batch > 1,
+ * that many packets are read ahead and decrypted together; the error that
+ * stopped the read-ahead is returned after the queued packets.
+ */
+static int read_packet_decrypted(AVFormatContext *s, AVPacket *pkt)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    int err, nb_pkts = 0;
+
+    if (!si->decrypt_queue.head && !si->decrypt_err &&
+        s->decrypt_batch > 1 && decryption_active()) {
+        if (si->nb_decrypt_pkts < s->decrypt_batch) {
+            AVPacket **pkts = av_realloc_array(si->decrypt_pkts, s->decrypt_batch,
+                                               sizeof(*pkts));
+            if (!pkts)
+                return AVERROR(ENOMEM);
+            si->decrypt_pkts = pkts;
+            for (; si->nb_decrypt_pkts < s->decrypt_batch; si->nb_decrypt_pkts++)
+                if (!(pkts[si->nb_decrypt_pkts] = av_packet_alloc()))
+                    return AVERROR(ENOMEM);
+        }
+
+        while (nb_pkts < s->decrypt_batch) {
+            err = read_packet_raw(s, si->decrypt_pkts[nb_pkts]);
+            if (err == FFERROR_REDO)
+                continue;
+            if (err < 0) {
+                av_packet_unref(si->decrypt_pkts[nb_pkts]);
+                si->decrypt_err = err;
+                break;
+            }
+            nb_pkts++;
+        }
+
+        err = decrypt_packets(s, si->decrypt_pkts, nb_pkts);
+        for (int i = 0; i < nb_pkts; i++) {
+            if (err >= 0)
+                err = avpriv_packet_list_put(&si->decrypt_queue,
+                                             si->decrypt_pkts[i], NULL, 0);
+            av_packet_unref(si->decrypt_pkts[i]);
+        }
+        if (err < 0)
+            return err;
+    }
+
+    if (si->decrypt_queue.head)
+        return avpriv_packet_list_get(&si->decrypt_queue, pkt);
+    if (si->decrypt_err) {
+        err = si->decrypt_err;
+        si->decrypt_err = 0;
+        return err;
+    }
+
+    err = read_packet_raw(s, pkt);
+    if (err >= 0 && (err = decrypt_packets(s, &pkt, 1)) < 0)
+        av_packet_unref(pkt);
+    return err;
+}
+//PLEX
+
 int ff_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     FFFormatContext *const si = ffformatcontext(s);
@@ -584,7 +750,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             }
         }
 
-        err = s->iformat->read_packet(s, pkt);
+        err = read_packet_decrypted(s, pkt); //PLEX
         if (err < 0) {
             av_packet_unref(pkt);
 
@@ -1238,6 +1404,8 @@ static int parse_packet(AVFormatContext *s, AVPacket *pkt,
 //PLEX
         if (pkt->flags & AV_PKT_FLAG_DISCARD)
             out_pkt->flags |= AV_PKT_FLAG_DISCARD;
+        if (sti->parser->disposable)
+            out_pkt->flags |= AV_PKT_FLAG_DISPOSABLE;
 //PLEX
 
         compute_pkt_fields(s, st, sti->parser, out_pkt, next_dts, next_pts);
@@ -1483,6 +1651,12 @@ int av_read_frame(AVFormatContext *s, AVPacket *pkt)
     int ret;
     AVStream *st;
 
+    //PLEX
+    /* the caller has set the discard flags by now */
+    if (si->lazy_pics_pending && (ret = ff_read_lazy_attached_pics(s, 1)) < 0)
+        return ret;
+    //PLEX
+
     if (!genpts) {
         ret = si->packet_buffer.head
               ? avpriv_packet_list_get(&si->packet_buffer, pkt)
@@ -1567,6 +1741,7 @@ return_packet:
     if (is_relative(pkt->pts))
         pkt->pts -= RELATIVE_TS_BASE;
 
+    FF_TRACE4(demux_packet, s->iformat->name, pkt->stream_index, pkt->size, pkt->pts); //PLEX
     return ret;
 }
 
@@ -1757,17 +1932,132 @@ static void estimate_timings_from_bit_rate(AVFormatContext *ic)
 }
 
 #define DURATION_MAX_READ_SIZE 250000LL
-#define DURATION_MAX_RETRY 6
+//PLEX
+#define DURATION_MAX_RETRY 3    ///< growing tail windows, up to the last 2 MB
+#define DURATION_MAX_BISECT 12  ///< bisection steps for streams ending early
+//PLEX
+
+/**
+ * Read packets from offset on, up to max_size bytes, and raise the stream
+ * durations to the timestamps seen.
+ */
+static void duration_read_window(AVFormatContext *ic, int64_t offset,
+                                 int64_t max_size, int *found_duration)
+{
+    AVPacket *const pkt = ffformatcontext(ic)->pkt;
+    int64_t read_size = 0, duration;
+    int num, den, ret;
+
+    avio_seek(ic->pb, offset, SEEK_SET);
+    for (;;) {
+        AVStream *st;
+        FFStream *sti;
+        if (read_size >= max_size)
+            break;
+
+        do {
+            ret = ff_read_packet(ic, pkt);
+        } while (ret == AVERROR(EAGAIN));
+        if (ret != 0)
+            break;
+        read_size += pkt->size;
+        st         = ic->streams[pkt->stream_index];
+        sti        = ffstream(st);
+        if (pkt->pts != AV_NOPTS_VALUE &&
+            (st->start_time != AV_NOPTS_VALUE ||
+             sti->first_dts != AV_NOPTS_VALUE)) {
+            if (pkt->duration == 0) {
+                compute_frame_duration(ic, &num, &den, st, sti->parser, pkt);
+                if (den && num) {
+                    pkt->duration = av_rescale_rnd(1,
+                                       num * (int64_t) st->time_base.den,
+                                       den * (int64_t) st->time_base.num,
+                                       AV_ROUND_DOWN);
+                }
+            }
+            duration = pkt->pts + pkt->duration;
+            *found_duration = 1;
+            if (st->start_time != AV_NOPTS_VALUE)
+                duration -= st->start_time;
+            else
+                duration -= sti->first_dts;
+            if (duration > 0) {
+                if (st->duration == AV_NOPTS_VALUE || sti->info->last_duration<= 0 ||
+                    (st->duration < duration && FFABS(duration - sti->info->last_duration) < 60LL*st->time_base.den / st->time_base.num))
+                    st->duration = duration;
+                sti->info->last_duration = duration;
+            }
+        }
+        av_packet_unref(pkt);
+    }
+}
+
+//PLEX
+/**
+ * Bisect [0, end) for the last position holding timestamps of the audio and
+ * video streams the tail windows left without a duration, e.g. a track that
+ * stops long before the end of a recording. The number of reads is bounded
+ * whatever the file size.
+ */
+static void estimate_duration_bisect(AVFormatContext *ic, int64_t end)
+{
+    const int64_t window = DURATION_MAX_READ_SIZE << 1;
+    int64_t *prev, lo = 0, hi = end;
+    int found_duration = 0, nb_pending = 0;
+
+    prev = av_calloc(ic->nb_streams, sizeof(*prev));
+    if (!prev)
+        return;
+
+    for (unsigned i = 0; i < ic->nb_streams; i++) {
+        const AVStream *const st  = ic->streams[i];
+        const FFStream *const sti = cffstream(st);
+        enum AVMediaType type = st->codecpar->codec_type;
+
+        prev[i] = -1;
+        if ((type == AVMEDIA_TYPE_VIDEO || type == AVMEDIA_TYPE_AUDIO) &&
+            st->duration == AV_NOPTS_VALUE &&
+            (st->start_time != AV_NOPTS_VALUE || sti->first_dts != AV_NOPTS_VALUE)) {
+            prev[i] = AV_NOPTS_VALUE;
+            nb_pending++;
+        }
+    }
+
+    for (int step = 0; nb_pending && hi - lo > window && step < DURATION_MAX_BISECT; step++) {
+        int64_t mid = lo + (hi - lo) / 2;
+        int found = 0;
+
+        /* let the window override what an earlier one found */
+        for (unsigned i = 0; i < ic->nb_streams; i++)
+            if (prev[i] != -1)
+                ffstream(ic->streams[i])->info->last_duration = 0;
+
+        ff_flush_packet_queue(ic);
+        duration_read_window(ic, mid, window, &found_duration);
+
+        for (unsigned i = 0; i < ic->nb_streams; i++) {
+            if (prev[i] != -1 && ic->streams[i]->duration != prev[i]) {
+                prev[i] = ic->streams[i]->duration;
+                found = 1;
+            }
+        }
+        if (found)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    av_log(ic, AV_LOG_DEBUG, "duration bisection ended at offset %"PRId64"\n", lo);
+    av_free(prev);
+}
+//PLEX
 
 /* only usable for MPEG-PS streams */
 static void estimate_timings_from_pts(AVFormatContext *ic, int64_t old_offset)
 {
-    FFFormatContext *const si = ffformatcontext(ic);
-    AVPacket *const pkt = si->pkt;
-    int num, den, read_size, ret;
     int found_duration = 0;
     int is_end;
-    int64_t filesize, offset, duration;
+    int64_t filesize, offset; //PLEX
     int retry = 0;
 
     /* flush packet queue */
@@ -1804,49 +2094,8 @@ static void estimate_timings_from_pts(AVFormatContext *ic, int64_t old_offset)
         if (offset < 0)
             offset = 0;
 
-        avio_seek(ic->pb, offset, SEEK_SET);
-        read_size = 0;
-        for (;;) {
-            AVStream *st;
-            FFStream *sti;
-            if (read_size >= DURATION_MAX_READ_SIZE << (FFMAX(retry - 1, 0)))
-                break;
-
-            do {
-                ret = ff_read_packet(ic, pkt);
-            } while (ret == AVERROR(EAGAIN));
-            if (ret != 0)
-                break;
-            read_size += pkt->size;
-            st         = ic->streams[pkt->stream_index];
-            sti        = ffstream(st);
-            if (pkt->pts != AV_NOPTS_VALUE &&
-                (st->start_time != AV_NOPTS_VALUE ||
-                 sti->first_dts != AV_NOPTS_VALUE)) {
-                if (pkt->duration == 0) {
-                    compute_frame_duration(ic, &num, &den, st, sti->parser, pkt);
-                    if (den && num) {
-                        pkt->duration = av_rescale_rnd(1,
-                                           num * (int64_t) st->time_base.den,
-                                           den * (int64_t) st->time_base.num,
-                                           AV_ROUND_DOWN);
-                    }
-                }
-                duration = pkt->pts + pkt->duration;
-                found_duration = 1;
-                if (st->start_time != AV_NOPTS_VALUE)
-                    duration -= st->start_time;
-                else
-                    duration -= sti->first_dts;
-                if (duration > 0) {
-                    if (st->duration == AV_NOPTS_VALUE || sti->info->last_duration<= 0 ||
-                        (st->duration < duration && FFABS(duration - sti->info->last_duration) < 60LL*st->time_base.den / st->time_base.num))
-                        st->duration = duration;
-                    sti->info->last_duration = duration;
-                }
-            }
-            av_packet_unref(pkt);
-        }
+        duration_read_window(ic, offset, DURATION_MAX_READ_SIZE << (FFMAX(retry - 1, 0)), //PLEX
+                             &found_duration);
 
         /* check if all audio/video streams have valid duration */
         if (!is_end) {
@@ -1865,6 +2114,11 @@ static void estimate_timings_from_pts(AVFormatContext *ic, int64_t old_offset)
              offset &&
              ++retry <= DURATION_MAX_RETRY);
 
+    //PLEX
+    if (offset)
+        estimate_duration_bisect(ic, offset);
+    //PLEX
+
     av_opt_set_int(ic, "skip_changes", 0, AV_OPT_SEARCH_CHILDREN);
 
     /* warn about audio/video streams which duration could not be estimated */
@@ -2021,6 +2275,45 @@ static int has_codec_parameters(const AVStream *st, const char **errmsg_ptr)
     return 1;
 }
 
+//PLEX
+/* fill in what the parser extracted from the extradata and packet headers */
+static void trust_parser_params(AVStream *st)
+{
+    FFStream *const sti = ffstream(st);
+    AVCodecContext *const avctx = sti->avctx;
+    const AVCodecParserContext *const pc = sti->parser;
+
+    if (!pc || avctx->codec_type != AVMEDIA_TYPE_VIDEO)
+        return;
+
+    if (avctx->pix_fmt == AV_PIX_FMT_NONE && pc->format >= 0)
+        avctx->pix_fmt = pc->format;
+    if (avctx->field_order == AV_FIELD_UNKNOWN)
+        avctx->field_order = pc->field_order;
+    if (!avctx->width && pc->width > 0) {
+        avctx->width  = pc->width;
+        avctx->height = pc->height;
+    }
+    if (!avctx->coded_width && pc->coded_width > 0) {
+        avctx->coded_width  = pc->coded_width;
+        avctx->coded_height = pc->coded_height;
+    }
+}
+
+/* whether decoding can be skipped because nothing is missing */
+static int trusted_params_complete(AVStream *st)
+{
+    FFStream *const sti = ffstream(st);
+
+    if (!has_codec_parameters(st, NULL))
+        return 0;
+
+    /* Without container-supplied DTS, only decoding tells the H.264 reorder
+     * delay needed to derive them. */
+    return has_decode_delay_been_guessed(st) || sti->info->frame_delay_evidence;
+}
+//PLEX
+
 /* returns 1 or 0 if or if not decoded data was returned, or a negative error */
 static int try_decode_frame(AVFormatContext *s, AVStream *st,
                             const AVPacket *pkt, AVDictionary **options)
@@ -2476,6 +2769,24 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int has_non_empty_subtitles = 0;
     int can_bail_noheader = 0;
 
+    //PLEX
+    if (ic->probe_cache) {
+        ret = ff_probe_cache_restore(ic);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            for (unsigned i = 0; i < ic->nb_streams; i++) {
+                FFStream *const sti = ffstream(ic->streams[i]);
+                if (sti->info) {
+                    av_freep(&sti->info->duration_error);
+                    av_freep(&sti->info);
+                }
+            }
+            return 0;
+        }
+    }
+    //PLEX
+
     si->packet_buffer_last = si->packet_buffer;
     si->packet_buffer = (PacketList){ NULL };
     //PLEX
@@ -2550,7 +2861,11 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 
         // Try to just open decoders, in case this is enough to get parameters.
         // Also ensure that subtitle_header is properly set.
-        if (!has_codec_parameters(st, NULL) && sti->request_probe <= 0 ||
+        // PLEX: with trusted headers, video decoders are opened later, only
+        // if the parser cannot provide the parameters.
+        if (!has_codec_parameters(st, NULL) && sti->request_probe <= 0 &&
+            !((ic->flags & AVFMT_FLAG_TRUST_HEADERS) && sti->parser &&
+              st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) ||
             st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE) {
             if (codec && !avctx->codec)
                 if (avcodec_open2(avctx, codec, options ? &options[i] : &thread_opt) < 0)
@@ -2583,6 +2898,9 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             int count;
 
 //PLEX
+            /* left for later by lazy_attached_pics */
+            if (sti->lazy_pic_size)
+                continue;
             if (sti->codec_info_nb_frames == 0 &&
                 st->codecpar->codec_type != AVMEDIA_TYPE_SUBTITLE &&
                 (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO || has_non_empty_video) &&
@@ -2824,6 +3142,11 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
+        //PLEX
+        if (ic->flags & AVFMT_FLAG_TRUST_HEADERS)
+            trust_parser_params(st);
+        if (!(ic->flags & AVFMT_FLAG_TRUST_HEADERS) || !trusted_params_complete(st))
+        //PLEX
         try_decode_frame(ic, st, pkt,
                          (options && i < orig_nb_streams) ? &options[i] : NULL);
 
@@ -3002,7 +3325,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             if (ret < 0)
                 goto find_stream_info_err;
         }
-        if (!has_codec_parameters(st, &errmsg)) {
+        if (!has_codec_parameters(st, &errmsg) && !sti->lazy_pic_size) { //PLEX
             char buf[256];
             avcodec_string(buf, sizeof(buf), sti->avctx, 0);
             av_log(ic, AV_LOG_WARNING,
@@ -3078,6 +3401,11 @@ FF_ENABLE_DEPRECATION_WARNINGS
 #endif
     }
 
+    //PLEX
+    if (ic->probe_cache)
+        ff_probe_cache_store(ic);
+    //PLEX
+
 find_stream_info_err:
     for (unsigned i = 0; i < ic->nb_streams; i++) {
         AVStream *const st  = ic->streams[i];
@@ -209,6 +209,45 @@ AVChapter *avpriv_new_chapter(AVFormatContext *s, int64_t id, AVRational time_ba
 int ff_add_attached_pic(AVFormatContext *s, AVStream *st, AVIOContext *pb,
                         AVBufferRef **buf, int size);
 
+//PLEX
+/**
+ * Check whether an attached picture of the given size at the current
+ * position of pb can be left unread until it is needed, see
+ * AVFormatContext.lazy_attached_pics.
+ */
+int ff_attached_pic_can_defer(AVFormatContext *s, AVIOContext *pb, int size);
+
+/**
+ * Same as ff_add_attached_pic(), but only record the position and size of
+ * the picture in s->pb, to read it when it is needed.
+ *
+ * @param head      first bytes of the picture, may be NULL
+ * @param head_size number of bytes in head
+ */
+int ff_add_lazy_attached_pic(AVFormatContext *s, AVStream *st, int64_t pos,
+                             int size, const uint8_t *head, int head_size);
+
+/**
+ * Return the first 8 bytes of the attached picture of st, whether it was
+ * read yet or not, or NULL if they are not known.
+ */
+const uint8_t *ff_attached_pic_head(const AVStream *st);
+
+/**
+ * Read the attached pictures left unread of the streams which are not
+ * discarded.
+ *
+ * @param queue also queue them to be returned by av_read_frame()
+ */
+int ff_read_lazy_attached_pics(AVFormatContext *s, int queue);
+
+/**
+ * Queue the attached pictures which were read for the streams which are
+ * not discarded, without reading those left unread.
+ */
+int ff_queue_attached_pictures(AVFormatContext *s);
+//PLEX
+
 /**
  * Add side data to a packet for changing parameters to the given values.
  * Parameters set to 0 aren't included in the change.
@@ -217,6 +256,18 @@ int ff_add_param_change(AVPacket *pkt, int32_t channels,
                         uint64_t channel_layout, int32_t sample_rate,
                         int32_t width, int32_t height);
 
+//PLEX
+/**
+ * Record that the payload of pkt was read verbatim from offset in the file
+ * behind pb, if the caller asked for source ranges and pb is a local file.
+ * Streams that are parsed are skipped, as parsers repacketize the data.
+ *
+ * @return 0 on success or if not applicable, < 0 on error
+ */
+int ff_add_source_range(AVFormatContext *s, AVStream *st, AVPacket *pkt,
+                        AVIOContext *pb, int64_t offset);
+//PLEX
+
 /**
  * Generate standard extradata for AVC-Intra based on width/height and field
  * order.
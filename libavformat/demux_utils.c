@@ -19,6 +19,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h" //PLEX
 #include "libavutil/version.h"
 
 #include "libavutil/avassert.h"
@@ -28,6 +29,10 @@
 #include "avio_internal.h"
 #include "demux.h"
 #include "internal.h"
+#include "url.h" //PLEX
+#if HAVE_UNISTD_H //PLEX
+#include <unistd.h>
+#endif
 
 struct AVCodecParserContext *av_stream_get_parser(const AVStream *st)
 {
@@ -90,13 +95,15 @@ void av_format_inject_global_side_data(AVFormatContext *s)
     }
 }
 
-int avformat_queue_attached_pictures(AVFormatContext *s)
+int ff_queue_attached_pictures(AVFormatContext *s) //PLEX
 {
     FFFormatContext *const si = ffformatcontext(s);
     int ret;
     for (unsigned i = 0; i < s->nb_streams; i++)
         if (s->streams[i]->disposition & AV_DISPOSITION_ATTACHED_PIC &&
             s->streams[i]->discard < AVDISCARD_ALL) {
+            if (ffstream(s->streams[i])->lazy_pic_size) //PLEX
+                continue;
             if (s->streams[i]->attached_pic.size <= 0) {
                 av_log(s, AV_LOG_WARNING,
                        "Attached picture on stream %d has invalid size, "
@@ -113,6 +120,89 @@ int avformat_queue_attached_pictures(AVFormatContext *s)
     return 0;
 }
 
+//PLEX
+int avformat_queue_attached_pictures(AVFormatContext *s)
+{
+    int ret = ff_read_lazy_attached_pics(s, 0);
+    if (ret < 0)
+        return ret;
+    return ff_queue_attached_pictures(s);
+}
+
+int ff_attached_pic_can_defer(AVFormatContext *s, AVIOContext *pb, int size)
+{
+    return s->lazy_attached_pics && pb && pb == s->pb && size > 0 &&
+           (pb->seekable & AVIO_SEEKABLE_NORMAL);
+}
+
+int ff_add_lazy_attached_pic(AVFormatContext *s, AVStream *st0, int64_t pos,
+                             int size, const uint8_t *head, int head_size)
+{
+    AVStream *st = st0;
+    FFStream *sti;
+
+    if (!st && !(st = avformat_new_stream(s, NULL)))
+        return AVERROR(ENOMEM);
+    sti = ffstream(st);
+    av_packet_unref(&st->attached_pic);
+    sti->lazy_pic_pos  = pos;
+    sti->lazy_pic_size = size;
+    memset(sti->lazy_pic_head, 0, sizeof(sti->lazy_pic_head));
+    if (head)
+        memcpy(sti->lazy_pic_head, head, FFMIN(head_size, sizeof(sti->lazy_pic_head)));
+    ffformatcontext(s)->lazy_pics_pending = 1;
+
+    st->disposition         |= AV_DISPOSITION_ATTACHED_PIC;
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    return 0;
+}
+
+const uint8_t *ff_attached_pic_head(const AVStream *st)
+{
+    const FFStream *sti = cffstream(st);
+
+    if (st->attached_pic.size >= 8)
+        return st->attached_pic.data;
+    if (sti->lazy_pic_size >= 8)
+        return sti->lazy_pic_head;
+    return NULL;
+}
+
+int ff_read_lazy_attached_pics(AVFormatContext *s, int queue)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    int64_t pos = -1;
+    int ret = 0;
+
+    si->lazy_pics_pending = 0;
+    for (unsigned i = 0; i < s->nb_streams && ret >= 0; i++) {
+        AVStream *st = s->streams[i];
+        FFStream *sti = ffstream(st);
+
+        if (!sti->lazy_pic_size || st->discard >= AVDISCARD_ALL)
+            continue;
+        if (pos < 0)
+            pos = avio_tell(s->pb);
+        if (avio_seek(s->pb, sti->lazy_pic_pos, SEEK_SET) < 0 ||
+            av_get_packet(s->pb, &st->attached_pic, sti->lazy_pic_size) <= 0) {
+            av_log(s, AV_LOG_WARNING, "Could not read the attached picture "
+                   "of stream %u\n", i);
+            av_packet_unref(&st->attached_pic);
+        } else {
+            st->attached_pic.stream_index = i;
+            st->attached_pic.flags       |= AV_PKT_FLAG_KEY;
+            if (queue)
+                ret = avpriv_packet_list_put(&si->raw_packet_buffer,
+                                             &st->attached_pic, av_packet_ref, 0);
+        }
+        sti->lazy_pic_size = 0;
+    }
+    if (pos >= 0 && avio_seek(s->pb, pos, SEEK_SET) < 0 && ret >= 0)
+        ret = AVERROR(EIO);
+    return ret;
+}
+//PLEX
+
 int ff_add_attached_pic(AVFormatContext *s, AVStream *st0, AVIOContext *pb,
                         AVBufferRef **buf, int size)
 {
@@ -130,6 +220,18 @@ int ff_add_attached_pic(AVFormatContext *s, AVStream *st0, AVIOContext *pb,
         pkt->data = (*buf)->data;
         pkt->size = (*buf)->size - AV_INPUT_BUFFER_PADDING_SIZE;
         *buf = NULL;
+    //PLEX
+    } else if (ff_attached_pic_can_defer(s, pb, size)) {
+        uint8_t head[8];
+        int64_t pos = avio_tell(pb);
+        int head_size = FFMIN(size, sizeof(head));
+
+        if ((ret = ffio_read_size(pb, head, head_size)) < 0 ||
+            (ret = avio_skip(pb, size - head_size)) < 0 ||
+            (ret = ff_add_lazy_attached_pic(s, st, pos, size, head, head_size)) < 0)
+            goto fail;
+        return 0;
+    //PLEX
     } else {
         ret = av_get_packet(pb, pkt, size);
         if (ret < 0)
@@ -148,6 +250,71 @@ fail:
     return ret;
 }
 
+//PLEX
+#if HAVE_UNISTD_H
+static void source_file_close(void *opaque, uint8_t *data)
+{
+    close(*(int *)data);
+    av_free(data);
+}
+
+/* A reference to a duplicate of the file descriptor behind pb, so that
+ * packets and muxers can keep using it after the input is closed. */
+static int get_source_file(AVFormatContext *s, AVIOContext *pb, int fd)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    int *dup_fd;
+
+    if (si->source_file && si->source_file_pb == pb)
+        return 0;
+    av_buffer_unref(&si->source_file);
+    si->source_file_pb = NULL;
+
+    if (!(dup_fd = av_malloc(sizeof(*dup_fd))))
+        return AVERROR(ENOMEM);
+    if ((*dup_fd = dup(fd)) < 0) {
+        int ret = AVERROR(errno);
+        av_free(dup_fd);
+        return ret;
+    }
+    si->source_file = av_buffer_create((uint8_t *)dup_fd, sizeof(*dup_fd),
+                                       source_file_close, NULL, AV_BUFFER_FLAG_READONLY);
+    if (!si->source_file) {
+        source_file_close(NULL, (uint8_t *)dup_fd);
+        return AVERROR(ENOMEM);
+    }
+    si->source_file_pb = pb;
+    return 0;
+}
+#endif
+
+int ff_add_source_range(AVFormatContext *s, AVStream *st, AVPacket *pkt,
+                        AVIOContext *pb, int64_t offset)
+{
+#if HAVE_UNISTD_H
+    AVPacketSourceRange *range;
+    URLContext *h;
+    int fd, ret;
+
+    if (!(s->flags & AVFMT_FLAG_SOURCE_RANGES) || ffstream(st)->need_parsing ||
+        pkt->size <= 0 || !pb || !(h = ffio_geturlcontext(pb)) ||
+        strcmp(h->prot->name, "file") || (fd = ffurl_get_file_handle(h)) < 0)
+        return 0;
+
+    if ((ret = get_source_file(s, pb, fd)) < 0)
+        return ret;
+    range = (AVPacketSourceRange *)av_packet_new_side_data(pkt, AV_PKT_DATA_SOURCE_RANGE,
+                                                           sizeof(*range));
+    if (!range)
+        return AVERROR(ENOMEM);
+    if (!(range->file = av_buffer_ref(ffformatcontext(s)->source_file)))
+        return AVERROR(ENOMEM);
+    range->offset = offset;
+#endif
+    return 0;
+}
+//PLEX
+
 int ff_add_param_change(AVPacket *pkt, int32_t channels,
                         uint64_t channel_layout, int32_t sample_rate,
                         int32_t width, int32_t height)
@@ -19,8 +19,18 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h" //PLEX
 #include "config_components.h"
 
+//PLEX
+#if HAVE_LINUX_IO_URING_H
+/* needed by O_DIRECT, MAP_POPULATE and syscall() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+//PLEX
+
 #include "libavutil/avstring.h"
 #include "libavutil/file_open.h"
 #include "libavutil/internal.h"
@@ -38,6 +48,26 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+//PLEX
+#if HAVE_LINUX_IO_URING_H
+#include <stdatomic.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+//PLEX
+#if HAVE_SYS_INOTIFY_H
+#include <poll.h>
+#include <sys/inotify.h>
+#elif defined(_WIN32) && HAVE_WINDOWS_H
+#include <windows.h>
+#include "libavutil/wchar_filename.h"
+#endif
+//PLEX
+#if HAVE_WRITEV
+#include <sys/uio.h>
+#endif
+//PLEX
 #include "os_support.h"
 #include "url.h"
 
@@ -88,6 +118,32 @@
 
 /* standard file protocol */
 
+//PLEX
+#if HAVE_LINUX_IO_URING_H
+#define URING_ALIGN 4096
+
+/* Submission and completion queues shared with the kernel. */
+typedef struct FileRing {
+    int fd;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+} FileRing;
+
+typedef struct FileUringBuf {
+    uint8_t *raw, *data;    /* data is aligned for O_DIRECT */
+    struct iovec iov;
+    int64_t pos;
+    int len;                /* bytes transferred once completed */
+    int busy;
+    int ret;
+} FileUringBuf;
+#endif
+//PLEX
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
@@ -98,13 +154,45 @@ typedef struct FileContext {
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+    //PLEX
+    int io_uring;
+    int uring_depth;
+    int uring_block_size;
+    int direct;
+#if HAVE_LINUX_IO_URING_H
+    int uring_active;
+    FileRing ring;
+    FileUringBuf *bufs;
+    int head;               /* read: buffer holding pos, write: oldest buffer */
+    int window;             /* read: the buffers are queued */
+    int64_t pos;
+    int write_error;
+#endif
+    int follow_close;
+    int writer_closed;      /* follow: the writer closed the file */
+    int notify_active;      /* follow: change notifications are set up */
+#if HAVE_SYS_INOTIFY_H
+    int notify_fd;
+#elif defined(_WIN32) && HAVE_WINDOWS_H
+    HANDLE notify;
+#endif
+    //PLEX
 } FileContext;
 
+#define URING_BLOCK_MIN 4096 //PLEX
+
 static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    //PLEX
+    { "follow_close", "stop following once the writer closes the file", offsetof(FileContext, follow_close), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "io_uring", "use io_uring for reads and writes when available", offsetof(FileContext, io_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "uring_depth", "number of io_uring operations kept in flight", offsetof(FileContext, uring_depth), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "uring_block_size", "size of each io_uring read or write", offsetof(FileContext, uring_block_size), AV_OPT_TYPE_INT, { .i64 = 262144 }, URING_BLOCK_MIN, 64 << 20, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "direct", "bypass the page cache for io_uring reads (O_DIRECT)", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    //PLEX
     { NULL }
 };
 
@@ -135,14 +223,463 @@ static const AVClass fd_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+//PLEX
+#if HAVE_LINUX_IO_URING_H
+static int ring_enter(FileRing *r, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    int ret;
+
+    do {
+        ret = syscall(__NR_io_uring_enter, r->fd, to_submit, min_complete, flags, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret < 0 ? AVERROR(errno) : ret;
+}
+
+static void ring_free(FileRing *r)
+{
+    if (r->sqes)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring && r->cq_ring != r->sq_ring)
+        munmap(r->cq_ring, r->cq_ring_size);
+    if (r->sq_ring)
+        munmap(r->sq_ring, r->sq_ring_size);
+    if (r->fd >= 0)
+        close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+static void *ring_mmap(FileRing *r, size_t size, off_t offset)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static int ring_setup(FileRing *r, unsigned entries)
+{
+    struct io_uring_params p = { 0 };
+    uint8_t *sq, *cq;
+    int ret;
+
+    memset(r, 0, sizeof(*r));
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0)
+        return AVERROR(errno);
+
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r->sq_ring_size = r->cq_ring_size = FFMAX(r->sq_ring_size, r->cq_ring_size);
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (!(r->sq_ring = ring_mmap(r, r->sq_ring_size, IORING_OFF_SQ_RING)))
+        goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r->cq_ring = r->sq_ring;
+    else if (!(r->cq_ring = ring_mmap(r, r->cq_ring_size, IORING_OFF_CQ_RING)))
+        goto fail;
+    if (!(r->sqes = ring_mmap(r, r->sqes_size, IORING_OFF_SQES)))
+        goto fail;
+
+    sq = r->sq_ring;
+    cq = r->cq_ring;
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    ret = AVERROR(errno);
+    ring_free(r);
+    return ret;
+}
+
+/* At most uring_depth operations are in flight, so the queues never fill. */
+static int ring_submit(FileRing *r, int opcode, int fd, const struct iovec *iov,
+                       int64_t offset, uint64_t user_data)
+{
+    unsigned tail = *r->sq_tail, index = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[index];
+    int ret;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = opcode;
+    sqe->fd        = fd;
+    sqe->addr      = (uintptr_t)iov;
+    sqe->len       = 1;
+    sqe->off       = offset;
+    sqe->user_data = user_data;
+    r->sq_array[index] = index;
+    atomic_store_explicit((_Atomic unsigned *)r->sq_tail, tail + 1, memory_order_release);
+
+    ret = ring_enter(r, 1, 0, 0);
+    return ret < 0 ? ret : 0;
+}
+
+static int ring_reap(FileRing *r, uint64_t *user_data, int *res)
+{
+    for (;;) {
+        unsigned head = *r->cq_head;
+        int ret;
+
+        if (head != atomic_load_explicit((_Atomic unsigned *)r->cq_tail, memory_order_acquire)) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            *user_data = cqe->user_data;
+            *res       = cqe->res;
+            atomic_store_explicit((_Atomic unsigned *)r->cq_head, head + 1, memory_order_release);
+            return 0;
+        }
+        if ((ret = ring_enter(r, 0, 1, IORING_ENTER_GETEVENTS)) < 0)
+            return ret;
+    }
+}
+
+/* Wait for the next completion and account it to its buffer. */
+static int uring_complete(FileContext *c, int write)
+{
+    FileUringBuf *b;
+    uint64_t index;
+    int res, ret;
+
+    if ((ret = ring_reap(&c->ring, &index, &res)) < 0)
+        return ret;
+    b = &c->bufs[index];
+    b->busy = 0;
+    if (res < 0) {
+        b->ret = AVERROR(-res);
+        if (write && !c->write_error)
+            c->write_error = b->ret;
+        return 0;
+    }
+    b->len = res;
+
+    /* complete short writes synchronously */
+    while (write && b->len < b->iov.iov_len) {
+        ssize_t n = pwrite(c->fd, b->data + b->len, b->iov.iov_len - b->len, b->pos + b->len);
+        if (n <= 0) {
+            if (!c->write_error)
+                c->write_error = n < 0 ? AVERROR(errno) : AVERROR(EIO);
+            break;
+        }
+        b->len += n;
+    }
+    return 0;
+}
+
+static int uring_wait(FileContext *c, FileUringBuf *b, int write)
+{
+    while (b->busy) {
+        int ret = uring_complete(c, write);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int uring_drain(FileContext *c, int write)
+{
+    int ret = 0;
+
+    for (int i = 0; i < c->uring_depth; i++) {
+        int err = uring_wait(c, &c->bufs[i], write);
+        if (err < 0)
+            ret = err;
+    }
+    c->window = 0;
+    return ret;
+}
+
+static int uring_submit(FileContext *c, FileUringBuf *b, int write, int64_t pos, int size)
+{
+    int ret;
+
+    b->pos         = pos;
+    b->len         = 0;
+    b->ret         = 0;
+    b->iov.iov_base = b->data;
+    b->iov.iov_len  = size;
+    ret = ring_submit(&c->ring, write ? IORING_OP_WRITEV : IORING_OP_READV, c->fd,
+                      &b->iov, pos, b - c->bufs);
+    if (ret < 0)
+        b->ret = ret;
+    else
+        b->busy = 1;
+    return ret;
+}
+
+/* Reads are queued for consecutive blocks from the one holding pos, and
+ * each block is queued again further ahead once it has been consumed. */
+static int uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    int n = c->uring_depth, bs = c->uring_block_size;
+    FileUringBuf *b;
+    int ret, offset;
+
+    if (c->window && (c->pos < c->bufs[c->head].pos ||
+                      c->pos >= c->bufs[c->head].pos + (int64_t)n * bs))
+        uring_drain(c, 0);
+
+    if (!c->window) {
+        int64_t start = c->pos - c->pos % bs;
+
+        c->head = 0;
+        for (int i = 0; i < n; i++) {
+            if ((ret = uring_submit(c, &c->bufs[i], 0, start + (int64_t)i * bs, bs)) < 0) {
+                uring_drain(c, 0);
+                return ret;
+            }
+        }
+        c->window = 1;
+    }
+
+    while (c->pos >= c->bufs[c->head].pos + bs) {
+        int64_t next = c->bufs[(c->head + n - 1) % n].pos + bs;
+
+        b = &c->bufs[c->head];
+        if ((ret = uring_wait(c, b, 0)) < 0 ||
+            (ret = uring_submit(c, b, 0, next, bs)) < 0) {
+            uring_drain(c, 0);
+            return ret;
+        }
+        c->head = (c->head + 1) % n;
+    }
+
+    b = &c->bufs[c->head];
+    if ((ret = uring_wait(c, b, 0)) < 0 || (ret = b->ret) < 0) {
+        uring_drain(c, 0);
+        return ret;
+    }
+
+    offset = c->pos - b->pos;
+    if (offset >= b->len) {
+        /* queue again on the next read in case the file grows */
+        uring_drain(c, 0);
+        return AVERROR_EOF;
+    }
+    size = FFMIN3(size, b->len - offset, c->blocksize);
+    memcpy(buf, b->data + offset, size);
+    c->pos += size;
+    return size;
+}
+
+/* Writes return as soon as they are queued. Errors are reported by the
+ * following write, seek or close. */
+static int uring_write(URLContext *h, const unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    FileUringBuf *b = &c->bufs[c->head];
+    int ret;
+
+    if ((ret = uring_wait(c, b, 1)) < 0)
+        return ret;
+    if (c->write_error)
+        return c->write_error;
+
+    size = FFMIN3(size, c->uring_block_size, c->blocksize);
+    memcpy(b->data, buf, size);
+    if ((ret = uring_submit(c, b, 1, c->pos, size)) < 0)
+        return ret;
+    c->pos += size;
+    c->head = (c->head + 1) % c->uring_depth;
+    return size;
+}
+
+static int64_t uring_seek(URLContext *h, int64_t pos, int whence)
+{
+    FileContext *c = h->priv_data;
+    int write = h->flags & AVIO_FLAG_WRITE;
+    struct stat st;
+
+    /* writes may complete in any order, so let none overlap a later one */
+    if (write) {
+        uring_drain(c, 1);
+        if (c->write_error)
+            return c->write_error;
+    }
+
+    switch (whence) {
+    case AVSEEK_SIZE:
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        return st.st_size;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += c->pos;
+        break;
+    case SEEK_END:
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        pos += st.st_size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    c->pos = pos;
+    return pos;
+}
+
+static void uring_uninit(FileContext *c)
+{
+    if (c->bufs) {
+        for (int i = 0; i < c->uring_depth; i++)
+            av_free(c->bufs[i].raw);
+        av_freep(&c->bufs);
+    }
+    ring_free(&c->ring);
+    c->uring_active = 0;
+}
+
+static int uring_init(URLContext *h, const char *filename, int flags)
+{
+    FileContext *c = h->priv_data;
+    int ret;
+
+    if ((ret = ring_setup(&c->ring, c->uring_depth)) < 0)
+        return ret;
+
+    c->uring_block_size = FFALIGN(c->uring_block_size, URING_ALIGN);
+    c->bufs = av_calloc(c->uring_depth, sizeof(*c->bufs));
+    if (!c->bufs) {
+        uring_uninit(c);
+        return AVERROR(ENOMEM);
+    }
+    for (int i = 0; i < c->uring_depth; i++) {
+        FileUringBuf *b = &c->bufs[i];
+        if (!(b->raw = av_malloc(c->uring_block_size + URING_ALIGN))) {
+            uring_uninit(c);
+            return AVERROR(ENOMEM);
+        }
+        b->data = (uint8_t *)FFALIGN((uintptr_t)b->raw, URING_ALIGN);
+    }
+
+#ifdef O_DIRECT
+    if (c->direct && !(flags & AVIO_FLAG_WRITE)) {
+        int fd = avpriv_open(filename, O_RDONLY | O_DIRECT);
+        if (fd >= 0) {
+            close(c->fd);
+            c->fd = fd;
+        } else {
+            av_log(h, AV_LOG_WARNING, "Cannot open %s with O_DIRECT: %s\n",
+                   filename, av_err2str(AVERROR(errno)));
+        }
+    }
+#endif
+
+    c->pos = lseek(c->fd, 0, SEEK_CUR);
+    if (c->pos < 0)
+        c->pos = 0;
+    c->uring_active = 1;
+    return 0;
+}
+#endif
+//PLEX
+
+//PLEX
+/* longest wait for the file to grow, so that the interrupt callback of the
+ * caller still gets checked */
+#define FOLLOW_WAIT_MS 100
+
+static void follow_init(URLContext *h, const char *filename)
+{
+    FileContext *c = h->priv_data;
+#if HAVE_SYS_INOTIFY_H
+    c->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (c->notify_fd >= 0) {
+        if (inotify_add_watch(c->notify_fd, filename, IN_MODIFY | IN_CLOSE_WRITE |
+                              IN_DELETE_SELF | IN_MOVE_SELF) >= 0)
+            c->notify_active = 1;
+        else
+            close(c->notify_fd);
+    }
+#elif defined(_WIN32) && HAVE_WINDOWS_H
+    wchar_t *dir_w = NULL;
+    char *dir = av_strdup(filename);
+
+    if (dir && utf8towchar(av_dirname(dir), &dir_w) >= 0 && dir_w) {
+        c->notify = FindFirstChangeNotificationW(dir_w, FALSE,
+                                                 FILE_NOTIFY_CHANGE_SIZE |
+                                                 FILE_NOTIFY_CHANGE_LAST_WRITE);
+        c->notify_active = c->notify != INVALID_HANDLE_VALUE;
+    }
+    av_free(dir_w);
+    av_free(dir);
+#endif
+    if (!c->notify_active)
+        av_log(h, AV_LOG_VERBOSE, "No change notifications, polling the file\n");
+}
+
+static void follow_uninit(FileContext *c)
+{
+    if (!c->notify_active)
+        return;
+#if HAVE_SYS_INOTIFY_H
+    close(c->notify_fd);
+#elif defined(_WIN32) && HAVE_WINDOWS_H
+    FindCloseChangeNotification(c->notify);
+#endif
+    c->notify_active = 0;
+}
+
+/**
+ * Block until the followed file changes or FOLLOW_WAIT_MS elapsed, instead
+ * of the sleep loop the EAGAIN retry falls back to.
+ */
+static void follow_wait(FileContext *c)
+{
+#if HAVE_SYS_INOTIFY_H
+    struct pollfd pfd = { .fd = c->notify_fd, .events = POLLIN };
+    union {
+        struct inotify_event ev;
+        char buf[4096];
+    } events;
+    ssize_t len;
+
+    if (!c->notify_active || poll(&pfd, 1, FOLLOW_WAIT_MS) <= 0)
+        return;
+    while ((len = read(c->notify_fd, events.buf, sizeof(events.buf))) > 0) {
+        for (char *p = events.buf; p < events.buf + len;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->mask & (IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF))
+                c->writer_closed = 1;
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+#elif defined(_WIN32) && HAVE_WINDOWS_H
+    if (c->notify_active &&
+        WaitForSingleObject(c->notify, FOLLOW_WAIT_MS) == WAIT_OBJECT_0)
+        FindNextChangeNotification(c->notify);
+#endif
+}
+//PLEX
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
+#if HAVE_LINUX_IO_URING_H //PLEX
+    if (c->uring_active)
+        return uring_read(h, buf, size);
+#endif
     size = FFMIN(size, c->blocksize);
     ret = read(c->fd, buf, size);
-    if (ret == 0 && c->follow)
+    //PLEX
+    if (ret == 0 && c->follow) {
+        /* a close seen before this empty read means nothing more is coming */
+        if (c->follow_close && c->writer_closed)
+            return AVERROR_EOF;
+        follow_wait(c);
         return AVERROR(EAGAIN);
+    }
+    //PLEX
     if (ret == 0)
         return AVERROR_EOF;
     return (ret == -1) ? AVERROR(errno) : ret;
@@ -152,11 +689,40 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
+#if HAVE_LINUX_IO_URING_H //PLEX
+    if (c->uring_active)
+        return uring_write(h, buf, size);
+#endif
     size = FFMIN(size, c->blocksize);
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
 
+//PLEX
+#if HAVE_WRITEV
+static int file_writev(URLContext *h, const URLWriteVec *vec, int nb_vec)
+{
+    FileContext *c = h->priv_data;
+    struct iovec iov[URL_WRITEV_MAX];
+    int ret;
+
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring_active)
+        return uring_write(h, vec->data, vec->size);
+#endif
+    if (c->blocksize != INT_MAX)
+        return file_write(h, vec->data, vec->size);
+
+    for (int i = 0; i < nb_vec; i++) {
+        iov[i].iov_base = (void *)vec[i].data;
+        iov[i].iov_len  = vec[i].size;
+    }
+    ret = writev(c->fd, iov, nb_vec);
+    return (ret == -1) ? AVERROR(errno) : ret;
+}
+#endif
+//PLEX
+
 static int file_get_handle(URLContext *h)
 {
     FileContext *c = h->priv_data;
@@ -218,8 +784,19 @@ static int fd_dup(URLContext *h, int oldfd)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
-    return (ret == -1) ? AVERROR(errno) : 0;
+    int ret, err = 0;
+#if HAVE_LINUX_IO_URING_H //PLEX
+    if (c->uring_active) {
+        int write = h->flags & AVIO_FLAG_WRITE;
+        uring_drain(c, write);
+        if (write)
+            err = c->write_error;
+        uring_uninit(c);
+    }
+#endif
+    follow_uninit(c); //PLEX
+    ret = close(c->fd);
+    return (ret == -1) ? AVERROR(errno) : err;
 }
 
 /* XXX: use llseek */
@@ -228,6 +805,11 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+#if HAVE_LINUX_IO_URING_H //PLEX
+    if (c->uring_active)
+        return uring_seek(h, pos, whence);
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -315,6 +897,25 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+    //PLEX
+    if (c->follow && !(flags & AVIO_FLAG_WRITE))
+        follow_init(h, filename);
+
+    if (c->io_uring) {
+#if HAVE_LINUX_IO_URING_H
+        int ret = AVERROR(EINVAL);
+        /* only plain reads or writes of regular files */
+        if (!c->follow && !h->is_streamed && !fstat(fd, &st) && S_ISREG(st.st_mode) &&
+            (flags & AVIO_FLAG_READ_WRITE) != AVIO_FLAG_READ_WRITE)
+            ret = uring_init(h, filename, flags);
+        if (ret < 0)
+            av_log(h, AV_LOG_VERBOSE, "Not using io_uring: %s\n", av_err2str(ret));
+#else
+        av_log(h, AV_LOG_VERBOSE, "io_uring is not supported in this build\n");
+#endif
+    }
+    //PLEX
+
     return 0;
 }
 
@@ -407,6 +1008,9 @@ const URLProtocol ff_file_protocol = {
     .url_open            = file_open,
     .url_read            = file_read,
     .url_write           = file_write,
+#if HAVE_WRITEV //PLEX
+    .url_writev          = file_writev,
+#endif
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
@@ -457,6 +1061,9 @@ const URLProtocol ff_pipe_protocol = {
     .url_open            = pipe_open,
     .url_read            = file_read,
     .url_write           = file_write,
+#if HAVE_WRITEV //PLEX
+    .url_writev          = file_writev,
+#endif
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
     .url_check           = file_check,
@@ -502,6 +1109,9 @@ const URLProtocol ff_fd_protocol = {
     .url_open            = fd_open,
     .url_read            = file_read,
     .url_write           = file_write,
+#if HAVE_WRITEV //PLEX
+    .url_writev          = file_writev,
+#endif
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
@@ -145,6 +145,10 @@ const AVInputFormat *av_find_input_format(const char *short_name)
 {
     const AVInputFormat *fmt = NULL;
     void *i = 0;
+    //PLEX
+    if ((fmt = ff_find_builtin_demuxer(short_name, &i)))
+        return fmt;
+    //PLEX
     while ((fmt = av_demuxer_iterate(&i)))
         if (av_match_name(short_name, fmt->name))
             return fmt;
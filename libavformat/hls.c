@@ -27,8 +27,11 @@
  * https://www.rfc-editor.org/rfc/rfc8216.txt
  */
 
+#include "config.h"
 #include "config_components.h"
 
+#include <stdatomic.h>
+
 #include "libavformat/http.h"
 #include "libavutil/aes.h"
 #include "libavutil/avstring.h"
@@ -38,6 +41,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
 #include "libavutil/time.h"
+#include "libavutil/thread.h" //PLEX
 #include "avformat.h"
 #include "demux.h"
 #include "internal.h"
@@ -49,6 +53,7 @@
 #include "hls_sample_encryption.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define PREFETCH_CHUNK_SIZE (64 * 1024) //PLEX
 
 #define MAX_FIELD_LEN 64
 #define MAX_CHARACTERISTICS_LEN 512
@@ -87,6 +92,7 @@ struct segment {
 };
 
 struct rendition;
+struct prefetch_job; //PLEX
 
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
@@ -173,6 +179,14 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    //PLEX
+    /* Segments being downloaded ahead of cur_seq_no, and the one
+     * input is currently reading from, if any. */
+    int n_prefetch;
+    struct prefetch_job **prefetch;
+    struct prefetch_job *input_job;
+    //PLEX
 };
 
 /*
@@ -230,8 +244,265 @@ typedef struct HLSContext {
     int seg_max_retry;
     AVIOContext *playlist_pb;
     HLSCryptoContext  crypto_ctx;
+    //PLEX
+    int prefetch_segments;
+    int prefetch_max_size;
+    int prefetch_inited;
+    AVMutex prefetch_lock;
+    AVCond prefetch_cond;
+    //PLEX
 } HLSContext;
 
+//PLEX
+/* A media segment downloaded into memory by a background thread. */
+struct prefetch_job {
+    HLSContext *c;
+    int64_t seq_no;
+    char *url;
+    AVDictionary *opts;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    atomic_int abort;
+    int done;           /* protected by prefetch_lock */
+    int ret;
+    uint8_t *data;
+    unsigned int alloc;
+    int len;
+    int pos;            /* read position of the consumer */
+};
+
+static void prefetch_job_free(struct prefetch_job **pjob)
+{
+    struct prefetch_job *job = *pjob;
+
+    if (!job)
+        return;
+#if HAVE_THREADS
+    atomic_store(&job->abort, 1);
+    pthread_join(job->thread, NULL);
+#endif
+    av_free(job->url);
+    av_free(job->data);
+    av_dict_free(&job->opts);
+    av_freep(pjob);
+}
+
+static void prefetch_remove(struct playlist *pls, int i)
+{
+    prefetch_job_free(&pls->prefetch[i]);
+    pls->prefetch[i] = pls->prefetch[--pls->n_prefetch];
+}
+
+static void prefetch_flush(struct playlist *pls)
+{
+    while (pls->n_prefetch)
+        prefetch_remove(pls, pls->n_prefetch - 1);
+    av_freep(&pls->prefetch);
+}
+
+static int prefetch_find(struct playlist *pls, int64_t seq_no)
+{
+    for (int i = 0; i < pls->n_prefetch; i++)
+        if (pls->prefetch[i]->seq_no == seq_no)
+            return i;
+    return -1;
+}
+
+static int prefetch_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    struct prefetch_job *job = opaque;
+    int len = FFMIN(buf_size, job->len - job->pos);
+
+    if (len <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, job->data + job->pos, len);
+    job->pos += len;
+    return len;
+}
+
+/* Close the segment being read, whether it came from the network or from
+ * a prefetched buffer. */
+static void close_input(struct playlist *pls)
+{
+    if (pls->input_job) {
+        if (pls->input)
+            av_freep(&pls->input->buffer);
+        avio_context_free(&pls->input);
+        prefetch_job_free(&pls->input_job);
+    } else {
+        ff_format_io_close(pls->parent, &pls->input);
+    }
+}
+
+#if HAVE_THREADS
+static int prefetch_interrupt_cb(void *opaque)
+{
+    struct prefetch_job *job = opaque;
+    return atomic_load(&job->abort) || ff_check_interrupt(job->c->interrupt_callback);
+}
+
+static void *prefetch_thread(void *arg)
+{
+    struct prefetch_job *job = arg;
+    HLSContext *c = job->c;
+    AVIOInterruptCB int_cb = { prefetch_interrupt_cb, job };
+    AVIOContext *pb = NULL;
+    int ret;
+
+    ret = ffio_open_whitelist(&pb, job->url, AVIO_FLAG_READ, &int_cb, &job->opts,
+                              c->ctx->protocol_whitelist, c->ctx->protocol_blacklist);
+    while (ret >= 0) {
+        uint8_t *data;
+
+        if (job->len > c->prefetch_max_size - PREFETCH_CHUNK_SIZE) {
+            ret = AVERROR(ENOSPC);
+            break;
+        }
+        data = av_fast_realloc(job->data, &job->alloc, job->len + PREFETCH_CHUNK_SIZE);
+        if (!data) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        job->data = data;
+
+        ret = avio_read(pb, job->data + job->len, PREFETCH_CHUNK_SIZE);
+        if (ret == AVERROR_EOF) {
+            ret = 0;
+            break;
+        }
+        if (ret > 0)
+            job->len += ret;
+    }
+    avio_closep(&pb);
+
+    ff_mutex_lock(&c->prefetch_lock);
+    job->ret  = ret;
+    job->done = 1;
+    ff_cond_broadcast(&c->prefetch_cond);
+    ff_mutex_unlock(&c->prefetch_lock);
+    return NULL;
+}
+
+static int prefetch_start(HLSContext *c, struct playlist *pls,
+                          struct segment *seg, int64_t seq_no)
+{
+    struct prefetch_job *job = av_mallocz(sizeof(*job));
+    int ret;
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->c      = c;
+    job->seq_no = seq_no;
+    atomic_init(&job->abort, 0);
+    if (!(job->url = av_strdup(seg->url)) ||
+        (ret = av_dict_copy(&job->opts, c->avio_opts, 0)) < 0) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if (seg->size >= 0) {
+        av_dict_set_int(&job->opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(&job->opts, "end_offset", seg->url_offset + seg->size, 0);
+    }
+    if ((ret = av_dynarray_add_nofree(&pls->prefetch, &pls->n_prefetch, job)) < 0)
+        goto fail;
+    if ((ret = pthread_create(&job->thread, NULL, prefetch_thread, job))) {
+        pls->n_prefetch--;
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    av_log(pls->parent, AV_LOG_DEBUG, "Prefetching segment %"PRId64" of playlist %d\n",
+           seq_no, pls->index);
+    return 0;
+
+fail:
+    av_free(job->url);
+    av_dict_free(&job->opts);
+    av_free(job);
+    return ret;
+}
+#else
+static int prefetch_start(HLSContext *c, struct playlist *pls,
+                          struct segment *seg, int64_t seq_no)
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+
+/* Keep downloads running for the segments following the current one,
+ * and drop those the playlist moved away from. */
+static void prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+    int64_t seq_no;
+
+    for (int i = 0; i < pls->n_prefetch; ) {
+        int64_t n = pls->prefetch[i]->seq_no;
+        if (n < pls->cur_seq_no || n > pls->cur_seq_no + c->prefetch_segments)
+            prefetch_remove(pls, i);
+        else
+            i++;
+    }
+
+    for (seq_no = pls->cur_seq_no + 1; seq_no <= pls->cur_seq_no + c->prefetch_segments; seq_no++) {
+        int64_t n = seq_no - pls->start_seq_no;
+        struct segment *seg;
+
+        if (n < 0)
+            continue;
+        if (n >= pls->n_segments)
+            break;
+        seg = pls->segments[n];
+        if (seg->key_type != KEY_NONE || !av_strstart(seg->url, "http", NULL) ||
+            prefetch_find(pls, seq_no) >= 0)
+            continue;
+        if (prefetch_start(c, pls, seg, seq_no) < 0)
+            break;
+    }
+}
+
+/* Use the prefetched copy of the current segment as input if there is
+ * one, waiting for its download to finish. Returns 1 if it was used. */
+static int prefetch_open(HLSContext *c, struct playlist *pls, struct segment *seg)
+{
+    int i = prefetch_find(pls, pls->cur_seq_no);
+    struct prefetch_job *job;
+    uint8_t *buf;
+
+    if (i < 0)
+        return 0;
+    job = pls->prefetch[i];
+    pls->prefetch[i] = pls->prefetch[--pls->n_prefetch];
+
+    ff_mutex_lock(&c->prefetch_lock);
+    while (!job->done)
+        ff_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+    ff_mutex_unlock(&c->prefetch_lock);
+
+    if (job->ret < 0 || strcmp(job->url, seg->url) ||
+        !(buf = av_malloc(INITIAL_BUFFER_SIZE))) {
+        if (job->ret < 0 && job->ret != AVERROR_EXIT)
+            av_log(pls->parent, AV_LOG_VERBOSE, "Prefetching segment %"PRId64" failed: %s\n",
+                   job->seq_no, av_err2str(job->ret));
+        prefetch_job_free(&job);
+        return 0;
+    }
+
+    /* a persistent connection left open by the previous segment */
+    close_input(pls);
+    pls->input = avio_alloc_context(buf, INITIAL_BUFFER_SIZE, 0, job,
+                                    prefetch_read, NULL, NULL);
+    if (!pls->input) {
+        av_free(buf);
+        prefetch_job_free(&job);
+        return 0;
+    }
+    pls->input_job      = job;
+    pls->cur_seg_offset = 0;
+    return 1;
+}
+//PLEX
+
 static void free_segment_dynarray(struct segment **segments, int n_segments)
 {
     int i;
@@ -276,7 +547,8 @@ static void free_playlist_list(HLSContext *c)
         av_freep(&pls->init_sec_buf);
         av_packet_free(&pls->pkt);
         av_freep(&pls->pb.pub.buffer);
-        ff_format_io_close(c->ctx, &pls->input);
+        close_input(pls); //PLEX
+        prefetch_flush(pls); //PLEX
         pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
         pls->input_next_requested = 0;
@@ -1558,6 +1830,8 @@ reload:
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
             ret = 0;
+        } else if (prefetch_open(c, v, seg)) { //PLEX
+            ret = 0;
         } else {
             ret = open_input(c, v, seg, &v->input);
         }
@@ -1580,6 +1854,8 @@ reload:
         }
         segment_retries = 0;
         just_opened = 1;
+        if (c->prefetch_segments) //PLEX
+            prefetch_schedule(c, v);
     }
 
     if (c->http_multiple == -1) {
@@ -1625,11 +1901,11 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (c->http_persistent && !v->input_job && //PLEX
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
-        ff_format_io_close(v->parent, &v->input);
+        close_input(v); //PLEX
     }
     v->cur_seq_no++;
 
@@ -1913,6 +2189,13 @@ static int hls_close(AVFormatContext *s)
     free_variant_list(c);
     free_rendition_list(c);
 
+    //PLEX
+    if (c->prefetch_inited) {
+        ff_cond_destroy(&c->prefetch_cond);
+        ff_mutex_destroy(&c->prefetch_lock);
+    }
+    //PLEX
+
     if (c->crypto_ctx.aes_ctx)
         av_free(c->crypto_ctx.aes_ctx);
 
@@ -1931,6 +2214,24 @@ static int hls_read_header(AVFormatContext *s)
     c->ctx                = s;
     c->interrupt_callback = &s->interrupt_callback;
 
+    //PLEX
+    if (c->prefetch_segments) {
+        if (!HAVE_THREADS) {
+            av_log(s, AV_LOG_WARNING, "Segment prefetching requires threads, disabling it\n");
+            c->prefetch_segments = 0;
+        } else if ((ret = ff_mutex_init(&c->prefetch_lock, NULL)) ||
+                   (ret = ff_cond_init(&c->prefetch_cond, NULL))) {
+            if (!ret)
+                ff_mutex_destroy(&c->prefetch_lock);
+            return AVERROR(ret);
+        } else {
+            c->prefetch_inited = 1;
+            /* the prefetch window supersedes the next segment request */
+            c->http_multiple = 0;
+        }
+    }
+    //PLEX
+
     c->first_packet = 1;
     c->first_timestamp = AV_NOPTS_VALUE;
     c->cur_timestamp = AV_NOPTS_VALUE;
@@ -2074,7 +2375,7 @@ static int hls_read_header(AVFormatContext *s)
             }
             ret = 0;
             /* Reset reading */
-            ff_format_io_close(pls->parent, &pls->input);
+            close_input(pls); //PLEX
             pls->input = NULL;
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
@@ -2228,7 +2529,8 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
-            ff_format_io_close(pls->parent, &pls->input);
+            close_input(pls); //PLEX
+            prefetch_flush(pls); //PLEX
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next_requested = 0;
@@ -2493,7 +2795,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
         AVIOContext *const pb = &pls->pb.pub;
-        ff_format_io_close(pls->parent, &pls->input);
+        close_input(pls); //PLEX
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
         pls->input_next_requested = 0;
@@ -2589,6 +2891,12 @@ static const AVOption hls_options[] = {
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
     {"seg_max_retry", "Maximum number of times to reload a segment on error.",
      OFFSET(seg_max_retry), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    //PLEX
+    {"prefetch_segments", "Number of segments downloaded ahead in the background",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 16, FLAGS},
+    {"prefetch_max_size", "Maximum size of a prefetched segment",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT, {.i64 = 64 << 20}, PREFETCH_CHUNK_SIZE, INT_MAX, FLAGS},
+    //PLEX
     {NULL}
 };
 
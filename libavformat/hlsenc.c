@@ -36,6 +36,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/log.h"
 #include "libavutil/random_seed.h"
+#include "libavutil/thread.h" //PLEX
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
 
@@ -52,6 +53,7 @@
 #include "mux.h"
 #include "os_support.h"
 #include "url.h"
+#include "webvttenc.h" //PLEX
 
 typedef enum {
     HLS_START_SEQUENCE_AS_START_NUMBER = 0,
@@ -107,6 +109,7 @@ typedef enum HLSFlags {
     HLS_PERIODIC_REKEY = (1 << 12),
     HLS_INDEPENDENT_SEGMENTS = (1 << 13),
     HLS_I_FRAMES_ONLY = (1 << 14),
+    HLS_ASYNC_PLAYLIST = (1 << 15), //PLEX
 } HLSFlags;
 
 typedef enum {
@@ -190,6 +193,14 @@ typedef struct ClosedCaptionsStream {
     const char *language;   /* closed captions language */
 } ClosedCaptionsStream;
 
+//PLEX
+typedef struct HLSAsyncPlaylist {
+    char *filename;
+    uint8_t *buf;
+    int size;
+} HLSAsyncPlaylist;
+//PLEX
+
 typedef struct HLSContext {
     const AVClass *class;  // Class for private options.
     int64_t start_sequence;
@@ -255,6 +266,20 @@ typedef struct HLSContext {
     char *headers;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
+//PLEX
+    /* playlists waiting for the writer thread, at most one per file name */
+    HLSAsyncPlaylist *async_pending;
+    int nb_async_pending;
+    int async_busy;
+    int async_exit;
+    int async_err;
+#if HAVE_THREADS
+    int async_started;
+    pthread_t async_thread;
+    pthread_mutex_t async_lock;
+    pthread_cond_t async_cond;
+#endif
+//PLEX
 } HLSContext;
 
 static int strftime_expand(const char *fmt, char **dest)
@@ -332,8 +357,10 @@ static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSCont
     }
     if (c->user_agent)
         av_dict_set(options, "user_agent", c->user_agent, 0);
-    if (c->http_persistent)
+    if (c->http_persistent) {
         av_dict_set_int(options, "multiple_requests", 1, 0);
+        av_dict_set_int(options, "connection_pool", 1, 0); //PLEX
+    }
     if (c->timeout >= 0)
         av_dict_set_int(options, "timeout", c->timeout, 0);
     if (c->headers)
@@ -1537,6 +1564,199 @@ fail:
     return ret;
 }
 
+//PLEX
+static int hls_async_write(AVFormatContext *s, const HLSAsyncPlaylist *pl)
+{
+    AVIOContext *pb = NULL;
+    char *temp_filename = av_asprintf("%s.tmp", pl->filename);
+    int ret;
+
+    if (!temp_filename)
+        return AVERROR(ENOMEM);
+    ret = ffio_open_whitelist(&pb, temp_filename, AVIO_FLAG_WRITE, &s->interrupt_callback,
+                              NULL, s->protocol_whitelist, s->protocol_blacklist);
+    if (ret >= 0) {
+        avio_write(pb, pl->buf, pl->size);
+        ret = avio_closep(&pb);
+    }
+    if (ret >= 0)
+        ret = ff_rename(temp_filename, pl->filename, s);
+    else
+        av_log(s, AV_LOG_WARNING, "Failed to write playlist '%s'\n", pl->filename);
+    av_free(temp_filename);
+    return ret;
+}
+
+static void hls_async_free(HLSAsyncPlaylist *pl)
+{
+    av_freep(&pl->filename);
+    av_freep(&pl->buf);
+    pl->size = 0;
+}
+
+#if HAVE_THREADS
+static void *hls_async_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    HLSContext *hls = s->priv_data;
+    HLSAsyncPlaylist pl;
+    int ret;
+
+    pthread_mutex_lock(&hls->async_lock);
+    for (;;) {
+        while (!hls->nb_async_pending && !hls->async_exit)
+            pthread_cond_wait(&hls->async_cond, &hls->async_lock);
+        if (!hls->nb_async_pending)
+            break;
+
+        pl = hls->async_pending[0];
+        memmove(hls->async_pending, hls->async_pending + 1,
+                --hls->nb_async_pending * sizeof(*hls->async_pending));
+        hls->async_busy = 1;
+        pthread_mutex_unlock(&hls->async_lock);
+
+        ret = hls_async_write(s, &pl);
+        hls_async_free(&pl);
+
+        pthread_mutex_lock(&hls->async_lock);
+        hls->async_busy = 0;
+        if (ret < 0 && !hls->async_err)
+            hls->async_err = ret;
+        pthread_cond_broadcast(&hls->async_cond);
+    }
+    pthread_mutex_unlock(&hls->async_lock);
+    return NULL;
+}
+#endif
+
+static int hls_async_init(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    HLSContext *hls = s->priv_data;
+    int ret;
+
+    if ((ret = pthread_mutex_init(&hls->async_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&hls->async_cond, NULL))) {
+        pthread_mutex_destroy(&hls->async_lock);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_create(&hls->async_thread, NULL, hls_async_thread, s))) {
+        pthread_cond_destroy(&hls->async_cond);
+        pthread_mutex_destroy(&hls->async_lock);
+        return AVERROR(ret);
+    }
+    hls->async_started = 1;
+#endif
+    return 0;
+}
+
+/* wait for the writer to finish everything queued so far */
+static int hls_async_flush(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+    int ret = 0;
+
+#if HAVE_THREADS
+    if (!hls->async_started)
+        return 0;
+    pthread_mutex_lock(&hls->async_lock);
+    while (hls->nb_async_pending || hls->async_busy)
+        pthread_cond_wait(&hls->async_cond, &hls->async_lock);
+    ret = hls->async_err;
+    hls->async_err = 0;
+    pthread_mutex_unlock(&hls->async_lock);
+#endif
+    return hls->ignore_io_errors ? 0 : ret;
+}
+
+static void hls_async_uninit(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+
+#if HAVE_THREADS
+    if (hls->async_started) {
+        pthread_mutex_lock(&hls->async_lock);
+        hls->async_exit = 1;
+        pthread_cond_broadcast(&hls->async_cond);
+        pthread_mutex_unlock(&hls->async_lock);
+        pthread_join(hls->async_thread, NULL);
+        pthread_cond_destroy(&hls->async_cond);
+        pthread_mutex_destroy(&hls->async_lock);
+        hls->async_started = 0;
+    }
+#endif
+    for (int i = 0; i < hls->nb_async_pending; i++)
+        hls_async_free(&hls->async_pending[i]);
+    av_freep(&hls->async_pending);
+    hls->nb_async_pending = 0;
+}
+
+#if HAVE_THREADS
+static int hls_async_queue(HLSContext *hls, HLSAsyncPlaylist *pl)
+{
+    HLSAsyncPlaylist *pending;
+    int ret = 0, i;
+
+    pthread_mutex_lock(&hls->async_lock);
+    for (i = 0; i < hls->nb_async_pending; i++)
+        if (!strcmp(hls->async_pending[i].filename, pl->filename))
+            break;
+    if (i < hls->nb_async_pending) {
+        hls_async_free(&hls->async_pending[i]);
+        hls->async_pending[i] = *pl;
+    } else {
+        pending = av_realloc_array(hls->async_pending, hls->nb_async_pending + 1,
+                                   sizeof(*hls->async_pending));
+        if (pending) {
+            hls->async_pending = pending;
+            hls->async_pending[hls->nb_async_pending++] = *pl;
+        } else {
+            hls_async_free(pl);
+            ret = AVERROR(ENOMEM);
+        }
+    }
+    if (ret >= 0) {
+        ret = hls->async_err;
+        hls->async_err = 0;
+    }
+    pthread_cond_signal(&hls->async_cond);
+    pthread_mutex_unlock(&hls->async_lock);
+    return ret;
+}
+#endif
+
+/**
+ * Hand a playlist built in a dynamic buffer over to the writer thread.
+ * A playlist still waiting under the same name is superseded, so a slow
+ * disk never makes the queue grow.
+ */
+static int hls_async_submit(AVFormatContext *s, AVIOContext **pb, const char *filename)
+{
+    HLSContext *hls = s->priv_data;
+    HLSAsyncPlaylist pl = { 0 };
+    int ret;
+
+    if (!*pb)
+        return 0;
+    pl.size     = avio_close_dyn_buf(*pb, &pl.buf);
+    *pb         = NULL;
+    pl.filename = av_strdup(filename);
+    if (!pl.filename) {
+        hls_async_free(&pl);
+        return AVERROR(ENOMEM);
+    }
+
+#if HAVE_THREADS
+    ret = hls_async_queue(hls, &pl);
+#else
+    ret = hls_async_write(s, &pl);
+    hls_async_free(&pl);
+#endif
+    return hls->ignore_io_errors ? 0 : ret;
+}
+//PLEX
+
 static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 {
     HLSContext *hls = s->priv_data;
@@ -1556,6 +1776,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     double prog_date_time = vs->initial_prog_date_time;
     double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int async = is_file_proto && (hls->flags & HLS_ASYNC_PLAYLIST); //PLEX
 
     hls->version = 2;
     if (!(hls->flags & HLS_ROUND_DURATIONS)) {
@@ -1584,7 +1805,13 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", vs->m3u8_name);
-    if ((ret = hlsenc_io_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options)) < 0) {
+    //PLEX
+    if (async)
+        ret = avio_open_dyn_buf(byterange_mode ? &hls->m3u8_out : &vs->out);
+    else
+    //PLEX
+    ret = hlsenc_io_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options);
+    if (ret < 0) {
         if (hls->ignore_io_errors)
             ret = 0;
         goto fail;
@@ -1640,7 +1867,13 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
     if (vs->vtt_m3u8_name) {
         snprintf(temp_vtt_filename, sizeof(temp_vtt_filename), use_temp_file ? "%s.tmp" : "%s", vs->vtt_m3u8_name);
-        if ((ret = hlsenc_io_open(s, &hls->sub_m3u8_out, temp_vtt_filename, &options)) < 0) {
+        //PLEX
+        if (async)
+            ret = avio_open_dyn_buf(&hls->sub_m3u8_out);
+        else
+        //PLEX
+        ret = hlsenc_io_open(s, &hls->sub_m3u8_out, temp_vtt_filename, &options);
+        if (ret < 0) {
             if (hls->ignore_io_errors)
                 ret = 0;
             goto fail;
@@ -1663,6 +1896,15 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
 fail:
     av_dict_free(&options);
+    //PLEX
+    if (async) {
+        ret = hls_async_submit(s, byterange_mode ? &hls->m3u8_out : &vs->out, vs->m3u8_name);
+        if (ret < 0)
+            return ret;
+        if (vs->vtt_m3u8_name)
+            hls_async_submit(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
+    } else {
+    //PLEX
     ret = hlsenc_io_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
     if (ret < 0) {
         return ret;
@@ -1673,6 +1915,7 @@ fail:
         if (vs->vtt_m3u8_name)
             ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
     }
+    } //PLEX
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs) < 0)
             av_log(s, AV_LOG_WARNING, "Master playlist creation failed\n");
@@ -1853,6 +2096,14 @@ static int hls_start(AVFormatContext *s, VariantStream *vs)
     av_dict_free(&options);
 
     if (vs->vtt_basename) {
+        //PLEX
+#if CONFIG_WEBVTT_MUXER
+        /* the muxer is kept across segments, only the file header is new */
+        if (ffformatcontext(vtt_oc)->initialized)
+            err = ff_webvtt_write_segment_header(vtt_oc);
+        else
+#endif
+        //PLEX
         err = avformat_write_header(vtt_oc,NULL);
         if (err < 0)
             return err;
@@ -2715,6 +2966,7 @@ static void hls_deinit(AVFormatContext *s)
         av_freep(&vs->streams);
     }
 
+    hls_async_uninit(s); //PLEX
     ff_format_io_close(s, &hls->m3u8_out);
     ff_format_io_close(s, &hls->sub_m3u8_out);
     ff_format_io_close(s, &hls->http_delete);
@@ -2859,7 +3111,7 @@ failed:
         av_free(old_filename);
     }
 
-    return 0;
+    return hls_async_flush(s); //PLEX
 }
 
 
@@ -2885,6 +3137,13 @@ static int hls_init(AVFormatContext *s)
             pattern += 2;
     }
 
+    //PLEX
+    if ((hls->flags & HLS_ASYNC_PLAYLIST) && (ret = hls_async_init(s)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to start the playlist writer thread\n");
+        return ret;
+    }
+    //PLEX
+
     hls->has_default_key = 0;
     hls->has_video_m3u8 = 0;
     ret = update_variant_stream_info(s);
@@ -3155,6 +3414,7 @@ static const AVOption options[] = {
     {"periodic_rekey", "reload keyinfo file periodically for re-keying", 0, AV_OPT_TYPE_CONST, {.i64 = HLS_PERIODIC_REKEY }, 0, UINT_MAX,   E, "flags"},
     {"independent_segments", "add EXT-X-INDEPENDENT-SEGMENTS, whenever applicable", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_INDEPENDENT_SEGMENTS }, 0, UINT_MAX, E, "flags"},
     {"iframes_only", "add EXT-X-I-FRAMES-ONLY, whenever applicable", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_I_FRAMES_ONLY }, 0, UINT_MAX, E, "flags"},
+    {"async_playlist", "build playlists in memory and write them from a separate thread", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_ASYNC_PLAYLIST }, 0, UINT_MAX, E, "flags"}, //PLEX
     {"strftime", "set filename expansion with strftime at segment creation", OFFSET(use_localtime), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
     {"strftime_mkdir", "create last directory component in strftime-generated filename", OFFSET(use_localtime_mkdir), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
     {"hls_playlist_type", "set the HLS playlist type", OFFSET(pl_type), AV_OPT_TYPE_INT, {.i64 = PLAYLIST_TYPE_NONE }, 0, PLAYLIST_TYPE_NB-1, E, "pl_type" },
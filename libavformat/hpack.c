@@ -0,0 +1,522 @@
+/*
+ * HPACK header compression for HTTP/2 (RFC 7541)
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "hpack.h"
+
+/* per entry overhead counted against the table size */
+#define ENTRY_OVERHEAD 32
+
+static const struct {
+    const char *name;
+    const char *value;
+} static_table[] = {
+    { ":authority",                  ""              },
+    { ":method",                     "GET"           },
+    { ":method",                     "POST"          },
+    { ":path",                       "/"             },
+    { ":path",                       "/index.html"   },
+    { ":scheme",                     "http"          },
+    { ":scheme",                     "https"         },
+    { ":status",                     "200"           },
+    { ":status",                     "204"           },
+    { ":status",                     "206"           },
+    { ":status",                     "304"           },
+    { ":status",                     "400"           },
+    { ":status",                     "404"           },
+    { ":status",                     "500"           },
+    { "accept-charset",              ""              },
+    { "accept-encoding",             "gzip, deflate" },
+    { "accept-language",             ""              },
+    { "accept-ranges",               ""              },
+    { "accept",                      ""              },
+    { "access-control-allow-origin", ""              },
+    { "age",                         ""              },
+    { "allow",                       ""              },
+    { "authorization",               ""              },
+    { "cache-control",               ""              },
+    { "content-disposition",         ""              },
+    { "content-encoding",            ""              },
+    { "content-language",            ""              },
+    { "content-length",              ""              },
+    { "content-location",            ""              },
+    { "content-range",               ""              },
+    { "content-type",                ""              },
+    { "cookie",                      ""              },
+    { "date",                        ""              },
+    { "etag",                        ""              },
+    { "expect",                      ""              },
+    { "expires",                     ""              },
+    { "from",                        ""              },
+    { "host",                        ""              },
+    { "if-match",                    ""              },
+    { "if-modified-since",           ""              },
+    { "if-none-match",               ""              },
+    { "if-range",                    ""              },
+    { "if-unmodified-since",         ""              },
+    { "last-modified",               ""              },
+    { "link",                        ""              },
+    { "location",                    ""              },
+    { "max-forwards",                ""              },
+    { "proxy-authenticate",          ""              },
+    { "proxy-authorization",         ""              },
+    { "range",                       ""              },
+    { "referer",                     ""              },
+    { "refresh",                     ""              },
+    { "retry-after",                 ""              },
+    { "server",                      ""              },
+    { "set-cookie",                  ""              },
+    { "strict-transport-security",   ""              },
+    { "transfer-encoding",           ""              },
+    { "user-agent",                  ""              },
+    { "vary",                        ""              },
+    { "via",                         ""              },
+    { "www-authenticate",            ""              },
+};
+
+#define NB_STATIC FF_ARRAY_ELEMS(static_table)
+
+/* Huffman code of RFC 7541 appendix B, indexed by symbol. The code is
+ * canonical, which the decoder relies on. */
+static const uint32_t huffman_codes[256] = {
+    0x00001ff8, 0x007fffd8, 0x0fffffe2, 0x0fffffe3, 0x0fffffe4, 0x0fffffe5,
+    0x0fffffe6, 0x0fffffe7, 0x0fffffe8, 0x00ffffea, 0x3ffffffc, 0x0fffffe9,
+    0x0fffffea, 0x3ffffffd, 0x0fffffeb, 0x0fffffec, 0x0fffffed, 0x0fffffee,
+    0x0fffffef, 0x0ffffff0, 0x0ffffff1, 0x0ffffff2, 0x3ffffffe, 0x0ffffff3,
+    0x0ffffff4, 0x0ffffff5, 0x0ffffff6, 0x0ffffff7, 0x0ffffff8, 0x0ffffff9,
+    0x0ffffffa, 0x0ffffffb, 0x00000014, 0x000003f8, 0x000003f9, 0x00000ffa,
+    0x00001ff9, 0x00000015, 0x000000f8, 0x000007fa, 0x000003fa, 0x000003fb,
+    0x000000f9, 0x000007fb, 0x000000fa, 0x00000016, 0x00000017, 0x00000018,
+    0x00000000, 0x00000001, 0x00000002, 0x00000019, 0x0000001a, 0x0000001b,
+    0x0000001c, 0x0000001d, 0x0000001e, 0x0000001f, 0x0000005c, 0x000000fb,
+    0x00007ffc, 0x00000020, 0x00000ffb, 0x000003fc, 0x00001ffa, 0x00000021,
+    0x0000005d, 0x0000005e, 0x0000005f, 0x00000060, 0x00000061, 0x00000062,
+    0x00000063, 0x00000064, 0x00000065, 0x00000066, 0x00000067, 0x00000068,
+    0x00000069, 0x0000006a, 0x0000006b, 0x0000006c, 0x0000006d, 0x0000006e,
+    0x0000006f, 0x00000070, 0x00000071, 0x00000072, 0x000000fc, 0x00000073,
+    0x000000fd, 0x00001ffb, 0x0007fff0, 0x00001ffc, 0x00003ffc, 0x00000022,
+    0x00007ffd, 0x00000003, 0x00000023, 0x00000004, 0x00000024, 0x00000005,
+    0x00000025, 0x00000026, 0x00000027, 0x00000006, 0x00000074, 0x00000075,
+    0x00000028, 0x00000029, 0x0000002a, 0x00000007, 0x0000002b, 0x00000076,
+    0x0000002c, 0x00000008, 0x00000009, 0x0000002d, 0x00000077, 0x00000078,
+    0x00000079, 0x0000007a, 0x0000007b, 0x00007ffe, 0x000007fc, 0x00003ffd,
+    0x00001ffd, 0x0ffffffc, 0x000fffe6, 0x003fffd2, 0x000fffe7, 0x000fffe8,
+    0x003fffd3, 0x003fffd4, 0x003fffd5, 0x007fffd9, 0x003fffd6, 0x007fffda,
+    0x007fffdb, 0x007fffdc, 0x007fffdd, 0x007fffde, 0x00ffffeb, 0x007fffdf,
+    0x00ffffec, 0x00ffffed, 0x003fffd7, 0x007fffe0, 0x00ffffee, 0x007fffe1,
+    0x007fffe2, 0x007fffe3, 0x007fffe4, 0x001fffdc, 0x003fffd8, 0x007fffe5,
+    0x003fffd9, 0x007fffe6, 0x007fffe7, 0x00ffffef, 0x003fffda, 0x001fffdd,
+    0x000fffe9, 0x003fffdb, 0x003fffdc, 0x007fffe8, 0x007fffe9, 0x001fffde,
+    0x007fffea, 0x003fffdd, 0x003fffde, 0x00fffff0, 0x001fffdf, 0x003fffdf,
+    0x007fffeb, 0x007fffec, 0x001fffe0, 0x001fffe1, 0x003fffe0, 0x001fffe2,
+    0x007fffed, 0x003fffe1, 0x007fffee, 0x007fffef, 0x000fffea, 0x003fffe2,
+    0x003fffe3, 0x003fffe4, 0x007ffff0, 0x003fffe5, 0x003fffe6, 0x007ffff1,
+    0x03ffffe0, 0x03ffffe1, 0x000fffeb, 0x0007fff1, 0x003fffe7, 0x007ffff2,
+    0x003fffe8, 0x01ffffec, 0x03ffffe2, 0x03ffffe3, 0x03ffffe4, 0x07ffffde,
+    0x07ffffdf, 0x03ffffe5, 0x00fffff1, 0x01ffffed, 0x0007fff2, 0x001fffe3,
+    0x03ffffe6, 0x07ffffe0, 0x07ffffe1, 0x03ffffe7, 0x07ffffe2, 0x00fffff2,
+    0x001fffe4, 0x001fffe5, 0x03ffffe8, 0x03ffffe9, 0x0ffffffd, 0x07ffffe3,
+    0x07ffffe4, 0x07ffffe5, 0x000fffec, 0x00fffff3, 0x000fffed, 0x001fffe6,
+    0x003fffe9, 0x001fffe7, 0x001fffe8, 0x007ffff3, 0x003fffea, 0x003fffeb,
+    0x01ffffee, 0x01ffffef, 0x00fffff4, 0x00fffff5, 0x03ffffea, 0x007ffff4,
+    0x03ffffeb, 0x07ffffe6, 0x03ffffec, 0x03ffffed, 0x07ffffe7, 0x07ffffe8,
+    0x07ffffe9, 0x07ffffea, 0x07ffffeb, 0x0ffffffe, 0x07ffffec, 0x07ffffed,
+    0x07ffffee, 0x07ffffef, 0x07fffff0, 0x03ffffee,
+};
+
+static const uint8_t huffman_lens[256] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+     6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+     5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+    13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+     7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+    15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+     6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+
+#define HUFFMAN_MIN_LEN  5
+#define HUFFMAN_MAX_LEN 30
+
+static struct {
+    uint32_t first[HUFFMAN_MAX_LEN + 1];
+    uint16_t count[HUFFMAN_MAX_LEN + 1];
+    uint16_t offset[HUFFMAN_MAX_LEN + 1];
+    uint8_t  symbols[256];
+} huffman_dec;
+
+static AVOnce huffman_init_once = AV_ONCE_INIT;
+
+static void huffman_init(void)
+{
+    int n = 0;
+
+    for (int len = HUFFMAN_MIN_LEN; len <= HUFFMAN_MAX_LEN; len++) {
+        huffman_dec.offset[len] = n;
+        for (int sym = 0; sym < 256; sym++) {
+            if (huffman_lens[sym] != len)
+                continue;
+            if (!huffman_dec.count[len]++)
+                huffman_dec.first[len] = huffman_codes[sym];
+            huffman_dec.symbols[n++] = sym;
+        }
+    }
+}
+
+static int huffman_decode(const uint8_t *src, int size, char *dst)
+{
+    uint32_t code = 0;
+    int len = 0, n = 0;
+
+    for (int i = 0; i < size * 8; i++) {
+        code = code << 1 | (src[i >> 3] >> (7 - (i & 7)) & 1);
+        if (++len < HUFFMAN_MIN_LEN)
+            continue;
+        if (code - huffman_dec.first[len] < huffman_dec.count[len]) {
+            dst[n++] = huffman_dec.symbols[huffman_dec.offset[len] + code - huffman_dec.first[len]];
+            code = len = 0;
+        } else if (len == HUFFMAN_MAX_LEN) {
+            return AVERROR_INVALIDDATA;
+        }
+    }
+    /* the padding is the most significant bits of EOS, all ones */
+    if (len > 7 || code != (1U << len) - 1)
+        return AVERROR_INVALIDDATA;
+    dst[n] = 0;
+    return n;
+}
+
+static int huffman_size(const char *str, int len)
+{
+    int64_t bits = 0;
+
+    for (int i = 0; i < len; i++)
+        bits += huffman_lens[(uint8_t)str[i]];
+    return (bits + 7) >> 3;
+}
+
+static void huffman_encode(AVBPrint *bp, const char *str, int len)
+{
+    uint64_t acc = 0;
+    int bits = 0;
+
+    for (int i = 0; i < len; i++) {
+        uint8_t sym = str[i];
+        acc   = acc << huffman_lens[sym] | huffman_codes[sym];
+        bits += huffman_lens[sym];
+        while (bits >= 8) {
+            bits -= 8;
+            av_bprint_chars(bp, acc >> bits & 0xff, 1);
+        }
+    }
+    if (bits)
+        av_bprint_chars(bp, (acc << (8 - bits) | 0xff >> bits) & 0xff, 1);
+}
+
+static void encode_int(AVBPrint *bp, int first, int prefix_bits, uint32_t value)
+{
+    uint32_t max = (1 << prefix_bits) - 1;
+
+    if (value < max) {
+        av_bprint_chars(bp, first | value, 1);
+        return;
+    }
+    av_bprint_chars(bp, first | max, 1);
+    value -= max;
+    while (value >= 128) {
+        av_bprint_chars(bp, 0x80 | (value & 0x7f), 1);
+        value >>= 7;
+    }
+    av_bprint_chars(bp, value, 1);
+}
+
+static int decode_int(const uint8_t **p, const uint8_t *end, int prefix_bits, uint32_t *value)
+{
+    uint32_t max = (1 << prefix_bits) - 1, v;
+    int shift = 0;
+
+    if (*p >= end)
+        return AVERROR_INVALIDDATA;
+    v = *(*p)++ & max;
+    if (v < max) {
+        *value = v;
+        return 0;
+    }
+    do {
+        if (*p >= end || shift > 21)
+            return AVERROR_INVALIDDATA;
+        v += (**p & 0x7f) << shift;
+        shift += 7;
+    } while (*(*p)++ & 0x80);
+    *value = v;
+    return 0;
+}
+
+static void encode_string(AVBPrint *bp, const char *str)
+{
+    int len = strlen(str), hlen = huffman_size(str, len);
+
+    if (hlen < len) {
+        encode_int(bp, 0x80, 7, hlen);
+        huffman_encode(bp, str, len);
+    } else {
+        encode_int(bp, 0, 7, len);
+        av_bprint_append_data(bp, str, len);
+    }
+}
+
+static int decode_string(const uint8_t **p, const uint8_t *end, char **str)
+{
+    uint32_t len;
+    int huffman, ret;
+
+    if (*p >= end)
+        return AVERROR_INVALIDDATA;
+    huffman = **p & 0x80;
+    if ((ret = decode_int(p, end, 7, &len)) < 0)
+        return ret;
+    if (len > end - *p)
+        return AVERROR_INVALIDDATA;
+
+    if (huffman) {
+        /* the shortest code is 5 bits long */
+        if (!(*str = av_malloc(len * 8 / HUFFMAN_MIN_LEN + 1)))
+            return AVERROR(ENOMEM);
+        if ((ret = huffman_decode(*p, len, *str)) < 0) {
+            av_freep(str);
+            return ret;
+        }
+    } else if (!(*str = av_strndup(*p, len))) {
+        return AVERROR(ENOMEM);
+    }
+    *p += len;
+    return 0;
+}
+
+static int entry_size(const char *name, const char *value)
+{
+    return strlen(name) + strlen(value) + ENTRY_OVERHEAD;
+}
+
+static void table_evict(HPACKTable *t, int max_size)
+{
+    while (t->nb_entries && t->size > max_size) {
+        HPACKEntry *e = &t->entries[--t->nb_entries];
+        t->size -= entry_size(e->name, e->value);
+        av_freep(&e->name);
+        av_freep(&e->value);
+    }
+}
+
+/* Takes ownership of name and value. */
+static int table_add(HPACKTable *t, char *name, char *value)
+{
+    int size = entry_size(name, value);
+
+    table_evict(t, t->max_size - size);
+    if (size > t->max_size) {
+        /* an entry larger than the table just empties it */
+        av_free(name);
+        av_free(value);
+        return 0;
+    }
+    if (av_reallocp_array(&t->entries, t->nb_entries + 1, sizeof(*t->entries)) < 0) {
+        av_free(name);
+        av_free(value);
+        t->nb_entries = t->size = 0;
+        return AVERROR(ENOMEM);
+    }
+    memmove(t->entries + 1, t->entries, t->nb_entries * sizeof(*t->entries));
+    t->entries[0].name  = name;
+    t->entries[0].value = value;
+    t->nb_entries++;
+    t->size += size;
+    return 0;
+}
+
+static int table_get(const HPACKTable *t, uint32_t index,
+                     const char **name, const char **value)
+{
+    if (!index)
+        return AVERROR_INVALIDDATA;
+    if (index <= NB_STATIC) {
+        *name  = static_table[index - 1].name;
+        *value = static_table[index - 1].value;
+        return 0;
+    }
+    index -= NB_STATIC + 1;
+    if (index >= t->nb_entries)
+        return AVERROR_INVALIDDATA;
+    *name  = t->entries[index].name;
+    *value = t->entries[index].value;
+    return 0;
+}
+
+void ff_hpack_table_init(HPACKTable *t, int max_size)
+{
+    memset(t, 0, sizeof(*t));
+    t->max_size = max_size;
+    ff_thread_once(&huffman_init_once, huffman_init);
+}
+
+void ff_hpack_table_uninit(HPACKTable *t)
+{
+    table_evict(t, -1);
+    av_freep(&t->entries);
+}
+
+void ff_hpack_set_max_size(HPACKTable *t, int max_size)
+{
+    if (max_size == t->max_size)
+        return;
+    t->max_size = max_size;
+    table_evict(t, max_size);
+    t->pending_update = 1;
+}
+
+void ff_hpack_encode_start(HPACKTable *t, AVBPrint *bp)
+{
+    if (t->pending_update)
+        encode_int(bp, 0x20, 5, t->max_size);
+    t->pending_update = 0;
+}
+
+void ff_hpack_encode_field(HPACKTable *t, AVBPrint *bp, const char *name,
+                           const char *value, int flags)
+{
+    uint32_t name_index = 0, nb = NB_STATIC + t->nb_entries;
+    char *dup_name, *dup_value;
+
+    for (uint32_t i = 1; i <= nb; i++) {
+        const char *n, *v;
+        table_get(t, i, &n, &v);
+        if (strcmp(n, name))
+            continue;
+        if (!strcmp(v, value) && !(flags & HPACK_FLAG_NEVER_INDEX)) {
+            encode_int(bp, 0x80, 7, i);
+            return;
+        }
+        if (!name_index)
+            name_index = i;
+    }
+
+    if (flags & HPACK_FLAG_NEVER_INDEX)
+        encode_int(bp, 0x10, 4, name_index);
+    else if (flags & HPACK_FLAG_NO_INDEX)
+        encode_int(bp, 0x00, 4, name_index);
+    else
+        encode_int(bp, 0x40, 6, name_index);
+    if (!name_index)
+        encode_string(bp, name);
+    encode_string(bp, value);
+
+    if (flags & (HPACK_FLAG_NO_INDEX | HPACK_FLAG_NEVER_INDEX))
+        return;
+    /* on allocation failure the peer indexes an entry we forgot about, so
+     * stop indexing altogether rather than get out of sync */
+    dup_name  = av_strdup(name);
+    dup_value = av_strdup(value);
+    if (!dup_name || !dup_value) {
+        av_free(dup_name);
+        av_free(dup_value);
+        dup_name = dup_value = NULL;
+    }
+    if (!dup_name || table_add(t, dup_name, dup_value) < 0) {
+        t->max_size = 0;
+        t->pending_update = 1;
+        table_evict(t, 0);
+    }
+}
+
+int ff_hpack_decode(HPACKTable *t, const uint8_t *buf, int size, int limit,
+                    int (*field)(void *opaque, const char *name, const char *value),
+                    void *opaque)
+{
+    const uint8_t *p = buf, *end = buf + size;
+    int fields = 0, ret = 0;
+
+    while (p < end) {
+        const char *n, *v;
+        char *name = NULL, *value = NULL;
+        uint32_t index;
+        int add = 0;
+
+        if (*p & 0x80) {
+            if ((ret = decode_int(&p, end, 7, &index)) < 0 ||
+                (ret = table_get(t, index, &n, &v)) < 0 ||
+                (ret = field(opaque, n, v)) < 0)
+                return ret;
+            fields++;
+            continue;
+        }
+        if ((*p & 0xe0) == 0x20) {
+            /* size updates may only start a block */
+            if (fields || (ret = decode_int(&p, end, 5, &index)) < 0)
+                return AVERROR_INVALIDDATA;
+            if (index > limit)
+                return AVERROR_INVALIDDATA;
+            t->max_size = index;
+            table_evict(t, index);
+            continue;
+        }
+
+        add = (*p & 0xc0) == 0x40;
+        if ((ret = decode_int(&p, end, add ? 6 : 4, &index)) < 0)
+            return ret;
+        if (index) {
+            if ((ret = table_get(t, index, &n, &v)) < 0)
+                return ret;
+            if (!(name = av_strdup(n)))
+                return AVERROR(ENOMEM);
+        } else if ((ret = decode_string(&p, end, &name)) < 0) {
+            return ret;
+        }
+        if ((ret = decode_string(&p, end, &value)) < 0) {
+            av_free(name);
+            return ret;
+        }
+
+        ret = field(opaque, name, value);
+        fields++;
+        if (ret >= 0 && add)
+            ret = table_add(t, name, value);
+        else {
+            av_free(name);
+            av_free(value);
+        }
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * HPACK header compression for HTTP/2 (RFC 7541)
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HPACK_H
+#define AVFORMAT_HPACK_H
+
+#include <stdint.h>
+
+#include "libavutil/bprint.h"
+
+#define HPACK_DEFAULT_TABLE_SIZE 4096
+
+/** Do not add the field to the dynamic table. */
+#define HPACK_FLAG_NO_INDEX    0x1
+/** Ask intermediaries never to index the field either, e.g. for credentials. */
+#define HPACK_FLAG_NEVER_INDEX 0x2
+
+typedef struct HPACKEntry {
+    char *name;
+    char *value;
+} HPACKEntry;
+
+/**
+ * Dynamic table of an encoder or a decoder, newest entry first.
+ */
+typedef struct HPACKTable {
+    HPACKEntry *entries;
+    int nb_entries;
+    int size;           ///< sum of the entry sizes as defined by the RFC
+    int max_size;
+    int pending_update; ///< encoder only: a size update must be signalled
+} HPACKTable;
+
+void ff_hpack_table_init(HPACKTable *t, int max_size);
+
+void ff_hpack_table_uninit(HPACKTable *t);
+
+/**
+ * Change the size of an encoder table, as allowed by the peer. The change is
+ * signalled at the start of the next header block.
+ */
+void ff_hpack_set_max_size(HPACKTable *t, int max_size);
+
+/**
+ * Start a header block, emitting a pending table size update.
+ */
+void ff_hpack_encode_start(HPACKTable *t, AVBPrint *bp);
+
+/**
+ * Append one header field to a header block. Fields already in the tables
+ * are sent as an index, others are added to the dynamic table unless flags
+ * say otherwise. Names must be lowercase.
+ */
+void ff_hpack_encode_field(HPACKTable *t, AVBPrint *bp, const char *name,
+                           const char *value, int flags);
+
+/**
+ * Decode a complete header block, calling field() for each header field in
+ * order. Decoding stops at the first error returned by field().
+ *
+ * @param limit largest table size the decoder accepts from the peer
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_hpack_decode(HPACKTable *t, const uint8_t *buf, int size, int limit,
+                    int (*field)(void *opaque, const char *name, const char *value),
+                    void *opaque);
+
+#endif /* AVFORMAT_HPACK_H */
@@ -34,6 +34,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h" //PLEX
 
 #include "avformat.h"
 #include "http.h"
@@ -56,6 +57,18 @@
 #define BUFFER_SIZE   (MAX_URL_SIZE + HTTP_HEADERS_SIZE)
 #define MAX_REDIRECTS 8
 #define MAX_CACHED_REDIRECTS 32
+//PLEX
+#define HTTP_POOL_SIZE         8
+#define HTTP_POOL_IDLE_TIMEOUT (5 * 1000000)    /* in microseconds */
+#define HTTP_POOL_MAX_DRAIN    (64 * 1024)      /* reply bytes read to free a connection */
+#define HTTP_MULTI_MAX         16
+
+enum HTTP2Mode {
+    HTTP2_OFF,
+    HTTP2_TLS,
+    HTTP2_PRIOR_KNOWLEDGE,
+};
+//PLEX
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
 #define MAX_EXPIRY    19
@@ -67,6 +80,8 @@ typedef enum {
     FINISH
 }HandshakeState;
 
+struct HTTPMulti; //PLEX
+
 typedef struct HTTPContext {
     const AVClass *class;
     URLContext *hd;
@@ -140,8 +155,34 @@ typedef struct HTTPContext {
     char *new_location;
     AVDictionary *redirect_cache;
     uint64_t filesize_from_content_range;
+    //PLEX
+    int connection_pool;
+    char pool_key[1024];
+    int multi_connections;
+    int multi_chunk_size;
+    int multi_failed;
+    struct HTTPMulti *multi;
+    int http2;
+    //PLEX
 } HTTPContext;
 
+//PLEX
+/**
+ * Idle keep-alive connections shared by all HTTP contexts of the process,
+ * keyed by the URL of the lower protocol (tcp://host:port, tls://host:port
+ * or the proxy).
+ */
+typedef struct HTTPPoolEntry {
+    char key[1024];
+    URLContext *hd;
+    AVIOInterruptCB int_cb;
+    int64_t idle_since;
+} HTTPPoolEntry;
+
+static AVMutex http_pool_lock = AV_MUTEX_INITIALIZER;
+static HTTPPoolEntry http_pool[HTTP_POOL_SIZE];
+//PLEX
+
 #define OFFSET(x) offsetof(HTTPContext, x)
 #define D AV_OPT_FLAG_DECODING_PARAM
 #define E AV_OPT_FLAG_ENCODING_PARAM
@@ -182,6 +223,15 @@ static const AVOption options[] = {
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
     { "short_seek_size", "Threshold to favor readahead over seek.", OFFSET(short_seek_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    //PLEX
+    { "connection_pool", "reuse idle keep-alive connections across contexts", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D | E },
+    { "multi_connections", "read large files through this many concurrent range requests", OFFSET(multi_connections), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, HTTP_MULTI_MAX, D },
+    { "multi_chunk_size", "size of the range requested by each connection", OFFSET(multi_chunk_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 64 * 1024, 64 << 20, D },
+    { "http2", "send requests over shared HTTP/2 connections", OFFSET(http2), AV_OPT_TYPE_INT, { .i64 = HTTP2_OFF }, HTTP2_OFF, HTTP2_PRIOR_KNOWLEDGE, D | E, "http2" },
+    { "off", "always use HTTP/1.1", 0, AV_OPT_TYPE_CONST, { .i64 = HTTP2_OFF }, 0, 0, D | E, "http2" },
+    { "tls", "use HTTP/2 with https servers that offer it", 0, AV_OPT_TYPE_CONST, { .i64 = HTTP2_TLS }, 0, 0, D | E, "http2" },
+    { "prior_knowledge", "also use HTTP/2 with plain http servers, without negotiation", 0, AV_OPT_TYPE_CONST, { .i64 = HTTP2_PRIOR_KNOWLEDGE }, 0, 0, D | E, "http2" },
+    //PLEX
     { NULL }
 };
 
@@ -190,6 +240,159 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                         const char *proxyauth);
 static int http_read_header(URLContext *h);
 static int http_shutdown(URLContext *h, int flags);
+static int http_buf_read(URLContext *h, uint8_t *buf, int size);
+
+//PLEX
+/* TLS connections keep the interrupt callback they were opened with in
+ * their lower layers, so only hand them to users of the same callback. */
+static int http_pool_match(const HTTPPoolEntry *e, const char *key,
+                           const AVIOInterruptCB *int_cb)
+{
+    if (strcmp(e->key, key))
+        return 0;
+    return !av_strstart(key, "tls:", NULL) ||
+           (e->int_cb.callback == int_cb->callback &&
+            e->int_cb.opaque   == int_cb->opaque);
+}
+
+/* A parked connection must have nothing to read; data or EOF means the
+ * server has given up on it. */
+static int http_pool_alive(URLContext *hd)
+{
+    uint8_t byte;
+    int ret;
+
+    hd->flags |= AVIO_FLAG_NONBLOCK;
+    ret = ffurl_read(hd, &byte, 1);
+    hd->flags &= ~AVIO_FLAG_NONBLOCK;
+    return ret == AVERROR(EAGAIN);
+}
+
+static URLContext *http_pool_take(URLContext *h, const char *key)
+{
+    URLContext *hd = NULL, *stale[HTTP_POOL_SIZE];
+    int64_t now = av_gettime_relative();
+    int nb_stale = 0;
+
+    ff_mutex_lock(&http_pool_lock);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        HTTPPoolEntry *e = &http_pool[i];
+        if (!e->hd)
+            continue;
+        if (now - e->idle_since > HTTP_POOL_IDLE_TIMEOUT) {
+            stale[nb_stale++] = e->hd;
+            e->hd = NULL;
+        } else if (!hd && http_pool_match(e, key, &h->interrupt_callback)) {
+            hd = e->hd;
+            e->hd = NULL;
+        }
+    }
+    ff_mutex_unlock(&http_pool_lock);
+
+    while (nb_stale)
+        ffurl_closep(&stale[--nb_stale]);
+
+    if (hd) {
+        hd->interrupt_callback = h->interrupt_callback;
+        av_log(h, AV_LOG_DEBUG, "Reusing pooled connection to %s\n", key);
+    }
+    return hd;
+}
+
+static void http_pool_put(URLContext *h, URLContext *hd, const char *key)
+{
+    URLContext *victim = NULL;
+    HTTPPoolEntry *slot = NULL;
+
+    ff_mutex_lock(&http_pool_lock);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        HTTPPoolEntry *e = &http_pool[i];
+        if (!e->hd) {
+            slot = e;
+            break;
+        }
+        if (!slot || e->idle_since < slot->idle_since)
+            slot = e;
+    }
+    victim = slot->hd;
+    av_strlcpy(slot->key, key, sizeof(slot->key));
+    slot->int_cb     = h->interrupt_callback;
+    slot->hd         = hd;
+    slot->idle_since = av_gettime_relative();
+    if (!av_strstart(key, "tls:", NULL))
+        hd->interrupt_callback = (AVIOInterruptCB){ 0 };
+    ff_mutex_unlock(&http_pool_lock);
+
+    ffurl_closep(&victim);
+}
+
+static int http_response_complete(HTTPContext *s)
+{
+    uint64_t target_end = s->end_off ? s->end_off : s->filesize;
+
+    if (s->buf_ptr != s->buf_end || s->http_code < 200)
+        return 0;
+    if (s->chunksize != UINT64_MAX)
+        return s->chunkend;
+    if (s->http_code == 204 || s->http_code == 304)
+        return 1;
+    return s->filesize != UINT64_MAX && s->off >= target_end;
+}
+
+/**
+ * Park the connection in the pool if the request on it is finished.
+ * Uploads have their reply read first, as long as it is short.
+ *
+ * @return 1 if the connection was parked
+ */
+static int http_pool_release(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+
+    if (s->listen || !*s->pool_key)
+        return 0;
+
+    if (h->flags & AVIO_FLAG_WRITE) {
+        uint8_t buf[1024];
+        int ret, total = 0;
+
+        if (s->end_chunked_post && !s->end_header)
+            if (http_read_header(h) < 0)
+                return 0;
+        if (!s->end_header ||
+            (s->chunksize == UINT64_MAX && s->filesize == UINT64_MAX &&
+             s->http_code != 204 && s->http_code != 304))
+            return 0;
+        while (total < HTTP_POOL_MAX_DRAIN &&
+               (ret = http_buf_read(h, buf, sizeof(buf))) > 0)
+            total += ret;
+    }
+
+    if (!s->hd || s->willclose || !http_response_complete(s))
+        return 0;
+
+    http_pool_put(h, s->hd, s->pool_key);
+    s->hd = NULL;
+    return 1;
+}
+
+void ff_http_pool_close(void)
+{
+    URLContext *hd[HTTP_POOL_SIZE];
+    int nb = 0;
+
+    ff_mutex_lock(&http_pool_lock);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (http_pool[i].hd)
+            hd[nb++] = http_pool[i].hd;
+        http_pool[i].hd = NULL;
+    }
+    ff_mutex_unlock(&http_pool_lock);
+
+    while (nb)
+        ffurl_closep(&hd[--nb]);
+}
+//PLEX
 
 void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
 {
@@ -211,6 +414,7 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     char path1[MAX_URL_SIZE], sanitized_path[MAX_URL_SIZE + 1];
     char buf[1024], urlbuf[MAX_URL_SIZE];
     int port, use_proxy, err = 0;
+    int reused = 0; //PLEX
     HTTPContext *s = h->priv_data;
 
     av_url_split(proto, sizeof(proto), auth, sizeof(auth),
@@ -266,16 +470,64 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
+    //PLEX
+    /* Requests are carried as streams of a shared connection; servers that
+     * turn h2 down get the usual HTTP/1.1 treatment. */
+    if (!s->hd && !use_proxy && !s->listen && !s->http_proxy &&
+        (s->http2 == HTTP2_PRIOR_KNOWLEDGE ||
+         (s->http2 == HTTP2_TLS && !strcmp(lower_proto, "tls")))) {
+        char h2url[1024];
+
+        ff_url_join(h2url, sizeof(h2url), "http2", NULL, hostname, port,
+                    "?tls=%d", !strcmp(lower_proto, "tls"));
+        err = ffurl_open_whitelist(&s->hd, h2url, AVIO_FLAG_READ_WRITE,
+                                   &h->interrupt_callback, options,
+                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        if (err == AVERROR(ENOSYS)) {
+            err = 0;
+        } else if (err < 0) {
+            goto end;
+        } else {
+            s->pool_key[0] = '\0';
+        }
+    }
+
+    if (!s->hd && s->connection_pool) {
+        av_strlcpy(s->pool_key, buf, sizeof(s->pool_key));
+        while (!s->hd && (s->hd = http_pool_take(h, buf))) {
+            if (!(reused = http_pool_alive(s->hd)))
+                ffurl_closep(&s->hd);
+        }
+    }
+    //PLEX
+
     if (!s->hd) {
         err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
                                    &h->interrupt_callback, options,
                                    h->protocol_whitelist, h->protocol_blacklist, h);
     }
 
+    if (err >= 0) {
+        err = http_connect(h, path, local_path, hoststr, auth, proxyauth);
+        //PLEX
+        /* The server may still have dropped a pooled connection before our
+         * request reached it; retry once on a fresh one. */
+        if (reused && (err == AVERROR_EOF || err == AVERROR(EPIPE) ||
+                       err == AVERROR(ECONNRESET))) {
+            av_log(h, AV_LOG_DEBUG, "Pooled connection to %s was closed, reconnecting\n", buf);
+            ffurl_closep(&s->hd);
+            err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
+                                       &h->interrupt_callback, options,
+                                       h->protocol_whitelist, h->protocol_blacklist, h);
+            if (err >= 0)
+                err = http_connect(h, path, local_path, hoststr, auth, proxyauth);
+        }
+        //PLEX
+    }
+
 end:
     freeenv_utf8(env_http_proxy);
-    return err < 0 ? err : http_connect(
-        h, path, local_path, hoststr, auth, proxyauth);
+    return err;
 }
 
 static int http_should_reconnect(HTTPContext *s, int err)
@@ -1514,7 +1766,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
         av_bprintf(&request, "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: "))
-        av_bprintf(&request, "Connection: %s\r\n", s->multiple_requests ? "keep-alive" : "close");
+        av_bprintf(&request, "Connection: %s\r\n", s->multiple_requests || s->connection_pool ? "keep-alive" : "close"); //PLEX
 
     if (!has_header(s->headers, "\r\nHost: "))
         av_bprintf(&request, "Host: %s\r\n", hoststr);
@@ -1619,7 +1871,7 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
                    "Chunked encoding data size: %"PRIu64"\n",
                     s->chunksize);
 
-            if (!s->chunksize && s->multiple_requests) {
+            if (!s->chunksize && (s->multiple_requests || s->connection_pool)) { //PLEX
                 http_get_line(s, line, sizeof(line)); // read empty chunk
                 s->chunkend = 1;
                 return 0;
@@ -1838,10 +2090,305 @@ static int store_icy(URLContext *h, int size)
     return FFMIN(size, remaining);
 }
 
+//PLEX
+/**
+ * Multi-connection reads: chunk k of the file, starting at base, is fetched
+ * into slot k % nb_slots by that slot's worker using its own range request.
+ * The slots form a reorder buffer that is consumed in file order, and a
+ * slot is refilled with its next chunk once it has been read completely.
+ */
+enum HTTPMultiSlotState {
+    MULTI_SLOT_EMPTY,
+    MULTI_SLOT_FETCHING,
+    MULTI_SLOT_DONE,
+};
+
+typedef struct HTTPMultiSlot {
+    struct HTTPMulti *m;
+    int64_t chunk;
+    int state;
+    int ret;
+    uint8_t *data;
+    int len;
+    int pos;
+#if HAVE_THREADS
+    pthread_t thread;
+    int thread_started;
+#endif
+} HTTPMultiSlot;
+
+typedef struct HTTPMulti {
+    URLContext *h;
+    uint64_t base, end;
+    int chunk_size;
+    int64_t chunk;          /* chunk being consumed */
+    int abort;
+    AVMutex lock;
+    AVCond cond;
+    int nb_slots;
+    HTTPMultiSlot slots[HTTP_MULTI_MAX];
+} HTTPMulti;
+
+#if HAVE_THREADS
+static int http_multi_interrupt_cb(void *opaque)
+{
+    HTTPMulti *m = opaque;
+    int abort;
+
+    ff_mutex_lock(&m->lock);
+    abort = m->abort;
+    ff_mutex_unlock(&m->lock);
+    return abort || ff_check_interrupt(&m->h->interrupt_callback);
+}
+
+/* Fetch one range into the slot buffer on a connection of its own, which
+ * inherits the options of the parent context. */
+static int http_multi_fetch(HTTPMulti *m, HTTPMultiSlot *slot, uint64_t start, int size)
+{
+    URLContext *h = m->h, *hd = NULL;
+    HTTPContext *s = h->priv_data, *cs;
+    AVIOInterruptCB int_cb = { http_multi_interrupt_cb, m };
+    AVDictionary *options = NULL;
+    int ret;
+
+    if ((ret = ffurl_alloc(&hd, s->location, AVIO_FLAG_READ, &int_cb)) < 0)
+        return ret;
+    if (strcmp(hd->prot->name, "http") && strcmp(hd->prot->name, "https")) {
+        ret = AVERROR(ENOSYS);
+        goto end;
+    }
+    cs = hd->priv_data;
+    if ((ret = av_opt_copy(cs, s)) < 0)
+        goto end;
+    av_freep(&cs->location);
+    cs->off               = start;
+    cs->end_off           = start + size;
+    cs->seekable          = 1;
+    cs->icy               = 0;
+    cs->multi_connections = 0;
+    cs->connection_pool   = 1;
+
+    if ((h->protocol_whitelist && !(hd->protocol_whitelist = av_strdup(h->protocol_whitelist))) ||
+        (h->protocol_blacklist && !(hd->protocol_blacklist = av_strdup(h->protocol_blacklist)))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    av_dict_copy(&options, s->chained_options, 0);
+    if ((ret = ffurl_connect(hd, &options)) < 0)
+        goto end;
+    /* the server ignored the range */
+    if (cs->http_code != 206 || cs->off != start) {
+        ret = AVERROR(ENOSYS);
+        goto end;
+    }
+
+    slot->len = 0;
+    while (slot->len < size) {
+        ret = ffurl_read(hd, slot->data + slot->len, size - slot->len);
+        if (ret == AVERROR_EOF)
+            ret = AVERROR(EIO);
+        if (ret < 0)
+            goto end;
+        slot->len += ret;
+    }
+    ret = 0;
+
+end:
+    av_dict_free(&options);
+    ffurl_closep(&hd);
+    return ret;
+}
+
+static void *http_multi_worker(void *arg)
+{
+    HTTPMultiSlot *slot = arg;
+    HTTPMulti *m = slot->m;
+
+    ff_mutex_lock(&m->lock);
+    for (;;) {
+        uint64_t start;
+        int ret;
+
+        while (!m->abort && slot->state != MULTI_SLOT_EMPTY)
+            ff_cond_wait(&m->cond, &m->lock);
+        if (m->abort)
+            break;
+        slot->state = MULTI_SLOT_FETCHING;
+        start = m->base + slot->chunk * m->chunk_size;
+        ff_mutex_unlock(&m->lock);
+
+        if (start >= m->end)
+            ret = AVERROR_EOF;
+        else
+            ret = http_multi_fetch(m, slot, start, FFMIN(m->chunk_size, m->end - start));
+
+        ff_mutex_lock(&m->lock);
+        slot->ret   = ret;
+        slot->pos   = 0;
+        slot->state = MULTI_SLOT_DONE;
+        ff_cond_broadcast(&m->cond);
+    }
+    ff_mutex_unlock(&m->lock);
+    return NULL;
+}
+
+static void http_multi_free(HTTPMulti **pm)
+{
+    HTTPMulti *m = *pm;
+
+    if (!m)
+        return;
+    ff_mutex_lock(&m->lock);
+    m->abort = 1;
+    ff_cond_broadcast(&m->cond);
+    ff_mutex_unlock(&m->lock);
+    for (int i = 0; i < m->nb_slots; i++) {
+        if (m->slots[i].thread_started)
+            pthread_join(m->slots[i].thread, NULL);
+        av_free(m->slots[i].data);
+    }
+    ff_cond_destroy(&m->cond);
+    ff_mutex_destroy(&m->lock);
+    av_freep(pm);
+}
+
+static int http_multi_start(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t end = s->end_off ? s->end_off : s->filesize;
+    HTTPMulti *m;
+    int ret;
+
+    /* only plain reads of a known size from a server honouring ranges */
+    if (s->multi_failed || h->is_streamed || s->filesize == UINT64_MAX ||
+        s->post_data || s->icy_metaint || s->chunksize != UINT64_MAX ||
+        s->buf_ptr != s->buf_end ||
+#if CONFIG_ZLIB
+        s->compressed ||
+#endif
+        end <= s->off || end - s->off < 2ULL * s->multi_chunk_size)
+        return 0;
+
+    m = av_mallocz(sizeof(*m));
+    if (!m)
+        return AVERROR(ENOMEM);
+    if ((ret = ff_mutex_init(&m->lock, NULL))) {
+        av_free(m);
+        return AVERROR(ret);
+    }
+    if ((ret = ff_cond_init(&m->cond, NULL))) {
+        ff_mutex_destroy(&m->lock);
+        av_free(m);
+        return AVERROR(ret);
+    }
+    m->h          = h;
+    m->base       = s->off;
+    m->end        = end;
+    m->chunk_size = s->multi_chunk_size;
+    s->multi      = m;
+
+    for (int i = 0; i < s->multi_connections; i++) {
+        HTTPMultiSlot *slot = &m->slots[i];
+
+        slot->m     = m;
+        slot->chunk = i;
+        slot->data  = av_malloc(m->chunk_size);
+        if (!slot->data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        m->nb_slots++;
+        if ((ret = pthread_create(&slot->thread, NULL, http_multi_worker, slot))) {
+            ret = AVERROR(ret);
+            goto fail;
+        }
+        slot->thread_started = 1;
+    }
+
+    /* the workers take over from the current connection */
+    ffurl_closep(&s->hd);
+    av_log(h, AV_LOG_VERBOSE, "Reading from offset %"PRIu64" with %d connections\n",
+           s->off, m->nb_slots);
+    return 0;
+
+fail:
+    http_multi_free(&s->multi);
+    return ret;
+}
+
+static int http_multi_read(URLContext *h, uint8_t *buf, int size)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPMulti *m = s->multi;
+    HTTPMultiSlot *slot = &m->slots[m->chunk % m->nb_slots];
+    int ret;
+
+    ff_mutex_lock(&m->lock);
+    while (slot->state != MULTI_SLOT_DONE)
+        ff_cond_wait(&m->cond, &m->lock);
+    ret = slot->ret;
+    if (ret >= 0) {
+        ret = FFMIN(size, slot->len - slot->pos);
+        memcpy(buf, slot->data + slot->pos, ret);
+        slot->pos += ret;
+        if (slot->pos == slot->len) {
+            slot->chunk += m->nb_slots;
+            slot->state  = MULTI_SLOT_EMPTY;
+            m->chunk++;
+            ff_cond_broadcast(&m->cond);
+        }
+    }
+    ff_mutex_unlock(&m->lock);
+
+    if (ret > 0)
+        s->off += ret;
+    return ret;
+}
+#else
+static void http_multi_free(struct HTTPMulti **pm)
+{
+}
+
+static int http_multi_start(URLContext *h)
+{
+    return 0;
+}
+
+static int http_multi_read(URLContext *h, uint8_t *buf, int size)
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+//PLEX
+
 static int http_read(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
 
+    //PLEX
+    if (s->multi_connections > 1 && !s->multi) {
+        int ret = http_multi_start(h);
+        if (ret < 0)
+            return ret;
+    }
+    if (s->multi) {
+        int ret = http_multi_read(h, buf, size);
+        if (ret >= 0 || ret == AVERROR_EOF || ret == AVERROR_EXIT)
+            return ret;
+
+        av_log(h, AV_LOG_WARNING, "Ranged read failed (%s), falling back to a single connection\n",
+               av_err2str(ret));
+        http_multi_free(&s->multi);
+        s->multi_failed = 1;
+    }
+    /* resume on a single connection where the workers left off */
+    if (!s->hd && s->multi_connections > 1) {
+        int64_t ret = http_seek_internal(h, s->off, SEEK_SET, 1);
+        if (ret < 0)
+            return ret;
+    }
+    //PLEX
+
     if (s->icy_metaint > 0) {
         size = store_icy(h, size);
         if (size < 0)
@@ -1881,6 +2428,33 @@ static int http_write(URLContext *h, const uint8_t *buf, int size)
     return size;
 }
 
+//PLEX
+static int http_write_from_fd(URLContext *h, int fd, int64_t offset, int size)
+{
+    char temp[11] = "";  /* 32-bit hex + CRLF + nul */
+    char crlf[] = "\r\n";
+    HTTPContext *s = h->priv_data;
+    int ret;
+
+    if (!s->hd || !s->hd->prot->url_write_from_fd)
+        return AVERROR(ENOSYS);
+    if (!s->chunked_post)
+        return ffurl_write_from_fd(s->hd, fd, offset, size);
+    if (size <= 0)
+        return size;
+
+    snprintf(temp, sizeof(temp), "%x\r\n", size);
+    if ((ret = ffurl_write(s->hd, temp, strlen(temp))) < 0)
+        return ret;
+    /* the chunk header is out, so there is no falling back any more */
+    if ((ret = ffurl_write_from_fd(s->hd, fd, offset, size)) < 0)
+        return ret == AVERROR(ENOSYS) ? AVERROR(EIO) : ret;
+    if ((ret = ffurl_write(s->hd, crlf, sizeof(crlf) - 1)) < 0)
+        return ret;
+    return size;
+}
+//PLEX
+
 static int http_shutdown(URLContext *h, int flags)
 {
     int ret = 0;
@@ -1924,6 +2498,12 @@ static int http_close(URLContext *h)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
+    //PLEX
+    http_multi_free(&s->multi);
+    if (s->hd && s->connection_pool && ret >= 0)
+        http_pool_release(h);
+    //PLEX
+
     if (s->hd)
         ffurl_closep(&s->hd);
     av_dict_free(&s->chained_options);
@@ -1960,6 +2540,17 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
         return AVERROR(EINVAL);
     if (off < 0)
         return AVERROR(EINVAL);
+
+    //PLEX
+    /* the workers restart at the new position on the next read */
+    if (s->multi) {
+        http_multi_free(&s->multi);
+        if (!force_reconnect) {
+            s->off = off;
+            return off;
+        }
+    }
+    //PLEX
     s->off = off;
 
     if (s->off && h->is_streamed)
@@ -2039,6 +2630,7 @@ const URLProtocol ff_http_protocol = {
     .url_handshake       = http_handshake,
     .url_read            = http_read,
     .url_write           = http_write,
+    .url_write_from_fd   = http_write_from_fd, //PLEX
     .url_seek            = http_seek,
     .url_close           = http_close,
     .url_get_file_handle = http_get_file_handle,
@@ -2047,7 +2639,7 @@ const URLProtocol ff_http_protocol = {
     .priv_data_size      = sizeof(HTTPContext),
     .priv_data_class     = &http_context_class,
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
-    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,httpproxy,data"
+    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,httpproxy,data,http2"
 };
 #endif /* CONFIG_HTTP_PROTOCOL */
 
@@ -2067,7 +2659,7 @@ const URLProtocol ff_https_protocol = {
     .priv_data_size      = sizeof(HTTPContext),
     .priv_data_class     = &https_context_class,
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
-    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,httpproxy"
+    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,httpproxy,http2"
 };
 #endif /* CONFIG_HTTPS_PROTOCOL */
 
@@ -0,0 +1,1293 @@
+/*
+ * HTTP/2 transport for the http protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * HTTP/2 (RFC 9113) client transport.
+ *
+ * Each http2:// context is a byte stream with the same shape as the TCP or
+ * TLS connection the http protocol normally writes its requests to: the
+ * HTTP/1.1 request written to it is sent as an HTTP/2 stream, and the
+ * response is read back as HTTP/1.1 text. All contexts to the same server
+ * share one connection, so concurrent requests (segments, ranges, keys) are
+ * multiplexed instead of each paying for its own TCP and TLS handshake.
+ *
+ * A reader thread per connection demultiplexes the incoming frames into the
+ * buffers of the streams and answers control frames. Opening fails with
+ * AVERROR(ENOSYS) if the server did not pick h2 through ALPN, in which case
+ * the caller can fall back to HTTP/1.1.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/fifo.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "hpack.h"
+#include "network.h"
+#include "url.h"
+
+#define FRAME_DATA          0x0
+#define FRAME_HEADERS       0x1
+#define FRAME_PRIORITY      0x2
+#define FRAME_RST_STREAM    0x3
+#define FRAME_SETTINGS      0x4
+#define FRAME_PUSH_PROMISE  0x5
+#define FRAME_PING          0x6
+#define FRAME_GOAWAY        0x7
+#define FRAME_WINDOW_UPDATE 0x8
+#define FRAME_CONTINUATION  0x9
+
+#define FLAG_END_STREAM     0x01
+#define FLAG_ACK            0x01
+#define FLAG_END_HEADERS    0x04
+#define FLAG_PADDED         0x08
+#define FLAG_PRIORITY       0x20
+
+#define SETTINGS_HEADER_TABLE_SIZE      0x1
+#define SETTINGS_ENABLE_PUSH            0x2
+#define SETTINGS_MAX_CONCURRENT_STREAMS 0x3
+#define SETTINGS_INITIAL_WINDOW_SIZE    0x4
+
+#define ERROR_NO_ERROR      0x0
+#define ERROR_PROTOCOL      0x1
+#define ERROR_FLOW_CONTROL  0x3
+#define ERROR_FRAME_SIZE    0x6
+#define ERROR_CANCEL        0x8
+#define ERROR_COMPRESSION   0x9
+
+#define FRAME_HEADER_SIZE   9
+/* frame size and window defined by the RFC until changed by SETTINGS;
+ * we never announce larger frames, nor send them */
+#define FRAME_SIZE          16384
+#define DEFAULT_WINDOW      65535
+/* receive windows we announce */
+#define STREAM_WINDOW       (1 << 20)
+#define CONN_WINDOW         (16 << 20)
+#define MAX_HEADER_BLOCK    (256 * 1024)
+#define MAX_REQUEST_HEAD    (64 * 1024)
+#define MAX_REQUEST_FIELDS  128
+#define MAX_STREAM_ID       0x7fffffff
+
+#define POLL_MS             100
+#define IDLE_TIMEOUT        (30 * 1000000)
+/* how long a server that did not pick h2 is remembered */
+#define NO_H2_TIMEOUT       (600 * 1000000LL)
+
+static const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+typedef struct H2Stream {
+    uint32_t id;
+    /* the response, as HTTP/1.1 text */
+    AVFifo *rbuf;
+    int head_queued;            /* bytes at the front of rbuf that are not body */
+    int64_t send_window;
+    int recv_window;
+    int unacked;                /* body bytes consumed but not given back yet */
+    int headers_done;
+    int local_closed;
+    int remote_closed;
+    int error;
+    struct H2Stream *next;
+} H2Stream;
+
+typedef struct H2Connection {
+    char *key;
+    URLContext *hd;
+    int fd;
+    int64_t expires;            /* negative entries only, hd is NULL */
+    AVIOInterruptCB *int_cb;
+
+    /* Lock order is write_lock, lock, io_lock. io_lock is only held for
+     * single calls to the transport, which is nonblocking. */
+    AVMutex lock;
+    AVCond cond;
+    AVMutex write_lock;
+    AVMutex io_lock;
+
+    /* write_lock */
+    HPACKTable encoder;
+    uint32_t next_stream_id;
+    uint8_t *wbuf;
+
+    /* lock */
+    H2Stream *streams;
+    int refs;
+    int nb_streams;
+    int error;
+    int goaway;
+    int64_t send_window;
+    int peer_window;
+    int peer_max_streams;
+    int peer_table_size;
+    int64_t idle_since;
+    AVBPrint control;           /* control frames waiting to be sent */
+
+    /* reader thread */
+    HPACKTable decoder;
+    uint8_t *rbuf;
+    int rbuf_len;
+    AVBPrint header_block;
+    uint32_t header_stream;
+    int header_end_stream;
+    int conn_unacked;
+
+    int thread_started;
+    pthread_t thread;
+    struct H2Connection *next;
+} H2Connection;
+
+enum RequestState {
+    REQ_HEAD,
+    REQ_BODY,
+    REQ_CHUNK_SIZE,
+    REQ_CHUNK_DATA,
+    REQ_CHUNK_END,
+    REQ_TRAILER,
+    REQ_DONE,
+};
+
+typedef struct HTTP2Context {
+    const AVClass *class;
+    int tls;
+
+    char authority[1024];
+    H2Connection *conn;
+    H2Stream *st;
+    enum RequestState state;
+    AVBPrint head;
+    int64_t body_left;
+    char line[64];
+    int line_len;
+} HTTP2Context;
+
+static AVMutex conns_lock = AV_MUTEX_INITIALIZER;
+static H2Connection *conns;
+
+static void frame_header(uint8_t *p, int len, int type, int flags, uint32_t id)
+{
+    AV_WB24(p, len);
+    p[3] = type;
+    p[4] = flags;
+    AV_WB32(p + 5, id & MAX_STREAM_ID);
+}
+
+static void conn_fail(H2Connection *conn, int err)
+{
+    ff_mutex_lock(&conn->lock);
+    if (!conn->error)
+        conn->error = err;
+    ff_cond_broadcast(&conn->cond);
+    ff_mutex_unlock(&conn->lock);
+}
+
+/* Wait for a change of the connection state. Must hold lock. */
+static int conn_wait(URLContext *h, H2Connection *conn, int64_t *start)
+{
+    int64_t t = av_gettime() + POLL_MS * 1000;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+
+    if (!*start)
+        *start = av_gettime_relative();
+    else if (h->rw_timeout > 0 && av_gettime_relative() - *start > h->rw_timeout)
+        return AVERROR(ETIMEDOUT);
+    if (ff_check_interrupt(&h->interrupt_callback))
+        return AVERROR_EXIT;
+    ff_cond_timedwait(&conn->cond, &conn->lock, &tv);
+    return 0;
+}
+
+/* Must hold write_lock. */
+static int conn_write_raw(H2Connection *conn, const uint8_t *buf, int size)
+{
+    int64_t wait_since = 0;
+    int ret, err;
+
+    while (size > 0) {
+        ff_mutex_lock(&conn->lock);
+        err = conn->error;
+        ff_mutex_unlock(&conn->lock);
+        if (err)
+            return err;
+
+        ff_mutex_lock(&conn->io_lock);
+        ret = ffurl_write(conn->hd, buf, size);
+        ff_mutex_unlock(&conn->io_lock);
+        if (ret > 0) {
+            buf  += ret;
+            size -= ret;
+            wait_since = 0;
+        } else if (ret == AVERROR(EAGAIN) || !ret) {
+            struct pollfd p = { .fd = conn->fd, .events = POLLOUT };
+            if (!wait_since) {
+                wait_since = av_gettime_relative();
+            } else if (av_gettime_relative() - wait_since > IDLE_TIMEOUT) {
+                conn_fail(conn, AVERROR(ETIMEDOUT));
+                return AVERROR(ETIMEDOUT);
+            }
+            poll(&p, 1, POLL_MS);
+        } else {
+            conn_fail(conn, ret);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+/* Must hold write_lock. */
+static int conn_write_frame(H2Connection *conn, int type, int flags, uint32_t id,
+                            const uint8_t *payload, int size)
+{
+    /* a single write, so that Nagle does not split header and payload */
+    frame_header(conn->wbuf, size, type, flags, id);
+    if (size)
+        memcpy(conn->wbuf + FRAME_HEADER_SIZE, payload, size);
+    return conn_write_raw(conn, conn->wbuf, FRAME_HEADER_SIZE + size);
+}
+
+/* Queue a frame to be sent by conn_flush_control(). Must hold lock. */
+static void conn_queue_frame(H2Connection *conn, int type, int flags, uint32_t id,
+                             const uint8_t *payload, int size)
+{
+    uint8_t hdr[FRAME_HEADER_SIZE];
+
+    frame_header(hdr, size, type, flags, id);
+    av_bprint_append_data(&conn->control, hdr, sizeof(hdr));
+    av_bprint_append_data(&conn->control, payload, size);
+}
+
+static void conn_queue_rst(H2Connection *conn, uint32_t id, uint32_t code)
+{
+    uint8_t payload[4];
+
+    AV_WB32(payload, code);
+    conn_queue_frame(conn, FRAME_RST_STREAM, 0, id, payload, sizeof(payload));
+}
+
+static void conn_queue_window_update(H2Connection *conn, uint32_t id, int inc)
+{
+    uint8_t payload[4];
+
+    AV_WB32(payload, inc);
+    conn_queue_frame(conn, FRAME_WINDOW_UPDATE, 0, id, payload, sizeof(payload));
+}
+
+static int conn_flush_control(H2Connection *conn)
+{
+    char *buf = NULL;
+    unsigned len;
+    int ret = 0;
+
+    ff_mutex_lock(&conn->write_lock);
+    ff_mutex_lock(&conn->lock);
+    len = conn->control.len;
+    if (len) {
+        if (!av_bprint_is_complete(&conn->control)) {
+            ret = AVERROR(ENOMEM);
+        } else {
+            av_bprint_finalize(&conn->control, &buf);
+        }
+        av_bprint_init(&conn->control, 0, AV_BPRINT_SIZE_UNLIMITED);
+    }
+    ff_mutex_unlock(&conn->lock);
+
+    if (ret < 0)
+        conn_fail(conn, ret);
+    else if (buf)
+        ret = conn_write_raw(conn, buf, len);
+    ff_mutex_unlock(&conn->write_lock);
+
+    av_free(buf);
+    return ret;
+}
+
+static H2Stream *conn_find_stream(H2Connection *conn, uint32_t id)
+{
+    H2Stream *st;
+
+    for (st = conn->streams; st; st = st->next)
+        if (st->id == id)
+            break;
+    return st;
+}
+
+/* Give consumed body bytes back to the peer. Must hold lock. */
+static void stream_update_window(H2Connection *conn, H2Stream *st)
+{
+    if (!st->remote_closed && st->unacked >= STREAM_WINDOW / 2) {
+        conn_queue_window_update(conn, st->id, st->unacked);
+        st->recv_window += st->unacked;
+        st->unacked = 0;
+    }
+}
+
+typedef struct HeaderParser {
+    H2Stream *st;
+    AVBPrint text;
+    int status;
+    int has_length;
+} HeaderParser;
+
+static int header_field(void *opaque, const char *name, const char *value)
+{
+    HeaderParser *hp = opaque;
+
+    if (!hp->st)
+        return 0;
+    if (*name == ':') {
+        if (!strcmp(name, ":status"))
+            hp->status = strtol(value, NULL, 10);
+        return 0;
+    }
+    if (!strcmp(name, "content-length"))
+        hp->has_length = 1;
+    av_bprintf(&hp->text, "%s: %s\r\n", name, value);
+    return 0;
+}
+
+/* Must hold lock. */
+static int conn_header_block(H2Connection *conn)
+{
+    H2Stream *st = conn_find_stream(conn, conn->header_stream);
+    HeaderParser hp = { 0 };
+    int ret;
+
+    /* trailers and blocks of reset streams are decoded all the same, to keep
+     * the decoder table in sync */
+    if (st && !st->headers_done)
+        hp.st = st;
+    av_bprint_init(&hp.text, 0, AV_BPRINT_SIZE_UNLIMITED);
+    ret = ff_hpack_decode(&conn->decoder, conn->header_block.str, conn->header_block.len,
+                          HPACK_DEFAULT_TABLE_SIZE, header_field, &hp);
+    av_bprint_clear(&conn->header_block);
+    if (ret < 0) {
+        av_bprint_finalize(&hp.text, NULL);
+        return ret;
+    }
+
+    if (hp.st) {
+        /* informational responses; Expect was handled on our side */
+        if (hp.status >= 100 && hp.status < 200 && !conn->header_end_stream) {
+            av_bprint_finalize(&hp.text, NULL);
+            return 0;
+        }
+        if (!hp.has_length)
+            av_bprintf(&hp.text, "Connection: close\r\n");
+        av_bprintf(&hp.text, "\r\n");
+        if (!av_bprint_is_complete(&hp.text)) {
+            st->error = AVERROR(ENOMEM);
+        } else {
+            char status[32];
+            int len = snprintf(status, sizeof(status), "HTTP/2.0 %d\r\n", hp.status);
+
+            if (av_fifo_write(st->rbuf, status, len) < 0 ||
+                av_fifo_write(st->rbuf, hp.text.str, hp.text.len) < 0)
+                st->error = AVERROR(ENOMEM);
+            st->head_queued += len + hp.text.len;
+        }
+        st->headers_done = 1;
+    }
+    if (st && conn->header_end_stream)
+        st->remote_closed = 1;
+    av_bprint_finalize(&hp.text, NULL);
+    return 0;
+}
+
+/* Handle one incoming frame. Returns an HTTP/2 error code for errors that
+ * are fatal for the connection. Must hold lock. */
+static int conn_handle_frame(H2Connection *conn, int type, int flags, uint32_t id,
+                             const uint8_t *p, int size)
+{
+    H2Stream *st;
+    int pad = 0;
+
+    if (conn->header_stream && (type != FRAME_CONTINUATION || id != conn->header_stream))
+        return ERROR_PROTOCOL;
+
+    switch (type) {
+    case FRAME_DATA:
+        if (!id)
+            return ERROR_PROTOCOL;
+        if (flags & FLAG_PADDED) {
+            if (size < 1 || p[0] >= size)
+                return ERROR_PROTOCOL;
+            pad = p[0] + 1;
+        }
+        conn->conn_unacked += size;
+        if (conn->conn_unacked >= CONN_WINDOW / 4) {
+            conn_queue_window_update(conn, 0, conn->conn_unacked);
+            conn->conn_unacked = 0;
+        }
+        st = conn_find_stream(conn, id);
+        if (!st || st->remote_closed || st->error)
+            break;
+        if (!st->headers_done)
+            return ERROR_PROTOCOL;
+        if (size > st->recv_window)
+            return ERROR_FLOW_CONTROL;
+        st->recv_window -= size;
+        st->unacked     += pad;
+        if (av_fifo_write(st->rbuf, p + FFMIN(pad, 1), size - pad) < 0) {
+            st->error = AVERROR(ENOMEM);
+            conn_queue_rst(conn, id, ERROR_CANCEL);
+        }
+        if (flags & FLAG_END_STREAM)
+            st->remote_closed = 1;
+        stream_update_window(conn, st);
+        break;
+    case FRAME_HEADERS:
+        if (!id)
+            return ERROR_PROTOCOL;
+        if (flags & FLAG_PADDED) {
+            if (size < 1)
+                return ERROR_PROTOCOL;
+            pad = p[0];
+            p++;
+            size--;
+        }
+        if (flags & FLAG_PRIORITY) {
+            if (size < 5)
+                return ERROR_PROTOCOL;
+            p    += 5;
+            size -= 5;
+        }
+        if (pad > size)
+            return ERROR_PROTOCOL;
+        size -= pad;
+        conn->header_stream     = id;
+        conn->header_end_stream = flags & FLAG_END_STREAM;
+        /* fall through */
+    case FRAME_CONTINUATION:
+        if (!conn->header_stream)
+            return ERROR_PROTOCOL;
+        if (conn->header_block.len + size > MAX_HEADER_BLOCK)
+            return ERROR_PROTOCOL;
+        av_bprint_append_data(&conn->header_block, p, size);
+        if (flags & FLAG_END_HEADERS) {
+            if (!av_bprint_is_complete(&conn->header_block) ||
+                conn_header_block(conn) < 0)
+                return ERROR_COMPRESSION;
+            conn->header_stream = 0;
+        }
+        break;
+    case FRAME_RST_STREAM:
+        if (!id || size != 4)
+            return ERROR_PROTOCOL;
+        st = conn_find_stream(conn, id);
+        if (st && !st->remote_closed && !st->error)
+            st->error = AVERROR(ECONNRESET);
+        break;
+    case FRAME_SETTINGS:
+        if (id)
+            return ERROR_PROTOCOL;
+        if (flags & FLAG_ACK)
+            break;
+        if (size % 6)
+            return ERROR_FRAME_SIZE;
+        for (; size >= 6; p += 6, size -= 6) {
+            uint32_t value = AV_RB32(p + 2);
+
+            switch (AV_RB16(p)) {
+            case SETTINGS_HEADER_TABLE_SIZE:
+                conn->peer_table_size = FFMIN(value, HPACK_DEFAULT_TABLE_SIZE);
+                break;
+            case SETTINGS_MAX_CONCURRENT_STREAMS:
+                conn->peer_max_streams = FFMIN(value, INT_MAX);
+                break;
+            case SETTINGS_INITIAL_WINDOW_SIZE:
+                if (value > MAX_STREAM_ID)
+                    return ERROR_FLOW_CONTROL;
+                for (st = conn->streams; st; st = st->next)
+                    st->send_window += (int64_t)value - conn->peer_window;
+                conn->peer_window = value;
+                break;
+            }
+        }
+        conn_queue_frame(conn, FRAME_SETTINGS, FLAG_ACK, 0, NULL, 0);
+        break;
+    case FRAME_PING:
+        if (id || size != 8)
+            return ERROR_PROTOCOL;
+        if (!(flags & FLAG_ACK))
+            conn_queue_frame(conn, FRAME_PING, FLAG_ACK, 0, p, size);
+        break;
+    case FRAME_GOAWAY:
+        if (id || size < 8)
+            return ERROR_PROTOCOL;
+        conn->goaway = 1;
+        /* streams the server did not process can be retried elsewhere */
+        for (st = conn->streams; st; st = st->next)
+            if (st->id > (AV_RB32(p) & MAX_STREAM_ID) && !st->error)
+                st->error = AVERROR(ECONNRESET);
+        break;
+    case FRAME_WINDOW_UPDATE:
+        if (size != 4)
+            return ERROR_PROTOCOL;
+        if (!id) {
+            conn->send_window += AV_RB32(p) & MAX_STREAM_ID;
+        } else if ((st = conn_find_stream(conn, id))) {
+            st->send_window += AV_RB32(p) & MAX_STREAM_ID;
+        }
+        break;
+    case FRAME_PUSH_PROMISE:
+        /* disabled in our SETTINGS */
+        return ERROR_PROTOCOL;
+    }
+    return ERROR_NO_ERROR;
+}
+
+static void *conn_thread(void *arg)
+{
+    H2Connection *conn = arg;
+    int ret, idle = 0, code = ERROR_NO_ERROR;
+
+    ff_thread_setname("http2");
+
+    for (;;) {
+        uint8_t *p = conn->rbuf;
+        struct pollfd pfd = { .fd = conn->fd, .events = POLLIN };
+
+        ff_mutex_lock(&conn->lock);
+        ret = conn->error;
+        if (!ret && !conn->refs && av_gettime_relative() - conn->idle_since > IDLE_TIMEOUT)
+            ret = idle = AVERROR_EOF;
+        ff_mutex_unlock(&conn->lock);
+        if (ret)
+            break;
+
+        ff_mutex_lock(&conn->io_lock);
+        ret = ffurl_read(conn->hd, conn->rbuf + conn->rbuf_len,
+                         2 * (FRAME_HEADER_SIZE + FRAME_SIZE) - conn->rbuf_len);
+        ff_mutex_unlock(&conn->io_lock);
+        if (ret == AVERROR(EAGAIN)) {
+            poll(&pfd, 1, POLL_MS);
+            continue;
+        } else if (ret <= 0) {
+            ret = ret ? ret : AVERROR_EOF;
+            break;
+        }
+        conn->rbuf_len += ret;
+
+        ff_mutex_lock(&conn->lock);
+        while (conn->rbuf_len - (p - conn->rbuf) >= FRAME_HEADER_SIZE) {
+            int size = AV_RB24(p);
+
+            if (size > FRAME_SIZE) {
+                code = ERROR_FRAME_SIZE;
+                break;
+            }
+            if (conn->rbuf_len - (p - conn->rbuf) < FRAME_HEADER_SIZE + size)
+                break;
+            code = conn_handle_frame(conn, p[3], p[4], AV_RB32(p + 5) & MAX_STREAM_ID,
+                                     p + FRAME_HEADER_SIZE, size);
+            if (code != ERROR_NO_ERROR)
+                break;
+            p += FRAME_HEADER_SIZE + size;
+        }
+        ff_cond_broadcast(&conn->cond);
+        ff_mutex_unlock(&conn->lock);
+
+        conn->rbuf_len -= p - conn->rbuf;
+        memmove(conn->rbuf, p, conn->rbuf_len);
+
+        if (code != ERROR_NO_ERROR) {
+            av_log(NULL, AV_LOG_ERROR, "HTTP/2 protocol error %d from %s\n", code, conn->key);
+            ret = AVERROR_INVALIDDATA;
+            break;
+        }
+        if (conn_flush_control(conn) < 0)
+            return NULL;
+    }
+
+    /* say goodbye unless the transport itself failed */
+    if (idle || code != ERROR_NO_ERROR) {
+        uint8_t payload[8];
+
+        AV_WB32(payload, 0);
+        AV_WB32(payload + 4, code);
+        ff_mutex_lock(&conn->lock);
+        conn_queue_frame(conn, FRAME_GOAWAY, 0, 0, payload, sizeof(payload));
+        ff_mutex_unlock(&conn->lock);
+        conn_flush_control(conn);
+    }
+    conn_fail(conn, ret);
+    return NULL;
+}
+
+static int conn_interrupt_cb(void *opaque)
+{
+    H2Connection *conn = opaque;
+    return conn->int_cb ? ff_check_interrupt(conn->int_cb) : 0;
+}
+
+static void conn_free(H2Connection *conn)
+{
+    if (conn->thread_started)
+        pthread_join(conn->thread, NULL);
+    ffurl_closep(&conn->hd);
+    ff_hpack_table_uninit(&conn->encoder);
+    ff_hpack_table_uninit(&conn->decoder);
+    av_bprint_finalize(&conn->control, NULL);
+    av_bprint_finalize(&conn->header_block, NULL);
+    ff_cond_destroy(&conn->cond);
+    ff_mutex_destroy(&conn->lock);
+    ff_mutex_destroy(&conn->write_lock);
+    ff_mutex_destroy(&conn->io_lock);
+    av_free(conn->wbuf);
+    av_free(conn->rbuf);
+    av_free(conn->key);
+    av_free(conn);
+}
+
+static int conn_open(URLContext *h, H2Connection *conn, const char *hostname,
+                     int port, AVDictionary **options)
+{
+    HTTP2Context *c = h->priv_data;
+    AVDictionary *opts = NULL;
+    uint8_t *proto = NULL, setup[6 * 3 + 4];
+    char url[1024];
+    int ret;
+
+    ff_url_join(url, sizeof(url), c->tls ? "tls" : "tcp", NULL, hostname, port, NULL);
+    if (options)
+        av_dict_copy(&opts, *options, 0);
+    av_dict_set(&opts, "tcp_nodelay", "1", 0);
+    if (c->tls)
+        av_dict_set(&opts, "alpn", "h2,http/1.1", 0);
+
+    /* the transport outlives the opener, so it gets a callback of its own
+     * which follows the opener's one until the connection is set up */
+    conn->int_cb = &h->interrupt_callback;
+    ret = ffurl_open_whitelist(&conn->hd, url, AVIO_FLAG_READ_WRITE,
+                               &(AVIOInterruptCB){ conn_interrupt_cb, conn }, &opts,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    av_dict_free(&opts);
+    conn->int_cb = NULL;
+    if (ret < 0)
+        goto end;
+
+    if (c->tls) {
+        av_opt_get(conn->hd, "alpn_selected", AV_OPT_SEARCH_CHILDREN, &proto);
+        if (!proto || strcmp((char *)proto, "h2")) {
+            av_log(h, AV_LOG_VERBOSE, "%s did not select h2\n", hostname);
+            ret = AVERROR(ENOSYS);
+            goto end;
+        }
+    }
+
+    conn->fd = ffurl_get_file_handle(conn->hd);
+    conn->hd->flags |= AVIO_FLAG_NONBLOCK;
+
+    ff_mutex_lock(&conn->write_lock);
+    AV_WB16(setup,      SETTINGS_ENABLE_PUSH);
+    AV_WB32(setup +  2, 0);
+    AV_WB16(setup +  6, SETTINGS_INITIAL_WINDOW_SIZE);
+    AV_WB32(setup +  8, STREAM_WINDOW);
+    AV_WB16(setup + 12, SETTINGS_HEADER_TABLE_SIZE);
+    AV_WB32(setup + 14, HPACK_DEFAULT_TABLE_SIZE);
+    AV_WB32(setup + 18, CONN_WINDOW - DEFAULT_WINDOW);
+    if ((ret = conn_write_raw(conn, (const uint8_t *)preface, sizeof(preface) - 1)) >= 0 &&
+        (ret = conn_write_frame(conn, FRAME_SETTINGS, 0, 0, setup, 18)) >= 0)
+        ret = conn_write_frame(conn, FRAME_WINDOW_UPDATE, 0, 0, setup + 18, 4);
+    ff_mutex_unlock(&conn->write_lock);
+    if (ret < 0)
+        goto end;
+
+    if ((ret = pthread_create(&conn->thread, NULL, conn_thread, conn))) {
+        ret = AVERROR(ret);
+        goto end;
+    }
+    conn->thread_started = 1;
+    av_log(h, AV_LOG_VERBOSE, "Opened HTTP/2 connection to %s\n", url);
+
+end:
+    av_free(proto);
+    return ret;
+}
+
+static H2Connection *conn_alloc(const char *key)
+{
+    H2Connection *conn = av_mallocz(sizeof(*conn));
+
+    if (!conn)
+        return NULL;
+    conn->key  = av_strdup(key);
+    conn->wbuf = av_malloc(FRAME_HEADER_SIZE + FRAME_SIZE);
+    conn->rbuf = av_malloc(2 * (FRAME_HEADER_SIZE + FRAME_SIZE));
+    if (!conn->key || !conn->wbuf || !conn->rbuf) {
+        av_free(conn->key);
+        av_free(conn->wbuf);
+        av_free(conn->rbuf);
+        av_free(conn);
+        return NULL;
+    }
+    ff_mutex_init(&conn->lock, NULL);
+    ff_cond_init(&conn->cond, NULL);
+    ff_mutex_init(&conn->write_lock, NULL);
+    ff_mutex_init(&conn->io_lock, NULL);
+    ff_hpack_table_init(&conn->encoder, HPACK_DEFAULT_TABLE_SIZE);
+    ff_hpack_table_init(&conn->decoder, HPACK_DEFAULT_TABLE_SIZE);
+    av_bprint_init(&conn->control, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&conn->header_block, 0, AV_BPRINT_SIZE_UNLIMITED);
+    conn->fd               = -1;
+    conn->next_stream_id   = 1;
+    conn->send_window      = DEFAULT_WINDOW;
+    conn->peer_window      = DEFAULT_WINDOW;
+    conn->peer_max_streams = INT_MAX;
+    conn->peer_table_size  = HPACK_DEFAULT_TABLE_SIZE;
+    return conn;
+}
+
+/* Find a live connection for key or open a new one, and take a reference. */
+static int conn_get(URLContext *h, const char *key, const char *hostname,
+                    int port, AVDictionary **options, H2Connection **pconn)
+{
+    H2Connection **p, *conn = NULL;
+    int64_t now = av_gettime_relative();
+    int ret;
+
+    ff_mutex_lock(&conns_lock);
+    for (p = &conns; *p; ) {
+        H2Connection *e = *p;
+        int usable = 0, dead;
+
+        if (!e->hd) {
+            dead = now > e->expires;
+            if (!dead && !strcmp(e->key, key)) {
+                ff_mutex_unlock(&conns_lock);
+                return AVERROR(ENOSYS);
+            }
+        } else {
+            ff_mutex_lock(&e->lock);
+            dead   = e->error && !e->refs;
+            usable = !e->error && !e->goaway && !strcmp(e->key, key);
+            if (usable && !conn) {
+                e->refs++;
+                conn = e;
+            }
+            ff_mutex_unlock(&e->lock);
+        }
+        if (dead) {
+            *p = e->next;
+            conn_free(e);
+        } else {
+            p = &e->next;
+        }
+    }
+    ff_mutex_unlock(&conns_lock);
+    if (conn) {
+        *pconn = conn;
+        return 0;
+    }
+
+    if (!(conn = conn_alloc(key)))
+        return AVERROR(ENOMEM);
+    conn->refs = 1;
+    ret = conn_open(h, conn, hostname, port, options);
+    if (ret < 0) {
+        conn_free(conn);
+        if (ret != AVERROR(ENOSYS) || !(conn = conn_alloc(key)))
+            return ret;
+        conn->expires = now + NO_H2_TIMEOUT;
+    } else {
+        *pconn = conn;
+    }
+
+    ff_mutex_lock(&conns_lock);
+    conn->next = conns;
+    conns = conn;
+    ff_mutex_unlock(&conns_lock);
+    return ret;
+}
+
+static void conn_release(H2Connection *conn)
+{
+    H2Connection **p;
+    int dead;
+
+    ff_mutex_lock(&conns_lock);
+    ff_mutex_lock(&conn->lock);
+    if (!--conn->refs)
+        conn->idle_since = av_gettime_relative();
+    dead = !conn->refs && conn->error;
+    ff_mutex_unlock(&conn->lock);
+    if (dead) {
+        for (p = &conns; *p && *p != conn; p = &(*p)->next);
+        if (*p)
+            *p = conn->next;
+        conn_free(conn);
+    }
+    ff_mutex_unlock(&conns_lock);
+}
+
+static void stream_close(HTTP2Context *c)
+{
+    H2Connection *conn = c->conn;
+    H2Stream *st = c->st, **p;
+
+    if (!st)
+        return;
+
+    ff_mutex_lock(&conn->lock);
+    for (p = &conn->streams; *p && *p != st; p = &(*p)->next);
+    if (*p) {
+        *p = st->next;
+        conn->nb_streams--;
+        if (!(st->remote_closed && st->local_closed) && !st->error && !conn->error)
+            conn_queue_rst(conn, st->id, ERROR_CANCEL);
+        ff_cond_broadcast(&conn->cond);
+    }
+    ff_mutex_unlock(&conn->lock);
+    conn_flush_control(conn);
+
+    av_fifo_freep2(&st->rbuf);
+    av_freep(&c->st);
+}
+
+/* Send a header block as HEADERS and CONTINUATION frames. Must hold write_lock. */
+static int stream_write_headers(H2Connection *conn, uint32_t id, const AVBPrint *bp,
+                                int end_stream)
+{
+    const uint8_t *p = bp->str;
+    int left = bp->len, ret;
+    int type = FRAME_HEADERS, flags = end_stream ? FLAG_END_STREAM : 0;
+
+    do {
+        int size = FFMIN(left, FRAME_SIZE);
+
+        if (size == left)
+            flags |= FLAG_END_HEADERS;
+        if ((ret = conn_write_frame(conn, type, flags, id, p, size)) < 0)
+            return ret;
+        p    += size;
+        left -= size;
+        type  = FRAME_CONTINUATION;
+        flags = 0;
+    } while (left > 0);
+    return 0;
+}
+
+/* Translate the HTTP/1.1 request head in c->head and start a stream for it. */
+static int stream_open(URLContext *h)
+{
+    HTTP2Context *c = h->priv_data;
+    H2Connection *conn = c->conn;
+    const char *names[MAX_REQUEST_FIELDS], *values[MAX_REQUEST_FIELDS];
+    const char *method, *path, *authority = c->authority;
+    char *line, *save, *p;
+    int nb_fields = 0, chunked = 0, expect = 0, end_stream, ret;
+    int64_t start = 0;
+    AVBPrint block;
+    H2Stream *st;
+
+    c->body_left = 0;
+
+    if (!(line = av_strtok(c->head.str, "\r\n", &save)))
+        return AVERROR(EINVAL);
+    method = line;
+    if (!(p = strchr(line, ' ')))
+        return AVERROR(EINVAL);
+    *p++ = '\0';
+    path = p;
+    if ((p = strchr(p, ' ')))
+        *p = '\0';
+
+    while ((line = av_strtok(NULL, "\r\n", &save))) {
+        char *name = line, *value, *end;
+
+        if (!(value = strchr(line, ':')))
+            continue;
+        *value++ = '\0';
+        while (*value == ' ' || *value == '\t')
+            value++;
+        end = value + strlen(value);
+        while (end > value && (end[-1] == ' ' || end[-1] == '\t'))
+            *--end = '\0';
+        for (p = name; *p; p++)
+            *p = av_tolower(*p);
+
+        if (!strcmp(name, "host")) {
+            authority = value;
+        } else if (!strcmp(name, "transfer-encoding")) {
+            chunked = !av_strcasecmp(value, "chunked");
+        } else if (!strcmp(name, "expect")) {
+            expect = !av_strcasecmp(value, "100-continue");
+        } else if (strcmp(name, "connection") && strcmp(name, "keep-alive") &&
+                   strcmp(name, "proxy-connection") && strcmp(name, "upgrade") &&
+                   (strcmp(name, "te") || !strcmp(value, "trailers"))) {
+            if (!strcmp(name, "content-length"))
+                c->body_left = strtoll(value, NULL, 10);
+            if (nb_fields == MAX_REQUEST_FIELDS)
+                return AVERROR(EINVAL);
+            names[nb_fields]    = name;
+            values[nb_fields++] = value;
+        }
+    }
+    end_stream = !chunked && c->body_left <= 0;
+
+    if (!(st = av_mallocz(sizeof(*st))) ||
+        !(st->rbuf = av_fifo_alloc2(4096, 1, AV_FIFO_FLAG_AUTO_GROW))) {
+        av_free(st);
+        return AVERROR(ENOMEM);
+    }
+    av_fifo_auto_grow_limit(st->rbuf, 2 * STREAM_WINDOW);
+    st->recv_window  = STREAM_WINDOW;
+    st->local_closed = end_stream;
+    c->st = st;
+
+    ff_mutex_lock(&conn->lock);
+    while (!conn->error && !conn->goaway && conn->nb_streams >= conn->peer_max_streams)
+        if ((ret = conn_wait(h, conn, &start)) < 0)
+            goto fail;
+    ret = conn->error ? conn->error : conn->goaway ? AVERROR(ECONNRESET) : 0;
+    if (ret < 0)
+        goto fail;
+    conn->nb_streams++;
+    st->next      = conn->streams;
+    conn->streams = st;
+    ff_mutex_unlock(&conn->lock);
+
+    av_bprint_init(&block, 0, AV_BPRINT_SIZE_UNLIMITED);
+    ff_mutex_lock(&conn->write_lock);
+    ff_mutex_lock(&conn->lock);
+    st->id = conn->next_stream_id;
+    st->send_window = conn->peer_window;
+    if (conn->peer_table_size != conn->encoder.max_size)
+        ff_hpack_set_max_size(&conn->encoder, conn->peer_table_size);
+    /* stream ids cannot be reused, move on to a new connection */
+    if (conn->next_stream_id >= MAX_STREAM_ID - 2)
+        conn->goaway = 1;
+    ff_mutex_unlock(&conn->lock);
+    conn->next_stream_id += 2;
+
+    ff_hpack_encode_start(&conn->encoder, &block);
+    ff_hpack_encode_field(&conn->encoder, &block, ":method", method, 0);
+    ff_hpack_encode_field(&conn->encoder, &block, ":scheme", c->tls ? "https" : "http", 0);
+    ff_hpack_encode_field(&conn->encoder, &block, ":authority", authority, 0);
+    ff_hpack_encode_field(&conn->encoder, &block, ":path", path, HPACK_FLAG_NO_INDEX);
+    for (int i = 0; i < nb_fields; i++) {
+        int flags = 0;
+        if (!strcmp(names[i], "authorization") || !strcmp(names[i], "proxy-authorization"))
+            flags = HPACK_FLAG_NEVER_INDEX;
+        else if (!strcmp(names[i], "range") || !strcmp(names[i], "content-length"))
+            flags = HPACK_FLAG_NO_INDEX;
+        ff_hpack_encode_field(&conn->encoder, &block, names[i], values[i], flags);
+    }
+    if (!av_bprint_is_complete(&block)) {
+        /* the encoder table no longer matches what the peer will see */
+        conn_fail(conn, AVERROR(ENOMEM));
+        ret = AVERROR(ENOMEM);
+    } else {
+        ret = stream_write_headers(conn, st->id, &block, end_stream);
+    }
+    ff_mutex_unlock(&conn->write_lock);
+    av_bprint_finalize(&block, NULL);
+    if (ret < 0)
+        return ret;
+
+    if (expect) {
+        static const char cont[] = "HTTP/2.0 100 Continue\r\n\r\n";
+        ff_mutex_lock(&conn->lock);
+        if (av_fifo_write(st->rbuf, cont, sizeof(cont) - 1) >= 0)
+            st->head_queued += sizeof(cont) - 1;
+        ff_mutex_unlock(&conn->lock);
+    }
+
+    c->state = chunked ? REQ_CHUNK_SIZE : end_stream ? REQ_DONE : REQ_BODY;
+    c->line_len = 0;
+    return 0;
+
+fail:
+    ff_mutex_unlock(&conn->lock);
+    av_fifo_freep2(&st->rbuf);
+    av_freep(&c->st);
+    return ret;
+}
+
+static int stream_write_data(URLContext *h, const uint8_t *buf, int size, int end_stream)
+{
+    HTTP2Context *c = h->priv_data;
+    H2Connection *conn = c->conn;
+    H2Stream *st = c->st;
+    int64_t start = 0;
+    int ret;
+
+    do {
+        int len = 0;
+
+        ret = 0;
+        ff_mutex_lock(&conn->lock);
+        while (size && !conn->error && !st->error &&
+               (st->send_window <= 0 || conn->send_window <= 0))
+            if ((ret = conn_wait(h, conn, &start)) < 0)
+                break;
+        ret = conn->error ? conn->error : st->error ? st->error : ret;
+        if (ret >= 0) {
+            len = FFMIN(FFMIN(size, FRAME_SIZE), FFMIN(st->send_window, conn->send_window));
+            st->send_window   -= len;
+            conn->send_window -= len;
+        }
+        ff_mutex_unlock(&conn->lock);
+        if (ret < 0)
+            return ret;
+
+        ff_mutex_lock(&conn->write_lock);
+        ret = conn_write_frame(conn, FRAME_DATA, end_stream && len == size ? FLAG_END_STREAM : 0,
+                               st->id, buf, len);
+        ff_mutex_unlock(&conn->write_lock);
+        if (ret < 0)
+            return ret;
+        buf  += len;
+        size -= len;
+        start = 0;
+    } while (size > 0);
+
+    if (end_stream) {
+        ff_mutex_lock(&conn->lock);
+        st->local_closed = 1;
+        ff_mutex_unlock(&conn->lock);
+    }
+    return 0;
+}
+
+/* Feed bytes of a chunked request body, returning how many were used. */
+static int stream_write_chunked(URLContext *h, const uint8_t *buf, int size)
+{
+    HTTP2Context *c = h->priv_data;
+    int len, ret;
+
+    switch (c->state) {
+    case REQ_CHUNK_DATA:
+        len = FFMIN(size, c->body_left);
+        if ((ret = stream_write_data(h, buf, len, 0)) < 0)
+            return ret;
+        if (!(c->body_left -= len))
+            c->state = REQ_CHUNK_END;
+        return len;
+    default:
+        for (len = 0; len < size && buf[len] != '\n'; len++)
+            if (c->line_len < sizeof(c->line) - 1)
+                c->line[c->line_len++] = buf[len];
+        if (len == size)
+            return len;
+        c->line[c->line_len] = '\0';
+        c->line_len = 0;
+        len++;
+
+        if (c->state == REQ_CHUNK_SIZE) {
+            c->body_left = strtoll(c->line, NULL, 16);
+            if (c->body_left < 0)
+                return AVERROR(EINVAL);
+            if (c->body_left) {
+                c->state = REQ_CHUNK_DATA;
+            } else {
+                if ((ret = stream_write_data(h, NULL, 0, 1)) < 0)
+                    return ret;
+                c->state = REQ_TRAILER;
+            }
+        } else if (c->state == REQ_CHUNK_END) {
+            c->state = REQ_CHUNK_SIZE;
+        } else if (c->line[0] == '\r' || !c->line[0]) {
+            /* trailers are dropped, the end of the body was sent already */
+            c->state = REQ_DONE;
+        }
+        return len;
+    }
+}
+
+static int http2_open(URLContext *h, const char *uri, int flags, AVDictionary **options)
+{
+    HTTP2Context *c = h->priv_data;
+    char hostname[1024], key[1100], buf[16];
+    const char *p;
+    int port, ret;
+
+    av_url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &port, NULL, 0, uri);
+    if (port <= 0 || !*hostname)
+        return AVERROR(EINVAL);
+    if ((p = strchr(uri, '?')) && av_find_info_tag(buf, sizeof(buf), "tls", p))
+        c->tls = strtol(buf, NULL, 10);
+    ff_url_join(c->authority, sizeof(c->authority), NULL, NULL, hostname, port, NULL);
+    snprintf(key, sizeof(key), "%s:%s", c->tls ? "tls" : "tcp", c->authority);
+
+    if ((ret = conn_get(h, key, hostname, port, options, &c->conn)) < 0)
+        return ret;
+    av_bprint_init(&c->head, 0, MAX_REQUEST_HEAD);
+    h->is_streamed = 1;
+    return 0;
+}
+
+static int http2_write(URLContext *h, const uint8_t *buf, int size)
+{
+    HTTP2Context *c = h->priv_data;
+    int done = 0, len, ret;
+
+    while (done < size) {
+        switch (c->state) {
+        case REQ_DONE:
+            /* a new request on the same context */
+            stream_close(c);
+            av_bprint_clear(&c->head);
+            c->state = REQ_HEAD;
+            /* fall through */
+        case REQ_HEAD: {
+            unsigned old = c->head.len;
+            char *end;
+
+            len = FFMIN(size - done, MAX_REQUEST_HEAD - 1 - (int)old);
+            av_bprint_append_data(&c->head, buf + done, len);
+            if (!av_bprint_is_complete(&c->head))
+                return AVERROR(ENOMEM);
+            if (!(end = strstr(c->head.str + FFMAX((int)old - 3, 0), "\r\n\r\n"))) {
+                if (c->head.len >= MAX_REQUEST_HEAD - 1)
+                    return AVERROR(EINVAL);
+                done += len;
+                break;
+            }
+            len = end + 4 - c->head.str;
+            done += len - old;
+            c->head.str[len] = '\0';
+            stream_close(c);
+            if ((ret = stream_open(h)) < 0)
+                return ret;
+            break;
+        }
+        case REQ_BODY:
+            len = FFMIN(size - done, c->body_left);
+            c->body_left -= len;
+            if ((ret = stream_write_data(h, buf + done, len, !c->body_left)) < 0)
+                return ret;
+            done += len;
+            if (!c->body_left)
+                c->state = REQ_DONE;
+            break;
+        case REQ_TRAILER:
+        case REQ_CHUNK_SIZE:
+        case REQ_CHUNK_DATA:
+        case REQ_CHUNK_END:
+            if ((ret = stream_write_chunked(h, buf + done, size - done)) < 0)
+                return ret;
+            done += ret;
+            break;
+        }
+    }
+    return size;
+}
+
+static int http2_read(URLContext *h, uint8_t *buf, int size)
+{
+    HTTP2Context *c = h->priv_data;
+    H2Connection *conn = c->conn;
+    H2Stream *st = c->st;
+    int64_t start = 0;
+    int ret = 0, len, pending;
+
+    if (!st)
+        return AVERROR_EOF;
+
+    ff_mutex_lock(&conn->lock);
+    while (!av_fifo_can_read(st->rbuf) && !st->remote_closed && !st->error && !conn->error) {
+        if (h->flags & AVIO_FLAG_NONBLOCK) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+        if ((ret = conn_wait(h, conn, &start)) < 0)
+            break;
+    }
+    if ((len = FFMIN(av_fifo_can_read(st->rbuf), size))) {
+        int head = FFMIN(len, st->head_queued);
+
+        av_fifo_read(st->rbuf, buf, len);
+        st->head_queued -= head;
+        st->unacked     += len - head;
+        stream_update_window(conn, st);
+        ret = len;
+    } else if (!ret) {
+        ret = st->remote_closed ? AVERROR_EOF : st->error ? st->error : conn->error;
+        /* a connection closed by the peer cuts the response short */
+        if (ret == AVERROR_EOF && !st->remote_closed)
+            ret = AVERROR(ECONNRESET);
+    }
+    pending = conn->control.len;
+    ff_mutex_unlock(&conn->lock);
+
+    if (pending)
+        conn_flush_control(conn);
+    return ret;
+}
+
+static int http2_close(URLContext *h)
+{
+    HTTP2Context *c = h->priv_data;
+
+    if (c->conn) {
+        stream_close(c);
+        conn_release(c->conn);
+        c->conn = NULL;
+    }
+    av_bprint_finalize(&c->head, NULL);
+    return 0;
+}
+
+static int http2_shutdown(URLContext *h, int flags)
+{
+    return 0;
+}
+
+static int http2_get_file_handle(URLContext *h)
+{
+    HTTP2Context *c = h->priv_data;
+    return c->conn ? c->conn->fd : -1;
+}
+
+#define OFFSET(x) offsetof(HTTP2Context, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+#define E AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+    { "tls", "use TLS and ask for h2 through ALPN", OFFSET(tls), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D | E },
+    { NULL }
+};
+
+static const AVClass http2_class = {
+    .class_name = "http2",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_http2_protocol = {
+    .name                = "http2",
+    .url_open2           = http2_open,
+    .url_read            = http2_read,
+    .url_write           = http2_write,
+    .url_close           = http2_close,
+    .url_shutdown        = http2_shutdown,
+    .url_get_file_handle = http2_get_file_handle,
+    .priv_data_size      = sizeof(HTTP2Context),
+    .priv_data_class     = &http2_class,
+    .flags               = URL_PROTOCOL_FLAG_NETWORK,
+    .default_whitelist   = "tcp,tls",
+};
@@ -663,10 +663,21 @@ static void read_apic(AVFormatContext *s, AVIOContext *pb, int taglen,
         goto fail;
     }
 
-    apic->buf = av_buffer_alloc(taglen + AV_INPUT_BUFFER_PADDING_SIZE);
-    if (!apic->buf || !taglen || avio_read(pb, apic->buf->data, taglen) != taglen)
-        goto fail;
-    memset(apic->buf->data + taglen, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    //PLEX
+    if (s && ff_attached_pic_can_defer(s, pb, taglen)) {
+        int head_size = FFMIN(taglen, sizeof(apic->head));
+        apic->pos  = avio_tell(pb);
+        apic->size = taglen;
+        if (ffio_read_size(pb, apic->head, head_size) < 0 ||
+            avio_skip(pb, taglen - head_size) < 0)
+            goto fail;
+    } else {
+        apic->buf = av_buffer_alloc(taglen + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!apic->buf || !taglen || avio_read(pb, apic->buf->data, taglen) != taglen)
+            goto fail;
+        memset(apic->buf->data + taglen, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    }
+    //PLEX
 
     new_extra->tag  = "APIC";
 
@@ -1136,6 +1147,14 @@ void ff_id3v2_read_dict(AVIOContext *pb, AVDictionary **metadata,
     id3v2_read_internal(pb, metadata, NULL, magic, extra_meta, 0);
 }
 
+//PLEX
+void ff_id3v2_read_dict_lazy(AVFormatContext *s, AVDictionary **metadata,
+                             const char *magic, ID3v2ExtraMeta **extra_meta)
+{
+    id3v2_read_internal(s->pb, metadata, s, magic, extra_meta, 0);
+}
+//PLEX
+
 void ff_id3v2_read(AVFormatContext *s, const char *magic,
                    ID3v2ExtraMeta **extra_meta, unsigned int max_search_size)
 {
@@ -1165,19 +1184,27 @@ int ff_id3v2_parse_apic(AVFormatContext *s, ID3v2ExtraMeta *extra_meta)
     for (cur = extra_meta; cur; cur = cur->next) {
         ID3v2ExtraMetaAPIC *apic;
         AVStream *st;
+        const uint8_t *head; //PLEX
         int ret;
 
         if (strcmp(cur->tag, "APIC"))
             continue;
         apic = &cur->data.apic;
 
-        ret = ff_add_attached_pic(s, NULL, NULL, &apic->buf, 0);
+        //PLEX
+        if (apic->buf)
+            ret = ff_add_attached_pic(s, NULL, NULL, &apic->buf, 0);
+        else
+            ret = ff_add_lazy_attached_pic(s, NULL, apic->pos, apic->size,
+                                           apic->head, sizeof(apic->head));
+        //PLEX
         if (ret < 0)
             return ret;
         st  = s->streams[s->nb_streams - 1];
         st->codecpar->codec_id   = apic->id;
 
-        if (AV_RB64(st->attached_pic.data) == PNGSIG)
+        head = ff_attached_pic_head(st); //PLEX
+        if (head && AV_RB64(head) == PNGSIG)
             st->codecpar->codec_id = AV_CODEC_ID_PNG;
 
         if (apic->description[0])
@@ -67,6 +67,12 @@ typedef struct ID3v2ExtraMetaAPIC {
     const char  *type;
     uint8_t     *description;
     enum AVCodecID id;
+    //PLEX
+    /* picture left unread, when buf is NULL */
+    int64_t pos;
+    int     size;
+    uint8_t head[8];
+    //PLEX
 } ID3v2ExtraMetaAPIC;
 
 typedef struct ID3v2ExtraMetaPRIV {
@@ -116,6 +122,15 @@ int ff_id3v2_tag_len(const uint8_t *buf);
  */
 void ff_id3v2_read_dict(AVIOContext *pb, AVDictionary **metadata, const char *magic, ID3v2ExtraMeta **extra_meta);
 
+//PLEX
+/**
+ * Same as ff_id3v2_read_dict() on s->pb, but attached pictures are left
+ * unread if s->lazy_attached_pics allows it.
+ */
+void ff_id3v2_read_dict_lazy(AVFormatContext *s, AVDictionary **metadata,
+                             const char *magic, ID3v2ExtraMeta **extra_meta);
+//PLEX
+
 /**
  * Read an ID3v2 tag, including supported extra metadata.
  *
@@ -45,6 +45,15 @@
  */
 #define FF_FMT_INIT_CLEANUP                             (1 << 0)
 
+//PLEX
+/**
+ * The demuxer accesses the index of its streams only through the functions
+ * of seek.c, so it can be kept in an FFPackedIndex instead of
+ * FFStream.index_entries.
+ */
+#define FF_FMT_PACKED_INDEX                             (1 << 1)
+//PLEX
+
 typedef struct AVCodecTag {
     enum AVCodecID id;
     unsigned int tag;
@@ -107,6 +116,28 @@ typedef struct FFFormatContext {
     PacketList packet_buffer_last;
     //PLEX
 
+    //PLEX
+    /**
+     * Set when ff_interleave_packet_per_dts() keeps packets in the
+     * per-stream FFStream.interleave_queue instead of packet_buffer.
+     * Muxing only.
+     */
+    int interleave_per_stream;
+
+    /**
+     * Min-heap of the streams with queued packets, ordered by the dts of
+     * their first queued packet.
+     */
+    struct FFStream **interleave_heap;
+    int nb_interleave_heap;
+
+    /**
+     * Set when attached pictures were left unread, to read them on the
+     * first av_read_frame(). Demuxing only.
+     */
+    int lazy_pics_pending;
+    //PLEX
+
     /* av_seek_frame() support */
     int64_t data_offset; /**< offset of the first packet */
 
@@ -193,6 +224,32 @@ typedef struct FFFormatContext {
      * Contexts and child contexts do not contain a metadata option
      */
     int metafree;
+
+    //PLEX
+    /**
+     * I/O statistics of the contexts closed through ff_format_io_close().
+     */
+    AVIOStats io_stats;
+
+    /**
+     * Packets read ahead and decrypted as a batch, and the read error that
+     * ended the batch, returned once the queue is drained.
+     */
+    PacketList decrypt_queue;
+    int decrypt_err;
+    AVPacket **decrypt_pkts;
+    int nb_decrypt_pkts;
+    struct AVSliceThread *decrypt_pool;
+    int decrypt_pool_failed;
+    int (*decrypt_handle_packet)(AVFormatContext *ctx, AVPacket *pkt);
+
+    /**
+     * Duplicate of the file descriptor behind source_file_pb, shared by the
+     * AV_PKT_DATA_SOURCE_RANGE side data of the packets read from it.
+     */
+    AVBufferRef *source_file;
+    AVIOContext *source_file_pb;
+    //PLEX
 } FFFormatContext;
 
 static av_always_inline FFFormatContext *ffformatcontext(AVFormatContext *s)
@@ -265,6 +322,10 @@ typedef struct FFStream {
                                     support seeking natively. */
     int nb_index_entries;
     unsigned int index_entries_allocated_size;
+    /**
+     * Replaces index_entries for formats with FF_FMT_PACKED_INDEX.
+     */
+    struct FFPackedIndex *packed_index; //PLEX
 
     int64_t interleaver_chunk_size;
     int64_t interleaver_chunk_duration;
@@ -389,6 +450,23 @@ typedef struct FFStream {
      */
     PacketListEntry *last_in_packet_buffer;
 
+    //PLEX
+    /**
+     * Packets of this stream waiting in the dts interleaver, in the order
+     * they were written, when FFFormatContext.interleave_per_stream is set.
+     */
+    PacketList interleave_queue;
+
+    /**
+     * Position in AVFormatContext.pb and size of an attached picture left
+     * unread by AVFormatContext.lazy_attached_pics. lazy_pic_size is reset
+     * once it is read.
+     */
+    int64_t lazy_pic_pos;
+    int lazy_pic_size;
+    uint8_t lazy_pic_head[8]; ///< first bytes of the picture, to tell its format
+    //PLEX
+
     int64_t last_IP_pts;
     int last_IP_duration;
 
@@ -437,6 +515,20 @@ static av_always_inline const FFStream *cffstream(const AVStream *st)
     return (const FFStream*)st;
 }
 
+//PLEX
+/**
+ * @return the number of index entries of the stream, in index_entries or
+ *         in its packed index
+ */
+int ff_index_nb_entries(const FFStream *sti);
+
+/**
+ * @return index entry idx of the stream, either in index_entries or
+ *         decoded from its packed index into tmp
+ */
+const AVIndexEntry *ff_index_get_entry(const FFStream *sti, int idx, AVIndexEntry *tmp);
+//PLEX
+
 #ifdef __GNUC__
 #define dynarray_add(tab, nb_ptr, elem)\
 do {\
@@ -734,6 +826,20 @@ void ff_format_set_url(AVFormatContext *s, char *url);
  */
 int ff_match_url_ext(const char *url, const char *extensions);
 
+//PLEX
+/**
+ * Look short_name up among the builtin demuxers with av_match_name()
+ * semantics, using a sorted index.
+ *
+ * @param opaque av_demuxer_iterate() state, set past the builtin demuxers
+ *               when the index was used so the caller only scans devices.
+ *               Left untouched for names containing a ',', which the
+ *               caller must look up with a full scan.
+ * @return the first matching builtin demuxer or NULL
+ */
+const AVInputFormat *ff_find_builtin_demuxer(const char *short_name, void **opaque);
+//PLEX
+
 struct FFOutputFormat;
 void avpriv_register_devices(const struct FFOutputFormat * const o[], const AVInputFormat * const i[]);
 
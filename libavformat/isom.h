@@ -35,6 +35,7 @@
 #include "avio.h"
 #include "internal.h"
 #include "dv.h"
+#include "readahead.h" //PLEX
 
 /* isom.c */
 extern const AVCodecTag ff_mp4_obj_type[];
@@ -163,6 +164,33 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+//PLEX
+/**
+ * Position of the index builder in the sample tables, kept between calls
+ * when the index is materialized on demand.
+ */
+typedef struct MOVIndexCursor {
+    int active;                 ///< samples are left to add to the index
+    int lazy;                   ///< the sample tables are kept for later calls
+    unsigned int sample;        ///< next sample to add
+    unsigned int chunk;
+    unsigned int chunk_sample;  ///< samples of the current chunk already added
+    int chunk_started;
+    unsigned int stts_index;
+    unsigned int stts_sample;
+    unsigned int stsc_index;
+    unsigned int stss_index;
+    unsigned int stps_index;
+    unsigned int rap_group_index;
+    unsigned int rap_group_sample;
+    unsigned int distance;
+    int key_off;
+    int64_t offset;
+    int64_t dts;
+    uint64_t stream_size;
+} MOVIndexCursor;
+//PLEX
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int pb_is_copied;
@@ -260,6 +288,12 @@ typedef struct MOVStreamContext {
         AVEncryptionInfo *default_encrypted_sample;
         MOVEncryptionIndex *encryption_index;
     } cenc;
+
+    //PLEX
+    MOVIndexCursor index_cursor;
+    FFReadAhead readahead;
+    int discard_skipped;    ///< current_sample was left behind while the stream was discarded
+    //PLEX
 } MOVStreamContext;
 
 typedef struct MOVContext {
@@ -328,6 +362,12 @@ typedef struct MOVContext {
     } *avif_info;
     int avif_info_size;
     int interleaved_read;
+    //PLEX
+    int lazy_index;
+    int64_t prefetch_size;
+    struct MOVPrefetch *prefetch;
+    int readahead_window;
+    //PLEX
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
@@ -296,6 +296,10 @@ typedef struct MatroskaAttachment {
     char *description;
     char *mime;
     EbmlBin bin;
+    //PLEX
+    int64_t lazy_pos;   ///< offset of the picture data left unread
+    int     lazy_size;
+    //PLEX
 
     AVStream *stream;
 } MatroskaAttachment;
@@ -429,6 +433,13 @@ typedef struct MatroskaDemuxContext {
     /* WebM DASH Manifest live flag */
     int is_live;
 
+    //PLEX
+    /* Sidecar file persisting the cluster index between sessions */
+    char *index_cache;
+    /* Number of index entries when the sidecar was loaded */
+    int64_t index_cache_entries;
+    //PLEX
+
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
 } MatroskaDemuxContext;
@@ -1099,6 +1110,93 @@ static int ebml_read_binary(AVIOContext *pb, int length,
     return 0;
 }
 
+//PLEX
+/*
+ * Read a Block or SimpleBlock, skipping over the payload of blocks of
+ * discarded tracks instead of reading it. When only the subtitles are
+ * demuxed, this leaves the audio and video data unread.
+ */
+static int ebml_read_block(MatroskaDemuxContext *matroska, AVIOContext *pb,
+                           int length, int64_t pos, EbmlBin *bin)
+{
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    int head = FFMIN(length, 8), n, ret, i;
+    uint8_t hdr[8];
+    uint64_t num;
+
+    /* the block starts with the track number as an EBML coded number */
+    if ((ret = avio_read(pb, hdr, head)) != head)
+        goto fail;
+
+    n = hdr[0] ? 8 - av_log2(hdr[0]) : 9;
+    if (n <= head) {
+        num = hdr[0] & (0xff >> n);
+        for (i = 1; i < n; i++)
+            num = (num << 8) | hdr[i];
+        for (i = 0; i < matroska->tracks.nb_elem; i++) {
+            if (tracks[i].num != num)
+                continue;
+            if (tracks[i].stream && tracks[i].stream->discard >= AVDISCARD_ALL) {
+                av_buffer_unref(&bin->buf);
+                bin->data = NULL;
+                bin->size = 0;
+                ret = avio_skip(pb, length - head);
+                return ret < 0 ? ret : 0;
+            }
+            break;
+        }
+    }
+
+    ret = av_buffer_realloc(&bin->buf, length + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (ret < 0)
+        goto fail;
+    memset(bin->buf->data + length, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    bin->data = bin->buf->data;
+    bin->size = length;
+    bin->pos  = pos;
+    memcpy(bin->data, hdr, head);
+    if (length > head &&
+        (ret = avio_read(pb, bin->data + head, length - head)) != length - head)
+        goto fail;
+    return 0;
+
+fail:
+    av_buffer_unref(&bin->buf);
+    bin->data = NULL;
+    bin->size = 0;
+    return ret < 0 ? ret : NEEDS_CHECKING;
+}
+
+/*
+ * Read the data of an attachment, or only record where it is if it is a
+ * picture which may be read when it is needed, see lazy_attached_pics.
+ * This relies on the mime type being stored before the data, as muxers do.
+ */
+static int ebml_read_attachment_data(MatroskaDemuxContext *matroska, AVIOContext *pb,
+                                     int length, int64_t pos, EbmlBin *bin)
+{
+    MatroskaAttachment *attachment = (MatroskaAttachment *)((uint8_t *)bin -
+                                     offsetof(MatroskaAttachment, bin));
+    int ret;
+
+    if (attachment->mime && ff_attached_pic_can_defer(matroska->ctx, pb, length)) {
+        for (int i = 0; mkv_image_mime_tags[i].id != AV_CODEC_ID_NONE; i++) {
+            if (!av_strstart(attachment->mime, mkv_image_mime_tags[i].str, NULL))
+                continue;
+            av_buffer_unref(&bin->buf);
+            bin->data = NULL;
+            bin->size = 0;
+            attachment->lazy_pos  = avio_tell(pb);
+            attachment->lazy_size = length;
+            ret = avio_skip(pb, length);
+            return ret < 0 ? ret : 0;
+        }
+    }
+    return ebml_read_binary(pb, length, pos, bin);
+}
+//PLEX
+
 /*
  * Read the next element, but only the header. The contents
  * are supposed to be sub-elements which can be read separately.
@@ -1476,7 +1574,12 @@ static int ebml_parse(MatroskaDemuxContext *matroska,
         res = ebml_read_ascii(pb, length, syntax->def.s, data);
         break;
     case EBML_BIN:
-        res = ebml_read_binary(pb, length, pos_alt, data);
+        if (id == MATROSKA_ID_SIMPLEBLOCK || id == MATROSKA_ID_BLOCK) //PLEX
+            res = ebml_read_block(matroska, pb, length, pos_alt, data);
+        else if (id == MATROSKA_ID_FILEDATA) //PLEX
+            res = ebml_read_attachment_data(matroska, pb, length, pos_alt, data);
+        else
+            res = ebml_read_binary(pb, length, pos_alt, data);
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
@@ -2029,6 +2132,144 @@ static void matroska_parse_cues(MatroskaDemuxContext *matroska) {
     matroska_add_index_entries(matroska);
 }
 
+//PLEX
+#define INDEX_CACHE_MAGIC   MKBETAG('M', 'K', 'I', 'X')
+#define INDEX_CACHE_VERSION 1
+
+static int64_t matroska_count_index_entries(MatroskaDemuxContext *matroska)
+{
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    int64_t nb_entries = 0;
+
+    for (int i = 0; i < matroska->tracks.nb_elem; i++)
+        if (tracks[i].stream)
+            nb_entries += ffstream(tracks[i].stream)->nb_index_entries;
+
+    return nb_entries;
+}
+
+/* The sidecar only applies to the file it was written for. */
+static void matroska_write_index_cache_id(MatroskaDemuxContext *matroska,
+                                          AVIOContext *pb)
+{
+    avio_wb32(pb, INDEX_CACHE_MAGIC);
+    avio_wb32(pb, INDEX_CACHE_VERSION);
+    avio_wb64(pb, avio_size(matroska->ctx->pb));
+    avio_wb64(pb, matroska->segment_start);
+    avio_wb64(pb, matroska->time_scale);
+}
+
+static int matroska_check_index_cache_id(MatroskaDemuxContext *matroska,
+                                         AVIOContext *pb)
+{
+    return avio_rb32(pb) == INDEX_CACHE_MAGIC &&
+           avio_rb32(pb) == INDEX_CACHE_VERSION &&
+           avio_rb64(pb) == avio_size(matroska->ctx->pb) &&
+           avio_rb64(pb) == matroska->segment_start &&
+           avio_rb64(pb) == matroska->time_scale;
+}
+
+/* Merge the cluster index saved by an earlier session into the streams. */
+static void matroska_load_index_cache(MatroskaDemuxContext *matroska)
+{
+    AVFormatContext *s = matroska->ctx;
+    AVIOContext *pb;
+    int nb_tracks;
+
+    if (!matroska->index_cache || (s->flags & AVFMT_FLAG_IGNIDX) ||
+        !(s->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return;
+
+    if (avio_open2(&pb, matroska->index_cache, AVIO_FLAG_READ,
+                   &s->interrupt_callback, NULL) < 0)
+        return;
+
+    if (!matroska_check_index_cache_id(matroska, pb)) {
+        av_log(s, AV_LOG_VERBOSE, "Ignoring index cache %s written for another file\n",
+               matroska->index_cache);
+        goto end;
+    }
+
+    nb_tracks = avio_rb32(pb);
+    for (int i = 0; i < nb_tracks && !avio_feof(pb); i++) {
+        MatroskaTrack *track = matroska_find_track_by_num(matroska, avio_rb64(pb));
+        uint32_t nb_entries  = avio_rb32(pb);
+
+        for (uint32_t j = 0; j < nb_entries && !avio_feof(pb); j++) {
+            int64_t pos       = avio_rb64(pb);
+            int64_t timestamp = avio_rb64(pb);
+
+            if (track && track->stream && pos >= matroska->segment_start)
+                av_add_index_entry(track->stream, pos, timestamp, 0, 0,
+                                   AVINDEX_KEYFRAME);
+        }
+    }
+
+    matroska->index_cache_entries = matroska_count_index_entries(matroska);
+    av_log(s, AV_LOG_VERBOSE, "Loaded index cache %s\n", matroska->index_cache);
+
+end:
+    avio_closep(&pb);
+}
+
+/* Persist the index if clusters parsed in this session have extended it. */
+static void matroska_store_index_cache(MatroskaDemuxContext *matroska)
+{
+    AVFormatContext *s = matroska->ctx;
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    AVIOContext *pb = NULL;
+    AVBPrint tmp;
+    int nb_tracks = 0, ret;
+
+    if (!matroska->index_cache || (s->flags & AVFMT_FLAG_IGNIDX) ||
+        !s->pb || !(s->pb->seekable & AVIO_SEEKABLE_NORMAL) ||
+        matroska_count_index_entries(matroska) <= matroska->index_cache_entries)
+        return;
+
+    for (int i = 0; i < matroska->tracks.nb_elem; i++)
+        nb_tracks += tracks[i].stream && ffstream(tracks[i].stream)->nb_index_entries;
+
+    av_bprint_init(&tmp, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    av_bprintf(&tmp, "%s.tmp", matroska->index_cache);
+    if (!av_bprint_is_complete(&tmp)) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = avio_open2(&pb, tmp.str, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
+    if (ret < 0)
+        goto end;
+
+    matroska_write_index_cache_id(matroska, pb);
+    avio_wb32(pb, nb_tracks);
+    for (int i = 0; i < matroska->tracks.nb_elem; i++) {
+        const FFStream *sti;
+
+        if (!tracks[i].stream || !ffstream(tracks[i].stream)->nb_index_entries)
+            continue;
+        sti = ffstream(tracks[i].stream);
+
+        avio_wb64(pb, tracks[i].num);
+        avio_wb32(pb, sti->nb_index_entries);
+        for (int j = 0; j < sti->nb_index_entries; j++) {
+            avio_wb64(pb, sti->index_entries[j].pos);
+            avio_wb64(pb, sti->index_entries[j].timestamp);
+        }
+    }
+
+    ret = avio_closep(&pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp.str, matroska->index_cache, s);
+
+end:
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Could not write index cache %s: %s\n",
+               matroska->index_cache, av_err2str(ret));
+    avio_closep(&pb);
+    av_bprint_finalize(&tmp, NULL);
+}
+//PLEX
+
 static int matroska_parse_content_encodings(MatroskaTrackEncoding *encodings,
                                             unsigned nb_encodings,
                                             MatroskaTrack *track,
@@ -3347,7 +3588,8 @@ static int matroska_read_header(AVFormatContext *s)
     attachments = attachments_list->elem;
     for (j = 0; j < attachments_list->nb_elem; j++) {
         if (!(attachments[j].filename && attachments[j].mime &&
-              attachments[j].bin.data && attachments[j].bin.size > 0)) {
+              ((attachments[j].bin.data && attachments[j].bin.size > 0) ||
+               attachments[j].lazy_size > 0))) { //PLEX
             av_log(matroska->ctx, AV_LOG_ERROR, "incomplete attachment\n");
         } else {
             AVStream *st = avformat_new_stream(s, NULL);
@@ -3369,7 +3611,13 @@ static int matroska_read_header(AVFormatContext *s)
             attachments[j].stream = st;
 
             if (st->codecpar->codec_id != AV_CODEC_ID_NONE) {
-                res = ff_add_attached_pic(s, st, NULL, &attachments[j].bin.buf, 0);
+                //PLEX
+                if (attachments[j].lazy_size > 0)
+                    res = ff_add_lazy_attached_pic(s, st, attachments[j].lazy_pos,
+                                                   attachments[j].lazy_size, NULL, 0);
+                else
+                    res = ff_add_attached_pic(s, st, NULL, &attachments[j].bin.buf, 0);
+                //PLEX
                 if (res < 0)
                     return res;
             } else {
@@ -3402,6 +3650,7 @@ static int matroska_read_header(AVFormatContext *s)
         }
 
     matroska_add_index_entries(matroska);
+    matroska_load_index_cache(matroska); //PLEX
 
     matroska_convert_tags(s);
 
@@ -4033,6 +4282,19 @@ static int matroska_parse_frame(MatroskaDemuxContext *matroska,
     pkt->pos = pos;
     pkt->duration = lace_duration;
 
+    //PLEX
+    /* pos is where the block data starts; the payload is still in place
+     * unless it had to be decoded */
+    if (buf && !track->needs_decoding) {
+        res = ff_add_source_range(matroska->ctx, st, pkt, matroska->ctx->pb,
+                                  pos + (pkt_data - buf->data));
+        if (res < 0) {
+            av_packet_unref(pkt);
+            return res;
+        }
+    }
+    //PLEX
+
     res = avpriv_packet_list_put(&matroska->queue, pkt, NULL, 0);
     if (res < 0) {
         av_packet_unref(pkt);
@@ -4048,6 +4310,28 @@ fail:
     return res;
 }
 
+//PLEX
+/* Undo header stripping without copying the payload: the block header and
+ * lace sizes in front of the first frame are no longer needed, so the
+ * stripped bytes can be written there when they fit. */
+static int matroska_restore_header_in_place(MatroskaTrack *track, AVBufferRef *buf,
+                                            uint8_t **data, int *size)
+{
+    const MatroskaTrackEncoding *encodings = track->encodings.elem;
+    int header_size = encodings[0].compression.settings.size;
+
+    if (encodings[0].compression.algo != MATROSKA_TRACK_ENCODING_COMP_HEADERSTRIP ||
+        !header_size || !encodings[0].compression.settings.data ||
+        *data - buf->data < header_size || !av_buffer_is_writable(buf))
+        return 0;
+
+    *data -= header_size;
+    *size += header_size;
+    memcpy(*data, encodings[0].compression.settings.data, header_size);
+    return 1;
+}
+//PLEX
+
 static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf, uint8_t *data,
                                 int size, int64_t pos, uint64_t cluster_time,
                                 uint64_t block_duration, int is_keyframe,
@@ -4154,7 +4438,8 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
         uint8_t *out_data = data;
         int      out_size = lace_size[n];
 
-        if (track->needs_decoding) {
+        if (track->needs_decoding && //PLEX
+            !(n == 0 && buf && matroska_restore_header_in_place(track, buf, &out_data, &out_size))) {
             res = matroska_decode_buffer(&out_data, &out_size, track);
             if (res < 0)
                 return res;
@@ -4348,6 +4633,8 @@ static int matroska_read_close(AVFormatContext *s)
     MatroskaTrack *tracks = matroska->tracks.elem;
     int n;
 
+    matroska_store_index_cache(matroska); //PLEX
+
     matroska_clear_queue(matroska);
 
     for (n = 0; n < matroska->tracks.nb_elem; n++)
@@ -4802,10 +5089,25 @@ const AVInputFormat ff_webm_dash_manifest_demuxer = {
 };
 #endif
 
+//PLEX
+static const AVOption matroska_options[] = {
+    { "index_cache", "sidecar file keeping the cluster index between sessions", offsetof(MatroskaDemuxContext, index_cache), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+//PLEX
+
 const AVInputFormat ff_matroska_demuxer = {
     .name           = "matroska,webm",
     .long_name      = NULL_IF_CONFIG_SMALL("Matroska / WebM"),
     .extensions     = "mkv,mk3d,mka,mks,webm",
+    .priv_class     = &matroska_class, //PLEX
     .priv_data_size = sizeof(MatroskaDemuxContext),
     .flags_internal = FF_FMT_INIT_CLEANUP,
     .read_probe     = matroska_probe,
@@ -0,0 +1,447 @@
+/*
+ * In-memory segment store protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Keeps files written by segmenting muxers in memory instead of on disk.
+ *
+ * Files written to memstore:<name> are published to a process-wide store
+ * when they are closed, replacing any earlier file of the same name. Only
+ * the most recently published files are retained. The store can be read
+ * back through the protocol and, when a serve URL is given, is exported by
+ * a small HTTP server so that another process can pull segments directly.
+ */
+
+#include <stdatomic.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "avio.h"
+#include "url.h"
+
+typedef struct MemStoreEntry {
+    char *name;
+    AVBufferRef *buf;
+    struct MemStoreEntry *next;
+} MemStoreEntry;
+
+typedef struct MemStoreContext {
+    const AVClass *class;
+    int retention;
+    char *serve;
+
+    const char *name;
+    /* write side */
+    uint8_t *data;
+    unsigned int alloc;
+    /* read side */
+    AVBufferRef *buf;
+
+    int64_t size;
+    int64_t pos;
+} MemStoreContext;
+
+/* Entries are kept oldest first. */
+static AVMutex store_lock = AV_MUTEX_INITIALIZER;
+static MemStoreEntry *store_entries;
+static int store_nb_entries;
+static int store_retention = 32;
+/* The server runs while memstore handles are open. */
+static AVMutex server_lock = AV_MUTEX_INITIALIZER;
+static int store_nb_handles;
+static int server_started;
+static pthread_t server_thread;
+/* A request being served is not interrupted, only the wait for the next
+ * client and the shutdown of the listening context. */
+static atomic_int server_stop;
+static atomic_int server_idle;
+
+static const char *memstore_name(const char *url)
+{
+    av_strstart(url, "memstore:", &url);
+    return url;
+}
+
+static MemStoreEntry **store_find(const char *name)
+{
+    MemStoreEntry **e;
+
+    for (e = &store_entries; *e; e = &(*e)->next)
+        if (!strcmp((*e)->name, name))
+            break;
+    return e;
+}
+
+static void store_remove(MemStoreEntry **e)
+{
+    MemStoreEntry *entry = *e;
+
+    *e = entry->next;
+    av_buffer_unref(&entry->buf);
+    av_free(entry->name);
+    av_free(entry);
+    store_nb_entries--;
+}
+
+/* Publish a file, taking ownership of buf. Must hold store_lock. */
+static int store_publish(const char *name, AVBufferRef **buf)
+{
+    MemStoreEntry **e = store_find(name), *entry;
+
+    if (*e)
+        store_remove(e);
+
+    entry = av_mallocz(sizeof(*entry));
+    if (!entry || !(entry->name = av_strdup(name))) {
+        av_free(entry);
+        av_buffer_unref(buf);
+        return AVERROR(ENOMEM);
+    }
+    entry->buf = *buf;
+    *buf = NULL;
+
+    for (e = &store_entries; *e; e = &(*e)->next);
+    *e = entry;
+    store_nb_entries++;
+
+    while (store_nb_entries > store_retention)
+        store_remove(&store_entries);
+
+    return 0;
+}
+
+static AVBufferRef *store_get(const char *name)
+{
+    MemStoreEntry **e;
+    AVBufferRef *buf = NULL;
+
+    ff_mutex_lock(&store_lock);
+    e = store_find(name);
+    if (*e)
+        buf = av_buffer_ref((*e)->buf);
+    ff_mutex_unlock(&store_lock);
+
+    return buf;
+}
+
+static void serve_client(AVIOContext *client)
+{
+    AVBufferRef *buf = NULL;
+    uint8_t *resource = NULL;
+    int ret;
+
+    while ((ret = avio_handshake(client)) > 0) {
+        av_opt_get(client, "resource", AV_OPT_SEARCH_CHILDREN, &resource);
+        if (resource && *resource)
+            break;
+        av_freep(&resource);
+    }
+    if (ret < 0)
+        goto end;
+
+    if (resource)
+        buf = store_get((char *)resource + (*resource == '/'));
+    if ((ret = av_opt_set_int(client, "reply_code", buf ? 200 : 404,
+                              AV_OPT_SEARCH_CHILDREN)) < 0)
+        goto end;
+    while ((ret = avio_handshake(client)) > 0);
+    if (ret < 0)
+        goto end;
+
+    if (buf) {
+        avio_write(client, buf->data, buf->size);
+        avio_flush(client);
+    }
+
+end:
+    av_buffer_unref(&buf);
+    av_free(resource);
+    avio_close(client);
+}
+
+static int server_interrupt(void *opaque)
+{
+    return atomic_load(&server_stop) && atomic_load(&server_idle);
+}
+
+/* Serves the store until the last handle is closed. Requests are handled
+ * one at a time, which is plenty for a local consumer. */
+static void *server_loop(void *arg)
+{
+    AVIOContext *server = arg, *client;
+    int ret;
+
+    while (!atomic_load(&server_stop)) {
+        atomic_store(&server_idle, 1);
+        ret = avio_accept(server, &client);
+        if (ret < 0)
+            break;
+        atomic_store(&server_idle, 0);
+        serve_client(client);
+    }
+
+    atomic_store(&server_idle, 1);
+    avio_close(server);
+    return NULL;
+}
+
+/* Must hold server_lock. */
+static void server_stop_locked(void)
+{
+    if (!server_started)
+        return;
+    atomic_store(&server_stop, 1);
+    pthread_join(server_thread, NULL);
+    server_started = 0;
+}
+
+/* Must hold server_lock. */
+static int server_start(URLContext *h, const char *url)
+{
+    static const AVIOInterruptCB int_cb = { server_interrupt, NULL };
+    MemStoreContext *c = h->priv_data;
+    AVDictionary *opts = NULL;
+    AVIOContext *server = NULL;
+    int ret;
+
+    if (server_started)
+        return 0;
+
+    atomic_store(&server_stop, 0);
+    av_dict_set(&opts, "listen", "2", 0);
+    /* keeps the listening context from sending a chunk trailer on close */
+    av_dict_set(&opts, "chunked_post", "0", 0);
+    ret = avio_open2(&server, url, AVIO_FLAG_WRITE, &int_cb, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        av_log(h, AV_LOG_ERROR, "Could not listen on %s\n", c->serve);
+        return ret;
+    }
+
+    if ((ret = pthread_create(&server_thread, NULL, server_loop, server))) {
+        avio_close(server);
+        return AVERROR(ret);
+    }
+    server_started = 1;
+    av_log(h, AV_LOG_VERBOSE, "Serving the segment store on %s\n", url);
+    return 0;
+}
+
+static int memstore_open(URLContext *h, const char *url, int flags)
+{
+    MemStoreContext *c = h->priv_data;
+    int ret;
+
+    c->name = memstore_name(h->filename);
+    if (!*c->name)
+        return AVERROR(EINVAL);
+
+    if (c->retention > 0) {
+        ff_mutex_lock(&store_lock);
+        store_retention = c->retention;
+        ff_mutex_unlock(&store_lock);
+    }
+
+    if (flags & AVIO_FLAG_WRITE) {
+        if (flags & AVIO_FLAG_READ)
+            return AVERROR(EINVAL);
+        h->is_streamed = 0;
+    } else {
+        c->buf = store_get(c->name);
+        if (!c->buf)
+            return AVERROR(ENOENT);
+        c->size = c->buf->size;
+    }
+
+    ff_mutex_lock(&server_lock);
+    if (c->serve && (ret = server_start(h, c->serve)) < 0) {
+        ff_mutex_unlock(&server_lock);
+        av_buffer_unref(&c->buf);
+        return ret;
+    }
+    store_nb_handles++;
+    ff_mutex_unlock(&server_lock);
+    return 0;
+}
+
+static int memstore_read(URLContext *h, unsigned char *buf, int size)
+{
+    MemStoreContext *c = h->priv_data;
+
+    size = FFMIN(size, c->size - c->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, c->buf->data + c->pos, size);
+    c->pos += size;
+    return size;
+}
+
+static int memstore_write(URLContext *h, const unsigned char *buf, int size)
+{
+    MemStoreContext *c = h->priv_data;
+    int64_t end = c->pos + size;
+
+    if (end > INT_MAX)
+        return AVERROR(ENOMEM);
+    if (end > c->alloc) {
+        uint8_t *data = av_fast_realloc(c->data, &c->alloc, end);
+        if (!data)
+            return AVERROR(ENOMEM);
+        c->data = data;
+    }
+    /* A seek past the end leaves a hole; keep it zeroed. */
+    if (c->pos > c->size)
+        memset(c->data + c->size, 0, c->pos - c->size);
+
+    memcpy(c->data + c->pos, buf, size);
+    c->pos  = end;
+    c->size = FFMAX(c->size, end);
+    return size;
+}
+
+static int64_t memstore_seek(URLContext *h, int64_t pos, int whence)
+{
+    MemStoreContext *c = h->priv_data;
+
+    switch (whence) {
+    case AVSEEK_SIZE:
+        return c->size;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += c->pos;
+        break;
+    case SEEK_END:
+        pos += c->size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    c->pos = pos;
+    return pos;
+}
+
+static int memstore_close(URLContext *h)
+{
+    MemStoreContext *c = h->priv_data;
+    AVBufferRef *buf = NULL;
+    int ret = 0;
+
+    av_buffer_unref(&c->buf);
+    if (h->flags & AVIO_FLAG_WRITE) {
+        buf = c->data ? av_buffer_create(c->data, c->size, av_buffer_default_free, NULL, 0)
+                      : av_buffer_alloc(0);
+        if (!buf)
+            av_freep(&c->data);
+        c->data = NULL;
+    }
+
+    if (h->flags & AVIO_FLAG_WRITE) {
+        ff_mutex_lock(&store_lock);
+        ret = buf ? store_publish(c->name, &buf) : AVERROR(ENOMEM);
+        ff_mutex_unlock(&store_lock);
+    }
+
+    ff_mutex_lock(&server_lock);
+    if (!--store_nb_handles)
+        server_stop_locked();
+    ff_mutex_unlock(&server_lock);
+
+    return ret;
+}
+
+static int memstore_check(URLContext *h, int mask)
+{
+    AVBufferRef *buf = store_get(memstore_name(h->filename));
+
+    if (!buf)
+        return AVERROR(ENOENT);
+    av_buffer_unref(&buf);
+    return mask & (AVIO_FLAG_READ | AVIO_FLAG_WRITE);
+}
+
+static int memstore_delete(URLContext *h)
+{
+    MemStoreEntry **e;
+    int ret = AVERROR(ENOENT);
+
+    ff_mutex_lock(&store_lock);
+    e = store_find(memstore_name(h->filename));
+    if (*e) {
+        store_remove(e);
+        ret = 0;
+    }
+    ff_mutex_unlock(&store_lock);
+
+    return ret;
+}
+
+static int memstore_move(URLContext *h_src, URLContext *h_dst)
+{
+    MemStoreEntry **e;
+    AVBufferRef *buf = NULL;
+    int ret = AVERROR(ENOENT);
+
+    ff_mutex_lock(&store_lock);
+    e = store_find(memstore_name(h_src->filename));
+    if (*e) {
+        buf = (*e)->buf;
+        (*e)->buf = NULL;
+        store_remove(e);
+        ret = store_publish(memstore_name(h_dst->filename), &buf);
+    }
+    ff_mutex_unlock(&store_lock);
+
+    return ret;
+}
+
+#define OFFSET(x) offsetof(MemStoreContext, x)
+#define E AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption memstore_options[] = {
+    { "retention", "set the number of files kept in the store", OFFSET(retention), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
+    { "serve", "serve the store over HTTP at this URL", OFFSET(serve), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    { NULL }
+};
+
+static const AVClass memstore_class = {
+    .class_name = "memstore",
+    .item_name  = av_default_item_name,
+    .option     = memstore_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_memstore_protocol = {
+    .name                = "memstore",
+    .url_open            = memstore_open,
+    .url_read            = memstore_read,
+    .url_write           = memstore_write,
+    .url_seek            = memstore_seek,
+    .url_close           = memstore_close,
+    .url_check           = memstore_check,
+    .url_delete          = memstore_delete,
+    .url_move            = memstore_move,
+    .priv_data_size      = sizeof(MemStoreContext),
+    .priv_data_class     = &memstore_class,
+};
@@ -27,6 +27,7 @@
 
 #include <inttypes.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdint.h>
 
 #include "libavutil/attributes.h"
@@ -47,6 +48,7 @@
 #include "libavutil/sha.h"
 #include "libavutil/spherical.h"
 #include "libavutil/stereo3d.h"
+#include "libavutil/thread.h"
 #include "libavutil/timecode.h"
 #include "libavutil/uuid.h"
 #include "libavcodec/ac3tab.h"
@@ -189,6 +191,7 @@ static int mov_read_covr(MOVContext *c, AVIOContext *pb, int type, int len)
     AVStream *st;
     MOVStreamContext *sc;
     enum AVCodecID id;
+    const uint8_t *head; //PLEX
     int ret;
 
     switch (type) {
@@ -212,8 +215,9 @@ static int mov_read_covr(MOVContext *c, AVIOContext *pb, int type, int len)
     st = c->fc->streams[c->fc->nb_streams - 1];
     st->priv_data = sc;
 
-    if (st->attached_pic.size >= 8 && id != AV_CODEC_ID_BMP) {
-        if (AV_RB64(st->attached_pic.data) == 0x89504e470d0a1a0a) {
+    head = ff_attached_pic_head(st); //PLEX
+    if (head && id != AV_CODEC_ID_BMP) {
+        if (AV_RB64(head) == 0x89504e470d0a1a0a) {
             id = AV_CODEC_ID_PNG;
         } else {
             id = AV_CODEC_ID_MJPEG;
@@ -1066,11 +1070,99 @@ static int mov_read_pasp(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 }
 
 /* this atom contains actual media data */
+//PLEX
+#define MOV_PREFETCH_CHUNK (256 * 1024)
+
+/**
+ * Background read of the start of mdat through a second handle, so that a
+ * moov stored after mdat is read while the first packets are fetched.
+ * The data itself is dropped, the reads only warm the storage cache.
+ */
+typedef struct MOVPrefetch {
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    AVIOContext *pb;
+    int64_t pos;
+    int64_t size;
+    atomic_int abort;
+} MOVPrefetch;
+
+#if HAVE_THREADS
+static void *mov_prefetch_thread(void *arg)
+{
+    MOVPrefetch *p = arg;
+    uint8_t *buf = av_malloc(MOV_PREFETCH_CHUNK);
+    int64_t done = 0;
+
+    if (buf && avio_seek(p->pb, p->pos, SEEK_SET) >= 0) {
+        while (done < p->size && !atomic_load(&p->abort)) {
+            int ret = avio_read(p->pb, buf, FFMIN(MOV_PREFETCH_CHUNK, p->size - done));
+            if (ret <= 0)
+                break;
+            done += ret;
+        }
+    }
+    av_free(buf);
+    return NULL;
+}
+#endif
+
+static void mov_prefetch_start(MOVContext *c, int64_t pos, int64_t size)
+{
+#if HAVE_THREADS
+    const char *proto = avio_find_protocol_name(c->fc->url);
+    MOVPrefetch *p;
+
+    // only local and mounted files share a cache between handles
+    if (!proto || strcmp(proto, "file"))
+        return;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return;
+    p->pos  = pos;
+    p->size = size;
+    atomic_init(&p->abort, 0);
+    if (c->fc->io_open(c->fc, &p->pb, c->fc->url, AVIO_FLAG_READ, NULL) < 0) {
+        av_free(p);
+        return;
+    }
+    if (pthread_create(&p->thread, NULL, mov_prefetch_thread, p)) {
+        ff_format_io_close(c->fc, &p->pb);
+        av_free(p);
+        return;
+    }
+    av_log(c->fc, AV_LOG_DEBUG, "Prefetching %"PRId64" bytes of mdat at %"PRId64"\n",
+           size, pos);
+    c->prefetch = p;
+#endif
+}
+
+static void mov_prefetch_stop(MOVContext *c)
+{
+#if HAVE_THREADS
+    MOVPrefetch *p = c->prefetch;
+
+    if (!p)
+        return;
+    atomic_store(&p->abort, 1);
+    pthread_join(p->thread, NULL);
+    ff_format_io_close(c->fc, &p->pb);
+    av_freep(&c->prefetch);
+#endif
+}
+//PLEX
+
 static int mov_read_mdat(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 {
     if (atom.size == 0) /* wrong one (MP4) */
         return 0;
     c->found_mdat=1;
+    //PLEX: moov follows, fetch the first samples while it is read
+    if (!c->found_moov && !c->prefetch && c->prefetch_size > 0 &&
+        pb == c->fc->pb && (pb->seekable & AVIO_SEEKABLE_NORMAL))
+        mov_prefetch_start(c, avio_tell(pb), FFMIN(atom.size, c->prefetch_size));
     return 0; /* now go for moov */
 }
 
@@ -4200,16 +4292,189 @@ static int build_open_gop_key_points(AVStream *st)
     return 0;
 }
 
+//PLEX
+/* Samples added per step when the index is materialized on demand. */
+#define MOV_INDEX_BATCH 4096
+
+static void mov_index_free_tables(MOVStreamContext *sc)
+{
+    av_freep(&sc->chunk_offsets);
+    av_freep(&sc->sample_sizes);
+    av_freep(&sc->keyframes);
+    av_freep(&sc->stts_data);
+    av_freep(&sc->stps_data);
+    av_freep(&sc->rap_group);
+}
+
+/**
+ * Add index entries until the first nb_samples samples are indexed or the
+ * sample tables are exhausted.
+ */
+static int mov_index_materialize(MOVContext *mov, AVStream *st, unsigned int nb_samples)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    MOVIndexCursor *cur = &sc->index_cursor;
+    unsigned int end = FFMIN(nb_samples, sc->sample_count);
+    int rap_group_present = sc->rap_group_count && sc->rap_group;
+    int ret = 0;
+
+    if (!cur->active)
+        return 0;
+
+    if (cur->lazy && end > sti->nb_index_entries) {
+        AVIndexEntry *entries = av_fast_realloc(sti->index_entries,
+                                                &sti->index_entries_allocated_size,
+                                                end * sizeof(*sti->index_entries));
+        if (!entries) {
+            ret = AVERROR(ENOMEM);
+            goto done;
+        }
+        sti->index_entries = entries;
+    }
+
+    for (;;) {
+        unsigned int sample_size;
+        int keyframe = 0;
+
+        if (!cur->chunk_started) {
+            int64_t next_offset;
+
+            if (cur->chunk >= sc->chunk_count)
+                break;
+            next_offset = cur->chunk + 1 < sc->chunk_count ? sc->chunk_offsets[cur->chunk + 1] : INT64_MAX;
+            cur->offset = sc->chunk_offsets[cur->chunk];
+            while (mov_stsc_index_valid(cur->stsc_index, sc->stsc_count) &&
+                cur->chunk + 1 == sc->stsc_data[cur->stsc_index + 1].first)
+                cur->stsc_index++;
+
+            if (next_offset > cur->offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
+                sc->stsc_data[cur->stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - cur->offset) {
+                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
+                sc->stsz_sample_size = sc->sample_size;
+            }
+            if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
+                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
+                sc->stsz_sample_size = sc->sample_size;
+            }
+            cur->chunk_sample  = 0;
+            cur->chunk_started = 1;
+        }
+        if (cur->chunk_sample >= sc->stsc_data[cur->stsc_index].count) {
+            cur->chunk++;
+            cur->chunk_started = 0;
+            continue;
+        }
+
+        if (cur->sample >= end) {
+            if (end < sc->sample_count)
+                return 0;
+            av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+            ret = AVERROR_INVALIDDATA;
+            goto done;
+        }
+
+        if (!sc->keyframe_absent && (!sc->keyframe_count || cur->sample+cur->key_off == sc->keyframes[cur->stss_index])) {
+            keyframe = 1;
+            if (cur->stss_index + 1 < sc->keyframe_count)
+                cur->stss_index++;
+        } else if (sc->stps_count && cur->sample+cur->key_off == sc->stps_data[cur->stps_index]) {
+            keyframe = 1;
+            if (cur->stps_index + 1 < sc->stps_count)
+                cur->stps_index++;
+        }
+        if (rap_group_present && cur->rap_group_index < sc->rap_group_count) {
+            if (sc->rap_group[cur->rap_group_index].index > 0)
+                keyframe = 1;
+            if (++cur->rap_group_sample == sc->rap_group[cur->rap_group_index].count) {
+                cur->rap_group_sample = 0;
+                cur->rap_group_index++;
+            }
+        }
+        if (sc->keyframe_absent
+            && !sc->stps_count
+            && !rap_group_present
+            && (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || (cur->chunk==0 && cur->chunk_sample==0)))
+             keyframe = 1;
+        if (keyframe)
+            cur->distance = 0;
+        sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[cur->sample];
+        if (cur->offset > INT64_MAX - sample_size) {
+            av_log(mov->fc, AV_LOG_ERROR, "Current offset %"PRId64" or sample size %u is too large\n",
+                   cur->offset,
+                   sample_size);
+            ret = AVERROR_INVALIDDATA;
+            goto done;
+        }
+
+        if (sc->pseudo_stream_id == -1 ||
+           sc->stsc_data[cur->stsc_index].id - 1 == sc->pseudo_stream_id) {
+            AVIndexEntry *e;
+            if (sample_size > 0x3FFFFFFF) {
+                av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
+                ret = AVERROR_INVALIDDATA;
+                goto done;
+            }
+            e = &sti->index_entries[sti->nb_index_entries++];
+            e->pos = cur->offset;
+            e->timestamp = cur->dts;
+            e->size = sample_size;
+            e->min_distance = cur->distance;
+            e->flags = keyframe ? AVINDEX_KEYFRAME : 0;
+            av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
+                    "size %u, distance %u, keyframe %d\n", st->index, cur->sample,
+                    cur->offset, cur->dts, sample_size, cur->distance, keyframe);
+            if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && sti->nb_index_entries < 100)
+                ff_rfps_add_frame(mov->fc, st, cur->dts);
+        }
+
+        cur->offset += sample_size;
+        cur->stream_size += sample_size;
+
+        cur->dts += sc->stts_data[cur->stts_index].duration;
+
+        cur->distance++;
+        cur->stts_sample++;
+        cur->sample++;
+        cur->chunk_sample++;
+        if (cur->stts_index + 1 < sc->stts_count && cur->stts_sample == sc->stts_data[cur->stts_index].count) {
+            cur->stts_sample = 0;
+            cur->stts_index++;
+        }
+    }
+
+done:
+    cur->active = 0;
+    if (cur->lazy)
+        mov_index_free_tables(sc);
+    return ret;
+}
+
+/**
+ * Extend an on-demand index until it can answer a seek to timestamp.
+ */
+static void mov_index_cover(MOVContext *mov, AVStream *st, int64_t timestamp, int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+
+    while (sc->index_cursor.active) {
+        if (sti->nb_index_entries &&
+            sti->index_entries[sti->nb_index_entries - 1].timestamp > timestamp &&
+            ((flags & AVSEEK_FLAG_BACKWARD) || av_index_search_timestamp(st, timestamp, flags) >= 0))
+            break;
+        mov_index_materialize(mov, st, sti->nb_index_entries + MOV_INDEX_BATCH);
+    }
+}
+//PLEX
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
     FFStream *const sti = ffstream(st);
     int64_t current_offset;
     int64_t current_dts = 0;
-    unsigned int stts_index = 0;
     unsigned int stsc_index = 0;
-    unsigned int stss_index = 0;
-    unsigned int stps_index = 0;
     unsigned int i, j;
     uint64_t stream_size = 0;
     MOVCtts *ctts_data_old = sc->ctts_data;
@@ -4270,14 +4535,10 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     /* only use old uncompressed audio chunk demuxing when stts specifies it */
     if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
           sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
-        unsigned int current_sample = 0;
-        unsigned int stts_sample = 0;
-        unsigned int sample_size;
-        unsigned int distance = 0;
-        unsigned int rap_group_index = 0;
-        unsigned int rap_group_sample = 0;
-        int rap_group_present = sc->rap_group_count && sc->rap_group;
-        int key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+        MOVIndexCursor *cur = &sc->index_cursor;
+        //PLEX: the index can only be built on demand when the edit lists do not rewrite it afterwards
+        int lazy = mov->lazy_index && sc->pseudo_stream_id == -1 &&
+                   (mov->ignore_editlist || !mov->advanced_editlist || !sc->elst_count);
 
         current_dts -= sc->dts_shift;
 
@@ -4285,13 +4546,15 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             return;
         if (sc->sample_count >= UINT_MAX / sizeof(*sti->index_entries) - sti->nb_index_entries)
             return;
-        if (av_reallocp_array(&sti->index_entries,
-                              sti->nb_index_entries + sc->sample_count,
-                              sizeof(*sti->index_entries)) < 0) {
-            sti->nb_index_entries = 0;
-            return;
+        if (!lazy) {
+            if (av_reallocp_array(&sti->index_entries,
+                                  sti->nb_index_entries + sc->sample_count,
+                                  sizeof(*sti->index_entries)) < 0) {
+                sti->nb_index_entries = 0;
+                return;
+            }
+            sti->index_entries_allocated_size = (sti->nb_index_entries + sc->sample_count) * sizeof(*sti->index_entries);
         }
-        sti->index_entries_allocated_size = (sti->nb_index_entries + sc->sample_count) * sizeof(*sti->index_entries);
 
         if (ctts_data_old) {
             // Expand ctts entries such that we have a 1-1 mapping with samples
@@ -4318,96 +4581,26 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             av_free(ctts_data_old);
         }
 
-        for (i = 0; i < sc->chunk_count; i++) {
-            int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
-            current_offset = sc->chunk_offsets[i];
-            while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
-                i + 1 == sc->stsc_data[stsc_index + 1].first)
-                stsc_index++;
-
-            if (next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
-                sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
-            if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
-
-            for (j = 0; j < sc->stsc_data[stsc_index].count; j++) {
-                int keyframe = 0;
-                if (current_sample >= sc->sample_count) {
-                    av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
-                    return;
-                }
-
-                if (!sc->keyframe_absent && (!sc->keyframe_count || current_sample+key_off == sc->keyframes[stss_index])) {
-                    keyframe = 1;
-                    if (stss_index + 1 < sc->keyframe_count)
-                        stss_index++;
-                } else if (sc->stps_count && current_sample+key_off == sc->stps_data[stps_index]) {
-                    keyframe = 1;
-                    if (stps_index + 1 < sc->stps_count)
-                        stps_index++;
-                }
-                if (rap_group_present && rap_group_index < sc->rap_group_count) {
-                    if (sc->rap_group[rap_group_index].index > 0)
-                        keyframe = 1;
-                    if (++rap_group_sample == sc->rap_group[rap_group_index].count) {
-                        rap_group_sample = 0;
-                        rap_group_index++;
-                    }
-                }
-                if (sc->keyframe_absent
-                    && !sc->stps_count
-                    && !rap_group_present
-                    && (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || (i==0 && j==0)))
-                     keyframe = 1;
-                if (keyframe)
-                    distance = 0;
-                sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[current_sample];
-                if (current_offset > INT64_MAX - sample_size) {
-                    av_log(mov->fc, AV_LOG_ERROR, "Current offset %"PRId64" or sample size %u is too large\n",
-                           current_offset,
-                           sample_size);
-                    return;
-                }
-
-                if (sc->pseudo_stream_id == -1 ||
-                   sc->stsc_data[stsc_index].id - 1 == sc->pseudo_stream_id) {
-                    AVIndexEntry *e;
-                    if (sample_size > 0x3FFFFFFF) {
-                        av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
-                        return;
-                    }
-                    e = &sti->index_entries[sti->nb_index_entries++];
-                    e->pos = current_offset;
-                    e->timestamp = current_dts;
-                    e->size = sample_size;
-                    e->min_distance = distance;
-                    e->flags = keyframe ? AVINDEX_KEYFRAME : 0;
-                    av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
-                            "size %u, distance %u, keyframe %d\n", st->index, current_sample,
-                            current_offset, current_dts, sample_size, distance, keyframe);
-                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && sti->nb_index_entries < 100)
-                        ff_rfps_add_frame(mov->fc, st, current_dts);
-                }
-
-                current_offset += sample_size;
-                stream_size += sample_size;
-
-                current_dts += sc->stts_data[stts_index].duration;
-
-                distance++;
-                stts_sample++;
-                current_sample++;
-                if (stts_index + 1 < sc->stts_count && stts_sample == sc->stts_data[stts_index].count) {
-                    stts_sample = 0;
-                    stts_index++;
-                }
+        //PLEX
+        memset(cur, 0, sizeof(*cur));
+        cur->active  = 1;
+        cur->lazy    = lazy;
+        cur->dts     = current_dts;
+        cur->key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+        if (lazy) {
+            if (sc->stsz_sample_size > 0) {
+                stream_size = (uint64_t)sc->stsz_sample_size * sc->sample_count;
+            } else {
+                for (i = 0; i < sc->sample_count; i++)
+                    stream_size += (unsigned)sc->sample_sizes[i];
             }
+            mov_index_materialize(mov, st, MOV_INDEX_BATCH);
+        } else {
+            if (mov_index_materialize(mov, st, UINT_MAX) < 0)
+                return;
+            stream_size = cur->stream_size;
         }
+        //PLEX
         if (st->duration > 0)
             st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
     } else {
@@ -4774,13 +4967,10 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
             ffstream(st)->need_parsing = AVSTREAM_PARSE_FULL;
     }
     /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    //PLEX: an index built on demand still reads the sample tables
+    if (!sc->index_cursor.active)
+        mov_index_free_tables(sc);
     av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
     av_freep(&sc->sync_group);
     av_freep(&sc->sgpd_sync);
 
@@ -5301,6 +5491,9 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
 
+    //PLEX: fragments are inserted into the complete moov index
+    mov_index_materialize(c, st, UINT_MAX);
+
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
     //
@@ -8226,6 +8419,7 @@ static void mov_read_chapters(AVFormatContext *s)
 
         sc = st->priv_data;
         cur_pos = avio_tell(sc->pb);
+        mov_index_materialize(mov, st, UINT_MAX); //PLEX
 
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
@@ -8402,6 +8596,8 @@ static int mov_read_close(AVFormatContext *s)
     MOVContext *mov = s->priv_data;
     int i, j;
 
+    mov_prefetch_stop(mov); //PLEX
+
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *st = s->streams[i];
         MOVStreamContext *sc = st->priv_data;
@@ -8435,6 +8631,7 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->sgpd_sync);
         av_freep(&sc->sample_offsets);
         av_freep(&sc->open_key_samples);
+        ff_readahead_free(&sc->readahead); //PLEX
         av_freep(&sc->display_matrix);
         av_freep(&sc->index_ranges);
 
@@ -8825,17 +9022,27 @@ static int mov_read_header(AVFormatContext *s)
     return 0;
 }
 
+static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags); //PLEX
+
 static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
 {
     AVIndexEntry *sample = NULL;
     int64_t best_dts = INT64_MAX;
-    int i;
+    int i, resynced = 0; //PLEX
     MOVContext *mov = s->priv_data;
     int no_interleave = !mov->interleaved_read || !(s->pb->seekable & AVIO_SEEKABLE_NORMAL);
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         FFStream *const avsti = ffstream(avst);
         MOVStreamContext *msc = avst->priv_data;
+        //PLEX: samples of discarded streams are not read, do not step through them
+        if (avst->discard == AVDISCARD_ALL)
+            msc->discard_skipped = 1;
+        if (msc->discard_skipped)
+            continue;
+        //PLEX: keep an on-demand index ahead of the reader, the next entry gives the duration
+        if (msc->index_cursor.active && msc->current_sample + 1 >= avsti->nb_index_entries)
+            mov_index_materialize(mov, avst, msc->current_sample + 1 + MOV_INDEX_BATCH);
         if (msc->pb && msc->current_sample < avsti->nb_index_entries) {
             AVIndexEntry *current_sample = &avsti->index_entries[msc->current_sample];
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
@@ -8852,6 +9059,22 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
             }
         }
     }
+
+    //PLEX: a stream that is no longer discarded rejoins at the read position
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *avst = s->streams[i];
+        MOVStreamContext *msc = avst->priv_data;
+        if (!msc->discard_skipped || avst->discard == AVDISCARD_ALL)
+            continue;
+        msc->discard_skipped = 0;
+        if (sample &&
+            mov_seek_stream(s, avst, av_rescale(best_dts, msc->time_scale, AV_TIME_BASE), 0) < 0)
+            mov_current_sample_set(msc, ffstream(avst)->nb_index_entries);
+        resynced = 1;
+    }
+    if (resynced)
+        return mov_find_next_sample(s, st);
+    //PLEX
     return sample;
 }
 
@@ -8942,6 +9165,30 @@ static int get_eia608_packet(AVIOContext *pb, AVPacket *pkt, int size)
     return 0;
 }
 
+//PLEX
+/**
+ * @return the number of bytes from sample on that belong to samples of the
+ *         same track stored back to back, up to the read-ahead window
+ */
+static int64_t mov_contiguous_run(MOVContext *mov, AVStream *st, const AVIndexEntry *sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    const AVIndexEntry *e   = sample;
+    const AVIndexEntry *end = sti->index_entries + sti->nb_index_entries;
+    int64_t len = sample->size;
+
+    if (ff_readahead_covers(&sc->readahead, sample->pos, sample->size))
+        return len;
+    while (e + 1 < end && e[1].pos == sample->pos + len &&
+           len + e[1].size <= mov->readahead_window) {
+        e++;
+        len += e->size;
+    }
+    return len;
+}
+//PLEX
+
 static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
@@ -8971,7 +9218,12 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     }
 
     if (st->discard != AVDISCARD_ALL) {
-        int64_t ret64 = avio_seek(sc->pb, sample->pos, SEEK_SET);
+        //PLEX: far apart tracks are read a contiguous run at a time
+        int readahead = st->codecpar->codec_id != AV_CODEC_ID_EIA_608 &&
+                        !mov->next_root_atom && !(mov->dv_demux && sc->dv_audio_container) &&
+                        ff_readahead_wanted(&sc->readahead, sc->pb, sample->pos,
+                                            sample->size, mov->readahead_window);
+        int64_t ret64 = readahead ? sample->pos : avio_seek(sc->pb, sample->pos, SEEK_SET);
         if (ret64 != sample->pos) {
             av_log(mov->fc, AV_LOG_ERROR, "stream %d, offset 0x%"PRIx64": partial file\n",
                    sc->ffindex, sample->pos);
@@ -8990,6 +9242,9 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 
         if (st->codecpar->codec_id == AV_CODEC_ID_EIA_608 && sample->size > 8)
             ret = get_eia608_packet(sc->pb, pkt, sample->size);
+        else if (readahead) //PLEX
+            ret = ff_readahead_get_packet(&sc->readahead, sc->pb, pkt, sample->pos, sample->size,
+                                          mov_contiguous_run(mov, st, sample));
         else
             ret = av_get_packet(sc->pb, pkt, sample->size);
         if (ret < 0) {
@@ -9077,6 +9332,15 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
+    //PLEX
+    if (!mov->aax_mode && !mov->decryption_key && !(mov->dv_demux && sc->dv_audio_container) &&
+        st->codecpar->codec_id != AV_CODEC_ID_EIA_608 && pkt->size == sample->size) {
+        ret = ff_add_source_range(s, st, pkt, sc->pb, sample->pos);
+        if (ret < 0)
+            return ret;
+    }
+    //PLEX
+
     if (mov->aax_mode)
         aax_filter(pkt->data, pkt->size, mov);
 
@@ -9165,6 +9429,8 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
+    mov_index_cover(s->priv_data, st, timestamp, flags); //PLEX
+
     for (;;) {
         sample = av_index_search_timestamp(st, timestamp, flags);
         av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
@@ -9336,6 +9602,16 @@ static const AVOption mov_options[] = {
         {.i64 = 0}, 0, 1, FLAGS },
     { "max_stts_delta", "treat offsets above this value as invalid", OFFSET(max_stts_delta), AV_OPT_TYPE_INT, {.i64 = UINT_MAX-48000*10 }, 0, UINT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "interleaved_read", "Interleave packets from multiple tracks at demuxer level", OFFSET(interleaved_read), AV_OPT_TYPE_BOOL, {.i64 = 1 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    //PLEX
+    { "lazy_index", "Build the sample index while reading instead of at open, "
+        "the exported index then only covers the samples read or seeked over so far",
+        OFFSET(lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
+    { "prefetch_size", "Bytes of mdat to read ahead in the background when moov is stored after it",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT64, {.i64 = 4 << 20}, 0, INT64_MAX, FLAGS },
+    { "readahead_window", "Read samples of a track stored apart from the current read position "
+        "this many bytes at a time, so badly interleaved files are read sequentially",
+        OFFSET(readahead_window), AV_OPT_TYPE_INT, {.i64 = 1 << 20}, 0, INT_MAX, FLAGS },
+    //PLEX
 
     { NULL },
 };
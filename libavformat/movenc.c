@@ -21,10 +21,19 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
 #include "config_components.h"
 
 #include <stdint.h>
 #include <inttypes.h>
+//PLEX
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_IO_H
+#include <io.h>
+#endif
+//PLEX
 
 #include "movenc.h"
 #include "avformat.h"
@@ -59,11 +68,13 @@
 #include "libavutil/timecode.h"
 #include "libavutil/dovi_meta.h"
 #include "libavutil/uuid.h"
+#include "libavutil/file_open.h" //PLEX
 #include "hevc.h"
 #include "rtpenc.h"
 #include "mov_chan.h"
 #include "movenc_ttml.h"
 #include "mux.h"
+#include "os_support.h" //PLEX
 #include "rawutils.h"
 #include "ttmlenc.h"
 #include "version.h"
@@ -109,7 +120,7 @@ static const AVOption options[] = {
     { "fragment_index", "Fragment number of the next fragment", offsetof(MOVMuxContext, fragments), AV_OPT_TYPE_INT, {.i64 = 1}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
     { "mov_gamma", "gamma value for gama atom", offsetof(MOVMuxContext, gamma), AV_OPT_TYPE_FLOAT, {.dbl = 0.0 }, 0.0, 10, AV_OPT_FLAG_ENCODING_PARAM},
     { "frag_interleave", "Interleave samples within fragments (max number of consecutive samples, lower is tighter interleaving, but with more overhead)", offsetof(MOVMuxContext, frag_interleave), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
-    { "encryption_scheme",    "Configures the encryption scheme, allowed values are none, cenc-aes-ctr", offsetof(MOVMuxContext, encryption_scheme_str),   AV_OPT_TYPE_STRING, {.str = NULL}, .flags = AV_OPT_FLAG_ENCODING_PARAM },
+    { "encryption_scheme",    "Configures the encryption scheme, allowed values are none, cenc-aes-ctr, cbcs-aes-cbc", offsetof(MOVMuxContext, encryption_scheme_str),   AV_OPT_TYPE_STRING, {.str = NULL}, .flags = AV_OPT_FLAG_ENCODING_PARAM },
     { "encryption_key", "The media encryption key (hex)", offsetof(MOVMuxContext, encryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_ENCODING_PARAM },
     { "encryption_kid", "The media encryption key identifier (hex)", offsetof(MOVMuxContext, encryption_kid), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_ENCODING_PARAM },
     { "use_stream_ids_as_track_ids", "use stream ids as track ids", offsetof(MOVMuxContext, use_stream_ids_as_track_ids), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
@@ -121,6 +132,8 @@ static const AVOption options[] = {
     { "empty_hdlr_name", "write zero-length name string in hdlr atoms within mdia and minf atoms", offsetof(MOVMuxContext, empty_hdlr_name), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
 //PLEX
     { "mov_res", "Override resolution of video", offsetof(MOVMuxContext, video_width), AV_OPT_TYPE_IMAGE_SIZE, .flags = AV_OPT_FLAG_ENCODING_PARAM },
+    { "frag_spill_size", "move fragment payload beyond this size to a temporary file", offsetof(MOVMuxContext, frag_spill_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { "expected_duration", "expected output duration, lets faststart reserve the moov space up front", offsetof(MOVMuxContext, expected_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM },
 //PLEX
     { "movie_timescale", "set movie timescale", offsetof(MOVMuxContext, movie_timescale), AV_OPT_TYPE_INT, {.i64 = MOV_TIMESCALE}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
     { NULL },
@@ -2843,7 +2856,7 @@ static int mov_write_stbl_tag(AVFormatContext *s, AVIOContext *pb, MOVMuxContext
     mov_write_stsc_tag(pb, track);
     mov_write_stsz_tag(pb, track);
     mov_write_stco_tag(pb, track);
-    if (track->cenc.aes_ctr) {
+    if ((track->cenc.aes_ctr || track->cenc.aes_cbc) && track->entry) { //PLEX
         ff_mov_cenc_write_stbl_atoms(&track->cenc, pb);
     }
     if (track->par->codec_id == AV_CODEC_ID_OPUS || track->par->codec_id == AV_CODEC_ID_AAC) {
@@ -4189,6 +4202,59 @@ static int mov_write_covr(AVIOContext *pb, AVFormatContext *s)
     return pos ? update_size(pb, pos) : 0;
 }
 
+//PLEX
+/* iTunes gapless information of the first audio track: encoder delay,
+ * end padding and number of presented samples */
+static int mov_write_itunsmpb_tag(AVIOContext *pb, MOVMuxContext *mov,
+                                  AVFormatContext *s)
+{
+    char value[128];
+    int64_t pos, start, end, priming, length, padding = 0;
+    MOVTrack *track = NULL;
+
+    if (mov->mode != MODE_IPOD || (mov->flags & FF_MOV_FLAG_FRAGMENT))
+        return 0;
+    for (int i = 0; i < mov->nb_streams; i++) {
+        if (mov->tracks[i].par->codec_type == AVMEDIA_TYPE_AUDIO) {
+            track = &mov->tracks[i];
+            break;
+        }
+    }
+    if (!track || !track->entry)
+        return 0;
+
+    get_pts_range(mov, track, &start, &end);
+    priming = FFMAX(-start, 0);
+    length  = end - FFMAX(start, 0);
+    if (!priming || length <= 0)
+        return 0;
+    if (track->par->frame_size > 0)
+        padding = FFMAX((int64_t)track->entry * track->par->frame_size - priming - length, 0);
+
+    snprintf(value, sizeof(value), " 00000000 %08"PRIX32" %08"PRIX32" %016"PRIX64
+             " 00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000",
+             (uint32_t)priming, (uint32_t)padding, (uint64_t)length);
+
+    pos = avio_tell(pb);
+    avio_wb32(pb, 0); /* size */
+    ffio_wfourcc(pb, "----");
+    avio_wb32(pb, 28);
+    ffio_wfourcc(pb, "mean");
+    avio_wb32(pb, 0);
+    avio_write(pb, "com.apple.iTunes", 16);
+    avio_wb32(pb, 20);
+    ffio_wfourcc(pb, "name");
+    avio_wb32(pb, 0);
+    avio_write(pb, "iTunSMPB", 8);
+    avio_wb32(pb, 16 + strlen(value));
+    ffio_wfourcc(pb, "data");
+    avio_wb32(pb, 1); /* UTF-8 */
+    avio_wb32(pb, 0);
+    avio_write(pb, value, strlen(value));
+    return update_size(pb, pos);
+}
+//PLEX
+
 /* iTunes meta data list */
 static int mov_write_ilst_tag(AVIOContext *pb, MOVMuxContext *mov,
                               AVFormatContext *s)
@@ -4227,6 +4293,7 @@ static int mov_write_ilst_tag(AVIOContext *pb, MOVMuxContext *mov,
     mov_write_trkn_tag(pb, mov, s, 0); // track number
     mov_write_trkn_tag(pb, mov, s, 1); // disc number
     mov_write_tmpo_tag(pb, s);
+    mov_write_itunsmpb_tag(pb, mov, s); //PLEX
     return update_size(pb, pos);
 }
 
@@ -5100,6 +5167,10 @@ static int mov_write_traf_tag(AVIOContext *pb, MOVMuxContext *mov,
         }
     }
     mov_write_trun_tag(pb, mov, track, moof_size, start, track->entry);
+    //PLEX
+    if (track->cenc.aes_ctr || track->cenc.aes_cbc)
+        ff_mov_cenc_write_traf_atoms(&track->cenc, pb, moof_offset);
+    //PLEX
     if (mov->mode == MODE_ISM) {
         mov_write_tfxd_tag(pb, track);
 
@@ -5830,6 +5901,153 @@ static int mov_write_squashed_packets(AVFormatContext *s)
     return 0;
 }
 
+//PLEX
+#define SPILL_BUF_SIZE (256 * 1024)
+
+/* Move the buffered payload of a fragment to a temporary file, so that
+ * memory use is bounded by frag_spill_size rather than the fragment size. */
+static int mov_spill_mdat(AVFormatContext *s, MOVTrack *trk)
+{
+    uint8_t *buf;
+    int size = avio_get_dyn_buf(trk->mdat_buf, &buf);
+
+    if (!trk->spill_name) {
+        int fd = avpriv_tempfile("movenc", &trk->spill_name, 0, s);
+        if (fd < 0)
+            return fd;
+        trk->spill_fd = fd;
+    }
+
+    trk->mdat_spilled += size;
+    while (size > 0) {
+        int ret = write(trk->spill_fd, buf, size);
+        if (ret < 0) {
+            ret = AVERROR(errno);
+            av_log(s, AV_LOG_ERROR, "Could not write to %s: %s\n",
+                   trk->spill_name, av_err2str(ret));
+            return ret;
+        }
+        buf  += ret;
+        size -= ret;
+    }
+    ffio_free_dyn_buf(&trk->mdat_buf);
+    return 0;
+}
+
+static int mov_write_spilled_mdat(AVFormatContext *s, MOVTrack *trk)
+{
+    int64_t left = trk->mdat_spilled;
+    uint8_t *buf;
+    int ret = 0;
+
+    if (!(buf = av_malloc(SPILL_BUF_SIZE)))
+        return AVERROR(ENOMEM);
+
+    if (lseek(trk->spill_fd, 0, SEEK_SET) < 0)
+        ret = AVERROR(errno);
+    while (ret >= 0 && left > 0) {
+        ret = read(trk->spill_fd, buf, FFMIN(left, SPILL_BUF_SIZE));
+        if (ret <= 0) {
+            ret = ret < 0 ? AVERROR(errno) : AVERROR(EIO);
+            break;
+        }
+        avio_write(s->pb, buf, ret);
+        left -= ret;
+    }
+    av_free(buf);
+
+    if (ret >= 0 && lseek(trk->spill_fd, 0, SEEK_SET) < 0)
+        ret = AVERROR(errno);
+    if (ret < 0)
+        av_log(s, AV_LOG_ERROR, "Could not read back %s: %s\n",
+               trk->spill_name, av_err2str(ret));
+    trk->mdat_spilled = 0;
+    return ret < 0 ? ret : 0;
+}
+
+/* smallest run of payloads worth a separate kernel copy */
+#define PAYLOAD_REF_MIN_SEND (16 * 1024)
+
+/* Keep the payload of a packet that carries its location in the input file
+ * by reference, so that it can be sent from the file when the fragment is
+ * flushed. Returns 1 if the packet was taken, 0 if it has to be copied. */
+static int mov_add_payload_ref(MOVTrack *trk, const AVPacket *pkt)
+{
+    const AVPacketSourceRange *range;
+    MOVPayloadRef *ref;
+    size_t sd_size;
+
+    range = (const AVPacketSourceRange *)av_packet_get_side_data(pkt, AV_PKT_DATA_SOURCE_RANGE,
+                                                                 &sd_size);
+    if (!range || sd_size < sizeof(*range) || !range->file || !pkt->buf)
+        return 0;
+
+    ref = av_fast_realloc(trk->payload_refs, &trk->payload_refs_alloc,
+                          (trk->nb_payload_refs + 1) * sizeof(*ref));
+    if (!ref)
+        return AVERROR(ENOMEM);
+    trk->payload_refs = ref;
+    ref += trk->nb_payload_refs;
+
+    if (!(ref->buf = av_buffer_ref(pkt->buf)))
+        return AVERROR(ENOMEM);
+    if (!(ref->file = av_buffer_ref(range->file))) {
+        av_buffer_unref(&ref->buf);
+        return AVERROR(ENOMEM);
+    }
+    ref->buf_pos = avio_tell(trk->mdat_buf);
+    ref->data    = pkt->data;
+    ref->size    = pkt->size;
+    ref->offset  = range->offset;
+    trk->nb_payload_refs++;
+    trk->payload_ref_bytes += pkt->size;
+    return 1;
+}
+
+static void mov_free_payload_refs(MOVTrack *trk)
+{
+    for (int i = 0; i < trk->nb_payload_refs; i++) {
+        av_buffer_unref(&trk->payload_refs[i].buf);
+        av_buffer_unref(&trk->payload_refs[i].file);
+    }
+    trk->nb_payload_refs   = 0;
+    trk->payload_ref_bytes = 0;
+}
+
+/* Write the buffered part of a fragment with the referenced payloads in
+ * between. Payloads that follow each other in the input file are sent
+ * together, straight from the file when the output protocol can. */
+static void mov_write_mdat_refs(AVFormatContext *s, MOVTrack *trk,
+                                const uint8_t *buf, int buf_size)
+{
+    int64_t pos = 0;
+
+    for (int i = 0; i < trk->nb_payload_refs;) {
+        const MOVPayloadRef *ref = &trk->payload_refs[i];
+        int64_t size = ref->size;
+        int n = 1, ret = AVERROR(ENOSYS);
+
+        avio_write(s->pb, buf + pos, ref->buf_pos - pos);
+        pos = ref->buf_pos;
+
+        while (i + n < trk->nb_payload_refs && ref[n].buf_pos == pos &&
+               ref[n].file->data == ref->file->data && ref[n].offset == ref->offset + size &&
+               size + ref[n].size <= INT_MAX) {
+            size += ref[n].size;
+            n++;
+        }
+        if (size >= PAYLOAD_REF_MIN_SEND)
+            ret = ffio_write_from_fd(s->pb, *(const int *)ref->file->data, ref->offset, size);
+        if (ret == AVERROR(ENOSYS))
+            for (int j = 0; j < n; j++)
+                avio_write(s->pb, ref[j].data, ref[j].size);
+        i += n;
+    }
+    avio_write(s->pb, buf + pos, buf_size - pos);
+    mov_free_payload_refs(trk);
+}
+//PLEX
+
 static int mov_flush_fragment(AVFormatContext *s, int force)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -5942,6 +6160,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         for (i = 0; i < mov->nb_streams; i++) {
             mov->tracks[i].entry = 0;
             mov->tracks[i].end_reliable = 0;
+            ff_mov_cenc_flush(&mov->tracks[i].cenc); //PLEX
         }
         avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
         return 0;
@@ -5978,6 +6197,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
             continue;
         if (track->mdat_buf)
             mdat_size += avio_tell(track->mdat_buf);
+        mdat_size += track->mdat_spilled + track->payload_ref_bytes; //PLEX
         if (first_track < 0)
             first_track = i;
     }
@@ -5997,7 +6217,8 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         if (mov->flags & FF_MOV_FLAG_SEPARATE_MOOF) {
             if (!track->entry)
                 continue;
-            mdat_size = avio_tell(track->mdat_buf);
+            mdat_size = track->mdat_buf ? avio_tell(track->mdat_buf) : 0; //PLEX
+            mdat_size += track->mdat_spilled + track->payload_ref_bytes; //PLEX
             moof_tracks = i;
         } else {
             write_moof = i == first_track;
@@ -6016,11 +6237,24 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         track->entry = 0;
         track->entries_flushed = 0;
         track->end_reliable = 0;
+        //PLEX
+        ff_mov_cenc_flush(&track->cenc);
+        if (track->mdat_spilled) {
+            int ret = mov_write_spilled_mdat(s, track);
+            if (ret < 0)
+                return ret;
+        }
+        //PLEX
         if (!mov->frag_interleave) {
             if (!track->mdat_buf)
                 continue;
             buf_size = avio_close_dyn_buf(track->mdat_buf, &buf);
             track->mdat_buf = NULL;
+            //PLEX
+            mov_write_mdat_refs(s, track, buf, buf_size);
+            av_free(buf);
+            continue;
+            //PLEX
         } else {
             if (!mov->mdat_buf)
                 continue;
@@ -6121,6 +6355,13 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
                 }
             }
 
+            //PLEX
+            if (mov->frag_spill_size && !mov->frag_interleave && trk->mdat_buf &&
+                avio_tell(trk->mdat_buf) >= mov->frag_spill_size) {
+                if ((ret = mov_spill_mdat(s, trk)) < 0)
+                    return ret;
+            }
+            //PLEX
             if (!trk->mdat_buf) {
                 if ((ret = avio_open_dyn_buf(&trk->mdat_buf)) < 0)
                     return ret;
@@ -6214,7 +6455,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
                 return ret;
             avio_write(pb, reformatted_data, size);
         } else {
-            if (trk->cenc.aes_ctr) {
+            if (trk->cenc.aes_ctr || trk->cenc.aes_cbc) { //PLEX
                 size = ff_mov_cenc_avc_parse_nal_units(&trk->cenc, pb, pkt->data, size);
                 if (size < 0) {
                     ret = size;
@@ -6234,7 +6475,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
                 return ret;
             avio_write(pb, reformatted_data, size);
         } else {
-            if (trk->cenc.aes_ctr) {
+            if (trk->cenc.aes_ctr || trk->cenc.aes_cbc) { //PLEX
                 size = ff_mov_cenc_avc_parse_nal_units(&trk->cenc, pb, pkt->data, size);
                 if (size < 0) {
                     ret = size;
@@ -6283,7 +6524,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
             }
         }
     } else {
-        if (trk->cenc.aes_ctr) {
+        if (trk->cenc.aes_ctr || trk->cenc.aes_cbc) { //PLEX
             if (par->codec_id == AV_CODEC_ID_H264 && par->extradata_size > 4) {
                 int nal_size_length = (par->extradata[4] & 0x3) + 1;
                 ret = ff_mov_cenc_avc_write_nal_units(s, &trk->cenc, nal_size_length, pb, pkt->data, size);
@@ -6297,6 +6538,13 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
             if (ret) {
                 goto err;
             }
+        //PLEX
+        } else if (pb == trk->mdat_buf && !mov->frag_interleave && !mov->frag_spill_size &&
+                   size == pkt->size && (ret = mov_add_payload_ref(trk, pkt))) {
+            if (ret < 0)
+                goto err;
+            ret = 0;
+        //PLEX
         } else {
             avio_write(pb, pkt->data, size);
         }
@@ -6314,6 +6562,8 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     }
 
     trk->cluster[trk->entry].pos              = avio_tell(pb) - size;
+    if (pb == trk->mdat_buf) //PLEX
+        trk->cluster[trk->entry].pos         += trk->mdat_spilled + trk->payload_ref_bytes;
     trk->cluster[trk->entry].samples_in_chunk = samples_in_chunk;
     trk->cluster[trk->entry].chunkNum         = 0;
     trk->cluster[trk->entry].size             = size;
@@ -6899,6 +7149,15 @@ static void mov_free(AVFormatContext *s)
 
         ff_mov_cenc_free(&track->cenc);
         ffio_free_dyn_buf(&track->mdat_buf);
+        //PLEX
+        if (track->spill_name) {
+            close(track->spill_fd);
+            unlink(track->spill_name);
+            av_freep(&track->spill_name);
+        }
+        mov_free_payload_refs(track);
+        av_freep(&track->payload_refs);
+        //PLEX
 
         avpriv_packet_list_free(&track->squashed_packet_queue);
     }
@@ -6973,6 +7232,39 @@ static int mov_create_dvd_sub_decoder_specific_info(MOVTrack *track,
     return 0;
 }
 
+//PLEX
+/* Generous bound on the moov size for the given duration, assuming ctts
+ * and stss entries for video and a co64 chunk for every sample. */
+static int64_t estimate_moov_size(AVFormatContext *s, int64_t duration)
+{
+    int64_t size = 64 * 1024 + 256 * s->nb_chapters;
+
+    for (int i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        AVRational rate = { 10, 1 };
+        int bytes = 16; /* stsz, stts, co64 */
+
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0)
+                rate = st->avg_frame_rate;
+            else if (st->r_frame_rate.num > 0 && st->r_frame_rate.den > 0)
+                rate = st->r_frame_rate;
+            else
+                rate = (AVRational){ 60, 1 };
+            bytes += 12; /* ctts, stss */
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO && par->sample_rate > 0) {
+            rate = (AVRational){ par->sample_rate,
+                                 par->frame_size > 0 ? par->frame_size : 1024 };
+        }
+        size += 16 * 1024 + par->extradata_size;
+        size += av_rescale(duration, (int64_t)rate.num * bytes,
+                           (int64_t)rate.den * AV_TIME_BASE);
+    }
+    return size;
+}
+//PLEX
+
 static int mov_init(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -7033,6 +7325,18 @@ static int mov_init(AVFormatContext *s)
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
         mov->reserved_moov_size = -1;
+        //PLEX
+        if (mov->expected_duration > 0 && mov->mode != MODE_AVIF &&
+            !(mov->flags & FF_MOV_FLAG_FRAGMENT)) {
+            int64_t size = estimate_moov_size(s, mov->expected_duration);
+            if (size <= INT_MAX) {
+                av_log(s, AV_LOG_VERBOSE, "Reserving %"PRId64" bytes for the moov atom\n", size);
+                mov->reserved_moov_size = size;
+                mov->moov_estimated     = 1;
+                mov->flags &= ~FF_MOV_FLAG_FASTSTART;
+            }
+        }
+        //PLEX
     }
 
     if (mov->use_editlist < 0) {
@@ -7164,9 +7468,14 @@ static int mov_init(AVFormatContext *s)
         return AVERROR(ENOMEM);
 
     if (mov->encryption_scheme_str != NULL && strcmp(mov->encryption_scheme_str, "none") != 0) {
-        if (strcmp(mov->encryption_scheme_str, "cenc-aes-ctr") == 0) {
+        if (strcmp(mov->encryption_scheme_str, "cenc-aes-ctr") == 0)
             mov->encryption_scheme = MOV_ENC_CENC_AES_CTR;
+        //PLEX
+        else if (strcmp(mov->encryption_scheme_str, "cbcs-aes-cbc") == 0)
+            mov->encryption_scheme = MOV_ENC_CBCS_AES_CBC;
+        //PLEX
 
+        if (mov->encryption_scheme != MOV_ENC_NONE) {
             if (mov->encryption_key_len != AES_CTR_KEY_SIZE) {
                 av_log(s, AV_LOG_ERROR, "Invalid encryption key len %d expected %d\n",
                     mov->encryption_key_len, AES_CTR_KEY_SIZE);
@@ -7376,6 +7685,13 @@ static int mov_init(AVFormatContext *s)
                 s->flags & AVFMT_FLAG_BITEXACT);
             if (ret)
                 return ret;
+        //PLEX
+        } else if (mov->encryption_scheme == MOV_ENC_CBCS_AES_CBC) {
+            ret = ff_mov_cbcs_init(&track->cenc, mov->encryption_key, track->par,
+                                   s->flags & AVFMT_FLAG_BITEXACT);
+            if (ret)
+                return ret;
+        //PLEX
         }
     }
 
@@ -7695,6 +8011,23 @@ static int mov_write_trailer(AVFormatContext *s)
             ffio_wfourcc(pb, "mdat");
             avio_wb64(pb, mov->mdat_size + 16);
         }
+        //PLEX
+        if (mov->moov_estimated) {
+            int moov_size = get_moov_size(s);
+            if (moov_size < 0)
+                return moov_size;
+            if (moov_size > mov->reserved_moov_size - 8) {
+                av_log(s, AV_LOG_WARNING, "The moov atom needs %d bytes but only %d were reserved, "
+                       "falling back to a second pass\n", moov_size, mov->reserved_moov_size - 8);
+                /* The reserved space stays in front of mdat as a free atom. */
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+                avio_wb32(pb, mov->reserved_moov_size);
+                ffio_wfourcc(pb, "free");
+                mov->reserved_moov_size = 0;
+                mov->flags |= FF_MOV_FLAG_FASTSTART;
+            }
+        }
+        //PLEX
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
         if (mov->flags & FF_MOV_FLAG_FASTSTART) {
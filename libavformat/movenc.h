@@ -45,6 +45,21 @@
 #define MODE_F4V  0x80
 #define MODE_AVIF 0x100
 
+//PLEX
+/**
+ * A sample payload read verbatim from a local file, written after the
+ * first buf_pos bytes of the mdat_buf of its fragment.
+ */
+typedef struct MOVPayloadRef {
+    int64_t        buf_pos;
+    AVBufferRef   *buf;
+    const uint8_t *data;
+    int            size;
+    AVBufferRef   *file;   ///< owns the input file descriptor, see AVPacketSourceRange
+    int64_t        offset;
+} MOVPayloadRef;
+//PLEX
+
 typedef struct MOVIentry {
     uint64_t     pos;
     int64_t      dts;
@@ -170,11 +185,25 @@ typedef struct MOVTrack {
     unsigned int squash_fragment_samples_to_one; //< flag to note formats where all samples for a fragment are to be squashed
 
     PacketList squashed_packet_queue;
+
+//PLEX
+    /* mdat payload of the current fragment moved out of mdat_buf */
+    char   *spill_name;
+    int     spill_fd;
+    int64_t mdat_spilled;
+
+    /* sample payloads of the current fragment kept by reference */
+    struct MOVPayloadRef *payload_refs;
+    int      nb_payload_refs;
+    unsigned payload_refs_alloc;
+    int64_t  payload_ref_bytes;
+//PLEX
 } MOVTrack;
 
 typedef enum {
     MOV_ENC_NONE = 0,
     MOV_ENC_CENC_AES_CTR,
+    MOV_ENC_CBCS_AES_CBC, //PLEX
 } MOVEncryptionScheme;
 
 typedef enum {
@@ -247,6 +276,9 @@ typedef struct MOVMuxContext {
 
 //PLEX
     int video_width, video_height;
+    int64_t expected_duration;
+    int moov_estimated;
+    int frag_spill_size;
 //PLEX
 
     int movie_timescale;
@@ -20,10 +20,14 @@
  */
 #include "movenccenc.h"
 #include "libavutil/intreadwrite.h"
+#include "libavutil/random_seed.h"
 #include "avio_internal.h"
 #include "movenc.h"
 #include "avc.h"
 
+/* cbcs leaves the start of a slice in the clear, which covers the slice header */
+#define CBCS_CLEAR_LEADER 32
+
 static int auxiliary_info_alloc_size(MOVMuxCencContext* ctx, int size)
 {
     size_t new_alloc_size;
@@ -83,6 +87,65 @@ static int auxiliary_info_add_subsample(MOVMuxCencContext* ctx,
     return 0;
 }
 
+/**
+ * Add a subsample, preceded by the clear bytes accumulated so far
+ */
+static int auxiliary_info_add_clear(MOVMuxCencContext* ctx,
+    uint32_t clear_bytes, uint32_t encrypted_bytes)
+{
+    int ret;
+
+    clear_bytes += ctx->pending_clear;
+    ctx->pending_clear = 0;
+
+    while (clear_bytes > UINT16_MAX) {
+        ret = auxiliary_info_add_subsample(ctx, UINT16_MAX, 0);
+        if (ret) {
+            return ret;
+        }
+        clear_bytes -= UINT16_MAX;
+    }
+
+    return auxiliary_info_add_subsample(ctx, clear_bytes, encrypted_bytes);
+}
+
+static int mov_cenc_per_sample_iv_size(MOVMuxCencContext* ctx)
+{
+    return ctx->aes_cbc ? 0 : AES_CTR_IV_SIZE;
+}
+
+/**
+ * Encrypt one protected range with the cbcs pattern and write it, the cbc
+ * chain starts over from the constant iv and a trailing partial block stays
+ * in the clear
+ */
+static void mov_cbcs_write_encrypted(MOVMuxCencContext* ctx, AVIOContext *pb,
+                                     const uint8_t *buf_in, int size)
+{
+    uint8_t chunk[4096];
+    uint8_t iv[CBCS_IV_SIZE];
+    int stride = (ctx->crypt_byte_block + ctx->skip_byte_block) * 16;
+    int chunk_size = stride ? sizeof(chunk) / stride * stride : sizeof(chunk);
+    int cur_size, i;
+
+    memcpy(iv, ctx->cbcs_iv, sizeof(iv));
+
+    while (size > 0) {
+        cur_size = FFMIN(size, chunk_size);
+        memcpy(chunk, buf_in, cur_size);
+        if (!stride) {
+            av_aes_crypt(ctx->aes_cbc, chunk, chunk, cur_size >> 4, iv, 0);
+        } else {
+            for (i = 0; i + 16 <= cur_size; i += stride)
+                av_aes_crypt(ctx->aes_cbc, chunk + i, chunk + i,
+                             FFMIN(ctx->crypt_byte_block, (cur_size - i) >> 4), iv, 0);
+        }
+        avio_write(pb, chunk, cur_size);
+        buf_in += cur_size;
+        size -= cur_size;
+    }
+}
+
 /**
  * Encrypt the input buffer and write using avio_write
  */
@@ -94,6 +157,11 @@ static void mov_cenc_write_encrypted(MOVMuxCencContext* ctx, AVIOContext *pb,
     int size_left = size;
     int cur_size;
 
+    if (ctx->aes_cbc) {
+        mov_cbcs_write_encrypted(ctx, pb, buf_in, size);
+        return;
+    }
+
     while (size_left > 0) {
         cur_size = FFMIN(size_left, sizeof(chunk));
         av_aes_ctr_crypt(ctx->aes_ctr, chunk, cur_pos, cur_size);
@@ -110,10 +178,12 @@ static int mov_cenc_start_packet(MOVMuxCencContext* ctx)
 {
     int ret;
 
-    /* write the iv */
-    ret = auxiliary_info_write(ctx, av_aes_ctr_get_iv(ctx->aes_ctr), AES_CTR_IV_SIZE);
-    if (ret) {
-        return ret;
+    /* write the iv, cbcs uses the constant one from tenc */
+    if (ctx->aes_ctr) {
+        ret = auxiliary_info_write(ctx, av_aes_ctr_get_iv(ctx->aes_ctr), AES_CTR_IV_SIZE);
+        if (ret) {
+            return ret;
+        }
     }
 
     if (!ctx->use_subsamples) {
@@ -137,8 +207,18 @@ static int mov_cenc_start_packet(MOVMuxCencContext* ctx)
 static int mov_cenc_end_packet(MOVMuxCencContext* ctx)
 {
     size_t new_alloc_size;
+    int ret;
 
-    av_aes_ctr_increment_iv(ctx->aes_ctr);
+    if (ctx->aes_ctr) {
+        av_aes_ctr_increment_iv(ctx->aes_ctr);
+    }
+
+    if (ctx->pending_clear) {
+        ret = auxiliary_info_add_clear(ctx, 0, 0);
+        if (ret) {
+            return ret;
+        }
+    }
 
     if (!ctx->use_subsamples) {
         ctx->auxiliary_info_entries++;
@@ -155,7 +235,7 @@ static int mov_cenc_end_packet(MOVMuxCencContext* ctx)
         ctx->auxiliary_info_sizes_alloc_size = new_alloc_size;
     }
     ctx->auxiliary_info_sizes[ctx->auxiliary_info_entries] =
-        AES_CTR_IV_SIZE + ctx->auxiliary_info_size - ctx->auxiliary_info_subsample_start;
+        mov_cenc_per_sample_iv_size(ctx) + ctx->auxiliary_info_size - ctx->auxiliary_info_subsample_start;
     ctx->auxiliary_info_entries++;
 
     /* update the subsample count*/
@@ -189,6 +269,38 @@ int ff_mov_cenc_write_packet(MOVMuxCencContext* ctx, AVIOContext *pb,
     return 0;
 }
 
+static int mov_cbcs_is_vcl(MOVMuxCencContext* ctx, uint8_t nal_header)
+{
+    if (ctx->codec_id == AV_CODEC_ID_HEVC) {
+        return (nal_header >> 1 & 0x3f) < 32;
+    }
+    return (nal_header & 0x1f) >= 1 && (nal_header & 0x1f) <= 5;
+}
+
+/**
+ * Write a nal unit whose length prefix of prefix_size bytes has already been
+ * written in the clear, cbcs only encrypts slices past their leader
+ */
+static int mov_cenc_write_nal(MOVMuxCencContext* ctx, AVIOContext *pb,
+                              int prefix_size, const uint8_t *nal, int nalsize)
+{
+    int clear = 1;
+
+    if (ctx->aes_cbc) {
+        if (!mov_cbcs_is_vcl(ctx, *nal) || nalsize <= CBCS_CLEAR_LEADER + 16) {
+            avio_write(pb, nal, nalsize);
+            ctx->pending_clear += prefix_size + nalsize;
+            return 0;
+        }
+        clear = CBCS_CLEAR_LEADER;
+    }
+
+    avio_write(pb, nal, clear);
+    mov_cenc_write_encrypted(ctx, pb, nal + clear, nalsize - clear);
+
+    return auxiliary_info_add_clear(ctx, prefix_size + clear, nalsize - clear);
+}
+
 int ff_mov_cenc_avc_parse_nal_units(MOVMuxCencContext* ctx, AVIOContext *pb,
                                  const uint8_t *buf_in, int size)
 {
@@ -212,10 +324,10 @@ int ff_mov_cenc_avc_parse_nal_units(MOVMuxCencContext* ctx, AVIOContext *pb,
         nal_end = ff_avc_find_startcode(nal_start, end);
 
         avio_wb32(pb, nal_end - nal_start);
-        avio_w8(pb, *nal_start);
-        mov_cenc_write_encrypted(ctx, pb, nal_start + 1, nal_end - nal_start - 1);
-
-        auxiliary_info_add_subsample(ctx, 5, nal_end - nal_start - 1);
+        ret = mov_cenc_write_nal(ctx, pb, 4, nal_start, nal_end - nal_start);
+        if (ret) {
+            return ret;
+        }
 
         size += 4 + nal_end - nal_start;
         nal_start = nal_end;
@@ -249,7 +361,7 @@ int ff_mov_cenc_avc_write_nal_units(AVFormatContext *s, MOVMuxCencContext* ctx,
             return -1;
         }
 
-        avio_write(pb, buf_in, nal_length_size + 1);
+        avio_write(pb, buf_in, nal_length_size);
 
         nalsize = 0;
         for (j = 0; j < nal_length_size; j++) {
@@ -263,11 +375,12 @@ int ff_mov_cenc_avc_write_nal_units(AVFormatContext *s, MOVMuxCencContext* ctx,
             return -1;
         }
 
-        mov_cenc_write_encrypted(ctx, pb, buf_in + 1, nalsize - 1);
+        ret = mov_cenc_write_nal(ctx, pb, nal_length_size, buf_in, nalsize);
+        if (ret) {
+            return ret;
+        }
         buf_in += nalsize;
         size -= nalsize;
-
-        auxiliary_info_add_subsample(ctx, nal_length_size + 1, nalsize - 1);
     }
 
     ret = mov_cenc_end_packet(ctx);
@@ -328,7 +441,7 @@ static int mov_cenc_write_saiz_tag(MOVMuxCencContext* ctx, AVIOContext *pb)
     avio_wb32(pb, 0); /* size */
     ffio_wfourcc(pb, "saiz");
     avio_wb32(pb, 0); /* version & flags */
-    avio_w8(pb, ctx->use_subsamples ? 0 : AES_CTR_IV_SIZE);    /* default size*/
+    avio_w8(pb, ctx->use_subsamples ? 0 : mov_cenc_per_sample_iv_size(ctx)); /* default size*/
     avio_wb32(pb, ctx->auxiliary_info_entries); /* entry count */
     if (ctx->use_subsamples) {
         avio_write(pb, ctx->auxiliary_info_sizes, ctx->auxiliary_info_entries);
@@ -340,17 +453,53 @@ void ff_mov_cenc_write_stbl_atoms(MOVMuxCencContext* ctx, AVIOContext *pb)
 {
     int64_t auxiliary_info_offset;
 
+    /* cbcs without subsamples has no per sample info at all */
+    if (ctx->aes_cbc && !ctx->use_subsamples)
+        return;
+
     mov_cenc_write_senc_tag(ctx, pb, &auxiliary_info_offset);
     mov_cenc_write_saio_tag(pb, auxiliary_info_offset);
     mov_cenc_write_saiz_tag(ctx, pb);
 }
 
-static int mov_cenc_write_schi_tag(AVIOContext *pb, uint8_t* kid)
+void ff_mov_cenc_write_traf_atoms(MOVMuxCencContext* ctx, AVIOContext *pb, int64_t moof_offset)
+{
+    int64_t auxiliary_info_offset;
+
+    if (!ctx->auxiliary_info_entries || (ctx->aes_cbc && !ctx->use_subsamples))
+        return;
+
+    mov_cenc_write_senc_tag(ctx, pb, &auxiliary_info_offset);
+    mov_cenc_write_saio_tag(pb, auxiliary_info_offset - moof_offset);
+    mov_cenc_write_saiz_tag(ctx, pb);
+}
+
+void ff_mov_cenc_flush(MOVMuxCencContext* ctx)
+{
+    ctx->auxiliary_info_size = 0;
+    ctx->auxiliary_info_entries = 0;
+}
+
+static int mov_cenc_write_schi_tag(MOVMuxCencContext* ctx, AVIOContext *pb, uint8_t* kid)
 {
     int64_t pos = avio_tell(pb);
     avio_wb32(pb, 0);     /* size */
     ffio_wfourcc(pb, "schi");
 
+    if (ctx->aes_cbc) {
+        avio_wb32(pb, 49);    /* size */
+        ffio_wfourcc(pb, "tenc");
+        avio_wb32(pb, 0x01000000); /* version & flags */
+        avio_w8(pb, 0);       /* reserved */
+        avio_w8(pb, ctx->crypt_byte_block << 4 | ctx->skip_byte_block);
+        avio_w8(pb, 1);       /* is encrypted */
+        avio_w8(pb, 0);       /* per sample iv size */
+        avio_write(pb, kid, CENC_KID_SIZE);
+        avio_w8(pb, CBCS_IV_SIZE);
+        avio_write(pb, ctx->cbcs_iv, CBCS_IV_SIZE);
+        return update_size(pb, pos);
+    }
+
     avio_wb32(pb, 32);    /* size */
     ffio_wfourcc(pb, "tenc");
     avio_wb32(pb, 0);     /* version & flags */
@@ -376,11 +525,11 @@ int ff_mov_cenc_write_sinf_tag(MOVTrack* track, AVIOContext *pb, uint8_t* kid)
     avio_wb32(pb, 20);    /* size */
     ffio_wfourcc(pb, "schm");
     avio_wb32(pb, 0); /* version & flags */
-    ffio_wfourcc(pb, "cenc");    /* scheme type*/
+    ffio_wfourcc(pb, track->cenc.aes_cbc ? "cbcs" : "cenc"); /* scheme type*/
     avio_wb32(pb, 0x10000); /* scheme version */
 
     /* schi */
-    mov_cenc_write_schi_tag(pb, kid);
+    mov_cenc_write_schi_tag(&track->cenc, pb, kid);
 
     return update_size(pb, pos);
 }
@@ -409,9 +558,42 @@ int ff_mov_cenc_init(MOVMuxCencContext* ctx, uint8_t* encryption_key,
     return 0;
 }
 
+int ff_mov_cbcs_init(MOVMuxCencContext* ctx, uint8_t* encryption_key,
+                     const AVCodecParameters *par, int bitexact)
+{
+    int ret;
+
+    ctx->aes_cbc = av_aes_alloc();
+    if (!ctx->aes_cbc) {
+        return AVERROR(ENOMEM);
+    }
+
+    ret = av_aes_init(ctx->aes_cbc, encryption_key, 128, 0);
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (!bitexact) {
+        ret = av_random_bytes(ctx->cbcs_iv, sizeof(ctx->cbcs_iv));
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    ctx->codec_id = par->codec_id;
+    ctx->use_subsamples = par->codec_id == AV_CODEC_ID_H264 || par->codec_id == AV_CODEC_ID_HEVC;
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        ctx->crypt_byte_block = 1;
+        ctx->skip_byte_block  = 9;
+    }
+
+    return 0;
+}
+
 void ff_mov_cenc_free(MOVMuxCencContext* ctx)
 {
     av_aes_ctr_free(ctx->aes_ctr);
+    av_freep(&ctx->aes_cbc);
     av_freep(&ctx->auxiliary_info);
     av_freep(&ctx->auxiliary_info_sizes);
 }
@@ -22,11 +22,13 @@
 #ifndef AVFORMAT_MOVENCCENC_H
 #define AVFORMAT_MOVENCCENC_H
 
+#include "libavutil/aes.h"
 #include "libavutil/aes_ctr.h"
 #include "avformat.h"
 #include "avio.h"
 
 #define CENC_KID_SIZE (16)
+#define CBCS_IV_SIZE  (16)
 
 struct MOVTrack;
 
@@ -43,6 +45,14 @@ typedef struct {
     size_t auxiliary_info_subsample_start;
     uint8_t* auxiliary_info_sizes;
     size_t  auxiliary_info_sizes_alloc_size;
+
+    /* cbcs: AES-CBC with a constant iv and a crypt:skip block pattern */
+    struct AVAES* aes_cbc;
+    uint8_t cbcs_iv[CBCS_IV_SIZE];
+    int crypt_byte_block;
+    int skip_byte_block;
+    enum AVCodecID codec_id;
+    uint32_t pending_clear;     ///< clear bytes not yet attached to a subsample
 } MOVMuxCencContext;
 
 /**
@@ -52,6 +62,14 @@ typedef struct {
  */
 int ff_mov_cenc_init(MOVMuxCencContext* ctx, uint8_t* encryption_key, int use_subsamples, int bitexact);
 
+/**
+ * Initialize a context for the cbcs scheme, video is encrypted with a 1:9
+ * pattern, anything else in whole 16 byte blocks
+ * @param key encryption key, must have a length of AES_CTR_KEY_SIZE
+ */
+int ff_mov_cbcs_init(MOVMuxCencContext* ctx, uint8_t* encryption_key,
+                     const AVCodecParameters *par, int bitexact);
+
 /**
  * Free a CENC context
  */
@@ -78,6 +96,16 @@ int ff_mov_cenc_avc_write_nal_units(AVFormatContext *s, MOVMuxCencContext* ctx,
  */
 void ff_mov_cenc_write_stbl_atoms(MOVMuxCencContext* ctx, AVIOContext *pb);
 
+/**
+ * Write the cenc atoms of one fragment inside traf, offsets are relative to moof_offset
+ */
+void ff_mov_cenc_write_traf_atoms(MOVMuxCencContext* ctx, AVIOContext *pb, int64_t moof_offset);
+
+/**
+ * Drop the auxiliary info of the samples that have been written out
+ */
+void ff_mov_cenc_flush(MOVMuxCencContext* ctx);
+
 /**
  * Write the sinf atom, contained inside stsd
  */
@@ -53,6 +53,7 @@ typedef struct {
     unsigned frames; /* Total number of frames in file */
     unsigned header_filesize;   /* Total number of bytes in the stream */
     int is_cbr;
+    int duration_points; //PLEX
 } MP3DecContext;
 
 enum CheckRet {
@@ -360,6 +361,70 @@ static int mp3_parse_vbr_tags(AVFormatContext *s, AVStream *st, int64_t base)
     return 0;
 }
 
+#define SEEK_WINDOW 4096
+
+//PLEX
+#define DURATION_SAMPLE_FRAMES 32
+
+/**
+ * Estimate the duration of a file without Xing/Info/VBRI tag from the mean
+ * frame size at a few evenly spread offsets. The generic estimate uses the
+ * bitrate of the first frames, which is badly off for VBR files; CBR files
+ * are left to it.
+ */
+static void mp3_estimate_duration(AVFormatContext *s, AVStream *st, int64_t data_start)
+{
+    MP3DecContext *mp3 = s->priv_data;
+    int64_t span = mp3->filesize - data_start, bytes = 0;
+    int frames = 0, spf = 0, sample_rate = 0, bit_rate = -1, is_vbr = 0;
+
+    for (int p = 0; p < mp3->duration_points; p++) {
+        int64_t pos = data_start + span * p / mp3->duration_points;
+        uint32_t header, header2, ref;
+        int i, size;
+
+        /* resync on two consecutive frames */
+        for (i = 0; i < SEEK_WINDOW; i++) {
+            size = check(s->pb, pos + i, &header);
+            if (size == CHECK_SEEK_FAILED)
+                break;
+            if (size > 0 && check(s->pb, pos + i + size, &header2) >= 0 &&
+                (header & MP3_MASK) == (header2 & MP3_MASK))
+                break;
+        }
+        if (i >= SEEK_WINDOW || size <= 0)
+            continue;
+        pos += i;
+        ref  = header & MP3_MASK;
+
+        for (int f = 0; f < DURATION_SAMPLE_FRAMES; f++) {
+            MPADecodeHeader c;
+
+            size = check(s->pb, pos, &header);
+            if (size <= 0 || (header & MP3_MASK) != ref ||
+                avpriv_mpegaudio_decode_header(&c, header) < 0)
+                break;
+            if (bit_rate >= 0 && c.bit_rate != bit_rate)
+                is_vbr = 1;
+            bit_rate    = c.bit_rate;
+            sample_rate = c.sample_rate;
+            spf         = c.layer == 1 ? 384 : c.layer == 3 && c.lsf ? 576 : 1152;
+            bytes      += size;
+            frames++;
+            pos        += size;
+        }
+    }
+
+    if (!is_vbr || !bytes || !sample_rate)
+        return;
+
+    st->duration = av_rescale_q(av_rescale(span, frames, bytes),
+                                (AVRational){ spf, sample_rate }, st->time_base);
+    st->codecpar->bit_rate = av_rescale(bytes, 8LL * sample_rate, frames * (int64_t)spf);
+    av_log(s, AV_LOG_DEBUG, "VBR duration estimated from %d sampled frames\n", frames);
+}
+//PLEX
+
 static int mp3_read_header(AVFormatContext *s)
 {
     FFFormatContext *const si = ffformatcontext(s);
@@ -429,6 +494,15 @@ static int mp3_read_header(AVFormatContext *s)
     if (off < 0)
         return off;
 
+    //PLEX
+    if (st->duration == AV_NOPTS_VALUE && mp3->duration_points > 0 &&
+        mp3->filesize > off) {
+        mp3_estimate_duration(s, st, off);
+        if ((ret = avio_seek(s->pb, off, SEEK_SET)) < 0)
+            return ret;
+    }
+    //PLEX
+
     // the seek index is relative to the end of the xing vbr headers
     for (int i = 0; i < sti->nb_index_entries; i++)
         sti->index_entries[i].pos += off;
@@ -463,8 +537,6 @@ static int mp3_read_packet(AVFormatContext *s, AVPacket *pkt)
     return ret;
 }
 
-#define SEEK_WINDOW 4096
-
 static int check(AVIOContext *pb, int64_t pos, uint32_t *ret_header)
 {
     int64_t ret = avio_seek(pb, pos, SEEK_SET);
@@ -596,6 +668,10 @@ static int mp3_seek(AVFormatContext *s, int stream_index, int64_t timestamp,
 
 static const AVOption options[] = {
     { "usetoc", "use table of contents", offsetof(MP3DecContext, usetoc), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM},
+    //PLEX
+    { "duration_points", "number of offsets sampled to estimate the duration of VBR files without header, 0 to disable",
+      offsetof(MP3DecContext, duration_points), AV_OPT_TYPE_INT, {.i64 = 8}, 0, 64, AV_OPT_FLAG_DECODING_PARAM},
+    //PLEX
     { NULL },
 };
 
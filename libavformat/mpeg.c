@@ -701,6 +701,7 @@ const AVInputFormat ff_mpegps_demuxer = {
     .read_packet    = mpegps_read_packet,
     .read_timestamp = mpegps_read_dts,
     .flags          = AVFMT_SHOW_IDS | AVFMT_TS_DISCONT,
+    .flags_internal = FF_FMT_PACKED_INDEX, //PLEX
 };
 
 #if CONFIG_VOBSUB_DEMUXER
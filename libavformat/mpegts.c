@@ -128,6 +128,21 @@ struct Program {
     int pmt_found;
 };
 
+//PLEX
+/** keyframe position of one PID, from a PES starting on a random access point */
+typedef struct MpegTSKeyframe {
+    int64_t pos;
+    int64_t dts;
+} MpegTSKeyframe;
+
+typedef struct MpegTSKeyIndex {
+    int pid;
+    MpegTSKeyframe *entries;   ///< sorted by pos, and by dts as well
+    int nb_entries;
+    unsigned int allocated;
+} MpegTSKeyIndex;
+//PLEX
+
 struct MpegTSContext {
     const AVClass *class;
     /* user data */
@@ -181,6 +196,16 @@ struct MpegTSContext {
 
     AVStream *epg_stream;
     AVBufferPool* pools[32];
+
+    //PLEX
+    int keyframe_index;
+    char *index_file;
+    /** random_access_indicator of the TS packet being handled */
+    int cur_rai;
+    MpegTSKeyIndex *key_index;
+    int nb_key_index;
+    int key_index_dirty;
+    //PLEX
 };
 
 #define MPEGTS_OPTIONS \
@@ -204,6 +229,12 @@ static const AVOption options[] = {
      {.i64 = 0}, 0, 1, 0 },
     {"max_packet_size", "maximum size of emitted packet", offsetof(MpegTSContext, max_packet_size), AV_OPT_TYPE_INT,
      {.i64 = 204800}, 1, INT_MAX/2, AV_OPT_FLAG_DECODING_PARAM },
+    //PLEX
+    {"keyframe_index", "index the video random access points while reading and seek with them", offsetof(MpegTSContext, keyframe_index), AV_OPT_TYPE_BOOL,
+     {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    {"index_file", "load the keyframe index from this file and save it back on close", offsetof(MpegTSContext, index_file), AV_OPT_TYPE_STRING,
+     {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
+    //PLEX
     { NULL },
 };
 
@@ -266,6 +297,7 @@ typedef struct PESContext {
     uint8_t stream_id;
     int64_t pts, dts;
     int64_t ts_packet_pos; /**< position of first TS packet of this PES packet */
+    int is_rai; /**< the first TS packet had random_access_indicator set */ //PLEX
     uint8_t header[MAX_PES_HEADER_SIZE];
     AVBufferRef *buffer;
     SLConfigDescr sl;
@@ -1002,6 +1034,147 @@ static void reset_pes_packet_state(PESContext *pes)
     av_buffer_unref(&pes->buffer);
 }
 
+//PLEX
+static MpegTSKeyIndex *get_key_index(MpegTSContext *ts, int pid, int create)
+{
+    MpegTSKeyIndex *idx;
+
+    for (int i = 0; i < ts->nb_key_index; i++)
+        if (ts->key_index[i].pid == pid)
+            return &ts->key_index[i];
+    if (!create)
+        return NULL;
+
+    idx = av_realloc_array(ts->key_index, ts->nb_key_index + 1, sizeof(*ts->key_index));
+    if (!idx)
+        return NULL;
+    ts->key_index = idx;
+    idx = &ts->key_index[ts->nb_key_index++];
+    memset(idx, 0, sizeof(*idx));
+    idx->pid = pid;
+    return idx;
+}
+
+/* index of the first entry whose pos is >= pos */
+static int key_index_search_pos(const MpegTSKeyIndex *idx, int64_t pos)
+{
+    int lo = 0, hi = idx->nb_entries;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (idx->entries[mid].pos < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void key_index_add(MpegTSContext *ts, int pid, int64_t pos, int64_t dts)
+{
+    MpegTSKeyIndex *idx = get_key_index(ts, pid, 1);
+    MpegTSKeyframe *e;
+    int i;
+
+    if (!idx)
+        return;
+
+    i = key_index_search_pos(idx, pos);
+    if (i < idx->nb_entries && idx->entries[i].pos == pos)
+        return;
+    /* keep dts ordered too; a discontinuity ends what the index can bisect */
+    if ((i > 0 && idx->entries[i - 1].dts >= dts) ||
+        (i < idx->nb_entries && idx->entries[i].dts <= dts))
+        return;
+
+    e = av_fast_realloc(idx->entries, &idx->allocated,
+                        (idx->nb_entries + 1) * sizeof(*idx->entries));
+    if (!e)
+        return;
+    idx->entries = e;
+    memmove(&e[i + 1], &e[i], (idx->nb_entries - i) * sizeof(*e));
+    e[i].pos = pos;
+    e[i].dts = dts;
+    idx->nb_entries++;
+    ts->key_index_dirty = 1;
+}
+
+/* apply the wrap correction the generic code does on returned packets */
+static int64_t key_index_unwrap(const AVStream *st, int64_t dts)
+{
+    const FFStream *sti = cffstream(st);
+
+    if (sti->pts_wrap_reference == AV_NOPTS_VALUE || st->pts_wrap_bits >= 64)
+        return AV_NOPTS_VALUE;
+    if (sti->pts_wrap_behavior == AV_PTS_WRAP_ADD_OFFSET && dts < sti->pts_wrap_reference)
+        return dts + (1ULL << st->pts_wrap_bits);
+    if (sti->pts_wrap_behavior == AV_PTS_WRAP_SUB_OFFSET && dts >= sti->pts_wrap_reference)
+        return dts - (1ULL << st->pts_wrap_bits);
+    return dts;
+}
+
+#define KEY_INDEX_MAGIC "# mpegts keyframe index 1"
+
+/**
+ * Load a keyframe index saved by key_index_save(). Lines are
+ * "pid pos dts"; entries past the end of the file are dropped.
+ */
+static void key_index_load(AVFormatContext *s)
+{
+    MpegTSContext *ts = s->priv_data;
+    int64_t filesize = avio_size(s->pb);
+    AVIOContext *pb = NULL;
+    char line[128];
+    int nb = 0;
+
+    if (s->io_open(s, &pb, ts->index_file, AVIO_FLAG_READ, NULL) < 0)
+        return;
+
+    ff_get_line(pb, line, sizeof(line));
+    if (strncmp(line, KEY_INDEX_MAGIC, strlen(KEY_INDEX_MAGIC))) {
+        av_log(s, AV_LOG_WARNING, "%s is not a keyframe index, ignoring it\n", ts->index_file);
+        goto end;
+    }
+    while (!avio_feof(pb)) {
+        int pid;
+        int64_t pos, dts;
+
+        if (!ff_get_line(pb, line, sizeof(line)))
+            break;
+        if (sscanf(line, "%d %"SCNd64" %"SCNd64, &pid, &pos, &dts) != 3 ||
+            pid < 0 || pid >= NB_PID_MAX || pos < 0 || (filesize > 0 && pos >= filesize))
+            continue;
+        key_index_add(ts, pid, pos, dts);
+        nb++;
+    }
+    av_log(s, AV_LOG_VERBOSE, "Loaded %d keyframes from %s\n", nb, ts->index_file);
+    ts->key_index_dirty = 0;
+
+end:
+    ff_format_io_close(s, &pb);
+}
+
+static void key_index_save(AVFormatContext *s)
+{
+    MpegTSContext *ts = s->priv_data;
+    AVIOContext *pb = NULL;
+
+    if (!ts->key_index_dirty ||
+        s->io_open(s, &pb, ts->index_file, AVIO_FLAG_WRITE, NULL) < 0)
+        return;
+
+    avio_printf(pb, "%s\n", KEY_INDEX_MAGIC);
+    for (int i = 0; i < ts->nb_key_index; i++) {
+        const MpegTSKeyIndex *idx = &ts->key_index[i];
+        for (int j = 0; j < idx->nb_entries; j++)
+            avio_printf(pb, "%d %"PRId64" %"PRId64"\n",
+                        idx->pid, idx->entries[j].pos, idx->entries[j].dts);
+    }
+    ff_format_io_close(s, &pb);
+    ts->key_index_dirty = 0;
+}
+//PLEX
+
 static void new_data_packet(const uint8_t *buffer, int len, AVPacket *pkt)
 {
     av_packet_unref(pkt);
@@ -1038,6 +1211,15 @@ static int new_pes_packet(PESContext *pes, AVPacket *pkt)
     pkt->pos   = pes->ts_packet_pos;
     pkt->flags = pes->flags;
 
+    //PLEX
+    if (pes->ts->keyframe_index && pes->is_rai && pkt->dts != AV_NOPTS_VALUE &&
+        pkt->pos >= 0 && pes->st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        int64_t dts = key_index_unwrap(pes->st, pkt->dts);
+        if (dts != AV_NOPTS_VALUE)
+            key_index_add(pes->ts, pes->pid, pkt->pos, dts);
+    }
+    //PLEX
+
     pes->buffer = NULL;
     reset_pes_packet_state(pes);
 
@@ -1163,6 +1345,7 @@ static int mpegts_push_data(MpegTSFilter *filter,
         }
         pes->state         = MPEGTS_HEADER;
         pes->ts_packet_pos = pos;
+        pes->is_rai        = ts->cur_rai; //PLEX
     }
     p = buf;
     while (buf_size > 0) {
@@ -2796,6 +2979,8 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
     is_discontinuity = has_adaptation &&
                        packet[4] != 0 && /* with length > 0 */
                        (packet[5] & 0x80); /* and discontinuity indicated */
+    ts->cur_rai      = has_adaptation && packet[4] != 0 &&
+                       (packet[5] & 0x40); //PLEX
 
     /* continuity check (currently not used) */
     cc = (packet[3] & 0xf);
@@ -2896,13 +3081,33 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
     return 0;
 }
 
+//PLEX
+/* number of consecutive sync bytes required before a resync is accepted */
+#define RESYNC_CHECK_PACKETS 4
+#define RESYNC_BUF_SIZE 4096
+
+/* Check that the sync byte at buf repeats over RESYNC_CHECK_PACKETS packets.
+ * Packets past the end of the data only count at the end of the file. */
+static int resync_check(const uint8_t *buf, int size, int packet_size)
+{
+    for (int k = 1; k < RESYNC_CHECK_PACKETS; k++)
+        if (k * packet_size < size && buf[k * packet_size] != 0x47)
+            return 0;
+    return 1;
+}
+//PLEX
+
 static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *current_packet)
 {
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb = s->pb;
-    int c, i;
     uint64_t pos = avio_tell(pb);
     int64_t back = FFMIN(seekback, pos);
+    //PLEX
+    static const int packet_sizes[] = { TS_PACKET_SIZE, TS_DVHS_PACKET_SIZE, TS_FEC_PACKET_SIZE };
+    uint8_t buf[RESYNC_BUF_SIZE];
+    int64_t scanned = 0;
+    //PLEX
 
     //Special case for files like 01c56b0dc1.ts
     if (current_packet[0] == 0x80 && current_packet[12] == 0x47 && pos >= TS_PACKET_SIZE) {
@@ -2912,26 +3117,56 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 
     avio_seek(pb, -back, SEEK_CUR);
 
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
+    //PLEX
+    /* Scan a buffer at a time, and only stop at a sync byte that is followed
+     * by more of them at a packet size, so that 0x47 bytes in the payload
+     * do not cause another loss of sync a packet later. */
+    while (scanned < ts->resync_size) {
+        int64_t base = avio_tell(pb);
+        const uint8_t *p;
+        int len, limit, ret;
+
+        ret = ffio_ensure_seekback(pb, sizeof(buf) + PROBE_PACKET_MAX_BUF);
+        if (ret < 0)
+            return ret;
+        len = avio_read(pb, buf, sizeof(buf));
+        if (len <= 0)
             return AVERROR_EOF;
-        if (c == 0x47) {
-            int new_packet_size, ret;
-            avio_seek(pb, -1, SEEK_CUR);
-            pos = avio_tell(pb);
-            ret = ffio_ensure_seekback(pb, PROBE_PACKET_MAX_BUF);
-            if (ret < 0)
-                return ret;
-            new_packet_size = get_packet_size(s);
-            if (new_packet_size > 0 && new_packet_size != ts->raw_packet_size) {
-                av_log(ts->stream, AV_LOG_WARNING, "changing packet size to %d\n", new_packet_size);
-                ts->raw_packet_size = new_packet_size;
+
+        limit = len;
+        if (len == sizeof(buf))
+            limit -= (RESYNC_CHECK_PACKETS - 1) * TS_FEC_PACKET_SIZE;
+        limit = FFMIN(limit, ts->resync_size - scanned);
+
+        for (p = buf; (p = memchr(p, 0x47, buf + limit - p)); p++) {
+            int new_packet_size = 0;
+
+            if (resync_check(p, buf + len - p, ts->raw_packet_size)) {
+                avio_seek(pb, base + (p - buf), SEEK_SET);
+                return 0;
+            }
+            /* a packet size change needs the full probe to be trusted */
+            for (int i = 0; i < FF_ARRAY_ELEMS(packet_sizes) && !new_packet_size; i++)
+                if (packet_sizes[i] != ts->raw_packet_size &&
+                    resync_check(p, buf + len - p, packet_sizes[i]))
+                    new_packet_size = packet_sizes[i];
+            if (new_packet_size) {
+                avio_seek(pb, base + (p - buf), SEEK_SET);
+                if (get_packet_size(s) == new_packet_size) {
+                    av_log(ts->stream, AV_LOG_WARNING, "changing packet size to %d\n", new_packet_size);
+                    ts->raw_packet_size = new_packet_size;
+                    avio_seek(pb, base + (p - buf), SEEK_SET);
+                    return 0;
+                }
             }
-            avio_seek(pb, pos, SEEK_SET);
-            return 0;
         }
+        if (len < sizeof(buf))
+            return AVERROR_EOF;
+
+        scanned += limit;
+        avio_seek(pb, base + limit, SEEK_SET);
     }
+    //PLEX
     av_log(s, AV_LOG_ERROR,
            "max resync size reached, could not find sync byte\n");
     /* no sync found */
@@ -2972,12 +3207,41 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+//PLEX
+/* Handle up to max packets straight from the I/O buffer, without a read call
+ * per packet. Stops at the first packet that is not in sync, which is then
+ * left to read_packet() to resync. Returns the number of packets handled. */
+static int64_t handle_buffered_packets(MpegTSContext *ts, int64_t max, int *ret)
+{
+    AVIOContext *pb = ts->stream->pb;
+    const int stride = ts->raw_packet_size;
+    const uint8_t *p = pb->buf_ptr;
+    int64_t pos = avio_tell(pb) + TS_PACKET_SIZE;
+    int64_t n = FFMIN(max, (pb->buf_end - p) / stride);
+    int64_t i;
+
+    *ret = 0;
+    if (pb->write_flag)
+        return 0;
+    for (i = 0; i < n && p[0] == 0x47; i++, p += stride, pos += stride) {
+        *ret = handle_packet(ts, p, pos);
+        if (*ret != 0 || ts->stop_parse) {
+            i++;
+            p += stride;
+            break;
+        }
+    }
+    pb->buf_ptr = (uint8_t *)p;
+    return i;
+}
+//PLEX
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
     uint8_t packet[TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
-    int64_t packet_num;
+    int64_t packet_num, n;
     int ret = 0;
 
     if (avio_tell(s->pb) != ts->last_pos) {
@@ -3013,6 +3277,16 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        //PLEX
+        n = handle_buffered_packets(ts, nb_packets ? nb_packets - packet_num : INT64_MAX, &ret);
+        if (n > 0) {
+            packet_num += n - 1;
+            if (ret != 0)
+                break;
+            continue;
+        }
+        //PLEX
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -3203,6 +3477,13 @@ static int mpegts_read_header(AVFormatContext *s)
                 st->start_time / 1000000.0, pcrs[0] / 27e6, ts->pcr_incr);
     }
 
+    //PLEX
+    if (ts->index_file) {
+        ts->keyframe_index = 1;
+        key_index_load(s);
+    }
+    //PLEX
+
     seek_back(s, pb, pos);
     return 0;
 }
@@ -3298,11 +3579,65 @@ static void mpegts_free(MpegTSContext *ts)
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
             mpegts_close_filter(ts, ts->pids[i]);
+
+    //PLEX
+    for (i = 0; i < ts->nb_key_index; i++)
+        av_freep(&ts->key_index[i].entries);
+    av_freep(&ts->key_index);
+    ts->nb_key_index = 0;
+    //PLEX
+}
+
+//PLEX
+/**
+ * Seek straight to an indexed keyframe when the target lies within the
+ * indexed span of the stream; otherwise let the generic bisection run.
+ */
+static int mpegts_read_seek(AVFormatContext *s, int stream_index,
+                            int64_t target_ts, int flags)
+{
+    MpegTSContext *ts = s->priv_data;
+    const MpegTSKeyIndex *idx;
+    const MpegTSKeyframe *e;
+    int lo, hi;
+
+    if (!ts->keyframe_index || flags & (AVSEEK_FLAG_BYTE | AVSEEK_FLAG_ANY))
+        return -1;
+
+    idx = get_key_index(ts, s->streams[stream_index]->id, 0);
+    if (!idx || idx->nb_entries < 2 ||
+        target_ts < idx->entries[0].dts ||
+        target_ts > idx->entries[idx->nb_entries - 1].dts)
+        return -1;
+
+    /* last entry with dts <= target_ts */
+    lo = 0;
+    hi = idx->nb_entries - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) >> 1;
+        if (idx->entries[mid].dts <= target_ts)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    if (!(flags & AVSEEK_FLAG_BACKWARD) && idx->entries[lo].dts < target_ts)
+        lo++;
+    e = &idx->entries[lo];
+
+    if (avio_seek(s->pb, e->pos, SEEK_SET) < 0)
+        return -1;
+    avpriv_update_cur_dts(s, s->streams[stream_index], e->dts);
+    return 0;
 }
+//PLEX
 
 static int mpegts_read_close(AVFormatContext *s)
 {
     MpegTSContext *ts = s->priv_data;
+    //PLEX
+    if (ts->index_file)
+        key_index_save(s);
+    //PLEX
     mpegts_free(ts);
     return 0;
 }
@@ -3443,8 +3778,10 @@ const AVInputFormat ff_mpegts_demuxer = {
     .read_header    = mpegts_read_header,
     .read_packet    = mpegts_read_packet,
     .read_close     = mpegts_read_close,
+    .read_seek      = mpegts_read_seek, //PLEX
     .read_timestamp = mpegts_get_dts,
     .flags          = AVFMT_SHOW_IDS | AVFMT_TS_DISCONT,
+    .flags_internal = FF_FMT_PACKED_INDEX, //PLEX
     .priv_class     = &mpegts_class,
 };
 
@@ -3457,5 +3794,6 @@ const AVInputFormat ff_mpegtsraw_demuxer = {
     .read_close     = mpegts_read_close,
     .read_timestamp = mpegts_get_dts,
     .flags          = AVFMT_SHOW_IDS | AVFMT_TS_DISCONT,
+    .flags_internal = FF_FMT_PACKED_INDEX, //PLEX
     .priv_class     = &mpegtsraw_class,
 };
\ No newline at end of file
@@ -128,6 +128,12 @@ typedef struct MpegTSWrite {
     uint8_t provider_name[256];
 
     int omit_video_pes_length;
+
+    //PLEX
+    /* continuation packets of a PES, built and written together */
+#define TS_BATCH_PACKETS 32
+    uint8_t batch_buf[TS_BATCH_PACKETS * (TS_PACKET_SIZE + 4)];
+    //PLEX
 } MpegTSWrite;
 
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
@@ -1473,6 +1479,44 @@ static int get_pes_stream_id(AVFormatContext *s, AVStream *st, int stream_id, in
  * number of TS packets. The final TS packet is padded using an oversized
  * adaptation header to exactly fill the last TS packet.
  * NOTE: 'payload' contains a complete PES payload. */
+//PLEX
+/* Packetize full continuation packets of a PES, which need neither an
+ * adaptation field nor stuffing, from a header template in a single write.
+ * Returns the number of payload bytes consumed. */
+static int mpegts_write_pes_batch(AVFormatContext *s, AVStream *st,
+                                  const uint8_t *payload, int payload_size)
+{
+    MpegTSWriteStream *ts_st = st->priv_data;
+    MpegTSWrite *ts = s->priv_data;
+    const int len = TS_PACKET_SIZE - 4;
+    int nb = FFMIN(payload_size / len, TS_BATCH_PACKETS);
+    uint8_t *q = ts->batch_buf;
+    int val = ts_st->pid >> 8;
+
+    if (ts->m2ts_mode && st->codecpar->codec_id == AV_CODEC_ID_AC3)
+        val |= 0x20;
+
+    for (int i = 0; i < nb; i++) {
+        if (ts->m2ts_mode) {
+            AV_WB32(q, get_pcr(ts) % 0x3fffffff);
+            q += 4;
+        }
+        ts_st->cc = ts_st->cc + 1 & 0xf;
+        q[0] = 0x47;
+        q[1] = val;
+        q[2] = ts_st->pid;
+        q[3] = 0x10 | ts_st->cc;
+        memcpy(q + 4, payload, len);
+        payload += len;
+        q       += TS_PACKET_SIZE;
+        ts->total_size += TS_PACKET_SIZE;
+    }
+    avio_write(s->pb, ts->batch_buf, q - ts->batch_buf);
+
+    return nb * len;
+}
+//PLEX
+
 static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
                              const uint8_t *payload, int payload_size,
                              int64_t pts, int64_t dts, int key, int stream_id)
@@ -1489,6 +1533,13 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     int force_pat = st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && key && !ts_st->prev_payload_key;
     int force_sdt = 0;
     int force_nit = 0;
+    //PLEX
+    /* Without a mux rate, only the first packet of a PES can carry a PCR,
+     * and the SI tables it may have sent are not due again for the same
+     * PCR value, so the rest can be batched. */
+    int can_batch = ts->mux_rate <= 1 && !is_dvb_subtitle &&
+                    ts->pat_period > 0 && ts->sdt_period > 0 && ts->nit_period > 0;
+    //PLEX
 
     av_assert0(ts_st->payload != buf || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
     if (ts->flags & MPEGTS_FLAG_PAT_PMT_AT_FRAMES && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
@@ -1505,6 +1556,14 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     is_start = 1;
     while (payload_size > 0) {
         int64_t pcr = AV_NOPTS_VALUE;
+        //PLEX
+        if (can_batch && !is_start && payload_size >= TS_PACKET_SIZE - 4) {
+            len = mpegts_write_pes_batch(s, st, payload, payload_size);
+            payload      += len;
+            payload_size -= len;
+            continue;
+        }
+        //PLEX
         if (ts->mux_rate > 1)
             pcr = get_pcr(ts);
         else if (dts != AV_NOPTS_VALUE)
@@ -34,6 +34,8 @@
 #include "libavutil/frame.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/mem_internal.h" //PLEX
+#include "libavutil/tracepoint.h" //PLEX
 
 /**
  * @file
@@ -339,6 +341,20 @@ FF_ENABLE_DEPRECATION_WARNINGS
                                     ff_interleave_packet_per_dts :
                                     ff_interleave_packet_passthrough;
 
+    //PLEX
+    /* Chunked interleaving reorders whole chunks, which only the shared
+     * packet_buffer list can express. */
+    si->interleave_per_stream = si->interleave_packet == ff_interleave_packet_per_dts &&
+                                !s->max_chunk_size && !s->max_chunk_duration;
+    if (si->interleave_per_stream) {
+        si->interleave_heap = av_calloc(s->nb_streams, sizeof(*si->interleave_heap));
+        if (!si->interleave_heap) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+    //PLEX
+
     if (!s->priv_data && of->priv_data_size > 0) {
         s->priv_data = av_mallocz(of->priv_data_size);
         if (!s->priv_data) {
@@ -486,9 +502,11 @@ int avformat_write_header(AVFormatContext *s, AVDictionary **options)
             return ret;
 
     if (ffofmt(s->oformat)->write_header) {
+        int tag = avpriv_mem_tag_push(AV_MEM_TAG_FORMAT); //PLEX
         if (!(s->oformat->flags & AVFMT_NOFILE) && s->pb)
             avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_HEADER);
         ret = ffofmt(s->oformat)->write_header(s);
+        avpriv_mem_tag_pop(tag); //PLEX
         if (ret >= 0 && s->pb && s->pb->error < 0)
             ret = s->pb->error;
         if (ret < 0)
@@ -680,6 +698,26 @@ static void handle_avoid_negative_ts(FFFormatContext *si, FFStream *sti,
                 tb = cmp_tb;
             }
         }
+        //PLEX
+        for (unsigned i = 0; i < s->nb_streams; i++) {
+            const FFStream *const cmp_sti = cffstream(s->streams[i]);
+            AVRational cmp_tb = cmp_sti->pub.time_base;
+
+            for (const PacketListEntry *pktl = cmp_sti->interleave_queue.head;
+                 pktl; pktl = pktl->next) {
+                int64_t cmp_ts = use_pts ? pktl->pkt.pts : pktl->pkt.dts;
+                if (cmp_ts == AV_NOPTS_VALUE)
+                    continue;
+                cmp_ts -= cmp_sti->lowest_ts_allowed;
+                if (s->output_ts_offset)
+                    cmp_ts += av_rescale_q(s->output_ts_offset, AV_TIME_BASE_Q, cmp_tb);
+                if (av_compare_ts(cmp_ts, cmp_tb, ts, tb) < 0) {
+                    ts = cmp_ts;
+                    tb = cmp_tb;
+                }
+            }
+        }
+        //PLEX
 
         if (ts < 0 ||
             ts > 0 && s->avoid_negative_ts == AVFMT_AVOID_NEG_TS_MAKE_ZERO) {
@@ -736,7 +774,7 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
     FFFormatContext *const si = ffformatcontext(s);
     AVStream *const st = s->streams[pkt->stream_index];
     FFStream *const sti = ffstream(st);
-    int ret;
+    int ret, tag;
 
     // If the timestamp offsetting below is adjusted, adjust
     // ff_interleaved_peek similarly.
@@ -750,6 +788,9 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
     }
     handle_avoid_negative_ts(si, sti, pkt);
 
+    FF_TRACE4(mux_write, s->oformat->name, pkt->stream_index, pkt->size, pkt->dts); //PLEX
+
+    tag = avpriv_mem_tag_push(AV_MEM_TAG_FORMAT); //PLEX
     if ((pkt->flags & AV_PKT_FLAG_UNCODED_FRAME)) {
         AVFrame **frame = (AVFrame **)pkt->data;
         av_assert0(pkt->size == sizeof(*frame));
@@ -757,6 +798,7 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
     } else {
         ret = ffofmt(s->oformat)->write_packet(s, pkt);
     }
+    avpriv_mem_tag_pop(tag); //PLEX
 
     if (s->pb && ret >= 0) {
         flush_if_needed(s);
@@ -948,6 +990,91 @@ static int interleave_compare_dts(AVFormatContext *s, const AVPacket *next,
     return comp > 0;
 }
 
+//PLEX
+/* Per-stream dts interleaving: every stream keeps its packets in write order
+ * and a min-heap over the streams picks the one whose first packet goes out
+ * next. Timestamps are monotonic within a stream, so this yields the same
+ * order as inserting into the shared packet_buffer list, at O(log streams)
+ * per packet instead of a walk over the buffered packets. */
+static int interleave_heap_less(AVFormatContext *s, const FFStream *a,
+                                const FFStream *b)
+{
+    return interleave_compare_dts(s, &b->interleave_queue.head->pkt,
+                                     &a->interleave_queue.head->pkt);
+}
+
+static void interleave_heap_sift_up(AVFormatContext *s, int i)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    FFStream **const heap = si->interleave_heap;
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!interleave_heap_less(s, heap[i], heap[parent]))
+            break;
+        FFSWAP(FFStream *, heap[i], heap[parent]);
+        i = parent;
+    }
+}
+
+static void interleave_heap_sift_down(AVFormatContext *s, int i)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    FFStream **const heap = si->interleave_heap;
+    const int nb = si->nb_interleave_heap;
+
+    for (;;) {
+        int min = i, child = 2 * i + 1;
+        if (child < nb && interleave_heap_less(s, heap[child], heap[min]))
+            min = child;
+        if (child + 1 < nb && interleave_heap_less(s, heap[child + 1], heap[min]))
+            min = child + 1;
+        if (min == i)
+            break;
+        FFSWAP(FFStream *, heap[i], heap[min]);
+        i = min;
+    }
+}
+
+static int interleave_heap_add(AVFormatContext *s, AVPacket *pkt)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    FFStream *const sti = ffstream(s->streams[pkt->stream_index]);
+    int was_empty = !sti->interleave_queue.head;
+    int ret;
+
+    if ((ret = avpriv_packet_list_put(&sti->interleave_queue, pkt, NULL, 0)) < 0) {
+        av_packet_unref(pkt);
+        return ret;
+    }
+
+    if (was_empty) {
+        si->interleave_heap[si->nb_interleave_heap] = sti;
+        interleave_heap_sift_up(s, si->nb_interleave_heap++);
+    }
+    return 0;
+}
+
+static const AVPacket *interleave_heap_top(AVFormatContext *s)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+
+    return si->nb_interleave_heap ? &si->interleave_heap[0]->interleave_queue.head->pkt
+                                  : NULL;
+}
+
+static void interleave_heap_get(AVFormatContext *s, AVPacket *pkt)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    FFStream *const sti = si->interleave_heap[0];
+
+    avpriv_packet_list_get(&sti->interleave_queue, pkt);
+    if (!sti->interleave_queue.head)
+        si->interleave_heap[0] = si->interleave_heap[--si->nb_interleave_heap];
+    interleave_heap_sift_down(s, 0);
+}
+//PLEX
+
 int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
                                  int flush, int has_packet)
 {
@@ -957,16 +1084,28 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
     int ret;
     int eof = flush;
 
+    const AVPacket *top_pkt; //PLEX
+
     if (has_packet) {
-        if ((ret = ff_interleave_add_packet(s, pkt, interleave_compare_dts)) < 0)
+        //PLEX
+        if (si->interleave_per_stream)
+            ret = interleave_heap_add(s, pkt);
+        else
+        //PLEX
+        ret = ff_interleave_add_packet(s, pkt, interleave_compare_dts);
+        if (ret < 0)
             return ret;
     }
+    //PLEX
+    top_pkt = si->interleave_per_stream ? interleave_heap_top(s) :
+              si->packet_buffer.head    ? &si->packet_buffer.head->pkt : NULL;
+    //PLEX
 
     for (unsigned i = 0; i < s->nb_streams; i++) {
         const AVStream *const st  = s->streams[i];
         const FFStream *const sti = cffstream(st);
         const AVCodecParameters *const par = st->codecpar;
-        if (sti->last_in_packet_buffer) {
+        if (sti->last_in_packet_buffer || sti->interleave_queue.head) { //PLEX
             ++stream_count;
         } else if (par->codec_type != AVMEDIA_TYPE_ATTACHMENT &&
                    par->codec_id != AV_CODEC_ID_VP8 &&
@@ -980,12 +1119,11 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
         flush = 1;
 
     if (s->max_interleave_delta > 0 &&
-        si->packet_buffer.head &&
-        si->packet_buffer.head->pkt.dts != AV_NOPTS_VALUE &&
+        top_pkt && //PLEX
+        top_pkt->dts != AV_NOPTS_VALUE && //PLEX
         !flush &&
         si->nb_interleaved_streams == stream_count+noninterleaved_count
     ) {
-        AVPacket *const top_pkt = &si->packet_buffer.head->pkt;
         int64_t delta_dts = INT64_MIN;
         int64_t top_dts = av_rescale_q(top_pkt->dts,
                                        s->streams[top_pkt->stream_index]->time_base,
@@ -994,7 +1132,11 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
         for (unsigned i = 0; i < s->nb_streams; i++) {
             const AVStream *const st  = s->streams[i];
             const FFStream *const sti = cffstream(st);
-            const PacketListEntry *const last = sti->last_in_packet_buffer;
+            //PLEX
+            const PacketListEntry *const last = si->interleave_per_stream ?
+                                                sti->interleave_queue.tail :
+                                                sti->last_in_packet_buffer;
+            //PLEX
             int64_t last_dts;
 
             if (!last)
@@ -1016,17 +1158,31 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
     }
 
 #if FF_API_LAVF_SHORTEST
-    if (si->packet_buffer.head &&
+    if (top_pkt && //PLEX
         eof &&
         (s->flags & AVFMT_FLAG_SHORTEST) &&
         si->shortest_end == AV_NOPTS_VALUE) {
-        AVPacket *const top_pkt = &si->packet_buffer.head->pkt;
-
         si->shortest_end = av_rescale_q(top_pkt->dts,
                                        s->streams[top_pkt->stream_index]->time_base,
                                        AV_TIME_BASE_Q);
     }
 
+    //PLEX
+    if (si->shortest_end != AV_NOPTS_VALUE && si->interleave_per_stream) {
+        while ((top_pkt = interleave_heap_top(s))) {
+            AVStream *const st = s->streams[top_pkt->stream_index];
+            int64_t top_dts = av_rescale_q(top_pkt->dts, st->time_base,
+                                        AV_TIME_BASE_Q);
+
+            if (si->shortest_end + 1 >= top_dts)
+                break;
+
+            interleave_heap_get(s, pkt);
+            av_packet_unref(pkt);
+            flush = 0;
+        }
+    } else
+    //PLEX
     if (si->shortest_end != AV_NOPTS_VALUE) {
         while (si->packet_buffer.head) {
             PacketListEntry *pktl = si->packet_buffer.head;
@@ -1053,6 +1209,16 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
     }
 #endif
 
+    //PLEX
+    if (stream_count && flush && si->interleave_per_stream) {
+        /* The shortest trimming may have emptied the queues. */
+        if (!si->nb_interleave_heap)
+            return 0;
+        interleave_heap_get(s, pkt);
+        return 1;
+    }
+    //PLEX
+
     if (stream_count && flush) {
         PacketListEntry *pktl = si->packet_buffer.head;
         AVStream *const st = s->streams[pktl->pkt.stream_index];
@@ -1094,6 +1260,12 @@ const AVPacket *ff_interleaved_peek(AVFormatContext *s, int stream)
 {
     FFFormatContext *const si = ffformatcontext(s);
     PacketListEntry *pktl = si->packet_buffer.head;
+    //PLEX
+    if (si->interleave_per_stream) {
+        pktl = ffstream(s->streams[stream])->interleave_queue.head;
+        return pktl ? &pktl->pkt : NULL;
+    }
+    //PLEX
     while (pktl) {
         if (pktl->pkt.stream_index == stream) {
             return &pktl->pkt;
@@ -1312,9 +1484,11 @@ int av_write_trailer(AVFormatContext *s)
         ret = ret1;
 
     if (ffofmt(s->oformat)->write_trailer) {
+        int tag = avpriv_mem_tag_push(AV_MEM_TAG_FORMAT); //PLEX
         if (!(s->oformat->flags & AVFMT_NOFILE) && s->pb)
             avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_TRAILER);
         ret1 = ffofmt(s->oformat)->write_trailer(s);
+        avpriv_mem_tag_pop(tag); //PLEX
         if (ret >= 0)
             ret = ret1;
     }
@@ -1336,6 +1510,48 @@ int av_write_trailer(AVFormatContext *s)
     return ret;
 }
 
+//PLEX
+int avformat_restart_output_query(AVFormatContext *s)
+{
+    const FFOutputFormat *const of = ffofmt(s->oformat);
+
+    if (!of->restart)
+        return AVERROR(ENOSYS);
+    return of->restart(s, -1, 1);
+}
+
+int avformat_restart_output(AVFormatContext *s, int segment)
+{
+    const FFOutputFormat *const of = ffofmt(s->oformat);
+    FFFormatContext *const si = ffformatcontext(s);
+    int ret;
+
+    if (!of->restart)
+        return AVERROR(ENOSYS);
+
+    /* the queued packets still belong to the old timeline */
+    ret = interleaved_write_packet(s, si->parse_pkt, 1, 0);
+    if (ret < 0)
+        return ret;
+
+    ret = of->restart(s, segment, 0);
+    if (ret < 0)
+        return ret;
+
+    for (unsigned i = 0; i < s->nb_streams; i++) {
+        FFStream *const sti = ffstream(s->streams[i]);
+
+        if (sti->bsfc)
+            av_bsf_flush(sti->bsfc);
+        sti->cur_dts = 0;
+        if (sti->priv_pts && sti->priv_pts->den)
+            frac_init(sti->priv_pts, 0, 0, sti->priv_pts->den);
+    }
+
+    return 0;
+}
+//PLEX
+
 int av_get_output_timestamp(struct AVFormatContext *s, int stream,
                             int64_t *dts, int64_t *wall)
 {
@@ -133,6 +133,13 @@ typedef struct FFOutputFormat {
      */
     int (*check_bitstream)(AVFormatContext *s, AVStream *st,
                            const AVPacket *pkt);
+    //PLEX
+    /**
+     * Start a new timeline, see avformat_restart_output(). With query set,
+     * only report whether this is supported with the current options.
+     */
+    int (*restart)(AVFormatContext *s, int segment, int query);
+    //PLEX
 } FFOutputFormat;
 
 static inline const FFOutputFormat *ffofmt(const AVOutputFormat *fmt)
@@ -964,7 +964,7 @@ const AVInputFormat ff_ogg_demuxer = {
     .name           = "ogg",
     .long_name      = NULL_IF_CONFIG_SMALL("Ogg"),
     .priv_data_size = sizeof(struct ogg),
-    .flags_internal = FF_FMT_INIT_CLEANUP,
+    .flags_internal = FF_FMT_INIT_CLEANUP | FF_FMT_PACKED_INDEX, //PLEX
     .read_probe     = ogg_probe,
     .read_header    = ogg_read_header,
     .read_packet    = ogg_read_packet,
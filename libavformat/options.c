@@ -21,6 +21,7 @@
 #include "avio_internal.h"
 #include "demux.h"
 #include "internal.h"
+#include "packed_index.h" //PLEX
 
 #include "libavcodec/avcodec.h"
 #include "libavcodec/codec_par.h"
@@ -293,6 +294,14 @@ AVStream *avformat_new_stream(AVFormatContext *s, const AVCodec *c)
          * timestamps have their first few packets buffered and the
          * timestamps corrected before they are returned to the user */
         sti->cur_dts = RELATIVE_TS_BASE;
+
+        //PLEX
+        if (s->iformat->flags_internal & FF_FMT_PACKED_INDEX) {
+            sti->packed_index = ff_packed_index_alloc();
+            if (!sti->packed_index)
+                goto fail;
+        }
+        //PLEX
     } else {
         sti->cur_dts = AV_NOPTS_VALUE;
     }
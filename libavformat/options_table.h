@@ -50,6 +50,8 @@ static const AVOption avformat_options[] = {
 {"sortdts", "try to interleave outputted packets by dts", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_SORT_DTS }, INT_MIN, INT_MAX, D, "fflags"},
 {"fastseek", "fast but inaccurate seeks", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_FAST_SEEK }, INT_MIN, INT_MAX, D, "fflags"},
 {"nobuffer", "reduce the latency introduced by optional buffering", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_NOBUFFER }, 0, INT_MAX, D, "fflags"},
+{"trustheaders", "trust codec parameters from the container headers and parsers", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_TRUST_HEADERS }, INT_MIN, INT_MAX, D, "fflags"}, //PLEX
+{"sourceranges", "tag packets with their location in the input file", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_SOURCE_RANGES }, INT_MIN, INT_MAX, D, "fflags"}, //PLEX
 {"bitexact", "do not write random/volatile data", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_BITEXACT }, 0, 0, E, "fflags" },
 #if FF_API_LAVF_SHORTEST
 {"shortest", "stop muxing with the shortest stream", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_SHORTEST }, 0, 0, E | AV_OPT_FLAG_DEPRECATED, "fflags" },
@@ -108,6 +110,10 @@ static const AVOption avformat_options[] = {
 {"max_streams", "maximum number of streams", OFFSET(max_streams), AV_OPT_TYPE_INT, { .i64 = 1000 }, 0, INT_MAX, D },
 {"skip_estimate_duration_from_pts", "skip duration calculation in estimate_timings_from_pts", OFFSET(skip_estimate_duration_from_pts), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, D},
 {"max_probe_packets", "Maximum number of packets to probe a codec", OFFSET(max_probe_packets), AV_OPT_TYPE_INT, { .i64 = 2500 }, 0, INT_MAX, D },
+{"probe_cache", "directory caching the stream analysis results of local files", OFFSET(probe_cache), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D}, //PLEX
+{"decrypt_batch", "number of packets decrypted together", OFFSET(decrypt_batch), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 64, D}, //PLEX
+{"decrypt_threads", "number of threads decrypting a batch of packets", OFFSET(decrypt_threads), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 16, D}, //PLEX
+{"lazy_attached_pics", "read attached pictures only when their stream is used", OFFSET(lazy_attached_pics), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D}, //PLEX
 {NULL},
 };
 
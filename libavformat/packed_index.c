@@ -0,0 +1,487 @@
+/*
+ * Compact storage of a stream index
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+
+#include "demux.h"
+#include "packed_index.h"
+
+#define CHUNK_ENTRIES 256
+
+typedef struct IndexChunk {
+    int64_t  pos_base;
+    int64_t  ts_base;
+    int      first;     ///< index of the first entry of the chunk in the index
+    int      nb;
+    /**
+     * Narrow chunks store the timestamp and position deltas only, all of
+     * their entries have the flags below, a size and a min_distance of 0.
+     * Wide chunks also store (size << 2 | flags) and min_distance.
+     */
+    int      wide;
+    int      flags;
+    int32_t *data;
+    unsigned data_size;
+} IndexChunk;
+
+struct FFPackedIndex {
+    IndexChunk  *chunks;
+    int          nb_chunks;
+    unsigned     chunks_size;
+    int          nb_entries;
+    AVIndexEntry entry;
+};
+
+FFPackedIndex *ff_packed_index_alloc(void)
+{
+    return av_mallocz(sizeof(FFPackedIndex));
+}
+
+static void free_chunks(IndexChunk *chunks, int nb_chunks)
+{
+    for (int i = 0; i < nb_chunks; i++)
+        av_freep(&chunks[i].data);
+    av_free(chunks);
+}
+
+void ff_packed_index_free(FFPackedIndex **ppi)
+{
+    FFPackedIndex *pi = *ppi;
+
+    if (!pi)
+        return;
+    free_chunks(pi->chunks, pi->nb_chunks);
+    av_freep(ppi);
+}
+
+int ff_packed_index_nb_entries(const FFPackedIndex *pi)
+{
+    return pi->nb_entries;
+}
+
+size_t ff_packed_index_memory(const FFPackedIndex *pi)
+{
+    size_t size = sizeof(*pi) + pi->chunks_size;
+
+    for (int i = 0; i < pi->nb_chunks; i++)
+        size += pi->chunks[i].data_size;
+    return size;
+}
+
+static av_always_inline int stride(const IndexChunk *c)
+{
+    return c->wide ? 4 : 2;
+}
+
+static int delta_fits(int64_t v, int64_t base)
+{
+    return v >= base ? (uint64_t)v - base <= INT32_MAX
+                     : (uint64_t)base - v <= (uint64_t)INT32_MAX + 1;
+}
+
+static int entry_fits(const IndexChunk *c, const AVIndexEntry *e)
+{
+    return delta_fits(e->pos, c->pos_base) && delta_fits(e->timestamp, c->ts_base);
+}
+
+static int entry_is_narrow(const IndexChunk *c, const AVIndexEntry *e)
+{
+    return !e->size && !e->min_distance && e->flags == c->flags;
+}
+
+static void chunk_get(const IndexChunk *c, int i, AVIndexEntry *e)
+{
+    const int32_t *d = c->data + i * stride(c);
+
+    e->timestamp = c->ts_base  + d[0];
+    e->pos       = c->pos_base + d[1];
+    if (c->wide) {
+        e->size         = (uint32_t)d[2] >> 2;
+        e->flags        = d[2] & 3;
+        e->min_distance = d[3];
+    } else {
+        e->size         = 0;
+        e->flags        = c->flags;
+        e->min_distance = 0;
+    }
+}
+
+static void chunk_set(IndexChunk *c, int i, const AVIndexEntry *e)
+{
+    int32_t *d = c->data + i * stride(c);
+
+    d[0] = (int32_t)(uint32_t)((uint64_t)e->timestamp - c->ts_base);
+    d[1] = (int32_t)(uint32_t)((uint64_t)e->pos       - c->pos_base);
+    if (c->wide) {
+        d[2] = (int32_t)((uint32_t)e->size << 2 | (e->flags & 3));
+        d[3] = e->min_distance;
+    }
+}
+
+static int chunk_reserve(IndexChunk *c, int wide, int nb)
+{
+    int32_t *data = av_fast_realloc(c->data, &c->data_size,
+                                    nb * (wide ? 4 : 2) * sizeof(*c->data));
+    if (!data)
+        return AVERROR(ENOMEM);
+    c->data = data;
+    return 0;
+}
+
+static int chunk_widen(IndexChunk *c)
+{
+    int ret = chunk_reserve(c, 1, c->nb + 1);
+    if (ret < 0)
+        return ret;
+
+    /* in place from the end, every entry moves up */
+    for (int i = c->nb - 1; i >= 0; i--) {
+        int32_t dts = c->data[2 * i], dpos = c->data[2 * i + 1];
+        c->data[4 * i]     = dts;
+        c->data[4 * i + 1] = dpos;
+        c->data[4 * i + 2] = c->flags & 3;
+        c->data[4 * i + 3] = 0;
+    }
+    c->wide = 1;
+    return 0;
+}
+
+/* bisect for the chunk holding entry idx */
+static int find_chunk(const FFPackedIndex *pi, int idx)
+{
+    int a = 0, b = pi->nb_chunks - 1;
+
+    while (a < b) {
+        int m = (a + b + 1) >> 1;
+        if (pi->chunks[m].first <= idx)
+            a = m;
+        else
+            b = m - 1;
+    }
+    return a;
+}
+
+void ff_packed_index_get(const FFPackedIndex *pi, int idx, AVIndexEntry *e)
+{
+    const IndexChunk *c;
+
+    av_assert1(idx >= 0 && idx < pi->nb_entries);
+    c = &pi->chunks[find_chunk(pi, idx)];
+    chunk_get(c, idx - c->first, e);
+}
+
+const AVIndexEntry *ff_packed_index_entry(FFPackedIndex *pi, int idx)
+{
+    ff_packed_index_get(pi, idx, &pi->entry);
+    return &pi->entry;
+}
+
+static int64_t entry_timestamp(const FFPackedIndex *pi, int idx)
+{
+    const IndexChunk *c = &pi->chunks[find_chunk(pi, idx)];
+    return c->ts_base + c->data[(idx - c->first) * stride(c)];
+}
+
+static int entry_flags(const FFPackedIndex *pi, int idx)
+{
+    const IndexChunk *c = &pi->chunks[find_chunk(pi, idx)];
+    return c->wide ? c->data[(idx - c->first) * 4 + 2] & 3 : c->flags;
+}
+
+int ff_packed_index_search(const FFPackedIndex *pi, int64_t wanted_timestamp,
+                           int flags)
+{
+    int nb_entries = pi->nb_entries;
+    int a, b, m;
+    int64_t timestamp;
+
+    /* the same search as ff_index_search_timestamp() */
+    a = -1;
+    b = nb_entries;
+
+    if (b && entry_timestamp(pi, b - 1) < wanted_timestamp)
+        a = b - 1;
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+
+        while ((entry_flags(pi, m) & AVINDEX_DISCARD_FRAME) && m < b && m < nb_entries - 1) {
+            m++;
+            if (m == b && entry_timestamp(pi, m) >= wanted_timestamp) {
+                m = b - 1;
+                break;
+            }
+        }
+
+        timestamp = entry_timestamp(pi, m);
+        if (timestamp >= wanted_timestamp)
+            b = m;
+        if (timestamp <= wanted_timestamp)
+            a = m;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        while (m >= 0 && m < nb_entries &&
+               !(entry_flags(pi, m) & AVINDEX_KEYFRAME))
+            m += (flags & AVSEEK_FLAG_BACKWARD) ? -1 : 1;
+
+    if (m == nb_entries)
+        return -1;
+    return m;
+}
+
+/* open a gap for nb chunks at position k */
+static int chunks_insert(FFPackedIndex *pi, int k, int nb)
+{
+    IndexChunk *chunks;
+
+    if (pi->nb_chunks > INT_MAX / sizeof(*chunks) - nb)
+        return AVERROR(ENOMEM);
+    chunks = av_fast_realloc(pi->chunks, &pi->chunks_size,
+                             (pi->nb_chunks + nb) * sizeof(*chunks));
+    if (!chunks)
+        return AVERROR(ENOMEM);
+    pi->chunks = chunks;
+
+    memmove(chunks + k + nb, chunks + k, (pi->nb_chunks - k) * sizeof(*chunks));
+    memset(chunks + k, 0, nb * sizeof(*chunks));
+    pi->nb_chunks += nb;
+    return 0;
+}
+
+/* move the entries of chunk k from off on into a new chunk k + 1 */
+static int chunk_split(FFPackedIndex *pi, int k, int off)
+{
+    IndexChunk *c, *n;
+    int ret = chunks_insert(pi, k + 1, 1);
+    if (ret < 0)
+        return ret;
+
+    c = &pi->chunks[k];
+    n = &pi->chunks[k + 1];
+    n->pos_base = c->pos_base;
+    n->ts_base  = c->ts_base;
+    n->first    = c->first + off;
+    n->nb       = c->nb - off;
+    n->wide     = c->wide;
+    n->flags    = c->flags;
+    ret = chunk_reserve(n, n->wide, n->nb);
+    if (ret < 0) {
+        memmove(n, n + 1, (pi->nb_chunks - k - 2) * sizeof(*n));
+        pi->nb_chunks--;
+        return ret;
+    }
+    memcpy(n->data, c->data + off * stride(c), n->nb * stride(c) * sizeof(*c->data));
+    c->nb = off;
+    return 0;
+}
+
+/* start a new chunk k with e as its only entry */
+static int chunk_new(FFPackedIndex *pi, int k, int first, const AVIndexEntry *e)
+{
+    IndexChunk *c;
+    int ret = chunks_insert(pi, k, 1);
+    if (ret < 0)
+        return ret;
+
+    c = &pi->chunks[k];
+    c->pos_base = e->pos;
+    c->ts_base  = e->timestamp;
+    c->first    = first;
+    c->flags    = e->flags;
+    c->wide     = !entry_is_narrow(c, e);
+    ret = chunk_reserve(c, c->wide, 1);
+    if (ret < 0) {
+        memmove(c, c + 1, (pi->nb_chunks - k - 1) * sizeof(*c));
+        pi->nb_chunks--;
+        return ret;
+    }
+    chunk_set(c, 0, e);
+    c->nb = 1;
+    return 0;
+}
+
+static int index_insert(FFPackedIndex *pi, int idx, const AVIndexEntry *e)
+{
+    IndexChunk *c;
+    int k, off, ret;
+
+    if (!pi->nb_chunks) {
+        k   = 0;
+        ret = chunk_new(pi, 0, 0, e);
+        goto done;
+    }
+
+    if (idx == pi->nb_entries) {
+        k = pi->nb_chunks - 1;
+    } else {
+        k = find_chunk(pi, idx);
+        /* fill up the previous chunk rather than this one */
+        if (idx == pi->chunks[k].first && k > 0 &&
+            pi->chunks[k - 1].nb < CHUNK_ENTRIES && entry_fits(&pi->chunks[k - 1], e))
+            k--;
+    }
+    c   = &pi->chunks[k];
+    off = idx - c->first;
+
+    if (!entry_fits(c, e) || (off == c->nb && c->nb == CHUNK_ENTRIES)) {
+        if (off == 0) {
+            ret = chunk_new(pi, k, idx, e);
+        } else {
+            if (off < c->nb && (ret = chunk_split(pi, k, off)) < 0)
+                return ret;
+            ret = chunk_new(pi, ++k, idx, e);
+        }
+        goto done;
+    }
+
+    if (c->nb == CHUNK_ENTRIES) {
+        int half = CHUNK_ENTRIES / 2;
+        if ((ret = chunk_split(pi, k, half)) < 0)
+            return ret;
+        if (off >= half) {
+            k++;
+            off -= half;
+        }
+        c = &pi->chunks[k];
+    }
+
+    if (!c->wide && !entry_is_narrow(c, e))
+        ret = chunk_widen(c);
+    else
+        ret = chunk_reserve(c, c->wide, c->nb + 1);
+    if (ret < 0)
+        return ret;
+
+    memmove(c->data + (off + 1) * stride(c), c->data + off * stride(c),
+            (c->nb - off) * stride(c) * sizeof(*c->data));
+    chunk_set(c, off, e);
+    c->nb++;
+    ret = 0;
+
+done:
+    if (ret < 0)
+        return ret;
+    for (int i = k + 1; i < pi->nb_chunks; i++)
+        pi->chunks[i].first++;
+    pi->nb_entries++;
+    return 0;
+}
+
+static int index_replace(FFPackedIndex *pi, int idx, const AVIndexEntry *e)
+{
+    int k = find_chunk(pi, idx);
+    IndexChunk *c = &pi->chunks[k];
+    int off = idx - c->first, ret;
+
+    if (!entry_fits(c, e)) {
+        /* give the entry a chunk of its own */
+        if (off + 1 < c->nb && (ret = chunk_split(pi, k, off + 1)) < 0)
+            return ret;
+        if (off > 0) {
+            if ((ret = chunk_split(pi, k, off)) < 0)
+                return ret;
+            k++;
+        }
+        c = &pi->chunks[k];
+        av_assert1(c->nb == 1);
+        c->pos_base = e->pos;
+        c->ts_base  = e->timestamp;
+        off = 0;
+    }
+
+    if (!c->wide && !entry_is_narrow(c, e) && (ret = chunk_widen(c)) < 0)
+        return ret;
+    chunk_set(c, off, e);
+    return 0;
+}
+
+int ff_packed_index_add(FFPackedIndex *pi, int64_t pos, int64_t timestamp,
+                        int size, int distance, int flags)
+{
+    AVIndexEntry e, ie;
+    int index, replace = 0, ret;
+
+    if ((unsigned) pi->nb_entries + 1 >= INT_MAX)
+        return -1;
+
+    if (timestamp == AV_NOPTS_VALUE)
+        return AVERROR(EINVAL);
+
+    if (size < 0 || size > 0x3FFFFFFF)
+        return AVERROR(EINVAL);
+
+    if (is_relative(timestamp)) //FIXME see ff_add_index_entry()
+        timestamp -= RELATIVE_TS_BASE;
+
+    index = ff_packed_index_search(pi, timestamp, AVSEEK_FLAG_ANY);
+    if (index < 0) {
+        index = pi->nb_entries;
+        av_assert0(index == 0 || entry_timestamp(pi, index - 1) < timestamp);
+    } else {
+        ff_packed_index_get(pi, index, &ie);
+        if (ie.timestamp != timestamp) {
+            if (ie.timestamp <= timestamp)
+                return -1;
+        } else {
+            replace = 1;
+            if (ie.pos == pos && distance < ie.min_distance)
+                // do not reduce the distance
+                distance = ie.min_distance;
+        }
+    }
+
+    e.pos          = pos;
+    e.timestamp    = timestamp;
+    e.min_distance = distance;
+    e.size         = size;
+    e.flags        = flags;
+
+    ret = replace ? index_replace(pi, index, &e) : index_insert(pi, index, &e);
+    return ret < 0 ? ret : index;
+}
+
+int ff_packed_index_reduce(FFPackedIndex *pi)
+{
+    FFPackedIndex tmp = { 0 };
+    AVIndexEntry e;
+    int ret;
+
+    for (int i = 0; i < pi->nb_entries; i += 2) {
+        ff_packed_index_get(pi, i, &e);
+        if ((ret = index_insert(&tmp, tmp.nb_entries, &e)) < 0) {
+            free_chunks(tmp.chunks, tmp.nb_chunks);
+            return ret;
+        }
+    }
+
+    free_chunks(pi->chunks, pi->nb_chunks);
+    pi->chunks      = tmp.chunks;
+    pi->nb_chunks   = tmp.nb_chunks;
+    pi->chunks_size = tmp.chunks_size;
+    pi->nb_entries  = tmp.nb_entries;
+    return 0;
+}
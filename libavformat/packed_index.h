@@ -0,0 +1,80 @@
+/*
+ * Compact storage of a stream index
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PACKED_INDEX_H
+#define AVFORMAT_PACKED_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "avformat.h"
+
+/**
+ * Index entries sorted by timestamp, like FFStream.index_entries, but
+ * kept in chunks of a few hundred entries. Each chunk stores position and
+ * timestamp as 32-bit deltas to a base, and size and min_distance only
+ * once one of its entries has them. An entry of a keyframe index thus
+ * takes 8 bytes instead of sizeof(AVIndexEntry).
+ *
+ * Lookups bisect the chunks, then the entries of a chunk. Appending is
+ * O(1), inserting moves at most one chunk of entries.
+ */
+typedef struct FFPackedIndex FFPackedIndex;
+
+FFPackedIndex *ff_packed_index_alloc(void);
+
+void ff_packed_index_free(FFPackedIndex **ppi);
+
+int ff_packed_index_nb_entries(const FFPackedIndex *pi);
+
+/**
+ * @return the number of bytes allocated for the index
+ */
+size_t ff_packed_index_memory(const FFPackedIndex *pi);
+
+/**
+ * Read entry idx, which must exist, into e.
+ */
+void ff_packed_index_get(const FFPackedIndex *pi, int idx, AVIndexEntry *e);
+
+/**
+ * Like ff_packed_index_get(), but into storage owned by the index, valid
+ * until the next call on it.
+ */
+const AVIndexEntry *ff_packed_index_entry(FFPackedIndex *pi, int idx);
+
+/**
+ * Same as ff_index_search_timestamp() on the entries of the index.
+ */
+int ff_packed_index_search(const FFPackedIndex *pi, int64_t wanted_timestamp,
+                           int flags);
+
+/**
+ * Same as ff_add_index_entry() on the entries of the index.
+ */
+int ff_packed_index_add(FFPackedIndex *pi, int64_t pos, int64_t timestamp,
+                        int size, int distance, int flags);
+
+/**
+ * Drop every second entry, as ff_reduce_index() does.
+ */
+int ff_packed_index_reduce(FFPackedIndex *pi);
+
+#endif /* AVFORMAT_PACKED_INDEX_H */
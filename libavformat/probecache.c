@@ -0,0 +1,443 @@
+/*
+ * Persistent cache of avformat_find_stream_info() results
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/md5.h"
+#include "libavutil/mem.h"
+#include "libavutil/random_seed.h"
+
+#include "libavcodec/avcodec.h"
+
+#include "avformat.h"
+#include "demux.h"
+#include "internal.h"
+#include "os_support.h"
+#include "probecache.h"
+#include "url.h"
+#include "version.h"
+
+#define CACHE_MAGIC   MKBETAG('P', 'L', 'P', 'C')
+#define CACHE_VERSION 1
+
+// bound the size of an entry for files with huge indexes
+#define MAX_INDEX_ENTRIES (1 << 16)
+
+typedef struct CachedStream {
+    AVCodecParameters *par;
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+    int disposition;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+    AVRational sample_aspect_ratio;
+    int codec_info_nb_frames;
+    AVIndexEntry *index;
+    int nb_index;
+} CachedStream;
+
+/* Build the cache key and the entry path, return 0 if s is not cacheable. */
+static int cache_key(AVFormatContext *s, AVBPrint *key, AVBPrint *path)
+{
+    const char *proto = avio_find_protocol_name(s->url);
+    const char *filename = s->url;
+    uint8_t md5[16];
+    struct stat st;
+
+    if (!s->probe_cache || !*s->probe_cache || !s->iformat ||
+        (s->ctx_flags & AVFMTCTX_NOHEADER))
+        return 0;
+    if (!proto || strcmp(proto, "file"))
+        return 0;
+    av_strstart(filename, "file:", &filename);
+    if (stat(filename, &st) || !S_ISREG(st.st_mode))
+        return 0;
+
+    av_bprintf(key, "%d\n%s\n%s\n%"PRId64"\n%"PRId64"\n%"PRId64"\n%"PRId64"\n%d\n",
+               LIBAVFORMAT_VERSION_INT, s->iformat->name, filename,
+               (int64_t)st.st_size, (int64_t)st.st_mtime,
+               s->probesize, s->max_analyze_duration, s->flags);
+    if (!av_bprint_is_complete(key))
+        return AVERROR(ENOMEM);
+
+    av_md5_sum(md5, key->str, key->len);
+    av_bprintf(path, "%s/", s->probe_cache);
+    for (int i = 0; i < sizeof(md5); i++)
+        av_bprintf(path, "%02x", md5[i]);
+    av_bprintf(path, ".probe");
+
+    return av_bprint_is_complete(path) ? 1 : AVERROR(ENOMEM);
+}
+
+static void write_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wb32(pb, q.num);
+    avio_wb32(pb, q.den);
+}
+
+static AVRational read_rational(AVIOContext *pb)
+{
+    AVRational q;
+    q.num = avio_rb32(pb);
+    q.den = avio_rb32(pb);
+    return q;
+}
+
+static void write_stream(AVIOContext *pb, const AVStream *st)
+{
+    const FFStream *const sti = cffstream(st);
+    const AVCodecParameters *par = st->codecpar;
+    int nb_index = FFMIN(ff_index_nb_entries(sti), MAX_INDEX_ENTRIES);
+
+    avio_wb32(pb, st->id);
+    avio_wb32(pb, par->codec_type);
+    avio_wb32(pb, par->codec_id);
+    avio_wb32(pb, par->codec_tag);
+    write_rational(pb, st->time_base);
+
+    avio_wb32(pb, par->format);
+    avio_wb64(pb, par->bit_rate);
+    avio_wb32(pb, par->bits_per_coded_sample);
+    avio_wb32(pb, par->bits_per_raw_sample);
+    avio_wb32(pb, par->profile);
+    avio_wb32(pb, par->level);
+    avio_wb32(pb, par->width);
+    avio_wb32(pb, par->height);
+    write_rational(pb, par->sample_aspect_ratio);
+    write_rational(pb, par->framerate);
+    avio_wb32(pb, par->field_order);
+    avio_wb32(pb, par->color_range);
+    avio_wb32(pb, par->color_primaries);
+    avio_wb32(pb, par->color_trc);
+    avio_wb32(pb, par->color_space);
+    avio_wb32(pb, par->chroma_location);
+    avio_wb32(pb, par->video_delay);
+    avio_wb32(pb, par->ch_layout.order);
+    avio_wb32(pb, par->ch_layout.nb_channels);
+    avio_wb64(pb, par->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ||
+                  par->ch_layout.order == AV_CHANNEL_ORDER_AMBISONIC ?
+                  par->ch_layout.u.mask : 0);
+    avio_wb32(pb, par->sample_rate);
+    avio_wb32(pb, par->block_align);
+    avio_wb32(pb, par->frame_size);
+    avio_wb32(pb, par->initial_padding);
+    avio_wb32(pb, par->trailing_padding);
+    avio_wb32(pb, par->seek_preroll);
+    avio_wb32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+
+    avio_wb64(pb, st->start_time);
+    avio_wb64(pb, st->duration);
+    avio_wb64(pb, st->nb_frames);
+    avio_wb32(pb, st->disposition);
+    write_rational(pb, st->avg_frame_rate);
+    write_rational(pb, st->r_frame_rate);
+    write_rational(pb, st->sample_aspect_ratio);
+    avio_wb32(pb, sti->codec_info_nb_frames);
+
+    avio_wb32(pb, nb_index);
+    for (int i = 0; i < nb_index; i++) {
+        AVIndexEntry tmp;
+        const AVIndexEntry *e = ff_index_get_entry(sti, i, &tmp);
+        avio_wb64(pb, e->pos);
+        avio_wb64(pb, e->timestamp);
+        avio_wb32(pb, e->size);
+        avio_wb32(pb, e->flags);
+        avio_wb32(pb, e->min_distance);
+    }
+}
+
+/* return 1 if the cached stream matches st and was read into cs */
+static int read_stream(AVIOContext *pb, const AVStream *st, CachedStream *cs)
+{
+    AVCodecParameters *par;
+    AVRational time_base;
+    int id, codec_type, codec_id, codec_tag, size;
+    uint64_t mask;
+
+    id         = avio_rb32(pb);
+    codec_type = avio_rb32(pb);
+    codec_id   = avio_rb32(pb);
+    codec_tag  = avio_rb32(pb);
+    time_base  = read_rational(pb);
+    if (id != st->id || codec_type != st->codecpar->codec_type ||
+        codec_id != st->codecpar->codec_id ||
+        av_cmp_q(time_base, st->time_base))
+        return 0;
+
+    par = cs->par = avcodec_parameters_alloc();
+    if (!par)
+        return AVERROR(ENOMEM);
+
+    par->codec_type            = codec_type;
+    par->codec_id              = codec_id;
+    par->codec_tag             = codec_tag;
+    par->format                = avio_rb32(pb);
+    par->bit_rate              = avio_rb64(pb);
+    par->bits_per_coded_sample = avio_rb32(pb);
+    par->bits_per_raw_sample   = avio_rb32(pb);
+    par->profile               = avio_rb32(pb);
+    par->level                 = avio_rb32(pb);
+    par->width                 = avio_rb32(pb);
+    par->height                = avio_rb32(pb);
+    par->sample_aspect_ratio   = read_rational(pb);
+    par->framerate             = read_rational(pb);
+    par->field_order           = avio_rb32(pb);
+    par->color_range           = avio_rb32(pb);
+    par->color_primaries       = avio_rb32(pb);
+    par->color_trc             = avio_rb32(pb);
+    par->color_space           = avio_rb32(pb);
+    par->chroma_location       = avio_rb32(pb);
+    par->video_delay           = avio_rb32(pb);
+    par->ch_layout.order       = avio_rb32(pb);
+    par->ch_layout.nb_channels = avio_rb32(pb);
+    mask                       = avio_rb64(pb);
+    if (par->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ||
+        par->ch_layout.order == AV_CHANNEL_ORDER_AMBISONIC)
+        par->ch_layout.u.mask = mask;
+    else if (par->ch_layout.order != AV_CHANNEL_ORDER_UNSPEC)
+        return 0;
+    par->sample_rate           = avio_rb32(pb);
+    par->block_align           = avio_rb32(pb);
+    par->frame_size            = avio_rb32(pb);
+    par->initial_padding       = avio_rb32(pb);
+    par->trailing_padding      = avio_rb32(pb);
+    par->seek_preroll          = avio_rb32(pb);
+
+    size = avio_rb32(pb);
+    if (size < 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return 0;
+    if (size) {
+        par->extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata)
+            return AVERROR(ENOMEM);
+        par->extradata_size = size;
+        if (avio_read(pb, par->extradata, size) != size)
+            return 0;
+    }
+
+    cs->start_time           = avio_rb64(pb);
+    cs->duration             = avio_rb64(pb);
+    cs->nb_frames            = avio_rb64(pb);
+    cs->disposition          = avio_rb32(pb);
+    cs->avg_frame_rate       = read_rational(pb);
+    cs->r_frame_rate         = read_rational(pb);
+    cs->sample_aspect_ratio  = read_rational(pb);
+    cs->codec_info_nb_frames = avio_rb32(pb);
+
+    cs->nb_index = avio_rb32(pb);
+    if (cs->nb_index < 0 || cs->nb_index > MAX_INDEX_ENTRIES)
+        return 0;
+    if (cs->nb_index) {
+        cs->index = av_calloc(cs->nb_index, sizeof(*cs->index));
+        if (!cs->index)
+            return AVERROR(ENOMEM);
+    }
+    for (int i = 0; i < cs->nb_index; i++) {
+        AVIndexEntry *e = &cs->index[i];
+        e->pos          = avio_rb64(pb);
+        e->timestamp    = avio_rb64(pb);
+        e->size         = avio_rb32(pb);
+        e->flags        = avio_rb32(pb);
+        e->min_distance = avio_rb32(pb);
+    }
+
+    return pb->error || avio_feof(pb) ? 0 : 1;
+}
+
+static int apply_stream(AVStream *st, CachedStream *cs)
+{
+    FFStream *const sti = ffstream(st);
+    int ret;
+
+    // keep the side data exported by the demuxer when reading the header
+    FFSWAP(AVPacketSideData*, cs->par->coded_side_data, st->codecpar->coded_side_data);
+    FFSWAP(int, cs->par->nb_coded_side_data, st->codecpar->nb_coded_side_data);
+
+    ret = avcodec_parameters_copy(st->codecpar, cs->par);
+    if (ret < 0)
+        return ret;
+
+    st->start_time          = cs->start_time;
+    st->duration            = cs->duration;
+    st->nb_frames           = cs->nb_frames;
+    st->disposition         = cs->disposition;
+    st->avg_frame_rate      = cs->avg_frame_rate;
+    st->r_frame_rate        = cs->r_frame_rate;
+    st->sample_aspect_ratio = cs->sample_aspect_ratio;
+    sti->codec_info_nb_frames = cs->codec_info_nb_frames;
+
+    for (int i = 0; i < cs->nb_index; i++) {
+        const AVIndexEntry *e = &cs->index[i];
+        av_add_index_entry(st, e->pos, e->timestamp, e->size,
+                           e->min_distance, e->flags);
+    }
+
+    // let the demuxing code update its internal context and parser
+    sti->need_context_update = 1;
+
+    return 0;
+}
+
+int ff_probe_cache_restore(AVFormatContext *s)
+{
+    AVBPrint key, path, cached_key;
+    AVIOContext *pb = NULL;
+    CachedStream *streams = NULL;
+    unsigned nb_streams = 0;
+    int ret, size;
+
+    av_bprint_init(&key,  0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&path, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&cached_key, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    ret = cache_key(s, &key, &path);
+    if (ret <= 0)
+        goto end;
+
+    if (avio_open2(&pb, path.str, AVIO_FLAG_READ, &s->interrupt_callback, NULL) < 0) {
+        ret = 0;
+        goto end;
+    }
+
+    ret = 0;
+    if (avio_rb32(pb) != CACHE_MAGIC || avio_rb32(pb) != CACHE_VERSION)
+        goto end;
+
+    size = avio_rb32(pb);
+    if (size != key.len)
+        goto end;
+    while (size > 0 && !avio_feof(pb)) {
+        av_bprint_chars(&cached_key, avio_r8(pb), 1);
+        size--;
+    }
+    if (!av_bprint_is_complete(&cached_key) || strcmp(cached_key.str, key.str))
+        goto end;
+
+    nb_streams = avio_rb32(pb);
+    if (nb_streams != s->nb_streams)
+        goto end;
+
+    streams = av_calloc(nb_streams, sizeof(*streams));
+    if (!streams) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    for (unsigned i = 0; i < nb_streams; i++) {
+        ret = read_stream(pb, s->streams[i], &streams[i]);
+        if (ret <= 0)
+            goto end;
+    }
+
+    for (unsigned i = 0; i < nb_streams; i++) {
+        ret = apply_stream(s->streams[i], &streams[i]);
+        if (ret < 0)
+            goto end;
+    }
+    s->start_time = avio_rb64(pb);
+    s->duration   = avio_rb64(pb);
+    s->bit_rate   = avio_rb64(pb);
+    s->duration_estimation_method = avio_rb32(pb);
+
+    av_log(s, AV_LOG_VERBOSE, "Restored stream parameters from %s\n", path.str);
+    ret = 1;
+
+end:
+    if (streams) {
+        for (unsigned i = 0; i < nb_streams; i++) {
+            avcodec_parameters_free(&streams[i].par);
+            av_freep(&streams[i].index);
+        }
+        av_freep(&streams);
+    }
+    avio_closep(&pb);
+    av_bprint_finalize(&key, NULL);
+    av_bprint_finalize(&path, NULL);
+    av_bprint_finalize(&cached_key, NULL);
+    return ret;
+}
+
+void ff_probe_cache_store(AVFormatContext *s)
+{
+    AVBPrint key, path, tmp;
+    AVIOContext *pb = NULL;
+    int ret;
+
+    av_bprint_init(&key,  0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&path, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&tmp,  0, AV_BPRINT_SIZE_UNLIMITED);
+
+    ret = cache_key(s, &key, &path);
+    if (ret <= 0)
+        goto end;
+
+    for (unsigned i = 0; i < s->nb_streams; i++) {
+        const AVChannelLayout *ch_layout = &s->streams[i]->codecpar->ch_layout;
+        if (ch_layout->order == AV_CHANNEL_ORDER_CUSTOM)
+            goto end;
+    }
+
+    // write to a temporary file, so that readers never see partial entries
+    av_bprintf(&tmp, "%s.%08"PRIx32".tmp", path.str, av_get_random_seed());
+    if (!av_bprint_is_complete(&tmp)) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = avio_open2(&pb, tmp.str, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
+    if (ret < 0)
+        goto end;
+
+    avio_wb32(pb, CACHE_MAGIC);
+    avio_wb32(pb, CACHE_VERSION);
+    avio_wb32(pb, key.len);
+    avio_write(pb, key.str, key.len);
+
+    avio_wb32(pb, s->nb_streams);
+    for (unsigned i = 0; i < s->nb_streams; i++)
+        write_stream(pb, s->streams[i]);
+    avio_wb64(pb, s->start_time);
+    avio_wb64(pb, s->duration);
+    avio_wb64(pb, s->bit_rate);
+    avio_wb32(pb, s->duration_estimation_method);
+
+    ret = avio_closep(&pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp.str, path.str, s);
+    if (ret < 0)
+        ffurl_delete(tmp.str);
+    else
+        av_log(s, AV_LOG_VERBOSE, "Stored stream parameters in %s\n", path.str);
+
+end:
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Could not update the probe cache: %s\n",
+               av_err2str(ret));
+    avio_closep(&pb);
+    av_bprint_finalize(&key, NULL);
+    av_bprint_finalize(&path, NULL);
+    av_bprint_finalize(&tmp, NULL);
+}
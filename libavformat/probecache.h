@@ -0,0 +1,46 @@
+/*
+ * Persistent cache of avformat_find_stream_info() results
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PROBECACHE_H
+#define AVFORMAT_PROBECACHE_H
+
+#include "avformat.h"
+
+/**
+ * Restore the stream parameters found by an earlier
+ * avformat_find_stream_info() on the same file from the cache directory
+ * set by the probe_cache option.
+ *
+ * Entries are keyed by the path, size and modification time of a local
+ * file, along with the demuxer and the probing limits. Formats without a
+ * header are never cached.
+ *
+ * @return 1 if the parameters were restored, 0 if there is no usable entry,
+ *         a negative error code on failure
+ */
+int ff_probe_cache_restore(AVFormatContext *s);
+
+/**
+ * Store the parameters found by a successful avformat_find_stream_info()
+ * call in the cache. Failures are logged and otherwise ignored.
+ */
+void ff_probe_cache_store(AVFormatContext *s);
+
+#endif /* AVFORMAT_PROBECACHE_H */
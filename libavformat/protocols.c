@@ -26,6 +26,8 @@
 
 extern const URLProtocol ff_async_protocol;
 extern const URLProtocol ff_bluray_protocol;
+//PLEX
+extern const URLProtocol ff_blockcache_protocol;
 extern const URLProtocol ff_cache_protocol;
 extern const URLProtocol ff_concat_protocol;
 extern const URLProtocol ff_concatf_protocol;
@@ -40,12 +42,16 @@ extern const URLProtocol ff_gopher_protocol;
 extern const URLProtocol ff_gophers_protocol;
 extern const URLProtocol ff_hls_protocol;
 extern const URLProtocol ff_http_protocol;
+//PLEX
+extern const URLProtocol ff_http2_protocol;
 extern const URLProtocol ff_httpproxy_protocol;
 extern const URLProtocol ff_https_protocol;
 extern const URLProtocol ff_icecast_protocol;
 extern const URLProtocol ff_mmsh_protocol;
 extern const URLProtocol ff_mmst_protocol;
 extern const URLProtocol ff_md5_protocol;
+//PLEX
+extern const URLProtocol ff_memstore_protocol;
 extern const URLProtocol ff_pipe_protocol;
 extern const URLProtocol ff_prompeg_protocol;
 extern const URLProtocol ff_rtmp_protocol;
@@ -0,0 +1,92 @@
+/*
+ * Per-stream read-ahead for badly interleaved files
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+
+#include "avformat.h"
+#include "readahead.h"
+
+int ff_readahead_covers(const FFReadAhead *ra, int64_t pos, int size)
+{
+    return ra->size && pos >= ra->pos && pos - ra->pos <= ra->size - size;
+}
+
+int ff_readahead_wanted(const FFReadAhead *ra, AVIOContext *pb,
+                        int64_t pos, int size, int window)
+{
+    int64_t dist;
+
+    if (window <= 0)
+        return 0;
+    if (ff_readahead_covers(ra, pos, size))
+        return 1;
+    dist = pos - avio_tell(pb);
+    return dist < 0 || dist > window;
+}
+
+int ff_readahead_get_packet(FFReadAhead *ra, AVIOContext *pb, AVPacket *pkt,
+                            int64_t pos, int size, int64_t len)
+{
+    int ret;
+
+    if (size < 0)
+        return AVERROR(EINVAL);
+
+    if (!ff_readahead_covers(ra, pos, size)) {
+        int64_t ret64;
+
+        ra->size = 0;
+        len = FFMAX(len, size);
+        if (len > INT_MAX)
+            len = INT_MAX;
+        if ((ret64 = avio_seek(pb, pos, SEEK_SET)) < 0)
+            return ret64;
+        av_fast_malloc(&ra->buf, &ra->allocated, len);
+        if (!ra->buf)
+            return av_get_packet(pb, pkt, size);
+        ret = avio_read(pb, ra->buf, len);
+        if (ret < size) {
+            /* short read, let the caller see the same result a plain read gives */
+            if (avio_seek(pb, pos, SEEK_SET) < 0)
+                return ret < 0 ? ret : AVERROR_EOF;
+            return av_get_packet(pb, pkt, size);
+        }
+        ra->pos  = pos;
+        ra->size = ret;
+    }
+
+    if ((ret = av_new_packet(pkt, size)) < 0)
+        return ret;
+    memcpy(pkt->data, ra->buf + (pos - ra->pos), size);
+    pkt->pos = pos;
+    return size;
+}
+
+void ff_readahead_free(FFReadAhead *ra)
+{
+    av_freep(&ra->buf);
+    ra->allocated = 0;
+    ra->size      = 0;
+}
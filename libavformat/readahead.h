@@ -0,0 +1,66 @@
+/*
+ * Per-stream read-ahead for badly interleaved files
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_READAHEAD_H
+#define AVFORMAT_READAHEAD_H
+
+#include <stdint.h>
+
+#include "libavcodec/packet.h"
+#include "avio.h"
+
+/**
+ * A window of file data belonging to one stream. Demuxers that would
+ * otherwise seek between far apart tracks for every packet read each
+ * track's contiguous samples in one go and serve the following packets
+ * from it.
+ */
+typedef struct FFReadAhead {
+    uint8_t *buf;
+    unsigned int allocated;
+    int64_t pos;            ///< file position of buf[0]
+    int size;               ///< valid bytes in buf
+} FFReadAhead;
+
+/**
+ * @return 1 if a read of size bytes at pos is buffered or would need a
+ *         seek further than window bytes from the current position of pb
+ */
+int ff_readahead_wanted(const FFReadAhead *ra, AVIOContext *pb,
+                        int64_t pos, int size, int window);
+
+/**
+ * @return 1 if the size bytes at pos are buffered
+ */
+int ff_readahead_covers(const FFReadAhead *ra, int64_t pos, int size);
+
+/**
+ * Read size bytes at pos into pkt. If they are not buffered, the len bytes
+ * at pos are buffered first, len should cover the stream's data that
+ * follows contiguously. pb is left after the buffered range.
+ *
+ * @return size of pkt or a negative error code
+ */
+int ff_readahead_get_packet(FFReadAhead *ra, AVIOContext *pb, AVPacket *pkt,
+                            int64_t pos, int size, int64_t len);
+
+void ff_readahead_free(FFReadAhead *ra);
+
+#endif /* AVFORMAT_READAHEAD_H */
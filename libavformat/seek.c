@@ -31,6 +31,7 @@
 #include "avio_internal.h"
 #include "demux.h"
 #include "internal.h"
+#include "packed_index.h" //PLEX
 
 void avpriv_update_cur_dts(AVFormatContext *s, AVStream *ref_st, int64_t timestamp)
 {
@@ -51,6 +52,15 @@ void ff_reduce_index(AVFormatContext *s, int stream_index)
     FFStream *const sti = ffstream(st);
     unsigned int max_entries = s->max_index_size / sizeof(AVIndexEntry);
 
+    //PLEX
+    if (sti->packed_index) {
+        if (ff_packed_index_memory(sti->packed_index) >= s->max_index_size &&
+            ff_packed_index_reduce(sti->packed_index) < 0)
+            av_log(s, AV_LOG_WARNING, "Could not reduce the index\n");
+        return;
+    }
+    //PLEX
+
     if ((unsigned) sti->nb_index_entries >= max_entries) {
         int i;
         for (i = 0; 2 * i < sti->nb_index_entries; i++)
@@ -122,6 +132,11 @@ int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
 {
     FFStream *const sti = ffstream(st);
     timestamp = ff_wrap_timestamp(st, timestamp);
+    //PLEX
+    if (sti->packed_index)
+        return ff_packed_index_add(sti->packed_index, pos, timestamp,
+                                   size, distance, flags);
+    //PLEX
     return ff_add_index_entry(&sti->index_entries, &sti->nb_index_entries,
                               &sti->index_entries_allocated_size, pos,
                               timestamp, size, distance, flags);
@@ -170,6 +185,22 @@ int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
     return m;
 }
 
+//PLEX
+int ff_index_nb_entries(const FFStream *sti)
+{
+    return sti->packed_index ? ff_packed_index_nb_entries(sti->packed_index)
+                             : sti->nb_index_entries;
+}
+
+const AVIndexEntry *ff_index_get_entry(const FFStream *sti, int idx, AVIndexEntry *tmp)
+{
+    if (!sti->packed_index)
+        return &sti->index_entries[idx];
+    ff_packed_index_get(sti->packed_index, idx, tmp);
+    return tmp;
+}
+//PLEX
+
 void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
 {
     int64_t pos_delta = 0;
@@ -200,15 +231,17 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
             if (ist1 == ist2)
                 continue;
 
-            for (int i1 = 0, i2 = 0; i1 < sti1->nb_index_entries; i1++) {
-                const AVIndexEntry *const e1 = &sti1->index_entries[i1];
+            for (int i1 = 0, i2 = 0, nb1 = ff_index_nb_entries(sti1), //PLEX
+                 nb2 = ff_index_nb_entries(sti2); i1 < nb1; i1++) {
+                AVIndexEntry tmp1, tmp2; //PLEX
+                const AVIndexEntry *const e1 = ff_index_get_entry(sti1, i1, &tmp1); //PLEX
                 int64_t e1_pts = av_rescale_q(e1->timestamp, st1->time_base, AV_TIME_BASE_Q);
 
                 if (e1->size < (1 << 23))
                     skip = FFMAX(skip, e1->size);
 
-                for (; i2 < sti2->nb_index_entries; i2++) {
-                    const AVIndexEntry *const e2 = &sti2->index_entries[i2];
+                for (; i2 < nb2; i2++) {
+                    const AVIndexEntry *const e2 = ff_index_get_entry(sti2, i2, &tmp2); //PLEX
                     int64_t e2_pts = av_rescale_q(e2->timestamp, st2->time_base, AV_TIME_BASE_Q);
                     int64_t cur_delta;
                     if (e2_pts < e1_pts || e2_pts - (uint64_t)e1_pts < time_tolerance)
@@ -243,21 +276,29 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
 int av_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
 {
     const FFStream *const sti = ffstream(st);
+    //PLEX
+    if (sti->packed_index)
+        return ff_packed_index_search(sti->packed_index, wanted_timestamp, flags);
+    //PLEX
     return ff_index_search_timestamp(sti->index_entries, sti->nb_index_entries,
                                      wanted_timestamp, flags);
 }
 
 int avformat_index_get_entries_count(const AVStream *st)
 {
-    return cffstream(st)->nb_index_entries;
+    return ff_index_nb_entries(cffstream(st)); //PLEX
 }
 
 const AVIndexEntry *avformat_index_get_entry(AVStream *st, int idx)
 {
     const FFStream *const sti = ffstream(st);
-    if (idx < 0 || idx >= sti->nb_index_entries)
+    if (idx < 0 || idx >= ff_index_nb_entries(sti)) //PLEX
         return NULL;
 
+    //PLEX
+    if (sti->packed_index)
+        return ff_packed_index_entry(sti->packed_index, idx);
+    //PLEX
     return &sti->index_entries[idx];
 }
 
@@ -266,13 +307,15 @@ const AVIndexEntry *avformat_index_get_entry_from_timestamp(AVStream *st,
                                                             int flags)
 {
     const FFStream *const sti = ffstream(st);
-    int idx = ff_index_search_timestamp(sti->index_entries,
-                                        sti->nb_index_entries,
-                                        wanted_timestamp, flags);
+    int idx = av_index_search_timestamp(st, wanted_timestamp, flags); //PLEX
 
     if (idx < 0)
         return NULL;
 
+    //PLEX
+    if (sti->packed_index)
+        return ff_packed_index_entry(sti->packed_index, idx);
+    //PLEX
     return &sti->index_entries[idx];
 }
 
@@ -307,15 +350,16 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
 
     st  = s->streams[stream_index];
     sti = ffstream(st);
-    if (sti->index_entries) {
+    if (sti->index_entries || (sti->packed_index && ff_index_nb_entries(sti))) { //PLEX
         const AVIndexEntry *e;
+        AVIndexEntry tmp; //PLEX
 
         /* FIXME: Whole function must be checked for non-keyframe entries in
          * index case, especially read_timestamp(). */
         index = av_index_search_timestamp(st, target_ts,
                                           flags | AVSEEK_FLAG_BACKWARD);
         index = FFMAX(index, 0);
-        e     = &sti->index_entries[index];
+        e     = ff_index_get_entry(sti, index, &tmp); //PLEX
 
         if (e->timestamp <= target_ts || e->pos == e->min_distance) {
             pos_min = e->pos;
@@ -328,9 +372,9 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
 
         index = av_index_search_timestamp(st, target_ts,
                                           flags & ~AVSEEK_FLAG_BACKWARD);
-        av_assert0(index < sti->nb_index_entries);
+        av_assert0(index < ff_index_nb_entries(sti)); //PLEX
         if (index >= 0) {
-            e = &sti->index_entries[index];
+            e = ff_index_get_entry(sti, index, &tmp); //PLEX
             av_assert1(e->timestamp >= target_ts);
             pos_max   = e->pos;
             ts_max    = e->timestamp;
@@ -528,22 +572,23 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     AVStream *const st  = s->streams[stream_index];
     FFStream *const sti = ffstream(st);
     const AVIndexEntry *ie;
-    int index;
+    AVIndexEntry tmp; //PLEX
+    int index, nb_entries = ff_index_nb_entries(sti); //PLEX
     int64_t ret;
 
     index = av_index_search_timestamp(st, timestamp, flags);
 
-    if (index < 0 && sti->nb_index_entries &&
-        timestamp < sti->index_entries[0].timestamp)
+    if (index < 0 && nb_entries &&
+        timestamp < ff_index_get_entry(sti, 0, &tmp)->timestamp) //PLEX
         return -1;
 
-    if (index < 0 || index == sti->nb_index_entries - 1) {
+    if (index < 0 || index == nb_entries - 1) {
         AVPacket *const pkt = si->pkt;
         int nonkey = 0;
 
-        if (sti->nb_index_entries) {
-            av_assert0(sti->index_entries);
-            ie = &sti->index_entries[sti->nb_index_entries - 1];
+        if (nb_entries) {
+            av_assert0(sti->index_entries || sti->packed_index); //PLEX
+            ie = ff_index_get_entry(sti, nb_entries - 1, &tmp); //PLEX
             if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
                 return ret;
             s->io_repositioned = 1;
@@ -583,7 +628,7 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     if (s->iformat->read_seek)
         if (s->iformat->read_seek(s, stream_index, timestamp, flags) >= 0)
             return 0;
-    ie = &sti->index_entries[index];
+    ie = ff_index_get_entry(sti, index, &tmp); //PLEX
     if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
         return ret;
     s->io_repositioned = 1;
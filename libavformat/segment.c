@@ -29,8 +29,11 @@
 #include <time.h>
 
 #include "avformat.h"
+#include "avio_internal.h" //PLEX
 #include "internal.h"
 #include "mux.h"
+#include "url.h"
+#include "webvttenc.h" //PLEX
 
 #include "libavutil/avassert.h"
 #include "libavutil/internal.h"
@@ -39,10 +42,12 @@
 #include "libavutil/avstring.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/thread.h" //PLEX
 #include "libavutil/time.h"
 #include "libavutil/timecode.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/timestamp.h"
+#include "libavutil/tracepoint.h" //PLEX
 
 typedef struct SegmentListEntry {
     int index;
@@ -70,6 +75,29 @@ typedef enum {
 #define SEGMENT_LIST_FLAG_CACHE 1
 #define SEGMENT_LIST_FLAG_LIVE  2
 
+//PLEX
+/* One completed segment in the resume index. */
+typedef struct SegmentIndexEntry {
+    int index;
+    double start_time, end_time;
+    int64_t size;
+    int keyframe;             ///< whether the segment starts with a keyframe
+} SegmentIndexEntry;
+
+/* Work handed to the segment I/O thread, run in submission order. */
+typedef struct SegmentIOJob {
+    char *url;                ///< segment to upload, NULL for a list update
+    uint8_t *data;
+    int size;
+    SegmentListEntry entry;   ///< list entry snapshot for list updates
+    int complete, is_last;
+    int index_update;         ///< add index_entry to the resume index instead
+    SegmentIndexEntry index_entry;
+    int prewarm;              ///< prepare the next segment, url is its output or NULL
+    struct SegmentIOJob *next;
+} SegmentIOJob;
+//PLEX
+
 typedef struct SegmentContext {
     const AVClass *class;  /**< Class for private options. */
     int segment_idx;       ///< index of the segment file to write, starting from 0
@@ -135,6 +163,39 @@ typedef struct SegmentContext {
     int list_separate_times;    ///< PLEX
     int list_unfinished;     ///< PLEX
     int cur_list_size; ///< PLEX
+
+    //PLEX
+    int async_io;              ///< finish segments on a background thread
+    int64_t async_max_size;    ///< bound on the bytes queued for the thread
+    int pb_is_dyn;             ///< whether avf->pb is a dynamic buffer
+    AVDictionary *io_opts;     ///< protocol options for segment and list files
+    char *index_filename;      ///< resume index of the completed segments
+    int resume;                ///< skip segments the resume index has complete
+    SegmentIndexEntry *index_entries;   ///< written out, owned by the list writer
+    int nb_index_entries;
+    SegmentIndexEntry *resume_entries;  ///< as loaded on init, read-only
+    int nb_resume_entries;
+    int cur_keyframe;          ///< whether the current segment starts with a keyframe
+    int skipping;              ///< current segment already exists, avf->pb is a nullctx
+    int webvtt_reuse;          ///< keep one webvtt muxer for all the segments
+    int64_t prewarm;           ///< prepare the next segment this long before the cut
+    int prewarm_idx;           ///< segment_idx the next segment was prepared for, -1 if none
+    int prewarm_busy;          ///< a prewarm job is queued or running
+    AVFormatContext *prewarm_avf;  ///< muxer for the next segment
+    AVIOContext *prewarm_pb;   ///< output of the next segment, opened ahead
+    char *prewarm_url;         ///< file prewarm_pb writes to
+#if HAVE_THREADS
+    pthread_t io_thread;
+    pthread_mutex_t io_lock;
+    pthread_cond_t io_cond;
+    int io_thread_started;
+    SegmentIOJob *io_jobs, **io_jobs_tail;
+    int64_t io_queued;         ///< segment bytes not yet written out
+    int io_busy;
+    int io_exit;
+    int io_err;                ///< first error hit by the thread
+#endif
+    //PLEX
 } SegmentContext;
 
 static void print_csv_escaped_str(AVIOContext *ctx, const char *str)
@@ -153,17 +214,37 @@ static void print_csv_escaped_str(AVIOContext *ctx, const char *str)
         avio_w8(ctx, '"');
 }
 
-static int segment_mux_init(AVFormatContext *s)
+static int open_null_ctx(AVIOContext **ctx)
+{
+    int buf_size = 32768;
+    uint8_t *buf = av_malloc(buf_size);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    *ctx = avio_alloc_context(buf, buf_size, 1, NULL, NULL, NULL, NULL);
+    if (!*ctx) {
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static void close_null_ctxp(AVIOContext **pb)
+{
+    av_freep(&(*pb)->buffer);
+    avio_context_free(pb);
+}
+
+static int segment_mux_alloc(AVFormatContext *s, AVFormatContext **poc) //PLEX
 {
     SegmentContext *seg = s->priv_data;
     AVFormatContext *oc;
     int i;
     int ret;
 
-    ret = avformat_alloc_output_context2(&seg->avf, seg->oformat, NULL, NULL);
+    ret = avformat_alloc_output_context2(poc, seg->oformat, NULL, NULL); //PLEX
     if (ret < 0)
         return ret;
-    oc = seg->avf;
+    oc = *poc; //PLEX
 
     oc->interrupt_callback = s->interrupt_callback;
     oc->max_delay          = s->max_delay;
@@ -198,6 +279,15 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return 0;
 }
 
+//PLEX
+static int segment_mux_init(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+
+    return segment_mux_alloc(s, &seg->avf);
+}
+//PLEX
+
 static int set_segment_filename(AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
@@ -242,17 +332,275 @@ static int set_segment_filename(AVFormatContext *s)
     return 0;
 }
 
+//PLEX
+static int segment_io_open(AVFormatContext *s, AVIOContext **pb, const char *url)
+{
+    SegmentContext *seg = s->priv_data;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    av_dict_copy(&opts, seg->io_opts, 0);
+    ret = s->io_open(s, pb, url, AVIO_FLAG_WRITE, &opts);
+    av_dict_free(&opts);
+    return ret;
+}
+
+static SegmentIndexEntry *segment_index_find(SegmentIndexEntry *entries, int nb_entries,
+                                             int index)
+{
+    for (int i = 0; i < nb_entries; i++)
+        if (entries[i].index == index)
+            return &entries[i];
+    return NULL;
+}
+
+/* Whether the file exists with the size recorded when it was completed. */
+static int segment_file_complete(AVFormatContext *s, const char *url, int64_t size)
+{
+    AVIOContext *pb;
+    int64_t file_size;
+
+    if (s->io_open(s, &pb, url, AVIO_FLAG_READ, NULL) < 0)
+        return 0;
+    file_size = avio_size(pb);
+    ff_format_io_close(s, &pb);
+    return file_size == size;
+}
+
+static int segment_index_load(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    AVIOContext *pb;
+    char line[256];
+    int ret;
+
+    if (s->io_open(s, &pb, seg->index_filename, AVIO_FLAG_READ, NULL) < 0)
+        return 0;
+
+    while (ff_get_line(pb, line, sizeof(line)) > 0) {
+        SegmentIndexEntry e, *entries;
+
+        if (line[0] == '#' ||
+            sscanf(line, "%d,%lf,%lf,%"SCNd64",%d", &e.index, &e.start_time,
+                   &e.end_time, &e.size, &e.keyframe) != 5)
+            continue;
+
+        entries = av_realloc_array(seg->resume_entries, seg->nb_resume_entries + 1,
+                                   sizeof(*entries));
+        if (!entries) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        seg->resume_entries = entries;
+        seg->resume_entries[seg->nb_resume_entries++] = e;
+    }
+
+    /* Entries of segments that are not rewritten stay in the index. */
+    seg->index_entries = av_memdup(seg->resume_entries,
+                                   seg->nb_resume_entries * sizeof(*seg->resume_entries));
+    if (seg->nb_resume_entries && !seg->index_entries) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    seg->nb_index_entries = seg->nb_resume_entries;
+    ret = 0;
+
+end:
+    ff_format_io_close(s, &pb);
+    return ret;
+}
+
+/* Log where a restarted transcode has to resume, i.e. the first segment
+ * from the start number on that is not complete yet. */
+static void segment_index_log_resume(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    int index = seg->segment_idx + seg->segment_idx_wrap * seg->segment_idx_wrap_nb;
+    double start_time = -1;
+    char buf[1024];
+    SegmentIndexEntry *e;
+
+    while ((e = segment_index_find(seg->resume_entries, seg->nb_resume_entries, index)) &&
+           av_get_frame_filename(buf, sizeof(buf), s->url, index) >= 0 &&
+           segment_file_complete(s, buf, e->size)) {
+        start_time = e->end_time;
+        index++;
+    }
+
+    if (start_time >= 0)
+        av_log(s, AV_LOG_INFO, "Resume index: first missing segment %d starts at %f\n",
+               index, start_time);
+}
+
+static int segment_index_write(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    const char *proto = avio_find_protocol_name(seg->index_filename);
+    int use_rename = proto && !strcmp(proto, "file");
+    char temp_filename[1024];
+    AVIOContext *pb;
+    int ret;
+
+    snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s",
+             seg->index_filename);
+    if ((ret = segment_io_open(s, &pb, temp_filename)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to open segment index '%s'\n", temp_filename);
+        return ret;
+    }
+
+    avio_printf(pb, "#index,start_time,end_time,size,keyframe\n");
+    for (int i = 0; i < seg->nb_index_entries; i++) {
+        const SegmentIndexEntry *e = &seg->index_entries[i];
+        avio_printf(pb, "%d,%f,%f,%"PRId64",%d\n",
+                    e->index, e->start_time, e->end_time, e->size, e->keyframe);
+    }
+    if ((ret = ff_format_io_close(s, &pb)) < 0)
+        return ret;
+
+    return use_rename ? ff_rename(temp_filename, seg->index_filename, s) : 0;
+}
+
+static int segment_index_update(AVFormatContext *s, const SegmentIndexEntry *entry)
+{
+    SegmentContext *seg = s->priv_data;
+    SegmentIndexEntry *e = segment_index_find(seg->index_entries, seg->nb_index_entries,
+                                              entry->index);
+
+    if (!e) {
+        e = av_realloc_array(seg->index_entries, seg->nb_index_entries + 1,
+                             sizeof(*e));
+        if (!e)
+            return AVERROR(ENOMEM);
+        seg->index_entries = e;
+        e = &seg->index_entries[seg->nb_index_entries++];
+    }
+    *e = *entry;
+
+    return segment_index_write(s);
+}
+
+/* Whether the prewarm also prepares the muxer, not just the output. */
+static int segment_prewarm_mux(SegmentContext *seg)
+{
+    return seg->individual_header_trailer && !seg->webvtt_reuse && !seg->increment_tc;
+}
+
+/* Prepare the muxer and the output of the next segment, so that the cut
+ * only has to swap them in. A failure here is not fatal, the cut then
+ * does the work itself. Takes ownership of url. */
+static void segment_prewarm_run(AVFormatContext *s, char *url)
+{
+    SegmentContext *seg = s->priv_data;
+    AVFormatContext *oc = NULL;
+    AVIOContext *pb = NULL;
+    int ret = 0;
+
+    if (segment_prewarm_mux(seg))
+        ret = segment_mux_alloc(s, &oc);
+    /* never truncate a file early, only create new ones */
+    if (url && avio_check(url, 0) >= 0)
+        av_freep(&url);
+    if (ret >= 0 && url)
+        ret = segment_io_open(s, &pb, url);
+    if (ret < 0) {
+        av_log(s, AV_LOG_VERBOSE, "Could not prepare the next segment ahead of time\n");
+        avformat_free_context(oc);
+        oc = NULL;
+        av_freep(&url);
+    }
+
+    seg->prewarm_avf = oc;
+    seg->prewarm_pb  = pb;
+    seg->prewarm_url = url;
+}
+
+static void segment_prewarm_wait(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    SegmentContext *seg = s->priv_data;
+
+    if (!seg->io_thread_started)
+        return;
+    pthread_mutex_lock(&seg->io_lock);
+    while (seg->prewarm_busy)
+        pthread_cond_wait(&seg->io_cond, &seg->io_lock);
+    pthread_mutex_unlock(&seg->io_lock);
+#endif
+}
+
+/* Drop whatever was prepared and not used, including an output file
+ * that was created for nothing. */
+static void segment_prewarm_discard(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+
+    segment_prewarm_wait(s);
+    if (seg->prewarm_pb) {
+        ff_format_io_close(s, &seg->prewarm_pb);
+        ffurl_delete(seg->prewarm_url);
+    }
+    avformat_free_context(seg->prewarm_avf);
+    seg->prewarm_avf = NULL;
+    av_freep(&seg->prewarm_url);
+    seg->prewarm_idx = -1;
+}
+
+/* Open the output of the current segment. With async_io the segment is
+ * muxed into memory and written out by the I/O thread once it ends. */
+static int segment_open_pb(AVFormatContext *s, AVFormatContext *oc)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    segment_prewarm_wait(s);
+    if (seg->prewarm_pb && !strcmp(seg->prewarm_url, oc->url)) {
+        oc->pb = seg->prewarm_pb;
+        seg->prewarm_pb = NULL;
+    }
+    segment_prewarm_discard(s);
+    if (oc->pb)
+        return 0;
+
+    if (seg->resume) {
+        int index = seg->segment_idx + seg->segment_idx_wrap * seg->segment_idx_wrap_nb;
+        SegmentIndexEntry *e = segment_index_find(seg->resume_entries,
+                                                  seg->nb_resume_entries, index);
+
+        if (e && segment_file_complete(s, oc->url, e->size)) {
+            av_log(s, AV_LOG_VERBOSE, "Segment '%s' is already complete, skipping it\n",
+                   oc->url);
+            if ((ret = open_null_ctx(&oc->pb)) < 0)
+                return ret;
+            seg->skipping = 1;
+            return 0;
+        }
+    }
+
+    if (seg->async_io) {
+        if ((ret = avio_open_dyn_buf(&oc->pb)) < 0)
+            return ret;
+        seg->pb_is_dyn = 1;
+        return 0;
+    }
+    return segment_io_open(s, &oc->pb, oc->url);
+}
+//PLEX
+
 static int segment_start(AVFormatContext *s, int write_header)
 {
     SegmentContext *seg = s->priv_data;
     AVFormatContext *oc = seg->avf;
     int err = 0;
 
-    if (write_header) {
+    if (write_header && !seg->webvtt_reuse) { //PLEX
         avformat_free_context(oc);
-        seg->avf = NULL;
-        if ((err = segment_mux_init(s)) < 0)
+        //PLEX
+        segment_prewarm_wait(s);
+        seg->avf = seg->prewarm_avf;
+        seg->prewarm_avf = NULL;
+        if (!seg->avf && (err = segment_mux_init(s)) < 0)
             return err;
+        //PLEX
         oc = seg->avf;
     }
 
@@ -263,16 +611,28 @@ static int segment_start(AVFormatContext *s, int write_header)
     if ((err = set_segment_filename(s)) < 0)
         return err;
 
-    if ((err = s->io_open(s, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0) {
+    if ((err = segment_open_pb(s, oc)) < 0) { //PLEX
         av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
         return err;
     }
+    FF_TRACE2(segment_open, oc->url, seg->segment_idx); //PLEX
     if (!seg->individual_header_trailer)
         oc->pb->seekable = 0;
 
     if (oc->oformat->priv_class && oc->priv_data)
         av_opt_set(oc->priv_data, "mpegts_flags", "+resend_headers", 0);
 
+    //PLEX
+#if CONFIG_WEBVTT_MUXER
+    if (write_header && seg->webvtt_reuse) {
+        err = ff_webvtt_write_segment_header(oc);
+        if (err < 0)
+            return err;
+        write_header = 0;
+    }
+#endif
+    //PLEX
+
     if (write_header) {
         AVDictionary *options = NULL;
         av_dict_copy(&options, seg->format_options, 0);
@@ -293,7 +653,7 @@ static int segment_list_open(AVFormatContext *s)
     int ret;
 
     snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename), seg->use_rename ? "%s.tmp" : "%s", seg->list);
-    ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
+    ret = segment_io_open(s, &seg->list_pb, seg->temp_list_filename); //PLEX
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
         return ret;
@@ -364,7 +724,8 @@ static void segment_list_print_entry(AVIOContext      *list_ioctx,
     }
 }
 
-static int segment_write_list(AVFormatContext *s, int complete, int is_last)
+static int segment_write_list_entry(AVFormatContext *s, const SegmentListEntry *cur, //PLEX
+                                    int complete, int is_last)
 {
     SegmentContext *seg = s->priv_data;
     if (seg->list) {
@@ -391,7 +752,7 @@ static int segment_write_list(AVFormatContext *s, int complete, int is_last)
 
 
             /* append new element */
-            memcpy(entry, &seg->cur_entry, sizeof(*entry));
+            memcpy(entry, cur, sizeof(*entry)); //PLEX
             entry->filename = av_strdup(entry->filename);
             if (!seg->segment_list_entries)
                 seg->segment_list_entries = seg->segment_list_entries_end = entry;
@@ -427,7 +788,7 @@ static int segment_write_list(AVFormatContext *s, int complete, int is_last)
             if (seg->use_rename)
                 ff_rename(seg->temp_list_filename, seg->list, s);
         } else {
-            segment_list_print_entry(seg->list_pb, seg->list_type, seg->list_separate_times, !complete, &seg->cur_entry, s);
+            segment_list_print_entry(seg->list_pb, seg->list_type, seg->list_separate_times, !complete, cur, s); //PLEX
             avio_flush(seg->list_pb);
         }
     }
@@ -435,6 +796,306 @@ static int segment_write_list(AVFormatContext *s, int complete, int is_last)
     return 0;
 }
 
+//PLEX
+#if HAVE_THREADS
+static void segment_io_job_free(SegmentIOJob **pjob)
+{
+    SegmentIOJob *job = *pjob;
+
+    if (!job)
+        return;
+    av_freep(&job->url);
+    av_freep(&job->data);
+    av_freep(&job->entry.filename);
+    av_freep(pjob);
+}
+
+static int segment_io_job_run(AVFormatContext *s, SegmentIOJob *job)
+{
+    AVIOContext *pb = NULL;
+    int ret;
+
+    if (job->prewarm) {
+        segment_prewarm_run(s, job->url);
+        job->url = NULL;
+        return 0;
+    }
+    if (job->index_update)
+        return segment_index_update(s, &job->index_entry);
+    if (!job->url)
+        return segment_write_list_entry(s, &job->entry, job->complete, job->is_last);
+
+    if ((ret = segment_io_open(s, &pb, job->url)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", job->url);
+        return ret;
+    }
+    avio_write(pb, job->data, job->size);
+    avio_flush(pb);
+    ret = pb->error;
+    if (ff_format_io_close(s, &pb) < 0 && !ret)
+        ret = AVERROR(EIO);
+    if (ret < 0)
+        av_log(s, AV_LOG_ERROR, "Failed to write segment '%s'\n", job->url);
+    return ret;
+}
+
+static void *segment_io_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    SegmentContext *seg = s->priv_data;
+
+    pthread_mutex_lock(&seg->io_lock);
+    for (;;) {
+        SegmentIOJob *job;
+        int ret;
+
+        while (!seg->io_jobs && !seg->io_exit)
+            pthread_cond_wait(&seg->io_cond, &seg->io_lock);
+        if (!seg->io_jobs)
+            break;
+
+        job = seg->io_jobs;
+        seg->io_jobs = job->next;
+        if (!seg->io_jobs)
+            seg->io_jobs_tail = &seg->io_jobs;
+        seg->io_busy = 1;
+        pthread_mutex_unlock(&seg->io_lock);
+
+        /* Keep going after an error so the list stays consistent with
+         * whatever did make it out; the error is reported to the muxer. */
+        ret = segment_io_job_run(s, job);
+
+        pthread_mutex_lock(&seg->io_lock);
+        if (ret < 0 && !seg->io_err)
+            seg->io_err = ret;
+        seg->io_queued -= job->size;
+        seg->io_busy = 0;
+        if (job->prewarm)
+            seg->prewarm_busy = 0;
+        pthread_cond_broadcast(&seg->io_cond);
+        segment_io_job_free(&job);
+    }
+    pthread_mutex_unlock(&seg->io_lock);
+
+    return NULL;
+}
+
+static int segment_io_start(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    seg->io_jobs_tail = &seg->io_jobs;
+    if ((ret = pthread_mutex_init(&seg->io_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&seg->io_cond, NULL))) {
+        pthread_mutex_destroy(&seg->io_lock);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_create(&seg->io_thread, NULL, segment_io_thread, s))) {
+        pthread_cond_destroy(&seg->io_cond);
+        pthread_mutex_destroy(&seg->io_lock);
+        return AVERROR(ret);
+    }
+    seg->io_thread_started = 1;
+    return 0;
+}
+
+static void segment_io_stop(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+
+    if (!seg->io_thread_started)
+        return;
+
+    pthread_mutex_lock(&seg->io_lock);
+    /* Whatever is still queued here was abandoned by a failing muxer. */
+    while (seg->io_jobs) {
+        SegmentIOJob *job = seg->io_jobs;
+        seg->io_jobs = job->next;
+        segment_io_job_free(&job);
+    }
+    seg->prewarm_busy = 0;
+    seg->io_exit = 1;
+    pthread_cond_broadcast(&seg->io_cond);
+    pthread_mutex_unlock(&seg->io_lock);
+
+    pthread_join(seg->io_thread, NULL);
+    pthread_cond_destroy(&seg->io_cond);
+    pthread_mutex_destroy(&seg->io_lock);
+    seg->io_thread_started = 0;
+}
+
+/* Queue a job, waiting while too much segment data is already pending.
+ * Takes ownership of the job and reports errors hit by earlier jobs. */
+static int segment_io_submit(AVFormatContext *s, SegmentIOJob *job)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    pthread_mutex_lock(&seg->io_lock);
+    while (!seg->io_err && seg->io_queued &&
+           seg->io_queued + job->size > seg->async_max_size)
+        pthread_cond_wait(&seg->io_cond, &seg->io_lock);
+    ret = seg->io_err;
+    if (!ret) {
+        seg->io_queued    += job->size;
+        *seg->io_jobs_tail = job;
+        seg->io_jobs_tail  = &job->next;
+        pthread_cond_broadcast(&seg->io_cond);
+        job = NULL;
+    }
+    pthread_mutex_unlock(&seg->io_lock);
+
+    segment_io_job_free(&job);
+    return ret;
+}
+
+/* Wait for all queued work to be written out. */
+static int segment_io_drain(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    pthread_mutex_lock(&seg->io_lock);
+    while (seg->io_jobs || seg->io_busy)
+        pthread_cond_wait(&seg->io_cond, &seg->io_lock);
+    ret = seg->io_err;
+    pthread_mutex_unlock(&seg->io_lock);
+
+    return ret;
+}
+
+/* Hand the finished in-memory segment over to the I/O thread. */
+static int segment_io_submit_segment(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    AVFormatContext *oc = seg->avf;
+    SegmentIOJob *job = av_mallocz(sizeof(*job));
+
+    if (!job || !(job->url = av_strdup(oc->url))) {
+        ffio_free_dyn_buf(&oc->pb);
+        seg->pb_is_dyn = 0;
+        av_free(job);
+        return AVERROR(ENOMEM);
+    }
+    job->size = avio_close_dyn_buf(oc->pb, &job->data);
+    oc->pb = NULL;
+    seg->pb_is_dyn = 0;
+    if (!job->data) {
+        segment_io_job_free(&job);
+        return AVERROR(ENOMEM);
+    }
+
+    return segment_io_submit(s, job);
+}
+#endif
+
+//PLEX
+/* Have the next segment prepared ahead of its cut, on the I/O thread when
+ * there is one. The output is opened ahead only when it is a new local
+ * file whose name is already known and which is written directly. */
+static int segment_prewarm_start(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    const char *proto = avio_find_protocol_name(s->url);
+    char buf[1024], *url = NULL;
+
+    seg->prewarm_idx = seg->segment_idx;
+    if (!seg->async_io && !seg->resume && !seg->use_strftime && !seg->segment_idx_wrap &&
+        proto && !strcmp(proto, "file") &&
+        av_get_frame_filename(buf, sizeof(buf), s->url, seg->segment_idx + 1) >= 0 &&
+        !(url = av_strdup(buf)))
+        return AVERROR(ENOMEM);
+    if (!url && !segment_prewarm_mux(seg))
+        return 0;
+
+#if HAVE_THREADS
+    if (seg->io_thread_started) {
+        SegmentIOJob *job = av_mallocz(sizeof(*job));
+        int ret;
+
+        if (!job) {
+            av_free(url);
+            return AVERROR(ENOMEM);
+        }
+        job->prewarm = 1;
+        job->url     = url;
+
+        pthread_mutex_lock(&seg->io_lock);
+        seg->prewarm_busy = 1;
+        pthread_mutex_unlock(&seg->io_lock);
+        if ((ret = segment_io_submit(s, job)) < 0) {
+            pthread_mutex_lock(&seg->io_lock);
+            seg->prewarm_busy = 0;
+            pthread_mutex_unlock(&seg->io_lock);
+        }
+        return ret;
+    }
+#endif
+
+    segment_prewarm_run(s, url);
+    return 0;
+}
+//PLEX
+
+static int segment_write_list(AVFormatContext *s, int complete, int is_last)
+{
+    SegmentContext *seg = s->priv_data;
+
+#if HAVE_THREADS
+    if (seg->async_io) {
+        SegmentIOJob *job;
+
+        if (!seg->list)
+            return 0;
+        job = av_mallocz(sizeof(*job));
+        if (!job)
+            return AVERROR(ENOMEM);
+        job->entry          = seg->cur_entry;
+        job->entry.filename = av_strdup(seg->cur_entry.filename);
+        job->entry.next     = NULL;
+        job->complete       = complete;
+        job->is_last        = is_last;
+        if (!job->entry.filename) {
+            av_free(job);
+            return AVERROR(ENOMEM);
+        }
+        return segment_io_submit(s, job);
+    }
+#endif
+
+    return segment_write_list_entry(s, &seg->cur_entry, complete, is_last);
+}
+
+/* Add the segment that just ended to the resume index, after its data. */
+static int segment_index_add(AVFormatContext *s, int64_t size)
+{
+    SegmentContext *seg = s->priv_data;
+    SegmentIndexEntry entry = {
+        .index      = seg->cur_entry.index,
+        .start_time = seg->cur_entry.start_time,
+        .end_time   = seg->cur_entry.end_time,
+        .size       = size,
+        .keyframe   = seg->cur_keyframe,
+    };
+
+#if HAVE_THREADS
+    if (seg->async_io) {
+        SegmentIOJob *job = av_mallocz(sizeof(*job));
+
+        if (!job)
+            return AVERROR(ENOMEM);
+        job->index_update = 1;
+        job->index_entry  = entry;
+        return segment_io_submit(s, job);
+    }
+#endif
+
+    return segment_index_update(s, &entry);
+}
+//PLEX
+
 static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
 {
     SegmentContext *seg = s->priv_data;
@@ -446,23 +1107,40 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     char buf[AV_TIMECODE_STR_SIZE];
     int i;
     int err;
+    int64_t size; //PLEX
 
     if (!oc || !oc->pb)
         return AVERROR(EINVAL);
 
     av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
-    if (write_trailer)
+    if (write_trailer && (is_last || !seg->webvtt_reuse)) //PLEX
         ret = av_write_trailer(oc);
 
     if (ret < 0)
         av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
                oc->url);
 
+    //PLEX
+    avio_flush(oc->pb);
+    if ((size = avio_size(oc->pb)) < 0)
+        size = avio_tell(oc->pb);
+    FF_TRACE3(segment_close, oc->url, seg->segment_idx, size); //PLEX
+    //PLEX
+
+    //PLEX
+#if HAVE_THREADS
+    /* The segment is queued ahead of its list entry, so the list never
+     * references data that has not been written out yet. */
+    if (seg->pb_is_dyn && (ret = segment_io_submit_segment(s)) < 0)
+        goto end;
+#endif
+    //PLEX
+
     if ((ret = segment_write_list(s, 1, is_last)) < 0)
         goto end;
 
-    av_log(s, AV_LOG_VERBOSE, "segment:'%s' count:%d ended\n",
-           seg->avf->url, seg->segment_count);
+    av_log(s, AV_LOG_VERBOSE, "segment:'%s' count:%d %s\n",
+           seg->avf->url, seg->segment_count, seg->async_io ? "queued" : "ended"); //PLEX
     seg->segment_count++;
 
     if (seg->increment_tc) {
@@ -505,7 +1183,20 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     }
 
 end:
-    ff_format_io_close(oc, &oc->pb);
+    //PLEX
+    if (seg->pb_is_dyn) {
+        ffio_free_dyn_buf(&oc->pb);
+        seg->pb_is_dyn = 0;
+    }
+    if (seg->skipping) {
+        close_null_ctxp(&oc->pb);
+        seg->skipping = 0;
+    } else {
+        ff_format_io_close(oc, &oc->pb);
+        if (ret >= 0 && seg->index_filename)
+            ret = segment_index_add(s, size);
+    }
+    //PLEX
 
     return ret;
 }
@@ -619,26 +1310,6 @@ static int parse_frames(void *log_ctx, int **frames, int *nb_frames,
     return 0;
 }
 
-static int open_null_ctx(AVIOContext **ctx)
-{
-    int buf_size = 32768;
-    uint8_t *buf = av_malloc(buf_size);
-    if (!buf)
-        return AVERROR(ENOMEM);
-    *ctx = avio_alloc_context(buf, buf_size, 1, NULL, NULL, NULL, NULL);
-    if (!*ctx) {
-        av_free(buf);
-        return AVERROR(ENOMEM);
-    }
-    return 0;
-}
-
-static void close_null_ctxp(AVIOContext **pb)
-{
-    av_freep(&(*pb)->buffer);
-    avio_context_free(pb);
-}
-
 static int select_reference_stream(AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
@@ -701,10 +1372,18 @@ static void seg_free(AVFormatContext *s)
     SegmentContext *seg = s->priv_data;
     SegmentListEntry *cur;
 
+#if HAVE_THREADS
+    segment_io_stop(s); //PLEX
+#endif
+    segment_prewarm_discard(s); //PLEX
     ff_format_io_close(s, &seg->list_pb);
     if (seg->avf) {
         if (seg->is_nullctx)
             close_null_ctxp(&seg->avf->pb);
+        else if (seg->pb_is_dyn) //PLEX
+            ffio_free_dyn_buf(&seg->avf->pb);
+        else if (seg->skipping && seg->avf->pb) //PLEX
+            close_null_ctxp(&seg->avf->pb);
         else
             ff_format_io_close(s, &seg->avf->pb);
         avformat_free_context(seg->avf);
@@ -713,6 +1392,8 @@ static void seg_free(AVFormatContext *s)
     av_freep(&seg->times);
     av_freep(&seg->frames);
     av_freep(&seg->cur_entry.filename);
+    av_freep(&seg->index_entries); //PLEX
+    av_freep(&seg->resume_entries); //PLEX
 
     cur = seg->segment_list_entries;
     while (cur) {
@@ -801,6 +1482,33 @@ static int seg_init(AVFormatContext *s)
     if (seg->list_type == LIST_TYPE_EXT)
         av_log(s, AV_LOG_WARNING, "'ext' list type option is deprecated in favor of 'csv'\n");
 
+    //PLEX
+    if (seg->resume && !seg->index_filename) {
+        av_log(s, AV_LOG_ERROR, "segment_resume requires segment_index\n");
+        return AVERROR(EINVAL);
+    }
+    if (seg->resume) {
+        if ((ret = segment_index_load(s)) < 0)
+            return ret;
+        segment_index_log_resume(s);
+    }
+
+    seg->prewarm_idx = -1;
+    if (seg->async_io) {
+#if HAVE_THREADS
+        if ((ret = segment_io_start(s)) < 0)
+            return ret;
+#else
+        av_log(s, AV_LOG_ERROR, "segment_async_io requires threading support\n");
+        return AVERROR(ENOSYS);
+#endif
+    }
+#if HAVE_THREADS
+    else if (seg->prewarm && (ret = segment_io_start(s)) < 0)
+        return ret;
+#endif
+    //PLEX
+
     if ((ret = select_reference_stream(s)) < 0)
         return ret;
     av_log(s, AV_LOG_VERBOSE, "Selected stream id:%d type:%s\n",
@@ -819,6 +1527,15 @@ static int seg_init(AVFormatContext *s)
         return AVERROR(EINVAL);
     }
 
+    //PLEX
+#if CONFIG_WEBVTT_MUXER
+    /* webvtt keeps no state between cues, so one muxer serves all the
+     * segments as long as the timestamps keep increasing */
+    seg->webvtt_reuse = !strcmp(seg->oformat->name, "webvtt") &&
+                        seg->individual_header_trailer && !seg->reset_timestamps;
+#endif
+    //PLEX
+
     if ((ret = segment_mux_init(s)) < 0)
         return ret;
 
@@ -827,12 +1544,18 @@ static int seg_init(AVFormatContext *s)
     oc = seg->avf;
 
     if (seg->write_header_trailer) {
-        if ((ret = s->io_open(s, &oc->pb,
-                              seg->header_filename ? seg->header_filename : oc->url,
-                              AVIO_FLAG_WRITE, NULL)) < 0) {
+        if (seg->header_filename)
+            ret = segment_io_open(s, &oc->pb, seg->header_filename);
+        else
+            ret = segment_open_pb(s, oc); //PLEX
+        if (ret < 0) {
             av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
             return ret;
         }
+        //PLEX
+        if (!seg->header_filename)
+            FF_TRACE2(segment_open, oc->url, seg->segment_idx);
+        //PLEX
         if (!seg->individual_header_trailer)
             oc->pb->seekable = 0;
     } else {
@@ -897,8 +1620,9 @@ static int seg_write_header(AVFormatContext *s)
             close_null_ctxp(&oc->pb);
             seg->is_nullctx = 0;
         }
-        if ((ret = oc->io_open(oc, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0)
+        if ((ret = segment_open_pb(s, oc)) < 0) //PLEX
             return ret;
+        FF_TRACE2(segment_open, oc->url, seg->segment_idx); //PLEX
         if (!seg->individual_header_trailer)
             oc->pb->seekable = 0;
     }
@@ -990,6 +1714,16 @@ calc_times:
     if (pkt->pts != AV_NOPTS_VALUE)
         pkt_pts_avtb = av_rescale_q(pkt->pts, st->time_base, AV_TIME_BASE_Q);
 
+    //PLEX
+    if (seg->prewarm && pkt->stream_index == seg->reference_stream_index &&
+        seg->prewarm_idx != seg->segment_idx && end_pts != INT64_MAX &&
+        pkt->pts != AV_NOPTS_VALUE &&
+        av_compare_ts(pkt->pts, st->time_base,
+                      end_pts - seg->time_delta - seg->prewarm, AV_TIME_BASE_Q) >= 0 &&
+        (ret = segment_prewarm_start(s)) < 0)
+        goto fail;
+    //PLEX
+
     if (pkt->stream_index == seg->reference_stream_index &&
         (pkt->flags & AV_PKT_FLAG_KEY || seg->break_non_keyframes) &&
         (seg->segment_frame_count > 0 || seg->write_empty) &&
@@ -1033,6 +1767,9 @@ calc_times:
         seg->cur_entry.last_duration = pkt->duration;
     }
 
+    if (seg->segment_frame_count == 0 && pkt->stream_index == seg->reference_stream_index) //PLEX
+        seg->cur_keyframe = !!(pkt->flags & AV_PKT_FLAG_KEY);
+
     if (seg->segment_frame_count == 0) {
         av_log(s, AV_LOG_VERBOSE, "segment:'%s' starts with packet stream:%d pts:%s pts_time:%s frame:%d\n",
                seg->avf->url, pkt->stream_index,
@@ -1104,9 +1841,59 @@ static int seg_write_trailer(struct AVFormatContext *s)
     } else {
         ret = segment_end(s, 1, 1);
     }
+
+    //PLEX
+#if HAVE_THREADS
+    if (seg->io_thread_started) {
+        int err = segment_io_drain(s);
+        if (ret >= 0)
+            ret = err;
+    }
+#endif
+    //PLEX
     return ret;
 }
 
+//PLEX
+static int seg_restart(AVFormatContext *s, int segment, int query)
+{
+    SegmentContext *seg = s->priv_data;
+    int webvtt_reuse = seg->webvtt_reuse;
+    int ret;
+
+    /* the next segment needs a header of its own, and the cut points
+     * given as lists do not apply to a new timeline */
+    if (!seg->individual_header_trailer || seg->times || seg->frames ||
+        seg->segment_idx_wrap)
+        return AVERROR(ENOSYS);
+    if (query)
+        return 0;
+
+    /* the new timeline may go back in time, so start with a fresh muxer */
+    seg->webvtt_reuse = 0;
+    ret = segment_end(s, 1, 0);
+    if (ret >= 0) {
+        if (segment >= 0)
+            seg->segment_idx = segment - 1;
+        ret = segment_start(s, 1);
+    }
+    seg->webvtt_reuse = webvtt_reuse;
+    if (ret < 0)
+        return ret;
+
+    /* continue as if the output had been started at this segment */
+    seg->segment_count = seg->segment_copyts ? seg->segment_idx : 0;
+    seg->frame_count   = 0;
+    seg->cut_pending   = 0;
+    seg->reference_stream_first_pts = AV_NOPTS_VALUE;
+    memset(&seg->cur_entry, 0, sizeof(seg->cur_entry));
+    seg->cur_entry.index = seg->segment_idx;
+
+    av_log(s, AV_LOG_VERBOSE, "Output restarted at segment %d\n", seg->segment_idx);
+    return 0;
+}
+//PLEX
+
 static int seg_check_bitstream(AVFormatContext *s, AVStream *st,
                                const AVPacket *pkt)
 {
@@ -1175,6 +1962,12 @@ static const AVOption options[] = {
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
     { "write_empty_segments", "allow writing empty 'filler' segments", OFFSET(write_empty), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { "http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    { "segment_io_opts", "set protocol options for the segment and list files", OFFSET(io_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, E }, //PLEX
+    { "segment_index",     "set the resume index of the completed segments", OFFSET(index_filename), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, E }, //PLEX
+    { "segment_resume",    "do not rewrite segments the resume index lists as complete", OFFSET(resume), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E }, //PLEX
+    { "segment_async_io", "write finished segments and list updates on a background thread", OFFSET(async_io), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E }, //PLEX
+    { "segment_async_max_size", "set the maximum amount of segment data queued for writing", OFFSET(async_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 1, INT64_MAX, E }, //PLEX
+    { "segment_prewarm", "prepare the next segment this long before its expected start", OFFSET(prewarm), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, E }, //PLEX
     { NULL },
 };
 
@@ -1198,6 +1991,7 @@ const FFOutputFormat ff_segment_muxer = {
     .write_trailer  = seg_write_trailer,
     .deinit         = seg_free,
     .check_bitstream = seg_check_bitstream,
+    .restart        = seg_restart, //PLEX
 };
 #endif
 
@@ -1214,5 +2008,6 @@ const FFOutputFormat ff_stream_segment_muxer = {
     .write_trailer  = seg_write_trailer,
     .deinit         = seg_free,
     .check_bitstream = seg_check_bitstream,
+    .restart        = seg_restart, //PLEX
 };
 #endif
\ No newline at end of file
@@ -66,6 +66,7 @@ typedef struct IEC61937Context {
 
     const uint8_t *out_buf;         ///< pointer to the outgoing data before byte-swapping
     int out_bytes;                  ///< amount of outgoing bytes
+    int out_swapped;                ///< out_buf is already in output byte order //PLEX
 
     int use_preamble;               ///< preamble enabled (disabled for exactly pre-padded DTS)
     int extra_bswap;                ///< extra bswap for payload (for LE DTS => standard BE DTS)
@@ -108,6 +109,57 @@ static const AVClass spdif_class = {
     .version        = LIBAVUTIL_VERSION_INT,
 };
 
+//PLEX
+/**
+ * Whether the payload has to be byte swapped on output. Assembled bursts
+ * are stored swapped so that they can be written with no extra copy.
+ */
+static int spdif_need_swap(IEC61937Context *ctx)
+{
+    return !(ctx->extra_bswap ^ (ctx->spdif_flags & SPDIF_FLAG_BIGENDIAN));
+}
+
+/**
+ * Store len bytes of payload at byte offset pos of an assembly buffer, in
+ * output byte order. A final lone byte of an odd offset is completed with
+ * a zero byte, so the buffer needs one byte past the payload.
+ */
+static void spdif_put_payload(uint8_t *buf, int pos, const uint8_t *src,
+                              int len, int swap)
+{
+    int i;
+
+    if (!swap) {
+        memcpy(buf + pos, src, len);
+        return;
+    }
+    if ((pos & 1) && len) {
+        buf[pos - 1] = *src++;
+        pos++;
+        len--;
+    }
+    buf += pos;
+    for (i = 0; i + 1 < len; i += 2) {
+        buf[i]     = src[i + 1];
+        buf[i + 1] = src[i];
+    }
+    if (len & 1) {
+        buf[i]     = 0;
+        buf[i + 1] = src[i];
+    }
+}
+
+static void spdif_fill_payload(uint8_t *buf, int pos, int len, int swap)
+{
+    if (swap && (pos & 1) && len) {
+        buf[pos - 1] = 0;
+        pos++;
+        len--;
+    }
+    memset(buf + pos, 0, len + (swap && (len & 1)));
+}
+//PLEX
+
 static int spdif_header_ac3(AVFormatContext *s, AVPacket *pkt)
 {
     IEC61937Context *ctx = s->priv_data;
@@ -129,12 +181,13 @@ static int spdif_header_eac3(AVFormatContext *s, AVPacket *pkt)
     if (bsid > 10 && (pkt->data[4] & 0xc0) != 0xc0) /* fscod */
         repeat = eac3_repeat[(pkt->data[4] & 0x30) >> 4]; /* numblkscod */
 
-    tmp = av_fast_realloc(ctx->hd_buf[0], &ctx->hd_buf_size, ctx->hd_buf_filled + pkt->size);
+    tmp = av_fast_realloc(ctx->hd_buf[0], &ctx->hd_buf_size, ctx->hd_buf_filled + pkt->size + 1);
     if (!tmp)
         return AVERROR(ENOMEM);
     ctx->hd_buf[0] = tmp;
 
-    memcpy(&ctx->hd_buf[0][ctx->hd_buf_filled], pkt->data, pkt->size);
+    spdif_put_payload(ctx->hd_buf[0], ctx->hd_buf_filled, pkt->data, pkt->size,
+                      spdif_need_swap(ctx)); //PLEX
 
     ctx->hd_buf_filled += pkt->size;
     if (++ctx->hd_buf_count < repeat){
@@ -145,6 +198,7 @@ static int spdif_header_eac3(AVFormatContext *s, AVPacket *pkt)
     ctx->pkt_offset  = 24576;
     ctx->out_buf     = ctx->hd_buf[0];
     ctx->out_bytes   = ctx->hd_buf_filled;
+    ctx->out_swapped = 1; //PLEX
     ctx->length_code = ctx->hd_buf_filled;
 
     ctx->hd_buf_count  = 0;
@@ -236,15 +290,24 @@ static int spdif_header_dts4(AVFormatContext *s, AVPacket *pkt, int core_size,
      * with some receivers, but the exact requirement is unconfirmed. */
     ctx->length_code = FFALIGN(ctx->out_bytes + 0x8, 0x10) - 0x8;
 
-    av_fast_malloc(&ctx->hd_buf[0], &ctx->hd_buf_size, ctx->out_bytes);
+    av_fast_malloc(&ctx->hd_buf[0], &ctx->hd_buf_size, ctx->out_bytes + 1);
     if (!ctx->hd_buf[0])
         return AVERROR(ENOMEM);
 
-    ctx->out_buf = ctx->hd_buf[0];
+    ctx->out_buf     = ctx->hd_buf[0];
+    ctx->out_swapped = 1; //PLEX
 
-    memcpy(ctx->hd_buf[0], dtshd_start_code, sizeof(dtshd_start_code));
-    AV_WB16(ctx->hd_buf[0] + sizeof(dtshd_start_code), pkt_size);
-    memcpy(ctx->hd_buf[0] + sizeof(dtshd_start_code) + 2, pkt->data, pkt_size);
+    //PLEX
+    {
+        const int swap = spdif_need_swap(ctx);
+        uint8_t size[2];
+
+        AV_WB16(size, pkt_size);
+        spdif_put_payload(ctx->hd_buf[0], 0, dtshd_start_code, sizeof(dtshd_start_code), swap);
+        spdif_put_payload(ctx->hd_buf[0], sizeof(dtshd_start_code), size, 2, swap);
+        spdif_put_payload(ctx->hd_buf[0], sizeof(dtshd_start_code) + 2, pkt->data, pkt_size, swap);
+    }
+    //PLEX
 
     return 0;
 }
@@ -423,6 +486,7 @@ static int spdif_header_truehd(AVFormatContext *s, AVPacket *pkt)
 {
     IEC61937Context *ctx = s->priv_data;
     uint8_t *hd_buf = ctx->hd_buf[ctx->hd_buf_idx];
+    const int swap = spdif_need_swap(ctx); //PLEX
     int ratebits;
     int padding_remaining = 0;
     uint16_t input_timing;
@@ -494,8 +558,8 @@ static int spdif_header_truehd(AVFormatContext *s, AVPacket *pkt)
             /* time to insert MAT code */
             int code_len = mat_codes[next_code_idx].len;
             int code_len_remaining = code_len;
-            memcpy(hd_buf + mat_codes[next_code_idx].pos,
-                   mat_codes[next_code_idx].code, code_len);
+            spdif_put_payload(hd_buf, mat_codes[next_code_idx].pos,
+                              mat_codes[next_code_idx].code, code_len, swap); //PLEX
             ctx->hd_buf_filled += code_len;
 
             next_code_idx++;
@@ -529,7 +593,7 @@ static int spdif_header_truehd(AVFormatContext *s, AVPacket *pkt)
             int padding_to_insert = FFMIN(mat_codes[next_code_idx].pos - ctx->hd_buf_filled,
                                           padding_remaining);
 
-            memset(hd_buf + ctx->hd_buf_filled, 0, padding_to_insert);
+            spdif_fill_payload(hd_buf, ctx->hd_buf_filled, padding_to_insert, swap); //PLEX
             ctx->hd_buf_filled += padding_to_insert;
             padding_remaining -= padding_to_insert;
 
@@ -541,7 +605,7 @@ static int spdif_header_truehd(AVFormatContext *s, AVPacket *pkt)
             int data_to_insert = FFMIN(mat_codes[next_code_idx].pos - ctx->hd_buf_filled,
                                        data_remaining);
 
-            memcpy(hd_buf + ctx->hd_buf_filled, dataptr, data_to_insert);
+            spdif_put_payload(hd_buf, ctx->hd_buf_filled, dataptr, data_to_insert, swap); //PLEX
             ctx->hd_buf_filled += data_to_insert;
             dataptr += data_to_insert;
             data_remaining -= data_to_insert;
@@ -561,6 +625,7 @@ static int spdif_header_truehd(AVFormatContext *s, AVPacket *pkt)
 
     ctx->data_type   = IEC61937_TRUEHD;
     ctx->pkt_offset  = MAT_PKT_OFFSET;
+    ctx->out_swapped = 1; //PLEX
     ctx->out_bytes   = MAT_FRAME_SIZE;
     ctx->length_code = MAT_FRAME_SIZE;
     return 0;
@@ -632,6 +697,7 @@ static int spdif_write_packet(struct AVFormatContext *s, AVPacket *pkt)
     ctx->length_code = FFALIGN(pkt->size, 2) << 3;
     ctx->use_preamble = 1;
     ctx->extra_bswap = 0;
+    ctx->out_swapped = 0; //PLEX
 
     ret = ctx->header_info(s, pkt);
     if (ret < 0)
@@ -652,6 +718,12 @@ static int spdif_write_packet(struct AVFormatContext *s, AVPacket *pkt)
         spdif_put_16(ctx, s->pb, ctx->length_code);//Pd
     }
 
+    //PLEX
+    if (ctx->out_swapped) {
+        /* assembled bursts include the completed lone byte */
+        avio_write(s->pb, ctx->out_buf, FFALIGN(ctx->out_bytes, 2));
+    } else
+    //PLEX
     if (ctx->extra_bswap ^ (ctx->spdif_flags & SPDIF_FLAG_BIGENDIAN)) {
         avio_write(s->pb, ctx->out_buf, ctx->out_bytes & ~1);
     } else {
@@ -663,7 +735,7 @@ static int spdif_write_packet(struct AVFormatContext *s, AVPacket *pkt)
     }
 
     /* a final lone byte has to be MSB aligned */
-    if (ctx->out_bytes & 1)
+    if ((ctx->out_bytes & 1) && !ctx->out_swapped) //PLEX
         spdif_put_16(ctx, s->pb, ctx->out_buf[ctx->out_bytes - 1] << 8);
 
     ffio_fill(s->pb, 0, padding);
@@ -31,6 +31,19 @@
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if HAVE_WRITEV //PLEX
+#include <sys/uio.h>
+#endif
+#if HAVE_SENDFILE //PLEX
+#include <signal.h>
+#include <sys/sendfile.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#define tcp_sigmask pthread_sigmask
+#else
+#define tcp_sigmask sigprocmask
+#endif
+#endif
 
 typedef struct TCPContext {
     const AVClass *class;
@@ -313,6 +326,73 @@ static int tcp_write(URLContext *h, const uint8_t *buf, int size)
     return ret < 0 ? ff_neterrno() : ret;
 }
 
+//PLEX
+#if HAVE_WRITEV
+static int tcp_writev(URLContext *h, const URLWriteVec *vec, int nb_vec)
+{
+    TCPContext *s = h->priv_data;
+    struct iovec iov[URL_WRITEV_MAX];
+    struct msghdr msg = { 0 };
+    int ret;
+
+    if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+        ret = ff_network_wait_fd_timeout(s->fd, 1, h->rw_timeout, &h->interrupt_callback);
+        if (ret)
+            return ret;
+    }
+    for (int i = 0; i < nb_vec; i++) {
+        iov[i].iov_base = (void *)vec[i].data;
+        iov[i].iov_len  = vec[i].size;
+    }
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = nb_vec;
+    ret = sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+    return ret < 0 ? ff_neterrno() : ret;
+}
+#endif
+
+#if HAVE_SENDFILE
+/* Unlike send(), sendfile() has no MSG_NOSIGNAL, so SIGPIPE is blocked
+ * around it and the one raised for a peer that went away is consumed,
+ * leaving just the EPIPE error as with tcp_write(). */
+static int tcp_write_from_fd(URLContext *h, int fd, int64_t offset, int size)
+{
+    TCPContext *s = h->priv_data;
+    sigset_t pipe_set, old_set, pending;
+    off_t off = offset;
+    int was_pending, err;
+    ssize_t ret;
+
+    if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+        ret = ff_network_wait_fd_timeout(s->fd, 1, h->rw_timeout, &h->interrupt_callback);
+        if (ret)
+            return ret;
+    }
+
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    tcp_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+    was_pending = !sigpending(&pending) && sigismember(&pending, SIGPIPE);
+
+    ret = sendfile(s->fd, fd, &off, size);
+    err = errno;
+    if (ret < 0 && err == EPIPE && !was_pending) {
+        const struct timespec no_wait = { 0 };
+        while (sigtimedwait(&pipe_set, NULL, &no_wait) < 0 && errno == EINTR);
+    }
+    tcp_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    if (ret < 0) {
+        /* files sendfile() cannot read from */
+        if (err == EINVAL || err == ENOSYS)
+            return AVERROR(ENOSYS);
+        return AVERROR(err);
+    }
+    return ret;
+}
+#endif
+//PLEX
+
 static int tcp_shutdown(URLContext *h, int flags)
 {
     TCPContext *s = h->priv_data;
@@ -368,6 +448,12 @@ const URLProtocol ff_tcp_protocol = {
     .url_accept          = tcp_accept,
     .url_read            = tcp_read,
     .url_write           = tcp_write,
+#if HAVE_WRITEV //PLEX
+    .url_writev          = tcp_writev,
+#endif
+#if HAVE_SENDFILE //PLEX
+    .url_write_from_fd   = tcp_write_from_fd,
+#endif
     .url_close           = tcp_close,
     .url_get_file_handle = tcp_get_file_handle,
     .url_get_short_seek  = tcp_get_window_size,
@@ -48,8 +48,27 @@ typedef struct {
      * disabled output streams are set to -1 */
     int *stream_map;
     int header_written;
+
+    //PLEX
+    char **bsf_specs;    ///< filter list per stream, NULL for pass-through
+    int bsfs_shared;     ///< bsfs are owned by the tee chains
+    //PLEX
 } TeeSlave;
 
+//PLEX
+/**
+ * Filters run once on an input stream, their output is handed to every
+ * slave stream that asked for the same filter list.
+ */
+typedef struct TeeChain {
+    AVBSFContext *bsf;
+    char *spec;          ///< filter list, NULL for pass-through
+    unsigned stream;     ///< input stream index
+    unsigned *slaves;
+    int nb_slaves;
+} TeeChain;
+//PLEX
+
 typedef struct TeeContext {
     const AVClass *class;
     unsigned nb_slaves;
@@ -57,6 +76,11 @@ typedef struct TeeContext {
     TeeSlave *slaves;
     int use_fifo;
     AVDictionary *fifo_options;
+    //PLEX
+    TeeChain *chains;
+    int nb_chains;
+    AVPacket *bsf_pkt;   ///< packet going through a chain
+    //PLEX
 } TeeContext;
 
 static const char *const slave_delim     = "|";
@@ -129,10 +153,17 @@ static int close_slave(TeeSlave *tee_slave)
     if (tee_slave->header_written)
         ret = av_write_trailer(avf);
 
-    if (tee_slave->bsfs) {
+    if (tee_slave->bsfs && !tee_slave->bsfs_shared) { //PLEX
         for (i = 0; i < avf->nb_streams; ++i)
             av_bsf_free(&tee_slave->bsfs[i]);
     }
+    //PLEX
+    if (tee_slave->bsf_specs) {
+        for (i = 0; i < avf->nb_streams; ++i)
+            av_freep(&tee_slave->bsf_specs[i]);
+    }
+    av_freep(&tee_slave->bsf_specs);
+    //PLEX
     av_freep(&tee_slave->stream_map);
     av_freep(&tee_slave->bsfs);
 
@@ -142,6 +173,20 @@ static int close_slave(TeeSlave *tee_slave)
     return ret;
 }
 
+//PLEX
+static void free_chains(TeeContext *tee)
+{
+    for (int i = 0; i < tee->nb_chains; i++) {
+        av_bsf_free(&tee->chains[i].bsf);
+        av_freep(&tee->chains[i].spec);
+        av_freep(&tee->chains[i].slaves);
+    }
+    av_freep(&tee->chains);
+    tee->nb_chains = 0;
+    av_packet_free(&tee->bsf_pkt);
+}
+//PLEX
+
 static void close_slaves(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -151,6 +196,7 @@ static void close_slaves(AVFormatContext *avf)
         close_slave(&tee->slaves[i]);
     }
     av_freep(&tee->slaves);
+    free_chains(tee); //PLEX
 }
 
 static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
@@ -310,7 +356,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
     tee_slave->header_written = 1;
 
     tee_slave->bsfs = av_calloc(avf2->nb_streams, sizeof(*tee_slave->bsfs));
-    if (!tee_slave->bsfs) {
+    tee_slave->bsf_specs = av_calloc(avf2->nb_streams, sizeof(*tee_slave->bsf_specs)); //PLEX
+    if (!tee_slave->bsfs || !tee_slave->bsf_specs) { //PLEX
         ret = AVERROR(ENOMEM);
         goto end;
     }
@@ -354,6 +401,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
                            "stream %d of slave output '%s'\n", entry->value, i, filename);
                     goto end;
                 }
+                //PLEX
+                if (!(tee_slave->bsf_specs[i] = av_strdup(entry->value))) {
+                    ret = AVERROR(ENOMEM);
+                    goto end;
+                }
+                //PLEX
             }
         }
 
@@ -450,6 +503,65 @@ static int tee_process_slave_failure(AVFormatContext *avf, unsigned slave_idx, i
     }
 }
 
+//PLEX
+/* Use one filter instance for all the slave streams that apply the same
+ * filter list to an input stream, so it runs once per packet instead of
+ * once per slave. */
+static int share_bsfs(AVFormatContext *avf)
+{
+    TeeContext *tee = avf->priv_data;
+    unsigned i, s;
+
+    for (i = 0; i < tee->nb_slaves; i++) {
+        TeeSlave *slave = &tee->slaves[i];
+
+        if (!slave->avf)
+            continue;
+        slave->bsfs_shared = 1;
+        for (s = 0; s < avf->nb_streams; s++) {
+            int s2 = slave->stream_map[s], j;
+            char *spec;
+            TeeChain *chain;
+            unsigned *slaves;
+
+            if (s2 < 0)
+                continue;
+            spec = slave->bsf_specs[s2];
+            for (j = 0; j < tee->nb_chains; j++) {
+                chain = &tee->chains[j];
+                if (chain->stream == s && (spec ? chain->spec && !strcmp(chain->spec, spec)
+                                                : !chain->spec))
+                    break;
+            }
+
+            if (j == tee->nb_chains) {
+                chain = av_realloc_array(tee->chains, tee->nb_chains + 1, sizeof(*chain));
+                if (!chain)
+                    return AVERROR(ENOMEM);
+                tee->chains = chain;
+                chain = &tee->chains[tee->nb_chains++];
+                memset(chain, 0, sizeof(*chain));
+                chain->bsf    = slave->bsfs[s2];
+                chain->spec   = spec;
+                chain->stream = s;
+                slave->bsf_specs[s2] = NULL;
+            } else {
+                av_bsf_free(&slave->bsfs[s2]);
+                slave->bsfs[s2] = chain->bsf;
+            }
+
+            slaves = av_realloc_array(chain->slaves, chain->nb_slaves + 1, sizeof(*slaves));
+            if (!slaves)
+                return AVERROR(ENOMEM);
+            chain->slaves = slaves;
+            chain->slaves[chain->nb_slaves++] = i;
+        }
+    }
+
+    return 0;
+}
+//PLEX
+
 static int tee_write_header(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -496,6 +608,15 @@ static int tee_write_header(AVFormatContext *avf)
         av_freep(&slaves[i]);
     }
 
+    //PLEX
+    if (!(tee->bsf_pkt = av_packet_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = share_bsfs(avf)) < 0)
+        goto fail;
+    //PLEX
+
     for (i = 0; i < avf->nb_streams; i++) {
         int j, mapped = 0;
         for (j = 0; j < tee->nb_slaves; j++)
@@ -530,79 +651,141 @@ static int tee_write_trailer(AVFormatContext *avf)
         }
     }
     av_freep(&tee->slaves);
+    free_chains(tee); //PLEX
+    return ret_all;
+}
+
+//PLEX
+static int tee_fail_chain(AVFormatContext *avf, const TeeChain *chain, int err)
+{
+    TeeContext *tee = avf->priv_data;
+    int ret_all = 0, ret;
+
+    for (int k = 0; k < chain->nb_slaves; k++) {
+        if (!tee->slaves[chain->slaves[k]].avf)
+            continue;
+        ret = tee_process_slave_failure(avf, chain->slaves[k], err);
+        if (!ret_all && ret < 0)
+            ret_all = ret;
+    }
+    return ret_all;
+}
+
+/* Hand one filtered packet to every live slave of the chain. All but the
+ * last get a new reference, nothing is copied. */
+static int tee_write_chain_packet(AVFormatContext *avf, const TeeChain *chain,
+                                  AVPacket *pkt, AVPacket *pkt2)
+{
+    TeeContext *tee = avf->priv_data;
+    int ret_all = 0, ret, last = -1;
+
+    for (int k = 0; k < chain->nb_slaves; k++)
+        if (tee->slaves[chain->slaves[k]].avf)
+            last = k;
+
+    for (int k = 0; k <= last; k++) {
+        unsigned i = chain->slaves[k];
+        AVFormatContext *avf2 = tee->slaves[i].avf;
+        int s2;
+
+        if (!avf2)
+            continue;
+        s2 = tee->slaves[i].stream_map[chain->stream];
+
+        if (k == last) {
+            av_packet_move_ref(pkt2, pkt);
+        } else if ((ret = av_packet_ref(pkt2, pkt)) < 0) {
+            if (!ret_all)
+                ret_all = ret;
+            continue;
+        }
+        pkt2->stream_index = s2;
+        av_packet_rescale_ts(pkt2, chain->bsf->time_base_out,
+                             avf2->streams[s2]->time_base);
+        ret = av_interleaved_write_frame(avf2, pkt2);
+        if (ret < 0) {
+            ret = tee_process_slave_failure(avf, i, ret);
+            if (!ret_all && ret < 0)
+                ret_all = ret;
+        }
+    }
+    av_packet_unref(pkt);
     return ret_all;
 }
+//PLEX
 
 static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     TeeContext *tee = avf->priv_data;
     AVFormatContext *avf2;
-    AVBSFContext *bsfs;
     AVPacket *const pkt2 = ffformatcontext(avf)->pkt;
+    //PLEX
+    AVPacket *const pkt3 = tee->bsf_pkt;
     int ret_all = 0, ret;
-    unsigned i, s;
-    int s2;
-
-    for (i = 0; i < tee->nb_slaves; i++) {
-        if (!(avf2 = tee->slaves[i].avf))
-            continue;
+    unsigned i;
 
-        /* Flush slave if pkt is NULL*/
-        if (!pkt) {
+    /* Flush slave if pkt is NULL*/
+    if (!pkt) {
+        for (i = 0; i < tee->nb_slaves; i++) {
+            if (!(avf2 = tee->slaves[i].avf))
+                continue;
             ret = av_interleaved_write_frame(avf2, NULL);
             if (ret < 0) {
                 ret = tee_process_slave_failure(avf, i, ret);
                 if (!ret_all && ret < 0)
                     ret_all = ret;
             }
-            continue;
         }
+        return ret_all;
+    }
+
+    for (int c = 0; c < tee->nb_chains; c++) {
+        const TeeChain *chain = &tee->chains[c];
+        int alive = 0;
 
-        s = pkt->stream_index;
-        s2 = tee->slaves[i].stream_map[s];
-        if (s2 < 0)
+        if (chain->stream != pkt->stream_index)
+            continue;
+        for (int k = 0; k < chain->nb_slaves; k++)
+            alive |= !!tee->slaves[chain->slaves[k]].avf;
+        if (!alive)
             continue;
 
-        if ((ret = av_packet_ref(pkt2, pkt)) < 0) {
+        if ((ret = av_packet_ref(pkt3, pkt)) < 0) {
             if (!ret_all)
                 ret_all = ret;
             continue;
         }
-        bsfs = tee->slaves[i].bsfs[s2];
-        pkt2->stream_index = s2;
 
-        ret = av_bsf_send_packet(bsfs, pkt2);
+        ret = av_bsf_send_packet(chain->bsf, pkt3);
         if (ret < 0) {
-            av_packet_unref(pkt2);
+            av_packet_unref(pkt3);
             av_log(avf, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
                    av_err2str(ret));
-            ret = tee_process_slave_failure(avf, i, ret);
+            ret = tee_fail_chain(avf, chain, ret);
             if (!ret_all && ret < 0)
                 ret_all = ret;
+            continue;
         }
 
-        while(1) {
-            ret = av_bsf_receive_packet(bsfs, pkt2);
+        while (1) {
+            ret = av_bsf_receive_packet(chain->bsf, pkt3);
             if (ret == AVERROR(EAGAIN)) {
                 ret = 0;
                 break;
             } else if (ret < 0) {
+                ret = tee_fail_chain(avf, chain, ret);
                 break;
             }
 
-            av_packet_rescale_ts(pkt2, bsfs->time_base_out,
-                                 avf2->streams[s2]->time_base);
-            ret = av_interleaved_write_frame(avf2, pkt2);
+            ret = tee_write_chain_packet(avf, chain, pkt3, pkt2);
             if (ret < 0)
                 break;
-        };
-
-        if (ret < 0) {
-            ret = tee_process_slave_failure(avf, i, ret);
-            if (!ret_all && ret < 0)
-                ret_all = ret;
         }
+
+        if (!ret_all && ret < 0)
+            ret_all = ret;
     }
+    //PLEX
     return ret_all;
 }
 
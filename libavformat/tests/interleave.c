@@ -0,0 +1,136 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program feeds one video, several audio and many sparse subtitle
+ * streams through av_interleaved_write_frame() in bursts per stream, checks
+ * that the muxer receives them in dts order and reports the time taken.
+ * ./interleave [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/mathematics.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+#include "libavformat/mux.h"
+
+#define NB_AUDIO     8
+#define NB_SUBTITLE  16
+#define NB_STREAMS   (1 + NB_AUDIO + NB_SUBTITLE)
+#define BURST        2 /* seconds of one stream written at a time */
+
+static int64_t last_dts = INT64_MIN;
+static int nb_written, nb_errors;
+
+static int test_write_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    int64_t dts = av_rescale_q(pkt->dts, s->streams[pkt->stream_index]->time_base,
+                               AV_TIME_BASE_Q);
+    if (dts < last_dts)
+        nb_errors++;
+    last_dts = dts;
+    nb_written++;
+    return 0;
+}
+
+static const FFOutputFormat test_muxer = {
+    .p.name         = "interleave_test",
+    .p.flags        = AVFMT_NOFILE,
+    .write_packet   = test_write_packet,
+};
+
+typedef struct StreamGen {
+    AVRational tb;
+    int64_t    duration;
+    int64_t    next_dts;
+} StreamGen;
+
+int main(int argc, char **argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 600;
+    StreamGen gen[NB_STREAMS];
+    AVFormatContext *s;
+    AVPacket *pkt;
+    int64_t start;
+    int ret, nb_packets = 0;
+
+    if (seconds <= 0)
+        return 1;
+
+    s   = avformat_alloc_context();
+    pkt = av_packet_alloc();
+    if (!s || !pkt)
+        return 1;
+    s->oformat = &test_muxer.p;
+    s->max_interleave_delta = 0;
+
+    for (int i = 0; i < NB_STREAMS; i++) {
+        AVStream *st = avformat_new_stream(s, NULL);
+        if (!st)
+            return 1;
+        if (!i) {
+            st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+            st->codecpar->width      = 1920;
+            st->codecpar->height     = 1080;
+            gen[i] = (StreamGen){ { 1, 90000 }, 3600 };
+        } else if (i <= NB_AUDIO) {
+            st->codecpar->codec_type  = AVMEDIA_TYPE_AUDIO;
+            st->codecpar->sample_rate = 48000;
+            gen[i] = (StreamGen){ { 1, 48000 }, 1024 };
+        } else {
+            /* one cue every four seconds, staggered between the tracks */
+            st->codecpar->codec_type = AVMEDIA_TYPE_SUBTITLE;
+            gen[i] = (StreamGen){ { 1, 1000 }, 4000, (i - NB_AUDIO) * 250 };
+        }
+        st->time_base = gen[i].tb;
+    }
+
+    if ((ret = avformat_write_header(s, NULL)) < 0)
+        return 1;
+
+    start = av_gettime_relative();
+    for (int t = BURST; t <= seconds; t += BURST) {
+        for (int i = 0; i < NB_STREAMS; i++) {
+            int64_t end = av_rescale(t, gen[i].tb.den, gen[i].tb.num);
+
+            while (gen[i].next_dts < end) {
+                if ((ret = av_new_packet(pkt, 8)) < 0)
+                    return 1;
+                pkt->stream_index = i;
+                pkt->dts = pkt->pts = gen[i].next_dts;
+                pkt->duration = gen[i].duration;
+                gen[i].next_dts += gen[i].duration;
+                if ((ret = av_interleaved_write_frame(s, pkt)) < 0)
+                    return 1;
+                nb_packets++;
+            }
+        }
+    }
+    if ((ret = av_write_trailer(s)) < 0)
+        return 1;
+
+    printf("%d streams, %d packets: %.1f ns per packet, %d out of order\n",
+           NB_STREAMS, nb_packets,
+           (av_gettime_relative() - start) * 1000.0 / nb_packets, nb_errors);
+
+    av_packet_free(&pkt);
+    avformat_free_context(s);
+    return nb_errors || nb_written != nb_packets;
+}
@@ -0,0 +1,169 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program builds the same indexes as a flat AVIndexEntry array
+ * and as an FFPackedIndex, checks that entries, searches and reductions
+ * agree and reports the memory used by both.
+ * ./packed_index [hours]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavformat/avformat.h"
+#include "libavformat/demux.h"
+#include "libavformat/packed_index.h"
+
+typedef struct FlatIndex {
+    AVIndexEntry *entries;
+    int           nb;
+    unsigned      size;
+} FlatIndex;
+
+static int nb_errors;
+
+static void check(const FlatIndex *fi, const FFPackedIndex *pi, AVLFG *lfg,
+                  const char *what)
+{
+    static const int search_flags[] = {
+        0, AVSEEK_FLAG_BACKWARD, AVSEEK_FLAG_ANY,
+        AVSEEK_FLAG_ANY | AVSEEK_FLAG_BACKWARD,
+    };
+    AVIndexEntry e;
+
+    if (ff_packed_index_nb_entries(pi) != fi->nb) {
+        printf("%s: %d entries instead of %d\n", what,
+               ff_packed_index_nb_entries(pi), fi->nb);
+        nb_errors++;
+        return;
+    }
+    for (int i = 0; i < fi->nb; i++) {
+        const AVIndexEntry *f = &fi->entries[i];
+        ff_packed_index_get(pi, i, &e);
+        if (e.pos != f->pos || e.timestamp != f->timestamp || e.size != f->size ||
+            e.flags != f->flags || e.min_distance != f->min_distance) {
+            printf("%s: entry %d differs\n", what, i);
+            nb_errors++;
+            return;
+        }
+    }
+    for (int i = 0; fi->nb && i < 1000; i++) {
+        int64_t ts = fi->entries[av_lfg_get(lfg) % fi->nb].timestamp +
+                     (int)(av_lfg_get(lfg) % 7) - 3;
+        for (int j = 0; j < FF_ARRAY_ELEMS(search_flags); j++) {
+            int a = ff_index_search_timestamp(fi->entries, fi->nb, ts, search_flags[j]);
+            int b = ff_packed_index_search(pi, ts, search_flags[j]);
+            if (a != b) {
+                printf("%s: search for %"PRId64" with flags %d returned %d instead of %d\n",
+                       what, ts, search_flags[j], b, a);
+                nb_errors++;
+                return;
+            }
+        }
+    }
+}
+
+static void add(FlatIndex *fi, FFPackedIndex *pi, int64_t pos, int64_t ts,
+                int size, int distance, int flags)
+{
+    int a = ff_add_index_entry(&fi->entries, &fi->nb, &fi->size,
+                               pos, ts, size, distance, flags);
+    int b = ff_packed_index_add(pi, pos, ts, size, distance, flags);
+    if (a != b) {
+        printf("adding %"PRId64" returned %d instead of %d\n", ts, b, a);
+        nb_errors++;
+    }
+}
+
+static void reduce(FlatIndex *fi, FFPackedIndex *pi)
+{
+    int i;
+    for (i = 0; 2 * i < fi->nb; i++)
+        fi->entries[i] = fi->entries[2 * i];
+    fi->nb = i;
+    if (ff_packed_index_reduce(pi) < 0)
+        nb_errors++;
+}
+
+int main(int argc, char **argv)
+{
+    int hours = argc > 1 ? atoi(argv[1]) : 24;
+    FlatIndex fi = { 0 };
+    FFPackedIndex *pi;
+    AVLFG lfg;
+    int64_t pos;
+
+    if (hours <= 0)
+        return 1;
+    av_lfg_init(&lfg, 0xdeadbeef);
+
+    /* keyframes of a 90 kHz transport stream at ~8 Mb/s, every 0.5-2 s */
+    pi  = ff_packed_index_alloc();
+    pos = 0;
+    for (int64_t ts = 0; ts < hours * 3600LL * 90000; ts += 45000 + av_lfg_get(&lfg) % 135000) {
+        add(&fi, pi, pos, ts, 0, 0, AVINDEX_KEYFRAME);
+        pos += (ts % 180000 + 45000) * 11 + av_lfg_get(&lfg) % 188 * 188;
+    }
+    check(&fi, pi, &lfg, "keyframes");
+    printf("keyframe index of %d h, %d entries: flat %u bytes, packed %zu bytes\n",
+           hours, fi.nb, fi.size, ff_packed_index_memory(pi));
+
+    /* every audio packet, as the generic index of raw audio formats does */
+    ff_packed_index_free(&pi);
+    av_freep(&fi.entries);
+    fi = (FlatIndex){ 0 };
+    pi = ff_packed_index_alloc();
+    for (int64_t i = 0; i < hours * 3600LL * 48000 / 1536; i++)
+        add(&fi, pi, i * 768, i * 1536, 0, 0, AVINDEX_KEYFRAME);
+    check(&fi, pi, &lfg, "audio");
+    printf("audio index of %d h, %d entries: flat %u bytes, packed %zu bytes\n",
+           hours, fi.nb, fi.size, ff_packed_index_memory(pi));
+    reduce(&fi, pi);
+    check(&fi, pi, &lfg, "reduced");
+
+    /* out of order inserts, sizes, distances, flags and replaced entries
+     * as left by bisection seeks, with deltas that need new chunks */
+    ff_packed_index_free(&pi);
+    av_freep(&fi.entries);
+    fi = (FlatIndex){ 0 };
+    pi = ff_packed_index_alloc();
+    for (int i = 0; i < 20000; i++) {
+        int64_t ts = av_lfg_get(&lfg) % 50000 * 3000;
+        int64_t p  = ts * ((i & 1023) ? 7 : 100003);
+        int flags  = av_lfg_get(&lfg) % 5 ? AVINDEX_KEYFRAME : 0;
+        int size   = i % 3 ? 0 : av_lfg_get(&lfg) % 0x3FFFFFFF;
+        int dist   = i % 5 ? 0 : av_lfg_get(&lfg) % 100000;
+        if (!(i % 17))
+            flags |= AVINDEX_DISCARD_FRAME;
+        add(&fi, pi, p, ts - (i % 11 ? 0 : INT64_C(1) << 40), size, dist, flags);
+    }
+    check(&fi, pi, &lfg, "random");
+    reduce(&fi, pi);
+    check(&fi, pi, &lfg, "random reduced");
+
+    ff_packed_index_free(&pi);
+    av_freep(&fi.entries);
+
+    if (nb_errors)
+        printf("%d errors\n", nb_errors);
+    return !!nb_errors;
+}
@@ -65,6 +65,28 @@ static int set_options(TLSShared *c, const char *uri)
     return 0;
 }
 
+//PLEX
+int ff_tls_alpn_wire(const TLSShared *c, uint8_t *buf, int size)
+{
+    const char *p = c->alpn;
+    int len = 0;
+
+    while (p && *p) {
+        int n = strcspn(p, ",");
+
+        if (n > 255 || len + 1 + n > size)
+            return AVERROR(EINVAL);
+        if (n) {
+            buf[len] = n;
+            memcpy(buf + len + 1, p, n);
+            len += 1 + n;
+        }
+        p += n + !!p[n];
+    }
+    return len;
+}
+//PLEX
+
 int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AVDictionary **options)
 {
     int port;
@@ -40,6 +40,11 @@ typedef struct TLSShared {
     int numerichost;
 
     URLContext *tcp;
+
+    //PLEX
+    char *alpn;
+    char *alpn_selected;
+    //PLEX
 } TLSShared;
 
 #define TLS_OPTFL (AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM)
@@ -51,10 +56,23 @@ typedef struct TLSShared {
     {"key_file",   "Private key file",                    offsetof(pstruct, options_field . key_file),  AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
     {"listen",     "Listen for incoming connections",     offsetof(pstruct, options_field . listen),    AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, .flags = TLS_OPTFL }, \
     {"verifyhost", "Verify against a specific hostname",  offsetof(pstruct, options_field . host),      AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
-    {"http_proxy", "Set proxy to tunnel through",         offsetof(pstruct, options_field . http_proxy), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }
+    {"http_proxy", "Set proxy to tunnel through",         offsetof(pstruct, options_field . http_proxy), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
+    {"alpn",       "Comma separated list of application protocols to offer", offsetof(pstruct, options_field . alpn), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
+    {"alpn_selected", "Application protocol selected by the peer", offsetof(pstruct, options_field . alpn_selected), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }
 
 int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AVDictionary **options);
 
+//PLEX
+/**
+ * Encode the alpn option in the wire format of the TLS extension, a list of
+ * length prefixed protocol names.
+ *
+ * @return the encoded size, 0 if no protocols are set, or a negative AVERROR
+ *         code if they do not fit in size bytes
+ */
+int ff_tls_alpn_wire(const TLSShared *c, uint8_t *buf, int size);
+//PLEX
+
 void ff_gnutls_init(void);
 void ff_gnutls_deinit(void);
 
@@ -193,6 +193,27 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     gnutls_transport_set_push_function(p->session, gnutls_url_push);
     gnutls_transport_set_ptr(p->session, p);
     gnutls_set_default_priority(p->session);
+    //PLEX
+#if GNUTLS_VERSION_NUMBER >= 0x030200
+    if (!c->listen && c->alpn) {
+        uint8_t alpn[256];
+        gnutls_datum_t protocols[16];
+        int alpn_len = ff_tls_alpn_wire(c, alpn, sizeof(alpn)), nb = 0;
+        if (alpn_len < 0) {
+            ret = alpn_len;
+            goto fail;
+        }
+        for (int i = 0; i < alpn_len && nb < FF_ARRAY_ELEMS(protocols); i += 1 + alpn[i]) {
+            protocols[nb].data   = alpn + i + 1;
+            protocols[nb++].size = alpn[i];
+        }
+        if (nb && gnutls_alpn_set_protocols(p->session, protocols, nb, 0) < 0) {
+            ret = AVERROR(EIO);
+            goto fail;
+        }
+    }
+#endif
+    //PLEX
     do {
         if (ff_check_interrupt(&h->interrupt_callback)) {
             ret = AVERROR_EXIT;
@@ -206,6 +227,18 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         }
     } while (ret);
     p->need_shutdown = 1;
+    //PLEX
+#if GNUTLS_VERSION_NUMBER >= 0x030200
+    if (!c->listen && c->alpn) {
+        gnutls_datum_t selected;
+        if (!gnutls_alpn_get_selected_protocol(p->session, &selected) &&
+            !(c->alpn_selected = av_strndup((const char *)selected.data, selected.size))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+#endif
+    //PLEX
     if (c->verify) {
         unsigned int status, cert_list_size;
         gnutls_x509_crt_t cert;
@@ -46,8 +46,81 @@ typedef struct TLSContext {
     BIO_METHOD* url_bio_method;
 #endif
     int io_err;
+    //PLEX
+    int session_cache;
+    int ktls;
+    int use_socket;             ///< OpenSSL owns the socket, for kTLS
+    int fd;
+    char session_key[1024];
+    //PLEX
 } TLSContext;
 
+//PLEX
+#if OPENSSL_VERSION_NUMBER >= 0x1010000fL
+#define SESSION_CACHE_SIZE 32
+
+/* Client sessions of recent connections, so that reconnects to the same
+ * server (segments, seeks) resume instead of doing a full handshake. */
+typedef struct TLSSession {
+    char key[1024];
+    SSL_SESSION *session;
+} TLSSession;
+
+static AVMutex session_lock = AV_MUTEX_INITIALIZER;
+static TLSSession sessions[SESSION_CACHE_SIZE];
+static int session_next;
+
+/* Must hold session_lock. */
+static TLSSession *session_find(const char *key)
+{
+    for (int i = 0; i < SESSION_CACHE_SIZE; i++)
+        if (sessions[i].session && !strcmp(sessions[i].key, key))
+            return &sessions[i];
+    return NULL;
+}
+
+static int session_new_cb(SSL *ssl, SSL_SESSION *session)
+{
+    TLSContext *p = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    TLSSession *s;
+
+    ff_mutex_lock(&session_lock);
+    if (!(s = session_find(p->session_key))) {
+        s = &sessions[session_next];
+        session_next = (session_next + 1) % SESSION_CACHE_SIZE;
+        av_strlcpy(s->key, p->session_key, sizeof(s->key));
+    }
+    SSL_SESSION_free(s->session);
+    s->session = session;
+    ff_mutex_unlock(&session_lock);
+    /* we keep the reference */
+    return 1;
+}
+
+static void session_resume(TLSContext *p)
+{
+    TLSSession *s;
+
+    ff_mutex_lock(&session_lock);
+    if ((s = session_find(p->session_key)))
+        SSL_set_session(p->ssl, s->session);
+    ff_mutex_unlock(&session_lock);
+}
+
+static void session_remove(TLSContext *p)
+{
+    TLSSession *s;
+
+    ff_mutex_lock(&session_lock);
+    if ((s = session_find(p->session_key))) {
+        SSL_SESSION_free(s->session);
+        s->session = NULL;
+    }
+    ff_mutex_unlock(&session_lock);
+}
+#endif
+//PLEX
+
 #if HAVE_THREADS && OPENSSL_VERSION_NUMBER < 0x10100000L
 #include <openssl/crypto.h>
 pthread_mutex_t *openssl_mutexes;
@@ -145,6 +218,24 @@ static int print_tls_error(URLContext *h, int ret)
     return averr;
 }
 
+//PLEX
+/* Wait until the socket is ready for what the SSL call that returned ret
+ * wants. Returns 0 to retry the call, a positive value if it failed for
+ * another reason, or a negative AVERROR code. */
+static int socket_wait(URLContext *h, int ret)
+{
+    TLSContext *c = h->priv_data;
+    int err = SSL_get_error(c->ssl, ret);
+
+    if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE)
+        return 1;
+    if (h->flags & AVIO_FLAG_NONBLOCK)
+        return AVERROR(EAGAIN);
+    return ff_network_wait_fd_timeout(c->fd, err == SSL_ERROR_WANT_WRITE,
+                                      h->rw_timeout, &h->interrupt_callback);
+}
+//PLEX
+
 static int tls_close(URLContext *h)
 {
     TLSContext *c = h->priv_data;
@@ -253,7 +344,7 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     TLSContext *p = h->priv_data;
     TLSShared *c = &p->tls_shared;
     BIO *bio;
-    int ret;
+    int ret, wait = 0; //PLEX
 
     if ((ret = ff_openssl_init()) < 0)
         return ret;
@@ -298,6 +389,17 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         ret = AVERROR(EIO);
         goto fail;
     }
+    //PLEX
+#ifdef SSL_OP_ENABLE_KTLS
+    /* kTLS can only be set up by OpenSSL on a socket of its own; a tunnel
+     * through a proxy is fine as raw bytes, but keep it simple */
+    if (p->ktls && !c->http_proxy && (p->fd = ffurl_get_file_handle(c->tcp)) >= 0) {
+        SSL_set_options(p->ssl, SSL_OP_ENABLE_KTLS);
+        bio = BIO_new_socket(p->fd, BIO_NOCLOSE);
+        p->use_socket = 1;
+    } else {
+#endif
+    //PLEX
 #if OPENSSL_VERSION_NUMBER >= 0x1010000fL
     p->url_bio_method = BIO_meth_new(BIO_TYPE_SOURCE_SINK, "urlprotocol bio");
     BIO_meth_set_write(p->url_bio_method, url_bio_bwrite);
@@ -312,10 +414,52 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     bio = BIO_new(&url_bio_method);
     bio->ptr = p;
 #endif
+    //PLEX
+#ifdef SSL_OP_ENABLE_KTLS
+    }
+#endif
+    //PLEX
     SSL_set_bio(p->ssl, bio, bio);
     if (!c->listen && !c->numerichost)
         SSL_set_tlsext_host_name(p->ssl, c->host);
-    ret = c->listen ? SSL_accept(p->ssl) : SSL_connect(p->ssl);
+    //PLEX
+#if OPENSSL_VERSION_NUMBER >= 0x1000200fL
+    if (!c->listen && c->alpn) {
+        uint8_t alpn[256];
+        int alpn_len = ff_tls_alpn_wire(c, alpn, sizeof(alpn));
+        if (alpn_len < 0) {
+            ret = alpn_len;
+            goto fail;
+        }
+        if (alpn_len && SSL_set_alpn_protos(p->ssl, alpn, alpn_len)) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+#endif
+#if OPENSSL_VERSION_NUMBER >= 0x1010000fL
+    if (!c->listen && p->session_cache) {
+        char host[256];
+        int port;
+
+        av_url_split(NULL, 0, NULL, 0, host, sizeof(host), &port, NULL, 0, uri);
+        snprintf(p->session_key, sizeof(p->session_key), "%s:%d:%d:%s:%s", host, port,
+                 c->verify, c->ca_file ? c->ca_file : "", c->cert_file ? c->cert_file : "");
+        SSL_CTX_set_app_data(p->ctx, p);
+        SSL_CTX_set_session_cache_mode(p->ctx, SSL_SESS_CACHE_CLIENT |
+                                               SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(p->ctx, session_new_cb);
+        session_resume(p);
+    }
+#endif
+    do {
+        ret = c->listen ? SSL_accept(p->ssl) : SSL_connect(p->ssl);
+    } while (ret < 0 && p->use_socket && !(wait = socket_wait(h, ret)));
+    if (wait < 0) {
+        ret = wait;
+        goto fail;
+    }
+    //PLEX
     if (ret == 0) {
         av_log(h, AV_LOG_ERROR, "Unable to negotiate TLS/SSL session\n");
         ret = AVERROR(EIO);
@@ -324,9 +468,37 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         ret = print_tls_error(h, ret);
         goto fail;
     }
+    //PLEX
+#if OPENSSL_VERSION_NUMBER >= 0x1000200fL
+    if (!c->listen && c->alpn) {
+        const unsigned char *selected;
+        unsigned int selected_len;
+        SSL_get0_alpn_selected(p->ssl, &selected, &selected_len);
+        if (selected_len && !(c->alpn_selected = av_strndup((const char *)selected, selected_len))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+#endif
+    if (SSL_session_reused(p->ssl))
+        av_log(h, AV_LOG_DEBUG, "Resumed TLS session\n");
+#ifdef SSL_OP_ENABLE_KTLS
+    if (p->use_socket)
+        av_log(h, AV_LOG_VERBOSE, "Kernel TLS send: %s, receive: %s\n",
+               BIO_get_ktls_send(SSL_get_wbio(p->ssl)) ? "yes" : "no",
+               BIO_get_ktls_recv(SSL_get_rbio(p->ssl)) ? "yes" : "no");
+#endif
+    //PLEX
 
     return 0;
 fail:
+    //PLEX
+#if OPENSSL_VERSION_NUMBER >= 0x1010000fL
+    /* in case the session itself is what the server chokes on */
+    if (p->session_key[0])
+        session_remove(p);
+#endif
+    //PLEX
     tls_close(h);
     return ret;
 }
@@ -334,33 +506,63 @@ fail:
 static int tls_read(URLContext *h, uint8_t *buf, int size)
 {
     TLSContext *c = h->priv_data;
-    int ret;
+    int ret, wait = 0; //PLEX
     // Set or clear the AVIO_FLAG_NONBLOCK on c->tls_shared.tcp
     c->tls_shared.tcp->flags &= ~AVIO_FLAG_NONBLOCK;
     c->tls_shared.tcp->flags |= h->flags & AVIO_FLAG_NONBLOCK;
-    ret = SSL_read(c->ssl, buf, size);
+    do {
+        ret = SSL_read(c->ssl, buf, size);
+    } while (ret < 0 && c->use_socket && !(wait = socket_wait(h, ret))); //PLEX
     if (ret > 0)
         return ret;
     if (ret == 0)
         return AVERROR_EOF;
+    if (wait < 0) //PLEX
+        return wait;
     return print_tls_error(h, ret);
 }
 
 static int tls_write(URLContext *h, const uint8_t *buf, int size)
 {
     TLSContext *c = h->priv_data;
-    int ret;
+    int ret, wait = 0; //PLEX
     // Set or clear the AVIO_FLAG_NONBLOCK on c->tls_shared.tcp
     c->tls_shared.tcp->flags &= ~AVIO_FLAG_NONBLOCK;
     c->tls_shared.tcp->flags |= h->flags & AVIO_FLAG_NONBLOCK;
-    ret = SSL_write(c->ssl, buf, size);
+    do {
+        ret = SSL_write(c->ssl, buf, size);
+    } while (ret < 0 && c->use_socket && !(wait = socket_wait(h, ret))); //PLEX
     if (ret > 0)
         return ret;
     if (ret == 0)
         return AVERROR_EOF;
+    if (wait < 0) //PLEX
+        return wait;
     return print_tls_error(h, ret);
 }
 
+//PLEX
+#ifdef SSL_OP_ENABLE_KTLS
+/* With kernel TLS the socket encrypts by itself, so file data can be sent
+ * without passing through userspace. */
+static int tls_write_from_fd(URLContext *h, int fd, int64_t offset, int size)
+{
+    TLSContext *c = h->priv_data;
+    ossl_ssize_t ret;
+    int wait = 0;
+
+    if (!c->use_socket || !BIO_get_ktls_send(SSL_get_wbio(c->ssl)))
+        return AVERROR(ENOSYS);
+    do {
+        ret = SSL_sendfile(c->ssl, fd, offset, size, 0);
+    } while (ret <= 0 && !(wait = socket_wait(h, ret)));
+    if (ret > 0)
+        return ret;
+    return wait < 0 ? wait : print_tls_error(h, ret);
+}
+#endif
+//PLEX
+
 static int tls_get_file_handle(URLContext *h)
 {
     TLSContext *c = h->priv_data;
@@ -375,6 +577,10 @@ static int tls_get_short_seek(URLContext *h)
 
 static const AVOption options[] = {
     TLS_COMMON_OPTIONS(TLSContext, tls_shared),
+    //PLEX
+    { "session_cache", "Resume sessions of earlier connections to the same server", offsetof(TLSContext, session_cache), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, TLS_OPTFL },
+    { "ktls", "Let the kernel encrypt and decrypt records (Linux kTLS)", offsetof(TLSContext, ktls), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, TLS_OPTFL },
+    //PLEX
     { NULL }
 };
 
@@ -393,6 +599,9 @@ const URLProtocol ff_tls_protocol = {
     .url_close      = tls_close,
     .url_get_file_handle = tls_get_file_handle,
     .url_get_short_seek  = tls_get_short_seek,
+#ifdef SSL_OP_ENABLE_KTLS
+    .url_write_from_fd   = tls_write_from_fd, //PLEX
+#endif
     .priv_data_size = sizeof(TLSContext),
     .flags          = URL_PROTOCOL_FLAG_NETWORK,
     .priv_data_class = &tls_class,
@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* recvmmsg() */ //PLEX
 
 #include "avformat.h"
 #include "libavutil/avassert.h"
@@ -78,6 +79,15 @@
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
 
+//PLEX
+#if HAVE_RECVMMSG && HAVE_PTHREAD_CANCEL
+/* datagrams received per call by the circular buffer thread */
+#define UDP_RX_BATCH 32
+/* room for the size written to the fifo in front of each datagram */
+#define UDP_RX_SLOT_SIZE (4 + UDP_MAX_PKT_SIZE)
+#endif
+//PLEX
+
 typedef struct UDPContext {
     const AVClass *class;
     int udp_fd;
@@ -115,6 +125,22 @@ typedef struct UDPContext {
     char *sources;
     char *block;
     IPSourceFilters filters;
+
+    //PLEX
+    int busy_poll;
+    int64_t rx_dropped;     ///< datagrams dropped by the kernel, socket buffer full
+    int64_t rx_overruns;    ///< datagrams dropped on circular buffer overrun
+#ifdef UDP_RX_BATCH
+    uint8_t *rx_bufs;       ///< UDP_RX_BATCH slots of UDP_RX_SLOT_SIZE
+    struct mmsghdr rx_msgs[UDP_RX_BATCH];
+    struct iovec rx_iov[UDP_RX_BATCH];
+    struct sockaddr_storage rx_addrs[UDP_RX_BATCH];
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(uint32_t))];
+    } rx_control[UDP_RX_BATCH];
+#endif
+    //PLEX
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -139,6 +165,11 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    //PLEX
+    { "busy_poll",      "busy poll the device queue for this long when receiving, in microseconds (Linux only)", OFFSET(busy_poll), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "rx_dropped",     "datagrams dropped by the kernel because the socket buffer was full", OFFSET(rx_dropped), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "rx_overruns",    "datagrams dropped because the circular buffer was full", OFFSET(rx_overruns), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    //PLEX
     { NULL }
 };
 
@@ -479,6 +510,88 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+//PLEX
+/* queue a received datagram, buf has 4 bytes in front of the data for its
+ * size; returns 0 or a fatal error */
+static int rx_queue_datagram(URLContext *h, uint8_t *buf, int len,
+                             struct sockaddr_storage *addr)
+{
+    UDPContext *s = h->priv_data;
+
+    if (ff_ip_check_source_lists(addr, &s->filters))
+        return 0;
+    AV_WL32(buf, len);
+
+    if (av_fifo_can_write(s->fifo) < len + 4) {
+        /* No Space left */
+        s->rx_overruns++;
+        if (s->overrun_nonfatal) {
+            av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                    "Surviving due to overrun_nonfatal option\n");
+            return 0;
+        } else {
+            av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                    "To avoid, increase fifo_size URL option. "
+                    "To survive in such case, use overrun_nonfatal option\n");
+            return AVERROR(EIO);
+        }
+    }
+    av_fifo_write(s->fifo, buf, len + 4);
+    return 0;
+}
+
+#ifdef UDP_RX_BATCH
+static int rx_batch_init(UDPContext *s)
+{
+    s->rx_bufs = av_malloc(UDP_RX_BATCH * UDP_RX_SLOT_SIZE);
+    if (!s->rx_bufs)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < UDP_RX_BATCH; i++) {
+        s->rx_iov[i].iov_base = s->rx_bufs + i * UDP_RX_SLOT_SIZE + 4;
+        s->rx_iov[i].iov_len  = UDP_MAX_PKT_SIZE;
+        s->rx_msgs[i].msg_hdr = (struct msghdr){
+            .msg_name    = &s->rx_addrs[i],
+            .msg_iov     = &s->rx_iov[i],
+            .msg_iovlen  = 1,
+            .msg_control = s->rx_control[i].buf,
+        };
+    }
+    return 0;
+}
+
+/* receive all the datagrams available, blocking for the first one */
+static int rx_batch_recv(UDPContext *s)
+{
+    int n;
+
+    for (int i = 0; i < UDP_RX_BATCH; i++) {
+        s->rx_msgs[i].msg_hdr.msg_namelen    = sizeof(s->rx_addrs[i]);
+        s->rx_msgs[i].msg_hdr.msg_controllen = sizeof(s->rx_control[i].buf);
+    }
+
+    n = recvmmsg(s->udp_fd, s->rx_msgs, UDP_RX_BATCH, MSG_WAITFORONE, NULL);
+
+#ifdef SO_RXQ_OVFL
+    /* the kernel reports the drops so far on the socket, with every
+     * datagram received after one */
+    if (n > 0) {
+        struct msghdr *msg = &s->rx_msgs[n - 1].msg_hdr;
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                uint32_t dropped;
+                memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+                s->rx_dropped = dropped;
+            }
+        }
+    }
+#endif
+    return n;
+}
+#endif
+//PLEX
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -495,16 +608,22 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
+        int len, ret = 0;
+#ifndef UDP_RX_BATCH
         struct sockaddr_storage addr;
         socklen_t addr_len = sizeof(addr);
+#endif
 
         pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+#ifdef UDP_RX_BATCH
+        len = rx_batch_recv(s); //PLEX
+#else
         len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+#endif
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
         if (len < 0) {
@@ -514,25 +633,20 @@ static void *circular_buffer_task_rx( void *_URLContext)
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
-
-        if (av_fifo_can_write(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
-            }
+        //PLEX
+#ifdef UDP_RX_BATCH
+        /* len is the number of datagrams */
+        for (int i = 0; i < len && ret >= 0; i++)
+            ret = rx_queue_datagram(h, s->rx_bufs + i * UDP_RX_SLOT_SIZE,
+                                    s->rx_msgs[i].msg_len, &s->rx_addrs[i]);
+#else
+        ret = rx_queue_datagram(h, s->tmp, len, &addr);
+#endif
+        if (ret < 0) {
+            s->circular_buffer_error = ret;
+            goto end;
         }
-        av_fifo_write(s->fifo, s->tmp, len + 4);
+        //PLEX
         pthread_cond_signal(&s->cond);
     }
 
@@ -751,6 +865,8 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             if ((ret = ff_ip_parse_blocks(h, buf, &s->filters)) < 0)
                 goto fail;
         }
+        if (av_find_info_tag(buf, sizeof(buf), "busy_poll", p)) //PLEX
+            s->busy_poll = strtol(buf, NULL, 10);
         if (!is_output && av_find_info_tag(buf, sizeof(buf), "timeout", p))
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
@@ -900,6 +1016,29 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_RECVBUF)");
         }
         len = sizeof(tmp);
+        //PLEX
+#ifdef SO_RCVBUFFORCE
+        /* over the system limit, which privileged processes may exceed */
+        if (getsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &tmp, &len) >= 0 &&
+            tmp < s->buffer_size) {
+            tmp = s->buffer_size;
+            setsockopt(udp_fd, SOL_SOCKET, SO_RCVBUFFORCE, &tmp, sizeof(tmp));
+        }
+        len = sizeof(tmp);
+#endif
+#ifdef SO_RXQ_OVFL
+        tmp = 1;
+        setsockopt(udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &tmp, sizeof(tmp));
+#endif
+        if (s->busy_poll) {
+#ifdef SO_BUSY_POLL
+            if (setsockopt(udp_fd, SOL_SOCKET, SO_BUSY_POLL, &s->busy_poll, sizeof(s->busy_poll)) < 0)
+                ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_BUSY_POLL)");
+#else
+            av_log(h, AV_LOG_WARNING, "busy_poll is not supported on this system\n");
+#endif
+        }
+        //PLEX
         if (getsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &tmp, &len) < 0) {
             ff_log_net_error(h, AV_LOG_WARNING, "getsockopt(SO_RCVBUF)");
         } else {
@@ -952,6 +1091,12 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ret = AVERROR(ret);
             goto cond_fail;
         }
+        //PLEX
+#ifdef UDP_RX_BATCH
+        if (!is_output && (ret = rx_batch_init(s)) < 0)
+            goto thread_fail;
+#endif
+        //PLEX
         ret = pthread_create(&s->circular_buffer_thread, NULL, is_output?circular_buffer_task_tx:circular_buffer_task_rx, h);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", strerror(ret));
@@ -973,6 +1118,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep2(&s->fifo);
+#ifdef UDP_RX_BATCH
+    av_freep(&s->rx_bufs); //PLEX
+#endif
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -1140,6 +1288,14 @@ static int udp_close(URLContext *h)
         pthread_cond_destroy(&s->cond);
     }
 #endif
+    //PLEX
+    if (s->rx_dropped || s->rx_overruns)
+        av_log(h, AV_LOG_WARNING, "%"PRId64" datagrams dropped by the kernel, "
+               "%"PRId64" on circular buffer overrun\n", s->rx_dropped, s->rx_overruns);
+#ifdef UDP_RX_BATCH
+    av_freep(&s->rx_bufs);
+#endif
+    //PLEX
     closesocket(s->udp_fd);
     av_fifo_freep2(&s->fifo);
     ff_ip_reset_filters(&s->filters);
@@ -50,6 +50,15 @@ typedef struct URLContext {
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
 } URLContext;
 
+//PLEX
+#define URL_WRITEV_MAX 4
+
+typedef struct URLWriteVec {
+    const uint8_t *data;
+    int size;
+} URLWriteVec;
+//PLEX
+
 typedef struct URLProtocol {
     const char *name;
     int     (*url_open)( URLContext *h, const char *url, int flags);
@@ -76,6 +85,21 @@ typedef struct URLProtocol {
      */
     int     (*url_read)( URLContext *h, unsigned char *buf, int size);
     int     (*url_write)(URLContext *h, const unsigned char *buf, int size);
+    //PLEX
+    /**
+     * Write several buffers at once, like writev(). Returns the number of
+     * bytes written, which may end within any of the buffers; looping is
+     * left to ffurl_writev(). Protocols implementing it accept writes larger
+     * than max_packet_size.
+     */
+    int     (*url_writev)(URLContext *h, const URLWriteVec *vec, int nb_vec);
+    /**
+     * Write size bytes read from the file descriptor fd at offset, like
+     * sendfile(). Returns the number of bytes written; looping is left to
+     * ffurl_write_from_fd().
+     */
+    int     (*url_write_from_fd)(URLContext *h, int fd, int64_t offset, int size);
+    //PLEX
     int64_t (*url_seek)( URLContext *h, int64_t pos, int whence);
     int     (*url_close)(URLContext *h);
     int (*url_read_pause)(URLContext *h, int pause);
@@ -214,6 +238,27 @@ static inline int ffurl_write(URLContext *h, const uint8_t *buf, int size)
 #endif
 }
 
+//PLEX
+/**
+ * Write all the buffers in vec, at most URL_WRITEV_MAX of them, to the
+ * resource accessed by h, with a single call to the protocol when it
+ * supports vectored writes.
+ *
+ * @return the total number of bytes written, or a negative AVERROR code
+ */
+int ffurl_writev(URLContext *h, const URLWriteVec *vec, int nb_vec);
+
+/**
+ * Write size bytes of the file fd starting at offset to the resource
+ * accessed by h, letting the kernel copy them.
+ *
+ * @return size on success, AVERROR(ENOSYS) if the protocol or the file does
+ *         not support it and nothing was written, or another negative AVERROR
+ *         code on failure
+ */
+int ffurl_write_from_fd(URLContext *h, int fd, int64_t offset, int size);
+//PLEX
+
 int64_t ffurl_seek2(void *urlcontext, int64_t pos, int whence);
 /**
  * Change the position that will be used by the next read/write
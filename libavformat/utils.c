@@ -22,6 +22,7 @@
 #include <stdint.h>
 
 #include "config.h"
+#include "config_components.h" //PLEX
 
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
@@ -33,6 +34,7 @@
 
 #include "avformat.h"
 #include "avio_internal.h"
+#include "http.h" //PLEX
 #include "internal.h"
 #if CONFIG_NETWORK
 #include "network.h"
@@ -583,6 +585,9 @@ int avformat_network_init(void)
 int avformat_network_deinit(void)
 {
 #if CONFIG_NETWORK
+#if CONFIG_HTTP_PROTOCOL //PLEX
+    ff_http_pool_close();
+#endif
     ff_network_close();
     ff_tls_deinit();
 #endif
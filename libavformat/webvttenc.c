@@ -28,8 +28,10 @@
 #include "internal.h"
 #include "mux.h"
 //PLEX
+#include "libavutil/bprint.h"
 #include "libavutil/opt.h"
 #include <float.h>
+#include "webvttenc.h"
 //PLEX
 
 //PLEX
@@ -37,10 +39,13 @@ typedef struct {
     const AVClass  *class;
     float           sync_vtt;
     int64_t         sync_mpeg;
+    char            header[128];   ///< file header, rendered once
+    int             header_len;
+    AVBPrint        cue;           ///< reused for every cue
 } WebVTTMuxContext;
 //PLEX
 
-static void webvtt_write_time(AVIOContext *pb, int64_t millisec)
+static void webvtt_write_time(AVBPrint *bp, int64_t millisec) //PLEX
 {
     int64_t sec, min, hour;
     sec = millisec / 1000;
@@ -51,17 +56,27 @@ static void webvtt_write_time(AVIOContext *pb, int64_t millisec)
     min -= 60 * hour;
 
 //PLEX    if (hour > 0)
-        avio_printf(pb, "%02"PRId64":", hour);
+        av_bprintf(bp, "%02"PRId64":", hour); //PLEX
 
-    avio_printf(pb, "%02"PRId64":%02"PRId64".%03"PRId64"", min, sec, millisec);
+    av_bprintf(bp, "%02"PRId64":%02"PRId64".%03"PRId64"", min, sec, millisec); //PLEX
 }
 
+//PLEX
+int ff_webvtt_write_segment_header(AVFormatContext *ctx)
+{
+    WebVTTMuxContext *priv = ctx->priv_data;
+
+    avio_write(ctx->pb, priv->header, priv->header_len);
+    return 0;
+}
+//PLEX
+
 static int webvtt_write_header(AVFormatContext *ctx)
 {
     AVStream     *s = ctx->streams[0];
     AVCodecParameters *par = ctx->streams[0]->codecpar;
-    AVIOContext *pb = ctx->pb;
     WebVTTMuxContext *priv = (WebVTTMuxContext*)ctx->priv_data; //PLEX
+    AVBPrint bp; //PLEX
 
     if (ctx->nb_streams != 1 || par->codec_id != AV_CODEC_ID_WEBVTT) {
         av_log(ctx, AV_LOG_ERROR, "Exactly one WebVTT stream is needed.\n");
@@ -70,27 +85,36 @@ static int webvtt_write_header(AVFormatContext *ctx)
 
     avpriv_set_pts_info(s, 64, 1, 1000);
 
-    avio_printf(pb, "WEBVTT\n");
     //PLEX
-    avio_printf(pb, "X-TIMESTAMP-MAP=LOCAL:");
-    webvtt_write_time(pb, priv->sync_vtt * 1000);
-    avio_printf(pb, ",MPEGTS:%02"PRId64"\n", priv->sync_mpeg);
+    av_bprint_init_for_buffer(&bp, priv->header, sizeof(priv->header));
+    av_bprintf(&bp, "WEBVTT\n");
+    av_bprintf(&bp, "X-TIMESTAMP-MAP=LOCAL:");
+    webvtt_write_time(&bp, priv->sync_vtt * 1000);
+    av_bprintf(&bp, ",MPEGTS:%02"PRId64"\n", priv->sync_mpeg);
     // Tizen require an additional newline separator to separate the file magic
     // from the rest of the body.
-    avio_printf(pb, "\n");
-    //PLEX
+    av_bprintf(&bp, "\n");
+    priv->header_len = bp.len;
+    if (!priv->cue.size)
+        av_bprint_init(&priv->cue, 0, AV_BPRINT_SIZE_UNLIMITED);
 
-    return 0;
+    return ff_webvtt_write_segment_header(ctx);
+    //PLEX
 }
 
 static int webvtt_write_packet(AVFormatContext *ctx, AVPacket *pkt)
 {
-    AVIOContext  *pb = ctx->pb;
+    WebVTTMuxContext *priv = ctx->priv_data; //PLEX
+    AVBPrint *bp = &priv->cue; //PLEX
     size_t id_size, settings_size;
     int id_size_int, settings_size_int;
     uint8_t *id, *settings;
 
-    avio_printf(pb, "\n");
+    //PLEX
+    /* the whole cue is rendered first and written with a single call */
+    av_bprint_clear(bp);
+    av_bprintf(bp, "\n");
+    //PLEX
 
     id = av_packet_get_side_data(pkt, AV_PKT_DATA_WEBVTT_IDENTIFIER,
                                  &id_size);
@@ -100,11 +124,13 @@ static int webvtt_write_packet(AVFormatContext *ctx, AVPacket *pkt)
 
     id_size_int = id_size;
     if (id && id_size_int > 0)
-        avio_printf(pb, "%.*s\n", id_size_int, id);
+        av_bprintf(bp, "%.*s\n", id_size_int, id); //PLEX
 
-    webvtt_write_time(pb, pkt->pts);
-    avio_printf(pb, " --> ");
-    webvtt_write_time(pb, pkt->pts + pkt->duration);
+    //PLEX
+    webvtt_write_time(bp, pkt->pts);
+    av_bprintf(bp, " --> ");
+    webvtt_write_time(bp, pkt->pts + pkt->duration);
+    //PLEX
 
     settings = av_packet_get_side_data(pkt, AV_PKT_DATA_WEBVTT_SETTINGS,
                                        &settings_size);
@@ -114,16 +140,30 @@ static int webvtt_write_packet(AVFormatContext *ctx, AVPacket *pkt)
 
     settings_size_int = settings_size;
     if (settings && settings_size_int > 0)
-        avio_printf(pb, " %.*s", settings_size_int, settings);
+        av_bprintf(bp, " %.*s", settings_size_int, settings); //PLEX
 
-    avio_printf(pb, "\n");
+    //PLEX
+    av_bprintf(bp, "\n");
+    av_bprint_append_data(bp, pkt->data, pkt->size);
+    av_bprintf(bp, "\n");
+    if (!av_bprint_is_complete(bp))
+        return AVERROR(ENOMEM);
 
-    avio_write(pb, pkt->data, pkt->size);
-    avio_printf(pb, "\n");
+    avio_write(ctx->pb, bp->str, bp->len);
+    //PLEX
 
     return 0;
 }
 
+//PLEX
+static void webvtt_deinit(AVFormatContext *ctx)
+{
+    WebVTTMuxContext *priv = ctx->priv_data;
+
+    av_bprint_finalize(&priv->cue, NULL);
+}
+//PLEX
+
 //PLEX
 #define OFFSET(x) offsetof(WebVTTMuxContext, x)
 #define FLAGS AV_OPT_FLAG_ENCODING_PARAM
@@ -152,4 +192,5 @@ const FFOutputFormat ff_webvtt_muxer = {
     .p.subtitle_codec  = AV_CODEC_ID_WEBVTT,
     .write_header      = webvtt_write_header,
     .write_packet      = webvtt_write_packet,
+    .deinit            = webvtt_deinit, //PLEX
 };
\ No newline at end of file
@@ -0,0 +1,31 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_WEBVTTENC_H
+#define AVFORMAT_WEBVTTENC_H
+
+#include "avformat.h"
+
+/**
+ * Start a new file on ctx->pb of a webvtt muxer whose header has already
+ * been written, by writing the file header again. The muxer stays
+ * initialized, so segmenters can keep one context for all segments.
+ */
+int ff_webvtt_write_segment_header(AVFormatContext *ctx);
+
+#endif /* AVFORMAT_WEBVTTENC_H */
@@ -24,11 +24,14 @@
 #include "aes_ctr.h"
 #include "aes.h"
 #include "aes_internal.h"
+#include "intreadwrite.h"
 #include "macros.h"
 #include "mem.h"
+#include "mem_internal.h"
 #include "random_seed.h"
 
 #define AES_BLOCK_SIZE (16)
+#define CTR_BATCH      (16)
 
 typedef struct AVAESCTR {
     uint8_t counter[AES_BLOCK_SIZE];
@@ -104,6 +107,23 @@ void av_aes_ctr_increment_iv(struct AVAESCTR *a)
     a->block_offset = 0;
 }
 
+/* encrypt nb_blocks counters with one av_aes_crypt() call and xor them in */
+static void aes_ctr_crypt_blocks(struct AVAESCTR *a, uint8_t *dst,
+                                 const uint8_t *src, int nb_blocks)
+{
+    DECLARE_ALIGNED(8, uint8_t, counters)[CTR_BATCH * AES_BLOCK_SIZE];
+    DECLARE_ALIGNED(8, uint8_t, keystream)[CTR_BATCH * AES_BLOCK_SIZE];
+
+    for (int i = 0; i < nb_blocks; i++) {
+        memcpy(counters + i * AES_BLOCK_SIZE, a->counter, AES_BLOCK_SIZE);
+        av_aes_ctr_increment_be64(a->counter + 8);
+    }
+    av_aes_crypt(&a->aes, keystream, counters, nb_blocks, NULL, 0);
+
+    for (int i = 0; i < nb_blocks * AES_BLOCK_SIZE; i += 8)
+        AV_WN64(dst + i, AV_RN64(src + i) ^ AV_RN64A(keystream + i));
+}
+
 void av_aes_ctr_crypt(struct AVAESCTR *a, uint8_t *dst, const uint8_t *src, int count)
 {
     const uint8_t* src_end = src + count;
@@ -111,6 +131,15 @@ void av_aes_ctr_crypt(struct AVAESCTR *a, uint8_t *dst, const uint8_t *src, int
     uint8_t* encrypted_counter_pos;
 
     while (src < src_end) {
+        if (a->block_offset == 0 && src_end - src >= AES_BLOCK_SIZE) {
+            int nb_blocks = FFMIN((src_end - src) / AES_BLOCK_SIZE, CTR_BATCH);
+
+            aes_ctr_crypt_blocks(a, dst, src, nb_blocks);
+            src += nb_blocks * AES_BLOCK_SIZE;
+            dst += nb_blocks * AES_BLOCK_SIZE;
+            continue;
+        }
+
         if (a->block_offset == 0) {
             av_aes_crypt(&a->aes, a->encrypted_counter, a->counter, 1, NULL, 0);
 
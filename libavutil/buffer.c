@@ -24,6 +24,7 @@
 #include "buffer_internal.h"
 #include "common.h"
 #include "mem.h"
+#include "mem_internal.h" //PLEX
 #include "thread.h"
 
 static AVBufferRef *buffer_create(AVBuffer *buf, uint8_t *data, size_t size,
@@ -256,6 +257,60 @@ int av_buffer_replace(AVBufferRef **pdst, const AVBufferRef *src)
     return 0;
 }
 
+//PLEX
+static void pool_cache_init(AVBufferPool *pool)
+{
+    atomic_init(&pool->in_use, 0);
+    atomic_init(&pool->high_water, 0);
+    for (int i = 0; i < POOL_CACHE_SIZE; i++)
+        atomic_init(&pool->cache[i], 0);
+}
+
+static BufferPoolEntry *pool_cache_take(AVBufferPool *pool)
+{
+    for (int i = 0; i < POOL_CACHE_SIZE; i++) {
+        uintptr_t buf;
+
+        if (!atomic_load_explicit(&pool->cache[i], memory_order_relaxed))
+            continue;
+        buf = atomic_exchange_explicit(&pool->cache[i], 0, memory_order_acquire);
+        if (buf)
+            return (BufferPoolEntry *)buf;
+    }
+    return NULL;
+}
+
+static int pool_cache_put(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    /* spread the releasing threads over the slots */
+    int start = ((uintptr_t)buf / sizeof(*buf)) % POOL_CACHE_SIZE;
+
+    for (int i = 0; i < POOL_CACHE_SIZE; i++) {
+        atomic_uintptr_t *slot = &pool->cache[(start + i) % POOL_CACHE_SIZE];
+        uintptr_t empty = 0;
+
+        if (!atomic_load_explicit(slot, memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(slot, &empty, (uintptr_t)buf,
+                                                    memory_order_release,
+                                                    memory_order_relaxed))
+            return 1;
+    }
+    return 0;
+}
+
+/* Move the cached entries to the pool list; called with the mutex held. */
+static void pool_cache_drain(AVBufferPool *pool)
+{
+    BufferPoolEntry *buf;
+
+    while ((buf = pool_cache_take(pool))) {
+        buf->next  = pool->pool;
+        pool->pool = buf;
+        pool->nb_free++;
+    }
+}
+//PLEX
+
 AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, size_t size),
                                    void (*pool_free)(void *opaque))
@@ -276,6 +331,7 @@ AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
     pool->pool_free = pool_free;
 
     atomic_init(&pool->refcount, 1);
+    pool_cache_init(pool); //PLEX
 
     return pool;
 }
@@ -295,19 +351,23 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
     atomic_init(&pool->refcount, 1);
+    pool_cache_init(pool); //PLEX
 
     return pool;
 }
 
 static void buffer_pool_flush(AVBufferPool *pool)
 {
+    pool_cache_drain(pool); //PLEX
     while (pool->pool) {
         BufferPoolEntry *buf = pool->pool;
         pool->pool = buf->next;
 
         buf->free(buf->opaque, buf->data);
         av_freep(&buf);
+        pool->nb_allocated--; //PLEX
     }
+    pool->nb_free = 0; //PLEX
 }
 
 /*
@@ -347,10 +407,16 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     BufferPoolEntry *buf = opaque;
     AVBufferPool *pool = buf->pool;
 
+    //PLEX
+    atomic_fetch_sub_explicit(&pool->in_use, 1, memory_order_relaxed);
+    if (!pool_cache_put(pool, buf)) {
+    //PLEX
     ff_mutex_lock(&pool->mutex);
     buf->next = pool->pool;
     pool->pool = buf;
+    pool->nb_free++; //PLEX
     ff_mutex_unlock(&pool->mutex);
+    } //PLEX
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -362,11 +428,14 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 {
     BufferPoolEntry *buf;
     AVBufferRef     *ret;
+    int tag;
 
     av_assert0(pool->alloc || pool->alloc2);
 
+    tag = avpriv_mem_tag_push(AV_MEM_TAG_BUFFER_POOL); //PLEX
     ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
                          pool->alloc(pool->size);
+    avpriv_mem_tag_pop(tag); //PLEX
     if (!ret)
         return NULL;
 
@@ -389,24 +458,55 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
-    AVBufferRef *ret;
+    AVBufferRef *ret = NULL;
     BufferPoolEntry *buf;
+    //PLEX
+    int in_use, high_water;
+
+    /* Only the list and the allocation need the mutex; the AVBufferRef is
+     * created outside of it. The alloc callbacks may rely on being called
+     * under the mutex, so they still are. */
+    buf = pool_cache_take(pool);
+    if (!buf) {
+        ff_mutex_lock(&pool->mutex);
+        buf = pool->pool;
+        if (buf) {
+            pool->pool = buf->next;
+            pool->nb_free--;
+        } else {
+            ret = pool_alloc_buffer(pool);
+            if (ret)
+                pool->nb_allocated++;
+        }
+        ff_mutex_unlock(&pool->mutex);
+    }
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
     if (buf) {
+        buf->next = NULL;
         memset(&buf->buffer, 0, sizeof(buf->buffer));
         ret = buffer_create(&buf->buffer, buf->data, pool->size,
                             pool_release_buffer, buf, 0);
         if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
             buf->buffer.flags_internal |= BUFFER_FLAG_NO_FREE;
+        } else {
+            ff_mutex_lock(&pool->mutex);
+            buf->next  = pool->pool;
+            pool->pool = buf;
+            pool->nb_free++;
+            ff_mutex_unlock(&pool->mutex);
         }
-    } else {
-        ret = pool_alloc_buffer(pool);
     }
-    ff_mutex_unlock(&pool->mutex);
+
+    if (ret) {
+        in_use     = atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed) + 1;
+        high_water = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+        while (in_use > high_water &&
+               !atomic_compare_exchange_weak_explicit(&pool->high_water, &high_water, in_use,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            ;
+    }
+    //PLEX
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
@@ -414,6 +514,50 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     return ret;
 }
 
+//PLEX
+void ff_buffer_pool_stats(AVBufferPool *pool, int *nb_allocated,
+                          int *nb_in_use, int *high_water)
+{
+    ff_mutex_lock(&pool->mutex);
+    *nb_allocated = pool->nb_allocated;
+    ff_mutex_unlock(&pool->mutex);
+    *nb_in_use    = atomic_load_explicit(&pool->in_use, memory_order_relaxed);
+    *high_water   = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+}
+
+int ff_buffer_pool_trim(AVBufferPool *pool, int spare)
+{
+    BufferPoolEntry *list = NULL;
+    int nb_freed = 0;
+
+    ff_mutex_lock(&pool->mutex);
+    pool_cache_drain(pool);
+    while (pool->pool && pool->nb_allocated - nb_freed >
+           atomic_load_explicit(&pool->high_water, memory_order_relaxed) + spare) {
+        BufferPoolEntry *buf = pool->pool;
+        pool->pool = buf->next;
+        buf->next  = list;
+        list       = buf;
+        nb_freed++;
+    }
+    pool->nb_allocated -= nb_freed;
+    pool->nb_free      -= nb_freed;
+    atomic_store_explicit(&pool->high_water,
+                          atomic_load_explicit(&pool->in_use, memory_order_relaxed),
+                          memory_order_relaxed);
+    ff_mutex_unlock(&pool->mutex);
+
+    /* the free callbacks may be slow, e.g. for device memory */
+    while (list) {
+        BufferPoolEntry *buf = list;
+        list = buf->next;
+        buf->free(buf->opaque, buf->data);
+        av_free(buf);
+    }
+    return nb_freed;
+}
+//PLEX
+
 void *av_buffer_pool_buffer_get_opaque(const AVBufferRef *ref)
 {
     BufferPoolEntry *buf = ref->buffer->opaque;
@@ -65,6 +65,10 @@ struct AVBuffer {
     int flags_internal;
 };
 
+//PLEX
+#define POOL_CACHE_SIZE 8
+//PLEX
+
 typedef struct BufferPoolEntry {
     uint8_t *data;
 
@@ -105,6 +109,41 @@ struct AVBufferPool {
     AVBufferRef* (*alloc)(size_t size);
     AVBufferRef* (*alloc2)(void *opaque, size_t size);
     void         (*pool_free)(void *opaque);
+
+    //PLEX
+    /* protected by mutex */
+    int nb_allocated;
+    int nb_free;        /* entries in the pool list */
+
+    atomic_int in_use;
+    atomic_int high_water; /* most buffers in use since the last trim */
+
+    /*
+     * Released entries are parked here without taking the mutex and taken
+     * back by av_buffer_pool_get() the same way; the list is only used when
+     * all slots are full or empty. A slot only goes from empty to an entry
+     * by compare-and-swap and back by exchange, so there is no ABA problem.
+     */
+    atomic_uintptr_t cache[POOL_CACHE_SIZE];
+    //PLEX
 };
 
+//PLEX
+/**
+ * Get the number of buffers allocated by the pool, the number currently in
+ * use, and the most that were in use at once since the last trim.
+ */
+void ff_buffer_pool_stats(AVBufferPool *pool, int *nb_allocated,
+                          int *nb_in_use, int *high_water);
+
+/**
+ * Free unused buffers so that no more than spare buffers are kept in
+ * addition to the most that were in use at once since the last trim, then
+ * restart high water mark tracking.
+ *
+ * @return the number of buffers freed
+ */
+int ff_buffer_pool_trim(AVBufferPool *pool, int spare);
+//PLEX
+
 #endif /* AVUTIL_BUFFER_INTERNAL_H */
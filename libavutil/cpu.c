@@ -48,6 +48,11 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+//PLEX
+#if HAVE_SCHED_GETAFFINITY && defined(__linux__)
+#include <sys/syscall.h>
+#endif
+//PLEX
 
 static atomic_int cpu_flags = ATOMIC_VAR_INIT(-1);
 static atomic_int cpu_count = ATOMIC_VAR_INIT(-1);
@@ -265,6 +270,84 @@ void av_cpu_force_count(int count)
     atomic_store_explicit(&cpu_count, count, memory_order_relaxed);
 }
 
+//PLEX
+#if HAVE_SCHED_GETAFFINITY && defined(CPU_SET) && defined(__linux__)
+#define NUMA_MPOL_PREFERRED 1
+
+static int parse_cpulist(const char *list, cpu_set_t *cpuset)
+{
+    const char *p = list;
+    int count = 0;
+
+    CPU_ZERO(cpuset);
+    while (*p && *p != '\n') {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+
+        if (end == p || first < 0)
+            return AVERROR_INVALIDDATA;
+        if (*end == '-') {
+            p    = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+                return AVERROR_INVALIDDATA;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++, count++)
+            CPU_SET(cpu, cpuset);
+        p = end + (*end == ',');
+    }
+    return count;
+}
+
+int av_cpu_bind_numa_node(int node)
+{
+    char path[64], list[4096];
+    unsigned long nodemask[16] = { 0 };
+    const int bits = 8 * sizeof(*nodemask);
+    cpu_set_t cpuset;
+    FILE *f;
+    int ret;
+
+    if (node < 0 || node >= FF_ARRAY_ELEMS(nodemask) * bits)
+        return AVERROR(EINVAL);
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    f = fopen(path, "r");
+    if (!f)
+        return AVERROR(errno == ENOENT ? EINVAL : errno);
+    ret = fgets(list, sizeof(list), f) ? 0 : AVERROR(EIO);
+    fclose(f);
+    if (ret < 0)
+        return ret;
+
+    ret = parse_cpulist(list, &cpuset);
+    if (ret <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "NUMA node %d has no usable CPUs\n", node);
+        return ret < 0 ? ret : AVERROR(EINVAL);
+    }
+    if (sched_setaffinity(0, sizeof(cpuset), &cpuset) < 0)
+        return AVERROR(errno);
+
+    /* Only a preference, so that allocations still succeed when the node
+     * runs out of memory. */
+    nodemask[node / bits] = 1UL << (node % bits);
+    if (syscall(SYS_set_mempolicy, NUMA_MPOL_PREFERRED, nodemask,
+                FF_ARRAY_ELEMS(nodemask) * bits + 1) < 0)
+        av_log(NULL, AV_LOG_WARNING, "Could not prefer the memory of NUMA "
+               "node %d: %s\n", node, av_err2str(AVERROR(errno)));
+
+    av_log(NULL, AV_LOG_VERBOSE, "Bound to the %d CPUs of NUMA node %d\n",
+           ret, node);
+    return 0;
+}
+#else
+int av_cpu_bind_numa_node(int node)
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+//PLEX
+
 size_t av_cpu_max_align(void)
 {
 #if ARCH_MIPS
@@ -123,6 +123,21 @@ int av_cpu_count(void);
  */
 void av_cpu_force_count(int count);
 
+//PLEX
+/**
+ * Bind the calling thread to the CPUs of a NUMA node and make it prefer
+ * memory from that node. Threads created by the calling thread afterwards,
+ * including codec, filter and slice threads, inherit both, and
+ * av_cpu_count() then only counts the CPUs of the node. Call it before
+ * opening any codec or filter graph.
+ *
+ * @param node NUMA node index
+ * @return 0 on success, AVERROR(ENOSYS) if not supported on this system,
+ *         another negative AVERROR code on failure
+ */
+int av_cpu_bind_numa_node(int node);
+//PLEX
+
 /**
  * Get the maximum data alignment that may be required by FFmpeg.
  *
@@ -19,6 +19,7 @@
  */
 
 #include <inttypes.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -31,11 +32,124 @@
 #include "time_internal.h"
 #include "bprint.h"
 
+//PLEX
+/* Dictionaries past this many entries get a hash index next to elems. */
+#define DICT_HASH_MIN_COUNT 16
+
+#define DICT_SLOT_EMPTY   -1
+#define DICT_SLOT_DELETED -2
+
+typedef struct DictHashSlot {
+    uint32_t hash;
+    int idx;                    ///< index into elems or DICT_SLOT_*
+} DictHashSlot;
+//PLEX
+
 struct AVDictionary {
     int count;
     AVDictionaryEntry *elems;
+    //PLEX
+    DictHashSlot *hash;         ///< open addressing index, may be NULL
+    unsigned hash_mask;
+    int hash_used;              ///< non-empty slots, including deleted ones
+    //PLEX
 };
 
+//PLEX
+/* Case-folded FNV-1a, so both matching modes can use the same index. */
+static uint32_t dict_hash(const char *key)
+{
+    uint32_t h = 2166136261U;
+    while (*key)
+        h = (h ^ av_toupper((uint8_t)*key++)) * 16777619U;
+    return h;
+}
+
+static void dict_hash_insert(AVDictionary *m, uint32_t h, int idx)
+{
+    unsigned i = h & m->hash_mask;
+
+    while (m->hash[i].idx >= 0)
+        i = (i + 1) & m->hash_mask;
+    if (m->hash[i].idx == DICT_SLOT_EMPTY)
+        m->hash_used++;
+    m->hash[i].hash = h;
+    m->hash[i].idx  = idx;
+}
+
+static void dict_hash_rebuild(AVDictionary *m)
+{
+    unsigned size = 64;
+
+    while (size < 4U * m->count)
+        size <<= 1;
+
+    av_freep(&m->hash);
+    m->hash = av_malloc_array(size, sizeof(*m->hash));
+    if (!m->hash)
+        return; // lookups fall back to the linear scan
+    for (unsigned i = 0; i < size; i++)
+        m->hash[i].idx = DICT_SLOT_EMPTY;
+    m->hash_mask = size - 1;
+    m->hash_used = 0;
+    for (int i = 0; i < m->count; i++)
+        dict_hash_insert(m, dict_hash(m->elems[i].key), i);
+}
+
+/* Called after elems[count - 1] has been appended. */
+static void dict_hash_add(AVDictionary *m)
+{
+    if (!m->hash && m->count < DICT_HASH_MIN_COUNT)
+        return;
+    if (!m->hash || 2 * (m->hash_used + 1) > m->hash_mask + 1)
+        dict_hash_rebuild(m);
+    else
+        dict_hash_insert(m, dict_hash(m->elems[m->count - 1].key), m->count - 1);
+}
+
+static DictHashSlot *dict_hash_slot(AVDictionary *m, int idx)
+{
+    unsigned i = dict_hash(m->elems[idx].key) & m->hash_mask;
+
+    while (m->hash[i].idx != idx) {
+        av_assert2(m->hash[i].idx != DICT_SLOT_EMPTY);
+        i = (i + 1) & m->hash_mask;
+    }
+    return &m->hash[i];
+}
+
+/* Called before elems[idx] is replaced by the last entry. */
+static void dict_hash_remove(AVDictionary *m, int idx)
+{
+    if (!m->hash)
+        return;
+    dict_hash_slot(m, idx)->idx = DICT_SLOT_DELETED;
+    if (idx != m->count - 1)
+        dict_hash_slot(m, m->count - 1)->idx = idx;
+}
+
+static AVDictionaryEntry *dict_hash_get(const AVDictionary *m, const char *key,
+                                        int flags)
+{
+    uint32_t h = dict_hash(key);
+    int best = -1;
+
+    /* Keep scanning the chain: the first match in insertion order wins. */
+    for (unsigned i = h & m->hash_mask; m->hash[i].idx != DICT_SLOT_EMPTY;
+         i = (i + 1) & m->hash_mask) {
+        const DictHashSlot *slot = &m->hash[i];
+        const char *s;
+
+        if (slot->idx < 0 || slot->hash != h || (best >= 0 && slot->idx > best))
+            continue;
+        s = m->elems[slot->idx].key;
+        if (flags & AV_DICT_MATCH_CASE ? !strcmp(s, key) : !av_strcasecmp(s, key))
+            best = slot->idx;
+    }
+    return best >= 0 ? &m->elems[best] : NULL;
+}
+//PLEX
+
 int av_dict_count(const AVDictionary *m)
 {
     return m ? m->count : 0;
@@ -68,6 +182,11 @@ AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
     if (!key)
         return NULL;
 
+    //PLEX
+    if (!prev && m && m->hash && !(flags & AV_DICT_IGNORE_SUFFIX))
+        return dict_hash_get(m, key, flags);
+    //PLEX
+
     while ((entry = av_dict_iterate(m, entry))) {
         const char *s = entry->key;
         if (flags & AV_DICT_MATCH_CASE)
@@ -131,6 +250,7 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             copy_value = newval;
         } else
             av_free(tag->value);
+        dict_hash_remove(m, tag - m->elems); //PLEX
         av_free(tag->key);
         *tag = m->elems[--m->count];
     } else if (copy_value) {
@@ -144,9 +264,11 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
         m->elems[m->count].key = copy_key;
         m->elems[m->count].value = copy_value;
         m->count++;
+        dict_hash_add(m); //PLEX
     } else {
         if (!m->count) {
             av_freep(&m->elems);
+            av_freep(&m->hash); //PLEX
             av_freep(pm);
         }
         av_freep(&copy_key);
@@ -159,6 +281,7 @@ enomem:
 err_out:
     if (m && !m->count) {
         av_freep(&m->elems);
+        av_freep(&m->hash); //PLEX
         av_freep(pm);
     }
     av_free(copy_key);
@@ -232,6 +355,7 @@ void av_dict_free(AVDictionary **pm)
             av_freep(&m->elems[m->count].value);
         }
         av_freep(&m->elems);
+        av_freep(&m->hash); //PLEX
     }
     av_freep(pm);
 }
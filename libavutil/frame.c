@@ -16,6 +16,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h> //PLEX
+
 #include "channel_layout.h"
 #include "avassert.h"
 #include "buffer.h"
@@ -27,6 +29,7 @@
 #include "mem.h"
 #include "samplefmt.h"
 #include "hwcontext.h"
+#include "thread.h"
 
 #if FF_API_OLD_CHANNEL_LAYOUT
 #define CHECK_CHANNELS_CONSISTENCY(frame) \
@@ -809,12 +812,68 @@ AVFrameSideData *av_frame_new_side_data_from_buf(AVFrame *frame,
     return ret;
 }
 
+//PLEX
+/*
+ * Most side data has a small fixed-size payload (mastering display, light
+ * level, HDR10+, captions...) attached to every frame; take it from
+ * process-wide pools by size class, so that in the steady state only the
+ * AVBufferRef is allocated instead of the payload and its AVBuffer too.
+ * Each pool keeps at most SIDE_DATA_POOL_MAX buffers and lives as long as
+ * the process, past that payloads are allocated as before. Payloads always
+ * start zeroed, whether reused or not.
+ */
+#define SIDE_DATA_POOL_MAX 64
+
+static const size_t side_data_pool_sizes[] = { 128, 2048, 16384 };
+static AVBufferPool *side_data_pools[FF_ARRAY_ELEMS(side_data_pool_sizes)];
+static atomic_int side_data_pool_nb[FF_ARRAY_ELEMS(side_data_pool_sizes)];
+static AVOnce side_data_pools_once = AV_ONCE_INIT;
+
+static AVBufferRef *side_data_pool_alloc(void *opaque, size_t size)
+{
+    atomic_int *nb = opaque;
+
+    if (atomic_fetch_add_explicit(nb, 1, memory_order_relaxed) >= SIDE_DATA_POOL_MAX) {
+        atomic_fetch_sub_explicit(nb, 1, memory_order_relaxed);
+        return NULL;
+    }
+    return av_buffer_alloc(size);
+}
+
+static void side_data_pools_init(void)
+{
+    for (int i = 0; i < FF_ARRAY_ELEMS(side_data_pools); i++)
+        side_data_pools[i] = av_buffer_pool_init2(side_data_pool_sizes[i],
+                                                  &side_data_pool_nb[i],
+                                                  side_data_pool_alloc, NULL);
+}
+
+static AVBufferRef *side_data_alloc(size_t size)
+{
+    ff_thread_once(&side_data_pools_once, side_data_pools_init);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(side_data_pools); i++) {
+        if (size <= side_data_pool_sizes[i] && side_data_pools[i]) {
+            AVBufferRef *buf = av_buffer_pool_get(side_data_pools[i]);
+            if (buf) {
+                /* reused buffers still hold the previous payload */
+                buf->size = size;
+                memset(buf->data, 0, size);
+                return buf;
+            }
+            break;
+        }
+    }
+    return av_buffer_allocz(size);
+}
+//PLEX
+
 AVFrameSideData *av_frame_new_side_data(AVFrame *frame,
                                         enum AVFrameSideDataType type,
                                         size_t size)
 {
     AVFrameSideData *ret;
-    AVBufferRef *buf = av_buffer_alloc(size);
+    AVBufferRef *buf = side_data_alloc(size); //PLEX
     ret = av_frame_new_side_data_from_buf(frame, type, buf);
     if (!ret)
         av_buffer_unref(&buf);
@@ -958,6 +1017,7 @@ const char *av_frame_side_data_name(enum AVFrameSideDataType type)
     case AV_FRAME_DATA_DOVI_RPU_BUFFER:             return "Dolby Vision RPU Data";
     case AV_FRAME_DATA_DOVI_METADATA:               return "Dolby Vision Metadata";
     case AV_FRAME_DATA_AMBIENT_VIEWING_ENVIRONMENT: return "Ambient viewing environment";
+    case AV_FRAME_DATA_ENCODE_ANALYSIS:             return "Encode analysis"; //PLEX
     }
     return NULL;
 }
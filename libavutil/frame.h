@@ -224,6 +224,15 @@ enum AVFrameSideDataType {
      * encoding.
      */
     AV_FRAME_DATA_VIDEO_HINT,
+
+    //PLEX
+    /**
+     * Result of a shared analysis pass, in the form of an AVEncodeAnalysis.
+     * Attached before the frame is sent to several encoders so that they
+     * use the same frame types and skip their own scene cut detection.
+     */
+    AV_FRAME_DATA_ENCODE_ANALYSIS,
+    //PLEX
 };
 
 enum AVActiveFormatDescription {
@@ -307,6 +316,28 @@ typedef struct AVRegionOfInterest {
     AVRational qoffset;
 } AVRegionOfInterest;
 
+//PLEX
+/**
+ * Per-frame analysis shared by encoders, see AV_FRAME_DATA_ENCODE_ANALYSIS.
+ */
+typedef struct AVEncodeAnalysis {
+    /**
+     * Frame type to encode with: AV_PICTURE_TYPE_I for keyframes, or
+     * AV_PICTURE_TYPE_NONE to leave the decision to the encoder.
+     */
+    enum AVPictureType pict_type;
+    /**
+     * Whether the frame starts a new scene.
+     */
+    int scene_cut;
+    /**
+     * Mean absolute difference to the previous frame, in percent of the
+     * sample range. Higher values need more bits to encode.
+     */
+    float complexity;
+} AVEncodeAnalysis;
+//PLEX
+
 /**
  * This structure describes decoded (raw) audio or video data.
  *
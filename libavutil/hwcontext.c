@@ -20,6 +20,7 @@
 
 #include "avassert.h"
 #include "buffer.h"
+#include "buffer_internal.h"
 #include "common.h"
 #include "hwcontext.h"
 #include "hwcontext_internal.h"
@@ -504,6 +505,47 @@ int av_hwframe_transfer_data(AVFrame *dst, const AVFrame *src, int flags)
     return 0;
 }
 
+//PLEX
+int av_hwframe_ctx_get_pool_stats(AVBufferRef *hwframe_ref, AVHWFramesPoolStats *stats)
+{
+    AVHWFramesContext *ctx = (AVHWFramesContext*)hwframe_ref->data;
+    AVBufferPool *pool = ctx->internal->pool_internal;
+    int size;
+
+    if (!pool || ctx->pool != pool)
+        return AVERROR(ENOSYS);
+
+    ff_buffer_pool_stats(pool, &stats->nb_allocated, &stats->nb_in_use,
+                         &stats->high_water);
+    size = av_image_get_buffer_size(ctx->sw_format, ctx->width, ctx->height, 1);
+    stats->mem_size = size > 0 ? (int64_t)size * stats->nb_allocated : 0;
+    return 0;
+}
+
+int av_hwframe_ctx_trim_pool(AVBufferRef *hwframe_ref, int spare)
+{
+    AVHWFramesContext *ctx = (AVHWFramesContext*)hwframe_ref->data;
+    AVBufferPool *pool = ctx->internal->pool_internal;
+
+    if (!pool || ctx->pool != pool)
+        return AVERROR(ENOSYS);
+    /* surfaces of fixed pools are registered once and cannot be replaced */
+    switch (ctx->device_ctx->type) {
+    case AV_HWDEVICE_TYPE_VAAPI:
+    case AV_HWDEVICE_TYPE_D3D11VA:
+        if (ctx->initial_pool_size > 0)
+            return 0;
+        break;
+    case AV_HWDEVICE_TYPE_DXVA2:
+    case AV_HWDEVICE_TYPE_QSV:
+        return 0;
+    default:
+        break;
+    }
+    return ff_buffer_pool_trim(pool, FFMAX(spare, 0));
+}
+//PLEX
+
 int av_hwframe_get_buffer(AVBufferRef *hwframe_ref, AVFrame *frame, int flags)
 {
     AVHWFramesContext *ctx = (AVHWFramesContext*)hwframe_ref->data;
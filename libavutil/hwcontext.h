@@ -381,6 +381,42 @@ int av_hwframe_ctx_init(AVBufferRef *ref);
  */
 int av_hwframe_get_buffer(AVBufferRef *hwframe_ctx, AVFrame *frame, int flags);
 
+//PLEX
+/**
+ * Usage of the frame pool of an AVHWFramesContext.
+ */
+typedef struct AVHWFramesPoolStats {
+    int nb_allocated;   ///< surfaces currently allocated
+    int nb_in_use;      ///< surfaces currently referenced by frames
+    int high_water;     ///< most surfaces in use at once since the last trim
+    /**
+     * Estimated device memory held by the allocated surfaces, in bytes,
+     * from the size of the surfaces in the software format.
+     */
+    int64_t mem_size;
+} AVHWFramesPoolStats;
+
+/**
+ * Get the usage of the frame pool allocated internally by libavutil.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the pool was supplied by the
+ *         caller or frames are allocated in a source frames context
+ */
+int av_hwframe_ctx_get_pool_stats(AVBufferRef *hwframe_ctx, AVHWFramesPoolStats *stats);
+
+/**
+ * Release unused surfaces of a dynamically sized internal frame pool, so
+ * that only spare surfaces are kept in addition to the high water mark, and
+ * start tracking a new high water mark. Pools of a fixed size, where the
+ * device type requires it, are left untouched.
+ *
+ * This may be called from any thread.
+ *
+ * @return the number of surfaces released, or a negative AVERROR code
+ */
+int av_hwframe_ctx_trim_pool(AVBufferRef *hwframe_ctx, int spare);
+//PLEX
+
 /**
  * Copy data to or from a hw surface. At least one of dst/src must have an
  * AVHWFramesContext attached.
@@ -405,6 +405,7 @@ end:
 
 static void (*av_log_callback)(void*, int, const char*, va_list) =
     av_log_default_callback;
+static int av_log_callback_level = INT_MAX; //PLEX
 
 void av_log(void* avcl, int level, const char *fmt, ...)
 {
@@ -430,6 +431,11 @@ void av_vlog(void* avcl, int level, const char *fmt, va_list vl)
     if (avc && avc->version >= (50 << 16 | 15 << 8 | 2) &&
         avc->log_level_offset_offset && level >= AV_LOG_FATAL)
         level += *(int *) (((uint8_t *) avcl) + avc->log_level_offset_offset);
+    //PLEX
+    // nothing would be emitted, skip the callback and its formatting
+    if ((level >= 0 ? level & 0xff : level) > av_log_get_effective_level())
+        return;
+    //PLEX
     if (log_callback)
         log_callback(avcl, level, fmt, vl);
 }
@@ -439,6 +445,20 @@ int av_log_get_level(void)
     return av_log_level;
 }
 
+//PLEX
+int av_log_get_effective_level(void)
+{
+    if (av_log_callback == av_log_default_callback)
+        return av_log_level;
+    return FFMAX(av_log_level, av_log_callback_level);
+}
+
+void av_log_set_callback_level(int level)
+{
+    av_log_callback_level = level;
+}
+//PLEX
+
 void av_log_set_level(int level)
 {
     av_log_level = level;
@@ -457,6 +477,7 @@ int av_log_get_flags(void)
 void av_log_set_callback(void (*callback)(void*, int, const char*, va_list))
 {
     av_log_callback = callback;
+    av_log_callback_level = INT_MAX; //PLEX
 }
 
 static void missing_feature_sample(int sample, void *avc, const char *msg,
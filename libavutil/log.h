@@ -306,6 +306,25 @@ void av_log_set_level(int level);
  */
 void av_log_set_callback(void (*callback)(void*, int, const char*, va_list));
 
+//PLEX
+/**
+ * Tell av_log() the most verbose level the current callback emits on its
+ * own sinks, in addition to what it prints at the av_log_set_level() level.
+ * Messages above both levels are then dropped before the callback is
+ * called. Reset to "everything" by av_log_set_callback().
+ *
+ * @param level Logging level, INT_MAX to pass every message to the callback
+ */
+void av_log_set_callback_level(int level);
+
+/**
+ * Get the most verbose level for which av_log() still calls the callback,
+ * combining av_log_set_level() and av_log_set_callback_level(). Callers can
+ * test it to skip building expensive messages nobody will see.
+ */
+int av_log_get_effective_level(void);
+//PLEX
+
 /**
  * Default logging callback
  *
@@ -28,6 +28,12 @@
 
 #include "config.h"
 
+//PLEX
+#if HAVE_MADVISE
+#define _DEFAULT_SOURCE // for madvise() and MADV_HUGEPAGE with glibc
+#endif
+//PLEX
+
 #include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -36,6 +42,11 @@
 #if HAVE_MALLOC_H
 #include <malloc.h>
 #endif
+//PLEX
+#if HAVE_MADVISE
+#include <sys/mman.h>
+#endif
+//PLEX
 
 #include "attributes.h"
 #include "avassert.h"
@@ -45,6 +56,7 @@
 #include "intreadwrite.h"
 #include "macros.h"
 #include "mem.h"
+#include "mem_internal.h" //PLEX
 
 #ifdef MALLOC_PREFIX
 
@@ -75,6 +87,112 @@ void av_max_alloc(size_t max){
     atomic_store_explicit(&max_alloc_size, max, memory_order_relaxed);
 }
 
+//PLEX
+#if HAVE_POSIX_MEMALIGN && HAVE_MADVISE && defined(MADV_HUGEPAGE)
+#define HUGE_PAGE_SIZE (2 << 20)
+#endif
+
+static atomic_size_t huge_page_min_size = ATOMIC_VAR_INIT(0);
+
+void av_huge_page_alloc(size_t min_size)
+{
+    atomic_store_explicit(&huge_page_min_size, min_size, memory_order_relaxed);
+}
+
+static const char *const mem_tag_names[AV_MEM_TAG_NB] = {
+    [AV_MEM_TAG_OTHER]       = "other",
+    [AV_MEM_TAG_CODEC]       = "codec",
+    [AV_MEM_TAG_FILTER]      = "filter",
+    [AV_MEM_TAG_FORMAT]      = "format",
+    [AV_MEM_TAG_BUFFER_POOL] = "buffer pool",
+};
+
+const char *av_mem_tag_name(enum AVMemTag tag)
+{
+    return (unsigned)tag < AV_MEM_TAG_NB ? mem_tag_names[tag] : NULL;
+}
+
+#if CONFIG_MEMORY_ACCOUNTING
+/* Every block is preceded by ALIGN bytes holding its size and tag, so the
+ * pointers handed out keep their alignment. */
+typedef struct MemHeader {
+    size_t size;
+    int    tag;
+} MemHeader;
+
+static atomic_size_t mem_usage[AV_MEM_TAG_NB];
+static atomic_size_t mem_peak[AV_MEM_TAG_NB];
+static _Thread_local int mem_tag;
+
+static void mem_account(int tag, size_t add, size_t sub)
+{
+    size_t cur  = atomic_fetch_add_explicit(&mem_usage[tag], add - sub,
+                                            memory_order_relaxed) + add - sub;
+    size_t peak = atomic_load_explicit(&mem_peak[tag], memory_order_relaxed);
+
+    while (cur > peak &&
+           !atomic_compare_exchange_weak_explicit(&mem_peak[tag], &peak, cur,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+static void *mem_block_init(void *block, size_t size, int tag)
+{
+    MemHeader *h = block;
+
+    if (!block)
+        return NULL;
+    h->size = size;
+    h->tag  = tag;
+    mem_account(tag, size, 0);
+    return (uint8_t *)block + ALIGN;
+}
+
+static void *mem_block(void *ptr)
+{
+    return ptr ? (uint8_t *)ptr - ALIGN : NULL;
+}
+
+int avpriv_mem_tag_push(enum AVMemTag tag)
+{
+    int prev = mem_tag;
+    mem_tag = tag;
+    return prev;
+}
+
+void avpriv_mem_tag_pop(int prev)
+{
+    mem_tag = prev;
+}
+
+int av_mem_get_usage(enum AVMemTag tag, size_t *current, size_t *peak)
+{
+    if ((unsigned)tag >= AV_MEM_TAG_NB)
+        return AVERROR(EINVAL);
+    if (current)
+        *current = atomic_load_explicit(&mem_usage[tag], memory_order_relaxed);
+    if (peak)
+        *peak = atomic_load_explicit(&mem_peak[tag], memory_order_relaxed);
+    return 0;
+}
+#else
+int avpriv_mem_tag_push(enum AVMemTag tag)
+{
+    return 0;
+}
+
+void avpriv_mem_tag_pop(int prev)
+{
+}
+
+int av_mem_get_usage(enum AVMemTag tag, size_t *current, size_t *peak)
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+//PLEX
+
 static int size_mult(size_t a, size_t b, size_t *r)
 {
     size_t t;
@@ -96,11 +214,29 @@ static int size_mult(size_t a, size_t b, size_t *r)
 void *av_malloc(size_t size)
 {
     void *ptr = NULL;
+#ifdef HUGE_PAGE_SIZE
+    size_t huge_min = atomic_load_explicit(&huge_page_min_size, memory_order_relaxed); //PLEX
+#endif
 
     if (size > atomic_load_explicit(&max_alloc_size, memory_order_relaxed))
         return NULL;
+#if CONFIG_MEMORY_ACCOUNTING //PLEX
+    size += ALIGN;
+#endif
 
 #if HAVE_POSIX_MEMALIGN
+    //PLEX
+#ifdef HUGE_PAGE_SIZE
+    /* Align large blocks, e.g. 4K frame planes, to the huge page size so
+     * that transparent huge pages can back all of them. */
+    if (huge_min && size >= FFMAX(huge_min, HUGE_PAGE_SIZE)) {
+        if (posix_memalign(&ptr, HUGE_PAGE_SIZE, size))
+            ptr = NULL;
+        else
+            madvise(ptr, size, MADV_HUGEPAGE);
+    } else
+#endif
+    //PLEX
     if (size) //OS X on SDK 10.6 has a broken posix_memalign implementation
     if (posix_memalign(&ptr, ALIGN, size))
         ptr = NULL;
@@ -143,6 +279,10 @@ void *av_malloc(size_t size)
         size = 1;
         ptr= av_malloc(1);
     }
+#if CONFIG_MEMORY_ACCOUNTING //PLEX
+    size -= ALIGN;
+    ptr   = mem_block_init(ptr, size, mem_tag);
+#endif
 #if CONFIG_MEMORY_POISONING
     if (ptr)
         memset(ptr, FF_MEMORY_POISON, size);
@@ -153,14 +293,31 @@ void *av_malloc(size_t size)
 void *av_realloc(void *ptr, size_t size)
 {
     void *ret;
+#if CONFIG_MEMORY_ACCOUNTING //PLEX
+    MemHeader old = { 0, mem_tag };
+#endif
     if (size > atomic_load_explicit(&max_alloc_size, memory_order_relaxed))
         return NULL;
 
+#if CONFIG_MEMORY_ACCOUNTING //PLEX
+    if (ptr)
+        old = *(MemHeader *)mem_block(ptr);
+    ptr   = mem_block(ptr);
+    size += ALIGN;
+#endif
+
 #if HAVE_ALIGNED_MALLOC
     ret = _aligned_realloc(ptr, size + !size, ALIGN);
 #else
     ret = realloc(ptr, size + !size);
 #endif
+#if CONFIG_MEMORY_ACCOUNTING //PLEX
+    size -= ALIGN;
+    if (ret) {
+        mem_account(old.tag, 0, old.size);
+        ret = mem_block_init(ret, size, old.tag);
+    }
+#endif
 #if CONFIG_MEMORY_POISONING
     if (ret && !ptr)
         memset(ret, FF_MEMORY_POISON, size);
@@ -235,6 +392,13 @@ int av_reallocp_array(void *ptr, size_t nmemb, size_t size)
 
 void av_free(void *ptr)
 {
+#if CONFIG_MEMORY_ACCOUNTING //PLEX
+    if (ptr) {
+        const MemHeader *h = mem_block(ptr);
+        mem_account(h->tag, 0, h->size);
+        ptr = mem_block(ptr);
+    }
+#endif
 #if HAVE_ALIGNED_MALLOC
     _aligned_free(ptr);
 #else
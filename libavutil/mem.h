@@ -599,6 +599,50 @@ int av_size_mult(size_t a, size_t b, size_t *r);
  */
 void av_max_alloc(size_t max);
 
+//PLEX
+/**
+ * Back blocks of at least min_size bytes (and at least one huge page)
+ * allocated by av_malloc() and friends with transparent huge pages, which
+ * cuts TLB misses when processing large frames. Only effective on systems
+ * with madvise(MADV_HUGEPAGE), e.g. Linux with THP in "madvise" mode; such
+ * blocks are aligned to the huge page size.
+ *
+ * @param min_size Size threshold in bytes, 0 (the default) disables it
+ */
+void av_huge_page_alloc(size_t min_size);
+
+/**
+ * Components that heap allocations are attributed to when FFmpeg is built
+ * with --enable-memory-accounting.
+ */
+enum AVMemTag {
+    AV_MEM_TAG_OTHER,       ///< callers and everything not listed below
+    AV_MEM_TAG_CODEC,       ///< codec init and decode/encode callbacks
+    AV_MEM_TAG_FILTER,      ///< filter init and activation
+    AV_MEM_TAG_FORMAT,      ///< (de)muxer callbacks, including their I/O
+    AV_MEM_TAG_BUFFER_POOL, ///< buffers backing AVBufferPool, e.g. frame pools
+    AV_MEM_TAG_NB
+};
+
+/**
+ * Get the heap memory currently held by a component.
+ *
+ * Blocks are charged to the component that allocated them until they are
+ * freed, whichever thread frees them.
+ *
+ * @param tag     component to query
+ * @param current if not NULL, set to the bytes currently allocated
+ * @param peak    if not NULL, set to the largest value current has reached
+ * @return 0 on success, AVERROR(ENOSYS) if memory accounting is not built in
+ */
+int av_mem_get_usage(enum AVMemTag tag, size_t *current, size_t *peak);
+
+/**
+ * @return a short name for tag, e.g. "codec"
+ */
+const char *av_mem_tag_name(enum AVMemTag tag);
+//PLEX
+
 /**
  * @}
  * @}
@@ -135,4 +135,15 @@
 #   define LOCAL_ALIGNED_32(t, v, ...) E1(LOCAL_ALIGNED_A(32, t, v, __VA_ARGS__,,))
 #endif
 
+//PLEX
+/**
+ * Attribute the allocations of the calling thread to tag until the matching
+ * avpriv_mem_tag_pop(). Does nothing without --enable-memory-accounting.
+ *
+ * @return the previous tag, to be passed to avpriv_mem_tag_pop()
+ */
+int avpriv_mem_tag_push(enum AVMemTag tag);
+void avpriv_mem_tag_pop(int prev);
+//PLEX
+
 #endif /* AVUTIL_MEM_INTERNAL_H */
@@ -52,7 +52,38 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    //PLEX
+    int             shared;      ///< jobs are run on the process-wide pool
+    int             max_helpers; ///< pool threads that may still join
+    int             nb_helpers;  ///< pool threads running jobs of this context
+    AVSliceThread   *next;       ///< next context in the pool queue
+    //PLEX
+};
+
+//PLEX
+/**
+ * Process-wide pool of worker threads for contexts created with
+ * avpriv_slicethread_create_shared(). Executing contexts are queued and idle
+ * pool threads join them until their jobs run out. The calling thread always
+ * takes part and can finish all jobs alone, so nested execution cannot
+ * deadlock. mutex protects all fields but refcount, which is protected by
+ * ref_mutex as is the creation and teardown of the threads.
+ */
+static struct {
+    AVMutex         ref_mutex;
+    int             refcount;
+    AVMutex         mutex;
+    pthread_cond_t  cond;
+    pthread_t       *threads;
+    int             nb_threads;
+    int             quit;
+    AVSliceThread   *queue;
+} pool = {
+    .ref_mutex = AV_MUTEX_INITIALIZER,
+    .mutex     = AV_MUTEX_INITIALIZER,
 };
+//PLEX
 
 static int run_jobs(AVSliceThread *ctx)
 {
@@ -95,6 +126,184 @@ static void *attribute_align_arg thread_worker(void *v)
     }
 }
 
+//PLEX
+static void run_shared_jobs(AVSliceThread *ctx)
+{
+    unsigned nb_jobs           = ctx->nb_jobs;
+    unsigned nb_active_threads = ctx->nb_active_threads;
+    unsigned threadnr, jobnr;
+
+    // Jobs are handed out strictly in order, so a job waiting for the
+    // progress of an earlier one can not starve it. The caller never runs
+    // out of thread slots as at most nb_active_threads - 1 helpers join.
+    threadnr = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
+    if (threadnr >= nb_active_threads)
+        return;
+    while ((jobnr = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, jobnr, threadnr, nb_jobs, nb_active_threads);
+}
+
+static void *attribute_align_arg pool_worker(void *arg)
+{
+    pthread_mutex_lock(&pool.mutex);
+    while (!pool.quit) {
+        AVSliceThread *ctx = pool.queue;
+
+        while (ctx && ctx->nb_helpers >= ctx->max_helpers)
+            ctx = ctx->next;
+        if (!ctx) {
+            pthread_cond_wait(&pool.cond, &pool.mutex);
+            continue;
+        }
+
+        ctx->nb_helpers++;
+        pthread_mutex_unlock(&pool.mutex);
+        run_shared_jobs(ctx);
+        pthread_mutex_lock(&pool.mutex);
+
+        // all jobs are taken, nothing left to join
+        ctx->max_helpers = 0;
+        if (!--ctx->nb_helpers)
+            pthread_cond_signal(&ctx->done_cond);
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    return NULL;
+}
+
+static void pool_stop(void)
+{
+    pthread_mutex_lock(&pool.mutex);
+    pool.quit = 1;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.mutex);
+
+    for (int i = 0; i < pool.nb_threads; i++)
+        pthread_join(pool.threads[i], NULL);
+    pthread_cond_destroy(&pool.cond);
+    av_freep(&pool.threads);
+    pool.nb_threads = 0;
+}
+
+static int pool_ref(void)
+{
+    int ret = 0;
+
+    ff_mutex_lock(&pool.ref_mutex);
+    if (!pool.refcount) {
+        int nb_threads = av_cpu_count() - 1;
+
+        if ((ret = pthread_cond_init(&pool.cond, NULL))) {
+            ret = AVERROR(ret);
+            goto end;
+        }
+        pool.quit = 0;
+        if (nb_threads > 0 &&
+            !(pool.threads = av_calloc(nb_threads, sizeof(*pool.threads)))) {
+            pthread_cond_destroy(&pool.cond);
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        for (; pool.nb_threads < nb_threads; pool.nb_threads++) {
+            if ((ret = pthread_create(&pool.threads[pool.nb_threads], NULL,
+                                      pool_worker, NULL))) {
+                pool_stop();
+                ret = AVERROR(ret);
+                goto end;
+            }
+        }
+    }
+    pool.refcount++;
+end:
+    ff_mutex_unlock(&pool.ref_mutex);
+    return ret;
+}
+
+static void pool_unref(void)
+{
+    ff_mutex_lock(&pool.ref_mutex);
+    if (!--pool.refcount)
+        pool_stop();
+    ff_mutex_unlock(&pool.ref_mutex);
+}
+
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     int nb_threads)
+{
+    AVSliceThread *ctx;
+    int ret;
+
+    av_assert0(nb_threads >= 0);
+    if (!nb_threads) {
+        int nb_cpus = av_cpu_count();
+        if (nb_cpus > 1)
+            nb_threads = FFMIN(nb_cpus + 1, MAX_AUTO_THREADS);
+        else
+            nb_threads = 1;
+    }
+
+    *pctx = ctx = av_mallocz(sizeof(*ctx));
+    if (!ctx)
+        return AVERROR(ENOMEM);
+
+    ctx->priv        = priv;
+    ctx->worker_func = worker_func;
+    ctx->nb_threads  = nb_threads;
+    ctx->shared      = 1;
+    atomic_init(&ctx->first_job, 0);
+    atomic_init(&ctx->current_job, 0);
+
+    if ((ret = pthread_cond_init(&ctx->done_cond, NULL))) {
+        av_freep(pctx);
+        return AVERROR(ret);
+    }
+    if ((ret = pool_ref()) < 0) {
+        pthread_cond_destroy(&ctx->done_cond);
+        av_freep(pctx);
+        return ret;
+    }
+
+    return nb_threads;
+}
+
+static void execute_shared(AVSliceThread *ctx, int nb_jobs)
+{
+    int queued = 0;
+
+    ctx->nb_jobs           = nb_jobs;
+    ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctx->current_job, 0, memory_order_relaxed);
+
+    if (ctx->nb_active_threads > 1 && pool.nb_threads) {
+        AVSliceThread **tail;
+
+        pthread_mutex_lock(&pool.mutex);
+        ctx->max_helpers = ctx->nb_active_threads - 1;
+        ctx->next        = NULL;
+        for (tail = &pool.queue; *tail; tail = &(*tail)->next);
+        *tail = ctx;
+        pthread_cond_broadcast(&pool.cond);
+        pthread_mutex_unlock(&pool.mutex);
+        queued = 1;
+    }
+
+    run_shared_jobs(ctx);
+
+    if (queued) {
+        AVSliceThread **pos;
+
+        pthread_mutex_lock(&pool.mutex);
+        for (pos = &pool.queue; *pos != ctx; pos = &(*pos)->next);
+        *pos = ctx->next;
+        ctx->max_helpers = 0;
+        while (ctx->nb_helpers)
+            pthread_cond_wait(&ctx->done_cond, &pool.mutex);
+        pthread_mutex_unlock(&pool.mutex);
+    }
+}
+//PLEX
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
@@ -192,6 +401,12 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     int nb_workers, i, is_last = 0;
 
     av_assert0(nb_jobs > 0);
+    //PLEX
+    if (ctx->shared) {
+        execute_shared(ctx, nb_jobs);
+        return;
+    }
+    //PLEX
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
@@ -231,6 +446,14 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         return;
 
     ctx = *pctx;
+    //PLEX
+    if (ctx->shared) {
+        pthread_cond_destroy(&ctx->done_cond);
+        av_freep(pctx);
+        pool_unref();
+        return;
+    }
+    //PLEX
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
@@ -268,6 +491,16 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     return AVERROR(ENOSYS);
 }
 
+//PLEX
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     int nb_threads)
+{
+    *pctx = NULL;
+    return AVERROR(ENOSYS);
+}
+//PLEX
+
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
     av_assert0(0);
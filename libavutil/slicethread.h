@@ -35,6 +35,22 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*main_func)(void *priv),
                               int nb_threads);
 
+//PLEX
+/**
+ * Create a slice threading context that runs its jobs on a process-wide
+ * pool of av_cpu_count() - 1 threads shared by all such contexts, together
+ * with the calling thread. The pool is created with the first and destroyed
+ * with the last shared context.
+ * @param nb_threads maximum number of threads running jobs of this context
+ *                   at once, 0 for automatic, must be >= 0
+ * @return return nb_threads or negative AVERROR on failure
+ * @see avpriv_slicethread_create()
+ */
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     int nb_threads);
+//PLEX
+
 /**
  * Execute slice threading.
  * @param ctx slice threading context
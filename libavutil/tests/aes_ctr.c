@@ -26,6 +26,7 @@ static const DECLARE_ALIGNED(8, uint8_t, plain)[] = {
     0x6d, 0x6f, 0x73, 0x74, 0x20, 0x72, 0x61, 0x6e, 0x64, 0x6f, 0x6d
 };
 static DECLARE_ALIGNED(8, uint8_t, tmp)[11];
+static uint8_t big[1003], big_ref[1003];
 
 int main (void)
 {
@@ -57,6 +58,21 @@ int main (void)
         goto ERROR;
     }
 
+    /* the batched full blocks must match the keystream used byte by byte */
+    for (int i = 0; i < sizeof(big); i++)
+        big[i] = big_ref[i] = i * 7;
+    av_aes_ctr_set_full_iv(ae, iv);
+    av_aes_ctr_set_full_iv(ad, iv);
+    av_aes_ctr_crypt(ae, big + 1, big + 1, sizeof(big) - 1);
+    for (int i = 1; i < sizeof(big_ref); i++)
+        av_aes_ctr_crypt(ad, big_ref + i, big_ref + i, 1);
+
+    if (memcmp(big, big_ref, sizeof(big)) != 0 ||
+        memcmp(av_aes_ctr_get_iv(ae), av_aes_ctr_get_iv(ad), 16) != 0) {
+        av_log(NULL, AV_LOG_ERROR, "batched test failed\n");
+        goto ERROR;
+    }
+
     av_log(NULL, AV_LOG_INFO, "test passed\n");
     ret = 0;
 
@@ -0,0 +1,112 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program hammers one AVBufferPool from several threads, checks
+ * that no buffer is handed out twice at once and reports the time taken.
+ * ./buffer [threads [iterations]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define POOL_SIZE  4096
+#define MAX_HELD   4
+
+typedef struct ThreadArg {
+    AVBufferPool *pool;
+    int id;
+    int iterations;
+    int errors;
+} ThreadArg;
+
+static void *thread_main(void *opaque)
+{
+    ThreadArg *arg = opaque;
+    AVBufferRef *held[MAX_HELD] = { NULL };
+
+    for (int i = 0; i < arg->iterations; i++) {
+        int slot = i % MAX_HELD;
+
+        if (held[slot]) {
+            if (*(int *)held[slot]->data != arg->id)
+                arg->errors++;
+            av_buffer_unref(&held[slot]);
+        }
+        held[slot] = av_buffer_pool_get(arg->pool);
+        if (!held[slot]) {
+            arg->errors++;
+            break;
+        }
+        *(int *)held[slot]->data = arg->id;
+    }
+
+    for (int i = 0; i < MAX_HELD; i++)
+        av_buffer_unref(&held[i]);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200000;
+    pthread_t *threads;
+    ThreadArg *args;
+    AVBufferPool *pool;
+    int64_t start;
+    int errors = 0, ret;
+
+    if (nb_threads <= 0 || iterations <= 0)
+        return 1;
+
+    pool    = av_buffer_pool_init(POOL_SIZE, NULL);
+    threads = calloc(nb_threads, sizeof(*threads));
+    args    = calloc(nb_threads, sizeof(*args));
+    if (!pool || !threads || !args)
+        return 1;
+
+    start = av_gettime_relative();
+    for (int i = 0; i < nb_threads; i++) {
+        args[i].pool       = pool;
+        args[i].id         = i;
+        args[i].iterations = iterations;
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &args[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            return 1;
+        }
+    }
+    for (int i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+
+    printf("%d threads x %d get/unref: %.1f ns per buffer, %d errors\n",
+           nb_threads, iterations,
+           (av_gettime_relative() - start) * 1000.0 / ((double)nb_threads * iterations),
+           errors);
+
+    av_buffer_pool_uninit(&pool);
+    free(threads);
+    free(args);
+    return !!errors;
+}
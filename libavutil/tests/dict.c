@@ -161,5 +161,28 @@ int main(void)
     printf("%s\n", e->value);
     av_dict_free(&dict);
 
+    //PLEX large dictionaries are indexed, lookups must match a linear scan
+    for (int i = 0; i < 1000; i++) {
+        char key[16], val[16];
+        snprintf(key, sizeof(key), i & 1 ? "Key%d" : "key%d", (i * 7) % 300);
+        snprintf(val, sizeof(val), "%d", i);
+        if (av_dict_set(&dict, key, i % 5 ? val : NULL, i % 3 ? 0 : AV_DICT_MULTIKEY) < 0)
+            return 1;
+    }
+    for (int i = 0; i < 300; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "KEY%d", i);
+        for (int flags = 0; flags <= AV_DICT_MATCH_CASE; flags += AV_DICT_MATCH_CASE) {
+            const AVDictionaryEntry *ref = NULL;
+            while ((ref = dict_iterate(dict, ref)) &&
+                   (flags ? strcmp(ref->key, key) : av_strcasecmp(ref->key, key)))
+                ;
+            if (av_dict_get(dict, key, NULL, flags) != ref)
+                printf("indexed lookup of %s with flags %d differs\n", key, flags);
+        }
+    }
+    av_dict_free(&dict);
+    //PLEX
+
     return 0;
 }
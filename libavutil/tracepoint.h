@@ -0,0 +1,56 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Static tracepoints, enabled with --enable-usdt.
+ *
+ * Each probe is a single nop plus an ELF note describing where its
+ * arguments live, so it costs nothing until a tracer attaches, e.g.
+ *   bpftrace -e 'usdt:./libavcodec.so:ffmpeg:decode_send { @[str(arg0)] = count(); }'
+ * Without USDT support the macros expand to nothing and their arguments
+ * are not evaluated.
+ *
+ * Segmenting muxers fire segment_open(url, index) and
+ * segment_close(url, index, size in bytes).
+ */
+
+#ifndef AVUTIL_TRACEPOINT_H
+#define AVUTIL_TRACEPOINT_H
+
+#include "config.h"
+
+#if CONFIG_USDT
+#include <sys/sdt.h>
+
+#define FF_TRACE(name)                   DTRACE_PROBE(ffmpeg, name)
+#define FF_TRACE1(name, a)               DTRACE_PROBE1(ffmpeg, name, a)
+#define FF_TRACE2(name, a, b)            DTRACE_PROBE2(ffmpeg, name, a, b)
+#define FF_TRACE3(name, a, b, c)         DTRACE_PROBE3(ffmpeg, name, a, b, c)
+#define FF_TRACE4(name, a, b, c, d)      DTRACE_PROBE4(ffmpeg, name, a, b, c, d)
+#define FF_TRACE5(name, a, b, c, d, e)   DTRACE_PROBE5(ffmpeg, name, a, b, c, d, e)
+#else
+#define FF_TRACE(name)                   do { } while (0)
+#define FF_TRACE1(name, a)               do { } while (0)
+#define FF_TRACE2(name, a, b)            do { } while (0)
+#define FF_TRACE3(name, a, b, c)         do { } while (0)
+#define FF_TRACE4(name, a, b, c, d)      do { } while (0)
+#define FF_TRACE5(name, a, b, c, d, e)   do { } while (0)
+#endif
+
+#endif /* AVUTIL_TRACEPOINT_H */
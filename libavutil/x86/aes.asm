@@ -0,0 +1,162 @@
+;*****************************************************************************
+;* SIMD-optimized AES encryption/decryption
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION .text
+
+; one round on four independent blocks, so the aes unit stays busy
+%macro AES_ROUND4 2 ; op, round key offset
+    mova       m6, [r0 + %2]
+    %1         m0, m6
+    %1         m2, m6
+    %1         m3, m6
+    %1         m4, m6
+%endmacro
+
+;-----------------------------------------------------------------------------
+; void ff_aes_decrypt(AVAES *a, uint8_t *dst, const uint8_t *src, int count,
+;                     uint8_t *iv, int rounds)
+;
+; The round keys are stored last round first, for both directions.
+; ECB and CBC decryption run four blocks at a time, CBC encryption is
+; inherently serial.
+;-----------------------------------------------------------------------------
+%macro AES_CRYPT 1
+cglobal aes_%1rypt, 6,6,7
+    shl      r3d, 4
+    add      r5d, r5d
+    add      r0, 0x60
+    add      r2, r3
+    add      r1, r3
+    neg      r3
+    pxor     m1, m1
+    test     r4, r4
+    je .ecb
+    movu     m1, [r4] ; iv
+%ifidn %1, enc
+    jmp .tail
+%endif
+.ecb:
+    cmp      r3, -64
+    jg .tail
+.block4:
+    mova     m6, [r0 + 8*r5 - 0x60]
+    movu     m0, [r2 + r3]
+    movu     m2, [r2 + r3 + 0x10]
+    movu     m3, [r2 + r3 + 0x20]
+    movu     m4, [r2 + r3 + 0x30]
+    pxor     m0, m6
+    pxor     m2, m6
+    pxor     m3, m6
+    pxor     m4, m6
+    cmp      r5d, 24
+    je .rounds12_4
+    jl .rounds10_4
+    AES_ROUND4 aes%1, 0x70
+    AES_ROUND4 aes%1, 0x60
+.rounds12_4:
+    AES_ROUND4 aes%1, 0x50
+    AES_ROUND4 aes%1, 0x40
+.rounds10_4:
+    AES_ROUND4 aes%1, 0x30
+    AES_ROUND4 aes%1, 0x20
+    AES_ROUND4 aes%1, 0x10
+    AES_ROUND4 aes%1, 0x00
+    AES_ROUND4 aes%1, -0x10
+    AES_ROUND4 aes%1, -0x20
+    AES_ROUND4 aes%1, -0x30
+    AES_ROUND4 aes%1, -0x40
+    AES_ROUND4 aes%1, -0x50
+    AES_ROUND4 aes%1last, -0x60
+%ifidn %1, dec
+    test     r4, r4
+    je .noiv4
+    ; read the ciphertext before it may be overwritten in place
+    pxor     m0, m1
+    movu     m5, [r2 + r3]
+    pxor     m2, m5
+    movu     m5, [r2 + r3 + 0x10]
+    pxor     m3, m5
+    movu     m5, [r2 + r3 + 0x20]
+    pxor     m4, m5
+    movu     m1, [r2 + r3 + 0x30]
+.noiv4:
+%endif
+    movu     [r1 + r3], m0
+    movu     [r1 + r3 + 0x10], m2
+    movu     [r1 + r3 + 0x20], m3
+    movu     [r1 + r3 + 0x30], m4
+    add      r3, 64
+    cmp      r3, -64
+    jle .block4
+.tail:
+    test     r3, r3
+    je .done
+.block:
+    movu     m0, [r2 + r3] ; state
+%ifidn %1, enc
+    pxor     m0, m1
+%endif
+    pxor     m0, [r0 + 8*r5 - 0x60]
+    cmp      r5d, 24
+    je .rounds12
+    jl .rounds10
+    aes%1    m0, [r0 + 0x70]
+    aes%1    m0, [r0 + 0x60]
+.rounds12:
+    aes%1    m0, [r0 + 0x50]
+    aes%1    m0, [r0 + 0x40]
+.rounds10:
+    aes%1    m0, [r0 + 0x30]
+    aes%1    m0, [r0 + 0x20]
+    aes%1    m0, [r0 + 0x10]
+    aes%1    m0, [r0 + 0x00]
+    aes%1    m0, [r0 - 0x10]
+    aes%1    m0, [r0 - 0x20]
+    aes%1    m0, [r0 - 0x30]
+    aes%1    m0, [r0 - 0x40]
+    aes%1    m0, [r0 - 0x50]
+    aes%1last m0, [r0 - 0x60]
+    test     r4, r4
+    je .noiv
+%ifidn %1, enc
+    mova     m1, m0
+%else
+    pxor     m0, m1
+    movu     m1, [r2 + r3]
+%endif
+.noiv:
+    movu     [r1 + r3], m0
+    add      r3, 16
+    jl .block
+.done:
+    test     r4, r4
+    je .ret
+    movu     [r4], m1
+.ret:
+    RET
+%endmacro
+
+%if HAVE_AESNI_EXTERNAL
+INIT_XMM aesni
+AES_CRYPT enc
+AES_CRYPT dec
+%endif
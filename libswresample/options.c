@@ -130,6 +130,16 @@ static const AVOption options[]={
                                                         , OFFSET(async)          , AV_OPT_TYPE_FLOAT ,{.dbl=0                     }, INT_MIN, INT_MAX   , PARAM },
 {"first_pts"            , "Assume the first pts should be this value (in samples)."
                                                         , OFFSET(firstpts_in_samples), AV_OPT_TYPE_INT64 ,{.i64=AV_NOPTS_VALUE    }, INT64_MIN,INT64_MAX, PARAM },
+//PLEX
+{"block_comp"           , "apply soft compensation in blocks of comp_duration and copy the samples in between if the sample rates match"
+                                                        , OFFSET(block_comp)     , AV_OPT_TYPE_BOOL  ,{.i64=0                     }, 0      , 1         , PARAM },
+{"comp_soft_samples"    , "number of samples stretched or squeezed away by soft compensation"
+                                                        , OFFSET(comp_soft_samples), AV_OPT_TYPE_INT64 ,{.i64=0                   }, 0      , INT64_MAX , PARAM | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+{"comp_inserted_samples", "number of samples of silence inserted by hard compensation"
+                                                        , OFFSET(comp_inserted_samples), AV_OPT_TYPE_INT64 ,{.i64=0               }, 0      , INT64_MAX , PARAM | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+{"comp_dropped_samples" , "number of samples dropped by hard compensation"
+                                                        , OFFSET(comp_dropped_samples), AV_OPT_TYPE_INT64 ,{.i64=0                }, 0      , INT64_MAX , PARAM | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+//PLEX
 
 { "matrix_encoding"     , "set matrixed stereo encoding" , OFFSET(matrix_encoding), AV_OPT_TYPE_INT   ,{.i64 = AV_MATRIX_ENCODING_NONE}, AV_MATRIX_ENCODING_NONE,     AV_MATRIX_ENCODING_NB-1, PARAM, "matrix_encoding" },
     { "none",  "select none",               0, AV_OPT_TYPE_CONST, { .i64 = AV_MATRIX_ENCODING_NONE  }, INT_MIN, INT_MAX, PARAM, "matrix_encoding" },
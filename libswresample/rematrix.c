@@ -22,6 +22,8 @@
 #include "libavutil/avassert.h"
 #include "libavutil/channel_layout.h"
 
+#define SPARSE_BLOCK 256 //PLEX
+
 #define TEMPLATE_REMATRIX_FLT
 #include "rematrix_template.c"
 #undef TEMPLATE_REMATRIX_FLT
@@ -591,6 +593,8 @@ av_cold int swri_rematrix_init(SwrContext *s){
 
 #if ARCH_X86 && HAVE_X86ASM && HAVE_MMX
     return swri_rematrix_init_x86(s);
+#elif ARCH_AARCH64 && HAVE_NEON //PLEX
+    return swri_rematrix_init_aarch64(s);
 #endif
 
     return 0;
@@ -604,7 +608,7 @@ av_cold void swri_rematrix_free(SwrContext *s){
 }
 
 int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mustcopy){
-    int out_i, in_i, i, j;
+    int out_i, in_i;
     int len1 = 0;
     int off = 0;
 
@@ -651,34 +655,17 @@ int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mus
                 s->mix_2_1_f   (out->ch[out_i]+off, in->ch[in_i1]+off, in->ch[in_i2]+off, s->native_matrix, in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len-len1);
             break;}
         default:
+            //PLEX
             if(s->int_sample_fmt == AV_SAMPLE_FMT_FLTP){
-                for(i=0; i<len; i++){
-                    float v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((float*)in->ch[in_i])[i] * s->matrix_flt[out_i][in_i];
-                    }
-                    ((float*)out->ch[out_i])[i]= v;
-                }
+                sum_n_float((float*)out->ch[out_i], (const float**)in->ch, s->matrix_ch[out_i], s->matrix_flt[out_i], len);
             }else if(s->int_sample_fmt == AV_SAMPLE_FMT_DBLP){
-                for(i=0; i<len; i++){
-                    double v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((double*)in->ch[in_i])[i] * s->matrix[out_i][in_i];
-                    }
-                    ((double*)out->ch[out_i])[i]= v;
-                }
+                sum_n_double((double*)out->ch[out_i], (const double**)in->ch, s->matrix_ch[out_i], s->matrix[out_i], len);
+            }else if(s->int_sample_fmt == AV_SAMPLE_FMT_S32P){
+                sum_n_s32((int32_t*)out->ch[out_i], (const int32_t**)in->ch, s->matrix_ch[out_i], s->matrix32[out_i], len);
             }else{
-                for(i=0; i<len; i++){
-                    int v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((int16_t*)in->ch[in_i])[i] * s->matrix32[out_i][in_i];
-                    }
-                    ((int16_t*)out->ch[out_i])[i]= (v + 16384)>>15;
-                }
+                sum_n_s16((int16_t*)out->ch[out_i], (const int16_t**)in->ch, s->matrix_ch[out_i], s->matrix32[out_i], len);
             }
+            //PLEX
         }
     }
     return 0;
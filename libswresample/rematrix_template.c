@@ -87,17 +87,43 @@ static void RENAME(mix8to2)(SAMPLE **out, const SAMPLE **in, COEFF *coeffp, inte
     }
 }
 
+//PLEX
+#ifndef TEMPLATE_CLIP
+/* out = sum of the listed inputs, one pass per input over a block so that
+ * each pass is a plain vectorizable multiply-add */
+static void RENAME(sum_n)(SAMPLE *out, const SAMPLE **in, const uint8_t *ch, const COEFF *coeffp, integer len){
+    INTER acc[SPARSE_BLOCK];
+
+    for (integer i = 0; i < len; i += SPARSE_BLOCK) {
+        const int bl = FFMIN(len - i, SPARSE_BLOCK);
+        const SAMPLE *src = in[ch[1]] + i;
+        const INTER coeff = coeffp[ch[1]];
+
+        for (int k = 0; k < bl; k++)
+            acc[k] = coeff * src[k];
+        for (int j = 2; j <= ch[0]; j++) {
+            const SAMPLE *src = in[ch[j]] + i;
+            const INTER coeff = coeffp[ch[j]];
+
+            for (int k = 0; k < bl; k++)
+                acc[k] += coeff * src[k];
+        }
+        for (int k = 0; k < bl; k++)
+            out[i + k] = R(acc[k]);
+    }
+}
+#endif
+//PLEX
+
 static RENAME(mix_any_func_type) *RENAME(get_mix_any_func)(SwrContext *s){
-    if (  !av_channel_layout_compare(&s->out_ch_layout, &(AVChannelLayout)AV_CHANNEL_LAYOUT_STEREO)
-       && (   !av_channel_layout_compare(&s->in_ch_layout, &(AVChannelLayout)AV_CHANNEL_LAYOUT_5POINT1)
-           || !av_channel_layout_compare(&s->in_ch_layout, &(AVChannelLayout)AV_CHANNEL_LAYOUT_5POINT1_BACK))
+    //PLEX: the kernels only depend on the shape of the matrix, not on the layout
+    if (   s->out.ch_count == 2 && s->used_ch_layout.nb_channels == 6
        && s->matrix[0][2] == s->matrix[1][2] && s->matrix[0][3] == s->matrix[1][3]
        && !s->matrix[0][1] && !s->matrix[0][5] && !s->matrix[1][0] && !s->matrix[1][4]
     )
         return RENAME(mix6to2);
 
-    if (  !av_channel_layout_compare(&s->out_ch_layout, &(AVChannelLayout)AV_CHANNEL_LAYOUT_STEREO)
-       && !av_channel_layout_compare(&s->in_ch_layout, &(AVChannelLayout)AV_CHANNEL_LAYOUT_7POINT1)
+    if (   s->out.ch_count == 2 && s->used_ch_layout.nb_channels == 8
        && s->matrix[0][2] == s->matrix[1][2] && s->matrix[0][3] == s->matrix[1][3]
        && !s->matrix[0][1] && !s->matrix[0][5] && !s->matrix[1][0] && !s->matrix[1][4]
        && !s->matrix[0][7] && !s->matrix[1][6]
@@ -30,6 +30,8 @@
 #include "libavutil/cpu.h"
 #include "resample.h"
 
+#define REALIGN_DISTANCE 256 //PLEX
+
 /**
  * builds a polyphase filterbank.
  * @param factor resampling factor
@@ -335,6 +337,7 @@ static int set_compensation(ResampleContext *c, int sample_delta, int compensati
     }
 
     c->compensation_distance= compensation_distance;
+    c->realign = 0; //PLEX
     if (compensation_distance)
         c->dst_incr = c->ideal_dst_incr - c->ideal_dst_incr * (int64_t)sample_delta / compensation_distance;
     else
@@ -388,6 +391,16 @@ static int multiple_resample(ResampleContext *c, AudioData *dst, int dst_size, A
              * when frac and dst_incr_mod are zero */
             resample_func = (c->linear && (c->frac || c->dst_incr_mod)) ?
                             c->dsp.resample_linear : c->dsp.resample_common;
+            //PLEX: at whole sample positions and unit step the filter is only a delay
+            if (c->passthrough && !c->compensation_distance && !c->frac && !c->dst_incr_mod &&
+                c->dst_incr_div == c->phase_count && c->index >= 0 && !(c->index % c->phase_count)) {
+                int sample_index = c->index / c->phase_count + (c->filter_length - 1) / 2;
+                for (i = 0; i < dst->ch_count; i++)
+                    memcpy(dst->ch[i], src->ch[i] + sample_index * dst->bps, dst_size * dst->bps);
+                *consumed = c->index / c->phase_count + dst_size;
+                c->index  = 0;
+            } else
+            //PLEX
             for (i = 0; i < dst->ch_count; i++)
                 *consumed = resample_func(c, dst->ch[i], src->ch[i], dst_size, i+1 == dst->ch_count);
         }
@@ -396,7 +409,23 @@ static int multiple_resample(ResampleContext *c, AudioData *dst, int dst_size, A
     if (c->compensation_distance) {
         c->compensation_distance -= dst_size;
         if (!c->compensation_distance) {
-            c->dst_incr     = c->ideal_dst_incr;
+            //PLEX
+            /* in passthrough mode, move the position back to a whole sample
+             * over a short stretch, then drop the sub-phase remainder */
+            int64_t offset = (int64_t)c->index * c->src_incr + c->frac;
+            if (c->passthrough && !c->realign && offset) {
+                c->realign  = 1;
+                c->compensation_distance = REALIGN_DISTANCE;
+                c->dst_incr = c->ideal_dst_incr - offset / REALIGN_DISTANCE;
+            } else {
+                if (c->realign) {
+                    c->index   = 0;
+                    c->frac    = 0;
+                    c->realign = 0;
+                }
+                c->dst_incr = c->ideal_dst_incr;
+            }
+            //PLEX
             c->dst_incr_div = c->dst_incr / c->src_incr;
             c->dst_incr_mod = c->dst_incr % c->src_incr;
         }
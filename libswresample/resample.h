@@ -49,6 +49,10 @@ typedef struct ResampleContext {
     int felem_size;
     int filter_shift;
     int phase_count_compensation;      /* desired phase_count when compensation is enabled */
+    //PLEX
+    int passthrough;                   /* copy samples while not compensating, rates must match */
+    int realign;                       /* compensating the residual phase of the last compensation */
+    //PLEX
 
     struct {
         void (*resample_one)(void *dst, const void *src,
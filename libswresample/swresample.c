@@ -21,6 +21,7 @@
 #include "libavutil/opt.h"
 #include "swresample_internal.h"
 #include "audioconvert.h"
+#include "resample.h" //PLEX
 #include "libavutil/avassert.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/internal.h"
@@ -394,6 +395,10 @@ av_cold int swr_init(struct SwrContext *s){
             av_log(s, AV_LOG_ERROR, "Failed to initialize resampler\n");
             return AVERROR(ENOMEM);
         }
+        //PLEX
+        if (s->resampler == &swri_resampler)
+            s->resample->passthrough = s->block_comp && s->out_sample_rate == s->in_sample_rate;
+        //PLEX
     }else
         s->resampler->free(&s->resample);
     if(    s->int_sample_fmt != AV_SAMPLE_FMT_S16P
@@ -1058,13 +1063,28 @@ int64_t swr_next_pts(struct SwrContext *s, int64_t pts){
                 else          ret = swr_drop_output   (s, -delta / s-> in_sample_rate);
                 if(ret<0){
                     av_log(s, AV_LOG_ERROR, "Failed to compensate for timestamp delta of %f\n", fdelta);
+                } else if (delta > 0) { //PLEX
+                    s->comp_inserted_samples += delta / s->out_sample_rate;
+                } else {
+                    s->comp_dropped_samples  += -delta / s->in_sample_rate;
                 }
-            } else if(s->soft_compensation_duration && s->max_soft_compensation) {
+            } else if(s->soft_compensation_duration && s->max_soft_compensation
+                      && !(s->block_comp && s->outpts < s->block_comp_end)) { //PLEX
                 int duration = s->out_sample_rate * s->soft_compensation_duration;
                 double max_soft_compensation = s->max_soft_compensation / (s->max_soft_compensation < 0 ? -s->in_sample_rate : 1);
                 int comp = av_clipf(fdelta, -max_soft_compensation, max_soft_compensation) * duration ;
                 av_log(s, AV_LOG_VERBOSE, "compensating audio timestamp drift:%f compensation:%d in:%d\n", fdelta, comp, duration);
-                swr_set_compensation(s, comp, duration);
+                //PLEX
+                /* do not count the part of the previous compensation that is replaced */
+                if (s->resample && s->resampler == &swri_resampler && s->comp_last_duration)
+                    s->comp_soft_samples -= FFABS(s->comp_last) * (int64_t)s->resample->compensation_distance / s->comp_last_duration;
+                if (swr_set_compensation(s, comp, duration) >= 0) {
+                    s->comp_soft_samples += FFABS(comp);
+                    s->comp_last          = comp;
+                    s->comp_last_duration = duration;
+                    s->block_comp_end = s->outpts + duration * (int64_t)s->in_sample_rate;
+                }
+                //PLEX
             }
         }
 
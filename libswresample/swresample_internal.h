@@ -145,6 +145,15 @@ struct SwrContext {
     float max_soft_compensation;                    ///< swr maximum soft compensation in seconds over soft_compensation_duration
     float async;                                    ///< swr simple 1 parameter async, similar to ffmpegs -async
     int64_t firstpts_in_samples;                    ///< swr first pts in samples
+    //PLEX
+    int block_comp;                                 ///< swr soft compensation in blocks, pass through in between
+    int64_t block_comp_end;                         ///< outpts at which the running soft compensation ends
+    int comp_last;                                  ///< sample delta of the last soft compensation
+    int comp_last_duration;                         ///< duration of the last soft compensation
+    int64_t comp_soft_samples;                      ///< total number of samples stretched or squeezed away
+    int64_t comp_inserted_samples;                  ///< total number of samples of silence inserted
+    int64_t comp_dropped_samples;                   ///< total number of samples dropped
+    //PLEX
 
     int resample_first;                             ///< 1 if resampling must come first, 0 if rematrixing
     int rematrix;                                   ///< flag to indicate if rematrixing is needed (basically if input and output layouts mismatch)
@@ -205,6 +214,7 @@ int swri_rematrix_init(SwrContext *s);
 void swri_rematrix_free(SwrContext *s);
 int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mustcopy);
 int swri_rematrix_init_x86(struct SwrContext *s);
+int swri_rematrix_init_aarch64(struct SwrContext *s); //PLEX
 
 av_warn_unused_result
 int swri_get_dither(SwrContext *s, void *dst, int len, unsigned seed, enum AVSampleFormat noise_fmt);
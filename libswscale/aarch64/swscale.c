@@ -167,6 +167,38 @@ void ff_yuv2plane1_8_neon(
         int dstW,
         const uint8_t *dither,
         int offset);
+void ff_yuv2planeX_10_neon_asm(const int16_t *filter, int filterSize,
+                               const int16_t **src, uint16_t *dest, int dstW,
+                               int output_bits);
+void ff_yuv2nv12cX_neon_asm(int isSwapped, const uint8_t *chrDither,
+                            const int16_t *chrFilter, int chrFilterSize,
+                            const int16_t **chrUSrc, const int16_t **chrVSrc,
+                            uint8_t *dest, int chrDstW);
+
+#define YUV2PLANEX_NBPS(bits)                                                \
+static void yuv2planeX_ ## bits ## LE_neon(const int16_t *filter, int filterSize, \
+                                           const int16_t **src, uint8_t *dest, \
+                                           int dstW, const uint8_t *dither,   \
+                                           int offset)                        \
+{                                                                             \
+    ff_yuv2planeX_10_neon_asm(filter, filterSize, src, (uint16_t *)dest,      \
+                              dstW, bits);                                    \
+}
+
+YUV2PLANEX_NBPS(9)
+YUV2PLANEX_NBPS(10)
+YUV2PLANEX_NBPS(12)
+YUV2PLANEX_NBPS(14)
+
+static void yuv2nv12cX_neon(enum AVPixelFormat dstFormat, const uint8_t *chrDither,
+                            const int16_t *chrFilter, int chrFilterSize,
+                            const int16_t **chrUSrc, const int16_t **chrVSrc,
+                            uint8_t *dest, int chrDstW)
+{
+    ff_yuv2nv12cX_neon_asm(isSwappedChroma(dstFormat), chrDither,
+                           chrFilter, chrFilterSize, chrUSrc, chrVSrc,
+                           dest, chrDstW);
+}
 
 #define ASSIGN_SCALE_FUNC2(hscalefn, filtersize, opt) do {              \
     if (c->srcBpc == 8) {                                               \
@@ -211,6 +243,16 @@ av_cold void ff_sws_init_swscale_aarch64(SwsContext *c)
         ASSIGN_VSCALE_FUNC(c->yuv2plane1, neon);
         if (c->dstBpc == 8) {
             c->yuv2planeX = ff_yuv2planeX_8_neon;
+            if (isSemiPlanarYUV(c->dstFormat))
+                c->yuv2nv12cX = yuv2nv12cX_neon;
+        } else if (isNBPS(c->dstFormat) && !isBE(c->dstFormat) &&
+                   !(isSemiPlanarYUV(c->dstFormat) && isDataInHighBits(c->dstFormat))) {
+            switch (c->dstBpc) {
+            case 9:  c->yuv2planeX = yuv2planeX_9LE_neon;  break;
+            case 10: c->yuv2planeX = yuv2planeX_10LE_neon; break;
+            case 12: c->yuv2planeX = yuv2planeX_12LE_neon; break;
+            case 14: c->yuv2planeX = yuv2planeX_14LE_neon; break;
+            }
         }
     }
 }
@@ -81,6 +81,10 @@ static const AVOption swscale_options[] = {
 
     { "threads",         "number of threads",             OFFSET(nb_threads),   AV_OPT_TYPE_INT, {.i64 = 1 }, 0, INT_MAX, VE, "threads" },
         { "auto",        NULL,                            0,                  AV_OPT_TYPE_CONST, {.i64 = 0 },    .flags = VE, "threads" },
+    { "shared_threads",  "use the process-wide shared thread pool", OFFSET(shared_threads), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, VE },
+
+    { "tile_width",      "width of the destination column tiles", OFFSET(tile_width), AV_OPT_TYPE_INT, {.i64 = 0 }, -1, INT_MAX, VE, "tile_width" },
+        { "auto",        "size the tiles to the cache",   0,                  AV_OPT_TYPE_CONST, {.i64 = -1 },   .flags = VE, "tile_width" },
 
     { NULL }
 };
@@ -402,13 +402,14 @@ static void yuv2nv12cX_16BE_c(enum AVPixelFormat dstFormat, const uint8_t *chrDi
     yuv2nv12cX_16_c_template(1, chrDither, chrFilter, chrFilterSize, chrUSrc, chrVSrc, dest8, chrDstW, 16);
 }
 
-static void yuv2planeX_8_c(const int16_t *filter, int filterSize,
-                           const int16_t **src, uint8_t *dest, int dstW,
-                           const uint8_t *dither, int offset)
+static av_always_inline void
+yuv2planeX_8_c_template(const int16_t *filter, int filterSize,
+                        const int16_t **src, uint8_t *dest, int dstW,
+                        const uint8_t *dither, int offset, int use_dither)
 {
     int i;
     for (i=0; i<dstW; i++) {
-        int val = dither[(i + offset) & 7] << 12;
+        int val = use_dither ? dither[(i + offset) & 7] << 12 : 64 << 12;
         int j;
         for (j=0; j<filterSize; j++)
             val += src[j][i] * filter[j];
@@ -417,6 +418,13 @@ static void yuv2planeX_8_c(const int16_t *filter, int filterSize,
     }
 }
 
+static void yuv2planeX_8_c(const int16_t *filter, int filterSize,
+                           const int16_t **src, uint8_t *dest, int dstW,
+                           const uint8_t *dither, int offset)
+{
+    yuv2planeX_8_c_template(filter, filterSize, src, dest, dstW, dither, offset, 1);
+}
+
 static void yuv2plane1_8_c(const int16_t *src, uint8_t *dest, int dstW,
                            const uint8_t *dither, int offset)
 {
@@ -427,6 +435,62 @@ static void yuv2plane1_8_c(const int16_t *src, uint8_t *dest, int dstW,
     }
 }
 
+//PLEX
+/* vertical scalers with a constant number of taps, so the filter loop unrolls */
+#define yuv2planeX_fixed(taps)                                                \
+static void yuv2planeX_8_ ## taps ## tap_c(const int16_t *filter, int filterSize, \
+                              const int16_t **src, uint8_t *dest, int dstW,   \
+                              const uint8_t *dither, int offset)              \
+{                                                                             \
+    yuv2planeX_8_c_template(filter, taps, src, dest, dstW, dither, offset, 1); \
+}                                                                             \
+static void yuv2planeX_8_ ## taps ## tap_nodither_c(const int16_t *filter, int filterSize, \
+                              const int16_t **src, uint8_t *dest, int dstW,   \
+                              const uint8_t *dither, int offset)              \
+{                                                                             \
+    yuv2planeX_8_c_template(filter, taps, src, dest, dstW, dither, offset, 0); \
+}                                                                             \
+static void yuv2planeX_10LE_ ## taps ## tap_c(const int16_t *filter, int filterSize, \
+                              const int16_t **src, uint8_t *dest, int dstW,   \
+                              const uint8_t *dither, int offset)              \
+{                                                                             \
+    yuv2planeX_10_c_template(filter, taps, src, (uint16_t *) dest, dstW, 0, 10); \
+}
+
+yuv2planeX_fixed(2)
+yuv2planeX_fixed(4)
+yuv2planeX_fixed(6)
+yuv2planeX_fixed(8)
+
+yuv2planarX_fn ff_sws_fixed_planeX(SwsContext *c, yuv2planarX_fn yuv2planeX,
+                                   int filter_size)
+{
+    /* without dither the table is all 64, i.e. plain rounding */
+    int dither = isNBPS(c->srcFormat) || is16BPS(c->srcFormat);
+
+#define FIXED_TAPS(fn, suffix)                          \
+    switch (filter_size) {                              \
+    case 2: return fn ## _2tap ## suffix ## _c;         \
+    case 4: return fn ## _4tap ## suffix ## _c;         \
+    case 6: return fn ## _6tap ## suffix ## _c;         \
+    case 8: return fn ## _8tap ## suffix ## _c;         \
+    }
+
+    if (yuv2planeX == yuv2planeX_8_c) {
+        if (dither) {
+            FIXED_TAPS(yuv2planeX_8, )
+        } else {
+            FIXED_TAPS(yuv2planeX_8, _nodither)
+        }
+    } else if (yuv2planeX == yuv2planeX_10LE_c) {
+        FIXED_TAPS(yuv2planeX_10LE, )
+    }
+#undef FIXED_TAPS
+
+    return yuv2planeX;
+}
+//PLEX
+
 static void yuv2nv12cX_c(enum AVPixelFormat dstFormat, const uint8_t *chrDither,
                          const int16_t *chrFilter, int chrFilterSize,
                          const int16_t **chrUSrc, const int16_t **chrVSrc,
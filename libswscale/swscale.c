@@ -27,6 +27,7 @@
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
 #include "libavutil/emms.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mem_internal.h"
 #include "libavutil/pixdesc.h"
@@ -879,6 +880,45 @@ static int scale_cascaded(SwsContext *c,
     return ret;
 }
 
+static int scale_tiles(SwsContext *c,
+                       const uint8_t * const srcSlice[], const int srcStride[],
+                       int srcSliceY, int srcSliceH,
+                       uint8_t * const dstSlice[], const int dstStride[],
+                       int dstSliceY, int dstSliceH)
+{
+    const int src_align = 1 << av_pix_fmt_desc_get(c->srcFormat)->log2_chroma_w;
+    const int dst_align = 1 << av_pix_fmt_desc_get(c->dstFormat)->log2_chroma_w;
+    int src_bytes[4], dst_bytes[4];
+    int ret = 0;
+
+    /* tile offsets are multiples of the chroma subsampling, so the bytes of
+     * one subsampling unit also cover packed 4:2:2 */
+    for (int p = 0; p < 4; p++) {
+        src_bytes[p] = FFMAX(av_image_get_linesize(c->srcFormat, src_align, p), 0);
+        dst_bytes[p] = FFMAX(av_image_get_linesize(c->dstFormat, dst_align, p), 0);
+    }
+
+    for (int i = 0; i < c->nb_tile_ctx; i++) {
+        SwsContext *t = c->tile_ctx[i];
+        const uint8_t *src[4] = { NULL };
+        uint8_t *dst[4] = { NULL };
+
+        for (int p = 0; p < 4; p++) {
+            if (srcSlice[p])
+                src[p] = srcSlice[p] + src_bytes[p] * (t->tile_src_x / src_align);
+            if (dstSlice[p])
+                dst[p] = dstSlice[p] + dst_bytes[p] * (t->tile_dst_x / dst_align);
+        }
+
+        ret = scale_internal(t, src, srcStride, srcSliceY, srcSliceH,
+                             dst, dstStride, dstSliceY, dstSliceH);
+        if (ret < 0)
+            return ret;
+    }
+
+    return ret;
+}
+
 static int scale_internal(SwsContext *c,
                           const uint8_t * const srcSlice[], const int srcStride[],
                           int srcSliceY, int srcSliceH,
@@ -938,6 +978,10 @@ static int scale_internal(SwsContext *c,
         return scale_cascaded(c, srcSlice, srcStride, srcSliceY, srcSliceH,
                               dstSlice, dstStride, dstSliceY, dstSliceH);
 
+    if (c->nb_tile_ctx)
+        return scale_tiles(c, srcSlice, srcStride, srcSliceY, srcSliceH,
+                           dstSlice, dstStride, dstSliceY, dstSliceH);
+
     if (!srcSliceY && (c->flags & SWS_BITEXACT) && c->dither == SWS_DITHER_ED && c->dither_error[0])
         for (i = 0; i < 4; i++)
             memset(c->dither_error[i], 0, sizeof(c->dither_error[0][0]) * (c->dstW+2));
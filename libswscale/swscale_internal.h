@@ -682,6 +682,17 @@ typedef struct SwsContext {
     atomic_int   data_unaligned_warned;
 
     Half2FloatTables *h2f_tables;
+
+    /* Kept after the members accessed by asm through fixed offsets */
+
+    // column tiles, see tile_width
+    int tile_width;               ///< Width of the destination column tiles, 0 for none, -1 for auto.
+    struct SwsContext **tile_ctx;
+    int              nb_tile_ctx;
+    int tile_src_x;               ///< First source column of this tile.
+    int tile_dst_x;               ///< First destination column of this tile.
+
+    int shared_threads;           ///< Run the slice threads on the process-wide shared pool.
 } SwsContext;
 //FIXME check init (where 0)
 
@@ -979,6 +990,14 @@ void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2packed2_fn *yuv2packed2,
                               yuv2packedX_fn *yuv2packedX,
                               yuv2anyX_fn *yuv2anyX);
+//PLEX
+/**
+ * Return a C vertical scaler specialized for filter_size taps, or
+ * yuv2planeX itself if it has no such variant.
+ */
+yuv2planarX_fn ff_sws_fixed_planeX(SwsContext *c, yuv2planarX_fn yuv2planeX,
+                                   int filter_size);
+//PLEX
 void ff_sws_init_swscale_ppc(SwsContext *c);
 void ff_sws_init_swscale_vsx(SwsContext *c);
 void ff_sws_init_swscale_x86(SwsContext *c);
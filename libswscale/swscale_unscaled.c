@@ -323,6 +323,133 @@ static int planar8ToP01xleWrapper(SwsContext *c, const uint8_t *src[],
 
 #undef output_pixel
 
+/* Reduce a row of 16-bit samples, MSB-aligned after the left shift, to 8
+ * bits, rounding and dithering the way DITHER_COPY does. The dither is
+ * indexed by the destination column, dst_col being that of the first one. */
+static av_always_inline void row16To8(uint8_t *dst, int dst_step, int dst_col,
+                                      const uint8_t *src, int src_step,
+                                      int width, int lshift, int be,
+                                      const uint8_t *dither, int shiftonly)
+{
+    int j;
+
+    for (j = 0; j < width; j++) {
+        const uint8_t *p = src + 2 * src_step * j;
+        unsigned v = ((be ? AV_RB16(p) : AV_RL16(p)) << lshift) & 0xFFFF;
+        unsigned tmp;
+
+        if (!dither) {
+            tmp = v >> 8;
+        } else if (shiftonly) {
+            tmp = (v + dither[(dst_col + dst_step * j) & 7]) >> 8;
+            tmp -= tmp >> 8;
+        } else {
+            tmp = (v - (v >> 8) + dither[(dst_col + dst_step * j) & 7]) >> 8;
+        }
+        dst[dst_step * j] = tmp;
+    }
+}
+
+static av_always_inline int highBitDepthTo8(SwsContext *c, const uint8_t *src[],
+                                            int srcStride[], int srcSliceY,
+                                            int srcSliceH, uint8_t *dstParam[],
+                                            int dstStride[], int semiplanar,
+                                            int lshift, int be)
+{
+    const int nv12 = isSemiPlanarYUV(c->dstFormat);
+    const int chrW = c->chrSrcW;
+    const int chrH = (srcSliceH + 1) / 2;
+    const uint8_t *srcY = src[0], *srcU = src[1], *srcV = semiplanar ? src[1] + 2 : src[2];
+    uint8_t *dstY = dstParam[0] + dstStride[0] * srcSliceY;
+    uint8_t *dstU = dstParam[1] + dstStride[1] * (srcSliceY / 2);
+    uint8_t *dstV = nv12 ? dstU + 1 : dstParam[2] + dstStride[2] * (srcSliceY / 2);
+    const int strideV = nv12 ? dstStride[1] : dstStride[2];
+    const int dither = c->dither != SWS_DITHER_NONE;
+    int y;
+
+    for (y = 0; y < srcSliceH; y++) {
+        row16To8(dstY, 1, 0, srcY, 1, c->srcW, lshift, be,
+                 dither ? dithers[7][(srcSliceY + y) & 7] : NULL, !c->srcRange);
+        srcY += srcStride[0];
+        dstY += dstStride[0];
+    }
+
+    for (y = 0; y < chrH; y++) {
+        const uint8_t *d = dither ? dithers[7][(srcSliceY / 2 + y) & 7] : NULL;
+
+        if (semiplanar && nv12) {
+            row16To8(dstU, 1, 0, srcU, 1, 2 * chrW, lshift, be, d, 1);
+        } else {
+            row16To8(dstU, 1 + nv12, 0,    srcU, 1 + semiplanar, chrW, lshift, be, d, 1);
+            row16To8(dstV, 1 + nv12, nv12, srcV, 1 + semiplanar, chrW, lshift, be, d, 1);
+        }
+        srcU += srcStride[1];
+        srcV += semiplanar ? srcStride[1] : srcStride[2];
+        dstU += dstStride[1];
+        dstV += strideV;
+    }
+
+    return srcSliceH;
+}
+
+#define HIGH_BIT_DEPTH_TO_8_WRAPPER(name, semiplanar, lshift, be)           \
+static int name ## To8Wrapper(SwsContext *c, const uint8_t *src[],          \
+                              int srcStride[], int srcSliceY,               \
+                              int srcSliceH, uint8_t *dstParam[],           \
+                              int dstStride[])                              \
+{                                                                           \
+    return highBitDepthTo8(c, src, srcStride, srcSliceY, srcSliceH,         \
+                           dstParam, dstStride, semiplanar, lshift, be);    \
+}
+
+HIGH_BIT_DEPTH_TO_8_WRAPPER(p01xle,       1, 0, 0)
+HIGH_BIT_DEPTH_TO_8_WRAPPER(p01xbe,       1, 0, 1)
+HIGH_BIT_DEPTH_TO_8_WRAPPER(yuv420p10le, 0, 6, 0)
+HIGH_BIT_DEPTH_TO_8_WRAPPER(yuv420p10be, 0, 6, 1)
+HIGH_BIT_DEPTH_TO_8_WRAPPER(yuv420p12le, 0, 4, 0)
+HIGH_BIT_DEPTH_TO_8_WRAPPER(yuv420p12be, 0, 4, 1)
+
+static int nv12ToP01xWrapper(SwsContext *c, const uint8_t *src[],
+                             int srcStride[], int srcSliceY,
+                             int srcSliceH, uint8_t *dstParam8[],
+                             int dstStride[])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->dstFormat);
+    const int be = isBE(c->dstFormat);
+    /* the low bits are zero in P010 and P012 */
+    const unsigned mask = 0xFFFF & ~((1 << desc->comp[0].shift) - 1);
+    uint8_t *dstY = dstParam8[0] + dstStride[0] * srcSliceY;
+    uint8_t *dstUV = dstParam8[1] + dstStride[1] * (srcSliceY / 2);
+    /* limited range luma and chroma are shifted, full range luma is scaled */
+    const unsigned lumMask = c->srcRange ? 0xFF : 0;
+    int x, y;
+
+    for (y = 0; y < srcSliceH; y++) {
+        const uint8_t *tsrc = src[0] + srcStride[0] * y;
+        for (x = 0; x < c->srcW; x++) {
+            unsigned v = (tsrc[x] << 8 | (tsrc[x] & lumMask)) & mask;
+            if (be)
+                AV_WB16(dstY + 2 * x, v);
+            else
+                AV_WL16(dstY + 2 * x, v);
+        }
+        dstY += dstStride[0];
+    }
+
+    for (y = 0; y < (srcSliceH + 1) / 2; y++) {
+        const uint8_t *tsrc = src[1] + srcStride[1] * y;
+        for (x = 0; x < 2 * c->chrSrcW; x++) {
+            if (be)
+                AV_WB16(dstUV + 2 * x, tsrc[x] << 8);
+            else
+                AV_WL16(dstUV + 2 * x, tsrc[x] << 8);
+        }
+        dstUV += dstStride[1];
+    }
+
+    return srcSliceH;
+}
+
 static int planarToYuy2Wrapper(SwsContext *c, const uint8_t *src[],
                                int srcStride[], int srcSliceY, int srcSliceH,
                                uint8_t *dstParam[], int dstStride[])
@@ -2025,6 +2152,37 @@ void ff_get_unscaled_swscale(SwsContext *c)
         c->convert_unscaled = planar8ToP01xleWrapper;
     }
 
+    /* p01x_to_nv12, p01x_to_yuv420p and yuv420p1x_to_nv12 */
+    if (dstFormat == AV_PIX_FMT_NV12 || dstFormat == AV_PIX_FMT_YUV420P) {
+        switch (srcFormat) {
+        case AV_PIX_FMT_P010LE:
+        case AV_PIX_FMT_P012LE:
+        case AV_PIX_FMT_P016LE:
+            c->convert_unscaled = p01xleTo8Wrapper;
+            break;
+        case AV_PIX_FMT_P010BE:
+        case AV_PIX_FMT_P012BE:
+        case AV_PIX_FMT_P016BE:
+            c->convert_unscaled = p01xbeTo8Wrapper;
+            break;
+        }
+    }
+    if (dstFormat == AV_PIX_FMT_NV12) {
+        switch (srcFormat) {
+        case AV_PIX_FMT_YUV420P10LE: c->convert_unscaled = yuv420p10leTo8Wrapper; break;
+        case AV_PIX_FMT_YUV420P10BE: c->convert_unscaled = yuv420p10beTo8Wrapper; break;
+        case AV_PIX_FMT_YUV420P12LE: c->convert_unscaled = yuv420p12leTo8Wrapper; break;
+        case AV_PIX_FMT_YUV420P12BE: c->convert_unscaled = yuv420p12beTo8Wrapper; break;
+        }
+    }
+    /* nv12_to_p01x */
+    if (srcFormat == AV_PIX_FMT_NV12 &&
+        (dstFormat == AV_PIX_FMT_P010LE || dstFormat == AV_PIX_FMT_P010BE ||
+         dstFormat == AV_PIX_FMT_P012LE || dstFormat == AV_PIX_FMT_P012BE ||
+         dstFormat == AV_PIX_FMT_P016LE || dstFormat == AV_PIX_FMT_P016BE)) {
+        c->convert_unscaled = nv12ToP01xWrapper;
+    }
+
     if (srcFormat == AV_PIX_FMT_YUV410P && !(dstH & 3) &&
         (dstFormat == AV_PIX_FMT_YUV420P || dstFormat == AV_PIX_FMT_YUVA420P) &&
         !(flags & SWS_BITEXACT)) {
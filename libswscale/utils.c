@@ -998,9 +998,177 @@ static int range_override_needed(enum AVPixelFormat format)
     return !isYUV(format) && !isGray(format);
 }
 
-int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
-                             int srcRange, const int table[4], int dstRange,
-                             int brightness, int contrast, int saturation)
+/* working set budget of one column tile, well below the L2 size of current
+ * CPUs so that the source rows and the other planes fit as well */
+#define TILE_CACHE_BUDGET (128 << 10)
+#define TILE_ALIGN        64
+
+static void free_tiles(SwsContext *c)
+{
+    for (int i = 0; i < c->nb_tile_ctx; i++)
+        sws_freeContext(c->tile_ctx[i]);
+    av_freep(&c->tile_ctx);
+    c->nb_tile_ctx = 0;
+}
+
+static int auto_tile_width(SwsContext *c)
+{
+    const int bpc = c->dstBpc > 14 ? 4 : 2;
+    int64_t col, src_bytes = 0;
+
+    for (int p = 0; p < 4; p++) {
+        int linesize = av_image_get_linesize(c->srcFormat, c->srcW, p);
+        if (linesize > 0)
+            src_bytes += linesize;
+    }
+
+    /* bytes per destination column: horizontal filters, ring buffer lines
+     * and the share of one source row */
+    col = c->hLumFilterSize * 2 + 4 + c->vLumFilterSize * bpc +
+          ((c->hChrFilterSize * 2 + 4 + 2 * c->vChrFilterSize * bpc) >> c->chrDstHSubSample) +
+          src_bytes / c->dstW + 1;
+
+    return FFMAX(TILE_CACHE_BUDGET / col, 4 * TILE_ALIGN) & ~(TILE_ALIGN - 1);
+}
+
+static int tile_filter(int16_t **filter, int32_t **filter_pos, const int16_t *src_filter,
+                       const int32_t *src_pos, int filter_size, int x, int w, int src_x)
+{
+    av_freep(filter);
+    av_freep(filter_pos);
+    /* same padding as initFilter() */
+    if (!FF_ALLOCZ_TYPED_ARRAY(*filter, filter_size * (w + 3)) ||
+        !FF_ALLOC_TYPED_ARRAY(*filter_pos, w + 3))
+        return AVERROR(ENOMEM);
+
+    /* tiles start at multiples of 16, so the coefficients keep the layout of
+     * ff_shuffle_filter_coefficients() */
+    memcpy(*filter, src_filter + x * filter_size, w * filter_size * sizeof(**filter));
+    for (int i = 0; i < w; i++)
+        (*filter_pos)[i] = src_pos[x + i] - src_x;
+    (*filter_pos)[w] = (*filter_pos)[w + 1] = (*filter_pos)[w + 2] = (*filter_pos)[w - 1];
+
+    return 0;
+}
+
+static int init_tile(SwsContext *c, SwsContext *t, int dx0, int dx1)
+{
+    const int cdx0 = dx0 >> c->chrDstHSubSample;
+    const int cdx1 = dx1 == c->dstW ? c->chrDstW : dx1 >> c->chrDstHSubSample;
+    const int align = 1 << c->chrSrcHSubSample;
+    int sx0 = INT_MAX, sx1 = 0, csx0 = INT_MAX, csx1 = 0;
+    int ret;
+
+    for (int x = dx0; x < dx1; x++) {
+        sx0 = FFMIN(sx0, c->hLumFilterPos[x]);
+        sx1 = FFMAX(sx1, c->hLumFilterPos[x] + c->hLumFilterSize);
+    }
+    for (int x = cdx0; x < cdx1; x++) {
+        csx0 = FFMIN(csx0, c->hChrFilterPos[x]);
+        csx1 = FFMAX(csx1, c->hChrFilterPos[x] + c->hChrFilterSize);
+    }
+    sx0 = FFMIN(sx0, csx0 << c->chrSrcHSubSample) & ~(align - 1);
+    sx1 = FFMIN(FFMAX(sx1, csx1 << c->chrSrcHSubSample), c->srcW);
+
+    t->parent     = c;
+    ret = av_opt_copy(t, c);
+    if (ret < 0)
+        return ret;
+    t->nb_threads = 1;
+    t->tile_width = 0;
+    t->srcW       = sx1 - sx0;
+    t->dstW       = dx1 - dx0;
+    t->tile_src_x = sx0;
+    t->tile_dst_x = dx0;
+
+    ret = sws_init_context(t, NULL, NULL);
+    if (ret < 0)
+        return ret;
+    ret = sws_setColorspaceDetails(t, c->srcColorspaceTable, c->srcRange,
+                                   c->dstColorspaceTable, c->dstRange,
+                                   c->brightness, c->contrast, c->saturation);
+    if (ret < 0)
+        return ret;
+
+    /* the tile must run the same pipeline as the whole frame */
+    if (t->convert_unscaled || t->cascaded_context[0] || !t->hLumFilter ||
+        t->chrDstW != cdx1 - cdx0)
+        return AVERROR(ENOSYS);
+
+    /* and use the horizontal filters of the whole frame */
+    if ((ret = tile_filter(&t->hLumFilter, &t->hLumFilterPos, c->hLumFilter,
+                           c->hLumFilterPos, c->hLumFilterSize, dx0, t->dstW, sx0)) < 0 ||
+        (ret = tile_filter(&t->hChrFilter, &t->hChrFilterPos, c->hChrFilter,
+                           c->hChrFilterPos, c->hChrFilterSize, cdx0, t->chrDstW,
+                           sx0 >> c->chrSrcHSubSample)) < 0)
+        return ret;
+    t->hLumFilterSize = c->hLumFilterSize;
+    t->hChrFilterSize = c->hChrFilterSize;
+
+    ff_free_filters(t);
+    ff_sws_init_scale(t);
+    return ff_init_filters(t);
+}
+
+/**
+ * Split the destination into column tiles scaled by narrower contexts, so
+ * the per-row working set stays in cache for large frames. The tiles share
+ * the horizontal filters of the whole frame and the output is identical.
+ */
+static int context_init_tiles(SwsContext *c)
+{
+    const AVPixFmtDescriptor *desc_src = av_pix_fmt_desc_get(c->srcFormat);
+    int tile_w = c->tile_width, nb_tiles, ret;
+
+    free_tiles(c);
+
+    if (!tile_w || c->convert_unscaled || c->cascaded_context[0] ||
+        c->hyscale_fast || c->hcscale_fast || !c->hLumFilter ||
+        !isPlanarYUV(c->dstFormat) || usePal(c->srcFormat) || isBayer(c->srcFormat) ||
+        (desc_src->flags & (AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL)) ||
+        c->srcXYZ || c->dstXYZ || c->dither == SWS_DITHER_ED)
+        return 0;
+
+    /* multiples of 64 keep the dither phase and the SIMD alignment */
+    tile_w   = tile_w < 0 ? auto_tile_width(c) : FFALIGN(tile_w, TILE_ALIGN);
+    nb_tiles = (c->dstW + tile_w - 1) / tile_w;
+    if (nb_tiles < 2)
+        return 0;
+    if (c->tile_width < 0) {
+        /* balance the automatic tiles */
+        tile_w   = FFALIGN((c->dstW + nb_tiles - 1) / nb_tiles, TILE_ALIGN);
+        nb_tiles = (c->dstW + tile_w - 1) / tile_w;
+    }
+
+    c->tile_ctx = av_calloc(nb_tiles, sizeof(*c->tile_ctx));
+    if (!c->tile_ctx)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < nb_tiles; i++) {
+        c->tile_ctx[i] = sws_alloc_context();
+        if (!c->tile_ctx[i])
+            return AVERROR(ENOMEM);
+        c->nb_tile_ctx++;
+
+        ret = init_tile(c, c->tile_ctx[i], i * tile_w,
+                        FFMIN((i + 1) * tile_w, c->dstW));
+        if (ret < 0 && ret != AVERROR(ENOMEM)) {
+            av_log(c, AV_LOG_VERBOSE, "Column tiles not supported for this conversion.\n");
+            free_tiles(c);
+            return 0;
+        } else if (ret < 0) {
+            return ret;
+        }
+    }
+
+    av_log(c, AV_LOG_VERBOSE, "Scaling in %d column tiles of %d pixels.\n",
+           nb_tiles, tile_w);
+    return 0;
+}
+
+static int set_colorspace_details(struct SwsContext *c, const int inv_table[4],
+                                  int srcRange, const int table[4], int dstRange,
+                                  int brightness, int contrast, int saturation)
 {
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
@@ -1155,6 +1323,36 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     return 0;
 }
 
+int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
+                             int srcRange, const int table[4], int dstRange,
+                             int brightness, int contrast, int saturation)
+{
+    const int old[5] = { c->srcRange, c->dstRange, c->brightness,
+                         c->contrast, c->saturation };
+    int old_src_table[4], old_dst_table[4], ret;
+
+    if (!c->nb_tile_ctx)
+        return set_colorspace_details(c, inv_table, srcRange, table, dstRange,
+                                      brightness, contrast, saturation);
+
+    memcpy(old_src_table, c->srcColorspaceTable, sizeof(old_src_table));
+    memcpy(old_dst_table, c->dstColorspaceTable, sizeof(old_dst_table));
+
+    ret = set_colorspace_details(c, inv_table, srcRange, table, dstRange,
+                                 brightness, contrast, saturation);
+    if (ret < 0)
+        return ret;
+
+    /* the tiles are set up from the details of the whole frame */
+    if (old[0] != c->srcRange || old[1] != c->dstRange || old[2] != c->brightness ||
+        old[3] != c->contrast || old[4] != c->saturation ||
+        memcmp(old_src_table, c->srcColorspaceTable, sizeof(old_src_table)) ||
+        memcmp(old_dst_table, c->dstColorspaceTable, sizeof(old_dst_table)))
+        return context_init_tiles(c);
+
+    return 0;
+}
+
 int sws_getColorspaceDetails(struct SwsContext *c, int **inv_table,
                              int *srcRange, int **table, int *dstRange,
                              int *brightness, int *contrast, int *saturation)
@@ -1991,8 +2189,12 @@ static int context_init_threaded(SwsContext *c,
 {
     int ret;
 
-    ret = avpriv_slicethread_create(&c->slicethread, (void*)c,
-                                    ff_sws_slice_worker, NULL, c->nb_threads);
+    if (c->shared_threads)
+        ret = avpriv_slicethread_create_shared(&c->slicethread, (void*)c,
+                                               ff_sws_slice_worker, c->nb_threads);
+    else
+        ret = avpriv_slicethread_create(&c->slicethread, (void*)c,
+                                        ff_sws_slice_worker, NULL, c->nb_threads);
     if (ret == AVERROR(ENOSYS)) {
         c->nb_threads = 1;
         return 0;
@@ -2022,6 +2224,11 @@ static int context_init_threaded(SwsContext *c,
         ret = sws_init_single_context(c->slice_ctx[i], src_filter, dst_filter);
         if (ret < 0)
             return ret;
+        if (!src_filter && !dst_filter) {
+            ret = context_init_tiles(c->slice_ctx[i]);
+            if (ret < 0)
+                return ret;
+        }
 
         c->nb_slice_ctx++;
 
@@ -2065,7 +2272,11 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
         // threading disabled in this build, init as single-threaded
     }
 
-    return sws_init_single_context(c, srcFilter, dstFilter);
+    ret = sws_init_single_context(c, srcFilter, dstFilter);
+    if (ret < 0 || srcFilter || dstFilter)
+        return ret;
+
+    return context_init_tiles(c);
 }
 
 SwsContext *sws_alloc_set_opts(int srcW, int srcH, enum AVPixelFormat srcFormat,
@@ -2435,6 +2646,8 @@ void sws_freeContext(SwsContext *c)
     av_freep(&c->slice_ctx);
     av_freep(&c->slice_err);
 
+    free_tiles(c);
+
     avpriv_slicethread_free(&c->slicethread);
 
     for (i = 0; i < 4; i++)
@@ -279,7 +279,7 @@ void ff_init_vscale_pfn(SwsContext *c,
             --idx;
             if (yuv2nv12cX)             chrCtx->pfn.yuv2interleavedX = yuv2nv12cX;
             else if (c->vChrFilterSize == 1) chrCtx->pfn.yuv2planar1 = yuv2plane1;
-            else                             chrCtx->pfn.yuv2planarX = yuv2planeX;
+            else                             chrCtx->pfn.yuv2planarX = use_mmx ? yuv2planeX : ff_sws_fixed_planeX(c, yuv2planeX, c->vChrFilterSize); //PLEX
         }
 
         lumCtx = c->desc[idx].instance;
@@ -291,7 +291,7 @@ void ff_init_vscale_pfn(SwsContext *c,
         lumCtx->isMMX = use_mmx;
 
         if (c->vLumFilterSize == 1) lumCtx->pfn.yuv2planar1 = yuv2plane1;
-        else                        lumCtx->pfn.yuv2planarX = yuv2planeX;
+        else                        lumCtx->pfn.yuv2planarX = use_mmx ? yuv2planeX : ff_sws_fixed_planeX(c, yuv2planeX, c->vLumFilterSize); //PLEX
 
     } else {
         lumCtx = c->desc[idx].instance;
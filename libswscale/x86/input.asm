@@ -118,6 +118,15 @@ pb_shuffle16be:         db  1,  0,  3,  2, \
                             5,  4,  7,  6, \
                             9,  8, 11, 10, \
                            13, 12, 15, 14
+; word indices deinterleaving { U0, V0, U1, V1, ... } across two zmm registers
+pw_p01x_perm_uv:        dw  0,  2,  4,  6,  8, 10, 12, 14, \
+                           16, 18, 20, 22, 24, 26, 28, 30, \
+                           32, 34, 36, 38, 40, 42, 44, 46, \
+                           48, 50, 52, 54, 56, 58, 60, 62, \
+                            1,  3,  5,  7,  9, 11, 13, 15, \
+                           17, 19, 21, 23, 25, 27, 29, 31, \
+                           33, 35, 37, 39, 41, 43, 45, 47, \
+                           49, 51, 53, 55, 57, 59, 61, 63
 SECTION .text
 
 ;-----------------------------------------------------------------------------
@@ -701,6 +710,99 @@ NVXX_TO_UV_FN 5, nv12
 NVXX_TO_UV_FN 5, nv21
 %endif
 
+;-----------------------------------------------------------------------------
+; P010/P012/P016 (little-endian) to the 16-bit intermediate.
+;
+; void p01xLEToY_<opt>(uint8_t *dst, const uint8_t *src, const uint8_t *unused1,
+;                      const uint8_t *unused2, int w);
+; and
+; void p01xLEToUV_<opt>(uint8_t *dstU, uint8_t *dstV, const uint8_t *unused0,
+;                       const uint8_t *src, const uint8_t *unused1, int w);
+;-----------------------------------------------------------------------------
+
+; %1 = nr. of bits (10, 12)
+%macro P01X_TO_Y_FN 1
+cglobal p0%1LEToY, 5, 5, 1, dst, src, unused1, unused2, w
+    movsxdifnidn   wq, wd
+    add            wq, wq
+    add          dstq, wq
+    add          srcq, wq
+    neg            wq
+.loop:
+    movu           m0, [srcq+wq]          ; (word) { Y0 << (16 - %1), ... }
+    psrlw          m0, 16 - %1
+    movu   [dstq+wq], m0
+    add            wq, mmsize
+    jl .loop
+    RET
+%endmacro
+
+; %1 = nr. of bits (10, 12, 16)
+%macro P01X_TO_UV_FN 1
+cglobal p0%1LEToUV, 4, 5, 6, dstU, dstV, unused, src, w
+%if ARCH_X86_64
+    movsxd         wq, dword r5m
+%else ; x86-32
+    mov            wq, r5m
+%endif
+    add            wq, wq
+    add         dstUq, wq
+    add         dstVq, wq
+    lea          srcq, [srcq+wq*2]
+    neg            wq
+%if cpuflag(avx512)
+    movu           m2, [pw_p01x_perm_uv]
+    movu           m3, [pw_p01x_perm_uv+mmsize]
+%else
+    pcmpeqb        m5, m5
+    psrld          m5, 16                 ; (dword) { 0x0000ffff }
+%endif
+.loop:
+    movu           m0, [srcq+wq*2]        ; (word) { U0, V0, U1, V1, ... }
+    movu           m1, [srcq+wq*2+mmsize]
+%if cpuflag(avx512)
+    mova           m4, m2
+    vpermi2w       m4, m0, m1             ; (word) { U0, U1, U2, ... }
+    vpermt2w       m0, m3, m1             ; (word) { V0, V1, V2, ... }
+%else
+    pand           m4, m0, m5
+    pand           m3, m1, m5
+    psrld          m0, 16
+    psrld          m1, 16
+    packusdw       m4, m3                 ; (word) U, lane-interleaved
+    packusdw       m0, m1                 ; (word) V, lane-interleaved
+    vpermq         m4, m4, q3120          ; (word) { U0, U1, U2, ... }
+    vpermq         m0, m0, q3120          ; (word) { V0, V1, V2, ... }
+%endif
+%if %1 < 16
+    psrlw          m4, 16 - %1
+    psrlw          m0, 16 - %1
+%endif
+    movu  [dstUq+wq], m4
+    movu  [dstVq+wq], m0
+    add            wq, mmsize
+    jl .loop
+    RET
+%endmacro
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+P01X_TO_Y_FN  10
+P01X_TO_Y_FN  12
+P01X_TO_UV_FN 10
+P01X_TO_UV_FN 12
+P01X_TO_UV_FN 16
+%endif
+
+%if HAVE_AVX512_EXTERNAL
+INIT_ZMM avx512
+P01X_TO_Y_FN  10
+P01X_TO_Y_FN  12
+P01X_TO_UV_FN 10
+P01X_TO_UV_FN 12
+P01X_TO_UV_FN 16
+%endif
+
 %if ARCH_X86_64
 %define RY_IDX 0
 %define GY_IDX 1
@@ -38,6 +38,12 @@ pw_32:         times 8 dw 32
 pd_255:        times 8 dd 255
 pw_512:        times 8 dw 512
 pw_1024:       times 8 dw 1024
+pw_p010_rnd:   times 16 dw 1 << 4
+pw_p012_rnd:   times 16 dw 1 << 2
+pw_p010_max:   times 16 dw 0x3ff
+pw_p012_max:   times 16 dw 0xfff
+pd_p010_rnd:   times 8 dd 1 << 16
+pd_p012_rnd:   times 8 dd 1 << 14
 pd_65535_invf:             times 8 dd 0x37800080 ;1.0/65535.0
 pd_yuv2gbrp16_start:       times 8 dd -0x40000000
 pd_yuv2gbrp_y_start:       times 8 dd  (1 << 9)
@@ -568,6 +574,160 @@ INIT_YMM avx2
 yuv2nv12cX_fn yuv2nv12
 yuv2nv12cX_fn yuv2nv21
 %endif
+
+;-----------------------------------------------------------------------------
+; AVX2 P010/P012 (little-endian) vertical scaling
+;
+; void ff_yuv2p01xl1_avx2(const int16_t *src, uint8_t *dest, int dstW,
+;                         const uint8_t *dither, int offset)
+;
+; void ff_yuv2p01xlX_avx2(const int16_t *filter, int filterSize,
+;                         const int16_t **src, uint8_t *dest, int dstW,
+;                         const uint8_t *dither, int offset)
+;
+; void ff_yuv2p01xcX_avx2(enum AVPixelFormat format, const uint8_t *dither,
+;                         const int16_t *filter, int filterSize,
+;                         const int16_t **u, const int16_t **v,
+;                         uint8_t *dst, int dstWidth)
+;
+; Bit-exact with the C versions: the taps are summed in pairs with pmaddwd
+; into 32-bit accumulators, then shifted, clipped to %1 bits with packusdw
+; and pminuw, and moved to the high bits of the output words.
+;-----------------------------------------------------------------------------
+
+; accumulate the taps jq and jq + 1 (or jq twice if %4 is 0) of the rows
+; pointed to by %3 into %1 (low words) and %2 (high words); m4 holds the
+; coefficient pair and xq the byte offset in the rows
+%macro P01X_MADD 4
+    mov         tmp1q, [%3q + gprsize * jq]
+    mov         tmp2q, [%3q + gprsize * jq + %4]
+    movu           m5, [tmp1q + xq]
+    movu           m6, [tmp2q + xq]
+    punpcklwd      m7, m5, m6
+    punpckhwd      m5, m5, m6
+    pmaddwd        m7, m7, m4
+    pmaddwd        m5, m5, m4
+    paddd          %1, %1, m7
+    paddd          %2, %2, m5
+%endmacro
+
+; %1 = nr. of bits (10, 12)
+%macro yuv2p01x_fn 1
+cglobal yuv2p0%1l1, 3, 3, 5, src, dst, w
+    movsxdifnidn   wq, wd
+    add            wq, wq
+    add          srcq, wq
+    add          dstq, wq
+    neg            wq
+    mova           m2, [pw_p0%1_rnd]
+    pxor           m3, m3
+    mova           m4, [pw_p0%1_max]
+.loop:
+    movu           m0, [srcq + wq]
+    paddsw         m0, m0, m2
+    psraw          m0, m0, 15 - %1
+    pmaxsw         m0, m0, m3
+    pminsw         m0, m0, m4
+    psllw          m0, m0, 16 - %1
+    movu   [dstq + wq], m0
+    add            wq, mmsize
+    jl .loop
+    RET
+
+cglobal yuv2p0%1lX, 5, 9, 8, filter, fltsize, src, dst, w, x, j, tmp1, tmp2
+    movsxdifnidn   wq, wd
+    add            wq, wq
+    mova           m2, [pd_p0%1_rnd]
+    mova           m3, [pw_p0%1_max]
+    xor            xq, xq
+.outer:
+    mova           m0, m2
+    mova           m1, m2
+    xor            jq, jq
+.inner:
+    lea         tmp1d, [jq + 1]
+    cmp         tmp1d, fltsized
+    jge .tail
+    vpbroadcastd   m4, [filterq + 2 * jq]
+    P01X_MADD      m0, m1, src, gprsize
+    add            jq, 2
+    jmp .inner
+.tail:
+    cmp            jd, fltsized
+    jge .store
+    movzx       tmp1d, word [filterq + 2 * jq]
+    movd          xm4, tmp1d
+    vpbroadcastd   m4, xm4
+    P01X_MADD      m0, m1, src, 0
+.store:
+    psrad          m0, m0, 27 - %1
+    psrad          m1, m1, 27 - %1
+    packusdw       m0, m0, m1
+    pminuw         m0, m0, m3
+    psllw          m0, m0, 16 - %1
+    movu   [dstq + xq], m0
+    add            xq, mmsize
+    cmp            xq, wq
+    jl .outer
+    RET
+
+cglobal yuv2p0%1cX, 8, 12, 10, format, dither, filter, fltsize, u, v, dst, w, x, j, tmp1, tmp2
+    movsxdifnidn   wq, wd
+    add            wq, wq
+    mova           m8, [pd_p0%1_rnd]
+    mova           m9, [pw_p0%1_max]
+    xor            xq, xq
+.outer:
+    mova           m0, m8
+    mova           m1, m8
+    mova           m2, m8
+    mova           m3, m8
+    xor            jq, jq
+.inner:
+    lea         tmp1d, [jq + 1]
+    cmp         tmp1d, fltsized
+    jge .tail
+    vpbroadcastd   m4, [filterq + 2 * jq]
+    P01X_MADD      m0, m1, u, gprsize
+    P01X_MADD      m2, m3, v, gprsize
+    add            jq, 2
+    jmp .inner
+.tail:
+    cmp            jd, fltsized
+    jge .store
+    movzx       tmp1d, word [filterq + 2 * jq]
+    movd          xm4, tmp1d
+    vpbroadcastd   m4, xm4
+    P01X_MADD      m0, m1, u, 0
+    P01X_MADD      m2, m3, v, 0
+.store:
+    psrad          m0, m0, 27 - %1
+    psrad          m1, m1, 27 - %1
+    psrad          m2, m2, 27 - %1
+    psrad          m3, m3, 27 - %1
+    packusdw       m0, m0, m1                ; (word) { U0, ..., U15 }
+    packusdw       m2, m2, m3                ; (word) { V0, ..., V15 }
+    pminuw         m0, m0, m9
+    pminuw         m2, m2, m9
+    psllw          m0, m0, 16 - %1
+    psllw          m2, m2, 16 - %1
+    punpcklwd      m1, m0, m2                ; { U0 V0 .. U3 V3 | U8 V8 .. U11 V11 }
+    punpckhwd      m0, m0, m2                ; { U4 V4 .. U7 V7 | U12 V12 .. U15 V15 }
+    vperm2i128     m2, m1, m0, 0x20
+    vperm2i128     m3, m1, m0, 0x31
+    movu  [dstq + 2 * xq], m2
+    movu  [dstq + 2 * xq + mmsize], m3
+    add            xq, mmsize
+    cmp            xq, wq
+    jl .outer
+    RET
+%endmacro
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+yuv2p01x_fn 10
+yuv2p01x_fn 12
+%endif
 %endif ; ARCH_X86_64
 
 ;-----------------------------------------------------------------------------
@@ -322,6 +322,16 @@ INPUT_FUNCS(sse2);
 INPUT_FUNCS(ssse3);
 INPUT_FUNCS(avx);
 
+#define INPUT_P01X_FUNCS(opt) \
+    INPUT_Y_FUNC(p010LE, opt); \
+    INPUT_Y_FUNC(p012LE, opt); \
+    INPUT_UV_FUNC(p010LE, opt); \
+    INPUT_UV_FUNC(p012LE, opt); \
+    INPUT_UV_FUNC(p016LE, opt)
+
+INPUT_P01X_FUNCS(avx2);
+INPUT_P01X_FUNCS(avx512);
+
 #if ARCH_X86_64
 #define YUV2NV_DECL(fmt, opt) \
 void ff_yuv2 ## fmt ## cX_ ## opt(enum AVPixelFormat format, const uint8_t *dither, \
@@ -332,6 +342,17 @@ void ff_yuv2 ## fmt ## cX_ ## opt(enum AVPixelFormat format, const uint8_t *dith
 YUV2NV_DECL(nv12, avx2);
 YUV2NV_DECL(nv21, avx2);
 
+#define YUV2P01X_DECL(bits, opt) \
+void ff_yuv2p0 ## bits ## l1_ ## opt(const int16_t *src, uint8_t *dest, int dstW, \
+                                     const uint8_t *dither, int offset); \
+void ff_yuv2p0 ## bits ## lX_ ## opt(const int16_t *filter, int filterSize, \
+                                     const int16_t **src, uint8_t *dest, int dstW, \
+                                     const uint8_t *dither, int offset); \
+YUV2NV_DECL(p0 ## bits, opt)
+
+YUV2P01X_DECL(10, avx2);
+YUV2P01X_DECL(12, avx2);
+
 #define YUV2GBRP_FN_DECL(fmt, opt)                                                      \
 void ff_yuv2##fmt##_full_X_ ##opt(SwsContext *c, const int16_t *lumFilter,           \
                                  const int16_t **lumSrcx, int lumFilterSize,         \
@@ -643,6 +664,20 @@ switch(c->dstBpc){ \
         case AV_PIX_FMT_NV42:
             c->yuv2nv12cX = ff_yuv2nv21cX_avx2;
             break;
+        case AV_PIX_FMT_P010LE:
+        case AV_PIX_FMT_P210LE:
+        case AV_PIX_FMT_P410LE:
+            c->yuv2plane1 = ff_yuv2p010l1_avx2;
+            c->yuv2planeX = ff_yuv2p010lX_avx2;
+            c->yuv2nv12cX = ff_yuv2p010cX_avx2;
+            break;
+        case AV_PIX_FMT_P012LE:
+        case AV_PIX_FMT_P212LE:
+        case AV_PIX_FMT_P412LE:
+            c->yuv2plane1 = ff_yuv2p012l1_avx2;
+            c->yuv2planeX = ff_yuv2p012lX_avx2;
+            c->yuv2nv12cX = ff_yuv2p012cX_avx2;
+            break;
         default:
             break;
         }
@@ -744,6 +779,41 @@ switch(c->dstBpc){ \
         }
     }
 
+#define INPUT_P01X_CASES(opt) \
+        case AV_PIX_FMT_P010LE: \
+        case AV_PIX_FMT_P210LE: \
+        case AV_PIX_FMT_P410LE: \
+            c->lumToYV12 = ff_p010LEToY_ ## opt; \
+            c->chrToYV12 = ff_p010LEToUV_ ## opt; \
+            break; \
+        case AV_PIX_FMT_P012LE: \
+        case AV_PIX_FMT_P212LE: \
+        case AV_PIX_FMT_P412LE: \
+            c->lumToYV12 = ff_p012LEToY_ ## opt; \
+            c->chrToYV12 = ff_p012LEToUV_ ## opt; \
+            break; \
+        case AV_PIX_FMT_P016LE: \
+        case AV_PIX_FMT_P216LE: \
+        case AV_PIX_FMT_P416LE: \
+            c->chrToYV12 = ff_p016LEToUV_ ## opt; \
+            break;
+
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        switch (c->srcFormat) {
+        INPUT_P01X_CASES(avx2)
+        default:
+            break;
+        }
+    }
+
+    if (EXTERNAL_AVX512(cpu_flags)) {
+        switch (c->srcFormat) {
+        INPUT_P01X_CASES(avx512)
+        default:
+            break;
+        }
+    }
+
     if(c->flags & SWS_FULL_CHR_H_INT) {
 
         /* yuv2gbrp uses the SwsContext for yuv coefficients
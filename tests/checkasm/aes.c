@@ -0,0 +1,72 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavutil/aes.h"
+#include "libavutil/aes_internal.h"
+#include "libavutil/mem_internal.h"
+
+/* not a multiple of the four blocks the SIMD versions run at once */
+#define MAX_BLOCKS 11
+
+static void check_aes(int key_bits, int decrypt)
+{
+    LOCAL_ALIGNED_16(uint8_t, src,  [MAX_BLOCKS * 16]);
+    LOCAL_ALIGNED_16(uint8_t, dst0, [MAX_BLOCKS * 16]);
+    LOCAL_ALIGNED_16(uint8_t, dst1, [MAX_BLOCKS * 16]);
+    uint8_t key[32], iv0[16], iv1[16];
+    AVAES a;
+
+    declare_func(void, AVAES *a, uint8_t *dst, const uint8_t *src,
+                 int count, uint8_t *iv, int rounds);
+
+    for (int i = 0; i < sizeof(key); i++)
+        key[i] = rnd();
+    av_aes_init(&a, key, key_bits, decrypt);
+
+    if (!check_func(a.crypt, "aes_%s_%d", decrypt ? "decrypt" : "encrypt", key_bits))
+        return;
+
+    for (int cbc = 0; cbc < 2; cbc++) {
+        for (int count = 1; count <= MAX_BLOCKS; count++) {
+            for (int i = 0; i < MAX_BLOCKS * 16; i++)
+                src[i] = rnd();
+            for (int i = 0; i < 16; i++)
+                iv0[i] = iv1[i] = rnd();
+
+            call_ref(&a, dst0, src, count, cbc ? iv0 : NULL, a.rounds);
+            /* in place, the way the demuxers call it */
+            memcpy(dst1, src, count * 16);
+            call_new(&a, dst1, dst1, count, cbc ? iv1 : NULL, a.rounds);
+            if (memcmp(dst0, dst1, count * 16) || memcmp(iv0, iv1, 16))
+                fail();
+        }
+    }
+
+    bench_new(&a, dst1, src, MAX_BLOCKS, NULL, a.rounds);
+}
+
+void checkasm_check_aes(void)
+{
+    for (int decrypt = 0; decrypt < 2; decrypt++)
+        for (int key_bits = 128; key_bits <= 256; key_bits += 64)
+            check_aes(key_bits, decrypt);
+    report("aes");
+}
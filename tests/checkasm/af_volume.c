@@ -0,0 +1,61 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavfilter/af_volume.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem_internal.h"
+
+#include "checkasm.h"
+
+#define LEN 1024
+
+static void check_scale_samples(enum AVSampleFormat fmt, int bps, int volume,
+                                const char *name)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,     [LEN * 4]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [LEN * 4]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [LEN * 4]);
+    VolumeContext vol = { .sample_fmt = fmt, .volume_i = volume };
+
+    declare_func(void, uint8_t *dst, const uint8_t *src, int nb_samples,
+                 int volume);
+
+    for (int i = 0; i < LEN * 4; i += 4)
+        AV_WN32A(src + i, rnd());
+
+    ff_volume_init(&vol);
+    if (check_func(vol.scale_samples, "%s", name)) {
+        memset(dst_ref, 0, LEN * bps);
+        memset(dst_new, 0, LEN * bps);
+        call_ref(dst_ref, src, LEN, volume);
+        call_new(dst_new, src, LEN, volume);
+        if (memcmp(dst_ref, dst_new, LEN * bps))
+            fail();
+        bench_new(dst_new, src, LEN, volume);
+    }
+}
+
+void checkasm_check_volume(void)
+{
+    /* gains up to 128x and 16x, so saturation is covered too */
+    check_scale_samples(AV_SAMPLE_FMT_S16, 2, rnd() % 32768,    "scale_samples_s16");
+    check_scale_samples(AV_SAMPLE_FMT_S32, 4, rnd() % (1 << 12), "scale_samples_s32");
+    report("scale_samples");
+}
@@ -0,0 +1,166 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem_internal.h"
+
+#include "libavcodec/dcadata.h"
+#include "libavcodec/dcadsp.h"
+#include "libavcodec/mathops.h"
+
+#include "checkasm.h"
+
+#define NSUBBANDS   32
+#define NSAMPLES    64
+#define LBR_HISTORY 8
+
+static void check_decode_hf(DCADSPContext *c)
+{
+    LOCAL_ALIGNED_16(int32_t, ref_buf, [NSUBBANDS * NSAMPLES]);
+    LOCAL_ALIGNED_16(int32_t, new_buf, [NSUBBANDS * NSAMPLES]);
+    int32_t *ref[NSUBBANDS], *new[NSUBBANDS];
+    int32_t vq_index[NSUBBANDS];
+    int32_t scale_factors[NSUBBANDS][2];
+    int i;
+
+    declare_func(void, int32_t **dst, const int32_t *vq_index,
+                 const int8_t hf_vq[1024][32], int32_t scale_factors[32][2],
+                 ptrdiff_t sb_start, ptrdiff_t sb_end,
+                 ptrdiff_t ofs, ptrdiff_t len);
+
+    for (i = 0; i < NSUBBANDS; i++) {
+        ref[i] = ref_buf + i * NSAMPLES;
+        new[i] = new_buf + i * NSAMPLES;
+        vq_index[i] = rnd() & 1023;
+        scale_factors[i][0] = rnd() & 0x7fffff;
+        scale_factors[i][1] = 0;
+    }
+
+    if (check_func(c->decode_hf, "dca_decode_hf")) {
+        int sb_start = rnd() % NSUBBANDS;
+        int ofs      = (rnd() & 3) * 8;
+        int len      = ((rnd() & 3) + 1) * 8;
+
+        memset(ref_buf, 0, NSUBBANDS * NSAMPLES * sizeof(*ref_buf));
+        memset(new_buf, 0, NSUBBANDS * NSAMPLES * sizeof(*new_buf));
+        call_ref(ref, vq_index, ff_dca_high_freq_vq, scale_factors,
+                 sb_start, NSUBBANDS, ofs, len);
+        call_new(new, vq_index, ff_dca_high_freq_vq, scale_factors,
+                 sb_start, NSUBBANDS, ofs, len);
+        if (memcmp(ref_buf, new_buf, NSUBBANDS * NSAMPLES * sizeof(*ref_buf)))
+            fail();
+        bench_new(new, vq_index, ff_dca_high_freq_vq, scale_factors,
+                  0, NSUBBANDS, 0, 32);
+    }
+}
+
+static void check_decode_joint(DCADSPContext *c)
+{
+    LOCAL_ALIGNED_16(int32_t, src_buf, [NSUBBANDS * NSAMPLES]);
+    LOCAL_ALIGNED_16(int32_t, ref_buf, [NSUBBANDS * NSAMPLES]);
+    LOCAL_ALIGNED_16(int32_t, new_buf, [NSUBBANDS * NSAMPLES]);
+    int32_t *src[NSUBBANDS], *ref[NSUBBANDS], *new[NSUBBANDS];
+    int32_t scale_factors[NSUBBANDS];
+    int i;
+
+    declare_func(void, int32_t **dst, int32_t **src,
+                 const int32_t *scale_factors,
+                 ptrdiff_t sb_start, ptrdiff_t sb_end,
+                 ptrdiff_t ofs, ptrdiff_t len);
+
+    for (i = 0; i < NSUBBANDS; i++) {
+        src[i] = src_buf + i * NSAMPLES;
+        ref[i] = ref_buf + i * NSAMPLES;
+        new[i] = new_buf + i * NSAMPLES;
+        scale_factors[i] = sign_extend(rnd(), 24);
+    }
+    for (i = 0; i < NSUBBANDS * NSAMPLES; i++)
+        src_buf[i] = sign_extend(rnd(), 24);
+
+    if (check_func(c->decode_joint, "dca_decode_joint")) {
+        int sb_start = rnd() % (NSUBBANDS + 1);
+        int sb_end   = rnd() % (NSUBBANDS + 1);
+        int ofs      = (rnd() & 3) * 8;
+        int len      = ((rnd() & 3) + 1) * 8;
+
+        memset(ref_buf, 0, NSUBBANDS * NSAMPLES * sizeof(*ref_buf));
+        memset(new_buf, 0, NSUBBANDS * NSAMPLES * sizeof(*new_buf));
+        call_ref(ref, src, scale_factors, sb_start, sb_end, ofs, len);
+        call_new(new, src, scale_factors, sb_start, sb_end, ofs, len);
+        if (memcmp(ref_buf, new_buf, NSUBBANDS * NSAMPLES * sizeof(*ref_buf)))
+            fail();
+        bench_new(new, src, scale_factors, 0, NSUBBANDS, 0, 32);
+    }
+}
+
+static void check_lbr_bank(DCADSPContext *c)
+{
+    LOCAL_ALIGNED_16(float, in_buf, [NSUBBANDS], [LBR_HISTORY + NSAMPLES]);
+    LOCAL_ALIGNED_16(float, ref, [NSUBBANDS], [4]);
+    LOCAL_ALIGNED_16(float, new, [NSUBBANDS], [4]);
+    float *input[NSUBBANDS];
+    int i, j;
+
+    declare_func(void, float output[32][4], float **input,
+                 const float *coeff, ptrdiff_t ofs, ptrdiff_t len);
+
+    for (i = 0; i < NSUBBANDS; i++) {
+        input[i] = in_buf[i] + LBR_HISTORY;
+        for (j = 0; j < LBR_HISTORY + NSAMPLES; j++)
+            in_buf[i][j] = (float)rnd() / (UINT_MAX >> 1) - 1.0f;
+    }
+
+    if (check_func(c->lbr_bank, "dca_lbr_bank")) {
+        int ofs = (rnd() % (NSAMPLES / 4)) * 4;
+        int len = 8 << (rnd() % 3);
+
+        call_ref(ref, input, ff_dca_bank_coeff, ofs, len);
+        call_new(new, input, ff_dca_bank_coeff, ofs, len);
+        for (i = 0; i < len; i++) {
+            for (j = 0; j < 4; j++) {
+                if (!float_near_abs_eps(ref[i][j], new[i][j], 1.0e-6f)) {
+                    fail();
+                    fprintf(stderr, "output[%d][%d]: %g != %g\n",
+                            i, j, ref[i][j], new[i][j]);
+                    break;
+                }
+            }
+        }
+        bench_new(new, input, ff_dca_bank_coeff, 0, NSUBBANDS);
+    }
+}
+
+void checkasm_check_dcadsp(void)
+{
+    DCADSPContext c;
+
+    ff_dcadsp_init(&c);
+
+    check_decode_hf(&c);
+    report("decode_hf");
+
+    check_decode_joint(&c);
+    report("decode_joint");
+
+    check_lbr_bank(&c);
+    report("lbr_bank");
+}
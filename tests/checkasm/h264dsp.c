@@ -440,6 +440,34 @@ static void check_loop_filter_intra(void)
     }
 }
 
+static void check_startcode(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf, [1024 + AV_INPUT_BUFFER_PADDING_SIZE]);
+    H264DSPContext h;
+
+    declare_func(int, const uint8_t *buf, int size);
+
+    ff_h264dsp_init(&h, 8, 1);
+    if (check_func(h.startcode_find_candidate, "startcode_find_candidate")) {
+        /* from one in a few bytes to no zero byte at all */
+        for (int density = 4; density <= 4096; density *= 4) {
+            for (int i = 0; i < 1024 + AV_INPUT_BUFFER_PADDING_SIZE; i++)
+                buf[i] = rnd() % density ? rnd() | 1 : 0;
+
+            for (int size = 0; size <= 1024; size += 1 + (rnd() & 63)) {
+                int ref = call_ref(buf, size);
+                int new = call_new(buf, size);
+                /* the C version may also return past size when there is
+                 * no zero byte */
+                if (FFMIN(ref, size) != FFMIN(new, size))
+                    fail();
+            }
+        }
+        memset(buf, 0xff, 1024);
+        bench_new(buf, 1024);
+    }
+}
+
 void checkasm_check_h264dsp(void)
 {
     check_idct();
@@ -451,4 +479,7 @@ void checkasm_check_h264dsp(void)
 
     check_loop_filter_intra();
     report("loop_filter_intra");
+
+    check_startcode();
+    report("startcode");
 }
@@ -0,0 +1,65 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "checkasm.h"
+#include "libavfilter/scene_sad.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem_internal.h"
+
+/* an odd width also covers the C tail of the SIMD versions */
+#define WIDTH  333
+#define HEIGHT 64
+#define STRIDE 768
+
+static void check_scene_sad(int depth)
+{
+    LOCAL_ALIGNED_32(uint8_t, src1, [STRIDE * HEIGHT]);
+    LOCAL_ALIGNED_32(uint8_t, src2, [STRIDE * HEIGHT]);
+    ff_scene_sad_fn sad = ff_scene_sad_get_fn(depth);
+    const int bytes = depth > 8 ? 2 : 1;
+    uint64_t sum_ref, sum_new;
+
+    declare_func(void, const uint8_t *src1, ptrdiff_t stride1,
+                 const uint8_t *src2, ptrdiff_t stride2,
+                 ptrdiff_t width, ptrdiff_t height, uint64_t *sum);
+
+    for (int i = 0; i < STRIDE * HEIGHT; i += bytes) {
+        if (bytes == 2) {
+            AV_WN16A(src1 + i, rnd());
+            AV_WN16A(src2 + i, rnd());
+        } else {
+            src1[i] = rnd();
+            src2[i] = rnd();
+        }
+    }
+
+    if (check_func(sad, "scene_sad%d", depth)) {
+        call_ref(src1, STRIDE, src2, STRIDE, WIDTH, HEIGHT, &sum_ref);
+        call_new(src1, STRIDE, src2, STRIDE, WIDTH, HEIGHT, &sum_new);
+        if (sum_ref != sum_new)
+            fail();
+        bench_new(src1, STRIDE, src2, STRIDE, WIDTH, HEIGHT, &sum_new);
+    }
+}
+
+void checkasm_check_scene_sad(void)
+{
+    check_scene_sad(8);
+    check_scene_sad(16);
+    report("scene_sad");
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <float.h>
+
+#include "libavutil/channel_layout.h"
+#include "libavutil/mem_internal.h"
+#include "libswresample/swresample_internal.h"
+
+#include "checkasm.h"
+
+/* the SIMD versions are only used on multiples of 16 samples */
+#define LEN 1024
+
+#define randomize_buffer(buf)                          \
+    for (int i = 0; i < LEN; i++)                      \
+        buf[i] = (float)rnd() / (UINT_MAX >> 1) - 1.0f
+
+/*
+ * Only the float mixers are covered: the s16 SIMD versions take their own
+ * coefficient layout, so they cannot be called against the C ones with the
+ * same matrix.
+ */
+void checkasm_check_sw_rematrix(void)
+{
+    LOCAL_ALIGNED_32(float, in1,  [LEN]);
+    LOCAL_ALIGNED_32(float, in2,  [LEN]);
+    LOCAL_ALIGNED_32(float, out0, [LEN]);
+    LOCAL_ALIGNED_32(float, out1, [LEN]);
+    AVChannelLayout in_layout  = AV_CHANNEL_LAYOUT_5POINT1;
+    AVChannelLayout out_layout = AV_CHANNEL_LAYOUT_STEREO;
+    SwrContext *s = NULL;
+    void *coeff;
+    /* FL from FL and FC, the usual downmix pair */
+    const int index1 = 0, index2 = 2;
+
+    if (swr_alloc_set_opts2(&s, &out_layout, AV_SAMPLE_FMT_FLTP, 48000,
+                                &in_layout,  AV_SAMPLE_FMT_FLTP, 48000,
+                            0, NULL) < 0 || swr_init(s) < 0)
+        goto end;
+    coeff = s->native_simd_matrix ? s->native_simd_matrix : s->native_matrix;
+
+    randomize_buffer(in1);
+    randomize_buffer(in2);
+
+    {
+        declare_func(void, void *out, const void *in, void *coeffp,
+                     integer index, integer len);
+
+        if (check_func(s->mix_1_1_simd ? s->mix_1_1_simd : s->mix_1_1_f,
+                       "mix_1_1_float")) {
+            call_ref(out0, in1, coeff, index2, LEN);
+            call_new(out1, in1, coeff, index2, LEN);
+            if (!float_near_abs_eps_array(out0, out1, FLT_EPSILON, LEN))
+                fail();
+            bench_new(out1, in1, coeff, index2, LEN);
+        }
+    }
+
+    {
+        declare_func(void, void *out, const void *in1, const void *in2,
+                     void *coeffp, integer index1, integer index2, integer len);
+
+        if (check_func(s->mix_2_1_simd ? s->mix_2_1_simd : s->mix_2_1_f,
+                       "mix_2_1_float")) {
+            call_ref(out0, in1, in2, coeff, index1, index2, LEN);
+            call_new(out1, in1, in2, coeff, index1, index2, LEN);
+            if (!float_near_abs_eps_array(out0, out1, FLT_EPSILON, LEN))
+                fail();
+            bench_new(out1, in1, in2, coeff, index1, index2, LEN);
+        }
+    }
+
+    report("rematrix");
+end:
+    swr_free(&s);
+}
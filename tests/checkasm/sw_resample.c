@@ -0,0 +1,101 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem_internal.h"
+#include "libswresample/resample.h"
+
+#include "checkasm.h"
+
+#define SRC_LEN 2048
+#define DST_LEN 1024
+
+static void check_resample_common(enum AVSampleFormat fmt, int in_rate,
+                                  int out_rate, int filter_size)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,     [SRC_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [DST_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [DST_LEN * 8]);
+    int bps = av_get_bytes_per_sample(fmt);
+    ResampleContext *c;
+    int n, ret_ref, ret_new;
+
+    declare_func(int, ResampleContext *c, void *dst, const void *src,
+                 int n, int update_ctx);
+
+    c = swri_resampler.init(NULL, out_rate, in_rate, filter_size, 10, 0, 0,
+                            fmt, SWR_FILTER_TYPE_KAISER, 9, 20, 0, 1);
+    if (!c) {
+        fail();
+        return;
+    }
+    /* start on the first full filter window instead of the initial delay */
+    c->index = c->frac = 0;
+    n = FFMIN(DST_LEN, (int64_t)(SRC_LEN - c->filter_length - 1) * out_rate / in_rate - 1);
+
+    for (int i = 0; i < SRC_LEN; i++) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P: AV_WN16A(src + 2 * i, (int16_t)rnd() >> 2);             break;
+        case AV_SAMPLE_FMT_FLTP: ((float  *)src)[i] = (int32_t)rnd() / (float) INT32_MAX; break;
+        case AV_SAMPLE_FMT_DBLP: ((double *)src)[i] = (int32_t)rnd() / (double)INT32_MAX; break;
+        }
+    }
+
+    if (check_func(c->dsp.resample_common, "resample_common_%s_%d",
+                   av_get_sample_fmt_name(fmt), filter_size)) {
+        memset(dst_ref, 0, DST_LEN * bps);
+        memset(dst_new, 0, DST_LEN * bps);
+        ret_ref = call_ref(c, dst_ref, src, n, 0);
+        ret_new = call_new(c, dst_new, src, n, 0);
+        if (ret_ref != ret_new)
+            fail();
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P:
+            if (memcmp(dst_ref, dst_new, n * bps))
+                fail();
+            break;
+        case AV_SAMPLE_FMT_FLTP:
+            if (!float_near_abs_eps_array((float *)dst_ref, (float *)dst_new, 1e-5, n))
+                fail();
+            break;
+        case AV_SAMPLE_FMT_DBLP:
+            if (!double_near_abs_eps_array((double *)dst_ref, (double *)dst_new, 1e-12, n))
+                fail();
+            break;
+        }
+        bench_new(c, dst_new, src, n, 0);
+    }
+
+    swri_resampler.free(&c);
+}
+
+void checkasm_check_sw_resample(void)
+{
+    static const enum AVSampleFormat fmts[] = {
+        AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBLP,
+    };
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(fmts); i++) {
+        check_resample_common(fmts[i], 48000, 44100,  32);
+        check_resample_common(fmts[i], 48000, 44100, 128);
+    }
+    report("resample_common");
+}
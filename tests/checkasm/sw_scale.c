@@ -22,6 +22,7 @@
 #include "libavutil/common.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mem_internal.h"
+#include "libavutil/pixdesc.h"
 
 #include "libswscale/swscale.h"
 #include "libswscale/swscale_internal.h"
@@ -358,6 +359,199 @@ static void check_hscale(void)
     sws_freeContext(ctx);
 }
 
+static const enum AVPixelFormat p01x_formats[] = {
+    AV_PIX_FMT_P010LE, AV_PIX_FMT_P012LE, AV_PIX_FMT_P016LE,
+};
+
+static void check_input_p01x(void)
+{
+    struct SwsContext *ctx;
+    int fi, isi;
+    const int input_sizes[] = {8, 24, 128, 144, 256, 512};
+
+    LOCAL_ALIGNED_32(uint8_t, src, [LARGEST_INPUT_SIZE * 4 + 128]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [LARGEST_INPUT_SIZE * 2 + 64]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [LARGEST_INPUT_SIZE * 2 + 64]);
+
+    randomize_buffers(src, LARGEST_INPUT_SIZE * 4 + 128);
+
+    ctx = sws_alloc_context();
+    if (sws_init_context(ctx, NULL, NULL) < 0)
+        fail();
+
+    for (fi = 0; fi < FF_ARRAY_ELEMS(p01x_formats); fi++) {
+        const char *name = av_get_pix_fmt_name(p01x_formats[fi]);
+
+        ctx->srcFormat = p01x_formats[fi];
+        ff_sws_init_scale(ctx);
+
+        for (isi = 0; isi < FF_ARRAY_ELEMS(input_sizes); isi++) {
+            const int w = input_sizes[isi];
+
+            if (ctx->lumToYV12) {
+                declare_func(void, uint8_t *dst, const uint8_t *src,
+                             const uint8_t *src2, const uint8_t *src3,
+                             int w, uint32_t *pal, void *opq);
+
+                if (check_func(ctx->lumToYV12, "%s_to_y_%d", name, w)) {
+                    memset(dst0, 0, LARGEST_INPUT_SIZE * 2 * sizeof(dst0[0]));
+                    memset(dst1, 0, LARGEST_INPUT_SIZE * 2 * sizeof(dst1[0]));
+
+                    call_ref((uint8_t *)dst0, src, NULL, NULL, w, NULL, NULL);
+                    call_new((uint8_t *)dst1, src, NULL, NULL, w, NULL, NULL);
+                    if (memcmp(dst0, dst1, w * sizeof(dst0[0])))
+                        fail();
+                    if (w == LARGEST_INPUT_SIZE)
+                        bench_new((uint8_t *)dst1, src, NULL, NULL, w, NULL, NULL);
+                }
+            }
+
+            if (ctx->chrToYV12) {
+                declare_func(void, uint8_t *dstU, uint8_t *dstV,
+                             const uint8_t *src0, const uint8_t *src1,
+                             const uint8_t *src2, int w, uint32_t *pal,
+                             void *opq);
+
+                if (check_func(ctx->chrToYV12, "%s_to_uv_%d", name, w)) {
+                    uint16_t *dstV0 = dst0 + LARGEST_INPUT_SIZE + 32;
+                    uint16_t *dstV1 = dst1 + LARGEST_INPUT_SIZE + 32;
+
+                    memset(dst0, 0, LARGEST_INPUT_SIZE * 2 * sizeof(dst0[0]));
+                    memset(dst1, 0, LARGEST_INPUT_SIZE * 2 * sizeof(dst1[0]));
+
+                    call_ref((uint8_t *)dst0, (uint8_t *)dstV0, NULL, src, src, w, NULL, NULL);
+                    call_new((uint8_t *)dst1, (uint8_t *)dstV1, NULL, src, src, w, NULL, NULL);
+                    if (memcmp(dst0, dst1, w * sizeof(dst0[0])) ||
+                        memcmp(dstV0, dstV1, w * sizeof(dst0[0])))
+                        fail();
+                    if (w == LARGEST_INPUT_SIZE)
+                        bench_new((uint8_t *)dst1, (uint8_t *)dstV1, NULL, src, src, w, NULL, NULL);
+                }
+            }
+        }
+    }
+    sws_freeContext(ctx);
+}
+
+static void check_yuv2out(const enum AVPixelFormat *formats, int nb_formats)
+{
+    struct SwsContext *ctx;
+    int fi, fsi, isi, i, j;
+    const int input_sizes[] = {8, 24, 128, 144, 256, 512};
+    const int filter_sizes[] = {1, 2, 3, 4, 8, 16};
+    const uint8_t *dither = ff_dither_8x8_128[0];
+#define LARGEST_FILTER 16
+
+    LOCAL_ALIGNED_32(int16_t, src_pixels, [LARGEST_FILTER * 2 * (LARGEST_INPUT_SIZE + 32)]);
+    LOCAL_ALIGNED_32(int16_t, src, [LARGEST_INPUT_SIZE]);
+    LOCAL_ALIGNED_32(int16_t, filter, [LARGEST_FILTER]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [LARGEST_INPUT_SIZE * 2 + 64]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [LARGEST_INPUT_SIZE * 2 + 64]);
+    const int16_t *usrc[LARGEST_FILTER], *vsrc[LARGEST_FILTER];
+
+    // the full int16_t range exercises the clipping of yuv2plane1, the
+    // filters get 15-bit intermediates as produced by the horizontal scaler
+    randomize_buffers((uint8_t *)src, LARGEST_INPUT_SIZE * sizeof(*src));
+    for (i = 0; i < LARGEST_FILTER * 2 * (LARGEST_INPUT_SIZE + 32); i++)
+        src_pixels[i] = rnd() & 0x7fff;
+    for (j = 0; j < LARGEST_FILTER; j++) {
+        usrc[j] = src_pixels + j * (LARGEST_INPUT_SIZE + 32);
+        vsrc[j] = src_pixels + (j + LARGEST_FILTER) * (LARGEST_INPUT_SIZE + 32);
+    }
+
+    ctx = sws_alloc_context();
+    if (sws_init_context(ctx, NULL, NULL) < 0)
+        fail();
+
+    for (fi = 0; fi < nb_formats; fi++) {
+        const char *name = av_get_pix_fmt_name(formats[fi]);
+        // the x86 8-bit vertical scalers are only accurate to +-2
+        const int tol = av_pix_fmt_desc_get(formats[fi])->comp[0].depth == 8 ? 2 : 0;
+
+        ctx->dstFormat = formats[fi];
+        ff_sws_init_scale(ctx);
+
+        for (isi = 0; isi < FF_ARRAY_ELEMS(input_sizes); isi++) {
+            const int w = input_sizes[isi];
+
+            {
+                declare_func(void, const int16_t *src, uint8_t *dest,
+                             int dstW, const uint8_t *dither, int offset);
+
+                if (check_func(ctx->yuv2plane1, "yuv2%s_1_%d", name, w)) {
+                    memset(dst0, 0, LARGEST_INPUT_SIZE * sizeof(dst0[0]));
+                    memset(dst1, 0, LARGEST_INPUT_SIZE * sizeof(dst1[0]));
+                    call_ref(src, (uint8_t *)dst0, w, dither, 0);
+                    call_new(src, (uint8_t *)dst1, w, dither, 0);
+                    if (cmp_off_by_n((uint8_t *)dst0, (uint8_t *)dst1, w * sizeof(dst0[0]), tol))
+                        fail();
+                    if (w == LARGEST_INPUT_SIZE)
+                        bench_new(src, (uint8_t *)dst1, w, dither, 0);
+                }
+            }
+
+            for (fsi = 0; fsi < FF_ARRAY_ELEMS(filter_sizes); fsi++) {
+                const int filter_size = filter_sizes[fsi];
+
+                // coefficients of a 4096 sum to 1.0; keep the sum in range
+                for (j = 0; j < filter_size; j++)
+                    filter[j] = (int)(rnd() % 4096) - 2048;
+
+                {
+                    declare_func(void, const int16_t *filter, int filterSize,
+                                 const int16_t **src, uint8_t *dest, int dstW,
+                                 const uint8_t *dither, int offset);
+
+                    if (check_func(ctx->yuv2planeX, "yuv2%s_X_%d_%d", name, filter_size, w)) {
+                        memset(dst0, 0, LARGEST_INPUT_SIZE * sizeof(dst0[0]));
+                        memset(dst1, 0, LARGEST_INPUT_SIZE * sizeof(dst1[0]));
+                        call_ref(filter, filter_size, usrc, (uint8_t *)dst0, w, dither, 0);
+                        call_new(filter, filter_size, usrc, (uint8_t *)dst1, w, dither, 0);
+                        if (cmp_off_by_n((uint8_t *)dst0, (uint8_t *)dst1, w * sizeof(dst0[0]), tol))
+                            fail();
+                        if (w == LARGEST_INPUT_SIZE)
+                            bench_new(filter, filter_size, usrc, (uint8_t *)dst1, w, dither, 0);
+                    }
+                }
+
+                {
+                    declare_func(void, enum AVPixelFormat format, const uint8_t *dither,
+                                 const int16_t *filter, int filterSize,
+                                 const int16_t **u, const int16_t **v,
+                                 uint8_t *dst, int dstWidth);
+
+                    if (check_func(ctx->yuv2nv12cX, "yuv2%s_cX_%d_%d", name, filter_size, w)) {
+                        memset(dst0, 0, LARGEST_INPUT_SIZE * 2 * sizeof(dst0[0]));
+                        memset(dst1, 0, LARGEST_INPUT_SIZE * 2 * sizeof(dst1[0]));
+                        call_ref(ctx->dstFormat, dither, filter, filter_size, usrc, vsrc, (uint8_t *)dst0, w);
+                        call_new(ctx->dstFormat, dither, filter, filter_size, usrc, vsrc, (uint8_t *)dst1, w);
+                        if (cmp_off_by_n((uint8_t *)dst0, (uint8_t *)dst1, w * 2 * sizeof(dst0[0]), tol))
+                            fail();
+                        if (w == LARGEST_INPUT_SIZE)
+                            bench_new(ctx->dstFormat, dither, filter, filter_size, usrc, vsrc, (uint8_t *)dst1, w);
+                    }
+                }
+            }
+        }
+    }
+    sws_freeContext(ctx);
+}
+
+static void check_yuv2p01x(void)
+{
+    check_yuv2out(p01x_formats, 2);
+}
+
+static void check_yuv2nbps(void)
+{
+    static const enum AVPixelFormat formats[] = {
+        AV_PIX_FMT_NV12, AV_PIX_FMT_NV21,
+        AV_PIX_FMT_YUV420P9LE, AV_PIX_FMT_YUV420P10LE,
+        AV_PIX_FMT_YUV420P12LE, AV_PIX_FMT_YUV420P14LE,
+    };
+    check_yuv2out(formats, FF_ARRAY_ELEMS(formats));
+}
+
 void checkasm_check_sw_scale(void)
 {
     check_hscale();
@@ -368,4 +562,10 @@ void checkasm_check_sw_scale(void)
     check_yuv2yuvX(0);
     check_yuv2yuvX(1);
     report("yuv2yuvX");
+    check_input_p01x();
+    report("input_p01x");
+    check_yuv2p01x();
+    report("yuv2p01x");
+    check_yuv2nbps();
+    report("yuv2nbps");
 }
@@ -31,7 +31,7 @@
     for (size_t i = 0; i < count; i++) \
         buf0[i] = buf1[i] = (rnd() & 1) != 0 ? mask : 0;
 
-#define BODY(type, depth)                                                      \
+#define BODY(type, depth, par)                                                 \
     do {                                                                       \
         type prev0[9*WIDTH], prev1[9*WIDTH];                                   \
         type next0[9*WIDTH], next1[9*WIDTH];                                   \
@@ -52,11 +52,11 @@
         call_ref(dst0, prev0 + 4*WIDTH, cur0 + 4*WIDTH, next0 + 4*WIDTH,       \
                 WIDTH, stride, -stride, 2*stride, -2*stride,                   \
                 3*stride, -3*stride, 4*stride, -4*stride,                      \
-                0, mask);                                                      \
+                par, mask);                                                    \
         call_new(dst1, prev1 + 4*WIDTH, cur1 + 4*WIDTH, next1 + 4*WIDTH,       \
                 WIDTH, stride, -stride, 2*stride, -2*stride,                   \
                 3*stride, -3*stride, 4*stride, -4*stride,                      \
-                0, mask);                                                      \
+                par, mask);                                                    \
                                                                                \
         if (memcmp(dst0, dst1, sizeof dst0)                                    \
                 || memcmp(prev0, prev1, sizeof prev0)                          \
@@ -66,26 +66,42 @@
         bench_new(dst1, prev1 + 4*WIDTH, cur1 + 4*WIDTH, next1 + 4*WIDTH,      \
                 WIDTH, stride, -stride, 2*stride, -2*stride,                   \
                 3*stride, -3*stride, 4*stride, -4*stride,                      \
-                0, mask);                                                      \
+                par, mask);                                                    \
     } while (0)
 
 void checkasm_check_vf_bwdif(void)
 {
-    BWDIFDSPContext ctx_8, ctx_10;
+    BWDIFDSPContext ctx_8, ctx_10, ctx_12;
 
     ff_bwdif_init_filter_line(&ctx_8, 8);
     ff_bwdif_init_filter_line(&ctx_10, 10);
+    ff_bwdif_init_filter_line(&ctx_12, 12);
 
     if (check_func(ctx_8.filter_line, "bwdif8")) {
-        BODY(uint8_t, 8);
+        BODY(uint8_t, 8, 0);
         report("bwdif8");
     }
 
     if (check_func(ctx_10.filter_line, "bwdif10")) {
-        BODY(uint16_t, 10);
+        BODY(uint16_t, 10, 0);
         report("bwdif10");
     }
 
+    if (check_func(ctx_12.filter_line, "bwdif12")) {
+        BODY(uint16_t, 12, 0);
+        report("bwdif12");
+    }
+
+    if (check_func(ctx_8.filter_line, "bwdif8.p1")) {
+        BODY(uint8_t, 8, 1);
+        report("bwdif8.p1");
+    }
+
+    if (check_func(ctx_10.filter_line, "bwdif10.p1")) {
+        BODY(uint16_t, 10, 1);
+        report("bwdif10.p1");
+    }
+
     if (!ctx_8.filter_line3)
         ctx_8.filter_line3 = ff_bwdif_filter_line3_c;
 
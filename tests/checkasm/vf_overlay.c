@@ -0,0 +1,133 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/vf_overlay.h"
+#include "libavutil/mem_internal.h"
+
+#define WIDTH 256
+#define FAST_DIV255(x) ((((x) + 128) * 257) >> 16)
+
+/*
+ * C equivalents of the filter's inline 8-bit blend (straight alpha, no main
+ * alpha, even overlay width); the SIMD rows may stop short and leave the
+ * rest of the row to them.
+ */
+static int blend_row_44_c(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
+                          int w, ptrdiff_t alinesize)
+{
+    for (int x = 0; x < w; x++)
+        d[x] = FAST_DIV255(d[x] * (255 - a[x]) + s[x] * a[x]);
+    return w;
+}
+
+static int blend_row_22_c(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
+                          int w, ptrdiff_t alinesize)
+{
+    for (int x = 0; x < w; x++) {
+        int alpha = (a[2 * x] + ((a[2 * x] + a[2 * x + 1]) >> 1)) >> 1;
+        d[x] = FAST_DIV255(d[x] * (255 - alpha) + s[x] * alpha);
+    }
+    return w;
+}
+
+static int blend_row_20_c(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
+                          int w, ptrdiff_t alinesize)
+{
+    for (int x = 0; x < w; x++) {
+        const uint8_t *ax = a + 2 * x;
+        int alpha = (ax[0] + ax[alinesize] + ax[1] + ax[alinesize + 1]) >> 2;
+        d[x] = FAST_DIV255(d[x] * (255 - alpha) + s[x] * alpha);
+    }
+    return w;
+}
+
+static void check_blend_row(int (*blend_row)(uint8_t *d, uint8_t *da, uint8_t *s,
+                                             uint8_t *a, int w, ptrdiff_t alinesize),
+                            int (*blend_c)(uint8_t *d, uint8_t *da, uint8_t *s,
+                                           uint8_t *a, int w, ptrdiff_t alinesize),
+                            int hsub, const char *name)
+{
+    LOCAL_ALIGNED_16(uint8_t, d0, [WIDTH]);
+    LOCAL_ALIGNED_16(uint8_t, d1, [WIDTH]);
+    LOCAL_ALIGNED_16(uint8_t, s,  [WIDTH]);
+    LOCAL_ALIGNED_16(uint8_t, a,  [4 * WIDTH]);
+    const ptrdiff_t alinesize = 2 * WIDTH;
+    /* an odd width leaves a tail for the C version */
+    const int w = WIDTH - 5;
+    int c0, c1;
+
+    declare_func(int, uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
+                 int w, ptrdiff_t alinesize);
+
+    if (!check_func(blend_row, "overlay_row_%s", name))
+        return;
+
+    for (int i = 0; i < WIDTH; i++) {
+        d0[i] = d1[i] = rnd();
+        s[i] = rnd();
+    }
+    for (int i = 0; i < 4 * WIDTH; i++) {
+        /* cover the fully transparent and opaque cases too */
+        int r = rnd() & 0x3ff;
+        a[i] = r > 0x300 ? 0 : r > 0x200 ? 255 : r;
+    }
+
+    c0 = call_ref(d0, NULL, s, a, w, alinesize);
+    c1 = call_new(d1, NULL, s, a, w, alinesize);
+    if (c0 < w)
+        blend_c(d0 + c0, NULL, s + c0, a + (c0 << hsub), w - c0, alinesize);
+    if (c1 < w)
+        blend_c(d1 + c1, NULL, s + c1, a + (c1 << hsub), w - c1, alinesize);
+    if (c0 > w || c1 > w || memcmp(d0, d1, WIDTH))
+        fail();
+
+    bench_new(d1, NULL, s, a, w, alinesize);
+}
+
+void checkasm_check_vf_overlay(void)
+{
+    static const struct {
+        int format;
+        enum AVPixelFormat pix_fmt;
+        int hsub;
+        const char *name;
+    } tests[] = {
+        { OVERLAY_FORMAT_YUV444, AV_PIX_FMT_YUV444P, 0, "44" },
+        { OVERLAY_FORMAT_YUV422, AV_PIX_FMT_YUV422P, 1, "22" },
+        { OVERLAY_FORMAT_YUV420, AV_PIX_FMT_YUV420P, 1, "20" },
+    };
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        OverlayContext s = { 0 };
+        int (*blend_c)(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
+                       int w, ptrdiff_t alinesize) =
+            tests[i].format == OVERLAY_FORMAT_YUV444 ? blend_row_44_c :
+            tests[i].format == OVERLAY_FORMAT_YUV422 ? blend_row_22_c :
+                                                       blend_row_20_c;
+
+#if ARCH_X86
+        ff_overlay_init_x86(&s, tests[i].format, tests[i].pix_fmt, 0, 0);
+#endif
+        /* the chroma planes are the subsampled ones */
+        check_blend_row(s.blend_row[1] ? s.blend_row[1] : blend_c, blend_c,
+                        tests[i].hsub, tests[i].name);
+    }
+    report("overlay_row");
+}
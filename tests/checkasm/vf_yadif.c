@@ -0,0 +1,100 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/yadif.h"
+#include "libavutil/mem_internal.h"
+#include "libavutil/pixdesc.h"
+
+#define WIDTH 256
+/* filter_line is called 3 pixels into the line, on all but the edges */
+#define LINE_W (WIDTH - 16)
+
+#define randomize_buffers(buf0, buf1, mask, count) \
+    for (size_t i = 0; i < count; i++) \
+        buf0[i] = buf1[i] = rnd() & mask
+
+#define BODY(type, depth)                                                      \
+    do {                                                                       \
+        LOCAL_ALIGNED_16(type, prev0, [5*WIDTH]);                              \
+        LOCAL_ALIGNED_16(type, prev1, [5*WIDTH]);                              \
+        LOCAL_ALIGNED_16(type, next0, [5*WIDTH]);                              \
+        LOCAL_ALIGNED_16(type, next1, [5*WIDTH]);                              \
+        LOCAL_ALIGNED_16(type, cur0,  [5*WIDTH]);                              \
+        LOCAL_ALIGNED_16(type, cur1,  [5*WIDTH]);                              \
+        LOCAL_ALIGNED_16(type, dst0,  [WIDTH]);                                \
+        LOCAL_ALIGNED_16(type, dst1,  [WIDTH]);                                \
+        const int stride = WIDTH * sizeof(type);                               \
+        const int mask = (1 << depth) - 1;                                     \
+        const int off = 2 * WIDTH + 3;                                         \
+                                                                               \
+        declare_func(void, void *dst, void *prev, void *cur, void *next,       \
+                     int w, int prefs, int mrefs, int parity, int mode);       \
+                                                                               \
+        randomize_buffers(prev0, prev1, mask, 5*WIDTH);                        \
+        randomize_buffers(next0, next1, mask, 5*WIDTH);                        \
+        randomize_buffers( cur0,  cur1, mask, 5*WIDTH);                        \
+        memset(dst0, 0, WIDTH * sizeof(type));                                 \
+        memset(dst1, 0, WIDTH * sizeof(type));                                 \
+                                                                               \
+        call_ref(dst0 + 3, prev0 + off, cur0 + off, next0 + off,               \
+                 LINE_W, stride, -stride, parity, mode);                       \
+        call_new(dst1 + 3, prev1 + off, cur1 + off, next1 + off,               \
+                 LINE_W, stride, -stride, parity, mode);                       \
+                                                                               \
+        if (memcmp(dst0, dst1, WIDTH * sizeof(type))                           \
+                || memcmp(prev0, prev1, 5*WIDTH * sizeof(type))                \
+                || memcmp(next0, next1, 5*WIDTH * sizeof(type))                \
+                || memcmp( cur0,  cur1, 5*WIDTH * sizeof(type)))               \
+            fail();                                                            \
+        bench_new(dst1 + 3, prev1 + off, cur1 + off, next1 + off,              \
+                  LINE_W, stride, -stride, parity, mode);                      \
+    } while (0)
+
+void checkasm_check_vf_yadif(void)
+{
+    static const struct {
+        enum AVPixelFormat fmt;
+        int depth;
+    } formats[] = {
+        { AV_PIX_FMT_YUV420P,    8 },
+        { AV_PIX_FMT_YUV420P10, 10 },
+        { AV_PIX_FMT_YUV420P16, 16 },
+    };
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(formats); i++) {
+        YADIFContext s = { .csp = av_pix_fmt_desc_get(formats[i].fmt) };
+        const int depth = formats[i].depth;
+
+        ff_yadif_init_filter_line(&s);
+
+        /* modes 2 and 3 skip the spatial interlacing check */
+        for (int mode = 0; mode < 4; mode += 2) {
+            for (int parity = 0; parity < 2; parity++) {
+                if (!check_func(s.filter_line, "yadif%d.m%d.p%d", depth, mode, parity))
+                    continue;
+                if (depth == 8)
+                    BODY(uint8_t, 8);
+                else
+                    BODY(uint16_t, depth);
+            }
+        }
+        report("yadif%d", depth);
+    }
+}
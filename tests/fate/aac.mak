@@ -158,6 +158,28 @@ fate-aac-aref-encode: CMP_TARGET = 596
 fate-aac-aref-encode: SIZE_TOLERANCE = 2464
 fate-aac-aref-encode: FUZZ = 89
 
+FATE_AAC_ENCODE += fate-aac-twoloop-encode
+fate-aac-twoloop-encode: ./tests/data/asynth-44100-2.wav
+fate-aac-twoloop-encode: CMD = enc_dec_pcm adts wav s16le $(REF) -c:a aac -aac_coder twoloop -b:a 256k -fflags +bitexact -flags +bitexact
+fate-aac-twoloop-encode: CMP = stddev
+fate-aac-twoloop-encode: REF = ./tests/data/asynth-44100-2.wav
+fate-aac-twoloop-encode: CMP_SHIFT = -4096
+fate-aac-twoloop-encode: CMP_TARGET = 1068
+fate-aac-twoloop-encode: SIZE_TOLERANCE = 2464
+fate-aac-twoloop-encode: FUZZ = 60
+
+# Same input and rate as fate-aac-twoloop-encode, so that the realtime
+# coder stays within reach of twoloop
+FATE_AAC_ENCODE += fate-aac-realtime-encode
+fate-aac-realtime-encode: ./tests/data/asynth-44100-2.wav
+fate-aac-realtime-encode: CMD = enc_dec_pcm adts wav s16le $(REF) -c:a aac -aac_coder realtime -b:a 256k -fflags +bitexact -flags +bitexact
+fate-aac-realtime-encode: CMP = stddev
+fate-aac-realtime-encode: REF = ./tests/data/asynth-44100-2.wav
+fate-aac-realtime-encode: CMP_SHIFT = -4096
+fate-aac-realtime-encode: CMP_TARGET = 999
+fate-aac-realtime-encode: SIZE_TOLERANCE = 2464
+fate-aac-realtime-encode: FUZZ = 60
+
 FATE_AAC_ENCODE += fate-aac-ln-encode
 fate-aac-ln-encode: CMD = enc_dec_pcm adts wav s16le $(TARGET_SAMPLES)/audio-reference/luckynight_2ch_44kHz_s16.wav -c:a aac -aac_coder fast -aac_is 0 -aac_pns 0 -aac_ms 0 -aac_tns 0 -b:a 512k -fflags +bitexact -flags +bitexact
 fate-aac-ln-encode: CMP = stddev
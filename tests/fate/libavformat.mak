@@ -31,6 +31,16 @@ fate-seek_utils: libavformat/tests/seek_utils$(EXESUF)
 fate-seek_utils: CMD = run libavformat/tests/seek_utils$(EXESUF)
 fate-seek_utils: CMP = null
 
+FATE_LIBAVFORMAT += fate-interleave
+fate-interleave: libavformat/tests/interleave$(EXESUF)
+fate-interleave: CMD = run libavformat/tests/interleave$(EXESUF) 60
+fate-interleave: CMP = null
+
+FATE_LIBAVFORMAT += fate-packed_index
+fate-packed_index: libavformat/tests/packed_index$(EXESUF)
+fate-packed_index: CMD = run libavformat/tests/packed_index$(EXESUF) 4
+fate-packed_index: CMP = null
+
 FATE_LIBAVFORMAT += $(FATE_LIBAVFORMAT-yes)
 FATE-$(CONFIG_AVFORMAT) += $(FATE_LIBAVFORMAT)
 fate-libavformat: $(FATE_LIBAVFORMAT)
@@ -0,0 +1,394 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the startup latency after a seek: the file is opened again for
+ * every iteration, seeked to a random position, and the time and I/O spent
+ * until the first decoded frame and optionally the first complete output
+ * segment are reported per phase.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavformat/avio_internal.h"
+#include "libavutil/avstring.h"
+#include "libavutil/lfg.h"
+#include "libavutil/time.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+/* how far past the seek target packets are read at most, in seconds */
+#define MAX_READ_AHEAD 120
+
+enum Phase {
+    PHASE_OPEN,
+    PHASE_INFO,
+    PHASE_SEEK,
+    PHASE_FRAME,
+    PHASE_SEGMENT,
+    NB_PHASES
+};
+
+static const char *const phase_names[NB_PHASES] = {
+    "open", "info", "seek", "frame", "segment",
+};
+
+typedef struct Sample {
+    int64_t target;                 /* seek target, AV_TIME_BASE */
+    int64_t time[NB_PHASES];        /* microseconds, -1 if not reached */
+    int64_t bytes[NB_PHASES];       /* bytes read by the input */
+    int     seeks[NB_PHASES];       /* seeks issued on the input */
+} Sample;
+
+/* the segment file being written, whose close ends the segment phase */
+static struct {
+    AVIOContext *pb;
+    int64_t      closed;
+} segment;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: seek_bench [options] file\n"
+            "Options:\n"
+            "    -n iterations   number of open/seek cycles (default 10)\n"
+            "    -s seed         seed of the seek positions (default 1)\n"
+            "    -f format       also remux to dash or segment and time the first segment\n"
+            "    -o directory    output directory for -f (default .)\n"
+            "    -t seconds      segment duration for -f (default 4)\n"
+            "    -q              only print the summary\n"
+            );
+    exit(ret);
+}
+
+static void io_position(AVFormatContext *avf, int64_t *bytes, int *seeks)
+{
+    *bytes = avf && avf->pb ? ffiocontext(avf->pb)->bytes_read : 0;
+    *seeks = avf && avf->pb ? ffiocontext(avf->pb)->seek_count : 0;
+}
+
+static int io_open(AVFormatContext *s, AVIOContext **pb, const char *url,
+                   int flags, AVDictionary **options)
+{
+    int ret = avio_open2(pb, url, flags, &s->interrupt_callback, options);
+
+    if (ret >= 0 && av_strstart(av_basename(url), "chunk-", NULL))
+        segment.pb = *pb;
+    return ret;
+}
+
+static int io_close2(AVFormatContext *s, AVIOContext *pb)
+{
+    if (pb && pb == segment.pb) {
+        if (!segment.closed)
+            segment.closed = av_gettime_relative();
+        segment.pb = NULL;
+    }
+    return avio_close(pb);
+}
+
+static int open_output(AVFormatContext **poc, const char *format, const char *dir,
+                       double seg_duration, const AVStream *ist)
+{
+    AVDictionary *opts = NULL;
+    AVFormatContext *oc;
+    AVStream *ost;
+    char url[1024], value[32];
+    int ret;
+
+    if (!strcmp(format, "dash")) {
+        snprintf(url, sizeof(url), "%s/manifest.mpd", dir);
+        snprintf(value, sizeof(value), "%g", seg_duration);
+        av_dict_set(&opts, "seg_duration", value, 0);
+        av_dict_set(&opts, "init_seg_name", "init-$RepresentationID$.$ext$", 0);
+        av_dict_set(&opts, "media_seg_name", "chunk-$RepresentationID$-$Number%05d$.$ext$", 0);
+    } else {
+        snprintf(url, sizeof(url), "%s/chunk-%%05d.ts", dir);
+        snprintf(value, sizeof(value), "%g", seg_duration);
+        av_dict_set(&opts, "segment_time", value, 0);
+        av_dict_set(&opts, "segment_format", "mpegts", 0);
+    }
+
+    ret = avformat_alloc_output_context2(&oc, NULL, format, url);
+    if (ret < 0)
+        goto end;
+    *poc = oc;
+    oc->io_open  = io_open;
+    oc->io_close2 = io_close2;
+
+    if (!(ost = avformat_new_stream(oc, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ret = avcodec_parameters_copy(ost->codecpar, ist->codecpar);
+    if (ret < 0)
+        goto end;
+    ost->codecpar->codec_tag = 0;
+    ost->time_base = ist->time_base;
+
+    segment.pb     = NULL;
+    segment.closed = 0;
+    ret = avformat_write_header(oc, &opts);
+end:
+    av_dict_free(&opts);
+    return ret;
+}
+
+static int run(const char *filename, AVLFG *lfg, const char *format,
+               const char *dir, double seg_duration, Sample *s)
+{
+    AVFormatContext *avf = NULL, *oc = NULL;
+    AVCodecContext *dec = NULL;
+    const AVCodec *codec;
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    AVStream *st;
+    int64_t start, bytes, prev_bytes = 0, limit;
+    int seeks, prev_seeks = 0, idx, ret;
+
+    for (int i = 0; i < NB_PHASES; i++)
+        s->time[i] = -1;
+    if (!pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+#define PHASE_END(phase) do {                                   \
+        s->time[phase] = av_gettime_relative() - start;         \
+        io_position(avf, &bytes, &seeks);                       \
+        s->bytes[phase] = bytes - prev_bytes;                   \
+        s->seeks[phase] = seeks - prev_seeks;                   \
+        prev_bytes = bytes;                                     \
+        prev_seeks = seeks;                                     \
+    } while (0)
+
+    start = av_gettime_relative();
+    if ((ret = avformat_open_input(&avf, filename, NULL, NULL)) < 0)
+        goto end;
+    PHASE_END(PHASE_OPEN);
+
+    start = av_gettime_relative();
+    if ((ret = avformat_find_stream_info(avf, NULL)) < 0)
+        goto end;
+    PHASE_END(PHASE_INFO);
+
+    idx = av_find_best_stream(avf, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (idx < 0)
+        idx = av_find_best_stream(avf, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if ((ret = idx) < 0)
+        goto end;
+    st = avf->streams[idx];
+    if (!(dec = avcodec_alloc_context3(codec))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_to_context(dec, st->codecpar)) < 0 ||
+        (ret = avcodec_open2(dec, codec, NULL)) < 0)
+        goto end;
+
+    s->target = avf->start_time != AV_NOPTS_VALUE ? avf->start_time : 0;
+    if (avf->duration > 0)
+        s->target += av_lfg_get(lfg) / (double)UINT32_MAX * avf->duration * 0.9;
+
+    start = av_gettime_relative();
+    if ((ret = avformat_seek_file(avf, -1, INT64_MIN, s->target, s->target, 0)) < 0)
+        goto end;
+    PHASE_END(PHASE_SEEK);
+
+    /* the frame and segment phases both start from the seek */
+    start = av_gettime_relative();
+    if (format && (ret = open_output(&oc, format, dir, seg_duration, st)) < 0)
+        goto end;
+    limit = av_rescale_q(s->target + MAX_READ_AHEAD * AV_TIME_BASE,
+                         AV_TIME_BASE_Q, st->time_base);
+
+    while (s->time[PHASE_FRAME] < 0 || (oc && !segment.closed)) {
+        if ((ret = av_read_frame(avf, pkt)) < 0)
+            break;
+        if (pkt->stream_index != idx) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        if (pkt->dts != AV_NOPTS_VALUE && pkt->dts > limit) {
+            av_packet_unref(pkt);
+            break;
+        }
+
+        if (s->time[PHASE_FRAME] < 0 && avcodec_send_packet(dec, pkt) >= 0 &&
+            avcodec_receive_frame(dec, frame) >= 0) {
+            PHASE_END(PHASE_FRAME);
+            av_frame_unref(frame);
+        }
+        if (oc && !segment.closed) {
+            pkt->stream_index = 0;
+            av_packet_rescale_ts(pkt, st->time_base, oc->streams[0]->time_base);
+            if ((ret = av_interleaved_write_frame(oc, pkt)) < 0)
+                goto end;
+        }
+        av_packet_unref(pkt);
+    }
+    /* a segment cut short by the end of the input is written by the trailer */
+    if (oc) {
+        if ((ret = av_write_trailer(oc)) < 0)
+            goto end;
+        if (segment.closed) {
+            s->time[PHASE_SEGMENT] = segment.closed - start;
+            io_position(avf, &bytes, &seeks);
+            s->bytes[PHASE_SEGMENT] = bytes - prev_bytes;
+            s->seeks[PHASE_SEGMENT] = seeks - prev_seeks;
+        }
+    }
+    ret = 0;
+
+end:
+    avformat_free_context(oc);
+    avcodec_free_context(&dec);
+    avformat_close_input(&avf);
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    return ret;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+    int64_t va = *(const int64_t *)a, vb = *(const int64_t *)b;
+    return (va > vb) - (va < vb);
+}
+
+static void print_summary(const Sample *samples, int nb_samples)
+{
+    int64_t *times = malloc(nb_samples * sizeof(*times));
+
+    if (!times)
+        return;
+    printf("%-8s %6s %10s %10s %10s %12s %8s\n",
+           "phase", "count", "min ms", "median ms", "max ms", "avg bytes", "avg seeks");
+    for (int p = 0; p < NB_PHASES; p++) {
+        int64_t bytes = 0, seeks = 0;
+        int n = 0;
+
+        for (int i = 0; i < nb_samples; i++) {
+            if (samples[i].time[p] < 0)
+                continue;
+            times[n++] = samples[i].time[p];
+            bytes += samples[i].bytes[p];
+            seeks += samples[i].seeks[p];
+        }
+        if (!n)
+            continue;
+        qsort(times, n, sizeof(*times), cmp_int64);
+        printf("%-8s %6d %10.2f %10.2f %10.2f %12"PRId64" %8.1f\n",
+               phase_names[p], n, times[0] / 1000.0, times[n / 2] / 1000.0,
+               times[n - 1] / 1000.0, bytes / n, (double)seeks / n);
+    }
+    free(times);
+}
+
+int main(int argc, char **argv)
+{
+    const char *format = NULL, *dir = ".";
+    double seg_duration = 4;
+    int opt, ret, iterations = 10, quiet = 0, failed = 0;
+    unsigned seed = 1;
+    Sample *samples;
+    AVLFG lfg;
+
+    while ((opt = getopt(argc, argv, "hn:s:f:o:t:q")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            format = optarg;
+            break;
+        case 'o':
+            dir = optarg;
+            break;
+        case 't':
+            seg_duration = atof(optarg);
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc != 1 || iterations <= 0 || seg_duration <= 0 ||
+        (format && strcmp(format, "dash") && strcmp(format, "segment")))
+        usage(1);
+
+    if (!(samples = calloc(iterations, sizeof(*samples))))
+        return 1;
+    av_lfg_init(&lfg, seed);
+
+    if (!quiet)
+        printf("%-4s %10s %9s %9s %9s %9s %9s %10s %6s\n", "iter", "target s",
+               "open ms", "info ms", "seek ms", "frame ms", "segment ms", "bytes", "seeks");
+    for (int i = 0; i < iterations; i++) {
+        Sample *s = &samples[i];
+        int64_t bytes = 0;
+        int seeks = 0;
+
+        ret = run(argv[0], &lfg, format, dir, seg_duration, s);
+        if (ret < 0) {
+            fprintf(stderr, "%s: iteration %d: %s\n", argv[0], i, av_err2str(ret));
+            for (int p = 0; p < NB_PHASES; p++)
+                s->time[p] = -1;
+            failed++;
+            continue;
+        }
+        if (quiet)
+            continue;
+        for (int p = 0; p < NB_PHASES; p++) {
+            bytes += s->bytes[p];
+            seeks += s->seeks[p];
+        }
+        printf("%-4d %10.3f", i, s->target / (double)AV_TIME_BASE);
+        for (int p = 0; p < NB_PHASES; p++) {
+            if (s->time[p] < 0)
+                printf(" %9s", "-");
+            else
+                printf(" %9.2f", s->time[p] / 1000.0);
+        }
+        printf(" %10"PRId64" %6d\n", bytes, seeks);
+    }
+
+    print_summary(samples, iterations);
+    free(samples);
+    return failed == iterations;
+}
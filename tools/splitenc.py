@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+
+import argparse
+import concurrent.futures
+import logging
+import os
+import shlex
+import subprocess
+import tempfile
+
+HELP = '''
+Transcode a file by encoding GOP-aligned chunks of its video in parallel.
+
+The command uses ffprobe to find the keyframes of the first video stream
+and splits the input at the keyframes closest to evenly spaced points. Each
+chunk is decoded, filtered and encoded by its own ffmpeg process with the
+same video options, while the audio is encoded as a single continuous
+stream. The encoded chunks are then stitched back together without
+re-encoding with the concat demuxer, and muxed with the audio.
+
+Since every chunk is encoded separately, constant quality rate control
+(e.g. -crf) gives the most consistent results. Filters must not depend on
+frames from outside their chunk.
+
+ffmpeg options for the final mux can be passed through the extra arguments
+after options, for example as in:
+splitenc.py -i input.mkv -o output.mp4 --video '-c:v libx264 -crf 20' -- -movflags +faststart
+'''
+
+logging.basicConfig(format='splitenc|%(levelname)s> %(message)s', level=logging.INFO)
+log = logging.getLogger()
+
+# Chunk boundaries are moved this far (in seconds) ahead of the keyframe
+# timestamps printed by ffprobe, so that rounding never drops the keyframe
+# from the start of a chunk or adds it to the end of the previous one.
+EPSILON = 0.001
+
+
+class Formatter(
+    argparse.ArgumentDefaultsHelpFormatter, argparse.RawDescriptionHelpFormatter
+):
+    pass
+
+
+def _run_command(cmd, dry_run=False, capture=False):
+    log.info(f"Running command:\n$ {shlex.join(cmd)}")
+    if not dry_run or capture:
+        return subprocess.run(cmd, check=True, stdout=subprocess.PIPE if capture else None,
+                              universal_newlines=True)
+
+
+def probe(args):
+    result = _run_command([
+        'ffprobe', '-v', 'error', '-select_streams', 'v:0', '-of', 'csv=p=0',
+        '-show_entries', 'packet=pts_time,flags', args.input
+    ], capture=True)
+    keyframes = []
+    for line in result.stdout.splitlines():
+        fields = line.strip().split(',')
+        if len(fields) >= 2 and 'K' in fields[1] and fields[0] not in ('', 'N/A'):
+            keyframes.append(float(fields[0]))
+
+    result = _run_command([
+        'ffprobe', '-v', 'error', '-of', 'default=nw=1', '-show_entries',
+        'format=start_time,duration:stream=codec_type', args.input
+    ], capture=True)
+    info = {}
+    for line in result.stdout.splitlines():
+        key, _, value = line.strip().partition('=')
+        info.setdefault(key, []).append(value)
+    has_audio = 'audio' in info.get('codec_type', [])
+    start_time = float(info['start_time'][0]) if info.get('start_time', ['N/A'])[0] != 'N/A' else 0.0
+    duration = float(info['duration'][0])
+
+    # ffmpeg seeks relative to the start time of the input
+    keyframes = [k - start_time for k in keyframes]
+
+    return sorted(keyframes), duration, has_audio
+
+
+def split_points(keyframes, duration, nb_chunks):
+    points = [0.0]
+    for i in range(1, nb_chunks):
+        target = duration * i / nb_chunks
+        point = next((k for k in keyframes if k >= target), None)
+        if point is not None and point > points[-1]:
+            points.append(point)
+    return points
+
+
+def splitenc():
+    parser = argparse.ArgumentParser(description=HELP, formatter_class=Formatter)
+    parser.add_argument('--input', '-i', required=True, help='specify input file')
+    parser.add_argument('--output', '-o', required=True, help='specify output file')
+    parser.add_argument('--jobs', '-j', type=int, default=max(1, (os.cpu_count() or 1) // 8),
+                        help='specify the number of chunks encoded concurrently')
+    parser.add_argument('--chunks', '-c', type=int, default=0,
+                        help='specify the number of chunks, 0 for four per job')
+    parser.add_argument('--video', default='-c:v libx264', help='specify video encoding options')
+    parser.add_argument('--audio', default='-c:a copy', help='specify audio encoding options')
+    parser.add_argument('--workdir', help='specify the directory for the intermediate files')
+    parser.add_argument('--keep', help='keep the intermediate files', action='store_true')
+    parser.add_argument('--dry-run', '-n', help='simulate commands', action='store_true')
+    parser.add_argument('mux_arguments', nargs='*', help='specify options used for the final mux')
+
+    args = parser.parse_args()
+    if args.jobs < 1:
+        parser.error('--jobs must be at least 1')
+
+    keyframes, duration, has_audio = probe(args)
+    points = split_points(keyframes, duration, args.chunks or 4 * args.jobs)
+    log.info(f"Splitting '{args.input}' into {len(points)} chunks")
+
+    workdir = args.workdir or tempfile.mkdtemp(prefix='splitenc-')
+    os.makedirs(workdir, exist_ok=True)
+
+    commands = []
+    chunks = []
+    for i, start in enumerate(points):
+        chunk = os.path.join(workdir, f'chunk{i:05d}.mkv')
+        cmd = ['ffmpeg', '-nostdin', '-v', 'error', '-y']
+        # The first chunk starts at the beginning of the file, so that
+        # nothing in front of the first keyframe gets lost.
+        if i:
+            cmd += ['-ss', f'{start - EPSILON:.6f}']
+        cmd += ['-i', args.input]
+        if i + 1 < len(points):
+            end = points[i + 1]
+            cmd += ['-t', f'{end - start:.6f}' if i else f'{end - EPSILON:.6f}']
+        cmd += ['-map', '0:v:0', '-an', '-sn', '-dn'] + shlex.split(args.video)
+        cmd += ['-f', 'matroska', chunk]
+        commands.append(cmd)
+        chunks.append(chunk)
+
+    audio = os.path.join(workdir, 'audio.mka')
+    if has_audio:
+        commands.append(['ffmpeg', '-nostdin', '-v', 'error', '-y', '-i', args.input,
+                         '-map', '0:a', '-vn', '-sn', '-dn'] + shlex.split(args.audio) +
+                        ['-f', 'matroska', audio])
+
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        for future in [pool.submit(_run_command, cmd, args.dry_run) for cmd in commands]:
+            future.result()
+
+    concat_list = os.path.join(workdir, 'chunks.ffconcat')
+    with open(concat_list, 'w') as f:
+        f.write('ffconcat version 1.0\n')
+        for chunk in chunks:
+            f.write(f"file '{os.path.abspath(chunk)}'\n")
+
+    stitch_cmd = ['ffmpeg', '-nostdin', '-y', '-f', 'concat', '-safe', '0', '-i', concat_list]
+    if has_audio:
+        stitch_cmd += ['-i', audio, '-map', '0:v', '-map', '1:a']
+    stitch_cmd += ['-c', 'copy'] + args.mux_arguments + [args.output]
+    _run_command(stitch_cmd, args.dry_run)
+
+    if not args.keep and not args.dry_run:
+        for path in chunks + [audio, concat_list]:
+            if os.path.exists(path):
+                os.remove(path)
+        if not args.workdir:
+            os.rmdir(workdir)
+
+
+if __name__ == '__main__':
+    splitenc()
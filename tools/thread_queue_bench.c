@@ -0,0 +1,191 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the throughput of the fftools thread queue: a number of producer
+ * threads, one per stream, send packets to a single consumer, like the
+ * encoders feeding a muxer. The order of the packets of every stream and
+ * the EOF of every stream are checked as well.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavcodec/packet.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "fftools/objpool.h"
+#include "fftools/thread_queue.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+typedef struct Producer {
+    pthread_t    thread;
+    ThreadQueue *tq;
+    unsigned int stream_idx;
+    int64_t      nb_packets;
+    int          ret;
+} Producer;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: thread_queue_bench [options]\n"
+            "Options:\n"
+            "    -p producers    number of sending threads, one stream each (default 1)\n"
+            "    -n packets      packets sent by every producer (default 1000000)\n"
+            "    -q size         queue size (default 8)\n"
+            );
+    exit(ret);
+}
+
+static void pkt_move(void *dst, void *src)
+{
+    av_packet_move_ref(dst, src);
+}
+
+static void *producer_thread(void *arg)
+{
+    Producer *p = arg;
+    AVPacket *pkt = av_packet_alloc();
+
+    if (!pkt) {
+        p->ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    for (int64_t i = 0; i < p->nb_packets; i++) {
+        pkt->pts = i;
+        p->ret = tq_send(p->tq, p->stream_idx, pkt);
+        if (p->ret < 0)
+            break;
+    }
+
+finish:
+    tq_send_finish(p->tq, p->stream_idx);
+    av_packet_free(&pkt);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_producers = 1, queue_size = 8, nb_eof = 0, errors = 0, opt;
+    int64_t nb_packets = 1000000, received = 0, *next_pts, start, elapsed;
+    Producer *producers;
+    ThreadQueue *tq;
+    ObjPool *op;
+    AVPacket *pkt;
+
+    while ((opt = getopt(argc, argv, "hp:n:q:")) != -1) {
+        switch (opt) {
+        case 'p': nb_producers = atoi(optarg);    break;
+        case 'n': nb_packets   = atoll(optarg);   break;
+        case 'q': queue_size   = atoi(optarg);    break;
+        case 'h': usage(0);
+        default:  usage(1);
+        }
+    }
+    if (nb_producers <= 0 || nb_packets < 0 || queue_size <= 0)
+        usage(1);
+
+    op        = objpool_alloc_packets();
+    tq        = op ? tq_alloc(nb_producers, queue_size, op, pkt_move) : NULL;
+    producers = av_calloc(nb_producers, sizeof(*producers));
+    next_pts  = av_calloc(nb_producers, sizeof(*next_pts));
+    pkt       = av_packet_alloc();
+    if (!tq || !producers || !next_pts || !pkt) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    start = av_gettime_relative();
+
+    for (int i = 0; i < nb_producers; i++) {
+        producers[i] = (Producer){ .tq = tq, .stream_idx = i, .nb_packets = nb_packets };
+        if (pthread_create(&producers[i].thread, NULL, producer_thread, &producers[i])) {
+            fprintf(stderr, "Could not create a thread\n");
+            return 1;
+        }
+    }
+
+    while (1) {
+        int stream_idx, ret = tq_receive(tq, &stream_idx, pkt);
+
+        if (ret == AVERROR_EOF && stream_idx < 0)
+            break;
+        if (ret == AVERROR_EOF) {
+            if (next_pts[stream_idx] != nb_packets) {
+                fprintf(stderr, "stream %d: EOF after %"PRId64" of %"PRId64" packets\n",
+                        stream_idx, next_pts[stream_idx], nb_packets);
+                errors++;
+            }
+            nb_eof++;
+            continue;
+        }
+        if (ret < 0) {
+            fprintf(stderr, "Receiving failed: %s\n", av_err2str(ret));
+            return 1;
+        }
+        if (pkt->pts != next_pts[stream_idx]) {
+            fprintf(stderr, "stream %d: packet %"PRId64" received instead of %"PRId64"\n",
+                    stream_idx, pkt->pts, next_pts[stream_idx]);
+            errors++;
+        }
+        next_pts[stream_idx] = pkt->pts + 1;
+        received++;
+        av_packet_unref(pkt);
+    }
+
+    elapsed = av_gettime_relative() - start;
+
+    for (int i = 0; i < nb_producers; i++) {
+        pthread_join(producers[i].thread, NULL);
+        if (producers[i].ret < 0) {
+            fprintf(stderr, "stream %d: sending failed: %s\n", i,
+                    av_err2str(producers[i].ret));
+            errors++;
+        }
+    }
+    if (nb_eof != nb_producers) {
+        fprintf(stderr, "%d EOFs for %d streams\n", nb_eof, nb_producers);
+        errors++;
+    }
+
+    printf("%d producer(s), queue size %d: %"PRId64" packets in %.3f s, "
+           "%.0f packets/s, %.0f ns/packet\n",
+           nb_producers, queue_size, received, elapsed / 1e6,
+           elapsed ? received * 1e6 / elapsed : 0.0,
+           received ? elapsed * 1e3 / received : 0.0);
+
+    tq_free(&tq);
+    av_packet_free(&pkt);
+    av_freep(&producers);
+    av_freep(&next_pts);
+
+    return !!errors;
+}
@@ -0,0 +1,344 @@
+#!/usr/bin/env python3
+
+import argparse
+import glob
+import json
+import logging
+import os
+import platform
+import shlex
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+HELP = '''
+Run end-to-end transcode scenarios modelled on typical server jobs and
+report their cost in JSON, for tracking regressions between builds.
+
+Every scenario is run --runs times and the median of each metric is
+reported, along with the values of the individual runs:
+  wall_s                   wall clock time of the ffmpeg process
+  fps                      output video frames per wall clock second
+  speed                    media time produced per wall clock second
+  time_to_first_segment_s  until the first complete segment appeared,
+                           for segmenting scenarios
+  peak_rss_kb              peak resident set size of the ffmpeg process
+  cpu_s_per_media_min      user + system CPU seconds per minute of output
+
+Inputs are synthesized with the lavfi sources and cached in the work
+directory, so that they are identical between runs and builds. Scenarios
+that need real streams (PGS subtitles, 7.1 TrueHD) use the FATE samples
+given with --samples and are skipped without them, as are scenarios whose
+encoders, decoders, filters or (de)muxers are not in the ffmpeg build.
+
+transcode_bench.py --ffmpeg ./ffmpeg --samples fate-suite -o bench.json
+'''
+
+logging.basicConfig(format='transcode_bench|%(levelname)s> %(message)s', level=logging.INFO)
+log = logging.getLogger()
+
+# polling interval while waiting for the first segment, in seconds
+POLL_INTERVAL = 0.01
+
+
+class Formatter(
+    argparse.ArgumentDefaultsHelpFormatter, argparse.RawDescriptionHelpFormatter
+):
+    pass
+
+
+class Synthetic:
+    '''Input generated by ffmpeg, {d} in the arguments is the duration.'''
+
+    def __init__(self, name, args):
+        self.name = name
+        self.args = args
+
+
+class Sample:
+    '''Input taken from the FATE samples.'''
+
+    def __init__(self, path):
+        self.path = path
+
+
+class Scenario:
+    def __init__(self, name, description, inputs, args, requires, segments=None):
+        self.name = name
+        self.description = description
+        self.inputs = inputs
+        # ffmpeg arguments, {i0}, {i1}... are the inputs and {out} the output directory
+        self.args = args
+        self.requires = requires
+        # glob of the segment files in the output directory
+        self.segments = segments
+
+
+HDR10_2160P = Synthetic('hevc-hdr10-2160p.mkv', [
+    '-f', 'lavfi', '-i', 'testsrc2=s=3840x2160:r=24000/1001:d={d}',
+    '-vf', 'format=yuv420p10le', '-c:v', 'libx265', '-preset', 'ultrafast',
+    '-x265-params', 'log-level=error:hdr10=1:colorprim=bt2020:transfer=smpte2084:'
+                    'colormatrix=bt2020nc:max-cll=1000,400:'
+                    'master-display=G(13250,34500)B(7500,3000)R(34000,16000)'
+                    'WP(15635,16450)L(10000000,1)',
+    '-color_primaries', 'bt2020', '-color_trc', 'smpte2084', '-colorspace', 'bt2020nc',
+])
+
+DVD_480I = Synthetic('mpeg2-480i.vob', [
+    '-f', 'lavfi', '-i', 'testsrc2=s=720x480:r=60000/1001:d={d}',
+    '-f', 'lavfi', '-i', 'sine=f=440:r=48000:d={d}',
+    '-vf', 'tinterlace=interleave_top,setfield=tff', '-aspect', '16:9',
+    '-c:v', 'mpeg2video', '-flags', '+ilme+ildct', '-top', '1',
+    '-b:v', '6M', '-maxrate', '9M', '-bufsize', '1835k',
+    '-c:a', 'ac3', '-b:a', '192k', '-f', 'dvd',
+])
+
+H264_1080P = Synthetic('h264-1080p.mkv', [
+    '-f', 'lavfi', '-i', 'testsrc2=s=1920x1080:r=24000/1001:d={d}',
+    '-f', 'lavfi', '-i', 'sine=f=440:r=48000:d={d}',
+    '-c:v', 'libx264', '-preset', 'ultrafast', '-g', '48', '-pix_fmt', 'yuv420p',
+    '-c:a', 'aac', '-b:a', '128k',
+])
+
+H264_OUTPUT = ['-c:v', 'libx264', '-preset', 'veryfast', '-crf', '23']
+
+SCENARIOS = [
+    Scenario(
+        'hevc-hdr-tonemap', '4K HEVC HDR10 to 1080p H.264 SDR with tonemapping',
+        [HDR10_2160P],
+        ['-i', '{i0}', '-vf',
+         'zscale=w=1920:h=1080:t=linear:npl=100,format=gbrpf32le,zscale=p=bt709,'
+         'tonemap=hable:desat=0,zscale=t=bt709:m=bt709:r=tv,format=yuv420p']
+        + H264_OUTPUT + ['{out}/output.mp4'],
+        ['encoder:libx265', 'decoder:hevc', 'filter:zscale', 'filter:tonemap',
+         'encoder:libx264', 'muxer:mp4']),
+    Scenario(
+        'dvd-deinterlace', 'DVD MPEG-2 480i deinterlaced to H.264, AC-3 to AAC',
+        [DVD_480I],
+        ['-i', '{i0}', '-vf', 'bwdif=mode=send_frame:parity=tff'] + H264_OUTPUT
+        + ['-c:a', 'aac', '-b:a', '160k', '{out}/output.mp4'],
+        ['encoder:mpeg2video', 'encoder:ac3', 'muxer:dvd', 'filter:tinterlace',
+         'decoder:mpeg2video', 'decoder:ac3', 'filter:bwdif', 'encoder:libx264',
+         'encoder:aac', 'muxer:mp4']),
+    Scenario(
+        'mkv-dash-remux', 'Matroska H.264/AAC remuxed to DASH',
+        [H264_1080P],
+        ['-i', '{i0}', '-map', '0', '-c', 'copy', '-f', 'dash', '-seg_duration', '4',
+         '{out}/manifest.mpd'],
+        ['encoder:libx264', 'encoder:aac', 'muxer:dash'],
+        segments='chunk-stream*-*.m4s'),
+    Scenario(
+        'pgs-burnin', '1080p H.264 with PGS subtitles burnt in',
+        [H264_1080P, Sample('sub/pgs_sub.sup')],
+        ['-i', '{i0}', '-i', '{i1}', '-filter_complex', '[0:v:0][1:s:0]overlay=eof_action=pass[v]',
+         '-map', '[v]', '-map', '0:a'] + H264_OUTPUT + ['-c:a', 'copy', '{out}/output.mkv'],
+        ['encoder:libx264', 'encoder:aac', 'demuxer:sup', 'decoder:pgssub',
+         'filter:overlay', 'muxer:matroska']),
+    Scenario(
+        'truehd-aac-stereo', '7.1 TrueHD downmixed to stereo AAC',
+        [Sample('truehd/atmos.thd')],
+        ['-i', '{i0}', '-ac', '2', '-c:a', 'aac', '-b:a', '192k', '{out}/output.m4a'],
+        ['demuxer:truehd', 'decoder:truehd', 'encoder:aac', 'muxer:ipod']),
+]
+
+
+def _run_command(cmd, capture=False):
+    log.debug(f"Running command:\n$ {shlex.join(cmd)}")
+    return subprocess.run(cmd, check=True, stdout=subprocess.PIPE if capture else None,
+                          stdin=subprocess.DEVNULL, universal_newlines=True)
+
+
+def capabilities(ffmpeg):
+    '''Names of the components of the build, as 'kind:name'.'''
+    caps = set()
+    for kind, option, skip in (('encoder', '-encoders', '------'),
+                               ('decoder', '-decoders', '------'),
+                               ('filter', '-filters', None),
+                               ('muxer', '-muxers', '--'),
+                               ('demuxer', '-demuxers', '--')):
+        lines = _run_command([ffmpeg, '-hide_banner', option], capture=True).stdout.splitlines()
+        if skip:
+            lines = lines[next((i + 1 for i, l in enumerate(lines) if l.strip() == skip), 0):]
+        for line in lines:
+            fields = line.split()
+            if kind == 'filter':
+                # flags, name, links, description; the header has no links
+                if len(fields) < 3 or '->' not in fields[2]:
+                    continue
+            elif len(fields) < 2:
+                continue
+            for name in fields[1].split(','):
+                caps.add(f'{kind}:{name}')
+    return caps
+
+
+def prepare_inputs(args, scenario):
+    paths = []
+    for inp in scenario.inputs:
+        if isinstance(inp, Sample):
+            if not args.samples:
+                return None, f'needs the FATE sample {inp.path}, see --samples'
+            path = os.path.join(args.samples, inp.path)
+            if not os.path.exists(path):
+                return None, f'FATE sample {path} not found'
+        else:
+            path = os.path.join(args.workdir, 'inputs', f'{args.duration:g}s-{inp.name}')
+            if not os.path.exists(path):
+                os.makedirs(os.path.dirname(path), exist_ok=True)
+                log.info(f"Generating {path}")
+                tmp = path + '.tmp' + os.path.splitext(path)[1]
+                gen = [a.format(d=args.duration) for a in inp.args]
+                _run_command([args.ffmpeg, '-nostdin', '-v', 'error', '-y'] + gen + [tmp])
+                os.replace(tmp, path)
+        paths.append(path)
+    return paths, None
+
+
+def read_progress(path):
+    progress = {}
+    with open(path) as f:
+        for line in f:
+            key, _, value = line.strip().partition('=')
+            progress[key] = value
+    return progress
+
+
+def run_once(args, scenario, inputs):
+    outdir = tempfile.mkdtemp(prefix=f'{scenario.name}-', dir=os.path.join(args.workdir, 'runs'))
+    progress = os.path.join(outdir, 'progress.txt')
+    subst = {f'i{i}': path for i, path in enumerate(inputs)}
+    subst['out'] = outdir
+    cmd = [args.ffmpeg, '-nostdin', '-v', 'error', '-y', '-progress', progress]
+    cmd += [a.format(**subst) for a in scenario.args]
+    log.debug(f"Running command:\n$ {shlex.join(cmd)}")
+
+    first_segment = None
+    start = time.monotonic()
+    proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL)
+    while True:
+        # os.wait4() rather than Popen.wait() gives the usage of this child only
+        pid, status, usage = os.wait4(proc.pid, 0 if first_segment or not scenario.segments
+                                      else os.WNOHANG)
+        if pid:
+            break
+        if glob.glob(os.path.join(outdir, scenario.segments)):
+            first_segment = time.monotonic() - start
+        else:
+            time.sleep(POLL_INTERVAL)
+    wall = time.monotonic() - start
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode:
+        raise subprocess.CalledProcessError(proc.returncode, cmd)
+
+    info = read_progress(progress)
+    frames = int(info.get('frame', 0) or 0)
+    media = int(info.get('out_time_us', 0) or 0) / 1e6
+    cpu = usage.ru_utime + usage.ru_stime
+    # ru_maxrss is in bytes on macOS and in kilobytes elsewhere
+    rss = usage.ru_maxrss // 1024 if sys.platform == 'darwin' else usage.ru_maxrss
+
+    if not args.keep:
+        shutil.rmtree(outdir, ignore_errors=True)
+
+    return {
+        'wall_s': wall,
+        'fps': frames / wall if frames else None,
+        'speed': media / wall if media else None,
+        'time_to_first_segment_s': first_segment,
+        'peak_rss_kb': rss,
+        'cpu_s_per_media_min': cpu / (media / 60) if media else None,
+    }
+
+
+def median(runs, key):
+    values = [run[key] for run in runs if run[key] is not None]
+    return statistics.median(values) if values else None
+
+
+def run_scenario(args, scenario, caps):
+    result = {'name': scenario.name, 'description': scenario.description}
+
+    missing = [r for r in scenario.requires if r not in caps]
+    if missing:
+        result.update(status='skipped', reason='not in this build: ' + ', '.join(missing))
+        return result
+    inputs, reason = prepare_inputs(args, scenario)
+    if reason:
+        result.update(status='skipped', reason=reason)
+        return result
+
+    runs = []
+    try:
+        for i in range(args.runs):
+            runs.append(run_once(args, scenario, inputs))
+            log.info(f"{scenario.name} run {i + 1}/{args.runs}: {runs[-1]['wall_s']:.2f}s")
+    except subprocess.CalledProcessError as e:
+        result.update(status='failed', reason=f'ffmpeg exited with {e.returncode}')
+        return result
+
+    result['status'] = 'ok'
+    result.update({key: median(runs, key) for key in runs[0]})
+    result['runs'] = runs
+    return result
+
+
+def transcode_bench():
+    parser = argparse.ArgumentParser(description=HELP, formatter_class=Formatter)
+    parser.add_argument('scenarios', nargs='*', help='specify the scenarios to run, all by default')
+    parser.add_argument('--ffmpeg', default='ffmpeg', help='specify the ffmpeg binary to benchmark')
+    parser.add_argument('--samples', default=os.environ.get('FATE_SAMPLES'),
+                        help='specify the FATE samples directory')
+    parser.add_argument('--workdir', default=os.path.join(tempfile.gettempdir(), 'transcode_bench'),
+                        help='specify the directory for the generated inputs and the outputs')
+    parser.add_argument('--duration', '-t', type=float, default=30,
+                        help='specify the length of the synthetic inputs in seconds')
+    parser.add_argument('--runs', '-r', type=int, default=3, help='specify the runs per scenario')
+    parser.add_argument('--output', '-o', help='specify the JSON report file, stdout by default')
+    parser.add_argument('--keep', help='keep the outputs of the runs', action='store_true')
+    parser.add_argument('--list', '-l', help='list the scenarios and exit', action='store_true')
+
+    args = parser.parse_args()
+
+    if args.list:
+        for scenario in SCENARIOS:
+            print(f'{scenario.name:20} {scenario.description}')
+        return
+
+    names = {s.name for s in SCENARIOS}
+    unknown = [n for n in args.scenarios if n not in names]
+    if unknown:
+        parser.error('unknown scenarios: ' + ', '.join(unknown))
+    scenarios = [s for s in SCENARIOS if not args.scenarios or s.name in args.scenarios]
+
+    os.makedirs(os.path.join(args.workdir, 'runs'), exist_ok=True)
+    caps = capabilities(args.ffmpeg)
+    version = _run_command([args.ffmpeg, '-hide_banner', '-version'], capture=True).stdout
+
+    report = {
+        'ffmpeg': version.splitlines()[0] if version else None,
+        'host': platform.node(),
+        'machine': platform.machine(),
+        'cpu_count': os.cpu_count(),
+        'duration_s': args.duration,
+        'scenarios': [],
+    }
+    for scenario in scenarios:
+        result = run_scenario(args, scenario, caps)
+        if result['status'] != 'ok':
+            log.warning(f"{scenario.name}: {result['status']}, {result['reason']}")
+        report['scenarios'].append(result)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(report, f, indent=2)
+            f.write('\n')
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+
+
+if __name__ == '__main__':
+    transcode_bench()
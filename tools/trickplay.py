@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+
+import argparse
+import glob
+import logging
+import os
+import shlex
+import shutil
+import struct
+import subprocess
+import tempfile
+import time
+
+HELP = '''
+Generate seek preview thumbnails of a video and store them in a BIF file.
+
+Only keyframes are decoded (-skip_frame nokey), one image is kept per
+interval, and it is scaled on the device that decoded it. With VAAPI and
+QSV the images are JPEG encoded by the hardware as well; with CUDA they are
+downloaded after scaling and encoded by the mjpeg encoder, which is cheap at
+thumbnail sizes. --hwaccel none runs the same keyframe-only pipeline in
+software.
+
+--benchmark additionally times the full decode software path, i.e. what is
+done without this tool, and reports the speedup, for example as in:
+trickplay.py -i input.mkv -o index.bif --hwaccel vaapi --benchmark
+'''
+
+logging.basicConfig(format='trickplay|%(levelname)s> %(message)s', level=logging.INFO)
+log = logging.getLogger()
+
+BIF_MAGIC = b'\x89BIF\r\n\x1a\n'
+BIF_HEADER_SIZE = 64
+
+
+class Formatter(
+    argparse.ArgumentDefaultsHelpFormatter, argparse.RawDescriptionHelpFormatter
+):
+    pass
+
+
+def _run_command(cmd, dry_run=False):
+    log.info(f"Running command:\n$ {shlex.join(cmd)}")
+    if not dry_run:
+        subprocess.run(cmd, check=True)
+
+
+def hw_quality(qscale):
+    # map the mjpeg qscale range 1-31 onto the 1-100 JPEG quality of the
+    # hardware encoders
+    return str(max(1, min(100, round(100 - (qscale - 1) * 99 / 30))))
+
+
+def build_command(args, hwaccel, outdir, keyframes_only=True):
+    select = f'fps=1/{args.interval}'
+    quality = ['-q:v', str(args.quality)]
+    cmd = ['ffmpeg', '-nostdin', '-v', 'error', '-y']
+
+    if keyframes_only:
+        cmd += ['-skip_frame', 'nokey']
+    if hwaccel == 'cuda':
+        cmd += ['-hwaccel', 'cuda', '-hwaccel_output_format', 'cuda']
+        if args.device:
+            cmd += ['-hwaccel_device', args.device]
+        vf = (f'{select},scale_cuda={args.width}:-2:format=yuv420p,'
+              'hwdownload,format=yuv420p,scale=out_range=full,format=yuvj420p')
+        codec = 'mjpeg'
+    elif hwaccel == 'vaapi':
+        cmd += ['-hwaccel', 'vaapi', '-hwaccel_output_format', 'vaapi',
+                '-vaapi_device', args.device or '/dev/dri/renderD128']
+        vf = f'{select},scale_vaapi=w={args.width}:h=-2:format=nv12:out_range=full'
+        codec = 'mjpeg_vaapi'
+        quality = ['-global_quality', hw_quality(args.quality)]
+    elif hwaccel == 'qsv':
+        cmd += ['-hwaccel', 'qsv', '-hwaccel_output_format', 'qsv']
+        if args.device:
+            cmd += ['-qsv_device', args.device]
+        vf = f'{select},scale_qsv=w={args.width}:h=-1:format=nv12'
+        codec = 'mjpeg_qsv'
+        quality = ['-global_quality', hw_quality(args.quality)]
+    else:
+        vf = f'{select},scale={args.width}:-2:out_range=full,format=yuvj420p'
+        codec = 'mjpeg'
+
+    cmd += ['-i', args.input, '-map', '0:v:0', '-an', '-sn', '-dn', '-vf', vf,
+            '-c:v', codec] + quality
+    if codec == 'mjpeg':
+        # the standard tables code each image in a single pass; the optimal
+        # ones buffer the whole image to gain a few percent on its size
+        cmd += ['-huffman', 'default']
+    cmd += ['-f', 'image2', os.path.join(outdir, 'img%06d.jpg')]
+    return cmd
+
+
+def write_bif(path, images, interval):
+    # Roku BIF: header, then an index of (timestamp, offset) pairs closed by
+    # an end marker holding the end of the data, then the JPEG images.
+    data = []
+    for image in images:
+        with open(image, 'rb') as f:
+            data.append(f.read())
+
+    offset = BIF_HEADER_SIZE + 8 * (len(data) + 1)
+    with open(path, 'wb') as f:
+        f.write(BIF_MAGIC)
+        f.write(struct.pack('<III', 0, len(data), round(interval * 1000)))
+        f.write(b'\0' * (BIF_HEADER_SIZE - f.tell()))
+        for i, image in enumerate(data):
+            f.write(struct.pack('<II', i, offset))
+            offset += len(image)
+        f.write(struct.pack('<II', 0xffffffff, offset))
+        for image in data:
+            f.write(image)
+
+
+def run_pipeline(args, hwaccel, keyframes_only=True):
+    outdir = tempfile.mkdtemp(prefix='trickplay-', dir=args.workdir)
+    try:
+        start = time.monotonic()
+        _run_command(build_command(args, hwaccel, outdir, keyframes_only), args.dry_run)
+        elapsed = time.monotonic() - start
+        images = sorted(glob.glob(os.path.join(outdir, 'img*.jpg')))
+        if keyframes_only and not args.dry_run:
+            write_bif(args.output, images, args.interval)
+        return elapsed, len(images)
+    finally:
+        shutil.rmtree(outdir, ignore_errors=True)
+
+
+def trickplay():
+    parser = argparse.ArgumentParser(description=HELP, formatter_class=Formatter)
+    parser.add_argument('--input', '-i', required=True, help='specify input file')
+    parser.add_argument('--output', '-o', required=True, help='specify output BIF file')
+    parser.add_argument('--hwaccel', default='none', choices=['none', 'cuda', 'vaapi', 'qsv'],
+                        help='specify the device used for decoding, scaling and encoding')
+    parser.add_argument('--device', help='specify the hardware device')
+    parser.add_argument('--interval', type=float, default=10,
+                        help='specify the interval between thumbnails in seconds')
+    parser.add_argument('--width', type=int, default=320, help='specify the thumbnail width')
+    parser.add_argument('--quality', type=int, default=4,
+                        help='specify the JPEG quality as an mjpeg qscale (1-31, lower is better)')
+    parser.add_argument('--workdir', help='specify the directory for the intermediate images')
+    parser.add_argument('--benchmark', help='also time the full decode software path',
+                        action='store_true')
+    parser.add_argument('--dry-run', '-n', help='simulate commands', action='store_true')
+
+    args = parser.parse_args()
+
+    elapsed, count = run_pipeline(args, args.hwaccel)
+    log.info(f"Wrote {count} thumbnails to '{args.output}' in {elapsed:.2f}s "
+             f"({args.hwaccel}, keyframes only)")
+
+    if args.benchmark:
+        baseline, _ = run_pipeline(args, 'none', keyframes_only=False)
+        log.info(f"Full decode software path: {baseline:.2f}s")
+        if elapsed > 0 and not args.dry_run:
+            log.info(f"Speedup: {baseline / elapsed:.2f}x")
+
+
+if __name__ == '__main__':
+    trickplay()